@@ -14,7 +14,10 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
+#include <string.h>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "Farfalle.h"
@@ -35,6 +38,99 @@ static void Farfalle_assert(bool condition, const string &synopsis, const char *
 #define assert(cond, msg)  Farfalle_assert(cond, msg, __FUNCTION__)
 #endif
 
+// Below this amount of state bytes, the blocks are processed in the calling thread.
+static const unsigned int minimumParallelLength = 1 << 16;
+
+// The number of states given at once to BaseIterableTransformation::applyBatch().
+static const unsigned int statesPerBatch = 32;
+
+/** Calls body(worker, first, last) on nrWorkers consecutive ranges covering [0, count), each in its own thread. */
+static void forEachRange(unsigned int count, unsigned int nrWorkers, const function<void(unsigned int, unsigned int, unsigned int)> &body)
+{
+	if (nrWorkers <= 1)
+	{
+		body(0, 0, count);
+		return;
+	}
+	vector<thread> threads;
+	for (unsigned int t = 1; t < nrWorkers; t++)
+	{
+		threads.push_back(thread(body, t, (unsigned int)((UINT64)t * count / nrWorkers), (unsigned int)((UINT64)(t + 1) * count / nrWorkers)));
+	}
+	body(0, 0, (unsigned int)((UINT64)count / nrWorkers));
+	for (unsigned int t = 0; t < threads.size(); t++)
+	{
+		threads[t].join();
+	}
+}
+
+/** Copies length bits from src, starting at bit srcOffset, into dest, starting at bit destOffset. */
+static void copyBits(UINT8 *dest, UINT64 destOffset, const UINT8 *src, UINT64 srcOffset, UINT64 length)
+{
+	if (((destOffset % 8) == 0) && ((srcOffset % 8) == 0))
+	{
+		memcpy(dest + destOffset / 8, src + srcOffset / 8, length / 8);
+		if ((length % 8) != 0)
+		{
+			dest[(destOffset + length) / 8] = src[(srcOffset + length) / 8] & ((1 << (length % 8)) - 1);
+		}
+		return;
+	}
+	for (UINT64 i = 0; i < length; i++)
+	{
+		UINT8 bit = (src[(srcOffset + i) / 8] >> ((srcOffset + i) % 8)) & 1;
+		UINT8 &d = dest[(destOffset + i) / 8];
+		unsigned int z = (destOffset + i) % 8;
+		d = (d & ~(1 << z)) | (bit << z);
+	}
+}
+
+/** XORs length bits from src, starting at bit srcOffset, into dest, starting at bit destOffset. */
+static void xorBits(UINT8 *dest, UINT64 destOffset, const UINT8 *src, UINT64 srcOffset, UINT64 length)
+{
+	if (((destOffset % 8) == 0) && ((srcOffset % 8) == 0))
+	{
+		UINT8 *d = dest + destOffset / 8;
+		const UINT8 *s = src + srcOffset / 8;
+		for (UINT64 i = 0; i < length / 8; i++)
+		{
+			d[i] ^= s[i];
+		}
+		if ((length % 8) != 0)
+		{
+			d[length / 8] ^= s[length / 8] & ((1 << (length % 8)) - 1);
+		}
+		return;
+	}
+	for (UINT64 i = 0; i < length; i++)
+	{
+		UINT8 bit = (src[(srcOffset + i) / 8] >> ((srcOffset + i) % 8)) & 1;
+		dest[(destOffset + i) / 8] ^= bit << ((destOffset + i) % 8);
+	}
+}
+
+/* BaseIterableTransformation */
+void BaseIterableTransformation::applyInPlace(UINT8 *state) const
+{
+	BitString output = (*this)(BitString(state, width));
+	memcpy(state, output.array(), width / 8);
+}
+
+void BaseIterableTransformation::applyBatch(UINT8 *states, unsigned int count) const
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		applyInPlace(states + i * (width / 8));
+	}
+}
+
+/* BaseRollingFunction */
+void BaseRollingFunction::rollInPlace(UINT64 *k, unsigned int width, unsigned int i) const
+{
+	BitString kp = (*this)(BitString(reinterpret_cast<const UINT8 *>(k), width), i);
+	memcpy(k, kp.array(), width / 8);
+}
+
 /* IdentityRollingFunction */
 BitString IdentityRollingFunction::operator()(const BitString &k, unsigned int i) const
 {
@@ -42,6 +138,13 @@ BitString IdentityRollingFunction::operator()(const BitString &k, unsigned int i
 	return k;
 }
 
+void IdentityRollingFunction::rollInPlace(UINT64 *k, unsigned int width, unsigned int i) const
+{
+	(void)k;
+	(void)width;
+	(void)i;
+}
+
 /* Farfalle */
 Farfalle::Farfalle(BaseIterableTransformation &p_b,
                    BaseIterableTransformation &p_c,
@@ -49,55 +152,388 @@ Farfalle::Farfalle(BaseIterableTransformation &p_b,
                    BaseIterableTransformation &p_e,
                    BaseRollingFunction        &roll_c,
                    BaseRollingFunction        &roll_e)
-	: p_b(p_b), p_c(p_c), p_d(p_d), p_e(p_e), roll_c(roll_c), roll_e(roll_e)
+	: p_b(p_b), p_c(p_c), p_d(p_d), p_e(p_e), roll_c(roll_c), roll_e(roll_e), nrThreads(0)
 {
 	assert((p_b.width % 8) == 0 && (p_c.width % 8) == 0 && (p_d.width % 8) == 0 && (p_e.width % 8) == 0,
 		"This implementation only supports permutation width that are multiple of 8."); // Limitation of Transformation class
 }
 
 BitString Farfalle::operator()(const BitString &K, const BitStrings &Mseq, unsigned int n, unsigned int q) const
+{
+	vector<UINT8> Z((n + 7) / 8 + 1);
+	(*this)(K, Mseq, &Z[0], n, q);
+	return BitString(&Z[0], n);
+}
+
+void Farfalle::operator()(const BitString &K, const BitStrings &Mseq, UINT8 *Z, unsigned int n, unsigned int q) const
+{
+	FarfalleState state = initialize(K);
+
+	for (unsigned int j = 0; j < Mseq.size(); j++)
+	{
+		absorb(state, Mseq[j]);
+	}
+	output(state, Z, n, q);
+}
+
+BitString Farfalle::operator()(const shared_ptr<const FarfalleKeyContext> &key, const BitStrings &Mseq, unsigned int n, unsigned int q) const
+{
+	return evaluate(initialize(key), Mseq, n, q);
+}
+
+void Farfalle::operator()(const shared_ptr<const FarfalleKeyContext> &key, const BitStrings &Mseq, UINT8 *Z, unsigned int n, unsigned int q) const
+{
+	FarfalleState state = initialize(key);
+
+	for (unsigned int j = 0; j < Mseq.size(); j++)
+	{
+		absorb(state, Mseq[j]);
+	}
+	output(state, Z, n, q);
+}
+
+BitString Farfalle::evaluate(const FarfalleState &state, const BitStrings &Mseq, unsigned int n, unsigned int q) const
+{
+	FarfalleState stateAfterMseq = state;
+
+	for (unsigned int j = 0; j < Mseq.size(); j++)
+	{
+		absorb(stateAfterMseq, Mseq[j]);
+	}
+	return output(stateAfterMseq, n, q);
+}
+
+shared_ptr<const FarfalleKeyContext> Farfalle::prepareKey(const BitString &K, unsigned int nrMasks) const
+{
+	shared_ptr<FarfalleKeyContext> key = make_shared<FarfalleKeyContext>();
+	key->k = initialize(K).k;
+	key->nrMasks = nrMasks;
+	key->wordsPerMask = (width() / 8 + 7) / 8;
+	key->p_b = &p_b;
+	key->roll_c = &roll_c;
+	key->masks.assign((size_t)nrMasks * key->wordsPerMask, 0);
+	for (unsigned int i = 0; i < nrMasks; i++)
+	{
+		UINT64 *mask = &key->masks[(size_t)i * key->wordsPerMask];
+		if (i == 0)
+		{
+			memcpy(mask, key->k.array(), width() / 8);
+		}
+		else
+		{
+			memcpy(mask, mask - key->wordsPerMask, key->wordsPerMask * 8);
+			roll_c.rollInPlace(mask, width(), 1);
+		}
+	}
+	return key;
+}
+
+FarfalleState Farfalle::initialize(const shared_ptr<const FarfalleKeyContext> &key) const
+{
+	if ((key->p_b != &p_b) || (key->roll_c != &roll_c)) throw Exception("The key context was prepared for another instance of Farfalle");
+
+	FarfalleState state;
+	state.k = key->k;
+	state.x = BitString::zeroes(width());
+	state.I = 0;
+	state.key = key;
+	return state;
+}
+
+void Farfalle::getCompressionMask(const FarfalleState &state, unsigned int i, UINT64 *mask) const
+{
+	const FarfalleKeyContext *key = state.key.get();
+	if ((key != 0) && (key->nrMasks > 0))
+	{
+		unsigned int j = min(i, key->nrMasks - 1);
+		memcpy(mask, &key->masks[(size_t)j * key->wordsPerMask], key->wordsPerMask * 8);
+		roll_c.rollInPlace(mask, width(), i - j);
+	}
+	else
+	{
+		memcpy(mask, state.k.array(), width() / 8);
+		roll_c.rollInPlace(mask, width(), i);
+	}
+}
+
+FarfalleState Farfalle::initialize(const BitString &K) const
 {
 	unsigned int b = width();
 	if (!(K.size() <= b - 1)) throw Exception("Key length must be less than b bits");
-	unsigned int m = Mseq.size();
 
+	FarfalleState state;
 	BitString Kp = K || BitString::pad10(b, K.size());
-	BitString k = p_b(Kp);
+	state.k = Kp;
+	p_b.applyInPlace(state.k.array());
+	state.x = BitString::zeroes(b);
+	state.I = 0;
+	return state;
+}
+
+void Farfalle::absorb(FarfalleState &state, const BitString &M) const
+{
+	unsigned int b = width();
+	unsigned int mu = (M.size() + b) / b;
+	BitString Mp = M || BitString::pad10(mu * b, M.size());
+
+	// x = x ^ p_c(mblocks[i - I] ^ roll_c(k, i)) for i from I to I + mu - 1
+	compress(state, Mp.array(), state.I, mu, state.x);
+
+	state.I = state.I + mu + 1;
+}
+
+void Farfalle::absorb(FarfalleState &state, const UINT8 *M, size_t length, UINT8 delimitedSuffix) const
+{
+	if (delimitedSuffix == 0) throw Exception("delimitedSuffix has an invalid coding");
+
+	const unsigned int b = width();
+	const unsigned int stateSize = b / 8;
+	unsigned int suffixLength = 0;
+	while ((delimitedSuffix >> (suffixLength + 1)) != 0) suffixLength++;
+	UINT64 size = (UINT64)length * 8 + suffixLength;
+	unsigned int mu = (unsigned int)((size + b) / b);
+
+	// The whole blocks come from M, the rest, with the suffix and the padding, from at most two blocks on the side
+	unsigned int nrWholeBlocks = (unsigned int)(length / stateSize);
+	compress(state, M, state.I, nrWholeBlocks, state.x);
+	size_t tailLength = length - (size_t)nrWholeBlocks * stateSize;
+	vector<UINT8> tail((size_t)(mu - nrWholeBlocks) * stateSize, 0);
+	if (tailLength > 0)
+	{
+		memcpy(&tail[0], M + (size_t)nrWholeBlocks * stateSize, tailLength);
+	}
+	// The delimiter bit of the suffix is the first bit of the padding 10*
+	tail[tailLength] = delimitedSuffix;
+	compress(state, &tail[0], state.I + nrWholeBlocks, mu - nrWholeBlocks, state.x);
+
+	state.I = state.I + mu + 1;
+}
 
-	BitString    x = BitString::zeroes(b);
-	unsigned int I = 0;
+BitString Farfalle::output(const FarfalleState &state, unsigned int n, unsigned int q) const
+{
+	vector<UINT8> Z((n + 7) / 8 + 1);
+	output(state, &Z[0], n, q);
+	return BitString(&Z[0], n);
+}
 
-	for (unsigned int j = 0; j <= m - 1; j++)
+void Farfalle::output(const FarfalleState &state, UINT8 *Z, unsigned int n, unsigned int q) const
+{
+	BitString kp = state.k;
+	vector<UINT64> mask((width() / 8 + 7) / 8);
+	getCompressionMask(state, state.I, &mask[0]);
+	memcpy(kp.array(), &mask[0], width() / 8);
+	BitString y = state.x;
+	p_d.applyInPlace(y.array());
+	expand(y, kp, Z, n, q);
+}
+
+void Farfalle::addOutput(const FarfalleState &state, UINT8 *Z, unsigned int n, unsigned int q) const
+{
+	BitString kp = state.k;
+	vector<UINT64> mask((width() / 8 + 7) / 8);
+	getCompressionMask(state, state.I, &mask[0]);
+	memcpy(kp.array(), &mask[0], width() / 8);
+	BitString y = state.x;
+	p_d.applyInPlace(y.array());
+	expand(y, kp, Z, n, q, true);
+}
+
+unsigned int Farfalle::width() const
+{
+	return p_b.width;
+}
+
+void Farfalle::setNumberOfThreads(unsigned int aNrThreads)
+{
+	nrThreads = aNrThreads;
+}
+
+unsigned int Farfalle::numberOfWorkers(unsigned int count) const
+{
+	if ((UINT64)count * (width() / 8) < minimumParallelLength)
+	{
+		return 1;
+	}
+	unsigned int n = (nrThreads == 0) ? max(1U, thread::hardware_concurrency()) : nrThreads;
+	return min(n, count);
+}
+
+void Farfalle::compress(const FarfalleState &state, const UINT8 *blocks, unsigned int I, unsigned int mu, BitString &x) const
+{
+	if (mu == 0)
 	{
-		unsigned int mu = (Mseq[j].size() + b) / b;
-		BitString M = Mseq[j] || BitString::pad10(mu * b, Mseq[j].size());
-		Blocks mblocks(M, b);
+		return;
+	}
+	const unsigned int stateSize = width() / 8;
+	unsigned int nrWorkers = numberOfWorkers(mu);
+	vector<UINT8> accumulators(nrWorkers * stateSize, 0);
 
-		for (unsigned int i = I; i <= I + mu - 1; i++)
+	// Each worker rolls its own masks from its first block, then XORs the outputs of p_c into its accumulator
+	forEachRange(mu, nrWorkers, [&](unsigned int worker, unsigned int first, unsigned int last)
+	{
+		UINT8 *accumulator = &accumulators[worker * stateSize];
+		vector<UINT8> states(statesPerBatch * stateSize);
+		vector<UINT64> mask((stateSize + 7) / 8);
+		getCompressionMask(state, I + first, &mask[0]);
+		for (unsigned int i = first; i < last; i += statesPerBatch)
 		{
-			x = x ^ p_c(mblocks[i - I] ^ roll_c(k, i));
+			unsigned int count = min(statesPerBatch, last - i);
+			for (unsigned int s = 0; s < count; s++)
+			{
+				const UINT8 *block = blocks + (size_t)(i + s) * stateSize;
+				const UINT8 *m = reinterpret_cast<const UINT8 *>(&mask[0]);
+				UINT8 *input = &states[s * stateSize];
+				for (unsigned int z = 0; z < stateSize; z++)
+				{
+					input[z] = block[z] ^ m[z];
+				}
+				if (i + s + 1 < last)
+				{
+					roll_c.rollInPlace(&mask[0], width(), 1);
+				}
+			}
+			p_c.applyBatch(&states[0], count);
+			for (unsigned int s = 0; s < count; s++)
+			{
+				for (unsigned int z = 0; z < stateSize; z++)
+				{
+					accumulator[z] ^= states[s * stateSize + z];
+				}
+			}
 		}
+	});
 
-		I = I + mu + 1;
+	UINT8 *acc = x.array();
+	for (unsigned int worker = 0; worker < nrWorkers; worker++)
+	{
+		for (unsigned int z = 0; z < stateSize; z++)
+		{
+			acc[z] ^= accumulators[worker * stateSize + z];
+		}
 	}
+}
 
-	BitString kp = roll_c(k, I);
-	BitString y = p_d(x);
+void Farfalle::expand(const BitString &y, const BitString &kp, UINT8 *Z, unsigned int n, unsigned int q, bool add) const
+{
+	if (n == 0)
+	{
+		return;
+	}
+	const unsigned int b = width();
+	const unsigned int stateSize = b / 8;
+	const unsigned int firstBlock = q / b;
+	const unsigned int nrBlocks = (unsigned int)(((UINT64)q + n + b - 1) / b) - firstBlock;
+	const UINT8 *mask = kp.array();
+
+	// Output blocks start on byte boundaries in Z only when q is a multiple of 8, otherwise neighbouring workers would share bytes
+	unsigned int nrWorkers = ((q % 8) == 0) ? numberOfWorkers(nrBlocks) : 1;
 
-	Blocks zblocks(width());
+	// Each worker rolls its own states from its first block, then writes p_e(roll_e(y, j)) ^ kp for its blocks j into Z
+	forEachRange(nrBlocks, nrWorkers, [&](unsigned int, unsigned int first, unsigned int last)
+	{
+		vector<UINT8> states(statesPerBatch * stateSize);
+		vector<UINT64> state((stateSize + 7) / 8);
+		memcpy(&state[0], y.array(), stateSize);
+		roll_e.rollInPlace(&state[0], b, firstBlock + first);
+		for (unsigned int i = first; i < last; i += statesPerBatch)
+		{
+			unsigned int count = min(statesPerBatch, last - i);
+			for (unsigned int s = 0; s < count; s++)
+			{
+				memcpy(&states[s * stateSize], &state[0], stateSize);
+				if (i + s + 1 < last)
+				{
+					roll_e.rollInPlace(&state[0], b, 1);
+				}
+			}
+			p_e.applyBatch(&states[0], count);
+			for (unsigned int s = 0; s < count; s++)
+			{
+				for (unsigned int z = 0; z < stateSize; z++)
+				{
+					states[s * stateSize + z] ^= mask[z];
+				}
+			}
+			// The batch covers the bits from (firstBlock + i) * b to (firstBlock + i + count) * b of the expansion
+			UINT64 start = max((UINT64)(firstBlock + i) * b, (UINT64)q);
+			UINT64 end = min((UINT64)(firstBlock + i + count) * b, (UINT64)q + n);
+			if (add)
+			{
+				xorBits(Z, start - q, &states[0], start - (UINT64)(firstBlock + i) * b, end - start);
+			}
+			else
+			{
+				copyBits(Z, start - q, &states[0], start - (UINT64)(firstBlock + i) * b, end - start);
+			}
+		}
+	});
 
-	for (unsigned int j = 0; width() * j < n + q; j++)
+	if (((n % 8) != 0) && !add)
 	{
-		zblocks[j] = p_e(roll_e(y, j)) ^ kp;
+		Z[n / 8] &= (1 << (n % 8)) - 1;
 	}
+}
 
-	BitString Z = BitString::substring(zblocks.bits(), q, n);
-	return Z;
+/* FarfalleKeyContextPool */
+FarfalleKeyContextPool::FarfalleKeyContextPool(const Farfalle &F, unsigned int capacity, unsigned int nrMasks)
+	: F(F), capacity(max(1U, capacity)), nrMasks(nrMasks)
+{
 }
 
-unsigned int Farfalle::width() const
+string FarfalleKeyContextPool::identify(const BitString &K)
 {
-	return p_b.width;
+	string id(reinterpret_cast<const char *>(K.array()), (K.size() + 7) / 8);
+	unsigned int size = K.size();
+	id.append(reinterpret_cast<const char *>(&size), sizeof(size));
+	return id;
+}
+
+shared_ptr<const FarfalleKeyContext> FarfalleKeyContextPool::get(const BitString &K)
+{
+	string id = identify(K);
+	{
+		lock_guard<mutex> guard(lock);
+		unordered_map<string, ContextList::iterator>::iterator found = index.find(id);
+		if (found != index.end())
+		{
+			contexts.splice(contexts.begin(), contexts, found->second);
+			return found->second->second;
+		}
+	}
+	// The key setup is done outside the lock, so that other keys are served meanwhile
+	shared_ptr<const FarfalleKeyContext> key = F.prepareKey(K, nrMasks);
+	lock_guard<mutex> guard(lock);
+	unordered_map<string, ContextList::iterator>::iterator found = index.find(id);
+	if (found != index.end())
+	{
+		contexts.splice(contexts.begin(), contexts, found->second);
+		return found->second->second;
+	}
+	contexts.push_front(make_pair(id, key));
+	index[id] = contexts.begin();
+	if (contexts.size() > capacity)
+	{
+		index.erase(contexts.back().first);
+		contexts.pop_back();
+	}
+	return key;
+}
+
+void FarfalleKeyContextPool::remove(const BitString &K)
+{
+	lock_guard<mutex> guard(lock);
+	unordered_map<string, ContextList::iterator>::iterator found = index.find(identify(K));
+	if (found != index.end())
+	{
+		contexts.erase(found->second);
+		index.erase(found);
+	}
+}
+
+unsigned int FarfalleKeyContextPool::size()
+{
+	lock_guard<mutex> guard(lock);
+	return (unsigned int)contexts.size();
 }
 
 /* Farfalle-SANE */
@@ -108,11 +544,28 @@ FarfalleSANE::FarfalleSANE(const Farfalle  &F,
                            const BitString &N,
                            BitString &T,
                            bool sender)
-	: F(F), t(t), l(l), K(K), e(0)
+	: F(F), t(t), l(l), history(F.initialize(K)), e(0)
+{
+	start(N, T, sender);
+}
+
+FarfalleSANE::FarfalleSANE(const Farfalle                             &F,
+                           unsigned int                                t,
+                           unsigned int                                l,
+                           const shared_ptr<const FarfalleKeyContext> &key,
+                           const BitString                            &N,
+                           BitString                                  &T,
+                           bool                                        sender)
+	: F(F), t(t), l(l), history(F.initialize(key)), e(0)
+{
+	start(N, T, sender);
+}
+
+void FarfalleSANE::start(const BitString &N, BitString &T, bool sender)
 {
 	offset = l * ((t + l - 1) / l);
-	history = N;
-	BitString Tp = F(K, history, t);
+	F.absorb(history, N);
+	BitString Tp = F.output(history, t);
 
 	if (sender)
 	{
@@ -126,38 +579,38 @@ FarfalleSANE::FarfalleSANE(const Farfalle  &F,
 
 pair<BitString, BitString> FarfalleSANE::wrap(const BitString &A, const BitString &P)
 {
-	BitString C = P ^ F(K, history, P.size(), offset);
+	BitString C = P ^ F.output(history, P.size(), offset);
 
 	if (A.size() > 0 || P.size() == 0)
 	{
-		history = (A || 0 || e) * history;
+		F.absorb(history, A || 0 || e);
 	}
 
 	if (P.size() > 0)
 	{
-		history = (C || 1 || e) * history;
+		F.absorb(history, C || 1 || e);
 	}
 
-	BitString T = F(K, history, t);
+	BitString T = F.output(history, t);
 	e = (e + 1) % 2;
 	return make_pair(C, T);
 }
 
 BitString FarfalleSANE::unwrap(const BitString &A, const BitString &C, const BitString &T)
 {
-	BitString P = C ^ F(K, history, C.size(), offset);
+	BitString P = C ^ F.output(history, C.size(), offset);
 
 	if (A.size() > 0 || C.size() == 0)
 	{
-		history = (A || 0 || e) * history;
+		F.absorb(history, A || 0 || e);
 	}
 
 	if (C.size() > 0)
 	{
-		history = (C || 1 || e) * history;
+		F.absorb(history, C || 1 || e);
 	}
 
-	BitString Tp = F(K, history, t);
+	BitString Tp = F.output(history, t);
 	e = (e + 1) % 2;
 
 	if (Tp == T)
@@ -174,7 +627,14 @@ BitString FarfalleSANE::unwrap(const BitString &A, const BitString &C, const Bit
 FarfalleSANSE::FarfalleSANSE(const Farfalle  &F,
                              unsigned int     t,
                              const BitString &K)
-	: F(F), t(t), K(K), e(0)
+	: F(F), t(t), history(F.initialize(K)), e(0)
+{
+}
+
+FarfalleSANSE::FarfalleSANSE(const Farfalle                             &F,
+                             unsigned int                                t,
+                             const shared_ptr<const FarfalleKeyContext> &key)
+	: F(F), t(t), history(F.initialize(key)), e(0)
 {
 }
 
@@ -182,20 +642,22 @@ pair<BitString, BitString> FarfalleSANSE::wrap(const BitString &A, const BitStri
 {
 	if (A.size() > 0 || P.size() == 0)
 	{
-		history = (A || 0 || e) * history;
+		F.absorb(history, A || 0 || e);
 	}
 
 	BitString T, C;
 
 	if (P.size() > 0)
 	{
-		T =     F(K, (P || 0 || 1 || e) * history, t);
-		C = P ^ F(K, (T || 1 || 1 || e) * history, P.size());
-		history = (P || 0 || 1 || e) * history;
+		FarfalleState withT = history;
+		F.absorb(history, P || 0 || 1 || e);
+		T = F.output(history, t);
+		F.absorb(withT, T || 1 || 1 || e);
+		C = P ^ F.output(withT, P.size());
 	}
 	else
 	{
-		T = F(K, history, t);
+		T = F.output(history, t);
 	}
 
 	e = (e + 1) % 2;
@@ -206,18 +668,20 @@ BitString FarfalleSANSE::unwrap(const BitString &A, const BitString &C, const Bi
 {
 	if (A.size() > 0 || C.size() == 0)
 	{
-		history = (A || 0 || e) * history;
+		F.absorb(history, A || 0 || e);
 	}
 
 	BitString P;
 
 	if (C.size() > 0)
 	{
-		P = C ^ F(K, (T || 1 || 1 || e) * history, C.size());
-		history = (P || 0 || 1 || e) * history;
+		FarfalleState withT = history;
+		F.absorb(withT, T || 1 || 1 || e);
+		P = C ^ F.output(withT, C.size());
+		F.absorb(history, P || 0 || 1 || e);
 	}
 
-	BitString Tp = F(K, history, t);
+	BitString Tp = F.output(history, t);
 	e = (e + 1) % 2;
 
 	if (Tp == T)
@@ -259,6 +723,26 @@ unsigned int FarfalleWBC::split(unsigned int n) const
 }
 
 BitString FarfalleWBC::encipher(const BitString &K, const BitString &W, const BitString &P) const
+{
+	return encipher(H.initialize(K), G.initialize(K), W, P);
+}
+
+BitString FarfalleWBC::decipher(const BitString &K, const BitString &W, const BitString &C) const
+{
+	return decipher(H.initialize(K), G.initialize(K), W, C);
+}
+
+BitString FarfalleWBC::encipher(const shared_ptr<const FarfalleKeyContext> &key, const BitString &W, const BitString &P) const
+{
+	return encipher(H.initialize(key), G.initialize(key), W, P);
+}
+
+BitString FarfalleWBC::decipher(const shared_ptr<const FarfalleKeyContext> &key, const BitString &W, const BitString &C) const
+{
+	return decipher(H.initialize(key), G.initialize(key), W, C);
+}
+
+BitString FarfalleWBC::encipher(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &W, const BitString &P) const
 {
 	unsigned int b = H.width();
 
@@ -267,16 +751,16 @@ BitString FarfalleWBC::encipher(const BitString &K, const BitString &W, const Bi
 	BitString L = BitString::substring(P, 0, n_L);
 	BitString R = BitString::substring(P, n_L, n_R);
 
-	BitString Hval = H(K, (L || 0), min(b, R.size()));
+	BitString Hval = H.evaluate(keyH, (L || 0), min(b, R.size()));
 	R = R ^ (Hval || BitString::zeroes(R.size() - Hval.size()));
-	L = L ^ G(K, (R || 1) * W, L.size());
-	R = R ^ G(K, (L || 0) * W, R.size());
-	Hval = H(K, (R || 1), min(b, L.size()));
+	L = L ^ G.evaluate(keyG, (R || 1) * W, L.size());
+	R = R ^ G.evaluate(keyG, (L || 0) * W, R.size());
+	Hval = H.evaluate(keyH, (R || 1), min(b, L.size()));
 	L = L ^ (Hval || BitString::zeroes(L.size() - Hval.size()));
 	return L || R;
 }
 
-BitString FarfalleWBC::decipher(const BitString &K, const BitString &W, const BitString &C) const
+BitString FarfalleWBC::decipher(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &W, const BitString &C) const
 {
 	unsigned int b = H.width();
 
@@ -285,15 +769,88 @@ BitString FarfalleWBC::decipher(const BitString &K, const BitString &W, const Bi
 	BitString L = BitString::substring(C, 0, n_L);
 	BitString R = BitString::substring(C, n_L, n_R);
 
-	BitString Hval = H(K, (R || 1), min(b, L.size()));
+	BitString Hval = H.evaluate(keyH, (R || 1), min(b, L.size()));
 	L = L ^ (Hval || BitString::zeroes(L.size() - Hval.size()));
-	R = R ^ G(K, (L || 0) * W, R.size());
-	L = L ^ G(K, (R || 1) * W, L.size());
-	Hval = H(K, (L || 0), min(b, R.size()));
+	R = R ^ G.evaluate(keyG, (L || 0) * W, R.size());
+	L = L ^ G.evaluate(keyG, (R || 1) * W, L.size());
+	Hval = H.evaluate(keyH, (L || 0), min(b, R.size()));
 	R = R ^ (Hval || BitString::zeroes(R.size() - Hval.size()));
 	return L || R;
 }
 
+size_t FarfalleWBC::splitBytes(size_t length) const
+{
+	if (length > 0xFFFFFFFF / 8) throw Exception("The block is too long for the in-place interface");
+	if ((l % 8) != 0) throw Exception("The in-place interface requires l to be a multiple of 8");
+
+	unsigned int n_L = split((unsigned int)length * 8);
+	if ((n_L % 8) != 0) throw Exception("The parts of the block must be byte-aligned");
+	return n_L / 8;
+}
+
+void FarfalleWBC::addEvaluation(const Farfalle &F, const FarfalleState &key, const UINT8 *X, size_t length, UINT8 delimitedSuffix,
+                                const BitString *W, UINT8 *Z, unsigned int n)
+{
+	FarfalleState state = key;
+	if (W != 0)
+	{
+		F.absorb(state, *W);
+	}
+	F.absorb(state, X, length, delimitedSuffix);
+	F.addOutput(state, Z, n);
+}
+
+void FarfalleWBC::encipher(const BitString &K, const BitString &W, UINT8 *block, size_t length) const
+{
+	encipher(H.initialize(K), G.initialize(K), W, block, length);
+}
+
+void FarfalleWBC::decipher(const BitString &K, const BitString &W, UINT8 *block, size_t length) const
+{
+	decipher(H.initialize(K), G.initialize(K), W, block, length);
+}
+
+void FarfalleWBC::encipher(const shared_ptr<const FarfalleKeyContext> &key, const BitString &W, UINT8 *block, size_t length) const
+{
+	encipher(H.initialize(key), G.initialize(key), W, block, length);
+}
+
+void FarfalleWBC::decipher(const shared_ptr<const FarfalleKeyContext> &key, const BitString &W, UINT8 *block, size_t length) const
+{
+	decipher(H.initialize(key), G.initialize(key), W, block, length);
+}
+
+// The delimited suffixes 0x02 and 0x03 append the bits 0 and 1, as L || 0 and R || 1 in the BitString interface.
+void FarfalleWBC::encipher(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &W, UINT8 *block, size_t length) const
+{
+	unsigned int b = H.width();
+
+	size_t lengthL = splitBytes(length);
+	size_t lengthR = length - lengthL;
+	UINT8 *L = block;
+	UINT8 *R = block + lengthL;
+
+	addEvaluation(H, keyH, L, lengthL, 0x02, 0, R, min(b, (unsigned int)lengthR * 8));
+	addEvaluation(G, keyG, R, lengthR, 0x03, &W, L, (unsigned int)lengthL * 8);
+	addEvaluation(G, keyG, L, lengthL, 0x02, &W, R, (unsigned int)lengthR * 8);
+	addEvaluation(H, keyH, R, lengthR, 0x03, 0, L, min(b, (unsigned int)lengthL * 8));
+}
+
+void FarfalleWBC::decipher(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &W, UINT8 *block, size_t length) const
+{
+	unsigned int b = H.width();
+
+	size_t lengthL = splitBytes(length);
+	size_t lengthR = length - lengthL;
+	UINT8 *L = block;
+	UINT8 *R = block + lengthL;
+
+	addEvaluation(H, keyH, R, lengthR, 0x03, 0, L, min(b, (unsigned int)lengthL * 8));
+	addEvaluation(G, keyG, L, lengthL, 0x02, &W, R, (unsigned int)lengthR * 8);
+	addEvaluation(G, keyG, R, lengthR, 0x03, &W, L, (unsigned int)lengthL * 8);
+	addEvaluation(H, keyH, L, lengthL, 0x02, 0, R, min(b, (unsigned int)lengthR * 8));
+}
+
 /* Farfalle-WBC-AE */
 FarfalleWBCAE::FarfalleWBCAE(const Farfalle  &H,
                              const Farfalle  &G,
@@ -309,7 +866,23 @@ BitString FarfalleWBCAE::wrap(const BitString &K, const BitString &A, const BitS
 	return encipher(K, A, Pp);
 }
 
+BitString FarfalleWBCAE::wrap(const shared_ptr<const FarfalleKeyContext> &key, const BitString &A, const BitString &P) const
+{
+	BitString Pp = P || BitString::zeroes(t);
+	return encipher(key, A, Pp);
+}
+
 BitString FarfalleWBCAE::unwrap(const BitString &K, const BitString &A, const BitString &C) const
+{
+	return unwrap(H.initialize(K), G.initialize(K), A, C);
+}
+
+BitString FarfalleWBCAE::unwrap(const shared_ptr<const FarfalleKeyContext> &key, const BitString &A, const BitString &C) const
+{
+	return unwrap(H.initialize(key), G.initialize(key), A, C);
+}
+
+BitString FarfalleWBCAE::unwrap(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &A, const BitString &C) const
 {
 	unsigned int b = H.width();
 
@@ -318,21 +891,21 @@ BitString FarfalleWBCAE::unwrap(const BitString &K, const BitString &A, const Bi
 	BitString L = BitString::substring(C, 0, n_L);
 	BitString R = BitString::substring(C, n_L, n_R);
 
-	BitString Hval = H(K, (R || 1), min(b, L.size()));
+	BitString Hval = H.evaluate(keyH, (R || 1), min(b, L.size()));
 	L = L ^ (Hval || BitString::zeroes(L.size() - Hval.size()));
-	R = R ^ G(K, (L || 0) * A, R.size());
+	R = R ^ G.evaluate(keyG, (L || 0) * A, R.size());
 
 	if (R.size() >= b + t)
 	{
 		if (!(BitString::substring(R, R.size() - t, t) == BitString::zeroes(t))) throw Exception("error!");
-		L = L ^ G(K, (R || 1) * A, L.size());
-		Hval = H(K, (L || 0), b);
+		L = L ^ G.evaluate(keyG, (R || 1) * A, L.size());
+		Hval = H.evaluate(keyH, (L || 0), b);
 		R = R ^ (Hval || BitString::zeroes(R.size() - Hval.size()));
 	}
 	else
 	{
-		L = L ^ G(K, (R || 1) * A, L.size());
-		Hval = H(K, (L || 0), min(b, R.size()));
+		L = L ^ G.evaluate(keyG, (R || 1) * A, L.size());
+		Hval = H.evaluate(keyH, (L || 0), min(b, R.size()));
 		R = R ^ (Hval || BitString::zeroes(R.size() - Hval.size()));
 		if (!(BitString::substring(L || R, C.size() - t, t) == BitString::zeroes(t))) throw Exception("error!");
 	}
@@ -340,3 +913,82 @@ BitString FarfalleWBCAE::unwrap(const BitString &K, const BitString &A, const Bi
 	BitString Pp = L || R;
 	return Pp.truncate(C.size() - t);
 }
+
+size_t FarfalleWBCAE::wrap(const BitString &K, const BitString &A, UINT8 *buffer, size_t length) const
+{
+	if ((t % 8) != 0) throw Exception("The in-place interface requires t to be a multiple of 8");
+
+	memset(buffer + length, 0, t / 8);
+	encipher(K, A, buffer, length + t / 8);
+	return length + t / 8;
+}
+
+size_t FarfalleWBCAE::wrap(const shared_ptr<const FarfalleKeyContext> &key, const BitString &A, UINT8 *buffer, size_t length) const
+{
+	if ((t % 8) != 0) throw Exception("The in-place interface requires t to be a multiple of 8");
+
+	memset(buffer + length, 0, t / 8);
+	encipher(key, A, buffer, length + t / 8);
+	return length + t / 8;
+}
+
+size_t FarfalleWBCAE::unwrap(const BitString &K, const BitString &A, UINT8 *buffer, size_t length) const
+{
+	return unwrap(H.initialize(K), G.initialize(K), A, buffer, length);
+}
+
+size_t FarfalleWBCAE::unwrap(const shared_ptr<const FarfalleKeyContext> &key, const BitString &A, UINT8 *buffer, size_t length) const
+{
+	return unwrap(H.initialize(key), G.initialize(key), A, buffer, length);
+}
+
+/** Returns whether the length bytes at data are all zero. */
+static bool isZero(const UINT8 *data, size_t length)
+{
+	UINT8 acc = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		acc |= data[i];
+	}
+	return acc == 0;
+}
+
+size_t FarfalleWBCAE::unwrap(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &A, UINT8 *buffer, size_t length) const
+{
+	if ((t % 8) != 0) throw Exception("The in-place interface requires t to be a multiple of 8");
+	if (length < t / 8) throw Exception("error!");
+
+	unsigned int b = H.width();
+
+	size_t lengthL = splitBytes(length);
+	size_t lengthR = length - lengthL;
+	UINT8 *L = buffer;
+	UINT8 *R = buffer + lengthL;
+
+	addEvaluation(H, keyH, R, lengthR, 0x03, 0, L, min(b, (unsigned int)lengthL * 8));
+	addEvaluation(G, keyG, L, lengthL, 0x02, &A, R, (unsigned int)lengthR * 8);
+
+	bool valid;
+	if (lengthR * 8 >= b + t)
+	{
+		// The redundancy is at the end of R, so an invalid ciphertext is rejected before the second half of the rounds
+		valid = isZero(R + lengthR - t / 8, t / 8);
+		if (valid)
+		{
+			addEvaluation(G, keyG, R, lengthR, 0x03, &A, L, (unsigned int)lengthL * 8);
+			addEvaluation(H, keyH, L, lengthL, 0x02, 0, R, b);
+		}
+	}
+	else
+	{
+		addEvaluation(G, keyG, R, lengthR, 0x03, &A, L, (unsigned int)lengthL * 8);
+		addEvaluation(H, keyH, L, lengthL, 0x02, 0, R, min(b, (unsigned int)lengthR * 8));
+		valid = isZero(buffer + length - t / 8, t / 8);
+	}
+	if (!valid)
+	{
+		memset(buffer, 0, length);
+		throw Exception("error!");
+	}
+	return length - t / 8;
+}
@@ -16,7 +16,12 @@
 #define _FARFALLE_H_
 
 #include <iostream>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "bitstring.h"
 #include "transformations.h"
@@ -35,6 +40,10 @@ class BaseIterableTransformation
 		BaseIterableTransformation(unsigned int width, unsigned int rounds) : width(width), rounds(rounds) {}
 
 		virtual BitString operator()(const BitString &state) const = 0;
+		/** Applies the transformation in place onto a state of width/8 bytes, by default through operator(). */
+		virtual void applyInPlace(UINT8 *state) const;
+		/** Applies the transformation onto count states of width/8 bytes stored one after the other, by default with applyInPlace(). */
+		virtual void applyBatch(UINT8 *states, unsigned int count) const;
 };
 
 template<class T>
@@ -53,21 +62,72 @@ class IterableTransformation : public BaseIterableTransformation
 			f(state2.array());
 			return state2;
 		}
+
+		/** Applies f directly onto the bytes of the state, with no BitString copy. */
+		void applyInPlace(UINT8 *state) const
+		{
+			f(state);
+		}
+
+		void applyBatch(UINT8 *states, unsigned int count) const
+		{
+			f.applyBatch(states, count);
+		}
 };
 
 /**
  * Class implementing a rolling function
+ * operator()(k, i) must be equal to i iterations of operator()(., 1) from k,
+ * so that consecutive masks can be derived from one another.
  */
 class BaseRollingFunction
 {
 	public:
 		virtual BitString operator()(const BitString &k, unsigned int i) const = 0;
+		/** Rolls the width-bit state k, stored as 64-bit lanes, i times in place. */
+		virtual void rollInPlace(UINT64 *k, unsigned int width, unsigned int i) const;
 };
 
 class IdentityRollingFunction : public BaseRollingFunction
 {
 	public:
 		BitString operator()(const BitString &k, unsigned int i) const;
+		void rollInPlace(UINT64 *k, unsigned int width, unsigned int i) const;
+};
+
+/**
+ * Structure holding what Farfalle derives from a key alone, see Farfalle::prepareKey(),
+ * so that the operations with the same key skip the key setup:
+ * the masked key k and the first rolled compression masks roll_c(k, i),
+ * from which the masks of the first input blocks and k' = roll_c(k, I) are copied instead of rolled.
+ */
+struct FarfalleKeyContext
+{
+	/** The masked key k = p_b(K || 10*) */
+	BitString                         k;
+	/** The masks roll_c(k, i) for i from 0 to nrMasks - 1, each as wordsPerMask 64-bit words */
+	vector<UINT64>                    masks;
+	unsigned int                      nrMasks;
+	unsigned int                      wordsPerMask;
+	/** The permutation and rolling function the context was prepared with, checked by Farfalle::initialize() */
+	const BaseIterableTransformation *p_b;
+	const BaseRollingFunction        *roll_c;
+};
+
+/**
+ * Structure holding the state of Farfalle after the key and some input strings,
+ * which further strings can be added to with Farfalle::absorb()
+ */
+struct FarfalleState
+{
+	/** The masked key k = p_b(K || 10*) */
+	BitString    k;
+	/** The accumulator x of the compression layer */
+	BitString    x;
+	/** The index of the mask of the next input block */
+	unsigned int I;
+	/** The key context the state was initialized from, if any */
+	shared_ptr<const FarfalleKeyContext> key;
 };
 
 /**
@@ -82,11 +142,78 @@ class Farfalle
 		BaseIterableTransformation &p_e;
 		BaseRollingFunction        &roll_c;
 		BaseRollingFunction        &roll_e;
+		unsigned int                nrThreads;
+
+		/** Absorbs the mu blocks of b bits at blocks, with mask indexes starting at I, into the accumulator x. */
+		void          compress(const FarfalleState &state, const UINT8 *blocks, unsigned int I, unsigned int mu, BitString &x) const;
+		/** Writes roll_c(k, i) as 64-bit words into mask, from the key context of the state if it has one. */
+		void          getCompressionMask(const FarfalleState &state, unsigned int i, UINT64 *mask) const;
+		/** Writes the n bits of output, starting at bit q, of the expansion of y masked with kp into Z, or XORs them into Z if add is set. */
+		void          expand(const BitString &y, const BitString &kp, UINT8 *Z, unsigned int n, unsigned int q, bool add = false) const;
+		/** Returns the number of threads to use for count states. */
+		unsigned int  numberOfWorkers(unsigned int count) const;
 
 	public:
 		Farfalle(BaseIterableTransformation &p_b, BaseIterableTransformation &p_c, BaseIterableTransformation &p_d, BaseIterableTransformation &p_e, BaseRollingFunction &roll_c, BaseRollingFunction &roll_e);
 		BitString     operator()(const BitString &K, const BitStrings &Mseq, unsigned int n, unsigned int q = 0) const;
+		/** Same as above, but writes the n bits of output into the (n+7)/8 bytes of Z, with the unused bits of the last byte set to zero. */
+		void          operator()(const BitString &K, const BitStrings &Mseq, UINT8 *Z, unsigned int n, unsigned int q = 0) const;
+		/** Same as above, with the key setup taken from a context returned by prepareKey(). */
+		BitString     operator()(const shared_ptr<const FarfalleKeyContext> &key, const BitStrings &Mseq, unsigned int n, unsigned int q = 0) const;
+		void          operator()(const shared_ptr<const FarfalleKeyContext> &key, const BitStrings &Mseq, UINT8 *Z, unsigned int n, unsigned int q = 0) const;
+		/** Returns the n bits of output starting at bit q after the input strings Mseq are added to a copy of the state. */
+		BitString     evaluate(const FarfalleState &state, const BitStrings &Mseq, unsigned int n, unsigned int q = 0) const;
+		/** Derives once what depends only on the key K, i.e., k and the first nrMasks compression masks. */
+		shared_ptr<const FarfalleKeyContext> prepareKey(const BitString &K, unsigned int nrMasks = 32) const;
+		/** Returns the state with the key K and no input strings yet. */
+		FarfalleState initialize(const BitString &K) const;
+		/** Same as above, from a context prepared by an instance with the same p_b and roll_c. */
+		FarfalleState initialize(const shared_ptr<const FarfalleKeyContext> &key) const;
+		/** Adds the input string M after those already in the state, compressing only M. */
+		void          absorb(FarfalleState &state, const BitString &M) const;
+		/** Same as above, with M given as the length bytes at M followed by the 0 to 7 bits of delimitedSuffix before its delimiter bit,
+		  * as in Duplex::duplexingBytes(); the whole blocks are compressed directly from the caller's buffer. */
+		void          absorb(FarfalleState &state, const UINT8 *M, size_t length, UINT8 delimitedSuffix = 0x01) const;
+		/** Returns the n bits of output starting at bit q for the key and the input strings in the state. */
+		BitString     output(const FarfalleState &state, unsigned int n, unsigned int q = 0) const;
+		/** Same as above, but writes the output into the (n+7)/8 bytes of Z, as operator() does. */
+		void          output(const FarfalleState &state, UINT8 *Z, unsigned int n, unsigned int q = 0) const;
+		/** Same as above, but XORs the n bits of output into the first n bits of Z, leaving the other bits of Z unchanged. */
+		void          addOutput(const FarfalleState &state, UINT8 *Z, unsigned int n, unsigned int q = 0) const;
 		unsigned int  width() const;
+		/** Sets the maximum number of threads used on long inputs, 0 (the default) for the number of hardware threads. */
+		void          setNumberOfThreads(unsigned int aNrThreads);
+};
+
+/**
+ * Class implementing a pool of key contexts for one instance of Farfalle,
+ * for applications that switch between many keys, e.g., one per tenant:
+ * get() returns the context of a key, prepared on first use, and the pool
+ * keeps at most capacity contexts, evicting the least recently used one.
+ * It can be used from several threads at once.
+ */
+class FarfalleKeyContextPool
+{
+	protected:
+		typedef list<pair<string, shared_ptr<const FarfalleKeyContext> > > ContextList;
+
+		Farfalle                                         F;
+		const unsigned int                               capacity;
+		const unsigned int                               nrMasks;
+		mutex                                            lock;
+		/** The contexts, the most recently used first */
+		ContextList                                      contexts;
+		unordered_map<string, ContextList::iterator>     index;
+
+		static string identify(const BitString &K);
+
+	public:
+		FarfalleKeyContextPool(const Farfalle &F, unsigned int capacity = 1024, unsigned int nrMasks = 32);
+		/** Returns the context of the key K, see Farfalle::prepareKey(). */
+		shared_ptr<const FarfalleKeyContext>  get(const BitString &K);
+		/** Removes the context of the key K, if any; the operations still holding it are not affected. */
+		void                                  remove(const BitString &K);
+		unsigned int                          size();
 };
 
 /**
@@ -98,13 +225,15 @@ class FarfalleSANE
 		Farfalle           F;
 		const unsigned int t;
 		const unsigned int l;
-		BitString          K;
-		BitStrings         history;
+		FarfalleState      history;
 		unsigned int       offset;
 		unsigned int       e;
 
+		void                        start(const BitString &N, BitString &T, bool sender);
+
 	public:
 		FarfalleSANE(const Farfalle &F, unsigned int t, unsigned int l, const BitString &K, const BitString &N, BitString &T, bool sender);
+		FarfalleSANE(const Farfalle &F, unsigned int t, unsigned int l, const shared_ptr<const FarfalleKeyContext> &key, const BitString &N, BitString &T, bool sender);
 		pair<BitString, BitString>  wrap(const BitString &A, const BitString &P);
 		BitString                   unwrap(const BitString &A, const BitString &C, const BitString &T);
 };
@@ -117,12 +246,12 @@ class FarfalleSANSE
 	private:
 		Farfalle           F;
 		const unsigned int t;
-		BitString          K;
-		BitStrings         history;
+		FarfalleState      history;
 		unsigned int       e;
 
 	public:
 		FarfalleSANSE(const Farfalle &F, unsigned int t, const BitString &K);
+		FarfalleSANSE(const Farfalle &F, unsigned int t, const shared_ptr<const FarfalleKeyContext> &key);
 		pair<BitString, BitString>  wrap(const BitString &A, const BitString &P);
 		BitString                   unwrap(const BitString &A, const BitString &C, const BitString &T);
 };
@@ -138,11 +267,35 @@ class FarfalleWBC
 		const unsigned int l;
 
 		unsigned int split(unsigned int n) const;
+		/** Enciphers and deciphers with H and G in the given states after the key. */
+		BitString  encipher(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &W, const BitString &P) const;
+		BitString  decipher(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &W, const BitString &C) const;
+		/** Same as above, in place on the length bytes of block. */
+		void       encipher(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &W, UINT8 *block, size_t length) const;
+		void       decipher(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &W, UINT8 *block, size_t length) const;
+		/** Returns the length in bytes of the left part of a block of length bytes, checking that the parts are byte-aligned. */
+		size_t     splitBytes(size_t length) const;
+		/** XORs into the n first bits of Z the output of F after the key for the input strings W if not null, then X || suffix,
+		  * with X given as the length bytes at X and the suffix as in Farfalle::absorb(). */
+		static void addEvaluation(const Farfalle &F, const FarfalleState &key, const UINT8 *X, size_t length, UINT8 delimitedSuffix,
+		                          const BitString *W, UINT8 *Z, unsigned int n);
 
 	public:
 		FarfalleWBC(const Farfalle &H, const Farfalle &G, unsigned int l);
 		BitString  encipher(const BitString &K, const BitString &W, const BitString &P) const;
 		BitString  decipher(const BitString &K, const BitString &W, const BitString &C) const;
+		/** Same as above, with the key setup taken from a context valid for both H and G. */
+		BitString  encipher(const shared_ptr<const FarfalleKeyContext> &key, const BitString &W, const BitString &P) const;
+		BitString  decipher(const shared_ptr<const FarfalleKeyContext> &key, const BitString &W, const BitString &C) const;
+		/**
+		 * Same as above, in place on the length bytes of the caller's buffer block, for l a multiple of 8.
+		 * The long branch goes through the compression and expansion layers of H and G directly from and into block,
+		 * so that, unlike the BitString interface, no copy of the block or of its halves is made.
+		 */
+		void       encipher(const BitString &K, const BitString &W, UINT8 *block, size_t length) const;
+		void       decipher(const BitString &K, const BitString &W, UINT8 *block, size_t length) const;
+		void       encipher(const shared_ptr<const FarfalleKeyContext> &key, const BitString &W, UINT8 *block, size_t length) const;
+		void       decipher(const shared_ptr<const FarfalleKeyContext> &key, const BitString &W, UINT8 *block, size_t length) const;
 };
 
 /**
@@ -153,10 +306,25 @@ class FarfalleWBCAE : public FarfalleWBC
 	private:
 		const unsigned int t;
 
+		BitString  unwrap(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &A, const BitString &C) const;
+		size_t     unwrap(const FarfalleState &keyH, const FarfalleState &keyG, const BitString &A, UINT8 *buffer, size_t length) const;
+
 	public:
 		FarfalleWBCAE(const Farfalle &H, const Farfalle &G, unsigned int t, unsigned int l);
 		BitString  wrap(const BitString &K, const BitString &A, const BitString &P) const;
 		BitString  unwrap(const BitString &K, const BitString &A, const BitString &C) const;
+		BitString  wrap(const shared_ptr<const FarfalleKeyContext> &key, const BitString &A, const BitString &P) const;
+		BitString  unwrap(const shared_ptr<const FarfalleKeyContext> &key, const BitString &A, const BitString &C) const;
+		/**
+		 * Same as above, in place on the caller's buffer, for l and t multiples of 8, see FarfalleWBC::encipher().
+		 * wrap() enciphers the length bytes of plaintext at buffer, which must have room for t/8 more bytes,
+		 * and returns the length of the ciphertext; unwrap() deciphers the length bytes of ciphertext at buffer
+		 * and returns the length of the plaintext, or throws an exception with the buffer zeroed if the ciphertext is invalid.
+		 */
+		size_t     wrap(const BitString &K, const BitString &A, UINT8 *buffer, size_t length) const;
+		size_t     unwrap(const BitString &K, const BitString &A, UINT8 *buffer, size_t length) const;
+		size_t     wrap(const shared_ptr<const FarfalleKeyContext> &key, const BitString &A, UINT8 *buffer, size_t length) const;
+		size_t     unwrap(const shared_ptr<const FarfalleKeyContext> &key, const BitString &A, UINT8 *buffer, size_t length) const;
 };
 
 #endif
@@ -13,11 +13,21 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
 #include <sstream>
+#include <string.h>
 #include "Keccak-f.h"
 
 using namespace std;
 
+/** Returns whether the platform stores integers in little-endian order,
+  * in which case the 8 bytes of a 64-bit lane, in the order of the state, are the lane itself. */
+static inline bool isLittleEndian()
+{
+    const UINT64 one = 1;
+    return *(const UINT8 *)&one == 1;
+}
+
 KeccakF::KeccakF(unsigned int aWidth, int aStartRoundIndex, unsigned int aNrRounds)
 {
     width = aWidth;
@@ -26,8 +36,10 @@ KeccakF::KeccakF(unsigned int aWidth, int aStartRoundIndex, unsigned int aNrRoun
     nrRounds = aNrRounds;
     startRoundIndex = aStartRoundIndex;
     mask = (LaneValue(~0)) >> (64-laneSize);
+    laneComplementing = false;
     initializeRhoOffsets();
     initializeRoundConstants();
+    initializeInverseTheta();
 }
 
 KeccakF::KeccakF(unsigned int aWidth)
@@ -38,8 +50,10 @@ KeccakF::KeccakF(unsigned int aWidth)
     nrRounds = nominalNrRounds;
     startRoundIndex = 0;
     mask = (LaneValue(~0)) >> (64-laneSize);
+    laneComplementing = false;
     initializeRhoOffsets();
     initializeRoundConstants();
+    initializeInverseTheta();
 }
 
 void KeccakF::initializeNominalNumberOfRounds()
@@ -140,10 +154,17 @@ void KeccakF::ROL(LaneValue& L, int offset) const
 void KeccakF::fromBytesToLanes(const UINT8 *in, vector<LaneValue>& out) const
 {
     out.resize(25);
+    fromBytesToLanes(in, &out[0]);
+}
+
+void KeccakF::fromBytesToLanes(const UINT8 *in, LaneValue *out) const
+{
     if ((laneSize == 1) || (laneSize == 2) || (laneSize == 4) || (laneSize == 8)) {
         for(unsigned int i=0; i<25; i++)
             out[i] = (in[i*laneSize/8] >> ((i*laneSize) % 8)) & mask;
     }
+    else if ((laneSize == 64) && isLittleEndian())
+        memcpy(out, in, 25*8);
     else if ((laneSize == 16) || (laneSize == 32) || (laneSize == 64)) {
         for(unsigned int i=0; i<25; i++) {
             out[i] = 0;
@@ -154,6 +175,11 @@ void KeccakF::fromBytesToLanes(const UINT8 *in, vector<LaneValue>& out) const
 }
 
 void KeccakF::fromLanesToBytes(const vector<LaneValue>& in, UINT8 *out) const
+{
+    fromLanesToBytes(&in[0], out);
+}
+
+void KeccakF::fromLanesToBytes(const LaneValue *in, UINT8 *out) const
 {
     if ((laneSize == 1) || (laneSize == 2) || (laneSize == 4) || (laneSize == 8)) {
         for(unsigned int i=0; i<(25*laneSize+7)/8; i++)
@@ -161,6 +187,8 @@ void KeccakF::fromLanesToBytes(const vector<LaneValue>& in, UINT8 *out) const
         for(unsigned int i=0; i<25; i++)
             out[i*laneSize/8] |= in[i] << ((i*laneSize) % 8);
     }
+    else if ((laneSize == 64) && isLittleEndian())
+        memcpy(out, in, 25*8);
     else if ((laneSize == 16) || (laneSize == 32) || (laneSize == 64)) {
         for(unsigned int i=0; i<25; i++)
             for(unsigned int j=0; j<(laneSize/8); j++)
@@ -170,20 +198,342 @@ void KeccakF::fromLanesToBytes(const vector<LaneValue>& in, UINT8 *out) const
 
 void KeccakF::operator()(UINT8 * state) const
 {
-    vector<LaneValue> A(25);
+    LaneValue A[25];
+    fromBytesToLanes(state, A);
+    forwardOnLanes(A);
+    fromLanesToBytes(A, state);
+}
+
+void KeccakF::forward(vector<LaneValue>& state) const
+{
+    forwardOnLanes(&state[0]);
+}
+
+void KeccakF::forwardOnLanes(LaneValue *A) const
+{
+    forwardOnLanes(A, nrRounds);
+}
+
+void KeccakF::forwardOnLanes(LaneValue *A, unsigned int aNrRounds) const
+{
+    int endRoundIndex = startRoundIndex + (int)nrRounds;
+    if (laneComplementing) {
+        complementLanes(A);
+        for(int i=endRoundIndex-(int)aNrRounds; i<endRoundIndex; i++)
+            roundOnComplementedLanes(A, i);
+        complementLanes(A);
+    }
+    else
+        for(int i=endRoundIndex-(int)aNrRounds; i<endRoundIndex; i++)
+            roundOnLanes(A, i);
+}
+
+void KeccakF::applyRounds(UINT8 * state, unsigned int aNrRounds) const
+{
+    LaneValue A[25];
     fromBytesToLanes(state, A);
-    forward(A);
+    forwardOnLanes(A, aNrRounds);
     fromLanesToBytes(A, state);
 }
 
+void KeccakF::sweepRounds(UINT8 * states) const
+{
+    unsigned int stateSize = (width+7)/8;
+    LaneValue A[25];
+    fromBytesToLanes(states, A);
+    for(unsigned int i=0; i<nrRounds; i++) {
+        roundOnLanes(A, startRoundIndex + (int)i);
+        fromLanesToBytes(A, states + (i+1)*stateSize);
+    }
+}
+
+void KeccakF::thetaRhoPiOnLanes(LaneValue *A, LaneValue *B) const
+{
+    LaneValue C[5], D[5];
+
+    // θ
+    for(unsigned int x=0; x<5; x++)
+        C[x] = A[x] ^ A[x+5] ^ A[x+10] ^ A[x+15] ^ A[x+20];
+    for(unsigned int x=0; x<5; x++)
+        D[x] = rotateLane(C[(x+1)%5], 1%laneSize) ^ C[(x+4)%5];
+    for(unsigned int y=0; y<25; y+=5)
+        for(unsigned int x=0; x<5; x++)
+            A[x+y] ^= D[x];
+
+    // ρ and π
+    for(unsigned int i=0; i<25; i++)
+        B[i] = rotateLane(A[rhoPiSource[i]], rhoPiOffset[i]);
+}
+
+void KeccakF::roundOnLanes(LaneValue *A, int roundIndex) const
+{
+    LaneValue B[25];
+
+    thetaRhoPiOnLanes(A, B);
+
+    // χ
+    for(unsigned int y=0; y<25; y+=5)
+        for(unsigned int x=0; x<5; x++)
+            A[x+y] = B[x+y] ^ ((~B[(x+1)%5+y]) & B[(x+2)%5+y]);
+
+    // ι
+    A[0] ^= getRoundConstant(roundIndex);
+}
+
+// The lanes complemented at the input of θ and at the input of χ, respectively,
+// when using the lane complementing transform, see "Keccak implementation overview",
+// Section "The lane complementing transform", and KeccakFCodeGen::genMacroFile().
+static const UINT32 laneComplementingMask = 0x121106;
+static const UINT32 laneComplementingInChiMask = 0x9d14ad;
+
+/**
+  * χ on lanes complemented according to laneComplementingInChiMask, giving lanes
+  * complemented according to laneComplementingMask, for the lanes from index @a i on.
+  * The choice between AND and OR and the complemented operands are resolved
+  * at compile time, so that each row needs at most one complementation.
+  */
+template<unsigned int i>
+struct ChiOnComplementedLanes {
+    static inline void apply(LaneValue *A, const LaneValue *B, LaneValue mask)
+    {
+        const unsigned int x = i%5, y = i/5;
+        const bool M0 = (((laneComplementingMask ^ laneComplementingInChiMask) >> i) & 1) == 1;
+        const bool M1 = ((laneComplementingInChiMask >> ((x+1)%5 + 5*y)) & 1) == 1;
+        const bool M2 = ((laneComplementingInChiMask >> ((x+2)%5 + 5*y)) & 1) == 1;
+        const bool LC1 = (M1 == M2) && (M0 == M1);
+        const bool LC2 = (M1 == M2) && (M0 != M1);
+        const bool LOR = ((!M1) && M2) || (M0 && (M1 == M2));
+        const bool LC0 = (!LOR) == M0;
+        LaneValue B0 = B[i], B1 = B[(x+1)%5 + 5*y], B2 = B[(x+2)%5 + 5*y];
+        if (LC0) B0 ^= mask;
+        if (LC1) B1 ^= mask;
+        if (LC2) B2 ^= mask;
+        A[i] = B0 ^ (LOR ? (B1 | B2) : (B1 & B2));
+        ChiOnComplementedLanes<i+1>::apply(A, B, mask);
+    }
+};
+
+template<>
+struct ChiOnComplementedLanes<25> {
+    static inline void apply(LaneValue *, const LaneValue *, LaneValue) {}
+};
+
+void KeccakF::roundOnComplementedLanes(LaneValue *A, int roundIndex) const
+{
+    LaneValue B[25];
+
+    thetaRhoPiOnLanes(A, B);
+
+    // χ
+    ChiOnComplementedLanes<0>::apply(A, B, mask);
+
+    // ι
+    A[0] ^= getRoundConstant(roundIndex);
+}
+
+void KeccakF::complementLanes(LaneValue *A) const
+{
+    for(unsigned int i=0; i<25; i++)
+        if ((laneComplementingMask >> i) & 1)
+            A[i] ^= mask;
+}
+
+void KeccakF::setLaneComplementing(bool aLaneComplementing)
+{
+    laneComplementing = aLaneComplementing;
+}
+
+bool KeccakF::getLaneComplementing() const
+{
+    return laneComplementing;
+}
+
+const unsigned int KeccakF::batchSize;
+
+void KeccakF::applyBatch(UINT8 * states, unsigned int count) const
+{
+    applyBatch(states, count, 0);
+}
+
+void KeccakF::applyBatch(UINT8 * states, unsigned int count, const unsigned int *lanePosition) const
+{
+    unsigned int stateSize = (width+7)/8;
+    // Groups of batchSize states, then a smaller group for the remaining ones (e.g., the 2 or 4 pistons of Keyak)
+    for(unsigned int first=0; first<count; ) {
+        unsigned int n = min(batchSize, count-first);
+        if (n > 4)
+            applyGroup<batchSize>(states + first*stateSize, n, lanePosition);
+        else if (n > 2)
+            applyGroup<4>(states + first*stateSize, n, lanePosition);
+        else if (n == 2)
+            applyGroup<2>(states + first*stateSize, n, lanePosition);
+        else
+            applyGroup<1>(states + first*stateSize, n, lanePosition);
+        first += n;
+    }
+}
+
+template<unsigned int P>
+void KeccakF::applyGroup(UINT8 * states, unsigned int n, const unsigned int *lanePosition) const
+{
+    unsigned int stateSize = (width+7)/8;
+    LaneValue a[25], A[25*P];
+    for(unsigned int k=0; k<P; k++) {
+        if (k < n)
+            fromBytesToLanes(states + k*stateSize, a);
+        else
+            memset(a, 0, sizeof(a));
+        for(unsigned int i=0; i<25; i++)
+            A[(lanePosition ? lanePosition[i] : i)*P+k] = a[i];
+    }
+    for(int i=startRoundIndex; i<startRoundIndex+(int)nrRounds; i++)
+        roundOnLaneGroup<P>(A, i);
+    for(unsigned int k=0; k<n; k++) {
+        for(unsigned int i=0; i<25; i++)
+            a[i] = A[(lanePosition ? lanePosition[i] : i)*P+k];
+        fromLanesToBytes(a, states + k*stateSize);
+    }
+}
+
+void KeccakF::forwardOnLaneBatch(LaneValue *A) const
+{
+    for(int i=startRoundIndex; i<startRoundIndex+(int)nrRounds; i++)
+        roundOnLaneGroup<batchSize>(A, i);
+}
+
+void KeccakF::roundOnLaneBatch(LaneValue *A, int roundIndex) const
+{
+    roundOnLaneGroup<batchSize>(A, roundIndex);
+}
+
+template<unsigned int P>
+void KeccakF::roundOnLaneGroup(LaneValue *A, int roundIndex) const
+{
+    LaneValue B[25*P], C[5*P], D[5*P];
+
+    // θ
+    for(unsigned int x=0; x<5; x++)
+        for(unsigned int k=0; k<P; k++)
+            C[x*P+k] = A[x*P+k] ^ A[(x+5)*P+k]
+                ^ A[(x+10)*P+k] ^ A[(x+15)*P+k] ^ A[(x+20)*P+k];
+    for(unsigned int x=0; x<5; x++)
+        for(unsigned int k=0; k<P; k++)
+            D[x*P+k] = rotateLane(C[((x+1)%5)*P+k], 1%laneSize) ^ C[((x+4)%5)*P+k];
+    for(unsigned int i=0; i<25; i++)
+        for(unsigned int k=0; k<P; k++)
+            A[i*P+k] ^= D[(i%5)*P+k];
+
+    // ρ and π
+    for(unsigned int i=0; i<25; i++) {
+        const LaneValue *source = A + rhoPiSource[i]*P;
+        unsigned int offset = rhoPiOffset[i];
+        if (offset == 0)
+            for(unsigned int k=0; k<P; k++)
+                B[i*P+k] = source[k];
+        else
+            for(unsigned int k=0; k<P; k++)
+                B[i*P+k] = ((source[k] << offset) ^ (source[k] >> (laneSize-offset))) & mask;
+    }
+
+    // χ
+    for(unsigned int y=0; y<25; y+=5)
+        for(unsigned int x=0; x<5; x++)
+            for(unsigned int k=0; k<P; k++)
+                A[(x+y)*P+k] = B[(x+y)*P+k]
+                    ^ ((~B[((x+1)%5+y)*P+k]) & B[((x+2)%5+y)*P+k]);
+
+    // ι
+    LaneValue roundConstant = getRoundConstant(roundIndex);
+    for(unsigned int k=0; k<P; k++)
+        A[k] ^= roundConstant;
+}
+
 void KeccakF::inverse(UINT8 * state) const
 {
-    vector<LaneValue> A(25);
+    LaneValue A[25];
     fromBytesToLanes(state, A);
-    inverse(A);
+    inverseOnLanes(A);
     fromLanesToBytes(A, state);
 }
 
+void KeccakF::inverse(vector<LaneValue>& state) const
+{
+    inverseOnLanes(&state[0]);
+}
+
+void KeccakF::inverseOnLanes(LaneValue *A) const
+{
+    for(int i=startRoundIndex+(int)nrRounds-1; i>=startRoundIndex; i--)
+        inverseRoundOnLanes(A, i);
+}
+
+void KeccakF::inverseRoundOnLanes(LaneValue *A, int roundIndex) const
+{
+    LaneValue B[25], C[5];
+
+    // ι
+    A[0] ^= getRoundConstant(roundIndex);
+
+    // χ^-1, in place
+    for(unsigned int y=0; y<25; y+=5) {
+        for(unsigned int x=0; x<5; x++)
+            C[x] = A[x+y];
+        for(unsigned int x=0; x<6; x++) {
+            unsigned int X = (3*x)%5;
+            A[X+y] = C[X] ^ (A[(X+2)%5+y] & (~C[(X+1)%5]));
+        }
+    }
+
+    // π^-1 and ρ^-1
+    for(unsigned int i=0; i<25; i++)
+        B[rhoPiSource[i]] = rotateLane(A[i], (rhoPiOffset[i] == 0) ? 0 : laneSize-rhoPiOffset[i]);
+
+    // θ^-1
+    inverseThetaOnLanes(B);
+    for(unsigned int i=0; i<25; i++)
+        A[i] = B[i];
+}
+
+void KeccakF::inverseThetaOnLanes(LaneValue *A, bool transposed) const
+{
+    LaneValue C[5], D[5];
+    static const unsigned int modulo5[10] = { 0, 1, 2, 3, 4, 0, 1, 2, 3, 4 };
+
+    // First recover the column parities at the input of θ
+    for(unsigned int x=0; x<5; x++)
+        C[x] = A[x] ^ A[x+5] ^ A[x+10] ^ A[x+15] ^ A[x+20];
+    for(unsigned int i=0; i<inverseThetaNrFactors; i++) {
+        const unsigned int *factor = inverseThetaFactors[i];
+        if (!transposed) {
+            for(unsigned int x=0; x<5; x++)
+                D[x] = C[x] ^ C[modulo5[x+5-factor[0]]] ^ rotateLane(C[modulo5[x+5-factor[2]]], factor[1]);
+        }
+        else {
+            unsigned int offset = (laneSize-factor[1])%laneSize;
+            for(unsigned int x=0; x<5; x++)
+                D[x] = C[x] ^ C[modulo5[x+factor[0]]] ^ rotateLane(C[modulo5[x+factor[2]]], offset);
+        }
+        for(unsigned int x=0; x<5; x++)
+            C[x] = D[x];
+    }
+    for(unsigned int x=0; x<5; x++)
+        D[x] = 0;
+    for(unsigned int j=0; j<5; j++)
+        if ((inverseThetaFinalMask >> j) & 1)
+            for(unsigned int x=0; x<5; x++)
+                D[x] ^= C[transposed ? modulo5[x+j] : modulo5[x+5-j]];
+    // then cancel the effect of θ
+    for(unsigned int x=0; x<5; x++) {
+        if (!transposed)
+            C[x] = rotateLane(D[(x+1)%5], 1%laneSize) ^ D[(x+4)%5];
+        else
+            C[x] = rotateLane(D[(x+4)%5], (laneSize-1)%laneSize) ^ D[(x+1)%5];
+    }
+    for(unsigned int y=0; y<25; y+=5)
+        for(unsigned int x=0; x<5; x++)
+            A[x+y] ^= C[x];
+}
+
 string KeccakF::getDescription() const
 {
     stringstream a;
@@ -253,6 +603,54 @@ void KeccakF::initializeRhoOffsets()
         x = newX;
         y = newY;
     }
+    for(unsigned int x=0; x<5; x++)
+    for(unsigned int y=0; y<5; y++) {
+        unsigned int X, Y;
+        pi(x, y, X, Y);
+        rhoPiSource[index(X,Y)] = index(x,y);
+        rhoPiOffset[index(X,Y)] = rhoOffsets[index(x,y)] % laneSize;
+    }
+}
+
+void KeccakF::initializeInverseTheta()
+{
+    const LaneValue inversePositions64[5] = {
+        0xDE26BC4D789AF134ULL,
+        0x09AF135E26BC4D78ULL,
+        0xEBC4D789AF135E26ULL,
+        0x7135E26BC4D789AFULL,
+        0xCD789AF135E26BC4ULL };
+    for(unsigned int x=0; x<5; x++) {
+        inverseThetaPositions[x] = 0;
+        for(unsigned int z=0; z<64; z+=laneSize)
+            inverseThetaPositions[x] ^= inversePositions64[x] >> z;
+        inverseThetaPositions[x] &= mask;
+    }
+
+    // P^(2^i) = 1 + X^(2^i) + z^(2^i) X^(4*2^i), for i from 0 to m-1
+    unsigned int m = 0;
+    while((1U << m) < laneSize)
+        m++;
+    inverseThetaNrFactors = m;
+    for(unsigned int i=0; i<m; i++) {
+        inverseThetaFactors[i][0] = (1U << i) % 5;
+        inverseThetaFactors[i][1] = (1U << i) % laneSize;
+        inverseThetaFactors[i][2] = (4U << i) % 5;
+    }
+
+    // The inverse of T = P^(2^m) = 1 + X^k + X^(4k) modulo X^5+1, found by exhaustive search
+    const unsigned int k = (1U << m) % 5;
+    const unsigned int T = 1 ^ (1U << k) ^ (1U << ((4*k)%5));
+    for(unsigned int S=1; S<32; S++) {
+        unsigned int product = 0;
+        for(unsigned int j=0; j<5; j++)
+            if ((S >> j) & 1)
+                product ^= ((T << j) | (T >> (5-j))) & 0x1F;
+        if (product == 1) {
+            inverseThetaFinalMask = S;
+            break;
+        }
+    }
 }
 
 string KeccakF::buildBitName(const string& prefixSymbol, unsigned int laneSize, unsigned int z)
@@ -336,22 +734,43 @@ KeccakPStar::KeccakPStar(unsigned int aWidth, unsigned int aNrRounds)
 
 void KeccakPStar::operator()(UINT8 * state) const
 {
-    vector<LaneValue> A(25);
-    fromBytesToLanes(state, A);
-    inversePi(A);
-    KeccakF::forward(A);
-    pi(A);
-    fromLanesToBytes(A, state);
+    LaneValue a[25], A[25];
+    fromBytesToLanes(state, a);
+    for(unsigned int i=0; i<25; i++)
+        A[rhoPiSource[i]] = a[i];
+    forwardOnLanes(A);
+    for(unsigned int i=0; i<25; i++)
+        a[i] = A[rhoPiSource[i]];
+    fromLanesToBytes(a, state);
+}
+
+void KeccakPStar::applyRounds(UINT8 * state, unsigned int aNrRounds) const
+{
+    LaneValue a[25], A[25];
+    fromBytesToLanes(state, a);
+    for(unsigned int i=0; i<25; i++)
+        A[rhoPiSource[i]] = a[i];
+    forwardOnLanes(A, aNrRounds);
+    for(unsigned int i=0; i<25; i++)
+        a[i] = A[rhoPiSource[i]];
+    fromLanesToBytes(a, state);
+}
+
+void KeccakPStar::applyBatch(UINT8 * states, unsigned int count) const
+{
+    KeccakF::applyBatch(states, count, rhoPiSource);
 }
 
 void KeccakPStar::inverse(UINT8 * state) const
 {
-    vector<LaneValue> A(25);
-    fromBytesToLanes(state, A);
-    inversePi(A);
-    KeccakF::inverse(A);
-    pi(A);
-    fromLanesToBytes(A, state);
+    LaneValue a[25], A[25];
+    fromBytesToLanes(state, a);
+    for(unsigned int i=0; i<25; i++)
+        A[rhoPiSource[i]] = a[i];
+    inverseOnLanes(A);
+    for(unsigned int i=0; i<25; i++)
+        a[i] = A[rhoPiSource[i]];
+    fromLanesToBytes(a, state);
 }
 
 string KeccakPStar::getName() const
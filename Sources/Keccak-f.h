@@ -49,6 +49,23 @@ protected:
     vector<LaneValue> roundConstants;
     /** A 64-bit word whose first laneSize bits are 1 and all others 0. */
     LaneValue mask;
+    /** For each lane position, the index of the lane that ρ then π move to this position. */
+    unsigned int rhoPiSource[25];
+    /** For each lane position, the ρ offset (reduced modulo laneSize) of the lane from rhoPiSource. */
+    unsigned int rhoPiOffset[25];
+    /** For each x offset, the z offsets at which a column parity contributes to the inverse of θ. */
+    LaneValue inverseThetaPositions[5];
+    /** The number of factors (1 + X<sup>a</sup> + z<sup>b</sup>X<sup>c</sup>) in the inverse of θ on the parities, see inverseRoundOnLanes(). */
+    unsigned int inverseThetaNrFactors;
+    /** The values (a, b, c) of each factor, with b reduced modulo laneSize. */
+    unsigned int inverseThetaFactors[6][3];
+    /** The x offsets, as a bit mask, of the inverse of the remaining factor T, see initializeInverseTheta(). */
+    unsigned int inverseThetaFinalMask;
+    /** Whether forwardOnLanes() uses the lane complementing transform, see setLaneComplementing(). */
+    bool laneComplementing;
+public:
+    /** The number of states that applyBatch() processes simultaneously. */
+    static const unsigned int batchSize = 8;
 protected:
     /**
       * The constructor. The width and the range of rounds are
@@ -105,6 +122,144 @@ public:
       * the parameter @a state.
       */
     void inverse(UINT8 * state) const;
+    /**
+      * Method that applies the permutation onto a state given as 25 lanes
+      * in 64-bit words. Unlike the template method forward(), this method
+      * does not allocate any memory and combines ρ and π in a single step.
+      * It is the fast path used by operator()(UINT8*).
+      *
+      * @param  A       The state as an array of 25 lanes, ordered according to index().
+      */
+    void forwardOnLanes(LaneValue *A) const;
+    /**
+      * Method that applies the last @a aNrRounds rounds of Keccak-<i>p</i> that ends
+      * with the same round as this instance onto a state given as 25 lanes
+      * in 64-bit words, in place and without allocating any memory.
+      * The round indexes go from getIndexOfFirstRound()+getNumberOfRounds()-@a aNrRounds
+      * (possibly negative) to getIndexOfFirstRound()+getNumberOfRounds()-1,
+      * so that for instance a KeccakP object with the nominal number of rounds
+      * evaluates Keccak-<i>p</i> with any number of rounds.
+      *
+      * @param  A       The state as an array of 25 lanes, ordered according to index().
+      * @param  aNrRounds   The number of rounds to apply.
+      */
+    void forwardOnLanes(LaneValue *A, unsigned int aNrRounds) const;
+    /**
+      * Method that applies the last @a aNrRounds rounds onto the parameter
+      * @a state in place, see forwardOnLanes(LaneValue*, unsigned int) const.
+      * With 64-bit lanes on a little-endian platform, the bytes of the state
+      * are copied as they are into the lanes and back.
+      *
+      * @param  state   A buffer of ceil(getWidth()/8.0) bytes.
+      * @param  aNrRounds   The number of rounds to apply.
+      */
+    virtual void applyRounds(UINT8 * state, unsigned int aNrRounds) const;
+    /**
+      * Method that applies the rounds of this instance one after the other onto
+      * the state at the beginning of @a states and keeps the state after each round,
+      * so that a single evaluation gives the output for every number of rounds.
+      * For i from 1 to getNumberOfRounds(), the state at @a states + i*ceil(getWidth()/8.0)
+      * receives the state after the rounds getIndexOfFirstRound() to getIndexOfFirstRound()+i-1,
+      * i.e., the output of KeccakFanyRounds(getWidth(), getIndexOfFirstRound(), i)
+      * on the input state. Unlike applyRounds(), the rounds are the first ones of this instance.
+      *
+      * @param  states  A buffer of (getNumberOfRounds()+1)*ceil(getWidth()/8.0) bytes,
+      *                 starting with the input state.
+      */
+    void sweepRounds(UINT8 * states) const;
+    /**
+      * Method that applies the round function onto a state given as 25 lanes
+      * in 64-bit words, without allocating any memory.
+      *
+      * @param  A       The state as an array of 25 lanes, ordered according to index().
+      * @param  roundIndex  The round index.
+      */
+    void roundOnLanes(LaneValue *A, int roundIndex) const;
+    /**
+      * Method that selects whether forwardOnLanes(), and hence operator()(UINT8*),
+      * uses the lane complementing transform. When enabled, some lanes are complemented
+      * before the first round and after the last one, and the rounds in between
+      * use the complemented χ of roundOnComplementedLanes(), which requires
+      * one complementation per row instead of five. The result is the same in both cases.
+      */
+    void setLaneComplementing(bool aLaneComplementing);
+    /**
+      * Method that returns whether the lane complementing transform is used.
+      */
+    bool getLaneComplementing() const;
+    /**
+      * Method that applies the round function onto a state given as 25 lanes
+      * in the lane complementing representation, i.e., with the lanes of the mask
+      * 0x121106 complemented at the input and at the output of the round.
+      *
+      * @param  A       The state as an array of 25 lanes, ordered according to index().
+      * @param  roundIndex  The round index.
+      */
+    void roundOnComplementedLanes(LaneValue *A, int roundIndex) const;
+    /**
+      * Method that complements the lanes of the lane complementing transform,
+      * so as to go from and to the lane complementing representation.
+      */
+    void complementLanes(LaneValue *A) const;
+    /**
+      * Method that applies the permutation onto a vector of 25 lanes in 64-bit words.
+      * This overload takes precedence over the template method forward()
+      * for actual evaluations and goes through forwardOnLanes().
+      */
+    void forward(vector<LaneValue>& state) const;
+    /**
+      * Method that applies the inverse permutation onto a state given as
+      * 25 lanes in 64-bit words, without allocating any memory.
+      * It is the fast path used by inverse(UINT8*).
+      *
+      * @param  A       The state as an array of 25 lanes, ordered according to index().
+      */
+    void inverseOnLanes(LaneValue *A) const;
+    /**
+      * Method that applies the inverse of the round function onto a state
+      * given as 25 lanes in 64-bit words, without allocating any memory.
+      * The inverse of θ is computed on the column parities as a product of
+      * a few sparse factors (see initializeInverseTheta()) instead of
+      * a multiplication by the dense inverse.
+      *
+      * @param  A       The state as an array of 25 lanes, ordered according to index().
+      * @param  roundIndex  The round index.
+      */
+    void inverseRoundOnLanes(LaneValue *A, int roundIndex) const;
+    /**
+      * Method that applies the inverse permutation onto a vector of 25 lanes
+      * in 64-bit words. This overload takes precedence over the template
+      * method inverse() for actual evaluations and goes through inverseOnLanes().
+      */
+    void inverse(vector<LaneValue>& state) const;
+    /**
+      * Method that applies the permutation onto @a count states stored one
+      * after the other. The states are processed in groups of batchSize,
+      * interleaved lane by lane (see forwardOnLaneBatch()), so that each
+      * step operates on batchSize independent lanes at once and can be
+      * mapped by the compiler onto SIMD instructions (e.g., 4×1600 per
+      * pair of AVX2 registers or 8×1600 with AVX-512).
+      *
+      * @param  states  A buffer containing @a count states, each of
+      *                 ceil(getWidth()/8.0) bytes.
+      * @param  count   The number of states in @a states.
+      */
+    void applyBatch(UINT8 * states, unsigned int count) const;
+    /**
+      * Method that applies the permutation onto batchSize states whose lanes
+      * are interleaved: lane @a i of state @a k is in A[i*batchSize+k].
+      *
+      * @param  A       The states as an array of 25*batchSize lanes.
+      */
+    void forwardOnLaneBatch(LaneValue *A) const;
+    /**
+      * Method that applies the round function onto batchSize states whose
+      * lanes are interleaved as in forwardOnLaneBatch().
+      *
+      * @param  A       The states as an array of 25*batchSize lanes.
+      * @param  roundIndex  The round index.
+      */
+    void roundOnLaneBatch(LaneValue *A, int roundIndex) const;
     /**
       * Method that returns a string describing the instance of the Keccak-<i>f</i>
       * permutation.
@@ -396,6 +551,16 @@ public:
       *                 It will be resized to 25 if necessary.
       */
     void fromBytesToLanes(const UINT8 *in, vector<LaneValue>& out) const;
+    /**
+      * Method that converts a state given as an array of bytes into an array
+      * of 25 lanes in 64-bit words.
+      *
+      * @param  in      The state as an array of bytes.
+      *                 The array @a in must have a size of at least
+      *                 ceil(getWidth()/8.0) bytes.
+      * @param  out     The state as an array of 25 lanes.
+      */
+    void fromBytesToLanes(const UINT8 *in, LaneValue *out) const;
     /**
       * Method that converts a vector of lanes in 64-bit words into a state
       * given as an array of bytes.
@@ -407,6 +572,16 @@ public:
       *                 ceil(getWidth()/8.0) bytes.
       */
     void fromLanesToBytes(const vector<LaneValue>& in, UINT8 *out) const;
+    /**
+      * Method that converts an array of 25 lanes in 64-bit words into a state
+      * given as an array of bytes.
+      *
+      * @param  in      The state as an array of 25 lanes.
+      * @param  out     The state as an array of bytes.
+      *                 The array @a out must have a size of at least
+      *                 ceil(getWidth()/8.0) bytes.
+      */
+    void fromLanesToBytes(const LaneValue *in, UINT8 *out) const;
     /**
       * Function that appends the z coordinate to the given prefix.
       * If the lane size is 1, the z coordinate is not appended.
@@ -463,15 +638,69 @@ private:
     void initializeRoundConstants();
     /**
       * Method that initializes the 25 lane translation offsets for ρ according to
-      * the specifications.
+      * the specifications, as well as the combined ρ and π tables.
       */
     void initializeRhoOffsets();
+    /**
+      * Method that initializes the data used by the inverse of θ.
+      * In the ring of column parities F2[X,z]/(X<sup>5</sup>+1, z<sup>laneSize</sup>+1),
+      * θ multiplies the parities by P = 1 + X + zX<sup>4</sup>. Since the ring
+      * has characteristic 2, P<sup>2<sup>m</sup></sup> = T = 1 + X<sup>k</sup> + X<sup>4k</sup>
+      * with 2<sup>m</sup> = laneSize and k = 2<sup>m</sup> modulo 5, hence
+      * P<sup>-1</sup> = T<sup>-1</sup> ∏<sub>i&lt;m</sub> P<sup>2<sup>i</sup></sup>.
+      */
+    void initializeInverseTheta();
+protected:
+    /**
+      * Method that applies θ onto the lanes @a A, then ρ and π from @a A to @a B.
+      */
+    void thetaRhoPiOnLanes(LaneValue *A, LaneValue *B) const;
+    /**
+      * Method that applies the inverse of θ, or its transpose, onto the lanes @a A
+      * using the factors computed by initializeInverseTheta().
+      * The transpose multiplies the parities by the factors with X and z
+      * replaced by their inverses.
+      *
+      * @param  A       The state as an array of 25 lanes, ordered according to index().
+      * @param  transposed  Whether to apply the transpose of the inverse of θ.
+      */
+    void inverseThetaOnLanes(LaneValue *A, bool transposed = false) const;
+    /**
+      * Method that implements applyBatch(), with lane @a i of each state
+      * loaded to and stored from position lanePosition[i] of the interleaved
+      * lanes, or position @a i if @a lanePosition is null.
+      */
+    void applyBatch(UINT8 * states, unsigned int count, const unsigned int *lanePosition) const;
+    /**
+      * Method that applies the permutation onto the @a n <= P states stored
+      * one after the other, interleaved in groups of P lanes.
+      */
+    template<unsigned int P> void applyGroup(UINT8 * states, unsigned int n, const unsigned int *lanePosition) const;
+    /**
+      * Method that applies the round function onto P states whose lanes
+      * are interleaved as in forwardOnLaneBatch(), with P instead of batchSize.
+      */
+    template<unsigned int P> void roundOnLaneGroup(LaneValue *A, int roundIndex) const;
+    /**
+      * Method that translates a lane along the z-axis by an offset
+      * already reduced modulo laneSize.
+      *
+      * @param  L       The given lane, with only its first laneSize bits possibly set.
+      * @param  offset  The translation offset, between 0 and laneSize-1.
+      */
+    inline LaneValue rotateLane(LaneValue L, unsigned int offset) const
+    {
+        if (offset == 0)
+            return L;
+        else
+            return ((L << offset) ^ (L >> (laneSize-offset))) & mask;
+    }
 };
 
 template<class Lane>
 void KeccakF::forward(vector<Lane>& state) const
 {
-    for(unsigned int i=startRoundIndex; i<startRoundIndex+nrRounds; i++)
+    for(int i=startRoundIndex; i<startRoundIndex+(int)nrRounds; i++)
         round(state, i);
 }
 
@@ -505,7 +734,7 @@ void KeccakF::inverseRound(vector<Lane>& state, int roundIndex) const
 template<class Lane>
 void KeccakF::chi(vector<Lane>& A) const
 {
-    vector<Lane> C(5);
+    Lane C[5];
     for(unsigned int y=0; y<5; y++) {
         for(unsigned int x=0; x<5; x++)
             C[x] = A[index(x,y)] ^ ((~A[index(x+1,y)]) & A[index(x+2,y)]);
@@ -519,11 +748,10 @@ template<class Lane>
 void KeccakF::inverseChi(vector<Lane>& A) const
 {
     for(unsigned int y=0; y<5; y++) {
-        unsigned int length = 5;
-        vector<Lane> C(length);
-        for(unsigned int x=0; x<length; x++) C[index(x)] = A[index(x,y)];
-        for(unsigned int x=0; x<(3*(length-1)/2); x++) {
-            unsigned int X = (length-2)*x;
+        Lane C[5];
+        for(unsigned int x=0; x<5; x++) C[x] = A[index(x,y)];
+        for(unsigned int x=0; x<6; x++) {
+            unsigned int X = 3*x;
             A[index(X,y)] = C[index(X)] ^ (A[index(X+2,y)] & (~C[index(X+1)]));
         }
     }
@@ -532,13 +760,13 @@ void KeccakF::inverseChi(vector<Lane>& A) const
 template<class Lane>
 void KeccakF::theta(vector<Lane>& A) const
 {
-    vector<Lane> C(5);
+    Lane C[5];
     for(unsigned int x=0; x<5; x++) {
         C[x] = A[index(x,0)];
         for(unsigned int y=1; y<5; y++)
             C[x] ^= A[index(x,y)];
     }
-    vector<Lane> D(5);
+    Lane D[5];
     for(unsigned int x=0; x<5; x++) {
         Lane temp = C[index(x+1)];
         ROL(temp, 1);
@@ -552,33 +780,21 @@ void KeccakF::theta(vector<Lane>& A) const
 template<class Lane>
 void KeccakF::inverseTheta(vector<Lane>& A) const
 {
-    vector<Lane> C(5);
+    Lane C[5];
     for(unsigned int x=0; x<5; x++) {
         C[x] = A[index(x,0)];
         for(unsigned int y=1; y<5; y++){
             C[x] ^= A[index(x,y)];
         }
     }
-    const LaneValue inversePositions64[5] = {
-        0xDE26BC4D789AF134ULL,
-        0x09AF135E26BC4D78ULL,
-        0xEBC4D789AF135E26ULL,
-        0x7135E26BC4D789AFULL,
-        0xCD789AF135E26BC4ULL };
-    vector<LaneValue> inversePositions(5, 0);
-    for(unsigned int z=0; z<64; z+=laneSize)
-        for(unsigned int x=0; x<5; x++)
-            inversePositions[x] ^= inversePositions64[x] >> z;
     for(unsigned int z=0; z<laneSize; z++) {
         for(unsigned int xOff=0; xOff<5; xOff++)
-           for(int x=0; x<5; x++)
-               for(unsigned int y=0; y<5; y++)
-                   if ((inversePositions[xOff] & 1) != 0)
-                      A[index(x, y)] ^= C[index(x-xOff)];
-        for(unsigned int xOff=0; xOff<5; xOff++) {
+            if (((inverseThetaPositions[xOff] >> z) & 1) != 0)
+                for(int x=0; x<5; x++)
+                    for(unsigned int y=0; y<5; y++)
+                        A[index(x, y)] ^= C[index(x-xOff)];
+        for(unsigned int xOff=0; xOff<5; xOff++)
             ROL(C[xOff], 1);
-            inversePositions[xOff] >>= 1;
-        }
     }
 }
 
@@ -747,6 +963,19 @@ public:
       */
     void operator()(UINT8 * state) const;
 
+    /**
+      * Method that applies the last @a aNrRounds rounds of Keccak-<i>p</i>*
+      * onto the parameter @a state in place, with π<sup>-1</sup> at input
+      * and π at output, see KeccakF::applyRounds().
+      */
+    void applyRounds(UINT8 * state, unsigned int aNrRounds) const;
+
+    /**
+      * Method that applies the permutation onto @a count states stored one
+      * after the other, see KeccakF::applyBatch().
+      */
+    void applyBatch(UINT8 * states, unsigned int count) const;
+
     /**
       * Abstract method that applies the <em>inverse</em> of the permutation
       * onto the parameter @a state.
@@ -13,70 +13,169 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
 #include <fstream>
 #include <math.h>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "Keccak-f25LUT.h"
 
 using namespace std;
 
+static const SliceValue LUTsize = 1<<25;
+
 KeccakF25LUT::KeccakF25LUT(unsigned int aNrRounds)
-    : KeccakFfirstRounds(25, aNrRounds)
+    : KeccakFfirstRounds(25, aNrRounds), LUT(0)
 {
     generateLUT();
 }
 
 KeccakF25LUT::KeccakF25LUT()
-    : KeccakFfirstRounds(25)
+    : KeccakFfirstRounds(25), LUT(0)
 {
     generateLUT();
 }
 
+void KeccakF25LUT::operator()(UINT8 * state) const
+{
+    SliceValue slice = (SliceValue)state[0] ^ ((SliceValue)state[1] << 8)
+        ^ ((SliceValue)state[2] << 16) ^ ((SliceValue)(state[3] & 1) << 24);
+    slice = LUT[slice];
+    state[0] = slice & 0xFF;
+    state[1] = (slice >> 8) & 0xFF;
+    state[2] = (slice >> 16) & 0xFF;
+    state[3] = (slice >> 24) & 0x01;
+}
+
 void KeccakF25LUT::generateLUT()
 {
-   if (!retrieveLUT()) {
-        cout << "Generating the look-up table..." << flush;
-        vector<LaneValue> lanes(25, 0);
-        LUT.resize(1<<25);
-        for (SliceValue sliceIn=0; sliceIn< (1<<25) ; sliceIn++) {
-            if ((sliceIn & 0xfffff) == 0) cout << " " << floor(sliceIn*100.0/(1<<25)) << "%" << flush;
-            setSlice(lanes, sliceIn);
-            forward(lanes);
-            SliceValue sliceOut = getSlice(lanes);
-            LUT[sliceIn] = sliceOut;
-        }
-        cout << " done, now saving to disk..." << flush;
-        saveLUT();
-        cout << "and saved." << endl;
+    if (!retrieveLUT()) {
+        generateLUTs(vector<unsigned int>(1, nrRounds));
+        if (!retrieveLUT())
+            throw KeccakException("The look-up table could not be saved to or retrieved from " + buildFileName("", ".LUT") + ".");
     }
 }
 
-void KeccakF25LUT::saveLUT() const
+void KeccakF25LUT::generateLUTs(const vector<unsigned int>& nrRoundsList, unsigned int nrThreads)
 {
-    string fileName = buildFileName("", ".LUT");
-    ofstream fout(fileName.c_str(), ios::binary);
-    for (SliceValue i=0 ; i<(1<<25); i++) {
-        static unsigned char tmp[4];
-        tmp[0] =  LUT[i]&0xFF;
-        tmp[1] = (LUT[i]>>8)&0xFF;
-        tmp[2] = (LUT[i]>>16)&0xFF;
-        tmp[3] = (LUT[i]>>24)&0xFF;
-        fout.write((char *)tmp, 4);
+    if (nrRoundsList.size() == 0)
+        return;
+    unsigned int maxNrRounds = *max_element(nrRoundsList.begin(), nrRoundsList.end());
+    KeccakFfirstRounds f(25, maxNrRounds);
+    vector<string> fileNames;
+    vector<fstream*> files;
+    for(unsigned int i=0; i<nrRoundsList.size(); i++) {
+        fileNames.push_back(KeccakFfirstRounds(25, nrRoundsList[i]).buildFileName("", ".LUT"));
+        // The table is written under a temporary name so that other processes never map a partial file.
+        files.push_back(new fstream((fileNames[i] + ".tmp").c_str(), ios::out | ios::binary | ios::trunc));
     }
+    if (nrThreads == 0)
+        nrThreads = max(1U, thread::hardware_concurrency());
+
+    const SliceValue chunkSize = 1<<16;
+    SliceValue nextChunk = 0, chunksDone = 0;
+    mutex lock;
+    cout << "Generating the look-up table";
+    if (nrRoundsList.size() > 1)
+        cout << "s";
+    cout << "..." << flush;
+    auto worker = [&]() {
+        vector<UINT8> output(nrRoundsList.size()*chunkSize*4);
+        while(true) {
+            SliceValue first;
+            {
+                lock_guard<mutex> guard(lock);
+                if (nextChunk >= LUTsize)
+                    return;
+                first = nextChunk;
+                nextChunk += chunkSize;
+            }
+            for(SliceValue sliceIn=first; sliceIn<first+chunkSize; sliceIn++) {
+                LaneValue lanes[25];
+                for(unsigned int i=0; i<25; i++)
+                    lanes[i] = (sliceIn >> i) & 1;
+                for(unsigned int r=1; r<=maxNrRounds; r++) {
+                    f.roundOnLanes(lanes, r-1);
+                    for(unsigned int k=0; k<nrRoundsList.size(); k++) {
+                        if (nrRoundsList[k] == r) {
+                            SliceValue sliceOut = 0;
+                            for(unsigned int i=0; i<25; i++)
+                                sliceOut ^= (SliceValue)(lanes[i] & 1) << i;
+                            UINT8 *out = &output[(k*chunkSize + sliceIn - first)*4];
+                            out[0] =  sliceOut&0xFF;
+                            out[1] = (sliceOut>>8)&0xFF;
+                            out[2] = (sliceOut>>16)&0xFF;
+                            out[3] = (sliceOut>>24)&0xFF;
+                        }
+                    }
+                }
+            }
+            lock_guard<mutex> guard(lock);
+            for(unsigned int k=0; k<nrRoundsList.size(); k++) {
+                files[k]->seekp((streamoff)first*4);
+                files[k]->write((const char *)&output[k*chunkSize*4], chunkSize*4);
+            }
+            chunksDone++;
+            if ((chunksDone % 16) == 0) cout << " " << floor(chunksDone*chunkSize*100.0/LUTsize) << "%" << flush;
+        }
+    };
+    vector<thread> threads;
+    for(unsigned int t=0; t<nrThreads; t++)
+        threads.push_back(thread(worker));
+    for(unsigned int t=0; t<nrThreads; t++)
+        threads[t].join();
+    for(unsigned int k=0; k<files.size(); k++) {
+        delete files[k];
+        rename((fileNames[k] + ".tmp").c_str(), fileNames[k].c_str());
+    }
+    cout << " done and saved." << endl;
 }
 
 bool KeccakF25LUT::retrieveLUT()
 {
     string fileName = buildFileName("", ".LUT");
+    const UINT32 one = 1;
+    bool littleEndian = (*(const UINT8 *)&one == 1);
+#ifndef _WIN32
+    if (littleEndian) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        void *mapped = MAP_FAILED;
+        if ((fstat(fd, &st) == 0) && ((size_t)st.st_size == (size_t)LUTsize*4))
+            mapped = mmap(0, (size_t)LUTsize*4, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) return false;
+        table = shared_ptr<const SliceValue>((const SliceValue *)mapped,
+            [](const SliceValue *p) { munmap((void *)p, (size_t)LUTsize*4); });
+        LUT = table.get();
+        return true;
+    }
+#endif
+    (void)littleEndian;
     ifstream fin(fileName.c_str(), ios::binary);
     if (!fin) return false;
-    LUT.resize(1<<25);
-    for (SliceValue i=0 ; i<(1<<25); i++) {
-        static unsigned char tmp[4];
+    SliceValue *inMemory = new SliceValue[LUTsize];
+    for (SliceValue i=0 ; i<LUTsize; i++) {
+        unsigned char tmp[4];
         fin.read((char *)tmp, 4);
-        LUT[i]  = tmp[3];  LUT[i] <<= 8;
-        LUT[i] ^= tmp[2];  LUT[i] <<= 8;
-        LUT[i] ^= tmp[1];  LUT[i] <<= 8;
-        LUT[i] ^= tmp[0];
+        inMemory[i]  = tmp[3];  inMemory[i] <<= 8;
+        inMemory[i] ^= tmp[2];  inMemory[i] <<= 8;
+        inMemory[i] ^= tmp[1];  inMemory[i] <<= 8;
+        inMemory[i] ^= tmp[0];
+    }
+    if (!fin) {
+        delete[] inMemory;
+        return false;
     }
+    table = shared_ptr<const SliceValue>(inMemory, default_delete<const SliceValue[]>());
+    LUT = table.get();
     return true;
 }
@@ -16,6 +16,7 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #ifndef _KECCAKF25LUT_H_
 #define _KECCAKF25LUT_H_
 
+#include <memory>
 #include <vector>
 #include "Keccak-f.h"
 #include "Keccak-fParts.h"
@@ -24,14 +25,25 @@ using namespace std;
 
 /**
   * Class implementing Keccak-<i>f</i>[25] using a look-up table (LUT).
+  * The table is stored in a file with extension '.LUT' as 2<sup>25</sup>
+  * little-endian 32-bit words. When possible, this file is mapped read-only
+  * into memory, so that all the processes using the same table share a
+  * single copy of it.
   */
 class KeccakF25LUT : public KeccakFfirstRounds {
 public:
     /**
-      * Attribute containing the lookup table for Keccak-<i>f</i>[25].
+      * Attribute pointing to the lookup table for Keccak-<i>f</i>[25],
+      * with 2<sup>25</sup> entries indexed by the input slice value.
       * It is generated by generateLUT() or loaded from disk by retrieveLUT().
       */
-    vector<SliceValue> LUT;
+    const SliceValue *LUT;
+protected:
+    /**
+      * The memory holding the table, either mapped from the file or
+      * allocated on the heap. It is shared between copies of this object.
+      */
+    shared_ptr<const SliceValue> table;
 public:
     /**
       * The constructor, for which the width is fixed to 25. It generates a lookup table
@@ -45,11 +57,22 @@ public:
       * The constructor, with the nominal number of rounds.
       */
     KeccakF25LUT();
-protected:
     /**
-      * Method that saves the lookup table to a file with extension '.LUT'.
+      * Method that applies the permutation onto the parameter @a state
+      * with a single table look-up.
       */
-    void saveLUT() const;
+    void operator()(UINT8 * state) const;
+    /**
+      * Method that generates the lookup tables for several numbers of rounds
+      * in a single pass and saves each of them to its '.LUT' file.
+      * The work is split across threads.
+      *
+      * @param  nrRoundsList    The numbers of rounds for which to generate a table.
+      * @param  nrThreads   The number of threads, or 0 to use the number of
+      *                     hardware threads.
+      */
+    static void generateLUTs(const vector<unsigned int>& nrRoundsList, unsigned int nrThreads = 0);
+protected:
     /**
       * Method that retrieves the lookup table from a file with extension '.LUT'.
       */
@@ -152,6 +152,118 @@ bool AffineSpaceOfSlices::getOffsetWithGivenParity(RowValue parity, SliceValue&
 }
 
 
+// -------------------------------------------------------------
+//
+// PackedStateRows
+//
+// -------------------------------------------------------------
+
+PackedStateRows::PackedStateRows(unsigned int aLaneSize)
+    : laneSize(aLaneSize), nrParityWords((5*aLaneSize + 63)/64), nrWords(nrParityWords + (25*aLaneSize + 63)/64)
+{
+}
+
+void PackedStateRows::appendZeroRow()
+{
+    words.resize(words.size() + nrWords, 0);
+}
+
+/** This function XORs the @a nrBits bits of @a value at the given bit position of a packed row. */
+static inline void xorBits(UINT64 *row, unsigned int position, UINT64 value, unsigned int nrBits)
+{
+    unsigned int shift = position%64;
+    row[position/64] ^= value << shift;
+    if (shift + nrBits > 64)
+        row[position/64 + 1] ^= value >> (64 - shift);
+}
+
+/** This function returns the @a nrBits bits at the given bit position of a packed row. */
+static inline UINT64 getBits(const UINT64 *row, unsigned int position, unsigned int nrBits)
+{
+    unsigned int shift = position%64;
+    UINT64 value = row[position/64] >> shift;
+    if (shift + nrBits > 64)
+        value ^= row[position/64 + 1] << (64 - shift);
+    return value & (((UINT64)1 << nrBits) - 1);
+}
+
+void PackedStateRows::append(const vector<SliceValue>& state)
+{
+    appendZeroRow();
+    UINT64 *row = &words[words.size() - nrWords];
+    for(unsigned int z=0; z<laneSize; z++)
+        if (state[z] != 0) {
+            SliceValue slice = state[z];
+            RowValue parity = (RowValue)((slice ^ (slice >> 5) ^ (slice >> 10) ^ (slice >> 15) ^ (slice >> 20)) & 0x1F);
+            xorBits(row, 5*z, parity, 5);
+            xorBits(row + nrParityWords, 25*z, slice, 25);
+        }
+}
+
+void PackedStateRows::append(const vector<SliceValue>& state, const vector<RowValue>& parity)
+{
+    appendZeroRow();
+    UINT64 *row = &words[words.size() - nrWords];
+    for(unsigned int z=0; z<laneSize; z++) {
+        if (parity[z] != 0)
+            xorBits(row, 5*z, parity[z], 5);
+        if (state[z] != 0)
+            xorBits(row + nrParityWords, 25*z, state[z], 25);
+    }
+}
+
+void PackedStateRows::append(const PackedStateRows& other, unsigned int row)
+{
+    words.insert(words.end(), other.words.begin() + row*nrWords, other.words.begin() + (row+1)*nrWords);
+}
+
+int PackedStateRows::getFirstParityBit(unsigned int row, unsigned int fromBit) const
+{
+    const UINT64 *r = &words[row*nrWords];
+    for(unsigned int w=fromBit/64; w<nrParityWords; w++)
+        if (r[w] != 0) {
+            unsigned int bit = 0;
+            while(((r[w] >> bit) & 1) == 0)
+                bit++;
+            return (int)(64*w + bit);
+        }
+    return -1;
+}
+
+bool PackedStateRows::isStateZero(unsigned int row) const
+{
+    const UINT64 *r = &words[row*nrWords];
+    for(unsigned int w=nrParityWords; w<nrWords; w++)
+        if (r[w] != 0)
+            return false;
+    return true;
+}
+
+void PackedStateRows::add(unsigned int row, const PackedStateRows& other, unsigned int otherRow, unsigned int fromBit)
+{
+    UINT64 *r = &words[row*nrWords];
+    const UINT64 *o = &other.words[otherRow*nrWords];
+    for(unsigned int w=fromBit/64; w<nrWords; w++)
+        r[w] ^= o[w];
+}
+
+void PackedStateRows::getState(unsigned int row, vector<SliceValue>& state) const
+{
+    const UINT64 *r = &words[row*nrWords + nrParityWords];
+    state.resize(laneSize);
+    for(unsigned int z=0; z<laneSize; z++)
+        state[z] = (SliceValue)getBits(r, 25*z, 25);
+}
+
+void PackedStateRows::getParity(unsigned int row, vector<RowValue>& parity) const
+{
+    const UINT64 *r = &words[row*nrWords];
+    parity.resize(laneSize);
+    for(unsigned int z=0; z<laneSize; z++)
+        parity[z] = (RowValue)getBits(r, 5*z, 5);
+}
+
+
 // -------------------------------------------------------------
 //
 // AffineSpaceOfStates
@@ -164,10 +276,27 @@ AffineSpaceOfStates::AffineSpaceOfStates(unsigned int aLaneSize, vector<vector<S
     setGenerators(aGenerators, aGeneratorParities);
 }
 
-AffineSpaceOfStates::AffineSpaceOfStates(unsigned int aLaneSize, vector<vector<SliceValue> >& aGenerators, vector<vector<RowValue> >& aGeneratorParities, const vector<SliceValue>& aOffset, const vector<RowValue>& aOffsetParity)
-    : offset(aOffset), offsetParity(aOffsetParity), packed(false), laneSize(aLaneSize)
+AffineSpaceOfStates::AffineSpaceOfStates(unsigned int aLaneSize, const vector<vector<SliceValue> >& aGenerators, const vector<vector<RowValue> >& aGeneratorParities, const vector<SliceValue>& aOffset, const vector<RowValue>& aOffsetParity)
+    : originalGenerators(aGenerators), originalParities(aGeneratorParities),
+    offset(aOffset), offsetParity(aOffsetParity), packed(false), laneSize(aLaneSize), offsetRows(aLaneSize)
 {
-    setGenerators(aGenerators, aGeneratorParities);
+    PackedStateRows rows(laneSize);
+    for(unsigned int i=0; i<aGenerators.size(); i++)
+        rows.append(aGenerators[i], aGeneratorParities[i]);
+    setGenerators(rows);
+}
+
+AffineSpaceOfStates::AffineSpaceOfStates(unsigned int aLaneSize, const vector<vector<SliceValue> >& aGenerators, const vector<SliceValue>& aOffset)
+    : originalGenerators(aGenerators), originalParities(aGenerators.size()),
+    offset(aOffset), packed(false), laneSize(aLaneSize), offsetRows(aLaneSize)
+{
+    getParity(offset, offsetParity);
+    PackedStateRows rows(laneSize);
+    for(unsigned int i=0; i<aGenerators.size(); i++) {
+        getParity(aGenerators[i], originalParities[i]);
+        rows.append(aGenerators[i], originalParities[i]);
+    }
+    setGenerators(rows);
 }
 
 void AffineSpaceOfStates::setGenerators(vector<vector<SliceValue> >& aGenerators, vector<PackedParity>& aGeneratorParities)
@@ -222,53 +351,49 @@ void AffineSpaceOfStates::setGenerators(vector<vector<SliceValue> >& aGenerators
     }
 }
 
-void AffineSpaceOfStates::setGenerators(vector<vector<SliceValue> >& aGenerators, vector<vector<RowValue> >& aGeneratorParities)
+void AffineSpaceOfStates::setGenerators(PackedStateRows& rows)
 {
-    // Copy the generators into originalGenerators;
-    originalGenerators = aGenerators;
-    originalParities = aGeneratorParities;
-
-    // Upper-triangularize the parities
-    for(unsigned int z=0; z<laneSize; z++)
-    for(unsigned int x=0; x<nrRowsAndColumns; x++) {
-        // Look for a generator with a parity 1 at position (x,z)
-        RowValue selectX = 1 << x;
-        bool found = false;
-        vector<SliceValue> foundState;
-        vector<RowValue> foundParity;
-        for(unsigned int i=0; i<aGenerators.size(); i++) {
-            if ((aGeneratorParities[i][z] & selectX) != 0) {
-                foundState = aGenerators[i];
-                offsetGenerators.push_back(foundState);
-                foundParity = aGeneratorParities[i];
-                offsetParities.push_back(foundParity);
-                found = true;
-                break;
+    unsigned int nrRows = rows.getNumberOfRows();
+    offsetGeneratorPerParityBit.assign(rows.getNumberOfParityBits(), -1);
+    vector<int> firstBit(nrRows);
+    for(unsigned int i=0; i<nrRows; i++)
+        firstBit[i] = rows.getFirstParityBit(i);
+
+    // Upper-triangularize the parities, for the positions x+5z in increasing order.
+    // When all the parity bits before some position are zero in all the rows,
+    // the next position to process is the smallest first parity bit of the rows,
+    // and these bits can be skipped when adding rows.
+    while(true) {
+        // Look for the first generator with a parity 1 at the next position (x,z)
+        int bit = -1;
+        unsigned int found = 0;
+        for(unsigned int i=0; i<nrRows; i++)
+            if ((firstBit[i] >= 0) && ((bit < 0) || (firstBit[i] < bit))) {
+                bit = firstBit[i];
+                found = i;
             }
-        }
-        // If found, cancel all parities at position (x,z) for the other aGenerators
-        if (found) {
-            for(unsigned int i=0; i<aGenerators.size(); i++) {
-                if ((aGeneratorParities[i][z] & selectX) != 0) {
-                    for(unsigned int jz=0; jz<laneSize; jz++)
-                        aGenerators[i][jz] ^= foundState[jz];
-                    for(unsigned int jz=0; jz<laneSize; jz++)
-                        aGeneratorParities[i][jz] ^= foundParity[jz];
-                }
-            }
-        }
-    }
-    // The remaining aGenerators have zero parity
-    for(unsigned int i=0; i<aGenerators.size(); i++) {
-        bool zero = true;
-        for(unsigned int j=0; j<aGenerators[i].size(); j++)
-            if (aGenerators[i][j] != 0) {
-                zero = false;
-                break;
+        if (bit < 0)
+            break;
+        unsigned int index = offsetRows.getNumberOfRows();
+        offsetRows.append(rows, found);
+        offsetGeneratorPerParityBit[bit] = (int)index;
+        offsetGenerators.push_back(vector<SliceValue>());
+        offsetRows.getState(index, offsetGenerators.back());
+        offsetParities.push_back(vector<RowValue>());
+        offsetRows.getParity(index, offsetParities.back());
+        // Cancel all parities at position (x,z) for the other generators
+        for(unsigned int i=found; i<nrRows; i++)
+            if (firstBit[i] == bit) {
+                rows.add(i, offsetRows, index, bit);
+                firstBit[i] = rows.getFirstParityBit(i, bit);
             }
-        if (!zero)
-            kernelGenerators.push_back(aGenerators[i]);
     }
+    // The remaining generators have zero parity
+    for(unsigned int i=0; i<nrRows; i++)
+        if (!rows.isStateZero(i)) {
+            kernelGenerators.push_back(vector<SliceValue>());
+            rows.getState(i, kernelGenerators.back());
+        }
 }
 
 void AffineSpaceOfStates::display(ostream& fout) const
@@ -339,46 +464,27 @@ bool AffineSpaceOfStates::getOffsetWithGivenParity(PackedParity parity, vector<S
     }
 }
 
-bool oneAndZeroesBefore(const vector<RowValue>& parity, RowValue maskX, RowValue selectX, unsigned int z)
-{
-    for(unsigned int iz=0; iz<z; iz++)
-        if (parity[iz] != 0)
-            return false;
-    return (parity[z] & maskX) == selectX;
-}
-
 bool AffineSpaceOfStates::getOffsetWithGivenParity(const vector<RowValue>& parity, vector<SliceValue>& output) const
 {
     if (packed)
         throw KeccakException("AffineBaseOfState initialized with PackedParity, not accessible without PackedParity.");
-    output = offset;
-    vector<RowValue> outputParity = offsetParity;
     vector<RowValue> correctionParity(parity);
     for(unsigned int z=0; z<laneSize; z++)
         correctionParity[z] ^= offsetParity[z];
-
-    unsigned int i = 0;
-
-    for(unsigned int z=0; z<laneSize; z++)
-    for(unsigned int x=0; x<nrRowsAndColumns; x++) {
-        RowValue maskX = (1<<(x+1))-1;
-        RowValue selectX = 1 << x;
-        if ((correctionParity[z] & selectX) != 0) {
-            while((i<offsetParities.size()) && (!oneAndZeroesBefore(offsetParities[i], maskX, selectX, z)))
-                i++;
-            if (i<offsetParities.size()) {
-                for(unsigned int jz=0; jz<laneSize; jz++)
-                    output[jz] ^= offsetGenerators[i][jz];
-                for(unsigned int jz=0; jz<laneSize; jz++)
-                    correctionParity[jz] ^= offsetParities[i][jz];
-            }
-            else
-                return false;
-        }
-    }
-    for(unsigned int jz=0; jz<correctionParity.size(); jz++)
-        if (correctionParity[jz] != 0)
+    PackedStateRows correction(laneSize);
+    correction.append(offset, correctionParity);
+
+    // Cancel the parity bits in increasing order of position x+5z with the parity-offset generator
+    // whose first parity bit is at that position.
+    int bit = correction.getFirstParityBit(0);
+    while(bit >= 0) {
+        int i = offsetGeneratorPerParityBit[bit];
+        if (i < 0)
             return false;
+        correction.add(0, offsetRows, i, bit);
+        bit = correction.getFirstParityBit(0, bit);
+    }
+    correction.getState(0, output);
     return true;
 }
 
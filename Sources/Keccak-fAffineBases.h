@@ -127,8 +127,10 @@ class AffineSpaceIterator {
 private:
     vector<vector<T> > *emptyBase;
     const vector<vector<T> > *base;
+    vector<vector<unsigned int> > activeIndexes;
     vector<T> current;
-    UINT64 i, end;
+    UINT64 first, i, end;
+    int changedGenerator;
 public:
     /** This constructor creates an empty iterator. */
     AffineSpaceIterator();
@@ -139,6 +141,17 @@ public:
       * @param   aOffset    The offset, as a reference to a vector of elements of template type @a T.
       */
     AffineSpaceIterator(const vector<vector<T> >& aBase, const vector<T>& aOffset);
+    /** This constructor initializes the affine space iterator on a sub-range of the elements,
+      * in the order in which the iterator over the whole affine space would enumerate them.
+      * This allows one to split the affine space into parts processed independently.
+      * @param   aBase      The generator base, as a reference to the set (vector) of generators.
+      *                     Each generator is a vector of elements of template type @a T.
+      * @param   aOffset    The offset, as a reference to a vector of elements of template type @a T.
+      * @param   aFirst     The index of the first element to enumerate.
+      * @param   aLast      The index just after the last element to enumerate,
+      *                     at most 2 to the power the number of generators.
+      */
+    AffineSpaceIterator(const vector<vector<T> >& aBase, const vector<T>& aOffset, UINT64 aFirst, UINT64 aLast);
     /** The destructor. */
     ~AffineSpaceIterator();
     /** This method tells whether the last element of the affine space
@@ -152,26 +165,68 @@ public:
       * @return The current element in the affine space.
       */
     const vector<T>& operator*() const;
+    /** The elements are enumerated in Gray code order, so that each call to operator++()
+      * adds exactly one generator to the current element.
+      * This method returns the index of that generator for the last call.
+      * @return The index of the generator added by the last call to operator++(),
+      *     or -1 if there was no such call or if it reached the end.
+      */
+    int getChangedGenerator() const { return changedGenerator; }
+    /** This method returns the indexes of the non-zero elements of a generator,
+      * i.e., those of the current element that change when it is added.
+      * @param   index      The index of the generator.
+      * @return The indexes of the non-zero elements of the generator.
+      */
+    const vector<unsigned int>& getActiveIndexes(unsigned int index) const { return activeIndexes[index]; }
+    /** This method updates a function of the current element, which is the sum of a function
+      * of each of its elements, e.g., the weight of a state given as a vector of slices,
+      * after a call to operator++(). Only the elements that changed are evaluated.
+      * @param   sum        The value of the function for the previous element.
+      * @param   f          The function of each element.
+      * @return The value of the function for the current element.
+      */
+    template<class F> int getUpdatedSum(int sum, F f) const;
     /** This method displays the offset and generators.
       * @param   fout       The stream to display to.
       */
     void display(ostream& fout) const;
-    /** This method returns the number of elements in the affine space.
-      * @return The number of elements in the affine space.
+    /** This method returns the number of elements in the affine space,
+      * or in the sub-range given to the constructor.
+      * @return The number of elements to enumerate.
       */
     UINT64 getCount() const;
 };
 
 template<class T>
 AffineSpaceIterator<T>::AffineSpaceIterator()
-    : emptyBase(new vector<vector<T> >), base(emptyBase), current(), i(0), end(0)
+    : emptyBase(new vector<vector<T> >), base(emptyBase), current(), first(0), i(0), end(0), changedGenerator(-1)
 {
 }
 
 template<class T>
 AffineSpaceIterator<T>::AffineSpaceIterator(const vector<vector<T> >& aBase, const vector<T>& aOffset)
-    : emptyBase(0), base(&aBase), current(aOffset), i(0), end((UINT64)1<<base->size())
+    : emptyBase(0), base(&aBase), activeIndexes(aBase.size()), current(aOffset), first(0), i(0), end((UINT64)1<<base->size()), changedGenerator(-1)
+{
+    for(unsigned int index=0; index<base->size(); index++)
+        for(unsigned int z=0; z<(*base)[index].size(); z++)
+            if ((*base)[index][z] != 0)
+                activeIndexes[index].push_back(z);
+}
+
+template<class T>
+AffineSpaceIterator<T>::AffineSpaceIterator(const vector<vector<T> >& aBase, const vector<T>& aOffset, UINT64 aFirst, UINT64 aLast)
+    : emptyBase(0), base(&aBase), activeIndexes(aBase.size()), current(aOffset), first(aFirst), i(aFirst), end(aLast), changedGenerator(-1)
 {
+    for(unsigned int index=0; index<base->size(); index++)
+        for(unsigned int z=0; z<(*base)[index].size(); z++)
+            if ((*base)[index][z] != 0)
+                activeIndexes[index].push_back(z);
+    // The element of index i is the offset plus the generators selected by the Gray code of i.
+    UINT64 gray = (i < end) ? i ^ (i >> 1) : 0;
+    for(unsigned int index=0; (gray >> index) != 0; index++)
+        if (((gray >> index) & 1) != 0)
+            for(unsigned int z=0; z<current.size(); z++)
+                current[z] ^= (*base)[index][z];
 }
 
 template<class T>
@@ -190,12 +245,16 @@ bool AffineSpaceIterator<T>::isEnd() const
 template<class T>
 void AffineSpaceIterator<T>::operator++()
 {
+    changedGenerator = -1;
     if (i < (end-1)) {
         unsigned int index = 0;
         while((i & ((UINT64)1<<index)) != 0)
             index++;
-        for(unsigned int z=0; z<current.size(); z++)
-            current[z] ^= (*base)[index][z];
+        const vector<T>& generator = (*base)[index];
+        const vector<unsigned int>& indexes = activeIndexes[index];
+        for(unsigned int k=0; k<indexes.size(); k++)
+            current[indexes[k]] ^= generator[indexes[k]];
+        changedGenerator = index;
     }
     i++;
 }
@@ -206,6 +265,21 @@ const vector<T>& AffineSpaceIterator<T>::operator*() const
     return current;
 }
 
+template<class T>
+template<class F>
+int AffineSpaceIterator<T>::getUpdatedSum(int sum, F f) const
+{
+    if (changedGenerator < 0)
+        return sum;
+    const vector<T>& generator = (*base)[changedGenerator];
+    const vector<unsigned int>& indexes = activeIndexes[changedGenerator];
+    for(unsigned int k=0; k<indexes.size(); k++) {
+        unsigned int z = indexes[k];
+        sum += (int)f(current[z]) - (int)f(current[z] ^ generator[z]);
+    }
+    return sum;
+}
+
 template<class T>
 void AffineSpaceIterator<T>::display(ostream& fout) const
 {
@@ -226,7 +300,7 @@ void AffineSpaceIterator<T>::display(ostream& fout) const
 template<class T>
 UINT64 AffineSpaceIterator<T>::getCount() const
 {
-    return end;
+    return end - first;
 }
 
 /** This class implements an iterator over the affine space generated by the given
@@ -235,6 +309,89 @@ UINT64 AffineSpaceIterator<T>::getCount() const
 typedef AffineSpaceIterator<SliceValue> SlicesAffineSpaceIterator;
 
 
+/** This class stores states together with their parities as the rows of a matrix over GF(2),
+  * with each row packed into 64-bit words: first the parity, with the bit of column (x, z)
+  * at position x+5z, and then the state, with the bit (x, y, z) at position x+5y+25z.
+  * Adding a row to another one, as in Gaussian elimination, is thus done word by word.
+  */
+class PackedStateRows {
+protected:
+    /** The lane size. */
+    unsigned int laneSize;
+    /** The number of words taken by the parity in each row. */
+    unsigned int nrParityWords;
+    /** The number of words of each row. */
+    unsigned int nrWords;
+    /** The rows one after the other. */
+    vector<UINT64> words;
+public:
+    /** The constructor of an empty matrix.
+      * @param   aLaneSize  The lane size.
+      */
+    PackedStateRows(unsigned int aLaneSize = 0);
+    /** This method returns the number of rows.
+      * @return The number of rows.
+      */
+    unsigned int getNumberOfRows() const { return (nrWords == 0) ? 0 : (unsigned int)(words.size()/nrWords); }
+    /** This method returns the number of parity bits of each row, that is, 5 times the lane size.
+      * @return The number of parity bits.
+      */
+    unsigned int getNumberOfParityBits() const { return 5*laneSize; }
+    /** This method appends a row with the given state and its parity.
+      * @param   state      The state, as a vector of slices.
+      */
+    void append(const vector<SliceValue>& state);
+    /** This method appends a row with the given state and the given parity.
+      * @param   state      The state, as a vector of slices.
+      * @param   parity     The parity to store with it, as a vector of rows.
+      */
+    void append(const vector<SliceValue>& state, const vector<RowValue>& parity);
+    /** This method appends a copy of a row of another matrix with the same lane size.
+      * @param   other      The other matrix.
+      * @param   row        The index of the row in @a other.
+      */
+    void append(const PackedStateRows& other, unsigned int row);
+    /** This method tells whether a parity bit of a row is set.
+      * @param   row        The index of the row.
+      * @param   bit        The position x+5z of the parity bit.
+      * @return True iff the parity bit is set.
+      */
+    bool isParityBitSet(unsigned int row, unsigned int bit) const
+    {
+        return ((words[row*nrWords + bit/64] >> (bit%64)) & 1) != 0;
+    }
+    /** This method returns the position of the first parity bit set in a row.
+      * @param   row        The index of the row.
+      * @param   fromBit    A position before which all the parity bits are known to be zero.
+      * @return The position x+5z of the first parity bit set, or -1 if the parity is zero.
+      */
+    int getFirstParityBit(unsigned int row, unsigned int fromBit = 0) const;
+    /** This method tells whether the state of a row is zero.
+      * @param   row        The index of the row.
+      * @return True iff the state is zero.
+      */
+    bool isStateZero(unsigned int row) const;
+    /** This method adds a row of a matrix with the same lane size to a row of this one.
+      * @param   row        The index of the row to modify.
+      * @param   other      The matrix containing the row to add, possibly this one.
+      * @param   otherRow   The index of the row to add in @a other.
+      * @param   fromBit    A position before which the parity bits of the row to add are known to be zero.
+      */
+    void add(unsigned int row, const PackedStateRows& other, unsigned int otherRow, unsigned int fromBit = 0);
+    /** This method extracts the state of a row.
+      * @param   row        The index of the row.
+      * @param   state      The state, as a vector of slices.
+      */
+    void getState(unsigned int row, vector<SliceValue>& state) const;
+    /** This method extracts the parity of a row.
+      * @param   row        The index of the row.
+      * @param   parity     The parity, as a vector of rows.
+      */
+    void getParity(unsigned int row, vector<RowValue>& parity) const;
+protected:
+    void appendZeroRow();
+};
+
 /** This class expresses an affine space of states.
   * The members of the affine space are determined by the offset
   * plus any linear combination of the generators.
@@ -289,6 +446,12 @@ public:
 protected:
     /** The lane size. */
     unsigned int laneSize;
+    /** If packed is false, offsetGenerators and their parities as packed rows. */
+    PackedStateRows offsetRows;
+    /** If packed is false, the index in offsetGenerators of the generator whose
+      * first parity bit is at position x+5z, or -1 if there is none.
+      */
+    vector<int> offsetGeneratorPerParityBit;
 public:
     /** This constructor initializes the different attributes from the given generators,
       * the offset and their parities.
@@ -305,7 +468,8 @@ public:
     AffineSpaceOfStates(unsigned int aLaneSize, vector<vector<SliceValue> >& aGenerators, vector<PackedParity>& aGeneratorParities, const vector<SliceValue>& aOffset, PackedParity aOffsetParity);
     /** This constructor initializes the different attributes from the given generators,
       * the offset and their parities.
-      * @note   The passed vectors aGenerators and aGeneratorParities are modified in the process.
+      * The parity-offset and parity-kernel generators are computed by Gaussian elimination
+      * on the generators packed into PackedStateRows.
       * @param   aLaneSize          The lane size.
       * @param   aGenerators        The set of generators of the affine space,
       *                             each given as a vector of slices.
@@ -313,7 +477,15 @@ public:
       * @param   aOffset            The offset of the affine space, as a vector of slices.
       * @param   aOffsetParity      The parity of the offset, given as a vector of rows.
       */
-    AffineSpaceOfStates(unsigned int aLaneSize, vector<vector<SliceValue> >& aGenerators, vector<vector<RowValue> >& aGeneratorParities, const vector<SliceValue>& aOffset, const vector<RowValue>& aOffsetParity);
+    AffineSpaceOfStates(unsigned int aLaneSize, const vector<vector<SliceValue> >& aGenerators, const vector<vector<RowValue> >& aGeneratorParities, const vector<SliceValue>& aOffset, const vector<RowValue>& aOffsetParity);
+    /** This constructor is like the previous one, except that it computes the parities
+      * of the generators and of the offset itself.
+      * @param   aLaneSize          The lane size.
+      * @param   aGenerators        The set of generators of the affine space,
+      *                             each given as a vector of slices.
+      * @param   aOffset            The offset of the affine space, as a vector of slices.
+      */
+    AffineSpaceOfStates(unsigned int aLaneSize, const vector<vector<SliceValue> >& aGenerators, const vector<SliceValue>& aOffset);
     /** This method returns a state value (in argument @a output) with a given parity.
       * From the offset and the parity-offset generators of the affine space, this method
       * computes an element that has the given parity. (Note that other elements with the same parity
@@ -361,7 +533,7 @@ public:
       */
     void display(ostream& fout) const;
 private:
-    void setGenerators(vector<vector<SliceValue> >& aGenerators, vector<vector<RowValue> >& aGeneratorParities);
+    void setGenerators(PackedStateRows& rows);
     void setGenerators(vector<vector<SliceValue> >& aGenerators, vector<PackedParity>& aGeneratorParities);
 };
 
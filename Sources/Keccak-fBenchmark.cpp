@@ -0,0 +1,233 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <chrono>
+#include <functional>
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "Keccak-f.h"
+#include "Keccak-f25LUT.h"
+#include "Keccak-fBenchmark.h"
+#include "Keccak-fBitSliced.h"
+#include "Keccak-fCompiled.h"
+#include "Keccak-fDCLC.h"
+#include "Keccak-fPackedLanes.h"
+#include "Keccak-fStatic.h"
+
+using namespace std;
+
+/** The number of states processed by each call to applyBatch(). */
+static const unsigned int benchmarkBatchSize = 64;
+
+/** Returns the time stamp counter, or 0 if it is not available on this platform. */
+static UINT64 readCycleCounter()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+enum BenchmarkedOperation { forwardSingle, forwardBatch, inverseSingle };
+
+static void apply(const Permutation& permutation, BenchmarkedOperation operation, UINT8 *states, unsigned int stateSize, UINT64 count)
+{
+    for(UINT64 i=0; i<count; i++) {
+        if (operation == forwardSingle)
+            permutation(states);
+        else if (operation == forwardBatch)
+            permutation.applyBatch(states, benchmarkBatchSize);
+        else
+            permutation.inverse(states + (i % benchmarkBatchSize)*stateSize);
+    }
+}
+
+static void measure(ostream& out, const Permutation& permutation, const string& backend,
+    int startRoundIndex, unsigned int nrRounds, double minimumTime, BenchmarkedOperation operation)
+{
+    unsigned int stateSize = (permutation.getWidth()+7)/8;
+    unsigned int permutationsPerCall = (operation == forwardBatch) ? benchmarkBatchSize : 1;
+    vector<UINT8> states(stateSize*benchmarkBatchSize);
+    for(unsigned int i=0; i<states.size(); i++)
+        states[i] = (UINT8)(i*19 + 7);
+    if ((permutation.getWidth() % 8) != 0)
+        for(unsigned int k=0; k<benchmarkBatchSize; k++)
+            states[k*stateSize + stateSize-1] &= (1 << (permutation.getWidth() % 8)) - 1;
+
+    apply(permutation, operation, &states[0], stateSize, 1);
+    UINT64 count = 1;
+    double elapsed;
+    UINT64 cycles;
+    while(true) {
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        UINT64 beginCycles = readCycleCounter();
+        apply(permutation, operation, &states[0], stateSize, count);
+        cycles = readCycleCounter() - beginCycles;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        if (elapsed >= minimumTime)
+            break;
+        count *= 2;
+    }
+    double nrPermutations = (double)count*permutationsPerCall;
+    out << backend << "," << dec << permutation.getWidth() << "," << startRoundIndex << "," << nrRounds << ",";
+    out << ((operation == inverseSingle) ? "inverse" : "forward") << ",";
+    out << ((operation == forwardBatch) ? "batch" : "single") << ",";
+    out << stateSize << "," << (nrPermutations/elapsed) << ",";
+    if (cycles != 0)
+        out << ((double)cycles/(nrPermutations*stateSize));
+    out << endl;
+}
+
+void benchmarkPermutationsHeader(ostream& out)
+{
+    out << "backend,width,startRoundIndex,nrRounds,direction,mode,bytesPerState,permutationsPerSecond,cyclesPerByte" << endl;
+}
+
+void benchmarkPermutation(ostream& out, const Permutation& permutation, const string& backend,
+    int startRoundIndex, unsigned int nrRounds, double minimumTime)
+{
+    measure(out, permutation, backend, startRoundIndex, nrRounds, minimumTime, forwardSingle);
+    measure(out, permutation, backend, startRoundIndex, nrRounds, minimumTime, forwardBatch);
+    measure(out, permutation, backend, startRoundIndex, nrRounds, minimumTime, inverseSingle);
+}
+
+template<unsigned int width>
+static void benchmarkStatic(ostream& out, double minimumTime)
+{
+    KeccakFStatic<width> f;
+    benchmarkPermutation(out, f, "KeccakFStatic", f.getIndexOfFirstRound(), f.getNumberOfRounds(), minimumTime);
+}
+
+static void benchmarkStatic(ostream& out, unsigned int width, double minimumTime)
+{
+    switch(width) {
+        case 25: benchmarkStatic<25>(out, minimumTime); break;
+        case 50: benchmarkStatic<50>(out, minimumTime); break;
+        case 100: benchmarkStatic<100>(out, minimumTime); break;
+        case 200: benchmarkStatic<200>(out, minimumTime); break;
+        case 400: benchmarkStatic<400>(out, minimumTime); break;
+        case 800: benchmarkStatic<800>(out, minimumTime); break;
+        case 1600: benchmarkStatic<1600>(out, minimumTime); break;
+    }
+}
+
+void benchmarkPermutations(ostream& out, const vector<unsigned int>& widths,
+    bool allRoundCounts, bool includeLUT, bool includeCompiled, double minimumTime)
+{
+    benchmarkPermutationsHeader(out);
+    for(unsigned int i=0; i<widths.size(); i++) {
+        unsigned int width = widths[i];
+        unsigned int nominalNrRounds = KeccakF(width).getNominalNumberOfRounds();
+        for(unsigned int nrRounds=(allRoundCounts ? 1 : nominalNrRounds); nrRounds<=nominalNrRounds; nrRounds++) {
+            int startRoundIndex = (int)nominalNrRounds - (int)nrRounds;
+            benchmarkPermutation(out, KeccakFfirstRounds(width, nrRounds), "KeccakF", 0, nrRounds, minimumTime);
+            benchmarkPermutation(out, KeccakP(width, nrRounds), "KeccakP", startRoundIndex, nrRounds, minimumTime);
+            benchmarkPermutation(out, KeccakPStar(width, nrRounds), "KeccakPStar", startRoundIndex, nrRounds, minimumTime);
+            benchmarkPermutation(out, KeccakFBitSliced(width, 0, nrRounds), "KeccakFBitSliced", 0, nrRounds, minimumTime);
+            if (includeLUT && (width == 25))
+                benchmarkPermutation(out, KeccakF25LUT(nrRounds), "KeccakF25LUT", 0, nrRounds, minimumTime);
+            if (includeCompiled && (width >= 200))
+                benchmarkPermutation(out, KeccakFCompiled(width, 0, nrRounds), "KeccakFCompiled", 0, nrRounds, minimumTime);
+        }
+        benchmarkStatic(out, width, minimumTime);
+    }
+}
+
+/** Returns the time in seconds taken by one call to @a call, measured over at least @a minimumTime seconds. */
+static double secondsPerCall(const function<void()>& call, double minimumTime)
+{
+    call();
+    UINT64 count = 1;
+    while(true) {
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for(UINT64 i=0; i<count; i++)
+            call();
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        if (elapsed >= minimumTime)
+            return elapsed/count;
+        count *= 2;
+    }
+}
+
+/** Compares @a operation applied to N states of LaneValue one after the other
+  * and to the same states as packed lanes, then measures both and outputs a line
+  * of results, in the format of benchmarkPackedLanes(). */
+template<unsigned int N>
+static bool benchmarkPackedLanes(ostream& out, const KeccakFDCLC& f, const string& operationName,
+    const function<void(vector<LaneValue>&)>& operation,
+    const function<void(vector<PackedLanes<N> >&)>& packedOperation, double minimumTime)
+{
+    unsigned int laneSize = f.getLaneSize();
+    LaneValue mask = (laneSize < 64) ? ((LaneValue)1 << laneSize) - 1 : ~(LaneValue)0;
+    vector<LaneValue> states[N], expected[N], unpacked[N];
+    for(unsigned int i=0; i<N; i++) {
+        states[i].resize(25);
+        for(unsigned int j=0; j<25; j++)
+            states[i][j] = (((LaneValue)(i*25 + j + 1) * 0x9E3779B97F4A7C15ULL) >> 7) & mask;
+    }
+    vector<PackedLanes<N> > packed;
+    packLanes<N>(states, packed);
+    for(unsigned int i=0; i<N; i++) {
+        expected[i] = states[i];
+        operation(expected[i]);
+    }
+    packedOperation(packed);
+    unpackLanes<N>(packed, unpacked);
+    bool ok = true;
+    for(unsigned int i=0; i<N; i++)
+        ok = ok && (unpacked[i] == expected[i]);
+    double secondsIndividually = secondsPerCall([&]() {
+        for(unsigned int i=0; i<N; i++)
+            operation(states[i]);
+    }, minimumTime);
+    double secondsPacked = secondsPerCall([&]() { packedOperation(packed); }, minimumTime);
+    out << f.getWidth() << "," << operationName << "," << dec << N << ","
+        << (ok ? "ok" : "FAILED") << ","
+        << (N/secondsIndividually) << "," << (N/secondsPacked) << ","
+        << (secondsIndividually/secondsPacked) << endl;
+    return ok;
+}
+
+template<unsigned int N>
+static bool benchmarkPackedLanes(ostream& out, const KeccakFDCLC& f, double minimumTime)
+{
+    static const char *lambdaModeNames[] = { "lambda", "inverseLambda", "transposeLambda", "dualLambda" };
+    bool passed = benchmarkPackedLanes<N>(out, f, "forward",
+        [&](vector<LaneValue>& A) { f.forward<LaneValue>(A); },
+        [&](vector<PackedLanes<N> >& A) { f.forward(A); }, minimumTime);
+    for(int mode=KeccakFDCLC::Straight; mode<KeccakFDCLC::EndOfLambdaModes; mode++)
+        passed = benchmarkPackedLanes<N>(out, f, lambdaModeNames[mode],
+            [&](vector<LaneValue>& A) { f.lambda(A, (KeccakFDCLC::LambdaMode)mode); },
+            [&](vector<PackedLanes<N> >& A) { f.lambda(A, (KeccakFDCLC::LambdaMode)mode); }, minimumTime) && passed;
+    return passed;
+}
+
+bool benchmarkPackedLanes(ostream& out, const vector<unsigned int>& widths, double minimumTime)
+{
+    bool passed = true;
+    out << "width,operation,packedStates,check,statesPerSecondIndividually,statesPerSecondPacked,speedup" << endl;
+    for(unsigned int i=0; i<widths.size(); i++) {
+        KeccakFDCLC f(widths[i]);
+        passed = benchmarkPackedLanes<4>(out, f, minimumTime) && passed;
+        passed = benchmarkPackedLanes<8>(out, f, minimumTime) && passed;
+        passed = benchmarkPackedLanes<16>(out, f, minimumTime) && passed;
+    }
+    return passed;
+}
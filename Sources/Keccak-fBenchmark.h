@@ -0,0 +1,93 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFBENCHMARK_H_
+#define _KECCAKFBENCHMARK_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "transformations.h"
+
+using namespace std;
+
+/**
+  * Function that measures the throughput of a permutation and outputs the
+  * results as lines of comma-separated values, one per direction and mode,
+  * in the format announced by benchmarkPermutationsHeader().
+  * The forward direction is measured on single states with operator() and
+  * on batches of states with applyBatch(); the inverse is measured on
+  * single states.
+  *
+  * @param  out         The stream to write the results to.
+  * @param  permutation The permutation to measure.
+  * @param  backend     The name of the implementation, as output in the first column.
+  * @param  startRoundIndex The index of the first round, as output in the results.
+  * @param  nrRounds    The number of rounds, as output in the results.
+  * @param  minimumTime The minimum duration, in seconds, of each measurement.
+  */
+void benchmarkPermutation(ostream& out, const Permutation& permutation, const string& backend,
+    int startRoundIndex, unsigned int nrRounds, double minimumTime = 0.05);
+
+/**
+  * Function that outputs the line of column names of the results
+  * output by benchmarkPermutation().
+  */
+void benchmarkPermutationsHeader(ostream& out);
+
+/**
+  * Function that measures the Keccak-<i>f</i> and Keccak-<i>p</i> permutations
+  * for the given widths, for all the round counts from 1 to the nominal number
+  * of rounds (or only the nominal number of rounds if @a allRoundCounts is false),
+  * and for all the available implementations: KeccakF, KeccakP, KeccakPStar,
+  * KeccakFBitSliced, KeccakFStatic (nominal number of rounds only),
+  * and optionally KeccakF25LUT and KeccakFCompiled.
+  * The results are output in comma-separated values, starting with
+  * the line of column names.
+  *
+  * @param  out         The stream to write the results to.
+  * @param  widths      The widths to measure.
+  * @param  allRoundCounts  Whether to measure all the round counts.
+  * @param  includeLUT  Whether to measure KeccakF25LUT, which may need
+  *                     to generate its look-up tables first.
+  * @param  includeCompiled Whether to measure KeccakFCompiled, which needs
+  *                     to compile the generated code for each instance.
+  * @param  minimumTime The minimum duration, in seconds, of each measurement.
+  */
+void benchmarkPermutations(ostream& out,
+    const vector<unsigned int>& widths = vector<unsigned int>({25, 50, 100, 200, 400, 800, 1600}),
+    bool allRoundCounts = true, bool includeLUT = false, bool includeCompiled = false,
+    double minimumTime = 0.05);
+
+/**
+  * Function that measures the generic template methods of KeccakF and KeccakFDCLC
+  * on states of packed lanes (see PackedLanes), i.e., the rounds with KeccakF::forward()
+  * and λ in its four modes with KeccakFDCLC::lambda(), against the same template methods
+  * applied to one state of LaneValue after the other. (The dedicated overload of
+  * KeccakF::forward() for LaneValue remains the fastest way to evaluate single states.)
+  * For each width and each number of packed states (4, 8 and 16), the results of both ways
+  * are compared, and the states per second of both ways are output as lines of
+  * comma-separated values, starting with the line of column names.
+  *
+  * @param  out         The stream to write the results to.
+  * @param  widths      The widths to measure.
+  * @param  minimumTime The minimum duration, in seconds, of each measurement.
+  * @return Whether the packed lanes gave the same results as the individual states.
+  */
+bool benchmarkPackedLanes(ostream& out,
+    const vector<unsigned int>& widths = vector<unsigned int>({25, 200, 1600}),
+    double minimumTime = 0.05);
+
+#endif
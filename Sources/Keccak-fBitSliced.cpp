@@ -0,0 +1,114 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <algorithm>
+#include <string.h>
+#include "Keccak-fBitSliced.h"
+
+using namespace std;
+
+const unsigned int KeccakFBitSliced::bitSlicedInstances;
+
+KeccakFBitSliced::KeccakFBitSliced(unsigned int aWidth, int aStartRoundIndex, unsigned int aNrRounds)
+    : KeccakFanyRounds(aWidth, aStartRoundIndex, aNrRounds)
+{
+}
+
+KeccakFBitSliced::KeccakFBitSliced(unsigned int aWidth)
+    : KeccakFanyRounds(aWidth)
+{
+}
+
+void KeccakFBitSliced::applyBatch(UINT8 * states, unsigned int count) const
+{
+    unsigned int stateSize = (width+7)/8;
+    BitSlicedWord S[1600];
+    for(unsigned int first=0; first<count; first+=bitSlicedInstances) {
+        unsigned int n = min(bitSlicedInstances, count-first);
+        fromBytesToBitSlices(states + first*stateSize, n, S);
+        forwardOnBitSlices(S);
+        fromBitSlicesToBytes(S, n, states + first*stateSize);
+    }
+}
+
+void KeccakFBitSliced::forwardOnBitSlices(BitSlicedWord *S) const
+{
+    for(int i=startRoundIndex; i<startRoundIndex+(int)nrRounds; i++)
+        roundOnBitSlices(S, i);
+}
+
+void KeccakFBitSliced::roundOnBitSlices(BitSlicedWord *S, int roundIndex) const
+{
+    const unsigned int w = laneSize;
+    BitSlicedWord B[1600], C[5*64], D[5*64];
+
+    // θ
+    for(unsigned int x=0; x<5; x++)
+        for(unsigned int z=0; z<w; z++)
+            C[x*w+z] = S[x*w+z] ^ S[(x+5)*w+z] ^ S[(x+10)*w+z] ^ S[(x+15)*w+z] ^ S[(x+20)*w+z];
+    for(unsigned int x=0; x<5; x++)
+        for(unsigned int z=0; z<w; z++)
+            D[x*w+z] = C[((x+4)%5)*w+z] ^ C[((x+1)%5)*w+(z+w-1)%w];
+    for(unsigned int i=0; i<25; i++)
+        for(unsigned int z=0; z<w; z++)
+            S[i*w+z] ^= D[(i%5)*w+z];
+
+    // ρ and π, as a relabelling of the words
+    for(unsigned int i=0; i<25; i++) {
+        const BitSlicedWord *source = S + rhoPiSource[i]*w;
+        unsigned int offset = rhoPiOffset[i];
+        memcpy(B + i*w, source + w - offset, offset*sizeof(BitSlicedWord));
+        memcpy(B + i*w + offset, source, (w - offset)*sizeof(BitSlicedWord));
+    }
+
+    // χ
+    for(unsigned int y=0; y<25; y+=5)
+        for(unsigned int x=0; x<5; x++)
+            for(unsigned int z=0; z<w; z++)
+                S[(x+y)*w+z] = B[(x+y)*w+z] ^ ((~B[((x+1)%5+y)*w+z]) & B[((x+2)%5+y)*w+z]);
+
+    // ι
+    LaneValue roundConstant = getRoundConstant(roundIndex);
+    for(unsigned int z=0; z<w; z++)
+        if ((roundConstant >> z) & 1)
+            S[z] = ~S[z];
+}
+
+void KeccakFBitSliced::fromBytesToBitSlices(const UINT8 *states, unsigned int count, BitSlicedWord *S) const
+{
+    unsigned int stateSize = (width+7)/8;
+    memset(S, 0, width*sizeof(BitSlicedWord));
+    for(unsigned int k=0; k<count; k++) {
+        const UINT8 *state = states + k*stateSize;
+        for(unsigned int p=0; p<width; p++)
+            S[p] |= (BitSlicedWord)((state[p/8] >> (p%8)) & 1) << k;
+    }
+}
+
+void KeccakFBitSliced::fromBitSlicesToBytes(const BitSlicedWord *S, unsigned int count, UINT8 *states) const
+{
+    unsigned int stateSize = (width+7)/8;
+    for(unsigned int k=0; k<count; k++) {
+        UINT8 *state = states + k*stateSize;
+        memset(state, 0, stateSize);
+        for(unsigned int p=0; p<width; p++)
+            state[p/8] |= (UINT8)(((S[p] >> k) & 1) << (p%8));
+    }
+}
+
+string KeccakFBitSliced::getDescription() const
+{
+    return "Bit-sliced " + KeccakF::getDescription();
+}
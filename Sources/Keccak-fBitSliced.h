@@ -0,0 +1,100 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFBITSLICED_H_
+#define _KECCAKFBITSLICED_H_
+
+#include "Keccak-f.h"
+
+using namespace std;
+
+/** The type of a word holding one bit position of bitSlicedInstances instances. */
+typedef UINT64 BitSlicedWord;
+
+/**
+  * Class implementing Keccak-<i>f</i> in a bit-sliced way, i.e., processing
+  * 64 independent instances at once. The state of the 64 instances is
+  * represented as getWidth() words of type BitSlicedWord: the word with index
+  * laneSize*index(x,y)+z contains bit (x,y,z) of the instances, with instance
+  * @a k in bit @a k of the word. In this representation, ρ and π become a
+  * relabelling of the words, and θ, χ and ι become word-wide boolean operations.
+  * This is mostly interesting for the small widths, from
+  * Keccak-<i>f</i>[25] to Keccak-<i>f</i>[200].
+  */
+class KeccakFBitSliced : public KeccakFanyRounds {
+public:
+    /** The number of instances processed together. */
+    static const unsigned int bitSlicedInstances = 64;
+public:
+    /**
+      * The constructor. See KeccakFanyRounds() for more details.
+      */
+    KeccakFBitSliced(unsigned int aWidth, int aStartRoundIndex, unsigned int aNrRounds);
+    /**
+      * The constructor, with the nominal number of rounds.
+      */
+    KeccakFBitSliced(unsigned int aWidth);
+    /**
+      * Method that applies the permutation onto @a count states stored
+      * one after the other, going through the bit-sliced representation
+      * in groups of bitSlicedInstances states.
+      *
+      * @param  states  A buffer containing @a count states, each of
+      *                 ceil(getWidth()/8.0) bytes.
+      * @param  count   The number of states in @a states.
+      */
+    void applyBatch(UINT8 * states, unsigned int count) const;
+    /**
+      * Method that applies the permutation onto bitSlicedInstances instances
+      * in the bit-sliced representation.
+      *
+      * @param  S       An array of getWidth() words.
+      */
+    void forwardOnBitSlices(BitSlicedWord *S) const;
+    /**
+      * Method that applies the round function onto bitSlicedInstances
+      * instances in the bit-sliced representation.
+      *
+      * @param  S       An array of getWidth() words.
+      * @param  roundIndex  The round index.
+      */
+    void roundOnBitSlices(BitSlicedWord *S, int roundIndex) const;
+    /**
+      * Method that converts up to bitSlicedInstances states into the
+      * bit-sliced representation. The instances beyond @a count are set to zero.
+      *
+      * @param  states  A buffer containing @a count states, each of
+      *                 ceil(getWidth()/8.0) bytes.
+      * @param  count   The number of states, at most bitSlicedInstances.
+      * @param  S       An array of getWidth() words.
+      */
+    void fromBytesToBitSlices(const UINT8 *states, unsigned int count, BitSlicedWord *S) const;
+    /**
+      * Method that converts the first @a count instances of the bit-sliced
+      * representation back into states.
+      *
+      * @param  S       An array of getWidth() words.
+      * @param  count   The number of states, at most bitSlicedInstances.
+      * @param  states  A buffer receiving @a count states, each of
+      *                 ceil(getWidth()/8.0) bytes.
+      */
+    void fromBitSlicesToBytes(const BitSlicedWord *S, unsigned int count, UINT8 *states) const;
+    /**
+      * Method that returns a string describing the instance.
+      */
+    string getDescription() const;
+};
+
+#endif
@@ -22,7 +22,7 @@ using namespace std;
 KeccakFCodeGen::KeccakFCodeGen(unsigned int aWidth)
     : KeccakF(aWidth), interleavingFactor(1),
     wordSize(laneSize), outputMacros(false), outputSubscripts(false),
-    scheduleType(1)
+    scheduleType(1), instructionSet(noSIMD)
 {
 }
 
@@ -48,6 +48,28 @@ void KeccakFCodeGen::setScheduleType(unsigned int aScheduleType)
         scheduleType = aScheduleType;
 }
 
+void KeccakFCodeGen::setSIMDInstructionSet(SIMDInstructionSet anInstructionSet)
+{
+    instructionSet = anInstructionSet;
+    if (instructionSet != noSIMD)
+        outputMacros = true;
+}
+
+unsigned int KeccakFCodeGen::getSIMDParallelism() const
+{
+    switch(instructionSet) {
+        case SSE2:
+        case NEON:
+            return 128/wordSize;
+        case AVX2:
+            return 256/wordSize;
+        case AVX512:
+            return 512/wordSize;
+        default:
+            return 1;
+    }
+}
+
 void KeccakFCodeGen::displayRoundConstants()
 {
     for(unsigned int i=0; i<roundConstants.size(); ++i) {
@@ -592,6 +614,8 @@ void KeccakFCodeGen::genMacroFile(ostream& fout, bool laneComplementing) const
     fout << "http://creativecommons.org/publicdomain/zero/1.0/" << endl;
     fout << "*/" << endl;
     fout << endl;
+    if (instructionSet != noSIMD)
+        genSIMDMacroDefinitions(fout);
     fout << "#define declareABCDE \\" << endl;
     genDeclarations(fout);
     fout << "#define prepareTheta \\" << endl;
@@ -639,6 +663,78 @@ void KeccakFCodeGen::genMacroFile(ostream& fout, bool laneComplementing) const
     genCopyStateVariables(fout);
 }
 
+void KeccakFCodeGen::genSIMDMacroDefinitions(ostream& fout) const
+{
+    if ((wordSize != 32) && (wordSize != 64))
+        throw KeccakException("The SIMD macro definitions are only available for 32-bit and 64-bit words.");
+    string header, type, AND, OR, XOR, ANDNOT, SET1, LOAD, STORE, ROL;
+    stringstream w, complement;
+    w << dec << wordSize;
+    complement << "0x" << hex << (wordSize == 64 ? "FFFFFFFFFFFFFFFFULL" : "FFFFFFFFUL");
+    switch(instructionSet) {
+        case SSE2:
+        case AVX2:
+        case AVX512: {
+            string prefix = (instructionSet == SSE2) ? "_mm" : ((instructionSet == AVX2) ? "_mm256" : "_mm512");
+            string size = (instructionSet == SSE2) ? "128" : ((instructionSet == AVX2) ? "256" : "512");
+            string epi = "_epi" + w.str();
+            header = (instructionSet == SSE2) ? "emmintrin.h" : "immintrin.h";
+            type = "__m" + size + "i";
+            AND = prefix + "_and_si" + size + "(a, b)";
+            OR = prefix + "_or_si" + size + "(a, b)";
+            XOR = prefix + "_xor_si" + size + "(a, b)";
+            ANDNOT = prefix + "_andnot_si" + size + "(a, b)";
+            SET1 = prefix + "_set1" + epi + (((wordSize == 64) && (instructionSet != AVX512)) ? "x" : "") + "(a)";
+            LOAD = prefix + "_loadu_si" + size + "((const V" + w.str() + " *)&(a))";
+            STORE = prefix + "_storeu_si" + size + "((V" + w.str() + " *)&(a), b)";
+            if (instructionSet == AVX512)
+                ROL = prefix + "_rol" + epi + "(a, o)";
+            else
+                ROL = prefix + "_or_si" + size + "(" + prefix + "_slli" + epi + "(a, o), "
+                    + prefix + "_srli" + epi + "(a, " + w.str() + "-(o)))";
+            break;
+        }
+        case NEON: {
+            string u = "_u" + w.str();
+            header = "arm_neon.h";
+            type = "uint" + w.str() + "x" + (wordSize == 64 ? "2" : "4") + "_t";
+            AND = "vandq" + u + "(a, b)";
+            OR = "vorrq" + u + "(a, b)";
+            XOR = "veorq" + u + "(a, b)";
+            ANDNOT = "vbicq" + u + "(b, a)";
+            SET1 = "vdupq_n" + u + "(a)";
+            LOAD = "vld1q" + u + "((const uint" + w.str() + "_t *)&(a))";
+            STORE = "vst1q" + u + "((uint" + w.str() + "_t *)&(a), b)";
+            ROL = "vsliq_n" + u + "(vshrq_n" + u + "(a, " + w.str() + "-(o)), a, o)";
+            break;
+        }
+        default:
+            throw KeccakException("No SIMD instruction set has been selected.");
+    }
+    const string W = w.str();
+    fout << "// --- SIMD macro definitions: " << dec << getSIMDParallelism() << " instances in parallel, ";
+    fout << "each variable holding the same " << wordSize << "-bit word of all instances" << endl;
+    fout << "#include <" << header << ">" << endl;
+    fout << "typedef " << type << " V" << W << ";" << endl;
+    fout << "#define CONST" << W << "(a)      " << SET1 << endl;
+    fout << "#define LOAD" << W << "(a)       " << LOAD << endl;
+    fout << "#define STORE" << W << "(a, b)   " << STORE << endl;
+    fout << "#define XOR" << W << "(a, b)     " << XOR << endl;
+    fout << "#define XOReq" << W << "(a, b)   a = XOR" << W << "(a, b)" << endl;
+    fout << "#define ROL" << W << "(a, o)     " << ROL << endl;
+    fout << "#define NOT" << W << "(a)        XOR" << W << "(a, CONST" << W << "(" << complement.str() << "))" << endl;
+    fout << "#define ANDuu" << W << "(a, b)   " << AND << endl;
+    fout << "#define ANDnu" << W << "(a, b)   " << ANDNOT << endl;
+    fout << "#define ANDun" << W << "(a, b)   ANDnu" << W << "(b, a)" << endl;
+    fout << "#define ANDnn" << W << "(a, b)   NOT" << W << "(OR" << W << "(a, b))" << endl;
+    fout << "#define ORuu" << W << "(a, b)    " << OR << endl;
+    fout << "#define ORnu" << W << "(a, b)    NOT" << W << "(ANDun" << W << "(a, b))" << endl;
+    fout << "#define ORun" << W << "(a, b)    NOT" << W << "(ANDnu" << W << "(a, b))" << endl;
+    fout << "#define ORnn" << W << "(a, b)    NOT" << W << "(ANDuu" << W << "(a, b))" << endl;
+    fout << "#define OR" << W << "(a, b)      " << OR << endl;
+    fout << endl;
+}
+
 string KeccakFCodeGen::strROL(const string& symbol, unsigned int amount) const
 {
     stringstream str;
@@ -25,6 +25,11 @@ using namespace std;
   * Class implementing code generation for the Keccak-<i>f</i> permutations.
   */
 class KeccakFCodeGen : public KeccakF {
+public:
+    /** The instruction sets for which SIMD macro definitions can be generated,
+      * see setSIMDInstructionSet().
+      */
+    enum SIMDInstructionSet { noSIMD, SSE2, AVX2, AVX512, NEON };
 protected:
      /** The interleaving factor, i.e., the ratio between the lane size and the
        * target word size. For instance, to generate 32-bit interleaved code
@@ -48,6 +53,10 @@ protected:
       * It must be 1 or 2. By default, it is 1.
       */
     unsigned int scheduleType;
+    /** The instruction set targeted by the generated macro definitions.
+      * By default, it is noSIMD, meaning that no definitions are output.
+      */
+    SIMDInstructionSet instructionSet;
 public:
     /**
       * The constructor. See KeccakF() for more details.
@@ -85,6 +94,23 @@ public:
       * @param  aScheduleType   The schedule type, 1 or 2.
       */
     void setScheduleType(unsigned int aScheduleType);
+    /**
+      * Method to set the SIMD instruction set for which genMacroFile() also
+      * outputs the definitions of the macros (V64, XOR64, ROL64, ANDnu64, etc.).
+      * Each variable then holds the same word of several independent
+      * instances, one per word of the SIMD register, see getSIMDParallelism().
+      * Setting an instruction set other than noSIMD also turns on
+      * setOutputMacros(true).
+      *
+      * @param  anInstructionSet    The instruction set.
+      */
+    void setSIMDInstructionSet(SIMDInstructionSet anInstructionSet);
+    /**
+      * Method that returns the number of instances processed in parallel
+      * by the generated code, i.e., the number of words per SIMD register
+      * (or 1 if no instruction set is selected).
+      */
+    unsigned int getSIMDParallelism() const;
     /**
       * Method that displays the round constants.
       */
@@ -182,6 +208,14 @@ public:
       *                 straightforward code.
       */
     void genMacroFile(ostream& fout, bool laneComplementing=false) const;
+    /**
+      * Method that generates the definitions of the macros used by the code
+      * produced with setOutputMacros(true), in terms of the intrinsics of
+      * the selected SIMD instruction set. The word size must be 32 or 64.
+      *
+      * @param  fout    The output stream where the code is generated.
+      */
+    void genSIMDMacroDefinitions(ostream& fout) const;
     /**
       * Method that generates C code to compute four rounds in place.
       * See “Keccak implementation overview”, Section “Efficient in-place implementations”
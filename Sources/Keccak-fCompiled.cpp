@@ -0,0 +1,248 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <thread>
+#include <unistd.h>
+#endif
+#include "Keccak-fCodeGen.h"
+#include "Keccak-fCompiled.h"
+
+using namespace std;
+
+// The lanes complemented before θ when lane complementing is used,
+// see KeccakFCodeGen::genMacroFile().
+static const SliceValue laneComplementingMask = 0x121106;
+
+KeccakFCompiled::KeccakFCompiled(unsigned int aWidth, int aStartRoundIndex, unsigned int aNrRounds,
+    unsigned int anInterleavingFactor, bool aLaneComplementing, const string& compiler)
+    : KeccakFanyRounds(aWidth, aStartRoundIndex, aNrRounds),
+    interleavingFactor(anInterleavingFactor), wordSize(laneSize/anInterleavingFactor),
+    laneComplementing(aLaneComplementing), library(0), kernel(0)
+{
+    if (laneSize < 8)
+        throw KeccakException("KeccakFCompiled requires a lane size of at least 8 bits.");
+    if ((interleavingFactor == 0) || ((laneSize % interleavingFactor) != 0) || (wordSize < 8))
+        throw KeccakException("The interleaving factor must divide the lane size and leave words of at least 8 bits.");
+    load(compiler);
+}
+
+KeccakFCompiled::~KeccakFCompiled()
+{
+#ifndef _WIN32
+    if (library != 0)
+        dlclose(library);
+#endif
+}
+
+void KeccakFCompiled::operator()(UINT8 * state) const
+{
+    LaneValue A[25];
+    UINT64 words[25*8];
+    fromBytesToLanes(state, A);
+    fromLanesToWords(A, words);
+    kernel(words);
+    fromWordsToLanes(words, A);
+    fromLanesToBytes(A, state);
+}
+
+void KeccakFCompiled::applyBatch(UINT8 * states, unsigned int count) const
+{
+    Transformation::applyBatch(states, count);
+}
+
+void KeccakFCompiled::fromLanesToWords(const LaneValue *lanes, UINT64 *words) const
+{
+    const UINT64 wordMask = (~(UINT64)0) >> (64-wordSize);
+    for(unsigned int i=0; i<25; i++) {
+        for(unsigned int zeta=0; zeta<interleavingFactor; zeta++) {
+            UINT64 word = 0;
+            for(unsigned int z=zeta; z<laneSize; z+=interleavingFactor)
+                word |= ((lanes[i] >> z) & 1) << (z/interleavingFactor);
+            if (laneComplementing && (((laneComplementingMask >> i) & 1) != 0))
+                word ^= wordMask;
+            words[i*interleavingFactor+zeta] = word;
+        }
+    }
+}
+
+void KeccakFCompiled::fromWordsToLanes(const UINT64 *words, LaneValue *lanes) const
+{
+    const UINT64 wordMask = (~(UINT64)0) >> (64-wordSize);
+    for(unsigned int i=0; i<25; i++) {
+        lanes[i] = 0;
+        for(unsigned int zeta=0; zeta<interleavingFactor; zeta++) {
+            UINT64 word = words[i*interleavingFactor+zeta] & wordMask;
+            if (laneComplementing && (((laneComplementingMask >> i) & 1) != 0))
+                word ^= wordMask;
+            for(unsigned int z=zeta; z<laneSize; z+=interleavingFactor)
+                lanes[i] |= ((word >> (z/interleavingFactor)) & 1) << z;
+        }
+    }
+}
+
+void KeccakFCompiled::generateSource(const string& fileName) const
+{
+    KeccakFCodeGen codeGen(width);
+    codeGen.setInterleavingFactor(interleavingFactor);
+    ofstream fout(fileName.c_str());
+    if (!fout)
+        throw KeccakException("Cannot open " + fileName + " for writing.");
+    fout << "typedef unsigned char UINT8;" << endl;
+    fout << "typedef unsigned short UINT16;" << endl;
+    fout << "typedef unsigned int UINT32;" << endl;
+    fout << "typedef unsigned long long UINT64;" << endl;
+    fout << "#define ROL" << dec << wordSize << "(a, offset) ((UINT" << wordSize << ")(((UINT" << wordSize
+        << ")(a) << (offset)) ^ ((UINT" << wordSize << ")(a) >> (" << wordSize << "-(offset)))))" << endl;
+    if (laneComplementing)
+        fout << "#define UseBebigokimisa" << endl;
+    fout << endl;
+    codeGen.genMacroFile(fout, laneComplementing);
+    fout << "#define roundConstantIndex(i) ((((i) % 255) + 255) % 255)" << endl;
+    fout << endl;
+    fout << "void KeccakToolsKernel(UINT64 *state)" << endl;
+    fout << "{" << endl;
+    fout << "    declareABCDE" << endl;
+    fout << "    int i;" << endl;
+    fout << endl;
+    fout << "    copyFromState(A, state)" << endl;
+    fout << "    prepareTheta" << endl;
+    fout << "    for(i=" << dec << startRoundIndex << "; i+1<" << (startRoundIndex+(int)nrRounds) << "; i+=2) {" << endl;
+    fout << "        thetaRhoPiChiIotaPrepareTheta(roundConstantIndex(i), A, E)" << endl;
+    fout << "        thetaRhoPiChiIotaPrepareTheta(roundConstantIndex(i+1), E, A)" << endl;
+    fout << "    }" << endl;
+    if ((nrRounds % 2) == 1) {
+        fout << "    thetaRhoPiChiIotaPrepareTheta(roundConstantIndex(" << (startRoundIndex+(int)nrRounds-1) << "), A, E)" << endl;
+        fout << "    copyStateVariables(A, E)" << endl;
+    }
+    fout << "    copyToState(state, A)" << endl;
+    fout << "}" << endl;
+}
+
+#ifndef _WIN32
+/** Returns @a path between single quotes for the shell, with its own single quotes escaped. */
+static string quoteForShell(const string& path)
+{
+    string quoted = "'";
+    for(unsigned int i=0; i<path.size(); i++)
+        if (path[i] == '\'')
+            quoted += "'\\''";
+        else
+            quoted += path[i];
+    return quoted + "'";
+}
+
+/** Returns a short tag that identifies the compiler command, so that libraries built with other flags are not reused. */
+static string compilerTag(const string& compiler)
+{
+    UINT64 hash = 0xCBF29CE484222325ULL; // FNV-1a
+    for(unsigned int i=0; i<compiler.size(); i++) {
+        hash ^= (UINT8)compiler[i];
+        hash *= 0x100000001B3ULL;
+    }
+    stringstream tag;
+    tag << hex << setw(16) << setfill('0') << hash;
+    return tag.str();
+}
+#endif
+
+void KeccakFCompiled::load(const string& compiler)
+{
+#ifdef _WIN32
+    (void)compiler;
+    throw KeccakException("KeccakFCompiled is not supported on this platform.");
+#else
+    string baseName = buildFileName("./", "-" + compilerTag(compiler));
+    string libraryFileName = baseName + ".so";
+    for(unsigned int attempt=0; attempt<2; attempt++) {
+        // A library left by a previous run is tried first; if it cannot be loaded,
+        // e.g., because it was truncated, or if it fails the check, it is compiled again.
+        bool cached = (attempt == 0);
+        if (!cached) {
+            // The code is generated and compiled under a unique temporary name, then renamed,
+            // so that concurrent processes never load a partial library.
+            stringstream temporaryName;
+            temporaryName << baseName << ".tmp" << hex << chrono::steady_clock::now().time_since_epoch().count()
+                << "-" << getpid() << "-" << this_thread::get_id();
+            string sourceFileName = temporaryName.str() + ".c";
+            string temporaryLibraryFileName = temporaryName.str() + ".so";
+            generateSource(sourceFileName);
+            string command = compiler + " -fPIC -shared -o " + quoteForShell(temporaryLibraryFileName) + " " + quoteForShell(sourceFileName);
+            int status = system(command.c_str());
+            if ((status == 0) && (rename(temporaryLibraryFileName.c_str(), libraryFileName.c_str()) == 0))
+                rename(sourceFileName.c_str(), (baseName + ".c").c_str());
+            else {
+                remove(temporaryLibraryFileName.c_str());
+                remove(sourceFileName.c_str());
+                throw KeccakException("The compilation of " + sourceFileName + " failed.");
+            }
+        }
+        library = dlopen(libraryFileName.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (library == 0) {
+            const char *error = dlerror();
+            if (cached)
+                continue;
+            throw KeccakException("Cannot load " + libraryFileName + ": " + ((error != 0) ? error : "unknown error"));
+        }
+        kernel = (void (*)(void *))dlsym(library, "KeccakToolsKernel");
+        if ((kernel != 0) && selfCheck())
+            return;
+        dlclose(library);
+        library = 0;
+        kernel = 0;
+    }
+    throw KeccakException("The compiled code in " + libraryFileName + " does not match KeccakF.");
+#endif
+}
+
+bool KeccakFCompiled::selfCheck() const
+{
+    unsigned int stateSize = (width+7)/8;
+    UINT8 state[200], reference[200];
+    for(unsigned int test=0; test<4; test++) {
+        for(unsigned int i=0; i<stateSize; i++)
+            state[i] = (test == 0) ? 0 : (UINT8)(i*37 + test*101 + (i*i*test)%251);
+        memcpy(reference, state, stateSize);
+        KeccakF::operator()(reference);
+        (*this)(state);
+        if (memcmp(state, reference, stateSize) != 0)
+            return false;
+    }
+    return true;
+}
+
+string KeccakFCompiled::getDescription() const
+{
+    return KeccakF::getDescription() + " (compiled generated code)";
+}
+
+string KeccakFCompiled::getName() const
+{
+    stringstream a;
+    a << KeccakF::getName() << "-gen";
+    if (interleavingFactor > 1)
+        a << "-int" << dec << interleavingFactor;
+    if (laneComplementing)
+        a << "-lc";
+    return a.str();
+}
@@ -0,0 +1,104 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFCOMPILED_H_
+#define _KECCAKFCOMPILED_H_
+
+#include <string>
+#include "Keccak-f.h"
+
+using namespace std;
+
+/**
+  * Class implementing Keccak-<i>f</i> with code generated by KeccakFCodeGen,
+  * compiled into a shared library and loaded at run time.
+  * At construction, the C code is generated and compiled, unless a shared
+  * library with the same name (see getName()) and compiler command already exists
+  * in the current directory, and it is checked against KeccakF::operator() before being used.
+  * A library that cannot be loaded or that fails the check is compiled again.
+  * The code is compiled under a temporary name, then renamed, so that several
+  * processes can share the same directory.
+  * The inverse and the template methods remain those of KeccakF, which
+  * serves as the reference.
+  * This is only available on platforms that support dlopen().
+  */
+class KeccakFCompiled : public KeccakFanyRounds {
+protected:
+    /** The interleaving factor of the generated code, see KeccakFCodeGen::setInterleavingFactor(). */
+    unsigned int interleavingFactor;
+    /** The word size of the generated code, equal to laneSize/interleavingFactor. */
+    unsigned int wordSize;
+    /** Whether the generated code uses the lane complementing transform. */
+    bool laneComplementing;
+    /** The handle to the loaded shared library. */
+    void *library;
+    /** The function of the shared library that applies the rounds onto an array of words. */
+    void (*kernel)(void *words);
+public:
+    /**
+      * The constructor.
+      *
+      * @param  aWidth      The width of the Keccak-<i>f</i> permutation,
+      *                     between 200 and 1600 (so that words have at least 8 bits).
+      * @param  aStartRoundIndex    The index of the first round to perform.
+      * @param  aNrRounds   The desired number of rounds.
+      * @param  anInterleavingFactor    The interleaving factor of the generated code.
+      * @param  aLaneComplementing  Whether the generated code uses lane complementing.
+      * @param  compiler    The command used to compile the generated code, to which
+      *                     the options to produce a shared library are appended.
+      */
+    KeccakFCompiled(unsigned int aWidth, int aStartRoundIndex, unsigned int aNrRounds,
+        unsigned int anInterleavingFactor = 1, bool aLaneComplementing = false,
+        const string& compiler = "cc -O3");
+    /**
+      * The destructor, which unloads the shared library.
+      */
+    ~KeccakFCompiled();
+    /**
+      * Method that applies the permutation onto the parameter @a state
+      * using the compiled code.
+      */
+    void operator()(UINT8 * state) const;
+    /**
+      * Method that applies the permutation onto @a count states stored one
+      * after the other using the compiled code.
+      */
+    void applyBatch(UINT8 * states, unsigned int count) const;
+    /**
+      * Method that returns a string describing the instance.
+      */
+    string getDescription() const;
+    /**
+      * Method that returns a short string that uniquely identifies the
+      * instance, including the options of the generated code.
+      */
+    string getName() const;
+protected:
+    /** Method that writes the C code of the kernel into the given file. */
+    void generateSource(const string& fileName) const;
+    /** Method that compiles and loads the kernel, then checks it. */
+    void load(const string& compiler);
+    /** Method that checks the kernel against KeccakF::operator() on a few states. */
+    bool selfCheck() const;
+    /** Method that converts 25 lanes into the (possibly interleaved and complemented) words of the kernel. */
+    void fromLanesToWords(const LaneValue *lanes, UINT64 *words) const;
+    /** Method that converts the words of the kernel back into 25 lanes. */
+    void fromWordsToLanes(const UINT64 *words, LaneValue *lanes) const;
+private:
+    KeccakFCompiled(const KeccakFCompiled&);
+    KeccakFCompiled& operator=(const KeccakFCompiled&);
+};
+
+#endif
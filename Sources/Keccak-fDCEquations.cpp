@@ -55,8 +55,8 @@ void KeccakFDCEquations::buildDCTrailFromPair(const vector<SliceValue>& a1, cons
     }
 }
 
-void KeccakFDCEquations::getDCEquations(RowValue diffIn, RowValue diffOut,
-    const vector<SymbolicBit>& inputVariables, vector<SymbolicBit>& inputRelations) const
+void KeccakFDCEquations::getDCConditions(RowValue diffIn, RowValue diffOut,
+    vector<RowValue>& masks, vector<bool>& values) const
 {
     RowValue diffOutXorChiDiffIn = diffOut ^ chiOnRow(diffIn);
     // Note: when diffIn=11111, 5 equations are generated, the fifth being redundant with the 4 first
@@ -66,31 +66,41 @@ void KeccakFDCEquations::getDCEquations(RowValue diffIn, RowValue diffOut,
         // in:  .X-
         // out: a_i+2 = ...
         if ((t & 0x6) == 0x2) {
-            SymbolicBit relation = inputVariables[(i+2)%nrRowsAndColumns];
-            if (addOne)
-                relation.complement();
-            inputRelations.push_back(relation);
+            masks.push_back(1 << ((i+2)%nrRowsAndColumns));
+            values.push_back(addOne);
         }
         // in:  .XX
         // out: a_i+1 + a_i+2 = ...
         if ((t & 0x6) == 0x6) {
-            SymbolicBit relation = inputVariables[(i+1)%nrRowsAndColumns];
-            relation.add(inputVariables[(i+2)%nrRowsAndColumns]);
-            if (addOne)
-                relation.complement();
-            inputRelations.push_back(relation);
+            masks.push_back((1 << ((i+1)%nrRowsAndColumns)) | (1 << ((i+2)%nrRowsAndColumns)));
+            values.push_back(addOne);
         }
         // in:  --X
         // out: a_i+1 = ...
         if ((t & 0x7) == 0x4) {
-            SymbolicBit relation = inputVariables[(i+1)%nrRowsAndColumns];
-            if (addOne)
-                relation.complement();
-            inputRelations.push_back(relation);
+            masks.push_back(1 << ((i+1)%nrRowsAndColumns));
+            values.push_back(addOne);
         }
     }
 }
 
+void KeccakFDCEquations::getDCEquations(RowValue diffIn, RowValue diffOut,
+    const vector<SymbolicBit>& inputVariables, vector<SymbolicBit>& inputRelations) const
+{
+    vector<RowValue> masks;
+    vector<bool> values;
+    getDCConditions(diffIn, diffOut, masks, values);
+    for(unsigned int i=0; i<masks.size(); i++) {
+        SymbolicBit relation;
+        for(unsigned int x=0; x<nrRowsAndColumns; x++)
+            if ((masks[i] >> x) & 1)
+                relation.add(inputVariables[x]);
+        if (values[i])
+            relation.complement();
+        inputRelations.push_back(relation);
+    }
+}
+
 void KeccakFDCEquations::getDCEquations(const vector<SliceValue>& diffIn,
     const vector<SliceValue>& diffOut, const vector<SymbolicLane>& input,
     vector<SymbolicBit>& inputRelations) const
@@ -130,7 +140,7 @@ void KeccakFDCEquations::genDCEquations(ostream& fout, const Trail& trail, bool
         vector<SymbolicBit> relations;
         getDCEquations(trail.states[r], stateAfterChi, variables, relations);
         for(unsigned int i=0; i<relations.size(); i++) {
-            fout << relations[i].value;
+            fout << relations[i];
             if (forSage)
                 fout << ",";
             else
@@ -153,6 +163,183 @@ void KeccakFDCEquations::genDCEquations(ostream& fout, const Trail& trail, bool
     }
 }
 
+/** This class writes clauses in the DIMACS CNF format, or only counts them.
+  * The XOR relations are written as XOR clauses, or split into plain clauses.
+  */
+class DIMACSWriter {
+protected:
+    ostream *fout;
+    bool useXORClauses;
+public:
+    /** The number of variables, including the auxiliary variables created so far. */
+    unsigned int nrVariables;
+    /** The number of clauses written or counted so far. */
+    UINT64 nrClauses;
+public:
+    /** The constructor.
+      * @param  aFout   The stream to write to, or 0 to only count the clauses.
+      * @param  aUseXORClauses  Whether to write the XOR relations as XOR clauses.
+      * @param  aNrVariables    The number of variables before the auxiliary ones.
+      */
+    DIMACSWriter(ostream *aFout, bool aUseXORClauses, unsigned int aNrVariables)
+        : fout(aFout), useXORClauses(aUseXORClauses), nrVariables(aNrVariables), nrClauses(0) {}
+    /** This method tells whether the clauses are written, as opposed to only counted. */
+    bool isWriting() const { return fout != 0; }
+    /** This method writes a clause, each literal being a variable or its negation. */
+    void addClause(const vector<int>& literals)
+    {
+        nrClauses++;
+        if (fout) {
+            for(unsigned int i=0; i<literals.size(); i++)
+                (*fout) << literals[i] << " ";
+            (*fout) << "0\n";
+        }
+    }
+    /** This method writes the relation saying that the sum of @a variables is @a value. */
+    void addXOR(vector<unsigned int> variables, bool value)
+    {
+        if (useXORClauses) {
+            nrClauses++;
+            if (fout) {
+                (*fout) << "x";
+                for(unsigned int i=0; i<variables.size(); i++)
+                    (*fout) << ((i == 0) && (!value) ? "-" : "") << variables[i] << " ";
+                (*fout) << "0\n";
+            }
+            return;
+        }
+        // The first 3 variables are replaced by an auxiliary variable equal to their sum.
+        while(variables.size() > 4) {
+            vector<unsigned int> head(variables.begin(), variables.begin()+3);
+            variables.erase(variables.begin(), variables.begin()+3);
+            nrVariables++;
+            head.push_back(nrVariables);
+            variables.push_back(nrVariables);
+            addSmallXOR(head, false);
+        }
+        addSmallXOR(variables, value);
+    }
+protected:
+    /** This method writes the clauses that exclude the values with the wrong parity. */
+    void addSmallXOR(const vector<unsigned int>& variables, bool value)
+    {
+        unsigned int n = (unsigned int)variables.size();
+        vector<int> literals(n);
+        for(unsigned int excluded=0; excluded<((unsigned int)1 << n); excluded++) {
+            bool parity = false;
+            for(unsigned int i=0; i<n; i++)
+                parity ^= ((excluded >> i) & 1) != 0;
+            if (parity == value)
+                continue;
+            for(unsigned int i=0; i<n; i++)
+                literals[i] = ((excluded >> i) & 1) ? -(int)variables[i] : (int)variables[i];
+            addClause(literals);
+        }
+    }
+};
+
+void KeccakFDCEquations::genDCEquationsCNF(ostream& fout, const Trail& trail, bool useXORClauses) const
+{
+    genDCEquationsCNF(fout, trail, vector<SliceValue>(), useXORClauses);
+}
+
+void KeccakFDCEquations::genDCEquationsCNF(ostream& fout, const Trail& trail, const vector<SliceValue>& a1, bool useXORClauses) const
+{
+    if ((!trail.stateAfterLastChiSpecified) || (!trail.firstStateSpecified))
+        throw KeccakException("The trail must be fully specified, i.e., it must not be a trail prefix or a trail core.");
+    if ((!a1.empty()) && (a1.size() != laneSize))
+        throw KeccakException("The given state's and trail's lane sizes do not match.");
+    unsigned int nrVariables = (3*trail.states.size() + 1)*width;
+    // The clauses are counted first, as the header comes before them.
+    DIMACSWriter counter(0, useXORClauses, nrVariables);
+    genDCClauses(counter, trail, a1);
+    DIMACSWriter writer(&fout, useXORClauses, nrVariables);
+    fout << "c " << getName() << ", " << dec << trail.states.size() << " rounds, see KeccakFDCEquations::genDCEquationsCNF()" << endl;
+    fout << "p cnf " << counter.nrVariables << " " << counter.nrClauses << endl;
+    genDCClauses(writer, trail, a1);
+}
+
+void KeccakFDCEquations::genDCClauses(DIMACSWriter& writer, const Trail& trail, const vector<SliceValue>& a1) const
+{
+    const unsigned int nrRounds = (unsigned int)trail.states.size();
+    const unsigned int inputOfChi = 1;
+    const unsigned int outputOfChi = 1 + (nrRounds+1)*width;
+    const unsigned int products = 1 + (2*nrRounds+1)*width;
+
+    // For each bit after λ, the bits before λ it depends on
+    vector<vector<unsigned int> > linearInputs(width);
+    for(unsigned int i=0; i<width; i++) {
+        vector<LaneValue> unit(nrRowsAndColumns*nrRowsAndColumns, 0);
+        unit[i/laneSize] = (LaneValue)1 << (i%laneSize);
+        lambda(unit, KeccakFDCLC::Straight);
+        for(unsigned int j=0; j<width; j++)
+            if ((unit[j/laneSize] >> (j%laneSize)) & 1)
+                linearInputs[j].push_back(i);
+    }
+
+    if (!a1.empty()) {
+        vector<LaneValue> state;
+        fromSlicesToLanes(a1, state);
+        lambda(state, KeccakFDCLC::Straight);
+        for(unsigned int i=0; i<width; i++) {
+            int variable = inputOfChi + i;
+            writer.addClause(vector<int>(1, ((state[i/laneSize] >> (i%laneSize)) & 1) ? variable : -variable));
+        }
+    }
+
+    vector<unsigned int> variables;
+    for(unsigned int r=0; r<nrRounds; r++) {
+        // Conditions at the input of χ
+        vector<SliceValue> stateAfterChi;
+        if (r == nrRounds-1)
+            stateAfterChi = trail.stateAfterLastChi;
+        else
+            lambda(trail.states[r+1], stateAfterChi, KeccakFDCLC::Inverse);
+        for(unsigned int z=0; z<laneSize; z++)
+        for(unsigned int y=0; y<nrRowsAndColumns; y++) {
+            RowValue diffInRow = getRowFromSlice(trail.states[r][z], y);
+            if (diffInRow != 0) {
+                vector<RowValue> masks;
+                vector<bool> values;
+                getDCConditions(diffInRow, getRowFromSlice(stateAfterChi[z], y), masks, values);
+                for(unsigned int i=0; i<masks.size(); i++) {
+                    variables.clear();
+                    for(unsigned int x=0; x<nrRowsAndColumns; x++)
+                        if ((masks[i] >> x) & 1)
+                            variables.push_back(inputOfChi + r*width + index(x, y)*laneSize + z);
+                    writer.addXOR(variables, values[i]);
+                }
+            }
+        }
+        // χ
+        for(unsigned int y=0; y<nrRowsAndColumns; y++)
+        for(unsigned int x=0; x<nrRowsAndColumns; x++)
+        for(unsigned int z=0; z<laneSize; z++) {
+            int b0 = inputOfChi + r*width + index(x, y)*laneSize + z;
+            int b1 = inputOfChi + r*width + index(x+1, y)*laneSize + z;
+            int b2 = inputOfChi + r*width + index(x+2, y)*laneSize + z;
+            int t = products + r*width + index(x, y)*laneSize + z;
+            int c = outputOfChi + r*width + index(x, y)*laneSize + z;
+            // t = (b1 + 1) b2 and c = b0 + t
+            writer.addClause(vector<int>{ t, b1, -b2 });
+            writer.addClause(vector<int>{ -t, -b1 });
+            writer.addClause(vector<int>{ -t, b2 });
+            writer.addXOR(vector<unsigned int>{ (unsigned int)c, (unsigned int)b0, (unsigned int)t }, false);
+        }
+        // ι, θ, ρ and π
+        vector<LaneValue> constant(nrRowsAndColumns*nrRowsAndColumns, 0);
+        iota(constant, r);
+        lambda(constant, KeccakFDCLC::Straight);
+        for(unsigned int j=0; j<width; j++) {
+            variables.clear();
+            variables.push_back(inputOfChi + (r+1)*width + j);
+            for(unsigned int k=0; k<linearInputs[j].size(); k++)
+                variables.push_back(outputOfChi + r*width + linearInputs[j][k]);
+            writer.addXOR(variables, ((constant[j/laneSize] >> (j%laneSize)) & 1) != 0);
+        }
+    }
+}
+
 void KeccakFDCEquations::displayEquations(ostream& fout, const vector<SymbolicLane>& state, const string& prefixOutput, bool forSage) const
 {
     for(unsigned int y=0; y<nrRowsAndColumns; y++)
@@ -164,7 +351,7 @@ void KeccakFDCEquations::displayEquations(ostream& fout, const vector<SymbolicLa
             fout << " + ";
         else
             fout << " = ";
-        fout << state[index(x,y)].values[z].value;
+        fout << state[index(x,y)].values[z];
         if (forSage)
             fout << ", ";
         fout << endl;
@@ -19,6 +19,8 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include "Keccak-fEquations.h"
 #include "Keccak-fPropagation.h"
 
+class DIMACSWriter;
+
 /** This class is an extension of KeccakFDCLC with additional functionality
   * to display equations related to a differential trail.
   */
@@ -52,6 +54,38 @@ public:
       *                     Otherwise, the equations are displayed in the form X=f(Y).
       */
     void genDCEquations(ostream& fout, const Trail& trail, bool forSage=false) const;
+    /** This method writes the same equations as genDCEquations() as an instance
+      * for SAT solvers in the DIMACS CNF format, directly from the round structure.
+      * The variables are numbered as follows, with b the width,
+      * n the number of rounds and i = index(x, y)*laneSize + z:
+      * - 1 + r*b + i for the bit (x, y, z) at the input of χ of round r, with 0 ≤ r ≤ n,
+      *     where round n stands for the output of the last round;
+      * - 1 + (n+1)*b + r*b + i for the bit at the output of χ of round r;
+      * - 1 + (2n+1)*b + r*b + i for the auxiliary variable equal to
+      *     the product of the complement of bit (x+1, y, z) and of bit (x+2, y, z) at the input of χ;
+      * - the variables after 1 + (3n+1)*b, if any, are auxiliary variables to split XOR relations.
+      * The χ mapping is encoded with three clauses for the product and an XOR relation per bit,
+      * and the other steps of the rounds with one XOR relation per bit.
+      * The conditions for the pair to follow the trail are XOR relations at the input of χ.
+      * @param   fout       The stream to write to.
+      * @param   trail      The trail to follow, fully specified as for genDCEquations().
+      * @param   useXORClauses  If true, the XOR relations are written as XOR clauses, as
+      *                     understood by CryptoMiniSat, i.e., "x1 -2 3 0" for x1 + x2 + x3 = 0.
+      *                     Otherwise, they are split into XORs of at most 4 variables,
+      *                     each written as 8 clauses or fewer.
+      */
+    void genDCEquationsCNF(ostream& fout, const Trail& trail, bool useXORClauses=true) const;
+    /** This method is the same as genDCEquationsCNF(ostream&, const Trail&, bool),
+      * with in addition unit clauses that fix the value of the first state of the pair,
+      * unless @a a1 is empty.
+      * This can be used to check with a SAT solver that a given pair follows the trail,
+      * in the same spirit as KeccakFEquations::genAbsoluteValuesBeforeChi().
+      * @param   fout       The stream to write to.
+      * @param   trail      The trail to follow.
+      * @param   a1         The first state of the pair before θ, as a vector of slices.
+      * @param   useXORClauses  See genDCEquationsCNF(ostream&, const Trail&, bool).
+      */
+    void genDCEquationsCNF(ostream& fout, const Trail& trail, const vector<SliceValue>& a1, bool useXORClauses=true) const;
     /** This method checks whether a given pair follows a given trail.
       * The state value is given before θ, as in the normal order of
       * the round function.
@@ -77,6 +111,15 @@ protected:
       */
     void getDCEquations(RowValue diffIn, RowValue diffOut,
         const vector<SymbolicBit>& inputVariables, vector<SymbolicBit>& inputRelations) const;
+    /** This method lists the conditions that the input of χ (for one row)
+      * must satisfy for the given input difference to propagate to the given
+      * output difference. Each condition says that the sum of the bits
+      * in masks[i] is equal to values[i].
+      */
+    void getDCConditions(RowValue diffIn, RowValue diffOut,
+        vector<RowValue>& masks, vector<bool>& values) const;
+    /** This method writes the clauses of genDCEquationsCNF(). */
+    void genDCClauses(DIMACSWriter& writer, const Trail& trail, const vector<SliceValue>& a1) const;
     /** This method produces the display of the equations. */
     void displayEquations(ostream& fout, const vector<SymbolicLane>& state, const string& prefixOutput, bool forSage=false) const;
 };
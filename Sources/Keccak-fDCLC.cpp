@@ -58,6 +58,50 @@ void ListOfRowPatterns::display(ostream& fout) const
 }
 
 
+// -------------------------------------------------------------
+//
+// RowPatternTable
+//
+// -------------------------------------------------------------
+
+RowPatternTable::RowPatternTable()
+{
+    for(unsigned int a=0; a<33; a++)
+        offsets[a] = 0;
+    for(unsigned int a=0; a<32; a++) {
+        minWeights[a] = 0;
+        maxWeights[a] = 0;
+    }
+}
+
+RowPatternTable::RowPatternTable(const vector<ListOfRowPatterns>& lists)
+{
+    if (lists.size() != 32)
+        throw KeccakException("RowPatternTable::RowPatternTable() expects 32 lists of row patterns.");
+    offsets[0] = 0;
+    for(unsigned int a=0; a<32; a++) {
+        const ListOfRowPatterns& l = lists[a];
+        for(unsigned int i=0; i<l.values.size(); i++) {
+            values.push_back(l.values[i]);
+            weights.push_back((UINT8)l.weights[i]);
+        }
+        offsets[a+1] = (UINT16)values.size();
+        minWeights[a] = l.minMaxInitialized ? (UINT8)l.minWeight : 0;
+        maxWeights[a] = l.minMaxInitialized ? (UINT8)l.maxWeight : 0;
+    }
+}
+
+RowPatternTable::Range RowPatternTable::getRange(RowValue input) const
+{
+    Range range;
+    range.values = getValues(input);
+    range.weights = getWeights(input);
+    range.size = size(input);
+    range.minWeight = minWeights[input];
+    return range;
+}
+
+
 // -------------------------------------------------------------
 //
 // KeccakFDCLC
@@ -221,98 +265,6 @@ void KeccakFDCLC::displayAll(ostream& fout, KeccakFPropagation *DC, KeccakFPropa
 
 void KeccakFDCLC::initializeLambdaLookupTables()
 {
-    // lambdaRowToSlice
-    {
-        string fileName = buildFileName("", "-lambda.cache");
-        ifstream fin(fileName.c_str(), ios::binary);
-        if (!fin) {
-            for(unsigned int m=0; m<KeccakFDCLC::EndOfLambdaModes ; m++) {
-                vector<vector<vector<vector<SliceValue> > > > vvvv;
-                for(unsigned int outputSlice=0; outputSlice<laneSize; outputSlice++) {
-                    vector<vector<vector<SliceValue> > > vvv;
-                    for(unsigned int inputSlice=0; inputSlice<laneSize; inputSlice++) {
-                        vector<vector<SliceValue> > vv;
-                        for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-                            vector<SliceValue> v(1<<nrRowsAndColumns);
-                            for(RowValue row=0; row<(1<<nrRowsAndColumns); row++) {
-                                vector<LaneValue> state(nrRowsAndColumns*nrRowsAndColumns, 0);
-                                setRow(state, row, y, inputSlice);
-                                lambda(state,KeccakFDCLC::LambdaMode(m));
-                                v[row] = getSlice(state, outputSlice);
-                            }
-                            vv.push_back(v);
-                        }
-                        vvv.push_back(vv);
-                    }
-                    vvvv.push_back(vvv);
-                }
-                lambdaRowToSlice.push_back(vvvv);
-            }
-            ofstream fout(fileName.c_str(), ios::binary);
-            for(unsigned int m=0; m<KeccakFDCLC::EndOfLambdaModes ; m++)
-            for(unsigned int outputSlice=0; outputSlice<laneSize; outputSlice++)
-            for(unsigned int inputSlice=0; inputSlice<laneSize; inputSlice++)
-            for(unsigned int y=0; y<nrRowsAndColumns; y++)
-            for(RowValue row=0; row<(1<<nrRowsAndColumns); row++) {
-                static unsigned char tmp[4];
-                SliceValue v = lambdaRowToSlice[m][outputSlice][inputSlice][y][row];
-                tmp[0] =  v&0xFF;
-                tmp[1] = (v>>8)&0xFF;
-                tmp[2] = (v>>16)&0xFF;
-                tmp[3] = (v>>24)&0xFF;
-                fout.write((char *)tmp, 4);
-            }
-        }
-        else {
-            for(unsigned int m=0; m<KeccakFDCLC::EndOfLambdaModes ; m++) {
-                vector<vector<vector<vector<SliceValue> > > > vvvv;
-                for(unsigned int outputSlice=0; outputSlice<laneSize; outputSlice++) {
-                    vector<vector<vector<SliceValue> > > vvv;
-                    for(unsigned int inputSlice=0; inputSlice<laneSize; inputSlice++) {
-                        vector<vector<SliceValue> > vv;
-                        for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-                            vector<SliceValue> v(1<<nrRowsAndColumns);
-                            for(RowValue row=0; row<(1<<nrRowsAndColumns); row++) {
-                                static unsigned char tmp[4];
-                                fin.read((char *)tmp, 4);
-                                v[row]  = tmp[3];  v[row] <<= 8;
-                                v[row] ^= tmp[2];  v[row] <<= 8;
-                                v[row] ^= tmp[1];  v[row] <<= 8;
-                                v[row] ^= tmp[0];
-                            }
-                            vv.push_back(v);
-                        }
-                        vvv.push_back(vv);
-                    }
-                    vvvv.push_back(vvv);
-                }
-                lambdaRowToSlice.push_back(vvvv);
-            }
-        }
-    }
-    // lambdaBeforeThetaRowToSlice
-    for(unsigned int m=0; m<KeccakFDCLC::EndOfLambdaModes ; m++) {
-        vector<vector<vector<vector<SliceValue> > > > vvvv;
-        for(unsigned int outputSlice=0; outputSlice<laneSize; outputSlice++) {
-            vector<vector<vector<SliceValue> > > vvv;
-            for(unsigned int inputSlice=0; inputSlice<laneSize; inputSlice++) {
-                vector<vector<SliceValue> > vv;
-                for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-                    vector<SliceValue> v(1<<nrRowsAndColumns);
-                    for(RowValue row=0; row<(1<<nrRowsAndColumns); row++) {
-                        vector<LaneValue> state(nrRowsAndColumns*nrRowsAndColumns, 0);
-                        setRow(state, row, y, inputSlice);
-                        lambdaBeforeTheta(state, KeccakFDCLC::LambdaMode(m));
-                        v[row] = getSlice(state, outputSlice);
-                    }
-                    vv.push_back(v);
-                }
-                vvv.push_back(vv);
-            }
-            vvvv.push_back(vvv);
-        }
-        lambdaBeforeThetaRowToSlice.push_back(vvvv);
-    }
     // thetaJustAfterChi
     for(unsigned int mode=0; mode<KeccakFDCLC::EndOfLambdaModes ; mode++) {
         if ((mode == Straight) || (mode == Dual))
@@ -327,74 +279,191 @@ void KeccakFDCLC::initializeLambdaLookupTables()
         else if ((mode == Transpose) || (mode == Inverse))
             thetaJustBeforeChi.push_back(true);
     }
-    // lambdaAfterThetaRowToSlice
+    // lambdaImageOfBit, lambdaBeforeThetaBitMap and lambdaAfterThetaBitMap
+    lambdaImageOfBit.resize(KeccakFDCLC::EndOfLambdaModes);
+    lambdaBeforeThetaBitMap.resize(KeccakFDCLC::EndOfLambdaModes);
+    lambdaAfterThetaBitMap.resize(KeccakFDCLC::EndOfLambdaModes);
     for(unsigned int m=0; m<KeccakFDCLC::EndOfLambdaModes ; m++) {
-        vector<vector<vector<vector<SliceValue> > > > vvvv;
-        for(unsigned int outputSlice=0; outputSlice<laneSize; outputSlice++) {
-            vector<vector<vector<SliceValue> > > vvv;
-            for(unsigned int inputSlice=0; inputSlice<laneSize; inputSlice++) {
-                vector<vector<SliceValue> > vv;
-                for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-                    vector<SliceValue> v(1<<nrRowsAndColumns);
-                    for(RowValue row=0; row<(1<<nrRowsAndColumns); row++) {
-                        vector<LaneValue> state(nrRowsAndColumns*nrRowsAndColumns, 0);
-                        setRow(state, row, y, inputSlice);
-                        lambdaAfterTheta(state, KeccakFDCLC::LambdaMode(m));
-                        v[row] = getSlice(state, outputSlice);
-                    }
-                    vv.push_back(v);
-                }
-                vvv.push_back(vv);
+        bool sparse = (m == Straight) || (m == Transpose);
+        if (sparse)
+            lambdaImageOfBit[m].resize(laneSize*25);
+        lambdaBeforeThetaBitMap[m].resize(laneSize*25);
+        lambdaAfterThetaBitMap[m].resize(laneSize*25);
+        for(unsigned int z=0; z<laneSize; z++)
+        for(unsigned int i=0; i<25; i++) {
+            vector<SliceValue> unit(laneSize, 0);
+            unit[z] = (SliceValue)1 << i;
+            if (sparse) {
+                LaneValue A[25];
+                fromSlicesToLaneArray(unit.data(), A);
+                lambdaOnLanes(A, KeccakFDCLC::LambdaMode(m));
+                vector<SliceValue> image(laneSize);
+                fromLaneArrayToSlices(A, image.data());
+                for(unsigned int outputSlice=0; outputSlice<laneSize; outputSlice++)
+                    if (image[outputSlice] != 0)
+                        lambdaImageOfBit[m][z*25+i].push_back(make_pair(outputSlice, image[outputSlice]));
+            }
+            for(unsigned int part=0; part<2; part++) {
+                vector<LaneValue> state;
+                fromSlicesToLanes(unit, state);
+                if (part == 0)
+                    lambdaBeforeTheta(state, KeccakFDCLC::LambdaMode(m));
+                else
+                    lambdaAfterTheta(state, KeccakFDCLC::LambdaMode(m));
+                vector<SliceValue> image;
+                fromLanesToSlices(state, image);
+                for(unsigned int outputSlice=0; outputSlice<laneSize; outputSlice++)
+                    for(unsigned int j=0; j<25; j++)
+                        if ((image[outputSlice] & ((SliceValue)1 << j)) != 0)
+                            (part == 0 ? lambdaBeforeThetaBitMap : lambdaAfterThetaBitMap)[m][z*25+i] = outputSlice*25+j;
+            }
+        }
+    }
+}
+
+void KeccakFDCLC::lambdaOnLanes(LaneValue *A, LambdaMode mode) const
+{
+    LaneValue B[25], C[5], D[5];
+    if (mode == Straight) {
+        thetaRhoPiOnLanes(A, B);
+    }
+    else if (mode == Dual) {
+        inverseThetaOnLanes(A, true);
+        for(unsigned int i=0; i<25; i++)
+            B[i] = rotateLane(A[rhoPiSource[i]], rhoPiOffset[i]);
+    }
+    else {
+        for(unsigned int i=0; i<25; i++)
+            B[rhoPiSource[i]] = rotateLane(A[i], (rhoPiOffset[i] == 0) ? 0 : laneSize-rhoPiOffset[i]);
+        if (mode == Inverse)
+            inverseThetaOnLanes(B);
+        else {
+            for(unsigned int x=0; x<5; x++)
+                C[x] = B[x] ^ B[x+5] ^ B[x+10] ^ B[x+15] ^ B[x+20];
+            for(unsigned int x=0; x<5; x++)
+                D[x] = rotateLane(C[(x+4)%5], (laneSize-1)%laneSize) ^ C[(x+1)%5];
+            for(unsigned int y=0; y<25; y+=5)
+                for(unsigned int x=0; x<5; x++)
+                    B[x+y] ^= D[x];
+        }
+    }
+    for(unsigned int i=0; i<25; i++)
+        A[i] = B[i];
+}
+
+void KeccakFDCLC::fromSlicesToLaneArray(const SliceValue *slices, LaneValue *lanes) const
+{
+    for(unsigned int i=0; i<25; i++)
+        lanes[i] = 0;
+    for(unsigned int z=0; z<laneSize; z++) {
+        SliceValue slice = slices[z];
+        if (slice != 0)
+            for(unsigned int i=0; i<25; i++)
+                lanes[i] ^= (LaneValue)((slice >> i) & 1) << z;
+    }
+}
+
+void KeccakFDCLC::fromLaneArrayToSlices(const LaneValue *lanes, SliceValue *slices) const
+{
+    for(unsigned int z=0; z<laneSize; z++)
+        slices[z] = 0;
+    for(unsigned int i=0; i<25; i++) {
+        LaneValue lane = lanes[i];
+        if (lane != 0)
+            for(unsigned int z=0; z<laneSize; z++)
+                slices[z] ^= (SliceValue)((lane >> z) & 1) << i;
+    }
+}
+
+void KeccakFDCLC::permuteBits(const SliceValue *in, SliceValue *out, const vector<unsigned int>& bitMap) const
+{
+    for(unsigned int z=0; z<laneSize; z++)
+        out[z] = 0;
+    for(unsigned int z=0; z<laneSize; z++)
+        for(SliceValue slice=in[z], i=0; slice!=0; slice>>=1, i++)
+            if ((slice & 1) != 0) {
+                unsigned int target = bitMap[z*25+i];
+                out[target/25] ^= (SliceValue)1 << (target%25);
             }
-            vvvv.push_back(vvv);
+}
+
+void KeccakFDCLC::lambda(const SliceValue *in, SliceValue *out, LambdaMode mode) const
+{
+    if (!lambdaImageOfBit[mode].empty()) {
+        // Each image has at most 11 active bits, so with few active bits,
+        // XORing their images costs less than transposing the whole state twice.
+        unsigned int nrActiveBits = 0;
+        for(unsigned int z=0; z<laneSize; z++)
+            nrActiveBits += getHammingWeightSlice(in[z]);
+        if (nrActiveBits <= 2*laneSize) {
+            for(unsigned int z=0; z<laneSize; z++)
+                out[z] = 0;
+            for(unsigned int z=0; z<laneSize; z++)
+                for(SliceValue slice=in[z], i=0; slice!=0; slice>>=1, i++)
+                    if ((slice & 1) != 0) {
+                        const vector<pair<unsigned int, SliceValue> >& image = lambdaImageOfBit[mode][z*25+i];
+                        for(unsigned int j=0; j<image.size(); j++)
+                            out[image[j].first] ^= image[j].second;
+                    }
+            return;
         }
-        lambdaAfterThetaRowToSlice.push_back(vvvv);
     }
+    LaneValue A[25];
+    fromSlicesToLaneArray(in, A);
+    lambdaOnLanes(A, mode);
+    fromLaneArrayToSlices(A, out);
 }
 
 void KeccakFDCLC::lambda(const vector<SliceValue>& in, vector<SliceValue>& out, LambdaMode mode) const
 {
     // This assumes that 'in' has size equal to 'laneSize'
-    out.assign(laneSize, 0);
-    for(unsigned int inputSlice=0; inputSlice<laneSize; inputSlice++)
-    for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-        RowValue row = getRowFromSlice(in[inputSlice], y);
-        for(unsigned int outputSlice=0; outputSlice<laneSize; outputSlice++)
-            out[outputSlice] ^= lambdaRowToSlice[mode][outputSlice][inputSlice][y][row];
-    }
+    out.resize(laneSize);
+    lambda(in.data(), out.data(), mode);
+}
+
+void KeccakFDCLC::lambda(const FixedStateAsSlices& in, FixedStateAsSlices& out, LambdaMode mode) const
+{
+    out.resize(laneSize);
+    lambda(in.data(), out.data(), mode);
 }
 
 void KeccakFDCLC::lambdaBeforeTheta(const vector<SliceValue>& in, vector<SliceValue>& out, LambdaMode mode) const
 {
-    if (thetaJustAfterChi[mode]) {
+    if (thetaJustAfterChi[mode])
         out = in;
+    else {
+        out.resize(laneSize);
+        permuteBits(in.data(), out.data(), lambdaBeforeThetaBitMap[mode]);
     }
+}
+
+void KeccakFDCLC::lambdaBeforeTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out, LambdaMode mode) const
+{
+    if (thetaJustAfterChi[mode])
+        out = in;
     else {
-        // This assumes that 'in' has size equal to 'laneSize'
-        out.assign(laneSize, 0);
-        for(unsigned int inputSlice=0; inputSlice<laneSize; inputSlice++)
-        for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-            RowValue row = getRowFromSlice(in[inputSlice], y);
-            for(unsigned int outputSlice=0; outputSlice<laneSize; outputSlice++)
-                out[outputSlice] ^= lambdaBeforeThetaRowToSlice[mode][outputSlice][inputSlice][y][row];
-        }
+        out.resize(laneSize);
+        permuteBits(in.data(), out.data(), lambdaBeforeThetaBitMap[mode]);
     }
 }
 
 void KeccakFDCLC::lambdaAfterTheta(const vector<SliceValue>& in, vector<SliceValue>& out, LambdaMode mode) const
 {
-    if (thetaJustBeforeChi[mode]) {
+    if (thetaJustBeforeChi[mode])
         out = in;
+    else {
+        out.resize(laneSize);
+        permuteBits(in.data(), out.data(), lambdaAfterThetaBitMap[mode]);
     }
+}
+
+void KeccakFDCLC::lambdaAfterTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out, LambdaMode mode) const
+{
+    if (thetaJustBeforeChi[mode])
+        out = in;
     else {
-        // This assumes that 'in' has size equal to 'laneSize'
-        out.assign(laneSize, 0);
-        for(unsigned int inputSlice=0; inputSlice<laneSize; inputSlice++)
-        for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-            RowValue row = getRowFromSlice(in[inputSlice], y);
-            for(unsigned int outputSlice=0; outputSlice<laneSize; outputSlice++)
-                out[outputSlice] ^= lambdaAfterThetaRowToSlice[mode][outputSlice][inputSlice][y][row];
-        }
+        out.resize(laneSize);
+        permuteBits(in.data(), out.data(), lambdaAfterThetaBitMap[mode]);
     }
 }
 
@@ -502,30 +571,84 @@ void KeccakFDCLC::checkLCTrail(const Trail& trail, KeccakFPropagation *LC) const
     }
 }
 
-void KeccakFDCLC::thetaTransEnvelope(vector<LaneValue>& state) const
+bool KeccakFDCLC::checkTrail(const Trail& trail, const KeccakFPropagation& DCorLC, vector<string>& errors) const
 {
-    // We invert the order of bits in lanes and of lanes in planes
-    LaneValue tmp, tmp2;
-    for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-        tmp = state[index(1,y)];
-        state[index(1,y)] = state[index(4,y)];
-        state[index(4,y)] = tmp;
-        tmp = state[index(2,y)];
-        state[index(2,y)] = state[index(3,y)];
-        state[index(3,y)] = tmp;
+    const bool isDC = (DCorLC.getPropagationType() == KeccakFPropagation::DC);
+    const vector<ListOfRowPatterns>& chi = isDC ? diffChi : corrInvChi;
+    const size_t nrErrors = errors.size();
+
+    // Check the structure of the trail
+    if (trail.states.size() != trail.weights.size()) {
+        stringstream error;
+        error << "The trail has " << dec << trail.states.size() << " states but " << trail.weights.size() << " weights.";
+        errors.push_back(error.str());
+        return false;
+    }
+    unsigned int offsetIndex = (trail.firstStateSpecified ? 0 : 1);
+    if ((!trail.firstStateSpecified) && ((trail.states.size() == 0) || (trail.states[0].size() != 0))) {
+        errors.push_back("The trail core does not have an empty first state.");
+        return false;
+    }
+    for(unsigned int i=offsetIndex; i<trail.states.size(); i++)
+        if (trail.states[i].size() != laneSize) {
+            stringstream error;
+            error << "The state at round " << dec << i << " has " << trail.states[i].size() << " slices instead of " << laneSize << ".";
+            errors.push_back(error.str());
+        }
+    if (trail.stateAfterLastChiSpecified && ((trail.stateAfterLastChi.size() != laneSize) || (trail.states.size() <= offsetIndex)))
+        errors.push_back("The state after the last \xCF\x87 is malformed.");
+    if (errors.size() > nrErrors)
+        return false;
+
+    // Check weights
+    unsigned int totalWeight = 0;
+    if (!trail.firstStateSpecified)
+        totalWeight += trail.weights[0];
+    for(unsigned int i=offsetIndex; i<trail.weights.size(); i++) {
+        unsigned int weight = 0;
+        for(unsigned int z=0; z<laneSize; z++)
+            for(unsigned int y=0; y<nrRowsAndColumns; y++)
+                weight += chi[getRowFromSlice(trail.states[i][z], y)].minWeight;
+        if (weight != trail.weights[i]) {
+            stringstream error;
+            error << "The weight of state at round " << dec << i << " is incorrect; it should be " << weight << ".";
+            errors.push_back(error.str());
+        }
+        totalWeight += weight;
+    }
+    if (totalWeight != trail.totalWeight) {
+        stringstream error;
+        error << "The total weight of the trail is incorrect; it should be " << dec << totalWeight << ".";
+        errors.push_back(error.str());
     }
-    for(unsigned int x=0; x<nrRowsAndColumns; x++) {
-        for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-            tmp = state[index(x,y)];
-            tmp2 = 0;
-            for(unsigned int z=0; z<laneSize; z++) {
-                tmp2 ^= tmp&1;
-                ROL(tmp,1);
-                ROL(tmp2,-1);
+
+    // Check compatibility between consecutive states
+    vector<SliceValue> stateAfterChi;
+    for(unsigned int i=1+offsetIndex; i<=trail.states.size(); i++) {
+        const vector<SliceValue> *after = &trail.stateAfterLastChi;
+        if (i < trail.states.size()) {
+            lambda(trail.states[i], stateAfterChi, isDC ? Inverse : Dual);
+            after = &stateAfterChi;
+        }
+        else if (!trail.stateAfterLastChiSpecified)
+            break;
+        bool compatible = true;
+        for(unsigned int z=0; (z<laneSize) && compatible; z++)
+            for(unsigned int y=0; (y<nrRowsAndColumns) && compatible; y++) {
+                const vector<RowValue>& values = chi[getRowFromSlice(trail.states[i-1][z], y)].values;
+                if (find(values.begin(), values.end(), getRowFromSlice((*after)[z], y)) == values.end())
+                    compatible = false;
             }
-            state[index(x,y)] = tmp2;
+        if (!compatible) {
+            stringstream error;
+            if (i < trail.states.size())
+                error << "The state at round " << dec << i-1 << " is incompatible with that at round " << dec << i << ".";
+            else
+                error << "The state after the last \xCF\x87 is incompatible with that of the last round.";
+            errors.push_back(error.str());
         }
     }
+    return errors.size() == nrErrors;
 }
 
 unsigned int KeccakFDCLC::getThetaGap(const vector<LaneValue>& state) const
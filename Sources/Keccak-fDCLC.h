@@ -67,6 +67,58 @@ public:
     void display(ostream& fout) const;
 };
 
+/** This class stores the output row patterns of χ or χ<sup>-1</sup> for all
+  * the 32 row input patterns in one contiguous table, as a compact form of the
+  * DDT or LAT restricted to the non-zero entries.
+  * The output patterns of input @a a are at indexes offsets[a] to offsets[a+1]-1
+  * of the arrays @a values and @a weights, sorted by increasing weight
+  * in the same order as in the ListOfRowPatterns they are built from.
+  * So, enumerating the outputs of an input in weight order is a linear scan.
+  */
+class RowPatternTable {
+public:
+    /** This structure gives the output patterns of a given input
+      * as pointers into the table, which remain valid as long as the table exists.
+      */
+    struct Range {
+        /** The output patterns, sorted by increasing weight. */
+        const RowValue *values;
+        /** The weights, i.e., weights[i] is the weight of values[i]. */
+        const UINT8 *weights;
+        /** The number of output patterns. */
+        unsigned int size;
+        /** The minimum weight, i.e., weights[0]. */
+        unsigned int minWeight;
+    };
+protected:
+    UINT16 offsets[33];
+    vector<RowValue> values;
+    vector<UINT8> weights;
+    UINT8 minWeights[32];
+    UINT8 maxWeights[32];
+public:
+    /** This constructor initializes an empty table. */
+    RowPatternTable();
+    /** This constructor initializes the table from the lists of output patterns per input.
+      * @param  lists   The 32 lists of output patterns, indexed by the input pattern.
+      */
+    RowPatternTable(const vector<ListOfRowPatterns>& lists);
+    /** This method returns the number of output patterns of a given input. */
+    inline unsigned int size(RowValue input) const { return offsets[input+1] - offsets[input]; }
+    /** This method returns the output patterns of a given input, sorted by increasing weight. */
+    inline const RowValue *getValues(RowValue input) const { return values.data() + offsets[input]; }
+    /** This method returns the weights of the output patterns of a given input. */
+    inline const UINT8 *getWeights(RowValue input) const { return weights.data() + offsets[input]; }
+    /** This method returns the output pattern with the lowest weight of a given input. */
+    inline RowValue getFirstValue(RowValue input) const { return values[offsets[input]]; }
+    /** This method returns the minimum weight of a given input. */
+    inline unsigned int getMinWeight(RowValue input) const { return minWeights[input]; }
+    /** This method returns the maximum weight of a given input. */
+    inline unsigned int getMaxWeight(RowValue input) const { return maxWeights[input]; }
+    /** This method returns the output patterns of a given input as a Range. */
+    Range getRange(RowValue input) const;
+};
+
 /** This class is an extension of KeccakF with additional functionality
   * aimed at differential and linear cryptanalysis.
   */
@@ -97,29 +149,21 @@ public:
       */
     vector<bool> thetaJustBeforeChi;
 private:
-    /** For λ mode (see LambdaMode), this attribute contains
-      * the contribution of an input row to an output slice via the linear
-      * function λ.
-      *
-      * The indexes are as follows, from outer to inner:
-      * - the λ mode (λ, its inverse, its transpose, the transpose of its inverse)
-      * - the output slice index (oz)
-      * - the input slice index (iz)
-      * - the input row index (iy)
-      * - the input row value input[iy,iz]
-      *
-      * So, given a row value B located at row iy in slice 0&lt;=iz&lt;laneSize,
-      * its linear contribution to the output of the λ function in Straight mode is given
-      * by lambdaRowToSlice[(int)Straight][oz][iz][iy][B], where oz is
-      * varied from 0 to laneSize-1 to see all the output slices.
+    /** For the λ modes in which θ or θ<sup>t</sup> is applied (Straight and Transpose),
+      * this attribute contains the image through λ of each bit with index z*25+x+5y,
+      * as a list of (output slice index, output slice value) for the non-zero output slices.
+      * It is empty for the other modes, as the inverse of θ makes these images dense.
+      * See lambda(const vector<SliceValue>&, vector<SliceValue>&, LambdaMode).
       */
-    vector<vector<vector<vector<vector<SliceValue> > > > > lambdaRowToSlice;
-    /** Same as lambdaRowToSlice, but only for the linear part before θ.
+    vector<vector<vector<pair<unsigned int, SliceValue> > > > lambdaImageOfBit;
+    /** For λ mode (see LambdaMode), this attribute contains the index z*25+x+5y
+      * of the bit to which the linear part before θ moves each bit with index z*25+x+5y.
+      * Since this part consists only of ρ and π or their inverses, it is a permutation of the bits.
       */
-    vector<vector<vector<vector<vector<SliceValue> > > > > lambdaBeforeThetaRowToSlice;
-    /** Same as lambdaRowToSlice, but only for the linear part after θ.
+    vector<vector<unsigned int> > lambdaBeforeThetaBitMap;
+    /** Same as lambdaBeforeThetaBitMap, but for the linear part after θ.
       */
-    vector<vector<vector<vector<vector<SliceValue> > > > > lambdaAfterThetaRowToSlice;
+    vector<vector<unsigned int> > lambdaAfterThetaBitMap;
 public:
     /** In this context, λ represents the linear operations in Keccak-<i>f</i>
       * between two applications of χ.
@@ -160,14 +204,17 @@ public:
     /** This method inverts the order of bits in lanes and of lanes in planes.
       * @param  state   The state to process as a vector of lanes.
       */
-    void thetaTransEnvelope(vector<LaneValue>& state) const;
+    template<class Lane> void thetaTransEnvelope(vector<Lane>& state) const;
     /** This method applies the linear transformation (see LambdaMode) between two χ's.
       * @param   state  The state to process as a vector of lanes.
       * @param   mode   The λ mode.
       */
     template<class Lane> void lambda(vector<Lane>& state, LambdaMode mode) const;
-    /** This method applies the λ function (see LambdaMode)
-      * using the lambdaRowToSlice table.
+    /** This method applies the λ function (see LambdaMode) on states represented as slices.
+      * When the mode allows it and the input has few active bits, the output is the XOR
+      * of the images of the active bits taken from lambdaImageOfBit.
+      * Otherwise, the state is transposed into lanes, on which λ is computed with
+      * word-level rotations, and transposed back into slices.
       * The input is a vector of laneSize slice values, and so is the output.
       * The mode argument gives the λ mode (i.e., inverse/transpose) to use.
       * @param   in     The input state as a vector of slices.
@@ -176,6 +223,10 @@ public:
       * @pre This assumes that @a in has size equal to @a laneSize.
       */
     void lambda(const vector<SliceValue>& in, vector<SliceValue>& out, LambdaMode mode) const;
+    /** This method is the same as lambda(const vector<SliceValue>&, vector<SliceValue>&, LambdaMode)
+      * on states of type FixedStateAsSlices, without memory allocation.
+      */
+    void lambda(const FixedStateAsSlices& in, FixedStateAsSlices& out, LambdaMode mode) const;
     /** Among the linear transformation steps (see LambdaMode)
       * between two χ's, this method applies the linear steps that come before θ.
       * @param   state  The state to process as a vector of lanes.
@@ -183,13 +234,16 @@ public:
       */
     template<class Lane> void lambdaBeforeTheta(vector<Lane>& state, LambdaMode mode) const;
     /** This method is the same as lambdaBeforeTheta() but works on states represented as slices
-      * and internally uses the lambdaBeforeThetaRowToSlice table.
+      * and internally moves the active bits according to lambdaBeforeThetaBitMap.
       * @param   in     The input state as a vector of slices.
       * @param   out    The output state as a vector of slices.
       * @param   mode   The λ mode.
       * @pre This assumes that @a in has size equal to @a laneSize.
       */
     void lambdaBeforeTheta(const vector<SliceValue>& in, vector<SliceValue>& out, LambdaMode mode) const;
+    /** This method is the same as lambdaBeforeTheta() on states of type FixedStateAsSlices.
+      */
+    void lambdaBeforeTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out, LambdaMode mode) const;
     /** Among the linear transformation steps (or its inverse and/or transpose)
       * between two χ's, this method applies the linear steps that come after θ.
       * @param   state  The state to process as a vector of lanes.
@@ -197,13 +251,16 @@ public:
       */
     template<class Lane> void lambdaAfterTheta(vector<Lane>& state, LambdaMode mode) const;
     /** This method is the same as lambdaAfterTheta() but works on states represented as slices
-      * and internally uses the lambdaAfterThetaRowToSlice table.
+      * and internally moves the active bits according to lambdaAfterThetaBitMap.
       * @param   in     The input state as a vector of slices.
       * @param   out    The output state as a vector of slices.
       * @param   mode   The λ mode.
       * @pre This assumes that @a in has size equal to @a laneSize.
       */
     void lambdaAfterTheta(const vector<SliceValue>& in, vector<SliceValue>& out, LambdaMode mode) const;
+    /** This method is the same as lambdaAfterTheta() on states of type FixedStateAsSlices.
+      */
+    void lambdaAfterTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out, LambdaMode mode) const;
     /** Apply the χ function on a single row value.
       * @param   a      The input row value.
       * @return The output row value.
@@ -249,6 +306,18 @@ public:
       *                 an inconsistency is detected.
       */
     void checkLCTrail(const Trail& trail, KeccakFPropagation *LC=0) const;
+    /** This method checks the consistency of a DC or LC trail like checkDCTrail() and checkLCTrail(),
+      * but without throwing an exception or displaying anything, so that it can be called on many trails,
+      * possibly from several threads. All the inconsistencies are reported, not only the first one.
+      * In addition, it checks that the trail is well formed, i.e., that the numbers of states and weights match
+      * and that the states have the lane size of this instance,
+      * in which case the other aspects are not tested.
+      * @param  trail   The trail to test the consistence of.
+      * @param  DCorLC  The propagation context of the trail, which tells whether it is a DC or LC trail.
+      * @param  errors  A description of each inconsistency found is appended to this vector.
+      * @return True iff the trail is consistent.
+      */
+    bool checkTrail(const Trail& trail, const KeccakFPropagation& DCorLC, vector<string>& errors) const;
     /** This method computes the θ-gap of the state given as input.
       * (See the Keccak main document for a definition of the θ-gap.)
       * @param   state  The state of which to compute the θ-gap as a vector of lanes.
@@ -284,6 +353,29 @@ public:
 private:
     void initializeAll();
     void initializeLambdaLookupTables();
+    /** This method applies λ (see LambdaMode) onto a state given as 25 lanes
+      * in 64-bit words, without allocating any memory.
+      * @param   A      The state as an array of 25 lanes, ordered according to index().
+      * @param   mode   The λ mode.
+      */
+    void lambdaOnLanes(LaneValue *A, LambdaMode mode) const;
+    /** This method transposes a state given as an array of laneSize slices
+      * into an array of 25 lanes, only visiting the active bits.
+      */
+    void fromSlicesToLaneArray(const SliceValue *slices, LaneValue *lanes) const;
+    /** This method transposes an array of 25 lanes into an array of laneSize slices,
+      * only visiting the active bits.
+      */
+    void fromLaneArrayToSlices(const LaneValue *lanes, SliceValue *slices) const;
+    /** This method moves each active bit of @a in to the position given by @a bitMap.
+      * The arrays of laneSize slices @a in and @a out must not overlap.
+      */
+    void permuteBits(const SliceValue *in, SliceValue *out, const vector<unsigned int>& bitMap) const;
+    /** This method applies λ on arrays of laneSize slices,
+      * see lambda(const vector<SliceValue>&, vector<SliceValue>&, LambdaMode).
+      * The arrays @a in and @a out must not overlap.
+      */
+    void lambda(const SliceValue *in, SliceValue *out, LambdaMode mode) const;
 };
 
 template<class Lane>
@@ -306,6 +398,33 @@ void KeccakFDCLC::thetaTransposed(vector<Lane>& A) const
             A[index(x,y)] ^= D[x];
 }
 
+template<class Lane>
+void KeccakFDCLC::thetaTransEnvelope(vector<Lane>& state) const
+{
+    // We invert the order of bits in lanes and of lanes in planes
+    Lane tmp, tmp2;
+    for(unsigned int y=0; y<nrRowsAndColumns; y++) {
+        tmp = state[index(1,y)];
+        state[index(1,y)] = state[index(4,y)];
+        state[index(4,y)] = tmp;
+        tmp = state[index(2,y)];
+        state[index(2,y)] = state[index(3,y)];
+        state[index(3,y)] = tmp;
+    }
+    for(unsigned int x=0; x<nrRowsAndColumns; x++) {
+        for(unsigned int y=0; y<nrRowsAndColumns; y++) {
+            tmp = state[index(x,y)];
+            tmp2 = 0;
+            for(unsigned int z=0; z<laneSize; z++) {
+                tmp2 ^= tmp&1;
+                ROL(tmp,1);
+                ROL(tmp2,-1);
+            }
+            state[index(x,y)] = tmp2;
+        }
+    }
+}
+
 template<class Lane>
 void KeccakFDCLC::lambda(vector<Lane>& state, LambdaMode mode) const
 {
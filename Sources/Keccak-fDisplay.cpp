@@ -13,8 +13,15 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include "Keccak-fDisplay.h"
 
 using namespace std;
@@ -270,21 +277,9 @@ void KeccakDisplayInSVG::displayTrail(ostream& fout, const KeccakFPropagation& D
     (void)x;
     (void)y;
     (void)scale;
-    vector<vector<SliceValue> > allAfterPreviousChi;
-    vector<vector<SliceValue> > allBeforeTheta;
-    vector<vector<SliceValue> > allAfterTheta;
-
-    for(unsigned int i=0; i<trail.states.size(); i++) {
-        vector<SliceValue> stateAfterChi;
-        DCorLC.reverseLambda(trail.states[i], stateAfterChi);
-        allAfterPreviousChi.push_back(stateAfterChi);
-        vector<SliceValue> stateBeforeTheta;
-        DCorLC.directLambdaBeforeTheta(stateAfterChi, stateBeforeTheta);
-        allBeforeTheta.push_back(stateBeforeTheta);
-        vector<SliceValue> stateAfterTheta;
-        DCorLC.directTheta(stateBeforeTheta, stateAfterTheta);
-        allAfterTheta.push_back(stateAfterTheta);
-    }
+    vector<vector<SliceValue> > allAfterPreviousChi(trail.states.size());
+    for(unsigned int i=1; i<trail.states.size(); i++)
+        DCorLC.reverseLambda(trail.states[i], allAfterPreviousChi[i]);
 
     unsigned int py = 0;
     for(unsigned int i=0; i<trail.states.size(); i++) {
@@ -610,3 +605,272 @@ void displayStates(ostream& fout,
         fout << endl;
     }
 }
+
+KeccakTrailsInSVG::KeccakTrailsInSVG()
+    : trailsPerDocument(1), nrThreads(thread::hardware_concurrency())
+{
+    displayRows = false;
+    displaySlices = false;
+    maxNumberOfHorizontalSlices = 8;
+    if (nrThreads == 0)
+        nrThreads = 1;
+}
+
+void KeccakTrailsInSVG::writeStyle(ostream& fout) const
+{
+    fout << "<style type=\"text/css\">\n"
+        << ".bit { fill: white; stroke: black; stroke-width: " << (bitSize*0.05) << "; }\n"
+        << ".bit_slice_active { fill: #F4F4F4; }\n"
+        << ".bit_row_active { fill: #E0E0F8; }\n"
+        << ".bit_bit_active { fill: black; }\n"
+        << ".f_row, .f_slice { fill: none; stroke: none; }\n"
+        << ".f_row_row_active { stroke: #C00000; stroke-width: " << (bitSize*0.1) << "; }\n"
+        << ".f_slice_slice_active { stroke: #0000C0; stroke-width: " << (bitSize*0.15) << "; }\n"
+        << ".normal { font-family: sans-serif; font-size: " << bitSize << "px; }\n"
+        << ".caption { font-family: sans-serif; font-size: " << (bitSize*1.2) << "px; font-weight: bold; }\n"
+        << ".arrow { fill: none; stroke: black; stroke-width: " << (bitSize*0.1) << "; marker-end: url(#arrowhead); }\n"
+        << "</style>\n";
+}
+
+void KeccakTrailsInSVG::writeRowGlyphs(ostream& fout) const
+{
+    fout << "<marker id=\"arrowhead\" viewBox=\"0 0 10 10\" refX=\"10\" refY=\"5\" markerWidth=\"6\" markerHeight=\"6\" orient=\"auto\">"
+        << "<path d=\"M 0 0 L 10 5 L 0 10 z\"/></marker>\n";
+    for(RowValue row=0; row<32; row++) {
+        fout << "<g id=\"row" << dec << (unsigned int)row << "\">";
+        for(unsigned int ix=0; ix<5; ix++) {
+            unsigned int x = KeccakF::index(ix+3);
+            fout << "<rect x=\"" << (ix*bitSize) << "\" y=\"0\" width=\"" << bitSize
+                << "\" height=\"" << bitSize << "\" class=\"bit";
+            if ((row >> x) & 1)
+                fout << " bit_bit_active";
+            if (displaySlices)
+                fout << " bit_slice_active";
+            if (displayRows && (row != 0))
+                fout << " bit_row_active";
+            fout << "\"/>";
+        }
+        if (displayRows) {
+            fout << "<rect x=\"0\" y=\"0\" width=\"" << (5*bitSize) << "\" height=\"" << bitSize << "\" class=\"f_row";
+            if (row != 0)
+                fout << " f_row_row_active";
+            fout << " f_row_slice_active\"/>";
+        }
+        fout << "</g>\n";
+    }
+}
+
+void KeccakTrailsInSVG::getStateLayout(const vector<SliceValue>& state, unsigned int& slicesPerRow, unsigned int& nrRows) const
+{
+    unsigned int activeSlices = 0;
+    for(unsigned int z=0; z<state.size(); z++)
+        if (state[z] != 0) activeSlices++;
+    nrRows = (maxNumberOfHorizontalSlices <= 0) ? 1 : ((activeSlices+maxNumberOfHorizontalSlices-1) / maxNumberOfHorizontalSlices);
+    if (nrRows == 0)
+        nrRows = 1;
+    slicesPerRow = (activeSlices+nrRows-1) / nrRows;
+}
+
+double KeccakTrailsInSVG::getStateHeight(const vector<SliceValue>& state) const
+{
+    unsigned int slicesPerRow, nrRows;
+    getStateLayout(state, slicesPerRow, nrRows);
+    return (7.0*nrRows - 2.0)*bitSize;
+}
+
+void KeccakTrailsInSVG::writeStateSparsely(ostream& fout, const vector<SliceValue>& state, double x, double y) const
+{
+    unsigned int slicesPerRow, nrRows;
+    getStateLayout(state, slicesPerRow, nrRows);
+    double px = x;
+    double py = y;
+    unsigned int j = 0;
+    for(unsigned int z=0; z<state.size(); z++) {
+        if (state[z] != 0) {
+            for(unsigned int iy=0; iy<5; iy++) {
+                unsigned int yy = KeccakF::index(7-iy);
+                fout << "<use xlink:href=\"#row" << dec << (unsigned int)getRowFromSlice(state[z], yy)
+                    << "\" x=\"" << px << "\" y=\"" << (py + iy*bitSize) << "\"/>";
+            }
+            if (displaySlices)
+                fout << "<rect x=\"" << px << "\" y=\"" << py << "\" width=\"" << (5*bitSize)
+                    << "\" height=\"" << (5*bitSize) << "\" class=\"f_slice f_slice_slice_active\"/>";
+            fout << "<text class=\"normal\" x=\"" << (px+2.5*bitSize) << "\" y=\"" << (py-0.2*bitSize)
+                << "\" text-anchor=\"middle\"><tspan style=\"font-style:italic;\">z</tspan> = " << z << "</text>\n";
+            px += 7*bitSize;
+            j++;
+            if (j >= slicesPerRow) {
+                px = x;
+                py += 7*bitSize;
+                j = 0;
+            }
+        }
+    }
+}
+
+void KeccakTrailsInSVG::getTrailSize(const KeccakFPropagation& DCorLC, const Trail& trail, double& width, double& height, vector<SliceValue>& buffer) const
+{
+    width = 0.0;
+    height = 3.0*bitSize;
+    bool first = true;
+    for(unsigned int i=0; i<trail.states.size(); i++) {
+        if (trail.states[i].empty())
+            continue;
+        for(unsigned int k=(first ? 1 : 0); k<2; k++) {
+            const vector<SliceValue> *state = &trail.states[i];
+            if (k == 0) {
+                DCorLC.reverseLambda(trail.states[i], buffer);
+                state = &buffer;
+            }
+            unsigned int slicesPerRow, nrRows;
+            getStateLayout(*state, slicesPerRow, nrRows);
+            width = max(width, 7.0*slicesPerRow*bitSize);
+            height += getStateHeight(*state) + 4.0*bitSize;
+        }
+        first = false;
+    }
+    width += 12.0*bitSize;
+    height -= 2.0*bitSize;
+}
+
+double KeccakTrailsInSVG::writeTrail(ostream& fout, const KeccakFPropagation& DCorLC, const Trail& trail, double y, vector<SliceValue>& buffer) const
+{
+    const double x = 11.0*bitSize;
+    double py = y + 3.0*bitSize;
+    bool first = true;
+    for(unsigned int i=0; i<trail.states.size(); i++) {
+        if (trail.states[i].empty())
+            continue;
+        if (!first) {
+            DCorLC.reverseLambda(trail.states[i], buffer);
+            writeStateSparsely(fout, buffer, x, py);
+            py += getStateHeight(buffer);
+            fout << "<path class=\"arrow\" d=\"M " << dec << (x-bitSize) << "," << py << " " << (x-bitSize) << "," << (py+4*bitSize) << "\"/>\n";
+            fout << "<text class=\"normal\" x=\"" << (x-0.8*bitSize) << "\" y=\"" << (py+2*bitSize)
+                << "\"><tspan style=\"font-style:italic;\">\xCE\xB8</tspan>, "
+                << "<tspan style=\"font-style:italic;\">\xCF\x81</tspan>, "
+                << "<tspan style=\"font-style:italic;\">\xCF\x80</tspan></text>\n";
+            py += 4*bitSize;
+        }
+        writeStateSparsely(fout, trail.states[i], x, py);
+        fout << "<text class=\"normal\" x=\"" << (x-0.2*bitSize) << "\" y=\"" << (py+3*bitSize)
+            << "\" text-anchor=\"end\">weight: " << dec << trail.weights[i] << "</text>\n";
+        py += getStateHeight(trail.states[i]);
+        if (i < trail.states.size()-1) {
+            fout << "<path class=\"arrow\" d=\"M " << dec << (x-bitSize) << "," << py << " " << (x-bitSize) << "," << (py+4*bitSize) << "\"/>\n";
+            fout << "<text class=\"normal\" x=\"" << (x-0.8*bitSize) << "\" y=\"" << (py+2*bitSize)
+                << "\"><tspan style=\"font-style:italic;\">\xCF\x87</tspan></text>\n";
+            py += 4*bitSize;
+        }
+        first = false;
+    }
+    return py + 2.0*bitSize;
+}
+
+void KeccakTrailsInSVG::writeDocument(ostream& fout, const KeccakFPropagation& DCorLC, const vector<Trail>& trails, UINT64 firstIndex) const
+{
+    vector<SliceValue> buffer;
+    double width = 0.0, height = 0.0;
+    for(unsigned int i=0; i<trails.size(); i++) {
+        double trailWidth, trailHeight;
+        getTrailSize(DCorLC, trails[i], trailWidth, trailHeight, buffer);
+        width = max(width, trailWidth);
+        height += trailHeight;
+    }
+    width = max(width, 30.0*bitSize);
+    fout << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    fout << "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" version=\"1.1\" "
+        << "width=\"" << width << "\" height=\"" << height << "\" viewBox=\"0 0 " << width << " " << height << "\">\n";
+    writeStyle(fout);
+    fout << "<defs>\n";
+    writeRowGlyphs(fout);
+    fout << "</defs>\n";
+    double y = 0.0;
+    for(unsigned int i=0; i<trails.size(); i++) {
+        fout << "<g id=\"trail" << dec << (firstIndex+i) << "\">\n";
+        fout << "<text class=\"caption\" x=\"" << bitSize << "\" y=\"" << (y+1.5*bitSize) << "\">Trail #" << dec << (firstIndex+i)
+            << ": " << trails[i].getNumberOfRounds() << " rounds, weight " << trails[i].totalWeight
+            << (trails[i].firstStateSpecified ? "" : " (trail core)") << "</text>\n";
+        y = writeTrail(fout, DCorLC, trails[i], y, buffer);
+        fout << "</g>\n";
+    }
+    fout << "</svg>" << endl;
+}
+
+string KeccakTrailsInSVG::getDocumentFileName(const string& prefix, UINT64 document) const
+{
+    stringstream name;
+    name << prefix << "-" << setfill('0') << setw(6) << dec << document << ".svg";
+    return name.str();
+}
+
+UINT64 KeccakTrailsInSVG::render(const KeccakFPropagation& DCorLC, TrailIterator& trails, const string& prefix) const
+{
+    string indexFileName = prefix + "-index.html";
+    ofstream index(indexFileName.c_str());
+    if (!index)
+        throw KeccakException("The file " + indexFileName + " cannot be written.");
+    size_t slash = prefix.find_last_of("/\\");
+    string relativePrefix = (slash == string::npos) ? prefix : prefix.substr(slash+1);
+    index << "<!DOCTYPE html>\n<html><head><meta charset=\"UTF-8\"><title>" << relativePrefix << "</title></head><body>\n";
+    index << "<table>\n<tr><th>Trail</th><th>Rounds</th><th>Weight</th><th>Weight profile</th><th>Document</th></tr>\n";
+
+    const unsigned int documentsPerBatch = 4*max(nrThreads, 1U);
+    const unsigned int trailsPerDocumentOrOne = max(trailsPerDocument, 1U);
+    UINT64 nrTrails = 0;
+    UINT64 nrDocuments = 0;
+    while(!trails.isEnd()) {
+        // The trails of the next documents are read on this thread.
+        vector<vector<Trail> > documents;
+        vector<UINT64> firstIndexes;
+        while((documents.size() < documentsPerBatch) && (!trails.isEnd())) {
+            documents.push_back(vector<Trail>());
+            firstIndexes.push_back(nrTrails);
+            string fileName = getDocumentFileName(relativePrefix, nrDocuments + documents.size() - 1);
+            while((documents.back().size() < trailsPerDocumentOrOne) && (!trails.isEnd())) {
+                const Trail& trail = *trails;
+                documents.back().push_back(trail);
+                index << "<tr><td>" << dec << nrTrails << "</td><td>" << trail.getNumberOfRounds()
+                    << "</td><td>" << trail.totalWeight << "</td><td>";
+                for(unsigned int i=0; i<trail.weights.size(); i++)
+                    index << ((i > 0) ? " " : "") << trail.weights[i];
+                index << "</td><td><a href=\"" << fileName;
+                if (trailsPerDocumentOrOne > 1)
+                    index << "#trail" << nrTrails;
+                index << "\">" << fileName << "</a></td></tr>\n";
+                nrTrails++;
+                ++trails;
+            }
+        }
+        // The documents are rendered and written in parallel.
+        atomic<unsigned int> next(0);
+        exception_ptr failure;
+        mutex failureLock;
+        vector<thread> workers;
+        for(unsigned int t=0; t<min(nrThreads, (unsigned int)documents.size()); t++)
+            workers.push_back(thread([&]() {
+                try {
+                    for(unsigned int k=next++; k<documents.size(); k=next++) {
+                        string fileName = getDocumentFileName(prefix, nrDocuments + k);
+                        ofstream fout(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+                        writeDocument(fout, DCorLC, documents[k], firstIndexes[k]);
+                        if (!fout)
+                            throw KeccakException("The file " + fileName + " cannot be written.");
+                    }
+                }
+                catch(...) {
+                    lock_guard<mutex> guard(failureLock);
+                    if (!failure)
+                        failure = current_exception();
+                    next = (unsigned int)documents.size();
+                }
+            }));
+        for(unsigned int t=0; t<workers.size(); t++)
+            workers[t].join();
+        if (failure)
+            rethrow_exception(failure);
+        nrDocuments += documents.size();
+    }
+    index << "</table>\n</body></html>" << endl;
+    return nrTrails;
+}
@@ -16,8 +16,11 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #ifndef _KECCAKFDISPLAY_H_
 #define _KECCAKFDISPLAY_H_
 
+#include <string>
+#include <vector>
 #include "Keccak-f.h"
 #include "Keccak-fPropagation.h"
+#include "Keccak-fTrails.h"
 
 using namespace std;
 
@@ -66,6 +69,60 @@ protected:
     void getPosition(unsigned int x, unsigned int y, unsigned int z, double &px, double &py) const;
 };
 
+/** Class to render many trails as complete SVG documents, e.g., all the trails of a file.
+  * The layout is the same as KeccakDisplayInSVG::displayTrail(), but the bits are not
+  * output one by one: the 32 possible rows are defined once per document as glyphs,
+  * and each active slice is drawn as its 5 rows referring to these glyphs.
+  * Consequently, getAdditionalBitStyles() is not taken into account.
+  * The documents are rendered and written in parallel, while the trails are read
+  * in batches from a TrailIterator, so that a whole file can be rendered without keeping it in memory.
+  */
+class KeccakTrailsInSVG : public KeccakDisplayInSVG
+{
+public:
+    /** The number of trails per document: 1 to write one SVG document per trail,
+      * or more to write pages of trails one below the other. */
+    unsigned int trailsPerDocument;
+    /** The number of threads that render the documents. */
+    unsigned int nrThreads;
+public:
+    /** The constructor. */
+    KeccakTrailsInSVG();
+    /** This method writes a complete SVG document with the given trails, one below the other.
+      * @param  fout    The stream to write to.
+      * @param   DCorLC     The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      * @param  trails  The trails.
+      * @param  firstIndex  The index of the first trail, used in the captions.
+      */
+    void writeDocument(ostream& fout, const KeccakFPropagation& DCorLC, const vector<Trail>& trails, UINT64 firstIndex = 0) const;
+    /** This method renders all the trails of an iterator into documents
+      * of trailsPerDocument trails each, named by getDocumentFileName(),
+      * and writes an HTML index listing the trails and their documents,
+      * named @a prefix followed by "-index.html".
+      * @param   DCorLC     The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      * @param  trails  The iterator on the trails.
+      * @param  prefix  The prefix of the names of the files.
+      * @return The number of trails rendered.
+      */
+    UINT64 render(const KeccakFPropagation& DCorLC, TrailIterator& trails, const string& prefix) const;
+    /** This method returns the name of a document written by render().
+      * @param  prefix  The prefix given to render().
+      * @param  document    The index of the document.
+      * @return The name of the file.
+      */
+    string getDocumentFileName(const string& prefix, UINT64 document) const;
+protected:
+    void writeStyle(ostream& fout) const;
+    void writeRowGlyphs(ostream& fout) const;
+    void getStateLayout(const vector<SliceValue>& state, unsigned int& slicesPerRow, unsigned int& nrRows) const;
+    double getStateHeight(const vector<SliceValue>& state) const;
+    void getTrailSize(const KeccakFPropagation& DCorLC, const Trail& trail, double& width, double& height, vector<SliceValue>& buffer) const;
+    void writeStateSparsely(ostream& fout, const vector<SliceValue>& state, double x, double y) const;
+    double writeTrail(ostream& fout, const KeccakFPropagation& DCorLC, const Trail& trail, double y, vector<SliceValue>& buffer) const;
+};
+
 /** This method outputs to fout the value of the state in a human readable way.
   * The slices are displayed side by side.
   */
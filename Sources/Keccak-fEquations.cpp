@@ -13,63 +13,389 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <math.h>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include "Keccak-fEquations.h"
 
 using namespace std;
 
+/** The hash function for the keys of the tables of SymbolicExpressionTables. */
+template<class T>
+struct SymbolicExpressionHash {
+    size_t operator()(const vector<T>& v) const
+    {
+        UINT64 h = 0xCBF29CE484222325ULL;
+        for(unsigned int i=0; i<v.size(); i++)
+            h = (h ^ (UINT64)v[i]) * 0x100000001B3ULL;
+        return (size_t)(h ^ (h >> 32));
+    }
+};
+
+/** This class contains the global tables behind SymbolicBit.
+  * The expressions are sums of monomials in atoms, where an atom is either a variable,
+  * or a sum or a product of two expressions left unexpanded.
+  * A monomial is a bitset of atom indexes, packed as the list of its non-zero words,
+  * each preceded by its position, by increasing position, and an expression is the sorted list of the indexes of its monomials.
+  * Monomial 0 is the constant 1, expression 0 is the constant 0
+  * and expression 1 is the constant 1.
+  */
+class SymbolicExpressionTables {
+public:
+    enum AtomType { variable, sum, product };
+    vector<AtomType> atomTypes;
+    /** For each atom that is a variable, its name. */
+    vector<string> atomNames;
+    /** For each atom that is a sum or a product, the indexes of its two operands. */
+    vector<pair<UINT32, UINT32> > atomOperands;
+    unordered_map<string, UINT32> variableAtoms;
+    vector<vector<UINT64> > monomials;
+    unordered_map<vector<UINT64>, UINT32, SymbolicExpressionHash<UINT64> > monomialIndexes;
+    vector<vector<UINT32> > expressions;
+    unordered_map<vector<UINT32>, UINT32, SymbolicExpressionHash<UINT32> > expressionIndexes;
+    unordered_map<UINT64, UINT32> sums, products;
+    unsigned int expansionLimit;
+public:
+    SymbolicExpressionTables()
+        : expansionLimit(256)
+    {
+        getMonomial(vector<UINT64>());
+        getExpression(vector<UINT32>());
+        getExpression(vector<UINT32>(1, 0));
+    }
+    static SymbolicExpressionTables& get()
+    {
+        static SymbolicExpressionTables tables;
+        return tables;
+    }
+    UINT32 getMonomial(const vector<UINT64>& monomial)
+    {
+        auto it = monomialIndexes.find(monomial);
+        if (it != monomialIndexes.end())
+            return it->second;
+        UINT32 i = (UINT32)monomials.size();
+        monomials.push_back(monomial);
+        monomialIndexes[monomial] = i;
+        return i;
+    }
+    UINT32 getExpression(const vector<UINT32>& expression)
+    {
+        auto it = expressionIndexes.find(expression);
+        if (it != expressionIndexes.end())
+            return it->second;
+        UINT32 i = (UINT32)expressions.size();
+        expressions.push_back(expression);
+        expressionIndexes[expression] = i;
+        return i;
+    }
+    UINT32 getAtom(AtomType type, const string& name, UINT32 a, UINT32 b)
+    {
+        UINT32 atom = (UINT32)atomTypes.size();
+        atomTypes.push_back(type);
+        atomNames.push_back(name);
+        atomOperands.push_back(make_pair(a, b));
+        return getAtom(atom);
+    }
+    UINT32 getAtom(UINT32 atom)
+    {
+        vector<UINT64> monomial(2);
+        monomial[0] = atom/64;
+        monomial[1] = (UINT64)1 << (atom%64);
+        return getExpression(vector<UINT32>(1, getMonomial(monomial)));
+    }
+    UINT32 getVariable(const string& name)
+    {
+        auto it = variableAtoms.find(name);
+        if (it != variableAtoms.end())
+            return getAtom(it->second);
+        variableAtoms[name] = (UINT32)atomTypes.size();
+        return getAtom(variable, name, 0, 0);
+    }
+    UINT32 multiplyMonomials(UINT32 m, UINT32 n)
+    {
+        const vector<UINT64>& a = monomials[m];
+        const vector<UINT64>& b = monomials[n];
+        vector<UINT64> product;
+        product.reserve(a.size() + b.size());
+        unsigned int i = 0, j = 0;
+        while((i < a.size()) || (j < b.size())) {
+            if ((j == b.size()) || ((i < a.size()) && (a[i] < b[j]))) {
+                product.push_back(a[i]);
+                product.push_back(a[i+1]);
+                i += 2;
+            }
+            else if ((i == a.size()) || (b[j] < a[i])) {
+                product.push_back(b[j]);
+                product.push_back(b[j+1]);
+                j += 2;
+            }
+            else {
+                product.push_back(a[i]);
+                product.push_back(a[i+1] | b[j+1]);
+                i += 2;
+                j += 2;
+            }
+        }
+        return getMonomial(product);
+    }
+    UINT32 add(UINT32 a, UINT32 b)
+    {
+        if (a == 0) return b;
+        if (b == 0) return a;
+        if (a == b) return 0;
+        UINT64 key = (a < b) ? (((UINT64)a << 32) | b) : (((UINT64)b << 32) | a);
+        auto it = sums.find(key);
+        if (it != sums.end())
+            return it->second;
+        const vector<UINT32>& x = expressions[a];
+        const vector<UINT32>& y = expressions[b];
+        if (x.size() + y.size() > expansionLimit) {
+            UINT32 result = getAtom(AtomType::sum, string(), a, b);
+            sums[key] = result;
+            return result;
+        }
+        vector<UINT32> sum;
+        sum.reserve(x.size() + y.size());
+        unsigned int i = 0, j = 0;
+        while((i < x.size()) || (j < y.size())) {
+            if ((j == y.size()) || ((i < x.size()) && (x[i] < y[j])))
+                sum.push_back(x[i++]);
+            else if ((i == x.size()) || (y[j] < x[i]))
+                sum.push_back(y[j++]);
+            else {
+                i++;
+                j++;
+            }
+        }
+        UINT32 result = getExpression(sum);
+        sums[key] = result;
+        return result;
+    }
+    UINT32 multiply(UINT32 a, UINT32 b)
+    {
+        if ((a == 0) || (b == 0)) return 0;
+        if (a == 1) return b;
+        if ((b == 1) || (a == b)) return a;
+        if (a > b) swap(a, b);
+        UINT64 key = ((UINT64)a << 32) | b;
+        auto it = products.find(key);
+        if (it != products.end())
+            return it->second;
+        UINT32 result;
+        if ((UINT64)expressions[a].size()*expressions[b].size() > expansionLimit)
+            result = getAtom(product, string(), a, b);
+        else {
+            vector<UINT32> terms;
+            terms.reserve(expressions[a].size()*expressions[b].size());
+            for(unsigned int i=0; i<expressions[a].size(); i++)
+                for(unsigned int j=0; j<expressions[b].size(); j++)
+                    terms.push_back(multiplyMonomials(expressions[a][i], expressions[b][j]));
+            sort(terms.begin(), terms.end());
+            // The monomials that appear an even number of times cancel out.
+            vector<UINT32> product;
+            for(unsigned int i=0; i<terms.size(); ) {
+                unsigned int j = i+1;
+                while((j < terms.size()) && (terms[j] == terms[i]))
+                    j++;
+                if ((j-i)%2 == 1)
+                    product.push_back(terms[i]);
+                i = j;
+            }
+            result = getExpression(product);
+        }
+        products[key] = result;
+        return result;
+    }
+    void getAtoms(UINT32 m, vector<UINT32>& atoms) const
+    {
+        atoms.clear();
+        for(unsigned int i=0; i<monomials[m].size(); i+=2)
+            for(UINT64 word=monomials[m][i+1]; word != 0; word &= word-1) {
+                unsigned int j = 0;
+                while(((word >> j) & 1) == 0)
+                    j++;
+                atoms.push_back((UINT32)monomials[m][i]*64+j);
+            }
+    }
+    unsigned int getDegree(UINT32 a, unordered_map<UINT32, unsigned int>& cache) const
+    {
+        auto it = cache.find(a);
+        if (it != cache.end())
+            return it->second;
+        unsigned int degree = 0;
+        vector<UINT32> atoms;
+        for(unsigned int i=0; i<expressions[a].size(); i++) {
+            getAtoms(expressions[a][i], atoms);
+            unsigned int monomialDegree = 0;
+            for(unsigned int j=0; j<atoms.size(); j++)
+                if (atomTypes[atoms[j]] == variable)
+                    monomialDegree++;
+                else if (atomTypes[atoms[j]] == AtomType::sum)
+                    monomialDegree += max(getDegree(atomOperands[atoms[j]].first, cache), getDegree(atomOperands[atoms[j]].second, cache));
+                else
+                    monomialDegree += getDegree(atomOperands[atoms[j]].first, cache) + getDegree(atomOperands[atoms[j]].second, cache);
+            degree = max(degree, monomialDegree);
+        }
+        cache[a] = degree;
+        return degree;
+    }
+    bool evaluate(UINT32 a, const function<bool(const string&)>& values, unordered_map<UINT32, bool>& cache) const
+    {
+        auto it = cache.find(a);
+        if (it != cache.end())
+            return it->second;
+        bool result = false;
+        vector<UINT32> atoms;
+        for(unsigned int i=0; i<expressions[a].size(); i++) {
+            getAtoms(expressions[a][i], atoms);
+            bool monomial = true;
+            for(unsigned int j=0; (j<atoms.size()) && monomial; j++) {
+                const pair<UINT32, UINT32>& operands = atomOperands[atoms[j]];
+                if (atomTypes[atoms[j]] == variable)
+                    monomial = values(atomNames[atoms[j]]);
+                else if (atomTypes[atoms[j]] == AtomType::sum)
+                    monomial = evaluate(operands.first, values, cache) != evaluate(operands.second, values, cache);
+                else
+                    monomial = evaluate(operands.first, values, cache) && evaluate(operands.second, values, cache);
+            }
+            result ^= monomial;
+        }
+        cache[a] = result;
+        return result;
+    }
+    void display(ostream& fout, UINT32 a) const
+    {
+        if (a == 0) {
+            fout << "0";
+            return;
+        }
+        vector<vector<UINT32> > sorted(expressions[a].size());
+        for(unsigned int i=0; i<expressions[a].size(); i++)
+            getAtoms(expressions[a][i], sorted[i]);
+        sort(sorted.begin(), sorted.end(), [](const vector<UINT32>& x, const vector<UINT32>& y) {
+            if (x.empty() || y.empty())
+                return y.empty() && !x.empty();
+            if (x.size() != y.size())
+                return x.size() < y.size();
+            return x < y;
+        });
+        for(unsigned int i=0; i<sorted.size(); i++) {
+            if (i > 0)
+                fout << " + ";
+            if (sorted[i].empty())
+                fout << "1";
+            for(unsigned int j=0; j<sorted[i].size(); j++) {
+                if (j > 0)
+                    fout << "*";
+                UINT32 atom = sorted[i][j];
+                const pair<UINT32, UINT32>& operands = atomOperands[atom];
+                if (atomTypes[atom] == variable)
+                    fout << atomNames[atom];
+                else if (atomTypes[atom] == product) {
+                    displayFactor(fout, operands.first);
+                    fout << "*";
+                    displayFactor(fout, operands.second);
+                }
+                else if (sorted[i].size() == 1) {
+                    display(fout, operands.first);
+                    fout << " + ";
+                    display(fout, operands.second);
+                }
+                else {
+                    fout << "(";
+                    display(fout, operands.first);
+                    fout << " + ";
+                    display(fout, operands.second);
+                    fout << ")";
+                }
+            }
+        }
+    }
+    void displayFactor(ostream& fout, UINT32 a) const
+    {
+        bool isSum = (expressions[a].size() > 1);
+        if (expressions[a].size() == 1) {
+            vector<UINT32> atoms;
+            getAtoms(expressions[a][0], atoms);
+            isSum = (atoms.size() == 1) && (atomTypes[atoms[0]] == AtomType::sum);
+        }
+        if (isSum) {
+            fout << "(";
+            display(fout, a);
+            fout << ")";
+        }
+        else
+            display(fout, a);
+    }
+};
+
 SymbolicBit::SymbolicBit()
-    : value("0"), containsAddition(false)
+    : expression(0)
 {
 }
 
 SymbolicBit::SymbolicBit(bool aValue)
-    : value(aValue ? "1" : "0"), containsAddition(false)
+    : expression(aValue ? 1 : 0)
 {
 }
 
-SymbolicBit::SymbolicBit(const string& aValue, bool aContainsAddition)
-    : value(aValue), containsAddition(aContainsAddition)
+SymbolicBit::SymbolicBit(const string& variableName)
+    : expression(SymbolicExpressionTables::get().getVariable(variableName))
 {
 }
 
 void SymbolicBit::complement()
 {
-    if (value == "0")
-        value = "1";
-    else {
-        value += " + 1";
-        containsAddition = true;
-    }
+    expression = SymbolicExpressionTables::get().add(expression, 1);
 }
 
 void SymbolicBit::add(const SymbolicBit& a)
 {
-    if (value == "0")
-        value = a.value;
-    else if (a.value != "0") {
-        value += " + ";
-        value += a.value;
-        containsAddition = true;
-    }
+    expression = SymbolicExpressionTables::get().add(expression, a.expression);
 }
 
 void SymbolicBit::multiply(const SymbolicBit& a)
 {
-    string temp;
-    if (containsAddition)
-        temp = "("+value+")";
-    else
-        temp = value;
-    if (a.containsAddition)
-        value = temp+"*("+a.value+")";
-    else
-        value = temp+"*"+a.value;
-    containsAddition = false;
+    expression = SymbolicExpressionTables::get().multiply(expression, a.expression);
+}
+
+unsigned int SymbolicBit::getNumberOfMonomials() const
+{
+    return (unsigned int)SymbolicExpressionTables::get().expressions[expression].size();
+}
+
+unsigned int SymbolicBit::getDegree() const
+{
+    unordered_map<UINT32, unsigned int> cache;
+    return SymbolicExpressionTables::get().getDegree(expression, cache);
+}
+
+string SymbolicBit::getString() const
+{
+    stringstream out;
+    out << *this;
+    return out.str();
+}
+
+bool SymbolicBit::evaluate(const function<bool(const string&)>& values) const
+{
+    unordered_map<UINT32, bool> cache;
+    return SymbolicExpressionTables::get().evaluate(expression, values, cache);
+}
+
+void SymbolicBit::setExpansionLimit(unsigned int limit)
+{
+    SymbolicExpressionTables::get().expansionLimit = limit;
+}
+
+ostream& operator<<(ostream& fout, const SymbolicBit& a)
+{
+    SymbolicExpressionTables::get().display(fout, a.expression);
+    return fout;
 }
 
 
@@ -165,7 +491,7 @@ void KeccakFEquations::genEquations(ostream& fout, const vector<SymbolicLane>& s
                 fout << " + ";
             else
                 fout << " = ";
-            fout << state[index(x,y)].values[z].value;
+            fout << state[index(x,y)].values[z];
             if (forSage)
                 fout << "',";
             fout << endl;
@@ -278,3 +604,138 @@ void KeccakFEquations::genAbsoluteValuesBeforeChi(ostream& fout, const vector<La
         iota(state, i);
     }
 }
+
+static const char matrixSignature[8] = { 'K', 'T', 'G', 'F', '2', 'M', 'a', 't' };
+static const UINT32 noVariable = 0xFFFFFFFF;
+
+static void writeUINT(ostream& fout, UINT64 value, unsigned int nrBytes)
+{
+    char bytes[8];
+    for(unsigned int i=0; i<nrBytes; i++)
+        bytes[i] = (char)((value >> (8*i)) & 0xFF);
+    fout.write(bytes, nrBytes);
+}
+
+template<class T>
+static void addModulo2(vector<T>& terms)
+{
+    sort(terms.begin(), terms.end());
+    unsigned int n = 0;
+    for(unsigned int i=0; i<terms.size(); ) {
+        unsigned int j = i+1;
+        while((j < terms.size()) && (terms[j] == terms[i]))
+            j++;
+        if ((j-i)%2 == 1)
+            terms[n++] = terms[i];
+        i = j;
+    }
+    terms.resize(n);
+}
+
+bool KeccakFEquations::getRoundMonomials(const vector<vector<unsigned int> >& linearInputs, int roundIndex, unsigned int bit,
+    vector<unsigned int>& linear, vector<pair<unsigned int, unsigned int> >& quadratic) const
+{
+    unsigned int xy = bit/laneSize, z = bit%laneSize;
+    unsigned int x = xy%5, y = xy/5;
+    const vector<unsigned int>& a0 = linearInputs[bit];
+    const vector<unsigned int>& a1 = linearInputs[index(x+1, y)*laneSize + z];
+    const vector<unsigned int>& a2 = linearInputs[index(x+2, y)*laneSize + z];
+    // a0 + (a1 + 1)*a2 = a0 + a2 + a1*a2
+    linear.assign(a0.begin(), a0.end());
+    linear.insert(linear.end(), a2.begin(), a2.end());
+    quadratic.clear();
+    for(unsigned int i=0; i<a1.size(); i++)
+        for(unsigned int j=0; j<a2.size(); j++) {
+            if (a1[i] == a2[j])
+                linear.push_back(a1[i]);
+            else
+                quadratic.push_back(make_pair(min(a1[i], a2[j]), max(a1[i], a2[j])));
+        }
+    addModulo2(linear);
+    addModulo2(quadratic);
+    vector<LaneValue> constant(25, 0);
+    iota(constant, roundIndex);
+    return ((constant[xy] >> z) & 1) != 0;
+}
+
+void KeccakFEquations::genRoundEquationsMatrix(ostream& fout, int startRoundIndex, unsigned nrRounds) const
+{
+    // For each bit after θ, ρ and π, the input bits it depends on
+    vector<vector<unsigned int> > linearInputs(width);
+    for(unsigned int i=0; i<width; i++) {
+        vector<LaneValue> unit(25, 0);
+        unit[i/laneSize] = (LaneValue)1 << (i%laneSize);
+        theta(unit);
+        rho(unit);
+        pi(unit);
+        for(unsigned int j=0; j<width; j++)
+            if ((unit[j/laneSize] >> (j%laneSize)) & 1)
+                linearInputs[j].push_back(i);
+    }
+
+    const UINT64 nrRows = (UINT64)nrRounds*width;
+    const UINT64 nrVariables = (UINT64)(nrRounds+1)*width;
+    vector<unsigned int> linear;
+    vector<pair<unsigned int, unsigned int> > quadratic;
+    vector<UINT32> columns;
+
+    // First pass: the quadratic monomials are numbered and the entries counted.
+    unordered_map<UINT64, UINT32> quadraticColumns;
+    vector<pair<UINT32, UINT32> > dictionary;
+    dictionary.push_back(make_pair(noVariable, noVariable));
+    for(UINT64 v=0; v<nrVariables; v++)
+        dictionary.push_back(make_pair((UINT32)v, noVariable));
+    vector<UINT64> rowBegins(1, 0);
+    rowBegins.reserve(nrRows+1);
+    for(unsigned int r=0; r<nrRounds; r++)
+    for(unsigned int bit=0; bit<width; bit++) {
+        bool constant = getRoundMonomials(linearInputs, startRoundIndex+r, bit, linear, quadratic);
+        for(unsigned int i=0; i<quadratic.size(); i++) {
+            UINT64 u = (UINT64)r*width + quadratic[i].first;
+            UINT64 v = (UINT64)r*width + quadratic[i].second;
+            if (quadraticColumns.insert(make_pair((u << 32) | v, (UINT32)dictionary.size())).second)
+                dictionary.push_back(make_pair((UINT32)u, (UINT32)v));
+        }
+        rowBegins.push_back(rowBegins.back() + 1 + linear.size() + quadratic.size() + (constant ? 1 : 0));
+    }
+    const UINT64 nrEntries = rowBegins.back();
+    if (dictionary.size() > noVariable)
+        throw KeccakException("KeccakFEquations::genRoundEquationsMatrix(): too many monomials.");
+
+    fout.write(matrixSignature, sizeof(matrixSignature));
+    writeUINT(fout, 1, 4);
+    writeUINT(fout, 0, 4);
+    writeUINT(fout, nrRows, 8);
+    writeUINT(fout, nrVariables, 8);
+    writeUINT(fout, dictionary.size(), 8);
+    writeUINT(fout, nrEntries, 8);
+
+    for(UINT64 i=0; i<rowBegins.size(); i++)
+        writeUINT(fout, rowBegins[i], 8);
+
+    // Second pass: the rows are computed again and written.
+    for(unsigned int r=0; r<nrRounds; r++)
+    for(unsigned int bit=0; bit<width; bit++) {
+        bool constant = getRoundMonomials(linearInputs, startRoundIndex+r, bit, linear, quadratic);
+        columns.clear();
+        if (constant)
+            columns.push_back(0);
+        for(unsigned int i=0; i<linear.size(); i++)
+            columns.push_back(1 + r*width + linear[i]);
+        columns.push_back(1 + (r+1)*width + bit);
+        for(unsigned int i=0; i<quadratic.size(); i++) {
+            UINT64 u = (UINT64)r*width + quadratic[i].first;
+            UINT64 v = (UINT64)r*width + quadratic[i].second;
+            columns.push_back(quadraticColumns[(u << 32) | v]);
+        }
+        sort(columns.begin(), columns.end());
+        for(unsigned int i=0; i<columns.size(); i++)
+            writeUINT(fout, columns[i], 4);
+    }
+    if (nrEntries%2 == 1)
+        writeUINT(fout, 0, 4);
+    for(unsigned int i=0; i<dictionary.size(); i++) {
+        writeUINT(fout, dictionary[i].first, 4);
+        writeUINT(fout, dictionary[i].second, 4);
+    }
+}
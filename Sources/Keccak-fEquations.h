@@ -16,7 +16,9 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #ifndef _KECCAKFEQUATIONS_H_
 #define _KECCAKFEQUATIONS_H_
 
+#include <functional>
 #include <iostream>
+#include <string>
 #include <vector>
 #include "Keccak-f.h"
 
@@ -70,6 +72,36 @@ public:
       * @param  nrRounds    The number of rounds to perform.
       */
     void genAbsoluteValuesBeforeChi(ostream& fout, const vector<LaneValue>& input, const string& prefix, int startRoundIndex, unsigned nrRounds) const;
+    /**
+      * Method that writes the same equations as genRoundEquations() as a sparse
+      * matrix over GF(2), in a binary format that can be mapped in memory.
+      * The equations are computed directly from the round structure, one at a time,
+      * and the matrix is written in two passes, the first one only counting the entries
+      * and numbering the monomials, so that only the monomial dictionary and the row offsets
+      * are kept in memory.
+      * Variable r*b + index(x, y)*laneSize + z, with b the width, is bit (x, y, z)
+      * at the input of round #r, i.e., the variable with prefix 'A'+r in genRoundEquations().
+      * Each row is the equation of one output bit, with the output variable, the linear terms,
+      * the quadratic terms and the constant on the same side, equal to 0.
+      * The columns are the monomials: column 0 is the constant 1,
+      * column 1+v is variable v and the following columns are the products of two variables,
+      * numbered by order of first appearance.
+      *
+      * The format consists of the following fields, with integers in little-endian order:
+      * - the signature "KTGF2Mat", the version 1 and a reserved 0, as 32-bit integers;
+      * - the number of rows, of variables, of columns and of non-zero entries, as 64-bit integers;
+      * - the compressed sparse rows (CSR): for each row and after the last, the index
+      *     of its first entry, as 64-bit integers, followed by the column of each entry,
+      *     by increasing column within a row, as 32-bit integers;
+      * - the monomial dictionary (padded to a multiple of 8 bytes): for each column,
+      *     the indexes of its two variables as 32-bit integers,
+      *     0xFFFFFFFF standing for no variable.
+      *
+      * @param  fout    The stream to which the matrix is written, opened in binary mode.
+      * @param  startRoundIndex The index of the first round to perform.
+      * @param  nrRounds    The number of rounds to perform.
+      */
+    void genRoundEquationsMatrix(ostream& fout, int startRoundIndex, unsigned nrRounds) const;
 protected:
     /**
       * Internal method to generate the equations from symbolic lanes.
@@ -92,6 +124,19 @@ protected:
       * @param  prefix  The prefix of the variables.
       */
     void initializeState(vector<SymbolicLane>& state, const string& prefix) const;
+    /**
+      * Internal method that computes the algebraic normal form of an output bit of a round,
+      * as the sorted lists of its linear terms and of its quadratic terms.
+      *
+      * @param  linearInputs    For each bit after θ, ρ and π, the sorted list of the input bits it depends on.
+      * @param  roundIndex  The index of the round.
+      * @param  bit     The output bit, as index(x, y)*laneSize + z.
+      * @param  linear  The input bits in the linear terms.
+      * @param  quadratic   The quadratic terms, as pairs of input bits.
+      * @return The constant term.
+      */
+    bool getRoundMonomials(const vector<vector<unsigned int> >& linearInputs, int roundIndex, unsigned int bit,
+        vector<unsigned int>& linear, vector<pair<unsigned int, unsigned int> >& quadratic) const;
 public:
     /**
       * Method that initializes the symbolic bits of a symbolic state
@@ -105,21 +150,81 @@ public:
 };
 
 /**
-  * Class implementing a symbolic bit in GF(2).
-  * The value is a string that can be modified with the methods of this class.
+  * Class implementing a symbolic bit in GF(2), i.e., a Boolean function of variables.
+  * The value is kept in algebraic normal form, as a sum of monomials,
+  * each monomial being a product of distinct atoms stored as a packed bitset of atom indexes.
+  * An atom is a variable, or a sum or a product of two expressions whose expansion would have
+  * more monomials than the expansion limit, see setExpansionLimit(), so that the memory
+  * grows linearly with the number of operations instead of exponentially with the number of rounds.
+  * The atoms, the monomials and the sums of monomials are hash-consed in global tables,
+  * so that a symbolic bit is just the index of its expression,
+  * equal expressions are stored only once and the sums and products are memoized.
+  * The names of the variables are only used when the expression is displayed.
+  * The global tables are never cleared and are not protected against concurrent accesses.
   */
 class SymbolicBit
 {
+protected:
+    /** The index of the expression in the global table. */
+    UINT32 expression;
 public:
-    string value;
-    bool containsAddition;
-public:
+    /** The constructor of the constant 0. */
     SymbolicBit();
+    /** The constructor of a constant.
+      * @param  aValue  The value of the constant.
+      */
     SymbolicBit(bool aValue);
-    SymbolicBit(const string& aValue, bool aContainsAddition=false);
+    /** The constructor of a variable.
+      * @param  variableName    The name of the variable, which identifies it.
+      */
+    SymbolicBit(const string& variableName);
+    /** This method adds the constant 1. */
     void complement();
+    /** This method adds another symbolic bit.
+      * @param  a   The symbolic bit to add.
+      */
     void add(const SymbolicBit& a);
+    /** This method multiplies by another symbolic bit.
+      * @param  a   The symbolic bit to multiply by.
+      */
     void multiply(const SymbolicBit& a);
+    /** This function sets the maximum number of monomials of the expansion of a sum or a product.
+      * A sum or a product with more monomials is kept as an atom, displayed with its two operands.
+      * @param  limit   The maximum number of monomials, 256 by default.
+      */
+    static void setExpansionLimit(unsigned int limit);
+    /** This method tells whether the expression is the constant 0 or 1.
+      * @return True if the expression is a constant.
+      */
+    bool isConstant() const { return expression <= 1; }
+    /** This method returns the number of monomials in the algebraic normal form.
+      * @return The number of monomials, including the constant 1 if present,
+      *         an unexpanded sum or product counting as one monomial.
+      */
+    unsigned int getNumberOfMonomials() const;
+    /** This method returns the algebraic degree. If a sum or a product was left unexpanded,
+      * the degree is computed from the degrees of its operands, so the result is an upper bound.
+      * @return The degree, or 0 for a constant.
+      */
+    unsigned int getDegree() const;
+    /** This method returns the expression as a string, e.g., "A[0] + A[1]*A[2] + 1",
+      * see operator<<().
+      * @return The expression as a string.
+      */
+    string getString() const;
+    /** This method evaluates the expression.
+      * @param  values  A function giving the value of a variable from its name.
+      * @return The value of the expression.
+      */
+    bool evaluate(const function<bool(const string&)>& values) const;
+    bool operator==(const SymbolicBit& a) const { return expression == a.expression; }
+    bool operator!=(const SymbolicBit& a) const { return expression != a.expression; }
+    /** This operator displays the expression, with the monomials
+      * by increasing number of atoms, then by order of creation of their atoms,
+      * and the constant 1 last. An unexpanded sum or product is displayed with its two operands,
+      * between parentheses if needed.
+      */
+    friend ostream& operator<<(ostream& fout, const SymbolicBit& a);
 };
 
 /**
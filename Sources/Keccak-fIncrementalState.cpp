@@ -0,0 +1,170 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <map>
+#include <mutex>
+#include "Keccak-fIncrementalState.h"
+
+using namespace std;
+
+IncrementalState::IncrementalState(const KeccakFPropagation& aDCorLC, bool aDirect)
+    : DCorLC(&aDCorLC), direct(aDirect), laneSize(aDCorLC.laneSize),
+    imageOfBit(getImagesOfBits(aDCorLC, aDirect)),
+    state(laneSize, 0), image(laneSize, 0),
+    weight(0), minReverseWeight(0), weightOfImage(0), minReverseWeightOfImage(0),
+    delta(laneSize, 0)
+{
+}
+
+IncrementalState::IncrementalState(const KeccakFPropagation& aDCorLC, bool aDirect, const vector<SliceValue>& aState)
+    : DCorLC(&aDCorLC), direct(aDirect), laneSize(aDCorLC.laneSize),
+    imageOfBit(getImagesOfBits(aDCorLC, aDirect)),
+    delta(laneSize, 0)
+{
+    set(aState);
+}
+
+void IncrementalState::set(const vector<SliceValue>& aState)
+{
+    state = aState;
+    if (direct)
+        DCorLC->directLambda(state, image);
+    else
+        DCorLC->reverseLambda(state, image);
+    weight = DCorLC->getWeight(state);
+    minReverseWeight = DCorLC->getMinReverseWeight(state);
+    weightOfImage = DCorLC->getWeight(image);
+    minReverseWeightOfImage = DCorLC->getMinReverseWeight(image);
+}
+
+void IncrementalState::toggleBit(const BitPosition& p)
+{
+    toggleStateSlice(p.z, (SliceValue)1 << (p.x+5*p.y));
+    accumulateImageOfBit(p.z, p.x+5*p.y);
+    applyDeltaToImage();
+}
+
+void IncrementalState::toggleColumn(unsigned int x, unsigned int z, ColumnValue column)
+{
+    SliceValue slice = 0;
+    for(unsigned int y=0; y<5; y++)
+        if ((column & (1 << y)) != 0)
+            slice ^= (SliceValue)1 << (x+5*y);
+    toggleSlice(z, slice);
+}
+
+void IncrementalState::toggleSlice(unsigned int z, SliceValue slice)
+{
+    if (slice == 0)
+        return;
+    toggleStateSlice(z, slice);
+    for(unsigned int i=0; i<25; i++)
+        if ((slice & ((SliceValue)1 << i)) != 0)
+            accumulateImageOfBit(z, i);
+    applyDeltaToImage();
+}
+
+void IncrementalState::toggle(const vector<SliceValue>& bits)
+{
+    // When the images to accumulate are larger than the state itself,
+    // e.g., with the dense θ-inverse, recomputing λ from scratch is cheaper.
+    unsigned int cost = 0;
+    for(unsigned int z=0; z<laneSize; z++)
+        for(unsigned int i=0; i<25; i++)
+            if ((bits[z] & ((SliceValue)1 << i)) != 0)
+                cost += (unsigned int)(*imageOfBit)[z*25+i].size();
+    if (cost > 2*laneSize) {
+        vector<SliceValue> newState(state);
+        for(unsigned int z=0; z<laneSize; z++)
+            newState[z] ^= bits[z];
+        set(newState);
+    }
+    else {
+        for(unsigned int z=0; z<laneSize; z++)
+            if (bits[z] != 0) {
+                toggleStateSlice(z, bits[z]);
+                for(unsigned int i=0; i<25; i++)
+                    if ((bits[z] & ((SliceValue)1 << i)) != 0)
+                        accumulateImageOfBit(z, i);
+            }
+        applyDeltaToImage();
+    }
+}
+
+void IncrementalState::accumulateImageOfBit(unsigned int z, unsigned int i)
+{
+    const vector<pair<unsigned int, SliceValue> >& bitImage = (*imageOfBit)[z*25+i];
+    for(unsigned int j=0; j<bitImage.size(); j++) {
+        unsigned int zImage = bitImage[j].first;
+        if (delta[zImage] == 0)
+            touched.push_back(zImage);
+        delta[zImage] ^= bitImage[j].second;
+    }
+}
+
+void IncrementalState::toggleStateSlice(unsigned int z, SliceValue slice)
+{
+    weight -= DCorLC->getWeight(state[z]);
+    minReverseWeight -= DCorLC->getMinReverseWeight(state[z]);
+    state[z] ^= slice;
+    weight += DCorLC->getWeight(state[z]);
+    minReverseWeight += DCorLC->getMinReverseWeight(state[z]);
+}
+
+void IncrementalState::applyDeltaToImage()
+{
+    for(unsigned int j=0; j<touched.size(); j++) {
+        unsigned int z = touched[j];
+        // A slice may be touched again after its delta cancelled out, hence listed twice.
+        if (delta[z] == 0)
+            continue;
+        weightOfImage -= DCorLC->getWeight(image[z]);
+        minReverseWeightOfImage -= DCorLC->getMinReverseWeight(image[z]);
+        image[z] ^= delta[z];
+        weightOfImage += DCorLC->getWeight(image[z]);
+        minReverseWeightOfImage += DCorLC->getMinReverseWeight(image[z]);
+        delta[z] = 0;
+    }
+    touched.clear();
+}
+
+shared_ptr<const IncrementalState::ImagesOfBits> IncrementalState::getImagesOfBits(const KeccakFPropagation& DCorLC, bool direct)
+{
+    // λ depends only on the lane size, on the propagation type and on the direction.
+    static mutex lock;
+    static map<unsigned int, shared_ptr<const ImagesOfBits> > cache;
+    unsigned int key = DCorLC.laneSize*4 + (DCorLC.getPropagationType() == KeccakFPropagation::DC ? 0 : 2) + (direct ? 0 : 1);
+    lock_guard<mutex> guard(lock);
+    shared_ptr<const ImagesOfBits>& images = cache[key];
+    if (!images) {
+        unsigned int laneSize = DCorLC.laneSize;
+        ImagesOfBits *newImages = new ImagesOfBits(laneSize*25);
+        vector<SliceValue> unit(laneSize, 0), unitImage;
+        for(unsigned int z=0; z<laneSize; z++)
+            for(unsigned int i=0; i<25; i++) {
+                unit[z] = (SliceValue)1 << i;
+                if (direct)
+                    DCorLC.directLambda(unit, unitImage);
+                else
+                    DCorLC.reverseLambda(unit, unitImage);
+                for(unsigned int zImage=0; zImage<laneSize; zImage++)
+                    if (unitImage[zImage] != 0)
+                        (*newImages)[z*25+i].push_back(make_pair(zImage, unitImage[zImage]));
+                unit[z] = 0;
+            }
+        images.reset(newImages);
+    }
+    return images;
+}
@@ -0,0 +1,148 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFINCREMENTALSTATE_H_
+#define _KECCAKFINCREMENTALSTATE_H_
+
+#include <memory>
+#include <vector>
+#include "Keccak-fParts.h"
+#include "Keccak-fPositions.h"
+#include "Keccak-fPropagation.h"
+
+using namespace std;
+
+/** This class keeps a state, its image through λ and their weights up to date
+  * while bits, columns or slices of the state are toggled.
+  * The image is computed in the "direct" or in the "reverse" direction,
+  * see KeccakFPropagation::directLambda() and KeccakFPropagation::reverseLambda().
+  * As λ is linear, toggling bits of the state toggles the XOR of their images,
+  * which are precomputed once per lane size, propagation type and direction.
+  * Only the slices that change are then looked up to update the weights,
+  * so the cost of a toggle is proportional to the number of affected slices
+  * instead of to the lane size.
+  * Since toggling twice the same bits restores the previous values,
+  * a search can undo its last step by toggling the same bits again.
+  */
+class IncrementalState {
+public:
+    /** The type of the precomputed images through λ, see imageOfBit. */
+    typedef vector<vector<pair<unsigned int, SliceValue> > > ImagesOfBits;
+protected:
+    /** The propagation context. */
+    const KeccakFPropagation *DCorLC;
+    /** Whether the image is computed with the direct λ (true) or the reverse λ (false). */
+    bool direct;
+    /** The lane size. */
+    unsigned int laneSize;
+    /** The image through λ of each bit with index z*25+x+5y,
+      * as a list of (slice index, slice value) for the non-zero slices.
+      */
+    shared_ptr<const ImagesOfBits> imageOfBit;
+    /** The state. */
+    vector<SliceValue> state;
+    /** The image of the state through λ. */
+    vector<SliceValue> image;
+    /** The propagation weight of state. */
+    unsigned int weight;
+    /** The minimum reverse weight of state. */
+    unsigned int minReverseWeight;
+    /** The propagation weight of image. */
+    unsigned int weightOfImage;
+    /** The minimum reverse weight of image. */
+    unsigned int minReverseWeightOfImage;
+    /** A working copy of a slice difference per slice index, kept all-zero between the calls. */
+    vector<SliceValue> delta;
+    /** The slice indexes touched in delta. */
+    vector<unsigned int> touched;
+public:
+    /** This constructor initializes the state to zero.
+      * @param  aDCorLC The propagation context.
+      * @param  aDirect Whether the image is computed with the direct λ (true)
+      *                 or with the reverse λ (false).
+      */
+    IncrementalState(const KeccakFPropagation& aDCorLC, bool aDirect);
+    /** This constructor initializes the state to the given value.
+      * @param  aDCorLC The propagation context.
+      * @param  aDirect Whether the image is computed with the direct λ (true)
+      *                 or with the reverse λ (false).
+      * @param  aState  The initial value of the state.
+      */
+    IncrementalState(const KeccakFPropagation& aDCorLC, bool aDirect, const vector<SliceValue>& aState);
+    /** This method sets the state to the given value and computes its image and the weights from scratch.
+      * @param  aState  The new value of the state.
+      */
+    void set(const vector<SliceValue>& aState);
+    /** This method toggles one bit of the state.
+      * @param  p   The position of the bit to toggle.
+      */
+    void toggleBit(const BitPosition& p);
+    /** This method toggles several bits of a column of the state.
+      * @param  x   The x coordinate of the column.
+      * @param  z   The z coordinate of the column.
+      * @param  column  The bits to toggle, with bit y for the row y.
+      */
+    void toggleColumn(unsigned int x, unsigned int z, ColumnValue column);
+    /** This method toggles several bits of a slice of the state.
+      * @param  z   The z coordinate of the slice.
+      * @param  slice   The bits to toggle.
+      */
+    void toggleSlice(unsigned int z, SliceValue slice);
+    /** This method toggles the bits of the state that are set in the given state.
+      * @param  bits    The bits to toggle, given as a vector of slices.
+      */
+    void toggle(const vector<SliceValue>& bits);
+    /** This method returns the state.
+      * @return A reference to the state as a vector of slices.
+      */
+    const vector<SliceValue>& getState() const { return state; }
+    /** This method returns the image of the state through λ.
+      * @return A reference to the image as a vector of slices.
+      */
+    const vector<SliceValue>& getImage() const { return image; }
+    /** This method returns the propagation weight of the state.
+      * @return The weight of the state.
+      */
+    unsigned int getWeight() const { return weight; }
+    /** This method returns the minimum reverse weight of the state.
+      * @return The minimum reverse weight of the state.
+      */
+    unsigned int getMinReverseWeight() const { return minReverseWeight; }
+    /** This method returns the propagation weight of the image of the state through λ.
+      * @return The weight of the image.
+      */
+    unsigned int getWeightOfImage() const { return weightOfImage; }
+    /** This method returns the minimum reverse weight of the image of the state through λ.
+      * @return The minimum reverse weight of the image.
+      */
+    unsigned int getMinReverseWeightOfImage() const { return minReverseWeightOfImage; }
+protected:
+    /** This method XORs the image of the bit with index z*25+i into delta. */
+    void accumulateImageOfBit(unsigned int z, unsigned int i);
+    /** This method toggles the bits in @a slice of the state slice @a z
+      * and updates the weights of the state accordingly.
+      */
+    void toggleStateSlice(unsigned int z, SliceValue slice);
+    /** This method applies delta to the image, updates the weights of the image
+      * and resets delta to zero.
+      */
+    void applyDeltaToImage();
+    /** This method returns the images of all the bits for the given propagation context and direction,
+      * computing them only the first time they are requested.
+      */
+    static shared_ptr<const ImagesOfBits> getImagesOfBits(const KeccakFPropagation& DCorLC, bool direct);
+};
+
+#endif
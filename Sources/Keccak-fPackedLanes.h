@@ -0,0 +1,161 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFPACKEDLANES_H_
+#define _KECCAKFPACKEDLANES_H_
+
+#include <vector>
+#include "Keccak-f.h"
+
+using namespace std;
+
+/**
+  * Class implementing the lanes at the same position in @a N independent states,
+  * typically 4, 8 or 16 states. It can be given as the parameter @a Lane of the
+  * template methods of KeccakF and KeccakFDCLC, e.g., KeccakF::forward(),
+  * KeccakF::round() or KeccakFDCLC::lambda(), which then process the @a N states at once.
+  * Each operation is a loop of @a N iterations on independent 64-bit words,
+  * which the compiler turns into SIMD instructions as far as the target allows.
+  * As with LaneValue, only the first laneSize bits of each lane are meaningful;
+  * see packLanes() and unpackLanes() to convert from and to the states of LaneValue.
+  */
+template<unsigned int N>
+class PackedLanes {
+public:
+    /** The lanes, where lanes[i] belongs to the i-th state. */
+    LaneValue lanes[N];
+public:
+    /** The constructor, which sets all the lanes to zero. */
+    PackedLanes()
+    {
+        for(unsigned int i=0; i<N; i++)
+            lanes[i] = 0;
+    }
+    /** The constructor, which sets all the lanes to @a value, e.g., a round constant. */
+    PackedLanes(LaneValue value)
+    {
+        for(unsigned int i=0; i<N; i++)
+            lanes[i] = value;
+    }
+    /**
+      * Method that translates all the lanes along the z-axis, as KeccakF::ROL() on a LaneValue.
+      *
+      * @param  offset      The translation offset. It can be any signed
+      *                     integer, as it will be reduced modulo @a laneSize.
+      * @param  laneSize    The size of the lanes.
+      */
+    void ROL(int offset, unsigned int laneSize)
+    {
+        LaneValue mask = (laneSize < 64) ? ((LaneValue)1 << laneSize) - 1 : ~(LaneValue)0;
+        offset %= (int)laneSize;
+        if (offset < 0) offset += laneSize;
+        if (offset != 0)
+            for(unsigned int i=0; i<N; i++) {
+                LaneValue L = lanes[i] & mask;
+                lanes[i] = ((L << offset) ^ (L >> (laneSize-offset))) & mask;
+            }
+        else
+            for(unsigned int i=0; i<N; i++)
+                lanes[i] &= mask;
+    }
+    friend PackedLanes operator~(const PackedLanes& a)
+    {
+        PackedLanes result;
+        for(unsigned int i=0; i<N; i++)
+            result.lanes[i] = ~a.lanes[i];
+        return result;
+    }
+    friend PackedLanes operator^(const PackedLanes& a, const PackedLanes& b)
+    {
+        PackedLanes result;
+        for(unsigned int i=0; i<N; i++)
+            result.lanes[i] = a.lanes[i] ^ b.lanes[i];
+        return result;
+    }
+    friend PackedLanes operator^(const PackedLanes& a, LaneValue b)
+    {
+        PackedLanes result;
+        for(unsigned int i=0; i<N; i++)
+            result.lanes[i] = a.lanes[i] ^ b;
+        return result;
+    }
+    friend PackedLanes operator&(const PackedLanes& a, const PackedLanes& b)
+    {
+        PackedLanes result;
+        for(unsigned int i=0; i<N; i++)
+            result.lanes[i] = a.lanes[i] & b.lanes[i];
+        return result;
+    }
+    friend PackedLanes operator&(const PackedLanes& a, LaneValue b)
+    {
+        PackedLanes result;
+        for(unsigned int i=0; i<N; i++)
+            result.lanes[i] = a.lanes[i] & b;
+        return result;
+    }
+    PackedLanes& operator^=(const PackedLanes& b)
+    {
+        for(unsigned int i=0; i<N; i++)
+            lanes[i] ^= b.lanes[i];
+        return *this;
+    }
+    PackedLanes& operator^=(LaneValue b)
+    {
+        for(unsigned int i=0; i<N; i++)
+            lanes[i] ^= b;
+        return *this;
+    }
+    bool operator==(const PackedLanes& b) const
+    {
+        for(unsigned int i=0; i<N; i++)
+            if (lanes[i] != b.lanes[i])
+                return false;
+        return true;
+    }
+    bool operator!=(const PackedLanes& b) const { return !(*this == b); }
+};
+
+/**
+  * Function that gathers @a N states into one state of packed lanes.
+  *
+  * @param  states  A pointer to @a N states, each a vector of the same number of lanes.
+  * @param  packed  The state of packed lanes, whose lanes[i] come from @a states[i].
+  */
+template<unsigned int N>
+void packLanes(const vector<LaneValue> *states, vector<PackedLanes<N> >& packed)
+{
+    packed.resize(states[0].size());
+    for(unsigned int j=0; j<packed.size(); j++)
+        for(unsigned int i=0; i<N; i++)
+            packed[j].lanes[i] = states[i][j];
+}
+
+/**
+  * Function that scatters a state of packed lanes into @a N states, as the inverse of packLanes().
+  *
+  * @param  packed  The state of packed lanes.
+  * @param  states  A pointer to @a N states, resized to the number of lanes of @a packed.
+  */
+template<unsigned int N>
+void unpackLanes(const vector<PackedLanes<N> >& packed, vector<LaneValue> *states)
+{
+    for(unsigned int i=0; i<N; i++) {
+        states[i].resize(packed.size());
+        for(unsigned int j=0; j<packed.size(); j++)
+            states[i][j] = packed[j].lanes[i];
+    }
+}
+
+#endif
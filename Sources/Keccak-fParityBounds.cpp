@@ -13,6 +13,7 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
 #include <sstream>
 #include "Keccak-fParityBounds.h"
 #include "Keccak-fPositions.h"
@@ -29,25 +30,67 @@ unsigned int getBoundOfTotalWeightGivenTotalHammingWeight(const KeccakFPropagati
     // The check was done both for DC and LC.
 }
 
-unsigned int getLowerBoundTotalActiveRowsFromACandUOC(const KeccakFPropagation& DCorLC,
+ParityBoundsTables::ParityBoundsTables(const KeccakFPropagation& DCorLC)
+    : laneSize(DCorLC.laneSize), rowsBefore(25*laneSize), rowsAfter(25*laneSize),
+    columnOfT(5*laneSize), tTranslatedAlongX(5*laneSize)
+{
+    for(unsigned int z=0; z<laneSize; z++)
+    for(unsigned int x=0; x<5; x++)
+    for(unsigned int y=0; y<5; y++) {
+        BitPosition before(x, y, z);
+        DCorLC.reverseRhoPiBeforeTheta(before);
+        BitPosition after(x, y, z);
+        DCorLC.directRhoPiAfterTheta(after);
+        rowsBefore[5*(x+5*z)+y] = before.y + 5*before.z;
+        rowsAfter[5*(x+5*z)+y] = after.y + 5*after.z;
+    }
+    for(unsigned int t=0; t<5*laneSize; t++) {
+        unsigned int x, z;
+        DCorLC.getXandZfromT(t, x, z);
+        columnOfT[t] = x + 5*z;
+        tTranslatedAlongX[t] = DCorLC.translateAlongXinT(t);
+    }
+}
+
+/** This class gives the same as ParityBoundsTables, computed with the KeccakFPropagation object. */
+class ParityBoundsPropagation
+{
+protected:
+    const KeccakFPropagation& DCorLC;
+public:
+    ParityBoundsPropagation(const KeccakFPropagation& aDCorLC) : DCorLC(aDCorLC) {}
+    unsigned int getLaneSize() const { return DCorLC.laneSize; }
+    void getXandZfromT(unsigned int t, unsigned int& x, unsigned int& z) const { DCorLC.getXandZfromT(t, x, z); }
+    unsigned int translateAlongXinT(unsigned int t) const { return DCorLC.translateAlongXinT(t); }
+    void getRows(unsigned int x, unsigned int y, unsigned int z, unsigned int& before, unsigned int& after) const
+    {
+        BitPosition left(x, y, z);
+        DCorLC.reverseRhoPiBeforeTheta(left);
+        before = left.y + 5*left.z;
+        BitPosition right(x, y, z);
+        DCorLC.directRhoPiAfterTheta(right);
+        after = right.y + 5*right.z;
+    }
+};
+
+template<class Geometry>
+unsigned int getLowerBoundTotalActiveRowsFromACandUOC(const Geometry& geometry,
     const vector<ColumnPosition>& xzAC, const vector<ColumnPosition>& xzUOC)
 {
     unsigned int activeRows = 0;
-    vector<vector<bool> > rowTakenLeft(5, vector<bool>(DCorLC.laneSize, false));
-    vector<vector<bool> > rowTakenRight(5, vector<bool>(DCorLC.laneSize, false));
+    vector<bool> rowTakenLeft(5*geometry.getLaneSize(), false);
+    vector<bool> rowTakenRight(5*geometry.getLaneSize(), false);
 
     for(unsigned int i=0; i<xzAC.size(); i++) {
         unsigned int x = xzAC[i].x;
         unsigned int z = xzAC[i].z;
         for(unsigned int y=0; y<5; y++) {
-            BitPosition left(x, y, z);
-            DCorLC.reverseRhoPiBeforeTheta(left);
-            BitPosition right(x, y, z);
-            DCorLC.directRhoPiAfterTheta(right);
-            if ((!rowTakenLeft[left.y][left.z]) && (!rowTakenRight[right.y][right.z])) {
+            unsigned int left, right;
+            geometry.getRows(x, y, z, left, right);
+            if ((!rowTakenLeft[left]) && (!rowTakenRight[right])) {
                 activeRows++;
-                rowTakenLeft[left.y][left.z] = true;
-                rowTakenRight[right.y][right.z] = true;
+                rowTakenLeft[left] = true;
+                rowTakenRight[right] = true;
             }
         }
     }
@@ -58,40 +101,29 @@ unsigned int getLowerBoundTotalActiveRowsFromACandUOC(const KeccakFPropagation&
         bool takenLeft = false;
         bool takenRight = false;
         for(unsigned int y=0; y<5; y++) {
-            BitPosition left(x, y, z);
-            DCorLC.reverseRhoPiBeforeTheta(left);
-            BitPosition right(x, y, z);
-            DCorLC.directRhoPiAfterTheta(right);
-            takenLeft |= rowTakenLeft[left.y][left.z];
-            takenRight |= rowTakenRight[right.y][right.z];
-            rowTakenLeft[left.y][left.z] = true;
-            rowTakenRight[right.y][right.z] = true;
+            unsigned int left, right;
+            geometry.getRows(x, y, z, left, right);
+            takenLeft |= rowTakenLeft[left];
+            takenRight |= rowTakenRight[right];
+            rowTakenLeft[left] = true;
+            rowTakenRight[right] = true;
         }
         if (!takenLeft)
             activeRows++;
         if (!takenRight)
             activeRows++;
-        for(unsigned int y=0; y<5; y++) {
-            BitPosition left(x, y, z);
-            DCorLC.reverseRhoPiBeforeTheta(left);
-            BitPosition  right(x, y, z);
-            DCorLC.directRhoPiAfterTheta(right);
-            if (takenLeft)
-                rowTakenLeft[left.y][left.z] = true;
-            if (takenRight)
-                rowTakenRight[right.y][right.z] = true;
-        }
     }
 
     return activeRows;
 }
 
-unsigned int getLowerBoundTotalActiveRows(const KeccakFPropagation& DCorLC,
+template<class Geometry>
+unsigned int getLowerBoundTotalActiveRowsOfParity(const Geometry& geometry,
     const vector<RowValue>& C, const vector<RowValue>& D)
 {
     vector<ColumnPosition> xzAC, xzUOC;
     for(unsigned int x=0; x<5; x++)
-    for(unsigned int z=0; z<DCorLC.laneSize; z++) {
+    for(unsigned int z=0; z<geometry.getLaneSize(); z++) {
         bool odd = (getBit(C, x, z) != 0);
         bool affected = (getBit(D, x, z) != 0);
         if (affected)
@@ -101,7 +133,19 @@ unsigned int getLowerBoundTotalActiveRows(const KeccakFPropagation& DCorLC,
                 xzUOC.push_back(ColumnPosition(x, z));
         }
     }
-    return getLowerBoundTotalActiveRowsFromACandUOC(DCorLC, xzAC, xzUOC);
+    return getLowerBoundTotalActiveRowsFromACandUOC(geometry, xzAC, xzUOC);
+}
+
+unsigned int getLowerBoundTotalActiveRows(const KeccakFPropagation& DCorLC,
+    const vector<RowValue>& C, const vector<RowValue>& D)
+{
+    return getLowerBoundTotalActiveRowsOfParity(ParityBoundsPropagation(DCorLC), C, D);
+}
+
+unsigned int getLowerBoundTotalActiveRows(const ParityBoundsTables& tables,
+    const vector<RowValue>& C, const vector<RowValue>& D)
+{
+    return getLowerBoundTotalActiveRowsOfParity(tables, C, D);
 }
 
 string Run::display() const
@@ -144,79 +188,122 @@ void ParityAsRuns::toParityAndParityEffect(const KeccakFPropagation& DCorLC, vec
     }
 }
 
-unsigned int ParityAsRuns::getLowerBoundTotalHammingWeight(const KeccakFPropagation& DCorLC) const
+template<class Geometry>
+unsigned int getLowerBoundTotalHammingWeightOfRuns(const Geometry& geometry, const vector<Run>& runs)
 {
-    vector<bool> affected(DCorLC.laneSize*5, false);
+    const unsigned int period = geometry.getLaneSize()*5;
+    vector<unsigned int> affected;
+    affected.reserve(2*runs.size());
     for(unsigned int i=0; i<runs.size(); i++) {
-        affected[DCorLC.translateAlongXinT(runs[i].tStart)] = true;
-        affected[DCorLC.translateAlongXinT(runs[i].tStart + runs[i].length)] = true;
+        affected.push_back(geometry.translateAlongXinT(runs[i].tStart));
+        affected.push_back(geometry.translateAlongXinT(runs[i].tStart + runs[i].length));
     }
+    sort(affected.begin(), affected.end());
+    affected.erase(unique(affected.begin(), affected.end()), affected.end());
+    // Each position of a run counts 2 unless its column is affected,
+    // so the affected positions covered by the runs are subtracted from their lengths.
     unsigned int total = 5*2*runs.size();
     for(unsigned int i=0; i<runs.size(); i++) {
-        for(unsigned int t=runs[i].tStart; t<runs[i].tStart+runs[i].length; t++) {
-            if (!affected[t % (DCorLC.laneSize*5)])
-                total += 2;
+        unsigned int unaffected = runs[i].length;
+        for(unsigned int j=0; j<affected.size(); j++) {
+            unsigned int d = (affected[j] + period - (runs[i].tStart % period)) % period;
+            if (d < runs[i].length)
+                unaffected -= (runs[i].length - d - 1)/period + 1;
         }
+        total += 2*unaffected;
     }
     return total;
 }
 
-unsigned int ParityAsRuns::getLowerBoundTotalActiveRowsUsingOnlyAC(const KeccakFPropagation& DCorLC) const
+template<class Geometry>
+unsigned int getLowerBoundTotalActiveRowsOfRunsUsingOnlyAC(const Geometry& geometry, const vector<Run>& runs)
 {
     vector<ColumnPosition> xzAC, xzUOC;
     for(unsigned int i=0; i<runs.size(); i++) {
         unsigned int x, z;
-        DCorLC.getXandZfromT(DCorLC.translateAlongXinT(runs[i].tStart), x, z);
+        geometry.getXandZfromT(geometry.translateAlongXinT(runs[i].tStart), x, z);
         xzAC.push_back(ColumnPosition(x, z));
-        DCorLC.getXandZfromT(DCorLC.translateAlongXinT(runs[i].tStart + runs[i].length), x, z);
+        geometry.getXandZfromT(geometry.translateAlongXinT(runs[i].tStart + runs[i].length), x, z);
         xzAC.push_back(ColumnPosition(x, z));
     }
-    return getLowerBoundTotalActiveRowsFromACandUOC(DCorLC, xzAC, xzUOC);
+    return getLowerBoundTotalActiveRowsFromACandUOC(geometry, xzAC, xzUOC);
 }
 
-unsigned int ParityAsRuns::getLowerBoundTotalActiveRows(const KeccakFPropagation& DCorLC) const
+template<class Geometry>
+unsigned int getLowerBoundTotalActiveRowsOfRuns(const Geometry& geometry, const vector<Run>& runs)
 {
+    const unsigned int period = geometry.getLaneSize()*5;
     vector<ColumnPosition> xzAC, xzUOC;
-    vector<bool> affected(DCorLC.laneSize*5, false);
+    vector<bool> affected(period, false);
     for(unsigned int i=0; i<runs.size(); i++) {
         unsigned int x, z;
-        DCorLC.getXandZfromT(DCorLC.translateAlongXinT(runs[i].tStart), x, z);
+        geometry.getXandZfromT(geometry.translateAlongXinT(runs[i].tStart), x, z);
         xzAC.push_back(ColumnPosition(x, z));
-        DCorLC.getXandZfromT(DCorLC.translateAlongXinT(runs[i].tStart + runs[i].length), x, z);
+        geometry.getXandZfromT(geometry.translateAlongXinT(runs[i].tStart + runs[i].length), x, z);
         xzAC.push_back(ColumnPosition(x, z));
-        affected[DCorLC.translateAlongXinT(runs[i].tStart)] = true;
-        affected[DCorLC.translateAlongXinT(runs[i].tStart + runs[i].length)] = true;
+        affected[geometry.translateAlongXinT(runs[i].tStart)] = true;
+        affected[geometry.translateAlongXinT(runs[i].tStart + runs[i].length)] = true;
     }
     for(unsigned int i=0; i<runs.size(); i++) {
         for(unsigned int t=runs[i].tStart; t<runs[i].tStart+runs[i].length; t++) {
-            if (!affected[t % (DCorLC.laneSize*5)]) {
+            if (!affected[t % period]) {
                 unsigned int x, z;
-                DCorLC.getXandZfromT(t, x, z);
+                geometry.getXandZfromT(t, x, z);
                 xzUOC.push_back(ColumnPosition(x, z));
             }
         }
     }
-    return getLowerBoundTotalActiveRowsFromACandUOC(DCorLC, xzAC, xzUOC);
+    return getLowerBoundTotalActiveRowsFromACandUOC(geometry, xzAC, xzUOC);
+}
+
+unsigned int ParityAsRuns::getLowerBoundTotalHammingWeight(const KeccakFPropagation& DCorLC) const
+{
+    return getLowerBoundTotalHammingWeightOfRuns(ParityBoundsPropagation(DCorLC), runs);
+}
+
+unsigned int ParityAsRuns::getLowerBoundTotalHammingWeight(const ParityBoundsTables& tables) const
+{
+    return getLowerBoundTotalHammingWeightOfRuns(tables, runs);
+}
+
+unsigned int ParityAsRuns::getLowerBoundTotalActiveRowsUsingOnlyAC(const KeccakFPropagation& DCorLC) const
+{
+    return getLowerBoundTotalActiveRowsOfRunsUsingOnlyAC(ParityBoundsPropagation(DCorLC), runs);
+}
+
+unsigned int ParityAsRuns::getLowerBoundTotalActiveRowsUsingOnlyAC(const ParityBoundsTables& tables) const
+{
+    return getLowerBoundTotalActiveRowsOfRunsUsingOnlyAC(tables, runs);
+}
+
+unsigned int ParityAsRuns::getLowerBoundTotalActiveRows(const KeccakFPropagation& DCorLC) const
+{
+    return getLowerBoundTotalActiveRowsOfRuns(ParityBoundsPropagation(DCorLC), runs);
+}
+
+unsigned int ParityAsRuns::getLowerBoundTotalActiveRows(const ParityBoundsTables& tables) const
+{
+    return getLowerBoundTotalActiveRowsOfRuns(tables, runs);
 }
 
-void lookForRunsBelowTargetWeight(const KeccakFPropagation& DCorLC, ostream& out,
+void lookForRunsBelowTargetWeight(const KeccakFPropagation& DCorLC, const ParityBoundsTables& tables, ostream& out,
     unsigned int targetWeight, ParityAsRuns& parity, ProgressMeter& progress, bool verbose)
 {
     unsigned int lowerBound;
     unsigned int weightBoundBasedOnTotalHammingWeight = getBoundOfTotalWeightGivenTotalHammingWeight(DCorLC,
-        parity.getLowerBoundTotalHammingWeight(DCorLC));
+        parity.getLowerBoundTotalHammingWeight(tables));
     if (weightBoundBasedOnTotalHammingWeight <= targetWeight) {
-        unsigned int minActiveRows = parity.getLowerBoundTotalActiveRowsUsingOnlyAC(DCorLC);
+        unsigned int minActiveRows = parity.getLowerBoundTotalActiveRowsUsingOnlyAC(tables);
         lowerBound = max(minActiveRows*2, weightBoundBasedOnTotalHammingWeight);
     }
     else
         lowerBound = weightBoundBasedOnTotalHammingWeight;
     if (lowerBound <= targetWeight) {
-        unsigned int thisOneLowerBound = parity.getLowerBoundTotalActiveRows(DCorLC)*2;
+        unsigned int thisOneLowerBound = parity.getLowerBoundTotalActiveRows(tables)*2;
         if (thisOneLowerBound <= targetWeight) {
             vector<RowValue> C, D;
             parity.toParityAndParityEffect(DCorLC, C, D);
-            unsigned int thisOneLowerBoundAgain = getLowerBoundTotalActiveRows(DCorLC, C, D)*2;
+            unsigned int thisOneLowerBoundAgain = getLowerBoundTotalActiveRows(tables, C, D)*2;
             if (thisOneLowerBoundAgain <= targetWeight) {
                 if (verbose) {
                     displayParity(cout, C, D);
@@ -237,7 +324,7 @@ void lookForRunsBelowTargetWeight(const KeccakFPropagation& DCorLC, ostream& out
                 run.tStart = tStart;
                 run.length = length;
                 parity.runs.push_back(run);
-                lookForRunsBelowTargetWeight(DCorLC, out, targetWeight, parity, progress, verbose);
+                lookForRunsBelowTargetWeight(DCorLC, tables, out, targetWeight, parity, progress, verbose);
                 parity.runs.pop_back();
                 ++progress;
             }
@@ -249,6 +336,7 @@ void lookForRunsBelowTargetWeight(const KeccakFPropagation& DCorLC, ostream& out
 void lookForRunsBelowTargetWeight(const KeccakFPropagation& DCorLC, ostream& out,  unsigned int targetWeight, bool verbose)
 {
     ProgressMeter progress;
+    ParityBoundsTables tables(DCorLC);
     progress.stack("Initial run starting point", 5);
     for(unsigned int tStart=0; tStart<5; tStart++) {
         progress.stack("Initial run length", DCorLC.laneSize*5-1);
@@ -258,7 +346,7 @@ void lookForRunsBelowTargetWeight(const KeccakFPropagation& DCorLC, ostream& out
             run.tStart = tStart;
             run.length = length;
             parity.runs.push_back(run);
-            lookForRunsBelowTargetWeight(DCorLC, out, targetWeight, parity, progress, verbose);
+            lookForRunsBelowTargetWeight(DCorLC, tables, out, targetWeight, parity, progress, verbose);
             ++progress;
         }
         progress.unstack();
@@ -20,6 +20,54 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include "Keccak-fParts.h"
 #include "Keccak-fPropagation.h"
 
+/** Class that tabulates what the bounds on parities need from the propagation context:
+  * the rows that the bits of each column occupy before and after λ,
+  * and the correspondence between the @a t coordinate and the columns.
+  * The bounds computed with it are the same as with the KeccakFPropagation object,
+  * but cost table look-ups instead of the computation of ρ and π.
+  * It does not change after its construction, so several threads can share it.
+  */
+class ParityBoundsTables
+{
+protected:
+    /** The lane size. */
+    unsigned int laneSize;
+    /** The entry 5*(x+5*z)+y contains y'+5*z', where (y', z') is the row of the bit (x, y, z) before λ. */
+    vector<UINT16> rowsBefore;
+    /** The same as rowsBefore, for the row after λ. */
+    vector<UINT16> rowsAfter;
+    /** The entry t contains x+5*z, where (x, z) is the column with coordinate t modulo 5*laneSize. */
+    vector<UINT16> columnOfT;
+    /** The entry t contains KeccakFPropagation::translateAlongXinT(t) for 0 ≤ t < 5*laneSize. */
+    vector<UINT16> tTranslatedAlongX;
+public:
+    /** The constructor.
+      * @param   DCorLC The propagation context of the parities.
+      */
+    ParityBoundsTables(const KeccakFPropagation& DCorLC);
+    /** This method returns the lane size. */
+    unsigned int getLaneSize() const { return laneSize; }
+    /** See KeccakFPropagation::getXandZfromT(). */
+    void getXandZfromT(unsigned int t, unsigned int& x, unsigned int& z) const
+    {
+        unsigned int xz = columnOfT[t % (5*laneSize)];
+        x = xz % 5;
+        z = xz / 5;
+    }
+    /** See KeccakFPropagation::translateAlongXinT(). */
+    unsigned int translateAlongXinT(unsigned int t) const
+    {
+        return tTranslatedAlongX[t % (5*laneSize)];
+    }
+    /** This method returns the rows, as y+5*z, of the bit (x, y, z) before λ in @a before and after λ in @a after. */
+    void getRows(unsigned int x, unsigned int y, unsigned int z, unsigned int& before, unsigned int& after) const
+    {
+        unsigned int i = 5*(x+5*z)+y;
+        before = rowsBefore[i];
+        after = rowsAfter[i];
+    }
+};
+
 /** Given the parity @a C and the θ-effect @a D, this function computes
   * a lower bound on the total number of active rows before and after λ.
   * This follows the algorithm in the paper "Differential propagation of Keccak"
@@ -34,6 +82,12 @@ http://creativecommons.org/publicdomain/zero/1.0/
 unsigned int getLowerBoundTotalActiveRows(const KeccakFPropagation& DCorLC,
     const vector<RowValue>& C, const vector<RowValue>& D);
 
+/** This function is the same as ::getLowerBoundTotalActiveRows(const KeccakFPropagation&, const vector<RowValue>&, const vector<RowValue>&),
+  * with the tables of the propagation context.
+  */
+unsigned int getLowerBoundTotalActiveRows(const ParityBoundsTables& tables,
+    const vector<RowValue>& C, const vector<RowValue>& D);
+
 /** Given the total Hamming weight of a state before and after λ, this
   * function computes a lower bound on the total weight
   * before and after λ, i.e., the minimum reverse weight before λ
@@ -97,6 +151,8 @@ public:
       *  @return    The lower bound on the total Hamming weight.
       */
     unsigned int getLowerBoundTotalHammingWeight(const KeccakFPropagation& DCorLC) const;
+    /** The same as getLowerBoundTotalHammingWeight(const KeccakFPropagation&), with the tables of the propagation context. */
+    unsigned int getLowerBoundTotalHammingWeight(const ParityBoundsTables& tables) const;
     /** This method returns a lower bound
       * on the total number of active rows before and after λ
       * for any state having this parity.
@@ -106,11 +162,15 @@ public:
       *  @return    The lower bound on the total number of active rows.
       */
     unsigned int getLowerBoundTotalActiveRows(const KeccakFPropagation& DCorLC) const;
+    /** The same as getLowerBoundTotalActiveRows(const KeccakFPropagation&), with the tables of the propagation context. */
+    unsigned int getLowerBoundTotalActiveRows(const ParityBoundsTables& tables) const;
     /** This method is like getLowerBoundTotalActiveRows(),
       * except that the bound does not take into account the contribution
       * of unaffected odd columns.
       */
     unsigned int getLowerBoundTotalActiveRowsUsingOnlyAC(const KeccakFPropagation& DCorLC) const;
+    /** The same as getLowerBoundTotalActiveRowsUsingOnlyAC(const KeccakFPropagation&), with the tables of the propagation context. */
+    unsigned int getLowerBoundTotalActiveRowsUsingOnlyAC(const ParityBoundsTables& tables) const;
 };
 
 /** This function looks for all parities (up to translation in z) such that
@@ -122,6 +182,7 @@ public:
   * by 2 times the total number of active rows.
   * The search is done as explained in the paper "Differential propagation of Keccak"
   * at Fast Software Encryption 2012.
+  * The bounds are computed with a ParityBoundsTables object.
   * @param   DCorLC The propagation context ,
   *                 as a reference to a KeccakFPropagation object.
   * @param  out The output file where to store the found parities.
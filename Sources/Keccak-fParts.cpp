@@ -47,6 +47,14 @@ unsigned int getNrActiveRows(const vector<SliceValue>& slices)
     return a;
 }
 
+unsigned int getNrActiveRows(const FixedStateAsSlices& slices)
+{
+    unsigned int a = 0;
+    for(unsigned int i=0; i<slices.size(); i++)
+        a += getNrActiveRows(slices[i]);
+    return a;
+}
+
 unsigned int getNrActiveRows(const vector<LaneValue>& lanes)
 {
     unsigned int result = 0;
@@ -133,6 +141,14 @@ unsigned int getHammingWeight(const vector<SliceValue>& state)
     return result;
 }
 
+unsigned int getHammingWeight(const FixedStateAsSlices& state)
+{
+    unsigned int result = 0;
+    for(unsigned int z=0; z<state.size(); z++)
+        result += getHammingWeightSlice(state[z]);
+    return result;
+}
+
 unsigned int getHammingWeightLane(LaneValue lane)
 {
     return HammingWeightTable[lane & 0xFF]
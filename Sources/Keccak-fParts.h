@@ -358,6 +358,89 @@ void fromLanesToSlices(const vector<LaneValue>& lanes, vector<SliceValue>& slice
   */
 void fromSlicesToLanes(const vector<SliceValue>& slices, vector<LaneValue>& lanes);
 
+/** The FixedStateAsSlices type codes a state as an array of laneSize slices
+  * stored inside the object, with a capacity of maxLaneSize slices.
+  * Unlike vector<SliceValue>, creating or copying such a state involves
+  * no memory allocation, so it is meant for the temporary states in the inner loops
+  * of the searches. It follows the interface of vector<SliceValue> for the operations
+  * used on states, and the array is aligned so that the loops over the slices can be vectorized.
+  */
+class alignas(32) FixedStateAsSlices {
+public:
+    /** The maximum number of slices, i.e., the lane size of Keccak-f[1600]. */
+    enum { maxLaneSize = 64 };
+protected:
+    /** The slices, of which the first laneSize are meaningful. */
+    SliceValue slices[maxLaneSize];
+    /** The number of slices. */
+    unsigned int laneSize;
+public:
+    /** This constructor initializes an empty state. */
+    FixedStateAsSlices() : laneSize(0) {}
+    /** This constructor initializes a state with @a aLaneSize slices of the given value. */
+    explicit FixedStateAsSlices(unsigned int aLaneSize, SliceValue value = 0) { assign(aLaneSize, value); }
+    /** This constructor initializes a state from a vector of slices. */
+    explicit FixedStateAsSlices(const vector<SliceValue>& state) { assign(state); }
+    /** This method sets the state to @a aLaneSize slices of the given value. */
+    inline void assign(unsigned int aLaneSize, SliceValue value)
+    {
+        setSize(aLaneSize);
+        for(unsigned int z=0; z<laneSize; z++)
+            slices[z] = value;
+    }
+    /** This method sets the state to the value of a vector of slices. */
+    inline void assign(const vector<SliceValue>& state)
+    {
+        setSize((unsigned int)state.size());
+        for(unsigned int z=0; z<laneSize; z++)
+            slices[z] = state[z];
+    }
+    /** This method changes the number of slices, the new slices being set to zero. */
+    inline void resize(unsigned int aLaneSize)
+    {
+        unsigned int previousLaneSize = laneSize;
+        setSize(aLaneSize);
+        for(unsigned int z=previousLaneSize; z<laneSize; z++)
+            slices[z] = 0;
+    }
+    /** This method copies the state into a vector of slices. */
+    inline void toVector(vector<SliceValue>& state) const { state.assign(slices, slices + laneSize); }
+    /** This method returns the number of slices. */
+    inline unsigned int size() const { return laneSize; }
+    /** This method tells whether the state has no slices. */
+    inline bool empty() const { return laneSize == 0; }
+    /** This method returns the value of a given slice as a constant reference. */
+    inline const SliceValue& operator[](unsigned int z) const { return slices[z]; }
+    /** This method returns the value of a given slice as a non-constant reference. */
+    inline SliceValue& operator[](unsigned int z) { return slices[z]; }
+    /** This method returns a pointer to the first slice. */
+    inline const SliceValue *data() const { return slices; }
+    /** This method returns a pointer to the first slice. */
+    inline SliceValue *data() { return slices; }
+    /** These methods return pointers to the first slice and past the last slice. */
+    inline const SliceValue *begin() const { return slices; }
+    inline const SliceValue *end() const { return slices + laneSize; }
+    inline SliceValue *begin() { return slices; }
+    inline SliceValue *end() { return slices + laneSize; }
+    bool operator==(const FixedStateAsSlices& other) const
+    {
+        if (laneSize != other.laneSize)
+            return false;
+        for(unsigned int z=0; z<laneSize; z++)
+            if (slices[z] != other.slices[z])
+                return false;
+        return true;
+    }
+    bool operator!=(const FixedStateAsSlices& other) const { return !(*this == other); }
+protected:
+    inline void setSize(unsigned int aLaneSize)
+    {
+        if (aLaneSize > maxLaneSize)
+            throw KeccakException("FixedStateAsSlices holds at most 64 slices.");
+        laneSize = aLaneSize;
+    }
+};
+
 
 // -------------------------------------------------------------
 //
@@ -381,6 +464,10 @@ unsigned int getHammingWeightSlice(SliceValue slice);
   */
 unsigned int getHammingWeight(const vector<SliceValue>& state);
 
+/** This function returns the Hamming weight of the given state.
+  */
+unsigned int getHammingWeight(const FixedStateAsSlices& state);
+
 /** This function returns the Hamming weight of the given lane.
   */
 unsigned int getHammingWeightLane(LaneValue lane);
@@ -397,6 +484,10 @@ unsigned int getNrActiveRows(const SliceValue& slice);
   */
 unsigned int getNrActiveRows(const vector<SliceValue>& slices);
 
+/** This method returns the number of active rows in the state given as slices.
+  */
+unsigned int getNrActiveRows(const FixedStateAsSlices& slices);
+
 /** This method returns the number of active rows in the state given as lanes.
   */
 unsigned int getNrActiveRows(const vector<LaneValue>& lanes);
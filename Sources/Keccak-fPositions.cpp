@@ -86,6 +86,11 @@ void BitPosition::zTranslate(int dz, unsigned int aLaneSize)
     z = ((((int)z+dz)%aLaneSize)+aLaneSize)%aLaneSize;
 }
 
+ostream& operator<<(ostream& fout, const PackedBitPosition& point)
+{
+    return fout << point.getBitPosition();
+}
+
 bool operator<(const ColumnPosition& aCP, const ColumnPosition& bCP)
 {
     return (aCP.getXplus5Z() < bCP.getXplus5Z());
@@ -17,6 +17,7 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #define _KECCAKFPOSITIONS_H_
 
 #include <iostream>
+#include "types.h"
 
 using namespace std;
 
@@ -82,6 +83,65 @@ public:
     void zTranslate(int dz, unsigned int aLaneSize);
 };
 
+/** Class containing the x, y, z coordinates of a bit packed in 16 bits,
+  * for the long lists of bit positions kept by the searches.
+  * The value is x·2<sup>9</sup> + y·2<sup>6</sup> + z, so that comparing two values
+  * gives the same order as BitPosition::operator<(),
+  * and that it can index tables of 2<sup>12</sup> entries,
+  * see KeccakFPropagation::directRhoPi(PackedBitPosition&).
+  */
+class PackedBitPosition {
+public:
+    /** The packed coordinates. */
+    UINT16 value;
+    /** The default constructor, for the position (0, 0, 0). */
+    PackedBitPosition() : value(0) {}
+    /** The constructor.
+      * @param  ax  The x-coordinate.
+      * @param  ay  The y-coordinate.
+      * @param  az  The z-coordinate, 0 ≤ z < 64.
+      */
+    PackedBitPosition(unsigned int ax, unsigned int ay, unsigned int az)
+        : value((UINT16)((ax << 9) | (ay << 6) | az)) {}
+    /** A constructor taking a bit position.
+      * @param  ap  The bit position.
+      */
+    explicit PackedBitPosition(const BitPosition& ap)
+        : value((UINT16)((ap.x << 9) | (ap.y << 6) | ap.z)) {}
+    /** @return The x-coordinate. */
+    inline unsigned int getX() const { return value >> 9; }
+    /** @return The y-coordinate. */
+    inline unsigned int getY() const { return (value >> 6) & 7; }
+    /** @return The z-coordinate. */
+    inline unsigned int getZ() const { return value & 63; }
+    /** @return The same position as a BitPosition object. */
+    inline BitPosition getBitPosition() const { return BitPosition(getX(), getY(), getZ()); }
+    /** The equality operator.
+      * @param  otherPoint  The bit position at the right of the operator.
+      * @return True iff this object equals @a otherPoint.
+      */
+    inline bool operator==(const PackedBitPosition& otherPoint) const { return value == otherPoint.value; }
+    /** An ordering operator, with the same order as BitPosition::operator<().
+      * @param  otherPoint  The bit position at the right of the operator.
+      * @return True iff this object comes before @a otherPoint.
+      */
+    inline bool operator<(const PackedBitPosition& otherPoint) const { return value < otherPoint.value; }
+    /** This method translates the position along the y axis.
+      * @param  dy  The amount of translation, 0 ≤ dy < 5.
+      */
+    inline void yTranslate(unsigned int dy)
+    {
+        unsigned int y = getY() + dy;
+        if (y >= 5) y -= 5;
+        value = (UINT16)((value & ~(7 << 6)) | (y << 6));
+    }
+    /** A display function, for use with the << operator, with the same format as for BitPosition.
+      * @param  fout    The output stream to write to.
+      * @param  point   The bit position to display.
+      */
+    friend ostream& operator<<(ostream& fout, const PackedBitPosition& point);
+};
+
 /** Class containing the x, z coordinates of a column. */
 class ColumnPosition
 {
@@ -14,9 +14,11 @@ http://creativecommons.org/publicdomain/zero/1.0/
 */
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <math.h>
+#include <unordered_map>
 #include "Keccak-fDCLC.h"
 #include "Keccak-fDisplay.h"
 #include "Keccak-fParity.h"
@@ -68,23 +70,62 @@ void KeccakFPropagation::directRhoPiAfterTheta(BitPosition& point) const
 }
 
 KeccakFPropagation::KeccakFPropagation(const KeccakFDCLC& aParent, KeccakFPropagation::DCorLC aDCorLC)
-    : directRowOutputListPerInput((aDCorLC == DC) ? aParent.diffChi : aParent.corrInvChi),
-    reverseRowOutputListPerInput((aDCorLC == DC) ? aParent.diffInvChi : aParent.corrChi),
+    : tables(make_shared<const KeccakFPropagationTables>(aParent, aDCorLC)),
+    directRowOutputListPerInput(tables->directRowOutputListPerInput),
+    reverseRowOutputListPerInput(tables->reverseRowOutputListPerInput),
+    directRowOutputTable(tables->directRowOutputTable),
+    reverseRowOutputTable(tables->reverseRowOutputTable),
+    affinePerInput(tables->affinePerInput),
     parent(aParent),
     laneSize(parent.getWidth()/25),
     name((aDCorLC == DC) ? "DC" : "LC"),
     lambdaMode((aDCorLC == DC) ? KeccakFDCLC::Straight : KeccakFDCLC::Transpose),
     reverseLambdaMode((aDCorLC == DC) ? KeccakFDCLC::Inverse : KeccakFDCLC::Dual)
 {
-    initializeAffine();
+    copySmallTables();
+}
+
+KeccakFPropagation::KeccakFPropagation(const KeccakFPropagation& other)
+    : tables(other.tables),
+    directRowOutputListPerInput(tables->directRowOutputListPerInput),
+    reverseRowOutputListPerInput(tables->reverseRowOutputListPerInput),
+    directRowOutputTable(tables->directRowOutputTable),
+    reverseRowOutputTable(tables->reverseRowOutputTable),
+    affinePerInput(tables->affinePerInput),
+    parent(other.parent),
+    laneSize(other.laneSize),
+    name(other.name),
+    lambdaMode(other.lambdaMode),
+    reverseLambdaMode(other.reverseLambdaMode)
+{
+    copySmallTables();
+}
+
+void KeccakFPropagation::copySmallTables()
+{
+    copy(tables->weightPerRow, tables->weightPerRow + 32, weightPerRow);
+    copy(tables->minReverseWeightPerRow, tables->minReverseWeightPerRow + 32, minReverseWeightPerRow);
+    copy(tables->chiCompatibilityTable, tables->chiCompatibilityTable + 32, chiCompatibilityTable);
+}
+
+KeccakFPropagationTables::KeccakFPropagationTables(const KeccakFDCLC& parent, KeccakFPropagation::DCorLC DCorLC)
+    : directRowOutputListPerInput((DCorLC == KeccakFPropagation::DC) ? parent.diffChi : parent.corrInvChi),
+    reverseRowOutputListPerInput((DCorLC == KeccakFPropagation::DC) ? parent.diffInvChi : parent.corrChi),
+    directRowOutputTable(directRowOutputListPerInput),
+    reverseRowOutputTable(reverseRowOutputListPerInput)
+{
+    static atomic<UINT64> nextIdentifier(0);
+    identifier = nextIdentifier++;
+    initializeAffine(parent, DCorLC);
     initializeWeight();
     initializeMinReverseWeight();
     initializeChiCompatibilityTable();
+    initializeRhoPiPerPackedPosition(parent, DCorLC);
 }
 
-void KeccakFPropagation::initializeAffine()
+void KeccakFPropagationTables::initializeAffine(const KeccakFDCLC& parent, KeccakFPropagation::DCorLC DCorLC)
 {
-    if (getPropagationType() == KeccakFPropagation::DC) {
+    if (DCorLC == KeccakFPropagation::DC) {
         for(RowValue row=0; row<(1<<nrRowsAndColumns); row++) {
             AffineSpaceOfRows a;
             if (row == ((1<<nrRowsAndColumns)-1)) {
@@ -163,24 +204,16 @@ void KeccakFPropagation::initializeAffine()
     }
 }
 
-void KeccakFPropagation::initializeWeight()
+void KeccakFPropagationTables::initializeWeight()
 {
-    for(SliceValue slice=0; slice<=maxSliceValue; slice++) {
-        unsigned int weightOfThisSlice = weightOfSlice(slice);
-        weightPerSlice.push_back(weightOfThisSlice);
-    }
+    for(RowValue row=0; row<32; row++)
+        weightPerRow[row] = (unsigned char)affinePerInput[row].getWeight();
 }
 
-void KeccakFPropagation::initializeMinReverseWeight()
+void KeccakFPropagationTables::initializeMinReverseWeight()
 {
-    for(SliceValue slice=0; slice<=maxSliceValue; slice++) {
-        unsigned int minReverseWeight = 0;
-        for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-            RowValue row = getRowFromSlice(slice, y);
-            minReverseWeight += reverseRowOutputListPerInput[row].minWeight;
-        }
-        minReverseWeightPerSlice.push_back(minReverseWeight);
-    }
+    for(RowValue row=0; row<32; row++)
+        minReverseWeightPerRow[row] = (unsigned char)reverseRowOutputTable.getMinWeight(row);
 }
 
 KeccakFPropagation::DCorLC KeccakFPropagation::getPropagationType() const
@@ -193,35 +226,53 @@ KeccakFPropagation::DCorLC KeccakFPropagation::getPropagationType() const
         throw KeccakException("The lambda mode does not match either DC or LC propagation.");
 }
 
-unsigned int KeccakFPropagation::weightOfSlice(SliceValue slice) const
+unsigned int KeccakFPropagation::getWeight(const vector<SliceValue>& state) const
 {
+    // Most slices are passive in the states of interest, so they are skipped.
     unsigned int weight = 0;
-    for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-        RowValue row = getRowFromSlice(slice, y);
-        weight += affinePerInput[row].getWeight();
-    }
+    for(unsigned int i=0; i<state.size(); i++)
+        if (state[i] != 0)
+            weight += getWeight(state[i]);
     return weight;
 }
 
-unsigned int KeccakFPropagation::getWeight(const vector<SliceValue>& state) const
+unsigned int KeccakFPropagation::getMinReverseWeight(const vector<SliceValue>& state) const
 {
     unsigned int weight = 0;
     for(unsigned int i=0; i<state.size(); i++)
-        weight += getWeight(state[i]);
+        if (state[i] != 0)
+            weight += getMinReverseWeight(state[i]);
     return weight;
 }
 
-unsigned int KeccakFPropagation::getMinReverseWeight(const vector<SliceValue>& state) const
+unsigned int KeccakFPropagation::getWeight(const FixedStateAsSlices& state) const
+{
+    unsigned int weight = 0;
+    for(unsigned int i=0; i<state.size(); i++)
+        if (state[i] != 0)
+            weight += getWeight(state[i]);
+    return weight;
+}
+
+unsigned int KeccakFPropagation::getMinReverseWeight(const FixedStateAsSlices& state) const
 {
     unsigned int weight = 0;
     for(unsigned int i=0; i<state.size(); i++)
-        weight += getMinReverseWeight(state[i]);
+        if (state[i] != 0)
+            weight += getMinReverseWeight(state[i]);
     return weight;
 }
 
 unsigned int KeccakFPropagation::getMinReverseWeightAfterLambda(const vector<SliceValue>& state) const
 {
-    vector<SliceValue> stateBeforeLambda;
+    FixedStateAsSlices stateBeforeLambda;
+    parent.lambda(FixedStateAsSlices(state), stateBeforeLambda, reverseLambdaMode);
+    return getMinReverseWeight(stateBeforeLambda);
+}
+
+unsigned int KeccakFPropagation::getMinReverseWeightAfterLambda(const FixedStateAsSlices& state) const
+{
+    FixedStateAsSlices stateBeforeLambda;
     reverseLambda(state, stateBeforeLambda);
     return getMinReverseWeight(stateBeforeLambda);
 }
@@ -295,40 +346,100 @@ AffineSpaceOfSlices KeccakFPropagation::buildSliceBase(SliceValue slice) const
     return a;
 }
 
+/** The maximum number of slice values kept by the cache of buildStateBase(). */
+static const size_t maxNrCachedSliceBases = 1 << 16;
+
+/** The generators of the propagation of a slice value through χ and λ,
+  * for the slice value at z=0.
+  */
+struct SliceBaseAfterLambda {
+    /** The offset of the output of χ. */
+    SliceValue offset;
+    /** The generators after λ. */
+    vector<vector<SliceValue> > generators;
+    /** The parities of the generators before θ. */
+    vector<vector<RowValue> > parities;
+};
+
+/** The cache of buildStateBase() for one thread,
+  * valid for the tables and λ mode it was filled with.
+  */
+struct SliceBaseCache {
+    UINT64 tablesIdentifier;
+    KeccakFDCLC::LambdaMode lambdaMode;
+    unordered_map<SliceValue, SliceBaseAfterLambda> bases;
+    SliceBaseCache() : tablesIdentifier(~(UINT64)0), lambdaMode(KeccakFDCLC::Straight) {}
+};
+
+template<class T>
+static void translateAlongZ(const vector<T>& in, unsigned int dz, vector<T>& out)
+{
+    out.resize(in.size());
+    for(unsigned int z=0; z<in.size(); z++)
+        out[(z+dz)%in.size()] = in[z];
+}
+
 AffineSpaceOfStates KeccakFPropagation::buildStateBase(const vector<SliceValue>& state, bool packedIfPossible) const
 {
     static const bool debug = false;
+    static thread_local SliceBaseCache cache;
     bool packed = packedIfPossible && ((laneSize*nrRowsAndColumns) <= (sizeof(PackedParity)*8));
 
+    if ((cache.tablesIdentifier != tables->identifier) || (cache.lambdaMode != lambdaMode)) {
+        cache.bases.clear();
+        cache.tablesIdentifier = tables->identifier;
+        cache.lambdaMode = lambdaMode;
+    }
+
     vector<vector<SliceValue> > genValues;   // to store the generator values while processing
     vector<PackedParity> genParitiesPacked;
     vector<vector<RowValue> > genParities;
     vector<SliceValue> offset(laneSize, 0);
     for(unsigned int z=0; z<laneSize; z++) {
-        vector<SliceValue> v(laneSize, 0);
-        for(unsigned int y=0; y<nrRowsAndColumns; y++) {
-            RowValue row = getRowFromSlice(state[z], y);
-            offset[z] ^= getSliceFromRow(affinePerInput[row].offset, y);
-            for(unsigned int i=0; i<affinePerInput[row].generators.size(); i++) {
-                RowValue b = affinePerInput[row].generators[i];
-                v[z] = getSliceFromRow(b, y);
-                vector<SliceValue> stateAfterLambda;
-                parent.lambda(v, stateAfterLambda, lambdaMode);
-                genValues.push_back(stateAfterLambda);
-                vector<SliceValue> stateBeforeTheta;
-                parent.lambdaBeforeTheta(v, stateBeforeTheta, lambdaMode);
-                if (packed)
-                    genParitiesPacked.push_back(getParity(stateBeforeTheta));
-                else {
+        if (state[z] == 0)
+            continue;
+        unordered_map<SliceValue, SliceBaseAfterLambda>::const_iterator cached = cache.bases.find(state[z]);
+        if (cached == cache.bases.end()) {
+            if (cache.bases.size() >= maxNrCachedSliceBases)
+                cache.bases.clear();
+            SliceBaseAfterLambda base;
+            base.offset = 0;
+            vector<SliceValue> v(laneSize, 0);
+            for(unsigned int y=0; y<nrRowsAndColumns; y++) {
+                RowValue row = getRowFromSlice(state[z], y);
+                base.offset ^= getSliceFromRow(affinePerInput[row].offset, y);
+                for(unsigned int i=0; i<affinePerInput[row].generators.size(); i++) {
+                    RowValue b = affinePerInput[row].generators[i];
+                    v[0] = getSliceFromRow(b, y);
+                    vector<SliceValue> stateAfterLambda;
+                    parent.lambda(v, stateAfterLambda, lambdaMode);
+                    base.generators.push_back(stateAfterLambda);
+                    vector<SliceValue> stateBeforeTheta;
+                    parent.lambdaBeforeTheta(v, stateBeforeTheta, lambdaMode);
                     vector<RowValue> parities;
                     getParity(stateBeforeTheta, parities);
-                    genParities.push_back(parities);
-                }
-                if (debug) {
-                    cout << "Generator: " << endl;
-                    displayStates(cout, v, false, stateBeforeTheta, true, stateAfterLambda, false);
+                    base.parities.push_back(parities);
                 }
             }
+            cached = cache.bases.insert(make_pair(state[z], base)).first;
+        }
+        offset[z] = cached->second.offset;
+        for(unsigned int i=0; i<cached->second.generators.size(); i++) {
+            genValues.push_back(vector<SliceValue>());
+            translateAlongZ(cached->second.generators[i], z, genValues.back());
+            if (packed) {
+                vector<RowValue> parities;
+                translateAlongZ(cached->second.parities[i], z, parities);
+                genParitiesPacked.push_back(packParity(parities));
+            }
+            else {
+                genParities.push_back(vector<RowValue>());
+                translateAlongZ(cached->second.parities[i], z, genParities.back());
+            }
+            if (debug) {
+                cout << "Generator: " << endl;
+                displayState(cout, genValues.back());
+            }
         }
     }
     vector<SliceValue> offsetAfterLambda;
@@ -362,21 +473,41 @@ void KeccakFPropagation::directLambda(const vector<SliceValue>& in, vector<Slice
     parent.lambda(in, out, lambdaMode);
 }
 
+void KeccakFPropagation::directLambda(const FixedStateAsSlices& in, FixedStateAsSlices& out) const
+{
+    parent.lambda(in, out, lambdaMode);
+}
+
 void KeccakFPropagation::reverseLambda(const vector<SliceValue>& in, vector<SliceValue>& out) const
 {
     parent.lambda(in, out, reverseLambdaMode);
 }
 
+void KeccakFPropagation::reverseLambda(const FixedStateAsSlices& in, FixedStateAsSlices& out) const
+{
+    parent.lambda(in, out, reverseLambdaMode);
+}
+
 void KeccakFPropagation::directLambdaBeforeTheta(const vector<SliceValue>& in, vector<SliceValue>& out) const
 {
     parent.lambdaBeforeTheta(in, out, lambdaMode);
 }
 
+void KeccakFPropagation::directLambdaBeforeTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out) const
+{
+    parent.lambdaBeforeTheta(in, out, lambdaMode);
+}
+
 void KeccakFPropagation::reverseLambdaBeforeTheta(const vector<SliceValue>& in, vector<SliceValue>& out) const
 {
     parent.lambdaAfterTheta(in, out, reverseLambdaMode);
 }
 
+void KeccakFPropagation::reverseLambdaBeforeTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out) const
+{
+    parent.lambdaAfterTheta(in, out, reverseLambdaMode);
+}
+
 void KeccakFPropagation::directTheta(const vector<SliceValue>& in, vector<SliceValue>& out) const
 {
     vector<LaneValue> lanes;
@@ -424,11 +555,21 @@ void KeccakFPropagation::directLambdaAfterTheta(const vector<SliceValue>& in, ve
     parent.lambdaAfterTheta(in, out, lambdaMode);
 }
 
+void KeccakFPropagation::directLambdaAfterTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out) const
+{
+    parent.lambdaAfterTheta(in, out, lambdaMode);
+}
+
 void KeccakFPropagation::reverseLambdaAfterTheta(const vector<SliceValue>& in, vector<SliceValue>& out) const
 {
     parent.lambdaBeforeTheta(in, out, reverseLambdaMode);
 }
 
+void KeccakFPropagation::reverseLambdaAfterTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out) const
+{
+    parent.lambdaBeforeTheta(in, out, reverseLambdaMode);
+}
+
 void KeccakFPropagation::directThetaEffectFromParities(const vector<LaneValue>& C, vector<LaneValue>& D) const
 {
     if (getPropagationType() == KeccakFPropagation::DC)
@@ -560,30 +701,68 @@ UINT64 KeccakFPropagation::displayTrailsAndCheck(const string& fileNameIn, ostre
     return totalCount;
 }
 
-void KeccakFPropagation::initializeChiCompatibilityTable()
+void KeccakFPropagationTables::initializeChiCompatibilityTable()
+{
+    for(RowValue a=0; a<32; a++) {
+        chiCompatibilityTable[a] = 0;
+        const RowValue *values = directRowOutputTable.getValues(a);
+        for(unsigned int i=0; i<directRowOutputTable.size(a); i++)
+            chiCompatibilityTable[a] |= (UINT32)1 << values[i];
+    }
+}
+
+void KeccakFPropagationTables::initializeRhoPiPerPackedPosition(const KeccakFDCLC& parent, KeccakFPropagation::DCorLC DCorLC)
 {
-    chiCompatibilityTable.assign(32*32, false);
-    for(RowValue a=0; a<32; a++) for(RowValue b=0; b<32; b++) {
-        const vector<RowValue>& values = directRowOutputListPerInput[a].values;
-        chiCompatibilityTable[a+32*b] =
-            find(values.begin(), values.end(), b) != values.end();
+    // The positions that do not exist are mapped to (0, 0, 0).
+    directRhoPiPerPackedPosition.assign(1 << 12, PackedBitPosition());
+    reverseRhoPiPerPackedPosition.assign(1 << 12, PackedBitPosition());
+    unsigned int laneSize = parent.getWidth()/25;
+    for(unsigned int x=0; x<5; x++)
+    for(unsigned int y=0; y<5; y++)
+    for(unsigned int z=0; z<laneSize; z++) {
+        PackedBitPosition p(x, y, z);
+        BitPosition rhoPi(x, y, z), inverseRhoPi(x, y, z);
+        rhoPi.z = parent.rho(rhoPi.x, rhoPi.y, rhoPi.z);
+        parent.pi(rhoPi.x, rhoPi.y, rhoPi.x, rhoPi.y);
+        parent.inversePi(inverseRhoPi.x, inverseRhoPi.y, inverseRhoPi.x, inverseRhoPi.y);
+        inverseRhoPi.z = parent.inverseRho(inverseRhoPi.x, inverseRhoPi.y, inverseRhoPi.z);
+        // as in KeccakFPropagation::directRhoPi() and reverseRhoPi()
+        directRhoPiPerPackedPosition[p.value] = PackedBitPosition((DCorLC == KeccakFPropagation::DC) ? rhoPi : inverseRhoPi);
+        reverseRhoPiPerPackedPosition[p.value] = PackedBitPosition((DCorLC == KeccakFPropagation::DC) ? inverseRhoPi : rhoPi);
     }
 }
 
 bool KeccakFPropagation::isChiCompatible(const vector<SliceValue>& beforeChi, const vector<SliceValue>& afterChi) const
 {
-    for(unsigned int z=0; z<laneSize; z++)
-    for(unsigned int y=0; y<nrRowsAndColumns; y++)
-        if (!isChiCompatible(getRowFromSlice(beforeChi[z], y), getRowFromSlice(afterChi[z], y)))
+    return isChiCompatible(beforeChi.data(), afterChi.data());
+}
+
+bool KeccakFPropagation::isChiCompatible(const FixedStateAsSlices& beforeChi, const FixedStateAsSlices& afterChi) const
+{
+    return isChiCompatible(beforeChi.data(), afterChi.data());
+}
+
+bool KeccakFPropagation::isChiCompatible(const SliceValue *beforeChi, const SliceValue *afterChi) const
+{
+    for(unsigned int z=0; z<laneSize; z++) {
+        SliceValue before = beforeChi[z], after = afterChi[z];
+        if ((before | after) == 0)
+            continue;
+        if (((chiCompatibilityTable[before & 0x1F] >> (after & 0x1F))
+                & (chiCompatibilityTable[(before >> 5) & 0x1F] >> ((after >> 5) & 0x1F))
+                & (chiCompatibilityTable[(before >> 10) & 0x1F] >> ((after >> 10) & 0x1F))
+                & (chiCompatibilityTable[(before >> 15) & 0x1F] >> ((after >> 15) & 0x1F))
+                & (chiCompatibilityTable[(before >> 20) & 0x1F] >> ((after >> 20) & 0x1F)) & 1) == 0)
             return false;
+    }
     return true;
 }
 
 bool KeccakFPropagation::isRoundCompatible(const Trail& first, const Trail& second) const
 {
-    vector<SliceValue> stateAfterChi;
-    reverseLambda(second.states[0], stateAfterChi);
-    return isChiCompatible(first.states.back(), stateAfterChi);
+    FixedStateAsSlices stateAfterChi;
+    reverseLambda(FixedStateAsSlices(second.states[0]), stateAfterChi);
+    return isChiCompatible(first.states.back().data(), stateAfterChi.data());
 }
 
 string KeccakFPropagation::buildFileName(const string& suffix) const
@@ -716,7 +895,7 @@ void KeccakFPropagation::specifyFirstStateArbitrarily(Trail& trail) const
             SliceValue newSlice = 0;
             for(unsigned int y=0; y<nrRowsAndColumns; y++) {
                 RowValue rowAfterChi = getRowFromSlice(stateBeforeLambda[z], y);
-                RowValue rowBeforeChi = reverseRowOutputListPerInput[rowAfterChi].values[0];
+                RowValue rowBeforeChi = reverseRowOutputTable.getFirstValue(rowAfterChi);
                 newSlice ^= getSliceFromRow(rowBeforeChi, y);
             }
             trail.states[0].push_back(newSlice);
@@ -736,7 +915,7 @@ void KeccakFPropagation::specifyStateAfterLastChiArbitrarily(Trail& trail) const
             SliceValue newSlice = 0;
             for(unsigned int y=0; y<nrRowsAndColumns; y++) {
                 RowValue rowBeforeChi = getRowFromSlice(stateBeforeChi[z], y);
-                RowValue rowAfterChi = directRowOutputListPerInput[rowBeforeChi].values[0];
+                RowValue rowAfterChi = directRowOutputTable.getFirstValue(rowBeforeChi);
                 newSlice ^= getSliceFromRow(rowAfterChi, y);
             }
             trail.stateAfterLastChi.push_back(newSlice);
@@ -751,6 +930,11 @@ ReverseStateIterator KeccakFPropagation::getReverseStateIterator(const vector<Sl
     return ReverseStateIterator(stateAfterChi, *this, maxWeight);
 }
 
+WeightOrderedReverseStateIterator KeccakFPropagation::getWeightOrderedReverseStateIterator(const vector<SliceValue>& stateAfterChi, unsigned int maxWeight) const
+{
+    return WeightOrderedReverseStateIterator(stateAfterChi, *this, maxWeight);
+}
+
 ReverseStateIterator::ReverseStateIterator(const vector<SliceValue>& stateAfterChi, const KeccakFPropagation& DCorLC)
     : maxWeight((nrRowsAndColumns-1)*nrRowsAndColumns*stateAfterChi.size())
 {
@@ -773,16 +957,18 @@ void ReverseStateIterator::initialize(const vector<SliceValue>& stateAfterChi, c
     for(unsigned int y=0; y<nrRowsAndColumns; y++) {
         RowValue row = getRow(stateAfterChi, y, z);
         if (row != 0) {
-            patterns.push_back(DCorLC.reverseRowOutputListPerInput[row]);
+            patterns.push_back(DCorLC.reverseRowOutputTable.getRange(row));
             Ys.push_back(y);
             Zs.push_back(z);
             indexes.push_back(0);
-            setRow(current, DCorLC.reverseRowOutputListPerInput[row].values[0], y, z);
-            minWeight += DCorLC.reverseRowOutputListPerInput[row].weights[0];
+            setRow(current, patterns.back().values[0], y, z);
+            minWeight += patterns.back().weights[0];
             size++;
         }
     }
     currentWeight = minWeight;
+    freeBegin = 0;
+    freeEnd = size;
     end = isEmpty();
 }
 
@@ -815,27 +1001,144 @@ unsigned int ReverseStateIterator::getCurrentWeight() const
 void ReverseStateIterator::next()
 {
     int affordableWeight = maxWeight - currentWeight;
-    unsigned int i = 0;
-    while(i < size) {
+    unsigned int i = freeBegin;
+    while(i < freeEnd) {
         unsigned int ii = indexes[i];
         affordableWeight += patterns[i].weights[ii];
         currentWeight -= patterns[i].weights[ii];
-        if (ii < (patterns[i].values.size()-1))
+        if (ii < (patterns[i].size-1))
             if ((int)patterns[i].weights[ii+1] <= affordableWeight)
                 break;
         affordableWeight -= patterns[i].minWeight;
         i++;
     }
-    if (i >= size) {
+    if (i >= freeEnd) {
         end = true;
         return;
     }
     indexes[i]++;
     currentWeight += patterns[i].weights[indexes[i]];
     setRow(current, patterns[i].values[indexes[i]], Ys[i], Zs[i]);
-    for(unsigned int j=0; j<i; j++) {
+    for(unsigned int j=freeBegin; j<i; j++) {
         indexes[j] = 0;
         currentWeight += patterns[j].weights[0];
         setRow(current, patterns[j].values[0], Ys[j], Zs[j]);
     }
 }
+
+void ReverseStateIterator::resetRows(unsigned int from, unsigned int to)
+{
+    for(unsigned int j=from; j<to; j++) {
+        currentWeight -= patterns[j].weights[indexes[j]];
+        indexes[j] = 0;
+        currentWeight += patterns[j].weights[0];
+        setRow(current, patterns[j].values[0], Ys[j], Zs[j]);
+    }
+}
+
+bool ReverseStateIterator::split(unsigned int depth, vector<ReverseStateIterator>& parts)
+{
+    if (end || (freeBegin == freeEnd))
+        return false;
+    unsigned int middle = freeEnd - min(depth, freeEnd - freeBegin);
+    // This iterator runs through the prefixes after the current one,
+    // with the other rows set to their first choice.
+    ReverseStateIterator prefixes(*this);
+    prefixes.resetRows(freeBegin, middle);
+    prefixes.freeBegin = middle;
+    for(prefixes.next(); !prefixes.end; prefixes.next()) {
+        parts.push_back(prefixes);
+        parts.back().freeBegin = freeBegin;
+        parts.back().freeEnd = middle;
+        parts.back().index = 0;
+    }
+    freeEnd = middle;
+    return true;
+}
+
+WeightOrderedReverseStateIterator::WeightOrderedReverseStateIterator(const vector<SliceValue>& stateAfterChi, const KeccakFPropagation& DCorLC, unsigned int aMaxWeight)
+    : maxWeight(aMaxWeight), nrQueued(0)
+{
+    current.assign(stateAfterChi.size(), 0);
+    Candidate first;
+    first.weight = 0;
+    first.rank = nrQueued++;
+    first.firstFreeRow = 0;
+    for(unsigned int z=0; z<stateAfterChi.size(); z++)
+    for(unsigned int y=0; y<nrRowsAndColumns; y++) {
+        RowValue row = getRow(stateAfterChi, y, z);
+        if (row != 0) {
+            patterns.push_back(DCorLC.reverseRowOutputTable.getRange(row));
+            Ys.push_back(y);
+            Zs.push_back(z);
+            first.indexes.push_back(0);
+            first.weight += patterns.back().weights[0];
+        }
+    }
+    empty = patterns.empty() || (first.weight > maxWeight);
+    if (!empty)
+        candidates.push(first);
+    end = true;
+    next();
+}
+
+bool WeightOrderedReverseStateIterator::isEnd() const
+{
+    return end;
+}
+
+bool WeightOrderedReverseStateIterator::isEmpty() const
+{
+    return empty;
+}
+
+void WeightOrderedReverseStateIterator::operator++()
+{
+    next();
+}
+
+const vector<SliceValue>& WeightOrderedReverseStateIterator::operator*() const
+{
+    return current;
+}
+
+unsigned int WeightOrderedReverseStateIterator::getCurrentWeight() const
+{
+    return currentCandidate.weight;
+}
+
+void WeightOrderedReverseStateIterator::next()
+{
+    if (candidates.empty()) {
+        end = true;
+        return;
+    }
+    currentCandidate = candidates.top();
+    candidates.pop();
+    end = false;
+    for(unsigned int i=0; i<patterns.size(); i++)
+        setRow(current, patterns[i].values[currentCandidate.indexes[i]], Ys[i], Zs[i]);
+    queueSuccessors();
+}
+
+void WeightOrderedReverseStateIterator::queueSuccessors()
+{
+    // Each combination is reached once, by increasing the choices row by row
+    // in the order of the rows. As the choices are sorted by weight,
+    // the successors are never lighter than the current combination.
+    for(unsigned int i=currentCandidate.firstFreeRow; i<patterns.size(); i++) {
+        unsigned int ii = currentCandidate.indexes[i];
+        if (ii+1 < patterns[i].size) {
+            unsigned int weight = currentCandidate.weight - patterns[i].weights[ii] + patterns[i].weights[ii+1];
+            if (weight <= maxWeight) {
+                Candidate successor;
+                successor.weight = weight;
+                successor.rank = nrQueued++;
+                successor.firstFreeRow = i;
+                successor.indexes = currentCandidate.indexes;
+                successor.indexes[i]++;
+                candidates.push(successor);
+            }
+        }
+    }
+}
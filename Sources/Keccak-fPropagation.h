@@ -16,6 +16,8 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #ifndef _KECCAKFPROPAGATION_H_
 #define _KECCAKFPROPAGATION_H_
 
+#include <memory>
+#include <queue>
 #include <string>
 #include "Keccak-fAffineBases.h"
 #include "Keccak-fDCLC.h"
@@ -23,6 +25,8 @@ http://creativecommons.org/publicdomain/zero/1.0/
 using namespace std;
 
 class ReverseStateIterator;
+class WeightOrderedReverseStateIterator;
+class KeccakFPropagationTables;
 
 /** This class provides the necessary tools to compute the propagation of
   * either differences or linear patterns through the rounds of Keccak-<i>f</i>.
@@ -35,23 +39,41 @@ class ReverseStateIterator;
   *   (hence same direction as the inverse rounds for DC, rounds for LC).
   *
   * In this context, the words "before" and "after" refer to the "direct" direction.
+  *
+  * An instance is not modified after its construction, so it can be used
+  * by several threads at the same time. Its tables are kept in a
+  * KeccakFPropagationTables object that the copies of the instance share,
+  * including the KeccakFPropagation part of the search classes constructed from it.
+  * So, a parallel search builds the tables once, and each thread works
+  * on its own search object, which keeps the state of its search.
   */
 class KeccakFPropagation {
+protected:
+    /** The tables, shared by the copies of this instance. */
+    shared_ptr<const KeccakFPropagationTables> tables;
 public:
     /** The output row patterns:
       * - for DC, same as KeccakFDCLC::diffChi;
       * - for LC, same as KeccakFDCLC::corrInvChi.
       */
-    vector<ListOfRowPatterns> directRowOutputListPerInput;
+    const vector<ListOfRowPatterns>& directRowOutputListPerInput;
     /** The output row patterns in the reverse direction:
       * - for DC, same as KeccakFDCLC::diffInvChi;
       * - for LC, same as KeccakFDCLC::corrChi.
       */
-    vector<ListOfRowPatterns> reverseRowOutputListPerInput;
+    const vector<ListOfRowPatterns>& reverseRowOutputListPerInput;
+    /** The same as directRowOutputListPerInput, in one contiguous table
+      * to enumerate the output patterns efficiently.
+      */
+    const RowPatternTable& directRowOutputTable;
+    /** The same as reverseRowOutputListPerInput, in one contiguous table
+      * to enumerate the output patterns efficiently.
+      */
+    const RowPatternTable& reverseRowOutputTable;
     /** This attribute contains the same as directRowOutputListPerInput
       * but in the form of an affine space representation.
       */
-    vector<AffineSpaceOfRows> affinePerInput;
+    const vector<AffineSpaceOfRows>& affinePerInput;
     /** This is a link to the 'parent' KeccakFDCLC class.
       */
     const KeccakFDCLC& parent;
@@ -71,17 +93,19 @@ protected:
       */
     KeccakFDCLC::LambdaMode reverseLambdaMode;
 private:
-    /** This attribute contains the propagation weight of every possible slice value.
+    /** This attribute contains the propagation weight of every possible row value.
+      * The weight of a slice is the sum of the weights of its five rows.
+      * This and the two tables below are copied from @a tables to avoid an indirection.
       */
-    vector<unsigned char> weightPerSlice;
-    /** This attribute contains the minimum reverse weight of every possible slice value.
+    unsigned char weightPerRow[32];
+    /** This attribute contains the minimum reverse weight of every possible row value.
       */
-    vector<unsigned char> minReverseWeightPerSlice;
-    /** This vector tells whether a pattern x at the input of χ is compatible
-      * with output y. This can be found in chiCompatibilityTable[x+32*y].
+    unsigned char minReverseWeightPerRow[32];
+    /** This attribute tells whether a pattern x at the input of χ is compatible
+      * with output y, as the bit y of chiCompatibilityTable[x].
       * See also isChiCompatible().
       */
-    vector<bool> chiCompatibilityTable;
+    UINT32 chiCompatibilityTable[32];
 public:
     /** This type allows one to specify the type of propagation: differential (DC) or linear (LC). */
     enum DCorLC { DC = 0, LC };
@@ -92,6 +116,12 @@ public:
       * @param   aDCorLC    The propagation type.
       */
     KeccakFPropagation(const KeccakFDCLC& aParent, KeccakFPropagation::DCorLC aDCorLC);
+    /** This constructor makes an instance equivalent to @a other, which shares its tables.
+      * @param   other  The instance to share the tables of.
+      */
+    KeccakFPropagation(const KeccakFPropagation& other);
+    /** This method returns the tables of the instance, which its copies share. */
+    const shared_ptr<const KeccakFPropagationTables>& getTables() const { return tables; }
     /** This method returns the propagation type (DC or LC) handled by the instance.
       * @return The propagation type as a DCorLC value.
       */
@@ -104,32 +134,50 @@ public:
       * @param   slice  The value of a slice.
       * @return The propagation weight of the given slice.
       */
-    inline unsigned int getWeight(const SliceValue& slice) const { return weightPerSlice[slice]; }
+    inline unsigned int getWeight(const SliceValue& slice) const
+    {
+        return weightPerRow[slice & 0x1F] + weightPerRow[(slice >> 5) & 0x1F] + weightPerRow[(slice >> 10) & 0x1F]
+            + weightPerRow[(slice >> 15) & 0x1F] + weightPerRow[(slice >> 20) & 0x1F];
+    }
     /** This method returns the propagation weight of a row.
       * @param   row    The value of a slice.
       * @return The propagation weight of the given row.
       */
-    inline unsigned int getWeightRow(const RowValue& row) const { return getWeight(getSliceFromRow(row, 0)); }
+    inline unsigned int getWeightRow(const RowValue& row) const { return weightPerRow[row]; }
     /** This method returns the propagation weight of a state.
       * @param   state  The value of a state given as a vector of slices.
       * @return The propagation weight of the given state.
       */
     unsigned int getWeight(const vector<SliceValue>& state) const;
+    /** This method returns the propagation weight of a state.
+      * @param   state  The value of a state given as a FixedStateAsSlices.
+      * @return The propagation weight of the given state.
+      */
+    unsigned int getWeight(const FixedStateAsSlices& state) const;
     /** This method returns the minimum reverse weight of a slice.
       * @param   slice  The value of a slice.
       * @return The minimum weight of the given slice.
       */
-    inline unsigned int getMinReverseWeight(const SliceValue& slice) const { return minReverseWeightPerSlice[slice]; }
+    inline unsigned int getMinReverseWeight(const SliceValue& slice) const
+    {
+        return minReverseWeightPerRow[slice & 0x1F] + minReverseWeightPerRow[(slice >> 5) & 0x1F] + minReverseWeightPerRow[(slice >> 10) & 0x1F]
+            + minReverseWeightPerRow[(slice >> 15) & 0x1F] + minReverseWeightPerRow[(slice >> 20) & 0x1F];
+    }
     /** This method returns the minimum reverse weight of a slice.
       * @param   slice  The value of a slice.
       * @return The minimum weight of the given slice.
       */
-    inline unsigned int getMinReverseWeightRow(const RowValue& row) const { return getMinReverseWeight(getSliceFromRow(row, 0)); }
+    inline unsigned int getMinReverseWeightRow(const RowValue& row) const { return minReverseWeightPerRow[row]; }
     /** This method returns the minimum reverse weight of a state.
       * @param   state  The value of a state given as a vector of slices.
       * @return The minimum reverse weight of the given state.
       */
     unsigned int getMinReverseWeight(const vector<SliceValue>& state) const;
+    /** This method returns the minimum reverse weight of a state.
+      * @param   state  The value of a state given as a FixedStateAsSlices.
+      * @return The minimum reverse weight of the given state.
+      */
+    unsigned int getMinReverseWeight(const FixedStateAsSlices& state) const;
     /** This method returns the minimum reverse weight of a state, to which
       * the reverse λ is first applied.
       * This allows to give a state value before χ (so after λ),
@@ -139,6 +187,10 @@ public:
       * @return The minimum reverse weight.
       */
     unsigned int getMinReverseWeightAfterLambda(const vector<SliceValue>& state) const;
+    /** This method is the same as getMinReverseWeightAfterLambda(const vector<SliceValue>&)
+      * on a state given as a FixedStateAsSlices.
+      */
+    unsigned int getMinReverseWeightAfterLambda(const FixedStateAsSlices& state) const;
     /** This method multiplies the vector (dx, dy)<sup>T</sup> by the matrix π or π<sup>-1</sup>
       * to the left:
       * - for DC, π is used;
@@ -179,6 +231,16 @@ public:
       * @param  point   The coordinates (x, y, z) to update.
       */
     void reverseRhoPiBeforeTheta(BitPosition& point) const;
+    /** This method does the same as directRhoPi(BitPosition&) on a packed bit position,
+      * with a lookup in a precomputed table.
+      * @param  point   The position to update.
+      */
+    inline void directRhoPi(PackedBitPosition& point) const;
+    /** This method does the same as reverseRhoPi(BitPosition&) on a packed bit position,
+      * with a lookup in a precomputed table.
+      * @param  point   The position to update.
+      */
+    inline void reverseRhoPi(PackedBitPosition& point) const;
     /** This method computes a lower bound on the propagation weight
       * for any state having the given the Hamming weight.
       * The formula is given in Section 3.1 of "The Keccak reference".
@@ -256,6 +318,9 @@ public:
       *                           set to true, unless the parities do not fit in the PackedParity type.
       *                           If false, the produced object will have AffineSpaceOfStates::packed
       *                           set to false.
+      * @note  The generators of each slice value, after λ and translated to z=0,
+      *        are kept in a bounded cache local to the calling thread,
+      *        so recurring slice values are propagated through λ only once.
       * @return The affine space as a AffineSpaceOfStates object.
       */
     AffineSpaceOfStates buildStateBase(const vector<SliceValue>& state, bool packedIfPossible = false) const;
@@ -268,6 +333,14 @@ public:
       * @return The iterator as a ReverseStateIterator object.
       */
     ReverseStateIterator getReverseStateIterator(const vector<SliceValue>& stateAfterChi, unsigned int maxWeight = 0) const;
+    /** This method builds an iterator over the possible states propagating through χ
+      * in the "reverse" direction, by nondecreasing propagation weight.
+      * See WeightOrderedReverseStateIterator.
+      * @param   stateAfterChi  The state just after χ given as a vector of slices.
+      * @param   maxWeight      The maximum propagation weight considered by the iterator.
+      * @return The iterator as a WeightOrderedReverseStateIterator object.
+      */
+    WeightOrderedReverseStateIterator getWeightOrderedReverseStateIterator(const vector<SliceValue>& stateAfterChi, unsigned int maxWeight) const;
     /** This method returns true iff the input row pattern is compatible with the output row pattern.
       * @param   beforeChi  The row value at the input of χ.
       * @param   afterChi   The row value at the output of χ.
@@ -275,7 +348,7 @@ public:
       */
     inline bool isChiCompatible(const RowValue& beforeChi, const RowValue& afterChi) const
     {
-        return chiCompatibilityTable[beforeChi+32*afterChi];
+        return ((chiCompatibilityTable[beforeChi] >> afterChi) & 1) != 0;
     }
     /** This method returns true iff the given state before χ is compatible with the given state after χ.
       * @param   beforeChi  The state value at the input of χ.
@@ -283,6 +356,14 @@ public:
       * @return It returns true iff the given values are compatible through χ.
       */
     bool isChiCompatible(const vector<SliceValue>& beforeChi, const vector<SliceValue>& afterChi) const;
+    /** This method is the same as isChiCompatible(const vector<SliceValue>&, const vector<SliceValue>&)
+      * on states given as FixedStateAsSlices.
+      */
+    bool isChiCompatible(const FixedStateAsSlices& beforeChi, const FixedStateAsSlices& afterChi) const;
+    /** This method is the same as isChiCompatible(const vector<SliceValue>&, const vector<SliceValue>&)
+      * on states given as arrays of laneSize slices, e.g., to mix both types of states.
+      */
+    bool isChiCompatible(const SliceValue *beforeChi, const SliceValue *afterChi) const;
     /** This method returns true iff two trails can be chained, i.e., if last state of the first trail
       * is compatible through χ and λ with the first state of the second trail.
       * @param   first  The first trail.
@@ -301,6 +382,10 @@ public:
       * @param   out    The output state value returned as a vector of slices.
       */
     void directLambda(const vector<SliceValue>& in, vector<SliceValue>& out) const;
+    /** This method is the same as directLambda(const vector<SliceValue>&, vector<SliceValue>&)
+      * on states given as FixedStateAsSlices, without memory allocation.
+      */
+    void directLambda(const FixedStateAsSlices& in, FixedStateAsSlices& out) const;
     /** This method applies λ in the "reverse" direction:
       * - DC: π<sup>-1</sup> then ρ<sup>-1</sup> then θ<sup>-1</sup>;
       * - LC: θ<sup>-1T</sup> then ρ then π.
@@ -308,6 +393,10 @@ public:
       * @param   out    The output state value returned as a vector of slices.
       */
     void reverseLambda(const vector<SliceValue>& in, vector<SliceValue>& out) const;
+    /** This method is the same as reverseLambda(const vector<SliceValue>&, vector<SliceValue>&)
+      * on states given as FixedStateAsSlices, without memory allocation.
+      */
+    void reverseLambda(const FixedStateAsSlices& in, FixedStateAsSlices& out) const;
     /** This method applies the part of λ before θ in the "direct" direction:
       * - DC: identity;
       * - LC: π<sup>-1</sup> then ρ<sup>-1</sup>.
@@ -315,6 +404,10 @@ public:
       * @param   out    The output state value returned as a vector of slices.
       */
     void directLambdaBeforeTheta(const vector<SliceValue>& in, vector<SliceValue>& out) const;
+    /** This method is the same as directLambdaBeforeTheta(const vector<SliceValue>&, vector<SliceValue>&)
+      * on states given as FixedStateAsSlices, without memory allocation.
+      */
+    void directLambdaBeforeTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out) const;
     /** This method applies the part of λ before θ in the "reverse" direction:
       * - DC: identity;
       * - LC: ρ then π.
@@ -322,6 +415,10 @@ public:
       * @param   out    The output state value returned as a vector of slices.
       */
     void reverseLambdaBeforeTheta(const vector<SliceValue>& in, vector<SliceValue>& out) const;
+    /** This method is the same as reverseLambdaBeforeTheta(const vector<SliceValue>&, vector<SliceValue>&)
+      * on states given as FixedStateAsSlices, without memory allocation.
+      */
+    void reverseLambdaBeforeTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out) const;
     /** This method applies θ in the "direct" direction:
       * - DC: θ;
       * - LC: θ<sup>T</sup>.
@@ -343,6 +440,10 @@ public:
       * @param   out    The output state value returned as a vector of slices.
       */
     void directLambdaAfterTheta(const vector<SliceValue>& in, vector<SliceValue>& out) const;
+    /** This method is the same as directLambdaAfterTheta(const vector<SliceValue>&, vector<SliceValue>&)
+      * on states given as FixedStateAsSlices, without memory allocation.
+      */
+    void directLambdaAfterTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out) const;
     /** This method applies the part of λ after θ in the "reverse" direction:
       * - DC: π<sup>-1</sup> then ρ<sup>-1</sup>;
       * - LC: identity.
@@ -350,6 +451,10 @@ public:
       * @param   out    The output state value returned as a vector of slices.
       */
     void reverseLambdaAfterTheta(const vector<SliceValue>& in, vector<SliceValue>& out) const;
+    /** This method is the same as reverseLambdaAfterTheta(const vector<SliceValue>&, vector<SliceValue>&)
+      * on states given as FixedStateAsSlices, without memory allocation.
+      */
+    void reverseLambdaAfterTheta(const FixedStateAsSlices& in, FixedStateAsSlices& out) const;
     /** This function computes the θ-effect from the parity, in the "direct" direction:
       * - DC: the θ-effect;
       * - LC: the θ<sup>T</sup>-effect.
@@ -430,32 +535,79 @@ public:
       * @param  trail   The trail to transform.
       */
     void specifyStateAfterLastChiArbitrarily(Trail& trail) const;
+private:
+    void copySmallTables();
+};
+
+/** This class contains the tables of KeccakFPropagation, which depend only on
+  * the type of propagation. It is immutable, and shared by all the copies of
+  * a KeccakFPropagation instance. See KeccakFPropagation for the meaning of the attributes.
+  */
+class KeccakFPropagationTables {
+public:
+    vector<ListOfRowPatterns> directRowOutputListPerInput;
+    vector<ListOfRowPatterns> reverseRowOutputListPerInput;
+    RowPatternTable directRowOutputTable;
+    RowPatternTable reverseRowOutputTable;
+    vector<AffineSpaceOfRows> affinePerInput;
+    /** A number that identifies these tables among all the instances built,
+      * e.g., to tell which tables a cache computed from them belongs to.
+      */
+    UINT64 identifier;
+    unsigned char weightPerRow[32];
+    unsigned char minReverseWeightPerRow[32];
+    UINT32 chiCompatibilityTable[32];
+    /** The image through KeccakFPropagation::directRhoPi() of each packed bit position, indexed by its value. */
+    vector<PackedBitPosition> directRhoPiPerPackedPosition;
+    /** The image through KeccakFPropagation::reverseRhoPi() of each packed bit position, indexed by its value. */
+    vector<PackedBitPosition> reverseRhoPiPerPackedPosition;
+public:
+    /** This constructor initializes the tables.
+      * @param   parent     A reference to the Keccak-<i>f</i> instance as a KeccakFDCLC object.
+      * @param   DCorLC     The propagation type.
+      */
+    KeccakFPropagationTables(const KeccakFDCLC& parent, KeccakFPropagation::DCorLC DCorLC);
 private:
     /** This method initializes affinePerInput.
       */
-    void initializeAffine();
-    /** This method initializes weightPerSlice.
+    void initializeAffine(const KeccakFDCLC& parent, KeccakFPropagation::DCorLC DCorLC);
+    /** This method initializes weightPerRow.
       */
     void initializeWeight();
-    /** This method initializes minReverseWeightPerSlice.
+    /** This method initializes minReverseWeightPerRow.
       */
     void initializeMinReverseWeight();
     /** This method initializes chiCompatibilityTable.
       */
     void initializeChiCompatibilityTable();
-    unsigned int weightOfSlice(SliceValue slice) const;
+    /** This method initializes directRhoPiPerPackedPosition and reverseRhoPiPerPackedPosition.
+      */
+    void initializeRhoPiPerPackedPosition(const KeccakFDCLC& parent, KeccakFPropagation::DCorLC DCorLC);
 };
 
+inline void KeccakFPropagation::directRhoPi(PackedBitPosition& point) const
+{
+    point = tables->directRhoPiPerPackedPosition[point.value];
+}
+
+inline void KeccakFPropagation::reverseRhoPi(PackedBitPosition& point) const
+{
+    point = tables->reverseRhoPiPerPackedPosition[point.value];
+}
+
 /** This class implements an iterator over the possible state values
   * before χ given a state after χ.
+  * The iterator refers to the tables of the KeccakFPropagation instance
+  * it is built from, which must therefore outlive it.
   */
 class ReverseStateIterator
 {
 private:
-    vector<ListOfRowPatterns> patterns;
+    vector<RowPatternTable::Range> patterns;
     vector<unsigned int> Ys, Zs;
     vector<unsigned int> indexes;
     unsigned int size;
+    unsigned int freeBegin, freeEnd;
     unsigned int minWeight, maxWeight;
     vector<SliceValue> current;
     unsigned int currentWeight;
@@ -499,9 +651,98 @@ public:
       * @return The weight of the current state.
       */
     unsigned int getCurrentWeight() const;
+    /** This method splits the states that remain to be run through into independent parts.
+      * The iterator enumerates the active rows like an odometer, the first rows
+      * changing the fastest. Here, the choices for the last @a depth rows that the
+      * iterator still varies are taken as a prefix: the iterator keeps only the remaining states
+      * with the same prefix as the current state, and a new iterator is appended to @a parts
+      * for each subsequent prefix for which at least one state is within the maximum weight.
+      * Running through the iterator and then through the parts in order
+      * gives the same states as the iterator would have without splitting.
+      * @param  depth   The number of rows in the prefix.
+      * @param  parts   The vector to which the new iterators are appended.
+      * @return It returns false iff the iterator has reached its end or
+      *     has no row left to vary, so that it cannot be split further.
+      */
+    bool split(unsigned int depth, vector<ReverseStateIterator>& parts);
 private:
     void initialize(const vector<SliceValue>& stateAfterChi, const KeccakFPropagation& DCorLC);
     void next();
+    void resetRows(unsigned int from, unsigned int to);
+};
+
+/** This class implements an iterator over the possible state values
+  * before χ given a state after χ, like ReverseStateIterator,
+  * but by nondecreasing propagation weight.
+  * The states are built lazily: the choices for the active rows are
+  * taken from their output lists sorted by weight, and merged with a priority queue,
+  * so that only the states up to the weight of the current one are ever built.
+  * A caller can thus stop as soon as the weight exceeds its budget.
+  * The states with the same weight come in a fixed order.
+  * The iterator refers to the tables of the KeccakFPropagation instance
+  * it is built from, which must therefore outlive it.
+  */
+class WeightOrderedReverseStateIterator
+{
+private:
+    /** A combination of the choices for the active rows, waiting in the queue. */
+    struct Candidate {
+        /** The propagation weight of the state. */
+        unsigned int weight;
+        /** The rank at which the candidate was queued, to order the candidates with the same weight. */
+        UINT64 rank;
+        /** The row from which the choices can still be changed. */
+        unsigned int firstFreeRow;
+        /** The index of the choice of each active row in its sorted output list. */
+        vector<UINT8> indexes;
+        bool operator<(const Candidate& other) const
+        {
+            // The priority queue puts the greatest element first.
+            if (weight != other.weight)
+                return weight > other.weight;
+            return rank > other.rank;
+        }
+    };
+    vector<RowPatternTable::Range> patterns;
+    vector<unsigned int> Ys, Zs;
+    unsigned int maxWeight;
+    priority_queue<Candidate> candidates;
+    UINT64 nrQueued;
+    Candidate currentCandidate;
+    vector<SliceValue> current;
+    bool end, empty;
+public:
+    /** This constructor initializes the iterator based on a state value after χ,
+      * the KeccakFPropagation instance, which determines the compatible states,
+      * and a maximum of the propagation weight.
+      * @param   stateAfterChi  The state value after χ as a vector of slices.
+      * @param   DCorLC         A reference to the KeccakFPropagation instance that
+      *                         determines the type of propagation.
+      * @param   aMaxWeight     The iterator will run through the states whose propagation
+      *                         weight is not higher than this parameter.
+      */
+    WeightOrderedReverseStateIterator(const vector<SliceValue>& stateAfterChi, const KeccakFPropagation& DCorLC, unsigned int aMaxWeight);
+    /** This method tells whether the iterator has reached the end of the possible states.
+      * @return It returns true iff there are no more states to run through.
+      */
+    bool isEnd() const;
+    /** This method tells wether the set of states to run through is empty.
+      * @return It returns true iff there are no states to run through.
+      */
+    bool isEmpty() const;
+    /** This method moves the iterator to the next state. */
+    void operator++();
+    /** This method returns a constant reference to the current state.
+      * @return A constant reference to the current state as a vector of slices.
+      */
+    const vector<SliceValue>& operator*() const;
+    /** This method returns the propagation weight of the current state.
+      * @return The weight of the current state.
+      */
+    unsigned int getCurrentWeight() const;
+private:
+    void next();
+    void queueSuccessors();
 };
 
 #endif
@@ -20,6 +20,8 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include "Keccak-fParts.h"
 #include "Keccak-fPositions.h"
 #include <map>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
@@ -132,17 +134,45 @@ public:
 
 };
 
-/** The SparseState type codes a state as map of z-coordinate, SliceValue couples.
+/** The SparseStateAsSlices type codes a state as a list of (z-coordinate, SliceValue) couples,
+  * sorted by z-coordinate.
   * It is compact for sparse states as it only stores the nonzero slices.
+  * Up to inlineCapacity slices are stored inside the object itself,
+  * so that low-weight states are handled without memory allocation;
+  * beyond that, the slices are moved to a vector.
   * The convention used and maintained by the getSlice(), setSlice(), getBit(),
   * setBitToZero() and invertBit() functions is that a slice with value zero
-  * does not appear in the map.
+  * does not appear in the list.
   */
 class SparseStateAsSlices {
 public:
-    map<unsigned int, SliceValue> slices;
+    /** The type of a couple (z-coordinate, slice value). */
+    typedef pair<unsigned int, SliceValue> Slice;
+    /** The type of an iterator over the nonzero slices, by increasing z-coordinate. */
+    typedef const Slice *const_iterator;
+    /** The number of slices stored without memory allocation. */
+    enum { inlineCapacity = 8 };
+protected:
+    /** The number of nonzero slices. */
+    unsigned int nrSlices;
+    /** The slices, if there are at most inlineCapacity of them. */
+    Slice inlineSlices[inlineCapacity];
+    /** The slices, if there are more than inlineCapacity of them. */
+    vector<Slice> moreSlices;
 public:
-    SparseStateAsSlices() {}
+    SparseStateAsSlices() : nrSlices(0) {}
+
+    /** This method returns an iterator to the first nonzero slice. */
+    inline const_iterator begin() const { return getSlices(); }
+
+    /** This method returns an iterator past the last nonzero slice. */
+    inline const_iterator end() const { return getSlices() + nrSlices; }
+
+    /** This method returns the number of nonzero slices. */
+    inline unsigned int size() const { return nrSlices; }
+
+    /** This method tells whether the state is all-zero. */
+    inline bool empty() const { return nrSlices == 0; }
 
     /** This method returns the value of a given bit in a state.
       *
@@ -152,11 +182,7 @@ public:
       */
     inline int getBit(unsigned int x, unsigned int y, unsigned int z) const
     {
-        map<unsigned int, SliceValue>::const_iterator slice = slices.find(z);
-        if (slice == slices.end())
-            return 0;
-        else
-            return ((slice->second) >> (x+5*y)) & 1;
+        return (getSlice(z) >> (x+5*y)) & 1;
     }
 
     /** This method returns the value of a given bit in a state.
@@ -176,12 +202,7 @@ public:
       */
     inline void setBitToZero(unsigned int x, unsigned int y, unsigned int z)
     {
-        map<unsigned int, SliceValue>::iterator slice = slices.find(z);
-        if (slice != slices.end()) {
-            slice->second &= ~getSlicePoint(x, y);
-            if (slice->second == 0)
-                slices.erase(slice);
-        }
+        setSlice(z, getSlice(z) & ~getSlicePoint(x, y));
     }
 
     /** This method sets to 0 a particular bit in a state.
@@ -201,11 +222,7 @@ public:
       */
     inline void setBitToOne(unsigned int x, unsigned int y, unsigned int z)
     {
-        map<unsigned int, SliceValue>::iterator slice = slices.find(z);
-        if (slice != slices.end())
-            slice->second |= getSlicePoint(x, y);
-        else
-            slices[z] = getSlicePoint(x, y);
+        setSlice(z, getSlice(z) | getSlicePoint(x, y));
     }
 
     /** This method sets to 1 a particular bit in a state.
@@ -225,14 +242,7 @@ public:
       */
     inline void invertBit(unsigned int x, unsigned int y, unsigned int z)
     {
-        map<unsigned int, SliceValue>::iterator slice = slices.find(z);
-        if (slice != slices.end()) {
-            slice->second ^= getSlicePoint(x, y);
-            if (slice->second == 0)
-                slices.erase(slice);
-        }
-        else
-            slices[z] = getSlicePoint(x, y);
+        setSlice(z, getSlice(z) ^ getSlicePoint(x, y));
     }
 
     /** This method inverts a particular bit in a state.
@@ -250,11 +260,12 @@ public:
       */
     inline SliceValue getSlice(unsigned int z) const
     {
-        map<unsigned int, SliceValue>::const_iterator slice = slices.find(z);
-        if (slice == slices.end())
-            return 0;
+        const Slice *slices = getSlices();
+        unsigned int i = find(z);
+        if ((i < nrSlices) && (slices[i].first == z))
+            return slices[i].second;
         else
-            return slice->second;
+            return 0;
     }
 
     /** This method sets the value of a given slice in a state.
@@ -264,19 +275,66 @@ public:
       */
     inline void setSlice(unsigned int z, SliceValue value)
     {
-        map<unsigned int, SliceValue>::iterator slice = slices.find(z);
-        if (slice == slices.end()) {
-            if (value != 0)
-                slices[z] = value;
-        }
-        else {
+        Slice *slices = getSlices();
+        unsigned int i = find(z);
+        if ((i < nrSlices) && (slices[i].first == z)) {
             if (value == 0)
-                slices.erase(slice);
+                erase(i);
             else
-                slice->second = value;
+                slices[i].second = value;
         }
+        else if (value != 0)
+            insert(i, Slice(z, value));
     }
 
+protected:
+    inline const Slice *getSlices() const
+    {
+        return (nrSlices > inlineCapacity) ? moreSlices.data() : inlineSlices;
+    }
+    inline Slice *getSlices()
+    {
+        return (nrSlices > inlineCapacity) ? moreSlices.data() : inlineSlices;
+    }
+    /** This method returns the index of the first slice with z-coordinate not below @a z. */
+    inline unsigned int find(unsigned int z) const
+    {
+        const Slice *slices = getSlices();
+        unsigned int i = 0;
+        while((i < nrSlices) && (slices[i].first < z))
+            i++;
+        return i;
+    }
+    inline void insert(unsigned int i, const Slice& slice)
+    {
+        if (nrSlices < inlineCapacity) {
+            for(unsigned int j=nrSlices; j>i; j--)
+                inlineSlices[j] = inlineSlices[j-1];
+            inlineSlices[i] = slice;
+        }
+        else {
+            if (nrSlices == inlineCapacity)
+                moreSlices.assign(inlineSlices, inlineSlices + inlineCapacity);
+            moreSlices.insert(moreSlices.begin() + i, slice);
+        }
+        nrSlices++;
+    }
+    inline void erase(unsigned int i)
+    {
+        if (nrSlices <= inlineCapacity) {
+            for(unsigned int j=i+1; j<nrSlices; j++)
+                inlineSlices[j-1] = inlineSlices[j];
+        }
+        else {
+            moreSlices.erase(moreSlices.begin() + i);
+            if (nrSlices == inlineCapacity + 1) {
+                for(unsigned int j=0; j<inlineCapacity; j++)
+                    inlineSlices[j] = moreSlices[j];
+                moreSlices.clear();
+            }
+        }
+        nrSlices--;
+    }
 };
 
 #endif
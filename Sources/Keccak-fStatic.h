@@ -0,0 +1,436 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFSTATIC_H_
+#define _KECCAKFSTATIC_H_
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Keccak-f.h"
+
+using namespace std;
+
+/**
+  * Class containing the constants of Keccak-<i>f</i>[@a width] as compile-time
+  * expressions, as a complement to the run-time initialization done by KeccakF.
+  */
+template<unsigned int width>
+class KeccakFConstants {
+public:
+    static_assert((width == 25) || (width == 50) || (width == 100) || (width == 200)
+        || (width == 400) || (width == 800) || (width == 1600),
+        "The width must be one of 25, 50, 100, 200, 400, 800 or 1600.");
+    /** The size of the lanes. */
+    static constexpr unsigned int laneSize = width/25;
+    /** A 64-bit word whose first laneSize bits are 1 and all others 0. */
+    static constexpr LaneValue mask = (LaneValue(~0)) >> (64-laneSize);
+    /** The nominal number of rounds, i.e., 12+2ℓ with 2<sup>ℓ</sup> = laneSize. */
+    static constexpr unsigned int nominalNrRounds =
+        12 + 2*((laneSize >= 2) + (laneSize >= 4) + (laneSize >= 8)
+            + (laneSize >= 16) + (laneSize >= 32) + (laneSize >= 64));
+    /**
+      * Method that maps the coordinates (x, y) onto the lanes numbered
+      * from 0 to 24, as KeccakF::index().
+      */
+    static constexpr unsigned int index(unsigned int x, unsigned int y)
+    {
+        return (x%5) + 5*(y%5);
+    }
+    /**
+      * Class holding the ρ offsets and the round constants, computed by
+      * its constructor at compile time.
+      */
+    class Tables {
+    public:
+        /** The ρ offsets reduced modulo laneSize, indexed as by index(). */
+        unsigned int rhoOffsets[25];
+        /** The 255 distinct round constants of ι, truncated to laneSize bits. */
+        LaneValue roundConstants[255];
+        constexpr Tables()
+            : rhoOffsets(), roundConstants()
+        {
+            unsigned int x = 1, y = 0;
+            for(unsigned int t=0; t<24; t++) {
+                rhoOffsets[index(x, y)] = ((t+1)*(t+2)/2) % laneSize;
+                unsigned int newX = y;
+                unsigned int newY = (2*x + 3*y)%5;
+                x = newX;
+                y = newY;
+            }
+            UINT8 LFSRstate = 0x01;
+            for(unsigned int i=0; i<255; i++) {
+                LaneValue c = 0;
+                for(unsigned int j=0; j<7; j++) {
+                    if ((LFSRstate & 0x01) != 0)
+                        c ^= (LaneValue)1 << ((1<<j)-1);
+                    if ((LFSRstate & 0x80) != 0)
+                        LFSRstate = (UINT8)((LFSRstate << 1) ^ 0x71);
+                    else
+                        LFSRstate = (UINT8)(LFSRstate << 1);
+                }
+                roundConstants[i] = c & mask;
+            }
+        }
+    };
+    /** The tables of ρ offsets and round constants. */
+    static constexpr Tables tables = Tables();
+    /**
+      * Method that returns the ρ offset of lane (x, y), reduced modulo laneSize.
+      */
+    static constexpr unsigned int rhoOffset(unsigned int x, unsigned int y)
+    {
+        return tables.rhoOffsets[index(x, y)];
+    }
+    /**
+      * Method that returns the round constant of ι for the given round index.
+      */
+    static constexpr LaneValue roundConstant(int roundIndex)
+    {
+        return tables.roundConstants[((roundIndex % 255) + 255) % 255];
+    }
+};
+
+/**
+  * Class implementing Keccak-<i>f</i>[@a width] with the number of rounds
+  * and the index of the first round fixed at compile time. By default,
+  * it implements Keccak-<i>p</i>[@a width, @a nrRounds], i.e., the last
+  * @a nrRounds rounds of Keccak-<i>f</i>, and Keccak-<i>f</i> itself if
+  * @a nrRounds is nominal.
+  * As the lane size, the ρ offsets and the round constants are all known
+  * at compile time, the compiler can fully unroll and constant-fold the
+  * rounds. It exposes the same template methods as KeccakF (forward(),
+  * inverse(), round(), theta(), etc.) so that it can be used with
+  * symbolic lanes as well.
+  */
+template<unsigned int width,
+    unsigned int nrRounds = KeccakFConstants<width>::nominalNrRounds,
+    int startRoundIndex = (int)KeccakFConstants<width>::nominalNrRounds - (int)nrRounds>
+class KeccakFStatic : public Permutation {
+public:
+    typedef KeccakFConstants<width> Constants;
+    /** The size of the lanes. */
+    static constexpr unsigned int laneSize = Constants::laneSize;
+    /** A 64-bit word whose first laneSize bits are 1 and all others 0. */
+    static constexpr LaneValue mask = Constants::mask;
+public:
+    KeccakFStatic() : Permutation() {}
+    /** Method that returns the number of bits of its domain and range. */
+    unsigned int getWidth() const { return width; }
+    /** Method that retuns the lane size. */
+    unsigned int getLaneSize() const { return laneSize; }
+    /** Method that returns the number of rounds of this instance. */
+    unsigned int getNumberOfRounds() const { return nrRounds; }
+    /** Method that returns the nominal number of rounds of Keccak-<i>f</i>[@a width]. */
+    unsigned int getNominalNumberOfRounds() const { return Constants::nominalNrRounds; }
+    /** Method that returns the index of the first round of this instance. */
+    int getIndexOfFirstRound() const { return startRoundIndex; }
+    /**
+      * Method that applies the permutation onto the parameter @a state.
+      */
+    void operator()(UINT8 * state) const
+    {
+        LaneValue A[25];
+        fromBytesToLanes(state, A);
+        forwardOnLanes(A);
+        fromLanesToBytes(A, state);
+    }
+    /**
+      * Method that applies the inverse of the permutation onto the parameter @a state.
+      */
+    void inverse(UINT8 * state) const
+    {
+        vector<LaneValue> A(25);
+        fromBytesToLanes(state, &A[0]);
+        inverse(A);
+        fromLanesToBytes(&A[0], state);
+    }
+    /**
+      * Method that applies the permutation onto a state given as 25 lanes
+      * in 64-bit words, with ρ and π combined and without allocating memory.
+      */
+    void forwardOnLanes(LaneValue *A) const
+    {
+        for(int i=startRoundIndex; i<startRoundIndex+(int)nrRounds; i++)
+            roundOnLanes(A, i);
+    }
+    /**
+      * Method that applies the round function onto a state given as 25 lanes
+      * in 64-bit words.
+      */
+    static void roundOnLanes(LaneValue *A, int roundIndex)
+    {
+        LaneValue B[25], C[5], D[5];
+        for(unsigned int x=0; x<5; x++)
+            C[x] = A[x] ^ A[x+5] ^ A[x+10] ^ A[x+15] ^ A[x+20];
+        for(unsigned int x=0; x<5; x++)
+            D[x] = rotate(C[(x+1)%5], 1) ^ C[(x+4)%5];
+        for(unsigned int y=0; y<25; y+=5)
+            for(unsigned int x=0; x<5; x++)
+                A[x+y] ^= D[x];
+        for(unsigned int x=0; x<5; x++)
+            for(unsigned int y=0; y<5; y++)
+                B[index(y, 2*x+3*y)] = rotate(A[index(x,y)], Constants::rhoOffset(x, y));
+        for(unsigned int y=0; y<25; y+=5)
+            for(unsigned int x=0; x<5; x++)
+                A[x+y] = B[x+y] ^ ((~B[(x+1)%5+y]) & B[(x+2)%5+y]);
+        A[0] ^= Constants::roundConstant(roundIndex);
+    }
+    /**
+      * Template method that applies the permutation, see KeccakF::forward().
+      */
+    template<class Lane> void forward(vector<Lane>& state) const
+    {
+        for(int i=startRoundIndex; i<startRoundIndex+(int)nrRounds; i++)
+            round(state, i);
+    }
+    /**
+      * Method that applies the permutation onto a vector of 25 lanes in
+      * 64-bit words through forwardOnLanes().
+      */
+    void forward(vector<LaneValue>& state) const
+    {
+        forwardOnLanes(&state[0]);
+    }
+    /**
+      * Template method that applies the inverse permutation, see KeccakF::inverse().
+      */
+    template<class Lane> void inverse(vector<Lane>& state) const
+    {
+        for(int i=startRoundIndex+(int)nrRounds-1; i>=startRoundIndex; i--)
+            inverseRound(state, i);
+    }
+    /**
+      * Template method that applies the round function, see KeccakF::round().
+      */
+    template<class Lane> void round(vector<Lane>& state, int roundIndex) const
+    {
+        theta(state);
+        rho(state);
+        pi(state);
+        chi(state);
+        iota(state, roundIndex);
+    }
+    /**
+      * Template method that applies the inverse of the round function,
+      * see KeccakF::inverseRound().
+      */
+    template<class Lane> void inverseRound(vector<Lane>& state, int roundIndex) const
+    {
+        iota(state, roundIndex);
+        inverseChi(state);
+        inversePi(state);
+        inverseRho(state);
+        inverseTheta(state);
+    }
+    /** Template method that applies χ. */
+    template<class Lane> void chi(vector<Lane>& A) const
+    {
+        Lane C[5];
+        for(unsigned int y=0; y<5; y++) {
+            for(unsigned int x=0; x<5; x++)
+                C[x] = A[index(x,y)] ^ ((~A[index(x+1,y)]) & A[index(x+2,y)]);
+            for(unsigned int x=0; x<5; x++)
+                A[index(x,y)] = C[x];
+        }
+    }
+    /** Template method that applies the inverse of χ. */
+    template<class Lane> void inverseChi(vector<Lane>& A) const
+    {
+        for(unsigned int y=0; y<5; y++) {
+            Lane C[5];
+            for(unsigned int x=0; x<5; x++)
+                C[x] = A[index(x,y)];
+            for(unsigned int x=0; x<6; x++) {
+                unsigned int X = 3*x;
+                A[index(X,y)] = C[X%5] ^ (A[index(X+2,y)] & (~C[(X+1)%5]));
+            }
+        }
+    }
+    /** Template method that applies θ. */
+    template<class Lane> void theta(vector<Lane>& A) const
+    {
+        Lane C[5], D[5];
+        for(unsigned int x=0; x<5; x++) {
+            C[x] = A[index(x,0)];
+            for(unsigned int y=1; y<5; y++)
+                C[x] ^= A[index(x,y)];
+        }
+        for(unsigned int x=0; x<5; x++) {
+            Lane temp = C[(x+1)%5];
+            ROL(temp, 1);
+            D[x] = temp ^ C[(x+4)%5];
+        }
+        for(unsigned int x=0; x<5; x++)
+            for(unsigned int y=0; y<5; y++)
+                A[index(x,y)] ^= D[x];
+    }
+    /** Template method that applies the inverse of θ, see KeccakF::inverseTheta(). */
+    template<class Lane> void inverseTheta(vector<Lane>& A) const
+    {
+        Lane C[5];
+        for(unsigned int x=0; x<5; x++) {
+            C[x] = A[index(x,0)];
+            for(unsigned int y=1; y<5; y++)
+                C[x] ^= A[index(x,y)];
+        }
+        for(unsigned int z=0; z<laneSize; z++) {
+            for(unsigned int xOff=0; xOff<5; xOff++)
+                if (((inversePositions(xOff) >> z) & 1) != 0)
+                    for(unsigned int x=0; x<5; x++)
+                        for(unsigned int y=0; y<5; y++)
+                            A[index(x, y)] ^= C[(x+5-xOff)%5];
+            for(unsigned int xOff=0; xOff<5; xOff++)
+                ROL(C[xOff], 1);
+        }
+    }
+    /** Template method that applies π. */
+    template<class Lane> void pi(vector<Lane>& A) const
+    {
+        vector<Lane> a(A);
+        for(unsigned int x=0; x<5; x++)
+            for(unsigned int y=0; y<5; y++)
+                A[index(y, 2*x+3*y)] = a[index(x,y)];
+    }
+    /** Template method that applies the inverse of π. */
+    template<class Lane> void inversePi(vector<Lane>& A) const
+    {
+        vector<Lane> a(A);
+        for(unsigned int x=0; x<5; x++)
+            for(unsigned int y=0; y<5; y++)
+                A[index(x,y)] = a[index(y, 2*x+3*y)];
+    }
+    /** Template method that applies ρ. */
+    template<class Lane> void rho(vector<Lane>& A) const
+    {
+        for(unsigned int x=0; x<5; x++)
+            for(unsigned int y=0; y<5; y++)
+                ROL(A[index(x,y)], Constants::rhoOffset(x, y));
+    }
+    /** Template method that applies the inverse of ρ. */
+    template<class Lane> void inverseRho(vector<Lane>& A) const
+    {
+        for(unsigned int x=0; x<5; x++)
+            for(unsigned int y=0; y<5; y++)
+                ROL(A[index(x,y)], (laneSize - Constants::rhoOffset(x, y)) % laneSize);
+    }
+    /** Template method that applies ι, which is its own inverse. */
+    template<class Lane> void iota(vector<Lane>& A, int roundIndex) const
+    {
+        A[0] ^= Constants::roundConstant(roundIndex);
+    }
+    /** Method that retuns the round constant used by ι in the given round. */
+    LaneValue getRoundConstant(int roundIndex) const
+    {
+        return Constants::roundConstant(roundIndex);
+    }
+    /** Template method that translates a lane along the z-axis, see KeccakF::ROL(). */
+    template<class Lane> void ROL(Lane& L, int offset) const
+    {
+        L.ROL(offset, laneSize);
+    }
+    /** Method that implementats ROL when the lane is in a 64-bit word LaneValue. */
+    void ROL(LaneValue& L, int offset) const
+    {
+        offset %= (int)laneSize;
+        if (offset < 0) offset += laneSize;
+        L = rotate(L & mask, offset);
+    }
+    /** Method that maps the coordinates (x, y) onto the lanes, see KeccakF::index(). */
+    static constexpr unsigned int index(unsigned int x, unsigned int y)
+    {
+        return Constants::index(x, y);
+    }
+    /**
+      * Method that converts a state given as an array of bytes into an array
+      * of 25 lanes in 64-bit words, see KeccakF::fromBytesToLanes().
+      */
+    static void fromBytesToLanes(const UINT8 *in, LaneValue *out)
+    {
+        for(unsigned int i=0; i<25; i++) {
+            if (laneSize < 8)
+                out[i] = (in[i*laneSize/8] >> ((i*laneSize) % 8)) & mask;
+            else {
+                out[i] = 0;
+                for(unsigned int j=0; j<(laneSize/8); j++)
+                    out[i] |= LaneValue(in[i*laneSize/8+j]) << (8*j);
+            }
+        }
+    }
+    /**
+      * Method that converts a state given as an array of 25 lanes in 64-bit
+      * words into an array of bytes, see KeccakF::fromLanesToBytes().
+      */
+    static void fromLanesToBytes(const LaneValue *in, UINT8 *out)
+    {
+        if (laneSize < 8) {
+            for(unsigned int i=0; i<(width+7)/8; i++)
+                out[i] = 0;
+            for(unsigned int i=0; i<25; i++)
+                out[i*laneSize/8] |= (UINT8)(in[i] << ((i*laneSize) % 8));
+        }
+        else {
+            for(unsigned int i=0; i<25; i++)
+                for(unsigned int j=0; j<(laneSize/8); j++)
+                    out[i*(laneSize/8)+j] = (UINT8)((in[i] >> (8*j)) & 0xFF);
+        }
+    }
+    /**
+      * Method that returns a string describing the instance, in the same
+      * format as KeccakF::getDescription().
+      */
+    string getDescription() const
+    {
+        stringstream a;
+        if ((nrRounds == Constants::nominalNrRounds) && (startRoundIndex == 0))
+            a << "Keccak-f[" << dec << width;
+        else if ((startRoundIndex + (int)nrRounds) == (int)Constants::nominalNrRounds)
+            a << "Keccak-p[" << dec << width << ", " << nrRounds;
+        else {
+            a << "Keccak-f[" << dec << width;
+            a << ", " << dec << nrRounds << " rounds " << startRoundIndex << "-" << (startRoundIndex+(int)nrRounds-1);
+        }
+        a << "]";
+        return a.str();
+    }
+protected:
+    /** Method that translates a lane by an offset already reduced modulo laneSize. */
+    static LaneValue rotate(LaneValue L, unsigned int offset)
+    {
+        if (offset == 0)
+            return L;
+        else
+            return ((L << offset) ^ (L >> (laneSize-offset))) & mask;
+    }
+    /**
+      * Method that returns, for the given x offset, the bit mask of the
+      * z offsets at which a column parity contributes to the inverse of θ.
+      */
+    static constexpr LaneValue inversePositions(unsigned int xOff)
+    {
+        const LaneValue inversePositions64[5] = {
+            0xDE26BC4D789AF134ULL,
+            0x09AF135E26BC4D78ULL,
+            0xEBC4D789AF135E26ULL,
+            0x7135E26BC4D789AFULL,
+            0xCD789AF135E26BC4ULL };
+        LaneValue result = 0;
+        for(unsigned int z=0; z<64; z+=laneSize)
+            result ^= inversePositions64[xOff] >> z;
+        return result;
+    }
+};
+
+#endif
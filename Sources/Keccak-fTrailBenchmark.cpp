@@ -0,0 +1,288 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+#include "Keccak-fDCLC.h"
+#include "Keccak-fTrailBenchmark.h"
+#include "Keccak-fTrailCollection.h"
+#include "Keccak-fTrailCoreInKernelAtC.h"
+#include "Keccak-fTrailExtension.h"
+#include "Keccak-fTree.h"
+#include "searchStatistics.h"
+
+using namespace std;
+
+/** Returns the peak resident set size of the process in bytes, or 0 if it is not available. */
+static UINT64 getPeakResidentSetSize()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return (UINT64)usage.ru_maxrss;
+#else
+    return (UINT64)usage.ru_maxrss*1024;
+#endif
+#endif
+}
+
+/** A workload returns the number of trails or trail cores it produces,
+  * and counts its nodes in the given statistics. */
+typedef function<UINT64(const KeccakFPropagation& DCorLC, SearchStatistics& statistics)> TrailWorkload;
+
+struct TrailWorkloadDescription {
+    string name;
+    unsigned int width;
+    KeccakFPropagation::DCorLC DCorLC;
+    string parameters;
+    UINT64 expectedCount;
+    TrailWorkload run;
+};
+
+/** Extends the first trail of a file forwards or backwards. */
+static UINT64 extendFirstTrail(const KeccakFPropagation& DCorLC, SearchStatistics& statistics,
+    const string& fileName, bool forward, unsigned int nrRounds, int maxTotalWeight)
+{
+    TrailCollection trails, firstTrail, trailsOut;
+    trails.load(fileName);
+    Trail trail;
+    trails.get(0, trail);
+    firstTrail.append(trail);
+    KeccakFTrailExtension extension(DCorLC);
+    extension.statistics = &statistics;
+    TrailCollectionIterator trailsIn(firstTrail, DCorLC);
+    if (forward)
+        extension.forwardExtendTrails(trailsIn, trailsOut, nrRounds, maxTotalWeight);
+    else
+        extension.backwardExtendTrails(trailsIn, trailsOut, nrRounds, maxTotalWeight);
+    return trailsOut.size();
+}
+
+/** Traverses the orbital tree, as traverseOrbitalTree() in main.cpp, and returns the number of nodes. */
+static UINT64 countOrbitalTreeNodes(const KeccakFPropagation& DCorLC, SearchStatistics& statistics,
+    unsigned int maxCost, unsigned int alpha, unsigned int beta)
+{
+    TwoRoundTrailCoreCostFunction costF(alpha, beta);
+    OrbitalsSet orbitals(DCorLC.laneSize);
+    TwoRoundTrailCoreStack cache(DCorLC);
+    OrbitalTreeIterator iterator(orbitals, cache, costF, maxCost);
+    iterator.setStatistics(&statistics);
+    UINT64 count = 0;
+    for(; !iterator.isEnd(); ++iterator)
+        count++;
+    return count;
+}
+
+/** Traverses the run tree, as traverseRunTreeAndOrbitalTree() in main.cpp without the orbital trees,
+  * and returns the number of nodes. */
+static UINT64 countRunTreeNodes(const KeccakFPropagation& DCorLC, SearchStatistics& statistics,
+    unsigned int maxCost, unsigned int alpha, unsigned int beta)
+{
+    TwoRoundTrailCoreCostBoundFunction costF(alpha, beta);
+    ColumnsSet columns(DCorLC.laneSize);
+    TwoRoundTrailCoreStack cache(DCorLC);
+    RunTreeIterator iterator(columns, cache, costF, maxCost);
+    iterator.setStatistics(&statistics);
+    UINT64 count = 0;
+    for(; !iterator.isEnd(); ++iterator)
+        count++;
+    return count;
+}
+
+/** Generates the 3-round trail cores in the kernel at C, with an empty background. */
+static UINT64 countTrailCoresInKernelAtC(const KeccakFPropagation& DCorLC, SearchStatistics& statistics,
+    unsigned int maxWeight)
+{
+    vector<SliceValue> empty(DCorLC.laneSize, 0);
+    TrailCoreInKernelAtC cores(empty, empty, maxWeight, DCorLC);
+    cores.setStatistics(&statistics);
+    UINT64 count = 0;
+    while(cores.next())
+        count++;
+    return count;
+}
+
+/** Reads the trails of a file, saves them in the text and binary formats,
+  * and returns the number of trails parsed back from the text,
+  * or 0 if a trail does not come back unchanged from a CompressedTrailSet. */
+static UINT64 readWriteTrails(const KeccakFPropagation& DCorLC, const string& fileName)
+{
+    TrailCollection trails;
+    TrailFileIterator trailsIn(fileName, DCorLC, false);
+    for(; !trailsIn.isEnd(); ++trailsIn)
+        trails.fetchTrail(*trailsIn);
+    CompressedTrailSet compressedTrails;
+    for(UINT64 i=0; i<trails.size(); i++) {
+        Trail original, decompressed;
+        trails.get(i, original);
+        CompressedTrail compressed(original);
+        compressed.get(decompressed);
+        if ((!decompressed.hasSameStates(original)) || (decompressed.weights != original.weights))
+            return 0;
+        for(unsigned int round=0; round<original.states.size(); round++) {
+            FixedStateAsSlices state;
+            compressed.getState(round, state);
+            if (state != FixedStateAsSlices(original.states[round]))
+                return 0;
+        }
+        compressedTrails.insert(compressed);
+        if (!compressedTrails.contains(original))
+            return 0;
+    }
+    stringstream text, binary;
+    trails.save(text);
+    trails.saveBinary(binary);
+    UINT64 count = 0;
+    Trail trail;
+    while(!text.eof()) {
+        try {
+            trail.load(text);
+            count++;
+        }
+        catch(TrailException) {
+        }
+    }
+    return count;
+}
+
+static vector<TrailWorkloadDescription> getTrailWorkloads(const string& directory)
+{
+    const KeccakFPropagation::DCorLC DC = KeccakFPropagation::DC;
+    const KeccakFPropagation::DCorLC LC = KeccakFPropagation::LC;
+    struct Extension { unsigned int width; KeccakFPropagation::DCorLC DCorLC; bool forward; unsigned int nrRounds; int maxTotalWeight; UINT64 expectedCount; };
+    const Extension extensions[] = {
+        { 25, DC, true, 4, 30, 219 }, { 25, LC, true, 4, 30, 581 },
+        { 50, DC, true, 3, 36, 4 }, { 100, LC, true, 3, 36, 4 }, { 1600, LC, true, 4, 74, 1 },
+        { 25, DC, false, 4, 28, 158 }, { 25, LC, false, 4, 28, 622 },
+        { 50, DC, false, 3, 34, 48 }, { 100, LC, false, 3, 34, 2 } };
+    struct Tree { bool orbital; unsigned int width; unsigned int maxCost, alpha, beta; UINT64 expectedCount; };
+    const Tree trees[] = {
+        { true, 200, 18, 1, 1, 11966 }, { true, 1600, 14, 1, 1, 752 },
+        { false, 200, 26, 1, 2, 55692 }, { false, 1600, 24, 1, 2, 15897 } };
+    struct InKernel { unsigned int width; unsigned int maxWeight; UINT64 expectedCount; };
+    const InKernel inKernel[] = { { 100, 22, 30 }, { 200, 24, 13 } };
+    struct File { unsigned int width; KeccakFPropagation::DCorLC DCorLC; const char *suffix; UINT64 expectedCount; };
+    const File files[] = {
+        { 25, DC, "-trailcores", 7 }, { 50, DC, "-trailcores", 5 }, { 100, DC, "-trailcores", 5 },
+        { 200, DC, "-trailcores", 3 }, { 1600, DC, "-FSE2012-3round-trailcores", 63 },
+        { 1600, DC, "-FSE2012-4round-trailcores", 1 },
+        { 25, LC, "-trailcores", 7 }, { 50, LC, "-trailcores", 5 }, { 100, LC, "-trailcores", 5 },
+        { 200, LC, "-trailcores", 3 }, { 1600, LC, "-trailcores", 2 } };
+
+    vector<TrailWorkloadDescription> workloads;
+    for(const Extension& e : extensions) {
+        stringstream parameters;
+        parameters << "first trail to " << e.nrRounds << " rounds up to weight " << e.maxTotalWeight;
+        workloads.push_back({ e.forward ? "forward-extension" : "backward-extension", e.width, e.DCorLC,
+            parameters.str(), e.expectedCount,
+            [=](const KeccakFPropagation& DCorLC, SearchStatistics& statistics) {
+                return extendFirstTrail(DCorLC, statistics, directory + "/" + DCorLC.buildFileName("-trailcores"),
+                    e.forward, e.nrRounds, e.maxTotalWeight);
+            } });
+    }
+    for(const Tree& t : trees) {
+        stringstream parameters;
+        parameters << "cost " << t.alpha << "*w0+" << t.beta << "*w1 up to " << t.maxCost;
+        workloads.push_back({ t.orbital ? "orbital-tree" : "run-tree", t.width, DC, parameters.str(), t.expectedCount,
+            [=](const KeccakFPropagation& DCorLC, SearchStatistics& statistics) {
+                return t.orbital ? countOrbitalTreeNodes(DCorLC, statistics, t.maxCost, t.alpha, t.beta)
+                    : countRunTreeNodes(DCorLC, statistics, t.maxCost, t.alpha, t.beta);
+            } });
+    }
+    for(const InKernel& k : inKernel) {
+        stringstream parameters;
+        parameters << "3-round trail cores up to weight " << k.maxWeight;
+        workloads.push_back({ "in-kernel-cores", k.width, DC, parameters.str(), k.expectedCount,
+            [=](const KeccakFPropagation& DCorLC, SearchStatistics& statistics) {
+                return countTrailCoresInKernelAtC(DCorLC, statistics, k.maxWeight);
+            } });
+    }
+    for(const File& f : files) {
+        string suffix = f.suffix;
+        workloads.push_back({ "trail-io", f.width, f.DCorLC, suffix.substr(1), f.expectedCount,
+            [=](const KeccakFPropagation& DCorLC, SearchStatistics&) {
+                return readWriteTrails(DCorLC, directory + "/" + DCorLC.buildFileName(suffix));
+            } });
+    }
+    return workloads;
+}
+
+bool benchmarkTrailSearches(ostream& out, const string& exampleTrailsDirectory, double minimumTime)
+{
+    vector<TrailWorkloadDescription> workloads = getTrailWorkloads(exampleTrailsDirectory);
+    map<unsigned int, unique_ptr<KeccakFDCLC> > parents;
+    map<pair<unsigned int, KeccakFPropagation::DCorLC>, unique_ptr<KeccakFPropagation> > propagations;
+    bool allPassed = true;
+    out << "workload,width,propagation,parameters,count,expectedCount,check,repetitions,secondsPerRepetition,"
+        << "nodesPerRepetition,nodesPerSecond,trailsPerSecond,peakResidentSetSize" << endl;
+    for(const TrailWorkloadDescription& workload : workloads) {
+        unique_ptr<KeccakFDCLC>& parent = parents[workload.width];
+        if (!parent)
+            parent.reset(new KeccakFDCLC(workload.width));
+        unique_ptr<KeccakFPropagation>& DCorLC = propagations[make_pair(workload.width, workload.DCorLC)];
+        if (!DCorLC)
+            DCorLC.reset(new KeccakFPropagation(*parent, workload.DCorLC));
+
+        SearchStatistics statistics;
+        UINT64 count = 0, repetitions = 0;
+        bool passed = true;
+        double elapsed;
+        streambuf *coutBuffer = cout.rdbuf();
+        stringstream discarded;
+        cout.rdbuf(discarded.rdbuf());
+        try {
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            do {
+                count = workload.run(*DCorLC, statistics);
+                passed = passed && (count == workload.expectedCount);
+                repetitions++;
+                discarded.str("");
+                elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+            } while(elapsed < minimumTime);
+        }
+        catch(...) {
+            cout.rdbuf(coutBuffer);
+            throw;
+        }
+        cout.rdbuf(coutBuffer);
+        allPassed = allPassed && passed;
+
+        UINT64 nodes = statistics.getTotal(SearchStatistics::nodesVisited);
+        out << workload.name << "," << dec << workload.width << ","
+            << (workload.DCorLC == KeccakFPropagation::DC ? "DC" : "LC") << ","
+            << workload.parameters << "," << count << "," << workload.expectedCount << ","
+            << (passed ? "ok" : "MISMATCH") << "," << repetitions << "," << (elapsed/repetitions) << ","
+            << (nodes/repetitions) << "," << (nodes/elapsed) << ","
+            << (count*repetitions/elapsed) << "," << getPeakResidentSetSize() << endl;
+    }
+    return allPassed;
+}
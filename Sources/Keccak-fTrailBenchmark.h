@@ -0,0 +1,48 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFTRAILBENCHMARK_H_
+#define _KECCAKFTRAILBENCHMARK_H_
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+/**
+  * Function that runs fixed workloads of the trail search and trail handling code
+  * on the trail files shipped in the "Example trails" directory, measures them
+  * and checks the number of trail cores or trails they produce against known values,
+  * so that an optimization cannot silently change the results.
+  * The workloads are the forward and backward extension of the first trail of a file,
+  * the traversal of the orbital tree and of the run tree, the generation of
+  * 3-round trail cores in the kernel with TrailCoreInKernelAtC and the reading,
+  * writing and parsing back of each file, for DC and LC and for widths 25 to 1600.
+  * Each workload is repeated until it lasts at least @a minimumTime seconds.
+  * The results are output as lines of comma-separated values, starting with the line of
+  * column names, with the number of nodes visited (as counted by SearchStatistics)
+  * and of trails produced per second, and the peak resident set size of the process
+  * in bytes after the workload, or 0 if it is not available on this platform.
+  * The progress displayed by the searches on cout is discarded meanwhile.
+  *
+  * @param  out         The stream to write the results to.
+  * @param  exampleTrailsDirectory  The directory with the example trail files.
+  * @param  minimumTime The minimum duration, in seconds, of each measurement.
+  * @return Whether all the workloads produced the expected numbers of trails.
+  */
+bool benchmarkTrailSearches(ostream& out, const string& exampleTrailsDirectory = "Example trails",
+    double minimumTime = 0.05);
+
+#endif
@@ -0,0 +1,212 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "Keccak-fDCLC.h"
+#include "Keccak-fTrailCheck.h"
+
+TrailFileChecker::TrailFileChecker(const KeccakFPropagation& aDCorLC)
+    : nrThreads(thread::hardware_concurrency()), batchSize(1 << 14), maxErrors(1 << 16),
+    DCorLC(aDCorLC), nrTrails(0), nrBadTrails(0), complete(false), minWeight(0), maxWeight(0)
+{
+    if (nrThreads == 0)
+        nrThreads = 1;
+}
+
+void TrailFileChecker::addError(UINT64 index, UINT64 offset, const string& reason)
+{
+    nrBadTrails++;
+    if (errors.size() < maxErrors) {
+        TrailCheckError error;
+        error.index = index;
+        error.offset = offset;
+        error.reason = reason;
+        errors.push_back(error);
+    }
+}
+
+void TrailFileChecker::checkBatch(vector<Trail>& trails, const vector<UINT64>& offsets, UINT64 firstIndex)
+{
+    vector<vector<string> > reasons(trails.size());
+    const unsigned int chunkSize = 256;
+    const unsigned int nrChunks = (unsigned int)((trails.size() + chunkSize - 1)/chunkSize);
+    atomic<unsigned int> next(0);
+    exception_ptr failure;
+    mutex lock;
+    vector<thread> workers;
+    for(unsigned int t=0; t<min(nrThreads, nrChunks); t++)
+        workers.push_back(thread([&]() {
+            try {
+                for(unsigned int k=next++; k<nrChunks; k=next++)
+                    for(size_t i=k*chunkSize; (i<(size_t)(k+1)*chunkSize) && (i<trails.size()); i++)
+                        DCorLC.parent.checkTrail(trails[i], DCorLC, reasons[i]);
+            }
+            catch(...) {
+                lock_guard<mutex> guard(lock);
+                if (!failure)
+                    failure = current_exception();
+                next = nrChunks;
+            }
+        }));
+    for(unsigned int t=0; t<workers.size(); t++)
+        workers[t].join();
+    if (failure)
+        rethrow_exception(failure);
+    for(size_t i=0; i<trails.size(); i++) {
+        const Trail& trail = trails[i];
+        if (nrTrails == 0)
+            minWeight = maxWeight = trail.totalWeight;
+        else {
+            minWeight = min(minWeight, trail.totalWeight);
+            maxWeight = max(maxWeight, trail.totalWeight);
+        }
+        nrTrails++;
+        nrTrailsPerNumberOfRounds[trail.getNumberOfRounds()]++;
+        if (!reasons[i].empty()) {
+            string reason = reasons[i][0];
+            for(unsigned int j=1; j<reasons[i].size(); j++)
+                reason += " " + reasons[i][j];
+            addError(firstIndex + i, offsets[i], reason);
+        }
+    }
+    trails.clear();
+}
+
+UINT64 TrailFileChecker::check(const string& aFileName)
+{
+    fileName = aFileName;
+    nrTrails = 0;
+    nrBadTrails = 0;
+    complete = false;
+    errors.clear();
+    nrTrailsPerNumberOfRounds.clear();
+    minWeight = maxWeight = 0;
+
+    vector<Trail> trails;
+    vector<UINT64> offsets;
+    UINT64 index = 0;
+    if (Trail::isBinaryFile(fileName)) {
+        TrailBinaryFile file(fileName);
+        const UINT8 *start = file.begin() - TrailBinaryFile::headerSize;
+        const UINT8 *data = file.begin();
+        while(true) {
+            if ((trails.size() >= batchSize) || (data >= file.end())) {
+                checkBatch(trails, offsets, index - trails.size());
+                offsets.clear();
+                if (data >= file.end())
+                    break;
+            }
+            UINT64 offset = data - start;
+            if (!TrailBinaryFile::isRecordComplete(data, file.end())) {
+                checkBatch(trails, offsets, index - trails.size());
+                addError(index, offset, "The record is truncated.");
+                return nrBadTrails;
+            }
+            const UINT8 *next = TrailBinaryFile::skipRecord(data);
+            trails.push_back(Trail());
+            offsets.push_back(offset);
+            try {
+                trails.back().loadBinary(data, next);
+            }
+            catch(TrailException& e) {
+                // The record has a valid length, so the next ones can still be read.
+                trails.pop_back();
+                offsets.pop_back();
+                checkBatch(trails, offsets, index - trails.size());
+                offsets.clear();
+                addError(index, offset, "The record cannot be decoded: " + e.reason);
+                nrTrails++;
+            }
+            data = next;
+            index++;
+        }
+    }
+    else {
+        // Each trail is on its own line, so a line that cannot be read does not affect the next ones.
+        ifstream fin(fileName.c_str(), ios::in | ios::binary);
+        if (!fin)
+            throw TrailException((string)"File '" + fileName + (string)"' cannot be read.");
+        string line;
+        UINT64 offset = 0;
+        while(true) {
+            if (trails.size() >= batchSize) {
+                checkBatch(trails, offsets, index - trails.size());
+                offsets.clear();
+            }
+            UINT64 lineOffset = offset;
+            if (!getline(fin, line))
+                break;
+            offset += line.size() + 1;
+            if (line.find_first_not_of(" \t\r") == string::npos)
+                continue;
+            istringstream sin(line);
+            Trail trail;
+            string reason;
+            try {
+                trail.load(sin);
+                string extra;
+                if (sin.fail())
+                    reason = "The trail is incomplete.";
+                else if (sin >> extra)
+                    reason = "The line contains data after the trail.";
+            }
+            catch(TrailException&) {
+                reason = "The trail cannot be read.";
+            }
+            if (reason.empty()) {
+                trails.push_back(trail);
+                offsets.push_back(lineOffset);
+            }
+            else {
+                checkBatch(trails, offsets, index - trails.size());
+                offsets.clear();
+                addError(index, lineOffset, reason);
+                nrTrails++;
+            }
+            index++;
+        }
+        checkBatch(trails, offsets, index - trails.size());
+    }
+    complete = true;
+    return nrBadTrails;
+}
+
+void TrailFileChecker::displaySummary(ostream& fout) const
+{
+    fout << "File " << fileName << ": " << dec << nrTrails << " " << DCorLC.name << " trails checked";
+    if (!complete)
+        fout << " before an unreadable record";
+    fout << ", " << nrBadTrails << " bad" << endl;
+    if (nrTrails > 0) {
+        fout << "Total weights from " << minWeight << " to " << maxWeight << endl;
+        for(map<unsigned int, UINT64>::const_iterator i=nrTrailsPerNumberOfRounds.begin(); i!=nrTrailsPerNumberOfRounds.end(); ++i)
+            fout << i->second << " trail(s) of " << i->first << " round(s)" << endl;
+    }
+    if (nrBadTrails > errors.size())
+        fout << "Only the first " << errors.size() << " bad trails are listed." << endl;
+}
+
+void TrailFileChecker::saveErrors(ostream& fout) const
+{
+    for(unsigned int i=0; i<errors.size(); i++)
+        fout << dec << errors[i].index << " " << errors[i].offset << " " << errors[i].reason << endl;
+}
@@ -0,0 +1,94 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFTRAILCHECK_H_
+#define _KECCAKFTRAILCHECK_H_
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "Keccak-fPropagation.h"
+#include "Keccak-fTrails.h"
+
+using namespace std;
+
+/** This structure describes an inconsistent or unreadable trail found by TrailFileChecker. */
+struct TrailCheckError {
+    /** The index of the trail in the file, starting from 0. */
+    UINT64 index;
+    /** The offset in bytes of the trail in the file. */
+    UINT64 offset;
+    /** The description of the inconsistency. */
+    string reason;
+};
+
+/** This class checks all the trails of a file, in the binary trail format or in the text format,
+  * with KeccakFDCLC::checkTrail(): their propagation through χ between consecutive rounds
+  * and their weights are verified, for DC or LC trails.
+  * The file is read in batches, whose trails are checked in parallel by several threads.
+  * Instead of stopping at the first inconsistency, the checker counts the bad trails
+  * and lists them with their offset in the file. A trail that cannot be read counts as bad;
+  * in a text file, the next line is read next, while in a binary file,
+  * a truncated record ends the check, as the following ones cannot be located.
+  */
+class TrailFileChecker {
+public:
+    /** The number of threads used by check(). */
+    unsigned int nrThreads;
+    /** The number of trails read before they are checked in parallel. */
+    unsigned int batchSize;
+    /** The maximum number of errors kept in the list, to bound the memory used; all are counted. */
+    UINT64 maxErrors;
+protected:
+    const KeccakFPropagation& DCorLC;
+    string fileName;
+    UINT64 nrTrails, nrBadTrails;
+    bool complete;
+    vector<TrailCheckError> errors;
+    map<unsigned int, UINT64> nrTrailsPerNumberOfRounds;
+    unsigned int minWeight, maxWeight;
+public:
+    /** The constructor.
+      * @param   aDCorLC    The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      */
+    TrailFileChecker(const KeccakFPropagation& aDCorLC);
+    /** This method checks the trails of a file.
+      * @param  aFileName   The name of the file.
+      * @return The number of bad trails, including an unreadable record.
+      */
+    UINT64 check(const string& aFileName);
+    /** This method returns the number of trails read by the last check, including those that cannot be decoded. */
+    UINT64 getNumberOfTrails() const { return nrTrails; }
+    /** This method returns the number of bad trails found by the last check. */
+    UINT64 getNumberOfBadTrails() const { return nrBadTrails; }
+    /** This method tells whether the last check read the file until its end. */
+    bool isComplete() const { return complete; }
+    /** This method returns the bad trails found by the last check, by increasing offset,
+      * up to maxErrors of them. */
+    const vector<TrailCheckError>& getErrors() const { return errors; }
+    /** This method displays a summary of the last check. */
+    void displaySummary(ostream& fout) const;
+    /** This method outputs the bad trails, one per line as the index, the offset and the reasons.
+      * @param  fout    The stream to output the list to.
+      */
+    void saveErrors(ostream& fout) const;
+protected:
+    void checkBatch(vector<Trail>& trails, const vector<UINT64>& offsets, UINT64 firstIndex);
+    void addError(UINT64 index, UINT64 offset, const string& reason);
+};
+
+#endif
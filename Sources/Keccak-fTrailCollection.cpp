@@ -0,0 +1,666 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <fstream>
+#include "Keccak-fTrailCollection.h"
+
+using namespace std;
+
+// -------------------------------------------------------------
+//
+// TrailView
+//
+// -------------------------------------------------------------
+
+bool TrailView::isTrailCore() const
+{
+    return (collection->flags[index] & 1) != 0;
+}
+
+bool TrailView::isStateAfterLastChiSpecified() const
+{
+    return (collection->flags[index] & 2) != 0;
+}
+
+unsigned int TrailView::getLaneSize() const
+{
+    return collection->laneSizes[index];
+}
+
+unsigned int TrailView::getNumberOfRounds() const
+{
+    return (unsigned int)(collection->weightBegin[index+1] - collection->weightBegin[index]);
+}
+
+unsigned int TrailView::getTotalWeight() const
+{
+    return collection->totalWeights[index];
+}
+
+unsigned int TrailView::getWeight(unsigned int round) const
+{
+    return collection->weights[collection->weightBegin[index] + round];
+}
+
+UINT64 TrailView::getStoredStateIndex(unsigned int round) const
+{
+    if (isTrailCore() && (round == 0))
+        throw TrailException("The first state of a trail core is not specified.");
+    return collection->stateBegin[index] + round - (isTrailCore() ? 1 : 0);
+}
+
+unsigned int TrailView::getNumberOfActiveSlices(unsigned int round) const
+{
+    UINT64 j = getStoredStateIndex(round);
+    return (unsigned int)(collection->sliceBegin[j+1] - collection->sliceBegin[j]);
+}
+
+const UINT8 *TrailView::getActiveSliceIndexes(unsigned int round) const
+{
+    return collection->sliceIndexes.data() + collection->sliceBegin[getStoredStateIndex(round)];
+}
+
+const SliceValue *TrailView::getActiveSliceValues(unsigned int round) const
+{
+    return collection->sliceValues.data() + collection->sliceBegin[getStoredStateIndex(round)];
+}
+
+void TrailView::getStoredState(UINT64 j, SliceValue *state) const
+{
+    unsigned int laneSize = getLaneSize();
+    for(unsigned int z=0; z<laneSize; z++)
+        state[z] = 0;
+    for(UINT64 k=collection->sliceBegin[j]; k<collection->sliceBegin[j+1]; k++)
+        state[collection->sliceIndexes[k]] = collection->sliceValues[k];
+}
+
+void TrailView::getState(unsigned int round, vector<SliceValue>& state) const
+{
+    if (isTrailCore() && (round == 0)) {
+        state.clear();
+        return;
+    }
+    state.resize(getLaneSize());
+    getStoredState(getStoredStateIndex(round), state.data());
+}
+
+void TrailView::getState(unsigned int round, FixedStateAsSlices& state) const
+{
+    if (isTrailCore() && (round == 0)) {
+        state.resize(0);
+        return;
+    }
+    state.resize(getLaneSize());
+    getStoredState(getStoredStateIndex(round), state.data());
+}
+
+void TrailView::getStateAfterLastChi(vector<SliceValue>& state) const
+{
+    if (!isStateAfterLastChiSpecified()) {
+        state.clear();
+        return;
+    }
+    state.resize(getLaneSize());
+    getStoredState(collection->stateBegin[index+1] - 1, state.data());
+}
+
+void TrailView::get(Trail& trail) const
+{
+    unsigned int nrRounds = getNumberOfRounds();
+    trail.firstStateSpecified = !isTrailCore();
+    trail.stateAfterLastChiSpecified = isStateAfterLastChiSpecified();
+    trail.totalWeight = getTotalWeight();
+    trail.weights.resize(nrRounds);
+    trail.states.resize(nrRounds);
+    for(unsigned int i=0; i<nrRounds; i++) {
+        trail.weights[i] = getWeight(i);
+        getState(i, trail.states[i]);
+    }
+    getStateAfterLastChi(trail.stateAfterLastChi);
+}
+
+// -------------------------------------------------------------
+//
+// TrailCollection
+//
+// -------------------------------------------------------------
+
+TrailCollection::TrailCollection()
+{
+    clear();
+}
+
+void TrailCollection::clear()
+{
+    weightBegin.assign(1, 0);
+    stateBegin.assign(1, 0);
+    totalWeights.clear();
+    laneSizes.clear();
+    flags.clear();
+    weights.clear();
+    sliceBegin.assign(1, 0);
+    sliceIndexes.clear();
+    sliceValues.clear();
+}
+
+void TrailCollection::reserve(UINT64 nrTrails, unsigned int nrRounds, unsigned int nrActiveSlicesPerState)
+{
+    weightBegin.reserve(nrTrails + 1);
+    stateBegin.reserve(nrTrails + 1);
+    totalWeights.reserve(nrTrails);
+    laneSizes.reserve(nrTrails);
+    flags.reserve(nrTrails);
+    weights.reserve(nrTrails*nrRounds);
+    sliceBegin.reserve(nrTrails*nrRounds + 1);
+    sliceIndexes.reserve(nrTrails*nrRounds*nrActiveSlicesPerState);
+    sliceValues.reserve(nrTrails*nrRounds*nrActiveSlicesPerState);
+}
+
+void TrailCollection::shrinkToFit()
+{
+    weightBegin.shrink_to_fit();
+    stateBegin.shrink_to_fit();
+    totalWeights.shrink_to_fit();
+    laneSizes.shrink_to_fit();
+    flags.shrink_to_fit();
+    weights.shrink_to_fit();
+    sliceBegin.shrink_to_fit();
+    sliceIndexes.shrink_to_fit();
+    sliceValues.shrink_to_fit();
+}
+
+UINT64 TrailCollection::getMemoryUsage() const
+{
+    return weightBegin.capacity()*sizeof(UINT64) + stateBegin.capacity()*sizeof(UINT64)
+        + totalWeights.capacity()*sizeof(UINT32) + laneSizes.capacity()*sizeof(UINT16)
+        + flags.capacity()*sizeof(UINT8) + weights.capacity()*sizeof(UINT32)
+        + sliceBegin.capacity()*sizeof(UINT64) + sliceIndexes.capacity()*sizeof(UINT8)
+        + sliceValues.capacity()*sizeof(SliceValue);
+}
+
+void TrailCollection::appendState(const vector<SliceValue>& state)
+{
+    for(unsigned int z=0; z<state.size(); z++)
+        if (state[z] != 0) {
+            sliceIndexes.push_back((UINT8)z);
+            sliceValues.push_back(state[z]);
+        }
+    sliceBegin.push_back(sliceIndexes.size());
+}
+
+UINT64 TrailCollection::append(const Trail& trail)
+{
+    unsigned int laneSize = 0;
+    if (trail.states.size() > 1)
+        laneSize = trail.states[1].size();
+    else if (trail.states.size() > 0)
+        laneSize = trail.states[0].size();
+    if (laneSize > 256)
+        throw TrailException("TrailCollection::append(): the lane size is too large.");
+    totalWeights.push_back(trail.totalWeight);
+    laneSizes.push_back((UINT16)laneSize);
+    flags.push_back((trail.firstStateSpecified ? 0 : 1) ^ (trail.stateAfterLastChiSpecified ? 2 : 0));
+    weights.insert(weights.end(), trail.weights.begin(), trail.weights.end());
+    weightBegin.push_back(weights.size());
+    for(unsigned int i=(trail.firstStateSpecified ? 0 : 1); i<trail.states.size(); i++)
+        appendState(trail.states[i]);
+    if (trail.stateAfterLastChiSpecified)
+        appendState(trail.stateAfterLastChi);
+    stateBegin.push_back(sliceBegin.size() - 1);
+    return size() - 1;
+}
+
+void TrailCollection::fetchTrail(const Trail& trail)
+{
+    append(trail);
+}
+
+static UINT32 readUINT(const UINT8*& data, const UINT8 *end, unsigned int nrBytes)
+{
+    if ((size_t)(end - data) < nrBytes)
+        throw TrailException("The binary trail record is truncated.");
+    UINT32 value = 0;
+    for(unsigned int i=0; i<nrBytes; i++)
+        value ^= (UINT32)data[i] << (8*i);
+    data += nrBytes;
+    return value;
+}
+
+static void writeUINT(ostream& fout, UINT32 value, unsigned int nrBytes)
+{
+    char bytes[4];
+    for(unsigned int i=0; i<nrBytes; i++)
+        bytes[i] = (char)((value >> (8*i)) & 0xFF);
+    fout.write(bytes, nrBytes);
+}
+
+UINT64 TrailCollection::appendBinary(const UINT8*& data, const UINT8 *end)
+{
+    const UINT8 *position = data;
+    UINT32 length = readUINT(position, end, 4);
+    if ((size_t)(end - position) < length)
+        throw TrailException("The binary trail record is truncated.");
+    const UINT8 *recordEnd = position + length;
+    size_t previousNrWeights = weights.size();
+    size_t previousNrStates = sliceBegin.size();
+    size_t previousNrSlices = sliceIndexes.size();
+    try {
+        unsigned int recordFlags = readUINT(position, recordEnd, 1);
+        readUINT(position, recordEnd, 1);
+        unsigned int laneSize = readUINT(position, recordEnd, 2);
+        UINT32 totalWeight = readUINT(position, recordEnd, 4);
+        unsigned int nrWeights = readUINT(position, recordEnd, 4);
+        if ((size_t)(recordEnd - position) < 4*(size_t)nrWeights)
+            throw TrailException("The binary trail record is truncated.");
+        for(unsigned int i=0; i<nrWeights; i++)
+            weights.push_back(readUINT(position, recordEnd, 4));
+        // The state after the last χ, if specified, follows the states counted in the record.
+        unsigned int nrStates = readUINT(position, recordEnd, 4);
+        if ((recordFlags & 2) != 0)
+            nrStates++;
+        if ((size_t)(recordEnd - position) < (size_t)nrStates)
+            throw TrailException("The binary trail record is truncated.");
+        for(unsigned int i=0; i<nrStates; i++) {
+            unsigned int nrActiveSlices = readUINT(position, recordEnd, 1);
+            if ((size_t)(recordEnd - position) < 5*(size_t)nrActiveSlices)
+                throw TrailException("The binary trail record is truncated.");
+            for(unsigned int j=0; j<nrActiveSlices; j++) {
+                unsigned int z = readUINT(position, recordEnd, 1);
+                if (z >= laneSize)
+                    throw TrailException("The binary trail record contains an invalid slice index.");
+                sliceIndexes.push_back((UINT8)z);
+                sliceValues.push_back(readUINT(position, recordEnd, 4));
+            }
+            sliceBegin.push_back(sliceIndexes.size());
+        }
+        if (position != recordEnd)
+            throw TrailException("The binary trail record has an inconsistent length.");
+        totalWeights.push_back(totalWeight);
+        laneSizes.push_back((UINT16)laneSize);
+        flags.push_back((UINT8)(recordFlags & 3));
+        weightBegin.push_back(weights.size());
+        stateBegin.push_back(sliceBegin.size() - 1);
+    }
+    catch(...) {
+        weights.resize(previousNrWeights);
+        sliceBegin.resize(previousNrStates);
+        sliceIndexes.resize(previousNrSlices);
+        sliceValues.resize(previousNrSlices);
+        throw;
+    }
+    data = recordEnd;
+    return size() - 1;
+}
+
+UINT64 TrailCollection::load(const string& fileName)
+{
+    UINT64 count = 0;
+    if (Trail::isBinaryFile(fileName)) {
+        TrailBinaryFile file(fileName);
+        for(const UINT8 *data = file.begin(); TrailBinaryFile::isRecordComplete(data, file.end()); count++)
+            appendBinary(data, file.end());
+    }
+    else {
+        ifstream fin(fileName.c_str());
+        if (!fin)
+            throw TrailException((string)"File '" + fileName + (string)"' cannot be read.");
+        while(!(fin.eof())) {
+            Trail trail;
+            try {
+                trail.load(fin);
+            }
+            catch(TrailException) {
+                if (!fin)
+                    break;
+                continue;
+            }
+            append(trail);
+            count++;
+        }
+    }
+    return count;
+}
+
+void TrailCollection::saveBinary(ostream& fout) const
+{
+    Trail::saveBinaryHeader(fout);
+    for(UINT64 i=0; i<size(); i++) {
+        UINT64 nrWeights = weightBegin[i+1] - weightBegin[i];
+        UINT64 nrStates = stateBegin[i+1] - stateBegin[i];
+        UINT64 nrActiveSlices = sliceBegin[stateBegin[i+1]] - sliceBegin[stateBegin[i]];
+        UINT32 length = (UINT32)(1 + 1 + 2 + 4 + 4 + 4*nrWeights + 4 + nrStates + 5*nrActiveSlices);
+        writeUINT(fout, length, 4);
+        writeUINT(fout, flags[i], 1);
+        writeUINT(fout, 0, 1);
+        writeUINT(fout, laneSizes[i], 2);
+        writeUINT(fout, totalWeights[i], 4);
+        writeUINT(fout, (UINT32)nrWeights, 4);
+        for(UINT64 k=weightBegin[i]; k<weightBegin[i+1]; k++)
+            writeUINT(fout, weights[k], 4);
+        // The state after the last χ, if specified, is the last stored state but is not counted.
+        writeUINT(fout, (UINT32)(nrStates - ((flags[i] & 2) ? 1 : 0)), 4);
+        for(UINT64 j=stateBegin[i]; j<stateBegin[i+1]; j++) {
+            writeUINT(fout, (UINT32)(sliceBegin[j+1] - sliceBegin[j]), 1);
+            for(UINT64 k=sliceBegin[j]; k<sliceBegin[j+1]; k++) {
+                writeUINT(fout, sliceIndexes[k], 1);
+                writeUINT(fout, sliceValues[k], 4);
+            }
+        }
+    }
+}
+
+void TrailCollection::save(ostream& fout) const
+{
+    Trail trail;
+    for(UINT64 i=0; i<size(); i++) {
+        get(i, trail);
+        trail.save(fout);
+    }
+}
+
+// -------------------------------------------------------------
+//
+// CompressedTrail
+//
+// -------------------------------------------------------------
+
+static void appendVarUINT(vector<UINT8>& data, UINT32 value)
+{
+    while(value >= 0x80) {
+        data.push_back((UINT8)(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back((UINT8)value);
+}
+
+static UINT32 readVarUINT(const UINT8*& data)
+{
+    UINT32 value = 0;
+    for(unsigned int shift=0; ; shift+=7) {
+        UINT8 byte = *(data++);
+        value |= (UINT32)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+}
+
+static void appendCompressedState(vector<UINT8>& data, const vector<SliceValue>& state)
+{
+    unsigned int nrActiveSlices = 0;
+    for(unsigned int z=0; z<state.size(); z++)
+        if (state[z] != 0)
+            nrActiveSlices++;
+    appendVarUINT(data, nrActiveSlices);
+    unsigned int previousZ = 0;
+    for(unsigned int z=0; z<state.size(); z++)
+        if (state[z] != 0) {
+            appendVarUINT(data, z - previousZ);
+            appendVarUINT(data, state[z]);
+            previousZ = z;
+        }
+}
+
+static void readCompressedState(const UINT8*& data, SliceValue *state, unsigned int laneSize)
+{
+    for(unsigned int z=0; z<laneSize; z++)
+        state[z] = 0;
+    unsigned int nrActiveSlices = readVarUINT(data);
+    unsigned int z = 0;
+    for(unsigned int i=0; i<nrActiveSlices; i++) {
+        z += readVarUINT(data);
+        state[z] = readVarUINT(data);
+    }
+}
+
+static void skipCompressedState(const UINT8*& data)
+{
+    unsigned int nrActiveSlices = readVarUINT(data);
+    for(unsigned int i=0; i<2*nrActiveSlices; i++)
+        while((*(data++) & 0x80) != 0) ;
+}
+
+void CompressedTrail::set(const Trail& trail)
+{
+    unsigned int laneSize = 0;
+    if (trail.states.size() > 1)
+        laneSize = trail.states[1].size();
+    else if (trail.states.size() > 0)
+        laneSize = trail.states[0].size();
+    if (laneSize > FixedStateAsSlices::maxLaneSize)
+        throw TrailException("CompressedTrail::set(): the lane size is too large.");
+    data.clear();
+    data.push_back((UINT8)((trail.firstStateSpecified ? 0 : 1) ^ (trail.stateAfterLastChiSpecified ? 2 : 0)));
+    appendVarUINT(data, laneSize);
+    appendVarUINT(data, trail.totalWeight);
+    appendVarUINT(data, (UINT32)trail.weights.size());
+    for(unsigned int i=0; i<trail.weights.size(); i++)
+        appendVarUINT(data, trail.weights[i]);
+    for(unsigned int i=(trail.firstStateSpecified ? 0 : 1); i<trail.states.size(); i++)
+        appendCompressedState(data, trail.states[i]);
+    if (trail.stateAfterLastChiSpecified)
+        appendCompressedState(data, trail.stateAfterLastChi);
+    data.shrink_to_fit();
+}
+
+const UINT8 *CompressedTrail::getFirstState(unsigned int& laneSize, unsigned int& nrWeights) const
+{
+    const UINT8 *position = data.data() + 1;
+    laneSize = readVarUINT(position);
+    readVarUINT(position);
+    nrWeights = readVarUINT(position);
+    for(unsigned int i=0; i<nrWeights; i++)
+        readVarUINT(position);
+    return position;
+}
+
+void CompressedTrail::get(Trail& trail) const
+{
+    unsigned int laneSize, nrRounds;
+    const UINT8 *position = getFirstState(laneSize, nrRounds);
+    trail.firstStateSpecified = !isTrailCore();
+    trail.stateAfterLastChiSpecified = isStateAfterLastChiSpecified();
+    trail.totalWeight = getTotalWeight();
+    trail.weights.resize(nrRounds);
+    const UINT8 *weights = data.data() + 1;
+    for(unsigned int i=0; i<3; i++)
+        readVarUINT(weights);
+    for(unsigned int i=0; i<nrRounds; i++)
+        trail.weights[i] = readVarUINT(weights);
+    trail.states.resize(nrRounds);
+    for(unsigned int i=0; i<nrRounds; i++) {
+        if (isTrailCore() && (i == 0))
+            trail.states[i].clear();
+        else {
+            trail.states[i].resize(laneSize);
+            readCompressedState(position, trail.states[i].data(), laneSize);
+        }
+    }
+    if (isStateAfterLastChiSpecified()) {
+        trail.stateAfterLastChi.resize(laneSize);
+        readCompressedState(position, trail.stateAfterLastChi.data(), laneSize);
+    }
+    else
+        trail.stateAfterLastChi.clear();
+}
+
+unsigned int CompressedTrail::getLaneSize() const
+{
+    const UINT8 *position = data.data() + 1;
+    return readVarUINT(position);
+}
+
+unsigned int CompressedTrail::getTotalWeight() const
+{
+    const UINT8 *position = data.data() + 1;
+    readVarUINT(position);
+    return readVarUINT(position);
+}
+
+unsigned int CompressedTrail::getNumberOfRounds() const
+{
+    const UINT8 *position = data.data() + 1;
+    readVarUINT(position);
+    readVarUINT(position);
+    return readVarUINT(position);
+}
+
+unsigned int CompressedTrail::getWeight(unsigned int round) const
+{
+    const UINT8 *position = data.data() + 1;
+    readVarUINT(position);
+    readVarUINT(position);
+    readVarUINT(position);
+    for(unsigned int i=0; i<round; i++)
+        readVarUINT(position);
+    return readVarUINT(position);
+}
+
+void CompressedTrail::getState(unsigned int round, FixedStateAsSlices& state) const
+{
+    if (isTrailCore() && (round == 0)) {
+        state.resize(0);
+        return;
+    }
+    unsigned int laneSize, nrRounds;
+    const UINT8 *position = getFirstState(laneSize, nrRounds);
+    if (round >= nrRounds)
+        throw TrailException("CompressedTrail::getState(): the round index is out of range.");
+    for(unsigned int i=(isTrailCore() ? 1 : 0); i<round; i++)
+        skipCompressedState(position);
+    state.resize(laneSize);
+    readCompressedState(position, state.data(), laneSize);
+}
+
+UINT64 CompressedTrail::getHash() const
+{
+    // FNV-1a
+    UINT64 hash = 0xCBF29CE484222325ULL;
+    for(size_t i=0; i<data.size(); i++)
+        hash = (hash ^ data[i]) * 0x100000001B3ULL;
+    return hash;
+}
+
+// -------------------------------------------------------------
+//
+// CompressedTrailSet
+//
+// -------------------------------------------------------------
+
+bool CompressedTrailSet::insert(const Trail& trail)
+{
+    return insert(CompressedTrail(trail));
+}
+
+bool CompressedTrailSet::insert(const CompressedTrail& trail)
+{
+    if (!trails.insert(trail).second)
+        return false;
+    nrBytes += trail.getSize();
+    return true;
+}
+
+bool CompressedTrailSet::contains(const Trail& trail) const
+{
+    return trails.count(CompressedTrail(trail)) != 0;
+}
+
+void CompressedTrailSet::fetchTrail(const Trail& trail)
+{
+    insert(trail);
+}
+
+// -------------------------------------------------------------
+//
+// TrailCollectionIterator
+//
+// -------------------------------------------------------------
+
+TrailCollectionIterator::TrailCollectionIterator(const TrailCollection& aCollection, const KeccakFPropagation& aDCorLC)
+    : TrailIterator(aDCorLC), collection(aCollection)
+{
+    initialize();
+    next();
+}
+
+TrailCollectionIterator::TrailCollectionIterator(const TrailCollection& aCollection, const KeccakFPropagation& aDCorLC, TrailFilter *aFilter)
+    : TrailIterator(aDCorLC, aFilter), collection(aCollection)
+{
+    initialize();
+    next();
+}
+
+void TrailCollectionIterator::initialize()
+{
+    position = 0;
+    i = 0;
+    if (filter) {
+        count = 0;
+        Trail trail;
+        for(UINT64 k=0; k<collection.size(); k++) {
+            collection.get(k, trail);
+            if (filter->filter(DCorLC, trail))
+                count++;
+        }
+    }
+    else
+        count = collection.size();
+}
+
+void TrailCollectionIterator::next()
+{
+    while(position < collection.size()) {
+        collection.get(position, current);
+        position++;
+        if ((!filter) || filter->filter(DCorLC, current))
+            return;
+    }
+    position = collection.size() + 1;
+}
+
+bool TrailCollectionIterator::isEnd()
+{
+    return position > collection.size();
+}
+
+bool TrailCollectionIterator::isEmpty()
+{
+    return count == 0;
+}
+
+void TrailCollectionIterator::operator++()
+{
+    next();
+    i++;
+}
+
+const Trail& TrailCollectionIterator::operator*()
+{
+    return current;
+}
+
+bool TrailCollectionIterator::isBounded()
+{
+    return true;
+}
+
+UINT64 TrailCollectionIterator::getIndex()
+{
+    return i;
+}
+
+UINT64 TrailCollectionIterator::getCount()
+{
+    return count;
+}
@@ -0,0 +1,350 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFTRAILCOLLECTION_H_
+#define _KECCAKFTRAILCOLLECTION_H_
+
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "Keccak-fParts.h"
+#include "Keccak-fTrails.h"
+
+using namespace std;
+
+class TrailCollection;
+
+/** This class gives read-only access to a trail stored in a TrailCollection,
+  * without decoding it into a Trail object.
+  * The rounds are numbered as in Trail::states, so for a trail core,
+  * the state of round 0 is not specified.
+  * A view remains valid as long as the collection is not modified.
+  */
+class TrailView {
+protected:
+    const TrailCollection *collection;
+    UINT64 index;
+public:
+    /** The constructor.
+      * @param  aCollection The collection containing the trail.
+      * @param  aIndex  The index of the trail in the collection.
+      */
+    TrailView(const TrailCollection& aCollection, UINT64 aIndex)
+        : collection(&aCollection), index(aIndex) {}
+    /** This method returns the index of the trail in its collection. */
+    UINT64 getIndex() const { return index; }
+    /** This method tells whether the trail is a trail core, i.e., whether
+      * its first state is not specified, see Trail::firstStateSpecified. */
+    bool isTrailCore() const;
+    /** This method tells whether the state after the last χ is specified,
+      * see Trail::stateAfterLastChiSpecified. */
+    bool isStateAfterLastChiSpecified() const;
+    /** This method returns the number of slices of the states. */
+    unsigned int getLaneSize() const;
+    /** This method returns the number of rounds of the trail. */
+    unsigned int getNumberOfRounds() const;
+    /** This method returns the total weight of the trail. */
+    unsigned int getTotalWeight() const;
+    /** This method returns the weight of a given round, see Trail::weights. */
+    unsigned int getWeight(unsigned int round) const;
+    /** This method returns the number of active slices in the state of a given round.
+      * @param  round   The round index, which must not be 0 for a trail core.
+      */
+    unsigned int getNumberOfActiveSlices(unsigned int round) const;
+    /** This method returns the z coordinates of the active slices in the state
+      * of a given round, by increasing value.
+      * @param  round   The round index, which must not be 0 for a trail core.
+      * @return A pointer to getNumberOfActiveSlices(round) z coordinates.
+      */
+    const UINT8 *getActiveSliceIndexes(unsigned int round) const;
+    /** This method returns the values of the active slices in the state
+      * of a given round, in the same order as getActiveSliceIndexes().
+      * @param  round   The round index, which must not be 0 for a trail core.
+      * @return A pointer to getNumberOfActiveSlices(round) slice values.
+      */
+    const SliceValue *getActiveSliceValues(unsigned int round) const;
+    /** This method decodes the state of a given round.
+      * For round 0 of a trail core, the state is empty, as in Trail::states.
+      * @param  round   The round index.
+      * @param  state   The state as a vector of slices.
+      */
+    void getState(unsigned int round, vector<SliceValue>& state) const;
+    /** This method is the same as getState(unsigned int, vector<SliceValue>&)
+      * with a state of type FixedStateAsSlices, without memory allocation.
+      */
+    void getState(unsigned int round, FixedStateAsSlices& state) const;
+    /** This method decodes the state after the last χ, or gives an empty state if it is not specified.
+      * @param  state   The state as a vector of slices.
+      */
+    void getStateAfterLastChi(vector<SliceValue>& state) const;
+    /** This method decodes the whole trail.
+      * @param  trail   The trail.
+      */
+    void get(Trail& trail) const;
+protected:
+    UINT64 getStoredStateIndex(unsigned int storedState) const;
+    void getStoredState(UINT64 stateIndex, SliceValue *state) const;
+};
+
+/** This class stores many trails compactly in memory.
+  * Instead of the separate vectors of a Trail object, the trails are stored
+  * one after the other in a few large arrays,
+  * in the spirit of the binary trail format, see Trail::saveBinary():
+  * - per trail, its total weight, lane size and flags, and the offsets of its weights and states;
+  * - the weights of all the trails together;
+  * - the states of all the trails together, encoded sparsely as the offset of their active slices,
+  *     whose z coordinates and values are kept in two separate arrays.
+  * So, storing a trail only costs a few bytes plus 5 bytes per active slice,
+  * and there is no memory allocation per trail.
+  * A trail is accessed through a TrailView, or decoded into a Trail with get().
+  * Trails can be added from Trail objects, as a TrailFetcher, or directly
+  * from the records of a file in the binary trail format.
+  */
+class TrailCollection : public TrailFetcher {
+protected:
+    /** For trail i, the weights are weights[weightBegin[i]] to weights[weightBegin[i+1]-1]. */
+    vector<UINT64> weightBegin;
+    /** For trail i, the states are stored with indexes stateBegin[i] to stateBegin[i+1]-1,
+      * without the first state of a trail core, and followed by the state after the last χ if specified. */
+    vector<UINT64> stateBegin;
+    vector<UINT32> totalWeights;
+    vector<UINT16> laneSizes;
+    /** For each trail, bit 0 is set for a trail core, and bit 1 when the state after the last χ is specified,
+      * as in the binary trail format. */
+    vector<UINT8> flags;
+    vector<UINT32> weights;
+    /** For state j, the active slices are sliceIndexes[sliceBegin[j]] to sliceIndexes[sliceBegin[j+1]-1],
+      * and similarly for sliceValues. */
+    vector<UINT64> sliceBegin;
+    vector<UINT8> sliceIndexes;
+    vector<SliceValue> sliceValues;
+    friend class TrailView;
+public:
+    /** The constructor of an empty collection. */
+    TrailCollection();
+    /** This method returns the number of trails. */
+    UINT64 size() const { return totalWeights.size(); }
+    /** This method tells whether the collection is empty. */
+    bool empty() const { return totalWeights.empty(); }
+    /** This method removes all the trails. */
+    void clear();
+    /** This method reserves memory for a number of trails.
+      * @param  nrTrails    The expected number of trails.
+      * @param  nrRounds    The expected number of rounds per trail.
+      * @param  nrActiveSlicesPerState  The expected number of active slices per state.
+      */
+    void reserve(UINT64 nrTrails, unsigned int nrRounds, unsigned int nrActiveSlicesPerState);
+    /** This method frees the memory reserved but not used. */
+    void shrinkToFit();
+    /** This method returns the number of bytes used by the arrays of the collection. */
+    UINT64 getMemoryUsage() const;
+    /** This method appends a trail.
+      * @param  trail   The trail.
+      * @return The index of the trail in the collection.
+      */
+    UINT64 append(const Trail& trail);
+    /** This method appends a trail read from a record in the binary trail format,
+      * without decoding it into a Trail object.
+      * @param  data    A pointer to the beginning of the record,
+      *                 which is moved to the beginning of the next record.
+      * @param  end     A pointer just after the last byte available.
+      * @return The index of the trail in the collection.
+      * An exception is thrown if the record is inconsistent or does not fit before @a end,
+      * in which case the collection is left unchanged.
+      */
+    UINT64 appendBinary(const UINT8*& data, const UINT8 *end);
+    /** See TrailFetcher::fetchTrail(). The trail is appended. */
+    void fetchTrail(const Trail& trail);
+    /** This method returns a view on a trail.
+      * @param  i   The index of the trail.
+      * @return The view on the trail.
+      */
+    TrailView operator[](UINT64 i) const { return TrailView(*this, i); }
+    /** This method decodes a trail.
+      * @param  i   The index of the trail.
+      * @param  trail   The trail.
+      */
+    void get(UINT64 i, Trail& trail) const { TrailView(*this, i).get(trail); }
+    /** This method appends the trails of a file, in the binary trail format
+      * or in the text format. The records of a binary file are stored directly.
+      * @param  fileName    The name of the file.
+      * @return The number of trails appended.
+      */
+    UINT64 load(const string& fileName);
+    /** This method saves the trails in the binary trail format, header included,
+      * directly from the arrays of the collection.
+      * @param  fout    The stream to save the trails to.
+      */
+    void saveBinary(ostream& fout) const;
+    /** This method saves the trails in the text format, see Trail::save().
+      * @param  fout    The stream to save the trails to.
+      */
+    void save(ostream& fout) const;
+protected:
+    void appendState(const vector<SliceValue>& state);
+};
+
+/** This class stores one trail compactly in memory, e.g., to keep large sets of low-weight trails.
+  * The trail is encoded in a single array of bytes, with variable-length integers
+  * (7 bits per byte, the high bit set when more bytes follow):
+  * - the flags as in the binary trail format (1 byte), see Trail::saveBinary();
+  * - the lane size, the total weight, the number of weights and the weights;
+  * - the states, without the first state of a trail core, followed by the state after the last χ if specified,
+  *     each as its number of active slices followed, for each active slice by increasing z,
+  *     by the difference with the z of the previous active slice (or z itself for the first one) and its value.
+  * So, a state costs one byte plus 2 to 5 bytes per active slice.
+  * As the encoding of a given trail is unique, two compressed trails are equal iff their trails are.
+  */
+class CompressedTrail {
+protected:
+    vector<UINT8> data;
+public:
+    /** The hash function, for use in unordered containers. */
+    struct Hash {
+        size_t operator()(const CompressedTrail& trail) const { return (size_t)trail.getHash(); }
+    };
+public:
+    /** The constructor of an empty trail. */
+    CompressedTrail() { set(Trail()); }
+    /** The constructor.
+      * @param  trail   The trail to compress.
+      */
+    explicit CompressedTrail(const Trail& trail) { set(trail); }
+    /** This method sets the compressed trail.
+      * @param  trail   The trail to compress.
+      */
+    void set(const Trail& trail);
+    /** This method decodes the whole trail.
+      * @param  trail   The trail.
+      */
+    void get(Trail& trail) const;
+    /** This method tells whether the trail is a trail core, see Trail::firstStateSpecified. */
+    bool isTrailCore() const { return (data[0] & 1) != 0; }
+    /** This method tells whether the state after the last χ is specified,
+      * see Trail::stateAfterLastChiSpecified. */
+    bool isStateAfterLastChiSpecified() const { return (data[0] & 2) != 0; }
+    /** This method returns the number of slices of the states. */
+    unsigned int getLaneSize() const;
+    /** This method returns the total weight of the trail. */
+    unsigned int getTotalWeight() const;
+    /** This method returns the number of rounds of the trail. */
+    unsigned int getNumberOfRounds() const;
+    /** This method returns the weight of a given round, see Trail::weights. */
+    unsigned int getWeight(unsigned int round) const;
+    /** This method decodes the state of a given round, without memory allocation.
+      * For round 0 of a trail core, the state is empty, as in Trail::states.
+      * @param  round   The round index.
+      * @param  state   The state.
+      */
+    void getState(unsigned int round, FixedStateAsSlices& state) const;
+    /** This method returns the number of bytes of the encoding. */
+    size_t getSize() const { return data.size(); }
+    /** This method returns a 64-bit hash of the encoding. */
+    UINT64 getHash() const;
+    bool operator==(const CompressedTrail& other) const { return data == other.data; }
+    bool operator!=(const CompressedTrail& other) const { return data != other.data; }
+protected:
+    const UINT8 *getFirstState(unsigned int& laneSize, unsigned int& nrWeights) const;
+};
+
+/** This class keeps a set of trails in memory, each as a CompressedTrail,
+  * for quick membership queries and to remove the duplicates among the trails given to it.
+  * Unlike TrailSetUpToTranslation, two trails are the same only if they have the same states,
+  * not up to translation, and the set must be used by one thread at a time.
+  */
+class CompressedTrailSet : public TrailFetcher {
+public:
+    typedef unordered_set<CompressedTrail, CompressedTrail::Hash>::const_iterator const_iterator;
+protected:
+    unordered_set<CompressedTrail, CompressedTrail::Hash> trails;
+    UINT64 nrBytes;
+public:
+    /** The constructor of an empty set. */
+    CompressedTrailSet() : nrBytes(0) {}
+    /** This method returns the number of trails. */
+    UINT64 size() const { return trails.size(); }
+    /** This method tells whether the set is empty. */
+    bool empty() const { return trails.empty(); }
+    /** This method removes all the trails. */
+    void clear() { trails.clear(); nrBytes = 0; }
+    /** This method adds a trail, unless it is already present.
+      * @param  trail   The trail to add.
+      * @return True iff the trail was not yet present.
+      */
+    bool insert(const Trail& trail);
+    /** This method adds a compressed trail, unless it is already present.
+      * @param  trail   The trail to add.
+      * @return True iff the trail was not yet present.
+      */
+    bool insert(const CompressedTrail& trail);
+    /** This method tells whether a trail is present.
+      * @param  trail   The trail to look for.
+      * @return True iff the trail is present.
+      */
+    bool contains(const Trail& trail) const;
+    /** See TrailFetcher::fetchTrail(). The trail is added unless already present. */
+    void fetchTrail(const Trail& trail);
+    /** This method returns the number of bytes of the encodings of the trails,
+      * i.e., without the overhead of the vectors and of the hash table. */
+    UINT64 getMemoryUsageOfTrails() const { return nrBytes; }
+    /** These methods iterate over the trails, in no particular order. */
+    const_iterator begin() const { return trails.begin(); }
+    const_iterator end() const { return trails.end(); }
+};
+
+/** This class implements an iterator on the trails of a TrailCollection,
+  * so that they can be given to the functions that take a TrailIterator.
+  * The collection must not be modified while it is being iterated.
+  */
+class TrailCollectionIterator : public TrailIterator {
+protected:
+    const TrailCollection& collection;
+    UINT64 position, i, count;
+    Trail current;
+public:
+    /** The constructor of the iterator.
+      * @param  aCollection The collection of trails.
+      * @param   aDCorLC    The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      */
+    TrailCollectionIterator(const TrailCollection& aCollection, const KeccakFPropagation& aDCorLC);
+    /** The constructor of the iterator, with a filter.
+      * @param  aCollection The collection of trails.
+      * @param   aDCorLC    The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      * @param  aFilter     A pointer to the filter.
+      */
+    TrailCollectionIterator(const TrailCollection& aCollection, const KeccakFPropagation& aDCorLC, TrailFilter *aFilter);
+    /** See TrailIterator::isEnd(). */
+    virtual bool isEnd();
+    /** See TrailIterator::isEmpty(). */
+    virtual bool isEmpty();
+    /** See TrailIterator::operator++(). */
+    virtual void operator++();
+    /** See TrailIterator::operator*(). */
+    virtual const Trail& operator*();
+    /** See TrailIterator::isBounded(). */
+    virtual bool isBounded();
+    /** See TrailIterator::getIndex(). */
+    virtual UINT64 getIndex();
+    /** See TrailIterator::getCount(). */
+    virtual UINT64 getCount();
+protected:
+    void initialize();
+    void next();
+};
+
+#endif
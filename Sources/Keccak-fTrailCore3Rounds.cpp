@@ -13,8 +13,10 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <sstream>
 #include "Keccak-fDisplay.h"
 #include "Keccak-fTrailCore3Rounds.h"
+#include "tableCache.h"
 #include "translationsymmetry.h"
 
 using namespace std;
@@ -29,6 +31,23 @@ TrailCore3Rounds::TrailCore3Rounds(const vector<SliceValue>& backgroundAtA,
     tabooAtB(aTabooAtB)
 {
     (void)backgroundAtA;
+    initialize();
+}
+
+TrailCore3Rounds::TrailCore3Rounds(const vector<SliceValue>& backgroundAtA,
+                                   const vector<SliceValue>& aTabooAtB,
+                                   unsigned int aMaxWeight,
+                                   const KeccakFPropagation& aDCorLC) :
+    KeccakFPropagation(aDCorLC),
+    maxWeight(aMaxWeight),
+    tabooAtB(aTabooAtB)
+{
+    (void)backgroundAtA;
+    initialize();
+}
+
+void TrailCore3Rounds::initialize()
+{
     initializeKnotInfoLUT();
 
     initializeVortexBase();
@@ -37,6 +56,11 @@ TrailCore3Rounds::TrailCore3Rounds(const vector<SliceValue>& backgroundAtA,
     stateAtB.assign(laneSize,0);
 
     minimumWorkingChainLength = 2;
+
+    nrParts = 1;
+    partIndex = 0;
+    rootIndex = 0;
+    statistics = 0;
 }
 
 void TrailCore3Rounds::populateStatesWithBackground(const vector<SliceValue>& backgroundAtA)
@@ -59,79 +83,74 @@ void TrailCore3Rounds::populateStatesWithBackground(const vector<SliceValue>& ba
 void TrailCore3Rounds::initializeKnotInfoLUT()
 {
     if (getPropagationType() == KeccakFPropagation::DC){
-        string fileName = "KnotInfoDC" + name + ".cache";
-        ifstream fin(fileName.c_str(), ios::binary);
-        if (!fin) {
-            vector<bool> isTameKnot;
-            for(SliceValue s=0; s<=maxSliceValue ; s++) {
-                if ( (0  == (s%0x40000)) ) cout << "phase 1 " << s << " of " << maxSliceValue+1 << endl;
-                vector<SliceValue> state(laneSize,0);
-                AffineSpaceOfSlices base = buildSliceBase(s);
-                SliceValue dummy;
-                bool isTame = base.getOffsetWithGivenParity(0,dummy);
-                isTameKnot.push_back(isTame);
-                if ((getHammingWeightSlice(s) == 2) && (getParity(s) == 0)) isTameKnot.back() = false;
+        // The knot information depends only on the slice value, so all the widths share the same table.
+        const string cacheName = "KnotInfo" + name + ".table";
+        const string parameters = "knot information per slice value for " + name;
+        size_t size;
+        knotInfoLUT = loadCachedTable(cacheName, parameters, size);
+        if (knotInfoLUT && (size == (size_t)maxSliceValue+1))
+            return;
+        vector<UINT8> lut;
+        lut.reserve((size_t)maxSliceValue+1);
+        vector<bool> isTameKnot;
+        for(SliceValue s=0; s<=maxSliceValue ; s++) {
+            if ( (0  == (s%0x40000)) ) cout << "phase 1 " << s << " of " << maxSliceValue+1 << endl;
+            vector<SliceValue> state(laneSize,0);
+            AffineSpaceOfSlices base = buildSliceBase(s);
+            SliceValue dummy;
+            bool isTame = base.getOffsetWithGivenParity(0,dummy);
+            isTameKnot.push_back(isTame);
+            if ((getHammingWeightSlice(s) == 2) && (getParity(s) == 0)) isTameKnot.back() = false;
+        }
+        for(SliceValue s=0; s<=maxSliceValue ; s++) {
+            if ( (0  == (s%0x40000)) ) cout << "phase 2 " << s << " of " << maxSliceValue+1 << endl;
+            unsigned int knotPointDeficit;
+            unsigned int knotWeightAtBDeficit;
+            unsigned int nrActiveRows = getNrActiveRows(s);
+            bool isOrbital;
+            if (isTameKnot[s]) {
+                knotPointDeficit = 0;
+                knotWeightAtBDeficit = 0;
+                isOrbital = false;
             }
-            for(SliceValue s=0; s<=maxSliceValue ; s++) {
-                if ( (0  == (s%0x40000)) ) cout << "phase 2 " << s << " of " << maxSliceValue+1 << endl;
-                unsigned int knotPointDeficit;
-                unsigned int knotWeightAtBDeficit;
-                unsigned int nrActiveRows = getNrActiveRows(s);
-                bool isOrbital;
-                if (isTameKnot[s]) {
+            else {
+                unsigned int HW = getHammingWeightSlice(s);
+                if (HW == 0){
                     knotPointDeficit = 0;
                     knotWeightAtBDeficit = 0;
                     isOrbital = false;
                 }
+                else if (HW == 1){
+                    knotPointDeficit = 2;
+                    knotWeightAtBDeficit = 3;
+                    isOrbital = false;
+                }
+                else if ((HW == 2) && (getParity(s) == 0)){
+                    knotPointDeficit = 1;
+                    knotWeightAtBDeficit = 1;
+                    isOrbital = true;
+                }
                 else {
-                    unsigned int HW = getHammingWeightSlice(s);
-                    if (HW == 0){
-                        knotPointDeficit = 0;
-                        knotWeightAtBDeficit = 0;
-                        isOrbital = false;
-                    }
-                    else if (HW == 1){
-                        knotPointDeficit = 2;
-                        knotWeightAtBDeficit = 3;
-                        isOrbital = false;
-                    }
-                    else if ((HW == 2) && (getParity(s) == 0)){
-                        knotPointDeficit = 1;
-                        knotWeightAtBDeficit = 1;
-                        isOrbital = true;
-                    }
-                    else {
-                        knotPointDeficit = 1;
-                        isOrbital = false;
-                        knotWeightAtBDeficit = 4;
-                        for (unsigned int x=0 ; x<5 ; x++){
-                            for (unsigned int y=0 ; y<5 ; y++){
-                                SliceValue strayBit = getSlicePoint(x,y);
-                                strayBit |= s;
-                                if (isTameKnot[strayBit]){
-                                    int tmp = getWeight(strayBit) - getWeight(s);
-                                    if (tmp < (int) knotWeightAtBDeficit) knotWeightAtBDeficit =  (unsigned int) tmp;
-                                }
+                    knotPointDeficit = 1;
+                    isOrbital = false;
+                    knotWeightAtBDeficit = 4;
+                    for (unsigned int x=0 ; x<5 ; x++){
+                        for (unsigned int y=0 ; y<5 ; y++){
+                            SliceValue strayBit = getSlicePoint(x,y);
+                            strayBit |= s;
+                            if (isTameKnot[strayBit]){
+                                int tmp = getWeight(strayBit) - getWeight(s);
+                                if (tmp < (int) knotWeightAtBDeficit) knotWeightAtBDeficit =  (unsigned int) tmp;
                             }
                         }
                     }
                 }
-                knotInfoLUT.push_back(packKnotInfo(knotPointDeficit,knotWeightAtBDeficit,nrActiveRows,isOrbital));
-            }
-            ofstream fout(fileName.c_str(), ios::binary);
-            for(SliceValue s=0 ; s<=maxSliceValue ; s++ ) {
-                static unsigned char tmp[1];
-                tmp[0] =  knotInfoLUT[s];
-                fout.write((char *)tmp, 1);
-            }
-        }
-        else {
-            for(SliceValue s=0 ; s<=maxSliceValue ; s++ ) {
-                unsigned char tmp[1];
-                fin.read((char *)tmp,1);
-                knotInfoLUT.push_back(tmp[0]);
             }
+            lut.push_back(packKnotInfo(knotPointDeficit,knotWeightAtBDeficit,nrActiveRows,isOrbital));
         }
+        saveCachedTable(cacheName, parameters, &lut[0], lut.size());
+        shared_ptr<const vector<UINT8> > computed = make_shared<const vector<UINT8> >(move(lut));
+        knotInfoLUT = shared_ptr<const UINT8>(computed, &(*computed)[0]);
     }
     else throw KeccakException("implementation of KnotInfoLUT for LC is under construction");
 }
@@ -145,7 +164,7 @@ UINT8 TrailCore3Rounds::packKnotInfo(unsigned int knotPointDeficit,unsigned int
 
 void TrailCore3Rounds::populateKnotInfo(KnotInformation& aKnotInfo,const SliceValue& aSliceValue, bool knotHasSinglePoint, bool hasBackground) const
 {
-    unsigned int tmp            = knotInfoLUT[aSliceValue];
+    unsigned int tmp            = knotInfoLUT.get()[aSliceValue];
     aKnotInfo.isOrbital         = (1 == (tmp&1));
     if (hasBackground && knotHasSinglePoint){
         aKnotInfo.nrActiveRows         = 1;
@@ -194,6 +213,7 @@ bool TrailCore3Rounds::completeChain()
     bool canChainBeExtended = canAffordExtendingChain();
     do {
         if (!canChainBeExtended) {
+            countSearchEvent(statistics, SearchStatistics::prunedByCost, (unsigned int)chains.size());
             if (chains.back().size() == 1) return false;
             else removePoint(false);
         }
@@ -207,7 +227,7 @@ bool TrailCore3Rounds::completeChain()
             BitPosition pB;
             do {
                 yOffsets.back().back() += 1; // this is the y offset at B
-                pB = chains.back().back();
+                pB = chains.back().back().getBitPosition();
                 pB.yTranslate(yOffsets.back().back());
                 success = (0 == getBit(tabooAtB, pB)); // pB shall not lie in tabooAtB
             }
@@ -223,13 +243,14 @@ bool TrailCore3Rounds::completeChain()
             bool isPotentialEndPoint;
             do {
                 yOffsets.back().back() += 1;        // this is the offset at A
-                pB = chains.back().back();
-                reverseRhoPi(pB);
-                pB.yTranslate(yOffsets.back().back());
-                directRhoPi(pB);
+                PackedBitPosition packedPB = chains.back().back();
+                reverseRhoPi(packedPB);
+                packedPB.yTranslate(yOffsets.back().back());
+                directRhoPi(packedPB);
+                pB = packedPB.getBitPosition();
                 isPotentialEndPoint =
                     (chains.back().size()+1 >= minimumWorkingChainLength )  // chain is long enough
-                    && (chains.back()[0] < pB);                             // end point is larger than start point
+                    && (chains.back()[0] < packedPB);                       // end point is larger than start point
                 success = (0 == getBit(tabooAtB, pB));                      // it does not arrive in the taboo zone
                 if (success) {
                     if (knots.count(pB.z) != 0) {                           // if it arrives in a knot slice
@@ -287,7 +308,7 @@ bool TrailCore3Rounds::nextChain()
             BitPosition pB;
             bool pBisInitialized = (chains.back().size() > 0);
             if (pBisInitialized) {
-                pB = chains.back()[0];
+                pB = chains.back()[0].getBitPosition();
                 removePoint(true);
             }
             do {
@@ -324,22 +345,36 @@ bool TrailCore3Rounds::nextChain()
 
 bool TrailCore3Rounds::nextWithKnots()
 {
-    if ((!knots.empty()) && chains.empty() && isStateAtBWellFormed()) return true; // this deals with non-zero backgrounds that result in a well-formed state at B
+    if ((!knots.empty()) && chains.empty() && isStateAtBWellFormed()) return isRootInPart(0); // this deals with non-zero backgrounds that result in a well-formed state at B
+    bool skipRoot = false;
+    bool wellFormed = false;
     do {
-        if (knots.empty() || (canAffordAddingChain())) {
-            chains.push_back(vector<BitPosition>());
+        if ((!skipRoot) && (knots.empty() || (canAffordAddingChain()))) {
+            countSearchEvent(statistics, SearchStatistics::childrenGenerated, (unsigned int)chains.size() + 1);
+            chains.push_back(vector<PackedBitPosition>());
             yOffsets.push_back(vector<unsigned int>());
             // Having a "free" starting point implies a knot or a run can be added. When this function is called, the working chain is empty, hence it necessarily adds two knot points. The new chain, as well as future ones, must have at least (minimumWorkingChainLength - 2) orbital points.
             startPointWorkingChainIsFree = canAffordGeneric(2, 1, minimumWorkingChainLength - 2, minimumWorkingChainLength - 2);
         }
+        else if (!skipRoot)
+            countSearchEvent(statistics, SearchStatistics::prunedByCost, (unsigned int)chains.size() + 1);
         while((!chains.empty()) && (!nextChain())) {
             chains.pop_back();
             yOffsets.pop_back();
             updateMinimumWorkingChainLength();
         }
         if (chains.empty()) return false;
+        // When only the first chain is left, nextChain() has just given it a new value, hence a new root.
+        if (chains.size() == 1) {
+            rootIndex++;
+            skipRoot = !isRootInPart(rootIndex);
+        }
+        if (!skipRoot) {
+            wellFormed = isStateAtBWellFormed();
+            countSearchEvent(statistics, wellFormed ? SearchStatistics::nodesVisited : SearchStatistics::prunedByShape, (unsigned int)chains.size());
+        }
     }
-    while (!isStateAtBWellFormed());
+    while (skipRoot || (!wellFormed));
     return true;
 }
 
@@ -390,23 +425,26 @@ void TrailCore3Rounds::removeVortexPoint(vector<BitPosition >& chainAtB,
     yOffset.pop_back();
 }
 
-void TrailCore3Rounds::addVortexToBaseIfMinimal(const vector<BitPosition >& chainAtB, unsigned int theNrActiveRowsAtA, unsigned int theNrActiveRowsAtD)
+void TrailCore3Rounds::addVortexToBaseIfMinimal(vector<vector<VortexInfo> >& base, const vector<BitPosition >& chainAtB, unsigned int theNrActiveRowsAtA, unsigned int theNrActiveRowsAtD) const
 {
     vector<SliceValue> workState(laneSize,0);
     for (unsigned int i=0 ; i<chainAtB.size() ; i++) setBitToOne(workState,chainAtB[i]);
 
     if ((chainAtB[0] < chainAtB.back()) && (isMinimalSymmetrically(workState))) {
-        while(2*vortexBase.size() <= chainAtB.size()) vortexBase.push_back(vector<VortexInfo>(0));
+        while(2*base.size() <= chainAtB.size()) base.push_back(vector<VortexInfo>(0));
         VortexInfo workVortexInfo;
         workVortexInfo.nrActiveRowsAtA = theNrActiveRowsAtA;
         workVortexInfo.nrActiveRowsAtD = theNrActiveRowsAtD;
         for(unsigned int i=0 ; i<chainAtB.size() ; i++) workVortexInfo.stateAtB.setBitToOne(chainAtB[i]);
-        vortexBase[chainAtB.size()/2].push_back(workVortexInfo);
+        base[chainAtB.size()/2].push_back(workVortexInfo);
     }
 }
 
 void TrailCore3Rounds::initializeVortexBase()
 {
+    if (loadVortexBase())
+        return;
+    vector<vector<VortexInfo> > base;
     vector<BitPosition> chainAtB;
     vector<unsigned int> yOffset;
     map<RowPosition,unsigned int> rowsAtA;
@@ -420,7 +458,7 @@ void TrailCore3Rounds::initializeVortexBase()
         if ((chainAtB.size() == 1) && (yOffset.back() == 4)) { // time to iterate the first point of the working chain
             pB = chainAtB.back();
             removeVortexPoint(chainAtB,yOffset,rowsAtA,rowsAtD,slicesAtB);
-            if (!pB.nextXY()) return;
+            if (!pB.nextXY()) break;
             addVortexPoint(pB,chainAtB,yOffset,rowsAtA,rowsAtD,slicesAtB);
         }
 
@@ -444,7 +482,7 @@ void TrailCore3Rounds::initializeVortexBase()
             else if ((pB.z == chainAtB[0].z) && (pB.x == chainAtB[0].x) && (pB.y != chainAtB[0].y)) { // we have hit a vortex
                 addVortexPoint(pB,chainAtB,yOffset,rowsAtA,rowsAtD,slicesAtB);
                 if (2*chainAtB.size() + 2*rowsAtA.size() + 2*rowsAtD.size() <= maxWeight) {
-                    addVortexToBaseIfMinimal(chainAtB,rowsAtA.size(),rowsAtD.size());
+                    addVortexToBaseIfMinimal(base,chainAtB,rowsAtA.size(),rowsAtD.size());
                 }
                 removeVortexPoint(chainAtB,yOffset,rowsAtA,rowsAtD,slicesAtB); // after storing the vortex, remove the last point of the working chain
             }
@@ -453,5 +491,217 @@ void TrailCore3Rounds::initializeVortexBase()
             removeVortexPoint(chainAtB,yOffset,rowsAtA,rowsAtD,slicesAtB); // purging the trailing part of the working chain
     }
     while(true);
+    saveVortexBase(base);
+    vortexBase = make_shared<const vector<vector<VortexInfo> > >(move(base));
+}
+
+string TrailCore3Rounds::getVortexBaseCacheName() const
+{
+    stringstream cacheName;
+    cacheName << "VortexBase" << name << "-" << dec << laneSize << "-" << maxWeight << ".table";
+    return cacheName.str();
+}
+
+string TrailCore3Rounds::getVortexBaseParameters() const
+{
+    stringstream parameters;
+    parameters << "vortex base for " << name << ", lane size " << dec << laneSize << ", maximum weight " << maxWeight;
+    return parameters.str();
+}
+
+static void appendUINT32(vector<UINT8>& buffer, UINT32 value)
+{
+    for(unsigned int i=0; i<4; i++)
+        buffer.push_back((UINT8)(value >> (8*i)));
+}
+
+static UINT32 readUINT32(const UINT8*& data, const UINT8 *end)
+{
+    if (end - data < 4)
+        throw KeccakException("The cached vortex base is truncated.");
+    UINT32 value = 0;
+    for(unsigned int i=0; i<4; i++)
+        value ^= (UINT32)data[i] << (8*i);
+    data += 4;
+    return value;
+}
+
+// The vortex base is saved as 32-bit words: the number of lengths, then, for each length,
+// the number of vortices followed by, for each vortex, its numbers of active rows at A and D,
+// its number of slices at B and the (z, slice value) couples.
+void TrailCore3Rounds::saveVortexBase(const vector<vector<VortexInfo> >& base) const
+{
+    vector<UINT8> buffer;
+    appendUINT32(buffer, (UINT32)base.size());
+    for(unsigned int u=0; u<base.size(); u++) {
+        appendUINT32(buffer, (UINT32)base[u].size());
+        for(unsigned int v=0; v<base[u].size(); v++) {
+            const VortexInfo& vortex = base[u][v];
+            appendUINT32(buffer, vortex.nrActiveRowsAtA);
+            appendUINT32(buffer, vortex.nrActiveRowsAtD);
+            appendUINT32(buffer, vortex.stateAtB.size());
+            for(SparseStateAsSlices::const_iterator i=vortex.stateAtB.begin(); i!=vortex.stateAtB.end(); ++i) {
+                appendUINT32(buffer, i->first);
+                appendUINT32(buffer, i->second);
+            }
+        }
+    }
+    saveCachedTable(getVortexBaseCacheName(),
+        getVortexBaseParameters(), &buffer[0], buffer.size());
+}
+
+bool TrailCore3Rounds::loadVortexBase()
+{
+    size_t size;
+    shared_ptr<const UINT8> content = loadCachedTable(getVortexBaseCacheName(),
+        getVortexBaseParameters(), size);
+    if (!content)
+        return false;
+    const UINT8 *data = content.get();
+    const UINT8 *end = data + size;
+    vector<vector<VortexInfo> > base(readUINT32(data, end));
+    for(unsigned int u=0; u<base.size(); u++) {
+        base[u].resize(readUINT32(data, end));
+        for(unsigned int v=0; v<base[u].size(); v++) {
+            VortexInfo& vortex = base[u][v];
+            vortex.nrActiveRowsAtA = readUINT32(data, end);
+            vortex.nrActiveRowsAtD = readUINT32(data, end);
+            unsigned int nrSlices = readUINT32(data, end);
+            for(unsigned int i=0; i<nrSlices; i++) {
+                unsigned int z = readUINT32(data, end);
+                vortex.stateAtB.setSlice(z, readUINT32(data, end));
+            }
+        }
+    }
+    vortexBase = make_shared<const vector<vector<VortexInfo> > >(move(base));
+    return true;
+}
+
+
+UINT64 TrailCore3Rounds::readFromCursor(const vector<UINT64>& cursor, size_t& position)
+{
+    if (position >= cursor.size())
+        throw KeccakException("The cursor is too short for the iteration state it should contain.");
+    return cursor[position++];
+}
+
+void TrailCore3Rounds::appendToCursor(vector<UINT64>& cursor, const vector<SliceValue>& state)
+{
+    cursor.push_back(state.size());
+    for(unsigned int z=0; z<state.size(); z++)
+        cursor.push_back(state[z]);
+}
+
+void TrailCore3Rounds::readFromCursor(const vector<UINT64>& cursor, size_t& position, vector<SliceValue>& state)
+{
+    state.resize((size_t)readFromCursor(cursor, position));
+    for(unsigned int z=0; z<state.size(); z++)
+        state[z] = (SliceValue)readFromCursor(cursor, position);
 }
 
+void TrailCore3Rounds::appendIterationState(vector<UINT64>& cursor) const
+{
+    cursor.push_back(knots.size());
+    for(map<unsigned int,KnotInformation>::const_iterator it = knots.begin(); it != knots.end(); ++it) {
+        cursor.push_back(it->first);
+        cursor.push_back(it->second.isOrbital ? 1 : 0);
+        cursor.push_back(it->second.nrActiveRows);
+        cursor.push_back(it->second.knotPointDeficit);
+        cursor.push_back(it->second.knotWeightAtBDeficit);
+    }
+    cursor.push_back(knotsWithBackground.size());
+    for(set<unsigned int>::const_iterator it = knotsWithBackground.begin(); it != knotsWithBackground.end(); ++it)
+        cursor.push_back(*it);
+    cursor.push_back(chains.size());
+    for(unsigned int i=0; i<chains.size(); i++) {
+        cursor.push_back(chains[i].size());
+        for(unsigned int j=0; j<chains[i].size(); j++) {
+            cursor.push_back(chains[i][j].getX());
+            cursor.push_back(chains[i][j].getY());
+            cursor.push_back(chains[i][j].getZ());
+            cursor.push_back(yOffsets[i][j]);
+        }
+    }
+    stack<bool> copyOfKnotPointAddedKnot(knotPointAddedKnot);
+    vector<UINT64> addedKnots;
+    while(!copyOfKnotPointAddedKnot.empty()) {
+        addedKnots.push_back(copyOfKnotPointAddedKnot.top() ? 1 : 0);
+        copyOfKnotPointAddedKnot.pop();
+    }
+    cursor.push_back(addedKnots.size());
+    cursor.insert(cursor.end(), addedKnots.rbegin(), addedKnots.rend());
+    appendToCursor(cursor, stateAtA);
+    appendToCursor(cursor, stateAtB);
+    cursor.push_back(minimumWorkingChainLength);
+    cursor.push_back(startPointWorkingChainIsFree ? 1 : 0);
+    cursor.push_back(nrActiveRowsAtA);
+    cursor.push_back(hammingWeightAtA);
+    cursor.push_back(rootIndex);
+}
+
+void TrailCore3Rounds::readIterationState(const vector<UINT64>& cursor, size_t& position)
+{
+    knots.clear();
+    UINT64 nrKnots = readFromCursor(cursor, position);
+    for(UINT64 i=0; i<nrKnots; i++) {
+        unsigned int z = (unsigned int)readFromCursor(cursor, position);
+        KnotInformation& knot = knots[z];
+        knot.isOrbital = (readFromCursor(cursor, position) != 0);
+        knot.nrActiveRows = (unsigned int)readFromCursor(cursor, position);
+        knot.knotPointDeficit = (unsigned int)readFromCursor(cursor, position);
+        knot.knotWeightAtBDeficit = (unsigned int)readFromCursor(cursor, position);
+    }
+    knotsWithBackground.clear();
+    UINT64 nrKnotsWithBackground = readFromCursor(cursor, position);
+    for(UINT64 i=0; i<nrKnotsWithBackground; i++)
+        knotsWithBackground.insert((unsigned int)readFromCursor(cursor, position));
+    chains.assign((size_t)readFromCursor(cursor, position), vector<PackedBitPosition>());
+    yOffsets.assign(chains.size(), vector<unsigned int>());
+    for(unsigned int i=0; i<chains.size(); i++) {
+        UINT64 chainLength = readFromCursor(cursor, position);
+        for(UINT64 j=0; j<chainLength; j++) {
+            BitPosition p;
+            p.x = (unsigned int)readFromCursor(cursor, position);
+            p.y = (unsigned int)readFromCursor(cursor, position);
+            p.z = (unsigned int)readFromCursor(cursor, position);
+            chains[i].push_back(PackedBitPosition(p));
+            yOffsets[i].push_back((unsigned int)readFromCursor(cursor, position));
+        }
+    }
+    knotPointAddedKnot = stack<bool>();
+    UINT64 nrKnotPoints = readFromCursor(cursor, position);
+    for(UINT64 i=0; i<nrKnotPoints; i++)
+        knotPointAddedKnot.push(readFromCursor(cursor, position) != 0);
+    readFromCursor(cursor, position, stateAtA);
+    readFromCursor(cursor, position, stateAtB);
+    minimumWorkingChainLength = (unsigned int)readFromCursor(cursor, position);
+    startPointWorkingChainIsFree = (readFromCursor(cursor, position) != 0);
+    nrActiveRowsAtA = (unsigned int)readFromCursor(cursor, position);
+    hammingWeightAtA = (unsigned int)readFromCursor(cursor, position);
+    rootIndex = readFromCursor(cursor, position);
+}
+
+void TrailCore3Rounds::getCursor(vector<UINT64>& cursor) const
+{
+    cursor.push_back(laneSize);
+    cursor.push_back(maxWeight);
+    appendIterationState(cursor);
+}
+
+void TrailCore3Rounds::resume(const vector<UINT64>& cursor)
+{
+    size_t position = 0;
+    if ((readFromCursor(cursor, position) != laneSize) || (readFromCursor(cursor, position) != maxWeight))
+        throw KeccakException("The cursor was obtained with another lane size or maximum weight.");
+    readIterationState(cursor, position);
+    if (position != cursor.size())
+        throw KeccakException("The cursor is too long for the iteration state it should contain.");
+}
+
+void TrailCore3Rounds::setPartition(unsigned int aPartIndex, unsigned int aNrParts)
+{
+    if ((aNrParts == 0) || (aPartIndex >= aNrParts))
+        throw KeccakException("TrailCore3Rounds::setPartition(): the part index must be smaller than the number of parts.");
+    nrParts = aNrParts;
+    partIndex = aPartIndex;
+}
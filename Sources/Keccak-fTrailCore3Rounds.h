@@ -20,6 +20,8 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include "Keccak-fPropagation.h"
 #include "Keccak-fState.h"
 #include "Keccak-fDCLC.h"
+#include "searchStatistics.h"
+#include <memory>
 #include <stack>
 #include <set>
 
@@ -47,9 +49,11 @@ class TrailCore3Rounds  : public KeccakFPropagation
 {
 protected:
 
-    /** Vector with element i containing information about the slice with value i, relevant when it is a knot.
+    /** Array with element i containing information about the slice with value i, relevant when it is a knot.
+      * It does not change after the construction, so the copies of this object share it.
+      * It is mapped from the table cache when available, see tableCache.h.
       */
-    vector<UINT8> knotInfoLUT;
+    shared_ptr<const UINT8> knotInfoLUT;
 
     /** Maximum lower weight of 3-round trail cores to be generated.
       */
@@ -64,14 +68,14 @@ protected:
       */
     set<unsigned int> knotsWithBackground;
 
-    /** Vector of chains, where each chain is actually a vector of bit positions at B.
+    /** Vector of chains, where each chain is actually a vector of bit positions at B, packed to keep them compact.
       * All chains are between knots, except the last chain that may be incomplete.
       * If the last chain is incomplete, it is called the working chain.
       * The chains respect an order:
       * - later chains are never shorter than earlier chains, with the exception of the working chain
       * - when chains have the same length, the starting bit position of the earlier chain is smaller than that of the later.
       */
-    vector<vector<BitPosition> > chains;
+    vector<vector<PackedBitPosition> > chains;
 
     /** y-offset accompanying the chains, required in the iteration process.
       * yOffset[i][j] gives information on how to compute chains[i][j+1] from chains[i][j].
@@ -140,8 +144,25 @@ protected:
 
     /** Database of all vortices that lead to 3-round trail cores with weight not above maxWeight.
       * Vortex[u][v] contains a vortex of length 2*u, v is just an index and has no special significance.
+      * It does not change after the construction, so the copies of this object share it.
       */
-    vector<vector<VortexInfo> > vortexBase;
+    shared_ptr<const vector<vector<VortexInfo> > > vortexBase;
+
+    /** The number of parts in which the roots of the search are split, see setPartition().
+      */
+    unsigned int nrParts;
+
+    /** The index of the part of the roots generated by this iterator, see setPartition().
+      */
+    unsigned int partIndex;
+
+    /** The index of the root of the current trail core, see getRootIndex().
+      */
+    UINT64 rootIndex;
+
+    /** Where to count the events of the search, or null, see setStatistics().
+      */
+    SearchStatistics *statistics;
 
 protected:
     /** This method builds the table knotInfoLUT
@@ -196,19 +217,42 @@ protected:
                            map<RowPosition,unsigned int>& rowsAtD,
                            map<unsigned int,unsigned int>& slicesAtB) const;
 
-    /** This method adds a vortex to vortexBase, provided the corresponding state at B is minimal in z
+    /** This method adds a vortex to the vortex base being built, provided the corresponding state at B is minimal in z
+      * @param   base  The vortex base being built.
       * @param   chainAtB  Chain containing the coordinates of the vortex points at B.
       * @param   nrActiveRowsAtA  self-explanatory.
       * @param   nrActiveRowsAtD  self-explanatory.
       */
-    void addVortexToBaseIfMinimal(const vector<BitPosition>& pointsAtB,
+    void addVortexToBaseIfMinimal(vector<vector<VortexInfo> >& base,
+                                  const vector<BitPosition>& pointsAtB,
                                   unsigned int nrActiveRowsAtA,
-                                  unsigned int nrActiveRowsAtD);
+                                  unsigned int nrActiveRowsAtD) const;
 
     /** This method assures the vortexBase contains all vortices up to and including maxWeight.
+      * The vortex base is taken from the table cache when available, see tableCache.h.
       */
     void initializeVortexBase();
 
+    /** This method returns the name of the vortex base in the table cache.
+      */
+    string getVortexBaseCacheName() const;
+
+    /** This method returns the description of the parameters of the vortex base in the table cache.
+      */
+    string getVortexBaseParameters() const;
+
+    /** This method saves the vortex base into the table cache.
+      */
+    void saveVortexBase(const vector<vector<VortexInfo> >& base) const;
+
+    /** This method sets vortexBase from the table cache, and returns false if it is not there.
+      */
+    bool loadVortexBase();
+
+    /** This method initializes the look-up tables and the iteration, common to the constructors.
+      */
+    void initialize();
+
     /** This virtual method returns whether the state is well formed corresponding to the subclass.
       * @return        Whether the state is well formed.
       */
@@ -300,6 +344,39 @@ protected:
       */
     void populateKnotInfo(KnotInformation& aKnotInformation,const SliceValue& aSliceValue, bool knotHasSinglePoint, bool hasBackground) const;
 
+    /** This method returns whether the given root belongs to the part generated by this iterator.
+      * @param   root   The index of the root, see getRootIndex().
+      * @return        Whether the trail cores of this root are generated.
+      */
+    bool isRootInPart(UINT64 root) const { return (root % nrParts) == partIndex; }
+    /** This virtual method appends to @a cursor the attributes that change during the iteration.
+      * Subclasses with such attributes must override it and call this method first.
+      * @param   cursor     The cursor to append to.
+      */
+    virtual void appendIterationState(vector<UINT64>& cursor) const;
+    /** This virtual method restores the attributes saved by appendIterationState().
+      * @param   cursor     The cursor.
+      * @param   position   The position in the cursor, which is moved past the attributes read.
+      */
+    virtual void readIterationState(const vector<UINT64>& cursor, size_t& position);
+    /** This method reads a value from a cursor.
+      * @param   cursor     The cursor.
+      * @param   position   The position in the cursor, which is moved past the value read.
+      * @return  The value read.
+      */
+    static UINT64 readFromCursor(const vector<UINT64>& cursor, size_t& position);
+    /** This method appends a state to a cursor.
+      * @param   cursor     The cursor to append to.
+      * @param   state      The state.
+      */
+    static void appendToCursor(vector<UINT64>& cursor, const vector<SliceValue>& state);
+    /** This method reads a state from a cursor.
+      * @param   cursor     The cursor.
+      * @param   position   The position in the cursor, which is moved past the state read.
+      * @param   state      The state read.
+      */
+    static void readFromCursor(const vector<UINT64>& cursor, size_t& position, vector<SliceValue>& state);
+
 public:
 
     /** Constructor that initializes the attributes.
@@ -314,6 +391,60 @@ public:
                     unsigned int aMaxWeight,
                     const KeccakFDCLC& aParent,
                     KeccakFPropagation::DCorLC aDCorLC);
+
+    /** Constructor that initializes the attributes, sharing the propagation tables of an existing instance.
+      * An initial call to next() is necessary for having the first valid state.
+      * @param   backgroundAtA  The background at A.
+      * @param   aTabooAtB      State indicating the bits at B where no active points may be put.
+      * @param   aMaxWeight     The maximum propagation weight up to which one must generate all trail cores.
+      * @param   aDCorLC        The propagation context, whose tables are shared.
+      */
+    TrailCore3Rounds(const vector<SliceValue>& backgroundAtA,
+                    const vector<SliceValue>& aTabooAtB,
+                    unsigned int aMaxWeight,
+                    const KeccakFPropagation& aDCorLC);
+    /** This method returns the current position of the iteration as a cursor,
+      * e.g., to save it in a SearchCheckpoint.
+      * @param   cursor     The cursor.
+      */
+    void getCursor(vector<UINT64>& cursor) const;
+    /** This method moves the iterator to the position given by @a cursor, as obtained
+      * from getCursor() with an iterator constructed with the same parameters.
+      * The next call to next() then gives the trail core that followed
+      * the one current when getCursor() was called.
+      * @param   cursor     The cursor.
+      */
+    void resume(const vector<UINT64>& cursor);
+    /** This method restricts the iteration to a part of the search, so that
+      * several iterators with the same parameters can split it between them.
+      * The search is split by roots: root 0 groups the trail cores generated
+      * before the first chain is added, e.g., those made of vortices only,
+      * and each subsequent value of the first chain is a new root, whose
+      * trail cores are those generated while the first chain keeps this value.
+      * The iterator generates only the trail cores of the roots with index
+      * equal to @a aPartIndex modulo @a aNrParts, skipping the other roots
+      * without adding further chains to them.
+      * It must be called before the first call to next().
+      * @param   aPartIndex The index of the part, between 0 and @a aNrParts-1.
+      * @param   aNrParts   The number of parts.
+      */
+    virtual void setPartition(unsigned int aPartIndex, unsigned int aNrParts);
+    /** This method returns the index of the root of the current trail core, see setPartition().
+      * Roots are numbered in the order of the sequential iteration, whatever the partition,
+      * so sorting the trail cores of all parts by root index, in a stable way,
+      * restores the order of a single iterator.
+      * @return  The index of the root.
+      */
+    UINT64 getRootIndex() const { return rootIndex; }
+    /** This method sets where to count the events of the search.
+      * The depth is the number of chains, plus the number of vortices
+      * in TrailCoreInKernelAtC. A new chain counts as a child.
+      * A state at B that is not well formed counts as pruned by shape.
+      * A chain that the weight bound cannot afford counts as pruned by cost.
+      * The vortex combinations rejected by isMinimalSymmetrically() count as pruned by canonicity.
+      * @param   aStatistics    The object to count in, or null not to count.
+      */
+    void setStatistics(SearchStatistics *aStatistics) { statistics = aStatistics; }
 };
 
 #endif
@@ -13,6 +13,11 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include "Keccak-fDisplay.h"
 #include "Keccak-fTrailCoreInKernelAtC.h"
 #include "translationsymmetry.h"
@@ -25,6 +30,20 @@ TrailCoreInKernelAtC::TrailCoreInKernelAtC(const vector<SliceValue>& backgroundA
                                            const KeccakFDCLC& aParent,
                                            KeccakFPropagation::DCorLC aDCorLC) :
     TrailCore3Rounds(backgroundAtA, aTabooAtB, aMaxWeight, aParent, aDCorLC)
+{
+    initializeIterator(backgroundAtA);
+}
+
+TrailCoreInKernelAtC::TrailCoreInKernelAtC(const vector<SliceValue>& backgroundAtA,
+                                           const vector<SliceValue>& aTabooAtB,
+                                           unsigned int aMaxWeight,
+                                           const KeccakFPropagation& aDCorLC) :
+    TrailCore3Rounds(backgroundAtA, aTabooAtB, aMaxWeight, aDCorLC)
+{
+    initializeIterator(backgroundAtA);
+}
+
+void TrailCoreInKernelAtC::initializeIterator(const vector<SliceValue>& backgroundAtA)
 {
     partialStateAtD.assign(laneSize,0);
 
@@ -104,7 +123,7 @@ void TrailCoreInKernelAtC::addPoint(const BitPosition& pB, bool toKnotSlice, boo
 {
     if (!isBackgroundPoint){
         yOffsets.back().push_back(0);
-        chains.back().push_back(pB);
+        chains.back().push_back(PackedBitPosition(pB));
 
         // Dealing with the impact at A
         BitPosition pA(pB);
@@ -167,7 +186,7 @@ void TrailCoreInKernelAtC::addPoint(const BitPosition& pB, bool toKnotSlice, boo
 
 void TrailCoreInKernelAtC::removePoint(bool fromKnotSlice)
 {
-    BitPosition pB(chains.back().back());
+    BitPosition pB(chains.back().back().getBitPosition());
     yOffsets.back().pop_back();
     chains.back().pop_back();
 
@@ -217,7 +236,7 @@ void TrailCoreInKernelAtC::removePoint(bool fromKnotSlice)
 void TrailCoreInKernelAtC::convertKnotPointToOrbitalPoint()
 {
     // The point pB is assumed to be the only point in its knot.
-    BitPosition pB = chains.back().back();
+    BitPosition pB = chains.back().back().getBitPosition();
 
     knotPointAddedKnot.pop(); // Popped because addPoint(toKnotSlice=false) does not push onto knotPointAddedKnot.
     knots.erase(pB.z);
@@ -255,7 +274,7 @@ bool TrailCoreInKernelAtC::mayBeStartPointSliceAndGoThere(unsigned int& z, bool
 
 unsigned int TrailCoreInKernelAtC::computeLowerWeightAssumingVortexIsAdded()
 {
-    const VortexInfo& v = vortexBase[outCore.back().vortexLength/2][outCore.back().vortexIndex];
+    const VortexInfo& v = (*vortexBase)[outCore.back().vortexLength/2][outCore.back().vortexIndex];
 
     unsigned int localNrActiveRowsAtA = max(outCore.back().nrActiveRowsAtA, v.nrActiveRowsAtA);
     unsigned int localLowerWeight = getLowerBoundOnReverseWeightGivenHammingWeightAndNrActiveRows(
@@ -292,8 +311,8 @@ bool TrailCoreInKernelAtC::next()
                 workCoreInfo.partialStateAtC[it->first] = getMinimumInKernelSliceAfterChi(workCoreInfo.partialStateAtC[it->first]);
                 it++;
             }
-            vector<SliceValue> localStateAtD(laneSize);
-            directLambdaAfterTheta(workCoreInfo.partialStateAtC,localStateAtD);
+            FixedStateAsSlices localStateAtD;
+            directLambdaAfterTheta(FixedStateAsSlices(workCoreInfo.partialStateAtC),localStateAtD);
             workCoreInfo.hammingWeightAtD = getHammingWeight(localStateAtD);
             workCoreInfo.nrActiveRowsAtD = getNrActiveRows(localStateAtD);
             workCoreInfo.partialWeight = getMinReverseWeight(stateAtA) + workCoreInfo.weightAtB + getWeight(localStateAtD);
@@ -304,13 +323,17 @@ bool TrailCoreInKernelAtC::next()
             outCore.push_back(workCoreInfo);
             if (outCore.back().partialWeight <= maxWeight)
                 return true;
-            else
+            else {
+                countSearchEvent(statistics, SearchStatistics::prunedByCost, (unsigned int)chains.size());
                 outCore.pop_back();
+            }
         }
+        else if (outCore.back().vortexLength/2 >= vortexBase->size())
+            outCore.pop_back(); // no vortex fits within maxWeight, e.g., for large lane sizes
         else {
             bool foundGoodVortexToAdd = true;
             if ((!knots.empty() || (outCore.size() > 1)) && // In absence of knots, the first vortex has a fixed position: vortexZOffset = 0
-                    (outCore.back().vortexIndex < vortexBase[outCore.back().vortexLength/2].size()) &&  // vortexIndex must point to an existing entry
+                    (outCore.back().vortexIndex < (*vortexBase)[outCore.back().vortexLength/2].size()) &&  // vortexIndex must point to an existing entry
                     (outCore.back().vortexZOffset < laneSize-1)) {
                 outCore.back().vortexZOffset += 1;
                 if ((outCore.size() > 1) &&
@@ -320,9 +343,13 @@ bool TrailCoreInKernelAtC::next()
                     for (unsigned int i=0 ; i<outCore.size() ; i++)
                         zPattern[outCore[i].vortexZOffset] = 1;
                     foundGoodVortexToAdd = isMinimalSymmetrically(zPattern);
+                    if (!foundGoodVortexToAdd) {
+                        countSearchEvent(statistics, SearchStatistics::childrenGenerated, getSearchDepth() + 1);
+                        countSearchEvent(statistics, SearchStatistics::prunedByCanonicity, getSearchDepth() + 1);
+                    }
                 }
             }
-            else if ((int)outCore.back().vortexIndex < (int)vortexBase[outCore.back().vortexLength/2].size()-1) {
+            else if ((int)outCore.back().vortexIndex < (int)(*vortexBase)[outCore.back().vortexLength/2].size()-1) {
                 outCore.back().vortexZOffset = 0;
                 outCore.back().vortexIndex += 1;
             }
@@ -330,34 +357,40 @@ bool TrailCoreInKernelAtC::next()
                 outCore.back().vortexZOffset = 0;
                 outCore.back().vortexIndex = 0;
                 outCore.back().vortexLength += 2;
-                if (outCore.back().vortexLength/2 >= vortexBase.size()) {
+                if (outCore.back().vortexLength/2 >= vortexBase->size()) {
                     outCore.pop_back();
                     foundGoodVortexToAdd = false;
                 }
-                else if (vortexBase[outCore.back().vortexLength/2].empty())
+                else if ((*vortexBase)[outCore.back().vortexLength/2].empty())
                     foundGoodVortexToAdd = false;
                 else if (outCore.back().partialWeight + 2*outCore.back().vortexLength > maxWeight) {
+                    countSearchEvent(statistics, SearchStatistics::prunedByCost, getSearchDepth() + 1);
                     outCore.pop_back();
                     foundGoodVortexToAdd = false;
                 }
             }
 
             if (foundGoodVortexToAdd) {
+                countSearchEvent(statistics, SearchStatistics::childrenGenerated, getSearchDepth() + 1);
                 foundGoodVortexToAdd = foundGoodVortexToAdd && (computeLowerWeightAssumingVortexIsAdded() <= maxWeight);
-                const VortexInfo& v = vortexBase[outCore.back().vortexLength/2][outCore.back().vortexIndex];
+                if (!foundGoodVortexToAdd)
+                    countSearchEvent(statistics, SearchStatistics::prunedByCost, getSearchDepth() + 1);
+                const VortexInfo& v = (*vortexBase)[outCore.back().vortexLength/2][outCore.back().vortexIndex];
                 if (foundGoodVortexToAdd) { // Now test the vortex to add for overlap with the state up to now and its tabooAtB
-                    map<unsigned int,SliceValue>::const_iterator it = v.stateAtB.slices.begin();
-                    while (foundGoodVortexToAdd && (it != v.stateAtB.slices.end())){
+                    SparseStateAsSlices::const_iterator it = v.stateAtB.begin();
+                    while (foundGoodVortexToAdd && (it != v.stateAtB.end())){
                         unsigned int localZ = ((it->first)+outCore.back().vortexZOffset)%laneSize;
                         foundGoodVortexToAdd = (outCore.back().stateAtB[localZ] == 0);
                         foundGoodVortexToAdd = foundGoodVortexToAdd  && (((tabooAtB[localZ])&(it->second)) == 0);
                         it++;
                     }
+                    if (!foundGoodVortexToAdd)
+                        countSearchEvent(statistics, SearchStatistics::prunedByShape, getSearchDepth() + 1);
                 }
                 if (foundGoodVortexToAdd) { // Now really adding the vortex
                     outCore.push_back(outCore.back());
-                    map<unsigned int,SliceValue>::const_iterator it = v.stateAtB.slices.begin();
-                    while (it != v.stateAtB.slices.end()){
+                    SparseStateAsSlices::const_iterator it = v.stateAtB.begin();
+                    while (it != v.stateAtB.end()){
                         unsigned int localZ = ((it->first)+outCore.back().vortexZOffset)%laneSize;
                         outCore.back().stateAtB[localZ] = it->second;
                         outCore.back().partialStateAtC[localZ] = it->second;
@@ -365,21 +398,25 @@ bool TrailCoreInKernelAtC::next()
                     }
                     outCore.back().weightAtB += 2*outCore.back().vortexLength;
 
-                    vector<SliceValue> localStateAtA(laneSize);
-                    reverseLambda(outCore.back().stateAtB,localStateAtA);
+                    FixedStateAsSlices localStateAtA;
+                    reverseLambda(FixedStateAsSlices(outCore.back().stateAtB),localStateAtA);
                     outCore.back().hammingWeightAtA = getHammingWeight(localStateAtA);
                     outCore.back().nrActiveRowsAtA = getNrActiveRows(localStateAtA);
 
-                    vector<SliceValue> localStateAtD(laneSize);
-                    directLambdaAfterTheta(outCore.back().partialStateAtC,localStateAtD);
+                    FixedStateAsSlices localStateAtD;
+                    directLambdaAfterTheta(FixedStateAsSlices(outCore.back().partialStateAtC),localStateAtD);
 
                     outCore.back().hammingWeightAtD = getHammingWeight(localStateAtD);
                     outCore.back().nrActiveRowsAtD = getNrActiveRows(localStateAtD);
                     outCore.back().partialWeight = getMinReverseWeight(localStateAtA) + outCore.back().weightAtB + getWeight(localStateAtD);
-                    if (outCore.back().partialWeight > maxWeight)
+                    if (outCore.back().partialWeight > maxWeight) {
+                        countSearchEvent(statistics, SearchStatistics::prunedByCost, getSearchDepth());
                         outCore.pop_back();
-                    else
+                    }
+                    else {
+                        countSearchEvent(statistics, SearchStatistics::nodesVisited, getSearchDepth());
                         return true;
+                    }
                 }
             }
         }
@@ -387,11 +424,71 @@ bool TrailCoreInKernelAtC::next()
     while(true);
 }
 
+void TrailCoreInKernelAtC::appendIterationState(vector<UINT64>& cursor) const
+{
+    TrailCore3Rounds::appendIterationState(cursor);
+    appendToCursor(cursor, partialStateAtD);
+    cursor.push_back(weightAtB);
+    cursor.push_back(knotPointDeficit);
+    cursor.push_back(knotWeightAtBDeficit);
+    cursor.push_back(partialHammingWeightAtD);
+    cursor.push_back(partialNrActiveRowsAtD);
+    cursor.push_back(outCore.size());
+    for(unsigned int i=0; i<outCore.size(); i++) {
+        const CoreInfo& info = outCore[i];
+        cursor.push_back(info.hammingWeightAtA);
+        cursor.push_back(info.nrActiveRowsAtA);
+        appendToCursor(cursor, info.stateAtB);
+        cursor.push_back(info.weightAtB);
+        appendToCursor(cursor, info.partialStateAtC);
+        cursor.push_back(info.hammingWeightAtD);
+        cursor.push_back(info.nrActiveRowsAtD);
+        cursor.push_back(info.partialWeight);
+        cursor.push_back(info.vortexLength);
+        cursor.push_back(info.vortexIndex);
+        cursor.push_back(info.vortexZOffset);
+    }
+}
+
+void TrailCoreInKernelAtC::readIterationState(const vector<UINT64>& cursor, size_t& position)
+{
+    TrailCore3Rounds::readIterationState(cursor, position);
+    readFromCursor(cursor, position, partialStateAtD);
+    weightAtB = (unsigned int)readFromCursor(cursor, position);
+    knotPointDeficit = (unsigned int)readFromCursor(cursor, position);
+    knotWeightAtBDeficit = (unsigned int)readFromCursor(cursor, position);
+    partialHammingWeightAtD = (unsigned int)readFromCursor(cursor, position);
+    partialNrActiveRowsAtD = (unsigned int)readFromCursor(cursor, position);
+    outCore.resize((size_t)readFromCursor(cursor, position));
+    for(unsigned int i=0; i<outCore.size(); i++) {
+        CoreInfo& info = outCore[i];
+        info.hammingWeightAtA = (unsigned int)readFromCursor(cursor, position);
+        info.nrActiveRowsAtA = (unsigned int)readFromCursor(cursor, position);
+        readFromCursor(cursor, position, info.stateAtB);
+        info.weightAtB = (unsigned int)readFromCursor(cursor, position);
+        readFromCursor(cursor, position, info.partialStateAtC);
+        info.hammingWeightAtD = (unsigned int)readFromCursor(cursor, position);
+        info.nrActiveRowsAtD = (unsigned int)readFromCursor(cursor, position);
+        info.partialWeight = (unsigned int)readFromCursor(cursor, position);
+        info.vortexLength = (unsigned int)readFromCursor(cursor, position);
+        info.vortexIndex = (unsigned int)readFromCursor(cursor, position);
+        info.vortexZOffset = (unsigned int)readFromCursor(cursor, position);
+    }
+}
+
 const TrailCoreInKernelAtC::CoreInfo& TrailCoreInKernelAtC::getTopCoreInfo() const
 {
     return outCore.back();
 }
 
+void TrailCoreInKernelAtC::setPartition(unsigned int aPartIndex, unsigned int aNrParts)
+{
+    TrailCore3Rounds::setPartition(aPartIndex, aNrParts);
+    // The vortices without knots, set up by the constructor, belong to root 0.
+    if (!isRootInPart(0))
+        outCore.clear();
+}
+
 ostream& operator<<(ostream& fout, const TrailCoreInKernelAtC& aL)
 {
     for(unsigned int chainNr = 0 ; chainNr < aL.chains.size() ; chainNr++) {
@@ -420,3 +517,105 @@ ostream& operator<<(ostream& fout, const TrailCoreInKernelAtC& aL)
     fout << endl;
     return fout;
 }
+
+ParallelTrailCoreInKernelAtC::ParallelTrailCoreInKernelAtC(const vector<SliceValue>& backgroundAtA,
+                                                           const vector<SliceValue>& aTabooAtB,
+                                                           unsigned int aMaxWeight,
+                                                           const KeccakFDCLC& aParent,
+                                                           KeccakFPropagation::DCorLC aDCorLC,
+                                                           unsigned int aNrThreads,
+                                                           unsigned int aMaxBuffered) :
+    prototype(backgroundAtA, aTabooAtB, aMaxWeight, aParent, aDCorLC),
+    nrThreads(aNrThreads > 0 ? aNrThreads : max(1U, thread::hardware_concurrency())),
+    maxBuffered(aMaxBuffered > 0 ? aMaxBuffered : 1), statistics(0)
+{
+}
+
+void ParallelTrailCoreInKernelAtC::run(const Output& output)
+{
+    // Each part keeps its trail cores, with their root index, until they are merged.
+    // As a part generates its roots in increasing order, all its roots below
+    // reachedRoot[part] are complete.
+    vector<deque<pair<UINT64, TrailCoreInKernelAtC::CoreInfo> > > buffered(nrThreads);
+    vector<UINT64> reachedRoot(nrThreads, 0);
+    vector<bool> finished(nrThreads, false);
+    bool stop = false;
+    exception_ptr failure;
+    mutex lock;
+    condition_variable changed;
+
+    vector<SearchStatistics> partStatistics(statistics != 0 ? nrThreads : 0);
+
+    vector<thread> threads;
+    for(unsigned int part=0; part<nrThreads; part++)
+        threads.push_back(thread([&, part]() {
+            try {
+                TrailCoreInKernelAtC iterator(prototype);
+                iterator.setPartition(part, nrThreads);
+                iterator.setStatistics(statistics != 0 ? &partStatistics[part] : 0);
+                while(iterator.next()) {
+                    unique_lock<mutex> guard(lock);
+                    changed.wait(guard, [&]() { return stop || (buffered[part].size() < maxBuffered); });
+                    if (stop)
+                        break;
+                    buffered[part].push_back(make_pair(iterator.getRootIndex(), iterator.getTopCoreInfo()));
+                    reachedRoot[part] = iterator.getRootIndex();
+                    changed.notify_all();
+                }
+            }
+            catch(...) {
+                lock_guard<mutex> guard(lock);
+                if (!failure)
+                    failure = current_exception();
+                stop = true;
+            }
+            lock_guard<mutex> guard(lock);
+            finished[part] = true;
+            changed.notify_all();
+        }));
+
+    try {
+        UINT64 root = 0;
+        unique_lock<mutex> guard(lock);
+        while(!stop) {
+            unsigned int part = (unsigned int)(root % nrThreads);
+            changed.wait(guard, [&]() { return stop || !buffered[part].empty() || finished[part] || (reachedRoot[part] > root); });
+            if (stop)
+                break;
+            if ((!buffered[part].empty()) && (buffered[part].front().first == root)) {
+                TrailCoreInKernelAtC::CoreInfo core(buffered[part].front().second);
+                buffered[part].pop_front();
+                changed.notify_all();
+                guard.unlock();
+                output(core);
+                guard.lock();
+            }
+            else {
+                // The root is complete: move to the next one, unless all the parts are done.
+                unsigned int nrFinished = 0;
+                bool nothingLeft = true;
+                for(unsigned int i=0; i<nrThreads; i++) {
+                    if (finished[i])
+                        nrFinished++;
+                    nothingLeft = nothingLeft && buffered[i].empty();
+                }
+                if ((nrFinished == nrThreads) && nothingLeft)
+                    break;
+                root++;
+            }
+        }
+    }
+    catch(...) {
+        lock_guard<mutex> guard(lock);
+        if (!failure)
+            failure = current_exception();
+        stop = true;
+        changed.notify_all();
+    }
+    for(unsigned int i=0; i<threads.size(); i++)
+        threads[i].join();
+    for(unsigned int i=0; i<partStatistics.size(); i++)
+        statistics->add(partStatistics[i]);
+    if (failure)
+        rethrow_exception(failure);
+}
@@ -20,6 +20,7 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include "Keccak-fTrailCore3Rounds.h"
 #include "Keccak-fState.h"
 #include "Keccak-fDCLC.h"
+#include <functional>
 #include <stack>
 #include <set>
 
@@ -61,6 +62,7 @@ protected:
       */
     unsigned int partialNrActiveRowsAtD;
 
+public:
     /** This struct groups data elements useful when adding vortices.
       */
     struct CoreInfo {
@@ -99,12 +101,17 @@ protected:
         unsigned int vortexZOffset;
     };
 
+protected:
     /** This attribute keeps track of the iteration, in the light of adding vortices.
       * When a vortex is added, a new entry is pushed back.
       * The first element contains a state with knots or an empty state.
       */
     vector<CoreInfo> outCore;
 
+    /** This method initializes the iteration, common to the constructors.
+      * @param   backgroundAtA  The background at A.
+      */
+    void initializeIterator(const vector<SliceValue>& backgroundAtA);
 
 protected:
 
@@ -146,6 +153,20 @@ protected:
       */
     unsigned int computeLowerWeightAssumingVortexIsAdded();
 
+    /** See TrailCore3Rounds::appendIterationState().
+      */
+    void appendIterationState(vector<UINT64>& cursor) const;
+
+    /** See TrailCore3Rounds::readIterationState().
+      */
+    void readIterationState(const vector<UINT64>& cursor, size_t& position);
+
+    /** This method returns the depth of the current trail core for the statistics,
+      * i.e., its number of chains and vortices, see TrailCore3Rounds::setStatistics().
+      * It assumes that outCore is not empty.
+      */
+    unsigned int getSearchDepth() const { return (unsigned int)(chains.size() + outCore.size() - 1); }
+
 public:
 
     /** Constructor that initializes the attributes.
@@ -161,6 +182,18 @@ public:
                     const KeccakFDCLC& aParent,
                     KeccakFPropagation::DCorLC aDCorLC);
 
+    /** Constructor that initializes the attributes, sharing the propagation tables of an existing instance.
+      * An initial call to next() is necessary for having the first valid state.
+      * @param   backgroundAtA  The background at A.
+      * @param   aTabooAtB      State indicating the bits at B where no active points may be put.
+      * @param   aMaxWeight     The maximum propagation weight up to which one must generate all states.
+      * @param   aDCorLC        The propagation context, whose tables are shared.
+      */
+    TrailCoreInKernelAtC(const vector<SliceValue>& backgroundAtA,
+                    const vector<SliceValue>& aTabooAtB,
+                    unsigned int aMaxWeight,
+                    const KeccakFPropagation& aDCorLC);
+
     /** This method generates the next three-round trail core inside the kernel at C with weight not above maxWeight.
       * @return  Whether a trail core was found.
       */
@@ -170,9 +203,68 @@ public:
      */
     const CoreInfo& getTopCoreInfo() const;
 
+    /** See TrailCore3Rounds::setPartition().
+      */
+    void setPartition(unsigned int aPartIndex, unsigned int aNrParts);
+
     /** This function displays the attributes of the TrailCoreInKernelAtC object.
       */
     friend ostream& operator<<(ostream& fout, const TrailCoreInKernelAtC& aL);
 };
 
+/** Class that generates the three-round trail cores of TrailCoreInKernelAtC with several threads.
+  * Each thread runs a copy of the same iterator restricted to a part of the roots,
+  * see TrailCore3Rounds::setPartition(), with the roots dealt to the threads in turn.
+  * The trail cores found by the threads are merged in the order of their roots,
+  * so they are output in the same order as with a single TrailCoreInKernelAtC.
+  */
+class ParallelTrailCoreInKernelAtC {
+public:
+    /** The type of the function called for each trail core, with the information at the top of the iterator,
+      * see TrailCoreInKernelAtC::getTopCoreInfo().
+      */
+    typedef function<void(const TrailCoreInKernelAtC::CoreInfo& core)> Output;
+protected:
+    /** The iterator copied by each thread. */
+    TrailCoreInKernelAtC prototype;
+    /** The number of threads. */
+    unsigned int nrThreads;
+    /** The maximum number of trail cores a thread keeps waiting to be merged before it pauses. */
+    unsigned int maxBuffered;
+    /** Where to add the events counted by the threads, or null, see setStatistics(). */
+    SearchStatistics *statistics;
+public:
+    /** Constructor that initializes the iterator with the same parameters as TrailCoreInKernelAtC.
+      * @param   backgroundAtA  The background at A.
+      * @param   aTabooAtB      State indicating the bits at B where no active points may be put.
+      * @param   aMaxWeight     The maximum propagation weight up to which one must generate all states.
+      * @param   aParent        Reference to the KeccakFDCLC instance defining laneSize.
+      * @param   aDCorLC        Whether the trail cores are DC or LC.
+      * @param   aNrThreads     The number of threads, or 0 to use the number of hardware threads.
+      * @param   aMaxBuffered   The maximum number of trail cores a thread keeps waiting to be merged.
+      */
+    ParallelTrailCoreInKernelAtC(const vector<SliceValue>& backgroundAtA,
+                    const vector<SliceValue>& aTabooAtB,
+                    unsigned int aMaxWeight,
+                    const KeccakFDCLC& aParent,
+                    KeccakFPropagation::DCorLC aDCorLC,
+                    unsigned int aNrThreads = 0,
+                    unsigned int aMaxBuffered = 1 << 16);
+    /** This method returns the number of threads.
+      * @return The number of threads.
+      */
+    unsigned int getNumberOfThreads() const { return nrThreads; }
+    /** This method sets where to add the events of the search, see TrailCore3Rounds::setStatistics().
+      * Each thread counts in its own object, which are added to @a aStatistics at the end of run().
+      * @param   aStatistics    The object to add the counts to, or null not to count.
+      */
+    void setStatistics(SearchStatistics *aStatistics) { statistics = aStatistics; }
+    /** This method generates all the trail cores and calls @a output for each of them
+      * from the calling thread, in the order of the sequential iteration.
+      * If a thread throws an exception, the others stop and the exception is thrown again from this method.
+      * @param   output     The function called for each trail core.
+      */
+    void run(const Output& output);
+};
+
 #endif
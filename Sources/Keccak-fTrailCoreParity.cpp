@@ -13,12 +13,15 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <sstream>
 #include <stack>
 #include <time.h>
+#include "Keccak-fParityBounds.h"
 #include "Keccak-fTrailCoreParity.h"
+#include "workStealing.h"
 
 bool OrbitalPosition::first(const vector<unsigned int>& yMin, unsigned int laneSize)
 {
@@ -579,3 +582,35 @@ void KeccakFTwoRoundTrailCoreWithGivenParityIterator::getTrail()
     trail.setFirstStateReverseMinimumWeight(DCorLC.getMinReverseWeight(stack_stateAtA.top()));
     trail.append(stack_stateAtB.top(), DCorLC.getWeight(stack_stateAtB.top()));
 }
+
+void generateTwoRoundTrailCoresWithGivenParities(const KeccakFPropagation& DCorLC,
+    const vector<vector<RowValue> >& parities, int maxWeight, TrailFetcher& trailsOut,
+    bool orbitals, unsigned int nrThreads)
+{
+    vector<pair<unsigned int, size_t> > schedule;
+    ParityBoundsTables tables(DCorLC);
+    for(size_t i=0; i<parities.size(); i++) {
+        vector<RowValue> D;
+        DCorLC.directThetaEffectFromParities(parities[i], D);
+        unsigned int minActiveRows = getLowerBoundTotalActiveRows(tables, parities[i], D);
+        if ((int)(2*minActiveRows) <= maxWeight)
+            schedule.push_back(make_pair(minActiveRows, i));
+    }
+    sort(schedule.begin(), schedule.end());
+
+    TrailFetcherSynchronized trailsOutSynchronized(trailsOut);
+    WorkStealingPool pool(nrThreads);
+    size_t next = 0;
+    pool.run([&](WorkStealingPool::Task& task) -> bool {
+        if (next >= schedule.size())
+            return false;
+        const vector<RowValue>& parity = parities[schedule[next].second];
+        next++;
+        task = [&DCorLC, &parity, maxWeight, orbitals, &trailsOutSynchronized](unsigned int) {
+            KeccakFTwoRoundTrailCoreWithGivenParityIterator i(DCorLC, parity, maxWeight, orbitals);
+            for( ; !i.isEnd(); ++i)
+                trailsOutSynchronized.fetchTrail(*i);
+        };
+        return true;
+    });
+}
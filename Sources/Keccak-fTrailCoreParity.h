@@ -210,4 +210,26 @@ protected:
     void getTrail();
 };
 
+/** This function generates the 2-round trail cores of
+  * KeccakFTwoRoundTrailCoreWithGivenParityIterator for each of the given parities,
+  * with one task per parity processed by a WorkStealingPool.
+  * The parities are scheduled by increasing lower bound on the total number of
+  * active rows, see ::getLowerBoundTotalActiveRows(), so that the parities
+  * leaving the most weight for the bits outside the parity, which tend to have
+  * the most trail cores, start first and the last tasks are short.
+  * A parity whose bound on the weight, i.e., twice this number of rows,
+  * exceeds @a maxWeight has no trail core within the budget and is skipped.
+  * The trail cores are given to @a trailsOut one at a time, in no particular order.
+  * @param   DCorLC The propagation context of the trails,
+  *                 as a reference to a KeccakFPropagation object.
+  * @param  parities    The parities, each as a vector of row values, e.g., read with readParity().
+  * @param  maxWeight   The maximum trail core weight w(a)+w<sup>rev</sup>(λ<sup>-1</sup>(a)).
+  * @param  trailsOut   Where to give the trail cores.
+  * @param  orbitals    See KeccakFTrailWithGivenParityIterator::KeccakFTrailWithGivenParityIterator().
+  * @param  nrThreads   The number of threads, or 0 to use the number of hardware threads.
+  */
+void generateTwoRoundTrailCoresWithGivenParities(const KeccakFPropagation& DCorLC,
+    const vector<vector<RowValue> >& parities, int maxWeight, TrailFetcher& trailsOut,
+    bool orbitals = true, unsigned int nrThreads = 0);
+
 #endif
\ No newline at end of file
@@ -13,30 +13,231 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include "Keccak-fTrailCoreRows.h"
 
+/** This class passes the candidate states from the enumeration to worker threads that filter them.
+  * The states are grouped in batches, stored one after the other in a vector of slices,
+  * and the queue holds a bounded number of batches,
+  * so that the enumeration waits when the workers lag behind.
+  */
+class CandidateStatesQueue {
+public:
+    typedef function<void(TrailFetcher& trailsOut, const vector<SliceValue>& state)> Filter;
+protected:
+    TrailFetcherSynchronized trailsOut;
+    Filter filter;
+    unsigned int laneSize;
+    vector<SliceValue> batch;
+    deque<vector<SliceValue> > batches;
+    unsigned int maxNrBatches;
+    unsigned int nrBusy;
+    bool closed;
+    exception_ptr failure;
+    mutex lock;
+    condition_variable changed;
+    vector<thread> threads;
+    static const unsigned int batchSize = 256;
+public:
+    CandidateStatesQueue(unsigned int nrThreads, unsigned int aLaneSize, TrailFetcher& aTrailsOut, const Filter& aFilter)
+        : trailsOut(aTrailsOut), filter(aFilter), laneSize(aLaneSize), nrBusy(0), closed(false)
+    {
+        if (nrThreads == 0)
+            nrThreads = max(1U, thread::hardware_concurrency());
+        maxNrBatches = 4*nrThreads;
+        for(unsigned int i=0; i<nrThreads; i++)
+            threads.push_back(thread(&CandidateStatesQueue::work, this));
+    }
+    ~CandidateStatesQueue()
+    {
+        close();
+    }
+    /** This method queues a candidate state. */
+    void push(const vector<SliceValue>& state)
+    {
+        batch.insert(batch.end(), state.begin(), state.end());
+        if (batch.size() >= batchSize*laneSize)
+            flush();
+    }
+    /** This method waits until all the candidate states queued so far are filtered,
+      * e.g., before a checkpoint records the states processed.
+      */
+    void drain()
+    {
+        flush();
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [this]() { return failure || (batches.empty() && (nrBusy == 0)); });
+        if (failure)
+            rethrow_exception(failure);
+    }
+    /** This method filters the remaining candidate states and stops the workers.
+      * If a worker failed, its exception is thrown again.
+      */
+    void finish()
+    {
+        flush();
+        close();
+        if (failure)
+            rethrow_exception(failure);
+    }
+protected:
+    void flush()
+    {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [this]() { return failure || (batches.size() < maxNrBatches); });
+        if (failure)
+            rethrow_exception(failure);
+        if (!batch.empty()) {
+            batches.push_back(vector<SliceValue>());
+            batches.back().swap(batch);
+            batch.reserve(batchSize*laneSize);
+            changed.notify_all();
+        }
+    }
+    void close()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            closed = true;
+            changed.notify_all();
+        }
+        for(unsigned int i=0; i<threads.size(); i++)
+            threads[i].join();
+        threads.clear();
+    }
+    void work()
+    {
+        unique_lock<mutex> guard(lock);
+        while(true) {
+            changed.wait(guard, [this]() { return closed || failure || !batches.empty(); });
+            if (failure || batches.empty())
+                return;
+            vector<SliceValue> states;
+            states.swap(batches.front());
+            batches.pop_front();
+            nrBusy++;
+            changed.notify_all();
+            guard.unlock();
+            try {
+                vector<SliceValue> state(laneSize);
+                for(size_t i=0; i<states.size(); i+=laneSize) {
+                    copy(states.begin()+i, states.begin()+i+laneSize, state.begin());
+                    filter(trailsOut, state);
+                }
+            }
+            catch(...) {
+                guard.lock();
+                if (!failure)
+                    failure = current_exception();
+                nrBusy--;
+                changed.notify_all();
+                return;
+            }
+            guard.lock();
+            nrBusy--;
+            changed.notify_all();
+        }
+    }
+};
+
 KeccakFTrailCoreRows::KeccakFTrailCoreRows(const KeccakFDCLC& aParent, KeccakFPropagation::DCorLC aDCorLC)
-    : KeccakFPropagation(aParent, aDCorLC)
+    : KeccakFPropagation(aParent, aDCorLC), nrThreads(1), checkpoint(0), nrSteps(0), nrStepsToSkip(0), candidates(0)
 {
 }
 
+KeccakFTrailCoreRows::KeccakFTrailCoreRows(const KeccakFPropagation& aDCorLC)
+    : KeccakFPropagation(aDCorLC), nrThreads(1), checkpoint(0), nrSteps(0), nrStepsToSkip(0), candidates(0)
+{
+}
+
+void KeccakFTrailCoreRows::setCheckpoint(SearchCheckpoint *aCheckpoint)
+{
+    checkpoint = aCheckpoint;
+}
+
+void KeccakFTrailCoreRows::startSteps()
+{
+    nrSteps = 0;
+    nrStepsToSkip = 0;
+    if ((checkpoint != 0) && checkpoint->isResuming()) {
+        if (checkpoint->getCursor().size() != 1)
+            throw KeccakException("The checkpoint was not made by KeccakFTrailCoreRows.");
+        nrStepsToSkip = checkpoint->getCursor()[0];
+    }
+}
+
+bool KeccakFTrailCoreRows::startStep()
+{
+    UINT64 step = nrSteps++;
+    if (step < nrStepsToSkip)
+        return false;
+    if ((checkpoint != 0) && checkpoint->isDue()) {
+        // The states before this one must be fully processed when the checkpoint records them as such.
+        if (candidates != 0)
+            candidates->drain();
+        checkpoint->save(vector<UINT64>(1, step));
+    }
+    return true;
+}
+
 void KeccakFTrailCoreRows::generateTrailCoresBasedOnRows(TrailFetcher& trailsOut, int maxNrRowsAtA, int maxNrRowsAtB, unsigned int maxWeight)
 {
     if ((maxNrRowsAtA > 3) && (maxNrRowsAtB > 3))
         throw KeccakException("This method generates up to 3 rows only.");
-    generateTrailCoresBasedOnRows(trailsOut, (maxNrRowsAtA < maxNrRowsAtB), maxNrRowsAtA, maxNrRowsAtB, maxWeight);
+    bool startingFromA = (maxNrRowsAtA < maxNrRowsAtB);
+    if (nrThreads == 1)
+        generateTrailCoresBasedOnRows(trailsOut, startingFromA, maxNrRowsAtA, maxNrRowsAtB, maxWeight);
+    else {
+        CandidateStatesQueue queue(nrThreads, laneSize, trailsOut, [=](TrailFetcher& out, const vector<SliceValue>& state) {
+            checkTrailCore(out, state, startingFromA, maxNrRowsAtA, maxNrRowsAtB, maxWeight);
+        });
+        candidates = &queue;
+        try {
+            generateTrailCoresBasedOnRows(trailsOut, startingFromA, maxNrRowsAtA, maxNrRowsAtB, maxWeight);
+            queue.finish();
+        }
+        catch(...) {
+            candidates = 0;
+            throw;
+        }
+        candidates = 0;
+    }
 }
 
 void KeccakFTrailCoreRows::generateTrailCoresUpToGivenWeight(TrailFetcher& trailsOut, unsigned int maxMinRevWeightAtA, unsigned int maxWeightAtB, unsigned int maxWeight)
 {
     if ((maxMinRevWeightAtA > 7) && (maxWeightAtB > 7))
         throw KeccakException("This method generates up to 3 rows only.");
-    generateTrailCoresUpToGivenWeight(trailsOut, (maxMinRevWeightAtA < maxWeightAtB), maxMinRevWeightAtA, maxWeightAtB, maxWeight);
+    bool startingFromA = (maxMinRevWeightAtA < maxWeightAtB);
+    if (nrThreads == 1)
+        generateTrailCoresUpToGivenWeight(trailsOut, startingFromA, maxMinRevWeightAtA, maxWeightAtB, maxWeight);
+    else {
+        CandidateStatesQueue queue(nrThreads, laneSize, trailsOut, [=](TrailFetcher& out, const vector<SliceValue>& state) {
+            checkTrailCoreUpToGivenWeight(out, state, startingFromA, maxMinRevWeightAtA, maxWeightAtB, maxWeight);
+        });
+        candidates = &queue;
+        try {
+            generateTrailCoresUpToGivenWeight(trailsOut, startingFromA, maxMinRevWeightAtA, maxWeightAtB, maxWeight);
+            queue.finish();
+        }
+        catch(...) {
+            candidates = 0;
+            throw;
+        }
+        candidates = 0;
+    }
 }
 
 void KeccakFTrailCoreRows::generateTrailCoresBasedOnRows(TrailFetcher& trailsOut, bool startingFromA, int maxNrRowsAtA, int maxNrRowsAtB, unsigned int maxWeight)
 {
+    startSteps();
     int maxNrRows = (startingFromA ? maxNrRowsAtA : maxNrRowsAtB);
     if (maxNrRows >= 1) {
         const unsigned int z = 0;
@@ -106,6 +307,7 @@ void KeccakFTrailCoreRows::generateTrailCoresBasedOnRows(TrailFetcher& trailsOut
 
 void KeccakFTrailCoreRows::generateTrailCoresUpToGivenWeight(TrailFetcher& trailsOut, bool startingFromA, unsigned int maxMinRevWeightAtA, unsigned int maxWeightAtB, unsigned int maxWeight)
 {
+    startSteps();
     int maxMinRevWeightAtAorB = (startingFromA ? maxMinRevWeightAtA : maxWeightAtB);
     int maxNrRows = maxMinRevWeightAtAorB/2;
     if (maxNrRows >= 1) {
@@ -198,6 +400,16 @@ void KeccakFTrailCoreRows::generateTrailCoresUpToGivenWeight(TrailFetcher& trail
 }
 
 void KeccakFTrailCoreRows::filterGeneratedTrailCores(TrailFetcher& trailsOut, const vector<SliceValue>& stateAtAorB, bool stateAtA, unsigned int maxNrRowsAtA, unsigned int maxNrRowsAtB, unsigned int maxWeight)
+{
+    if (!startStep())
+        return;
+    if (candidates != 0)
+        candidates->push(stateAtAorB);
+    else
+        checkTrailCore(trailsOut, stateAtAorB, stateAtA, maxNrRowsAtA, maxNrRowsAtB, maxWeight);
+}
+
+void KeccakFTrailCoreRows::checkTrailCore(TrailFetcher& trailsOut, const vector<SliceValue>& stateAtAorB, bool stateAtA, unsigned int maxNrRowsAtA, unsigned int maxNrRowsAtB, unsigned int maxWeight) const
 {
     vector<SliceValue> stateAtBorA;
     if (stateAtA) {
@@ -227,6 +439,16 @@ void KeccakFTrailCoreRows::filterGeneratedTrailCores(TrailFetcher& trailsOut, co
 }
 
 void KeccakFTrailCoreRows::filterGeneratedTrailCoresUpToGivenWeight(TrailFetcher& trailsOut, const vector<SliceValue>& stateAtAorB, bool stateAtA, unsigned int maxMinRevWeightAtA, unsigned int maxWeightAtB, unsigned int maxWeight)
+{
+    if (!startStep())
+        return;
+    if (candidates != 0)
+        candidates->push(stateAtAorB);
+    else
+        checkTrailCoreUpToGivenWeight(trailsOut, stateAtAorB, stateAtA, maxMinRevWeightAtA, maxWeightAtB, maxWeight);
+}
+
+void KeccakFTrailCoreRows::checkTrailCoreUpToGivenWeight(TrailFetcher& trailsOut, const vector<SliceValue>& stateAtAorB, bool stateAtA, unsigned int maxMinRevWeightAtA, unsigned int maxWeightAtB, unsigned int maxWeight) const
 {
     vector<SliceValue> stateAtBorA;
     if (stateAtA) {
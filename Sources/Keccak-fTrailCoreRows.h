@@ -17,20 +17,44 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #define _KECCAKFTRAILCOREROWS_H_
 
 #include "Keccak-fPropagation.h"
+#include "checkpoint.h"
 #include "Keccak-fTrails.h"
 #include "progress.h"
 
+class CandidateStatesQueue;
+
 /** This class contains a couple of methods to generate 2-round trail cores
   * by exhaustively generating all patterns with 1, 2 or 3 active rows.
   * This is exhaustive up to translation along the z axis.
   */
 class KeccakFTrailCoreRows : public KeccakFPropagation
 {
+public:
+    /** The number of threads used by generateTrailCoresBasedOnRows() and generateTrailCoresUpToGivenWeight().
+      * If 1 (the default), each candidate state is filtered as soon as it is enumerated.
+      * Otherwise, the enumeration puts the candidate states in a bounded queue,
+      * from which that many worker threads, or one per hardware thread if 0, filter them.
+      * In this case, the output trails come in no particular order.
+      */
+    unsigned int nrThreads;
 protected:
     ProgressMeter progress;
+    /** The checkpoint of the generation, if any. */
+    SearchCheckpoint *checkpoint;
+    /** The number of candidate states considered so far by the current generation. */
+    UINT64 nrSteps;
+    /** The number of candidate states already processed before resuming from the checkpoint. */
+    UINT64 nrStepsToSkip;
+    /** The queue to the worker threads during a generation with several threads, or null. */
+    CandidateStatesQueue *candidates;
 public:
     /** The constructor. See KeccakFPropagation::KeccakFPropagation(). */
     KeccakFTrailCoreRows(const KeccakFDCLC& aParent, KeccakFPropagation::DCorLC aDCorLC);
+    /** The constructor that shares the tables of an existing propagation context,
+      * see KeccakFPropagation::KeccakFPropagation(const KeccakFPropagation&).
+      * @param  aDCorLC The propagation context.
+      */
+    KeccakFTrailCoreRows(const KeccakFPropagation& aDCorLC);
     /** This method generates all 2-round trail cores up to a given weight,
       * constrained by the number of rows at A=λ<sup>-1</sup>(B) and at B.
       * The maximum number of rows that can be generated by this method is 3,
@@ -56,11 +80,23 @@ public:
       * @pre    @a maxMinRevWeightAtA ≤ 7 or @a maxWeightAtB ≤ 7.
       */
     void generateTrailCoresUpToGivenWeight(TrailFetcher& trailsOut, unsigned int maxMinRevWeightAtA, unsigned int maxWeightAtB, unsigned int maxWeight);
+    /** This method sets a checkpoint for the next generation, or removes it if @a aCheckpoint is null.
+      * The generation then periodically saves in it the number of candidate states processed,
+      * and, if the checkpoint was loaded from a file, it skips the candidate states processed before.
+      * The caller must open the output file with SearchCheckpoint::openOutput()
+      * and call SearchCheckpoint::complete() when the generation returns.
+      * @param  aCheckpoint     The checkpoint, which must remain valid during the generation.
+      */
+    void setCheckpoint(SearchCheckpoint *aCheckpoint);
 protected:
+    void startSteps();
+    bool startStep();
     void generateTrailCoresBasedOnRows(TrailFetcher& trailsOut, bool startingFromA, int maxNrRowsAtA, int maxNrRowsAtB, unsigned int maxWeight);
     void generateTrailCoresUpToGivenWeight(TrailFetcher& trailsOut, bool startingFromA, unsigned int maxMinRevWeightAtA, unsigned int maxWeightAtB, unsigned int maxWeight);
     void filterGeneratedTrailCores(TrailFetcher& trailsOut, const vector<SliceValue>& stateAtAorB, bool stateAtA, unsigned int maxNrRowsAtA, unsigned int maxNrRowsAtB, unsigned int maxWeight);
     void filterGeneratedTrailCoresUpToGivenWeight(TrailFetcher& trailsOut, const vector<SliceValue>& stateAtAorB, bool stateAtA, unsigned int maxMinRevWeightAtA, unsigned int maxWeightAtB, unsigned int maxWeight);
+    void checkTrailCore(TrailFetcher& trailsOut, const vector<SliceValue>& stateAtAorB, bool stateAtA, unsigned int maxNrRowsAtA, unsigned int maxNrRowsAtB, unsigned int maxWeight) const;
+    void checkTrailCoreUpToGivenWeight(TrailFetcher& trailsOut, const vector<SliceValue>& stateAtAorB, bool stateAtA, unsigned int maxMinRevWeightAtA, unsigned int maxWeightAtB, unsigned int maxWeight) const;
 };
 
 #endif
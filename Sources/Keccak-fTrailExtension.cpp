@@ -13,9 +13,21 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "Keccak-fTrailExtension.h"
+#include "Keccak-fTrailSort.h"
 #include "translationsymmetry.h"
+#include "workStealing.h"
 
 LowWeightExclusion::LowWeightExclusion()
 {
@@ -71,16 +83,14 @@ ostream& operator<<(ostream& out, const LowWeightExclusion& lwe)
 }
 
 KnownSmallWeightStates::KnownSmallWeightStates(const KeccakFPropagation& DCorLC, const string& fileName, int aMaxCompleteWeight)
-: maxCompleteWeight(aMaxCompleteWeight)
+: laneSize(0), nrStates(0), index(new vector<UINT64>()), maxCompleteWeight(aMaxCompleteWeight)
 {
-    statesAfterChiPerWeight.resize(maxCompleteWeight+1);
     loadFromFile(DCorLC, fileName);
 }
 
 KnownSmallWeightStates::KnownSmallWeightStates(int aMaxCompleteWeight)
-: maxCompleteWeight(aMaxCompleteWeight)
+: laneSize(0), nrStates(0), index(new vector<UINT64>()), maxCompleteWeight(aMaxCompleteWeight)
 {
-    statesAfterChiPerWeight.resize(maxCompleteWeight+1);
 }
 
 int KnownSmallWeightStates::getMaxCompleteWeight() const
@@ -88,72 +98,303 @@ int KnownSmallWeightStates::getMaxCompleteWeight() const
     return maxCompleteWeight;
 }
 
-void KnownSmallWeightStates::connect(const KeccakFPropagation& DCorLC, const vector<SliceValue>& inputState,
-    int maxWeightOut, vector<vector<SliceValue> >& compatibleStates) const
+UINT64 KnownSmallWeightStates::getNumberOfStates() const
 {
-    unsigned int inputNrRows = getNrActiveRows(inputState);
-    for(unsigned int weight=2; (weight<=(unsigned int)maxWeightOut) && (weight<statesAfterChiPerWeight.size()); weight++)
-        for(unsigned int i=0; i<statesAfterChiPerWeight[weight].size(); i++)
-            if (getNrActiveRows(statesAfterChiPerWeight[weight][i]) == inputNrRows)
-                connect(DCorLC, inputState, statesAfterChiPerWeight[weight][i], compatibleStates);
+    return nrStates;
+}
+
+UINT64 KnownSmallWeightStates::getKeyOfActiveRows(const vector<SliceValue>& state, unsigned int& dz, unsigned int& period)
+{
+    vector<unsigned char> rows(state.size());
+    for(unsigned int z=0; z<state.size(); z++) {
+        unsigned char activeRows = 0;
+        for(unsigned int y=0; y<5; y++)
+            if (getRowFromSlice(state[z], y) != 0)
+                activeRows |= 1 << y;
+        rows[z] = activeRows;
+    }
+    dz = getMinimalTranslation(rows);
+    vector<unsigned char> canonicalRows(rows.size());
+    for(unsigned int z=0; z<rows.size(); z++)
+        canonicalRows[(z+dz)%rows.size()] = rows[z];
+    period = getRotationPeriod(canonicalRows);
+    // FNV-1a
+    UINT64 key = 0xCBF29CE484222325ULL;
+    for(unsigned int z=0; z<canonicalRows.size(); z++) {
+        key ^= canonicalRows[z];
+        key *= 0x100000001B3ULL;
+    }
+    return key;
 }
 
 void KnownSmallWeightStates::connect(const KeccakFPropagation& DCorLC, const vector<SliceValue>& inputState,
-    const vector<SliceValue>& candidate, vector<vector<SliceValue> >& compatibleStates) const
+    int maxWeightOut, vector<vector<SliceValue> >& compatibleStates) const
 {
-    for(unsigned int z=0; z<DCorLC.laneSize; z++) {
-        vector<SliceValue> candidateZ(DCorLC.laneSize);
-        for(unsigned int iz=0; iz<DCorLC.laneSize; iz++)
-            candidateZ[iz] = candidate[(iz+z)%DCorLC.laneSize];
-        if (DCorLC.isChiCompatible(inputState, candidateZ)) {
-            vector<SliceValue> candidateZbeforeChi(DCorLC.laneSize);
-            DCorLC.directLambda(candidateZ, candidateZbeforeChi);
-            compatibleStates.push_back(candidateZbeforeChi);
+    if (nrStates == 0)
+        return;
+    if (inputState.size() != laneSize)
+        throw KeccakException("KnownSmallWeightStates::connect(): the lane size does not match that of the states.");
+    unsigned int dzInput, period;
+    UINT64 key = getKeyOfActiveRows(inputState, dzInput, period);
+    // The records with the same key are contiguous in the index, in the order of their position.
+    const vector<UINT64>& positions = *index;
+    UINT64 low = 0, high = positions.size();
+    while(low < high) {
+        UINT64 middle = low + (high - low)/2;
+        if (getKey(getRecord(positions[middle])) < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    int maxWeight = (maxWeightOut < maxCompleteWeight) ? maxWeightOut : maxCompleteWeight;
+    FixedStateAsSlices candidateZ(laneSize);
+    for(UINT64 i=low; (i<positions.size()) && (getKey(getRecord(positions[i])) == key); i++) {
+        const UINT32 *record = getRecord(positions[i]);
+        if ((record[2] < 2) || ((int)record[2] > maxWeight))
+            continue;
+        const UINT32 *candidate = record + 4;
+        // The active rows of the candidate translated by -z match those of B
+        // exactly for z = dzInput - dzCandidate modulo the period.
+        for(unsigned int z=(dzInput + laneSize - record[3]) % period; z<laneSize; z+=period) {
+            for(unsigned int iz=0; iz<laneSize; iz++)
+                candidateZ[iz] = candidate[(iz+z)%laneSize];
+            if (DCorLC.isChiCompatible(inputState.data(), candidateZ.data())) {
+                FixedStateAsSlices candidateZbeforeChi;
+                DCorLC.directLambda(candidateZ, candidateZbeforeChi);
+                compatibleStates.push_back(vector<SliceValue>(candidateZbeforeChi.begin(), candidateZbeforeChi.end()));
+            }
         }
     }
 }
 
 void KnownSmallWeightStates::loadFromFile(const KeccakFPropagation& DCorLC, const string& fileName)
 {
+    if (loadFromBinaryFile(DCorLC, fileName))
+        return;
+    // The states are added by chunks, so that only their compact records remain in memory.
+    const unsigned int chunkSize = 1 << 20;
+    vector<vector<SliceValue> > states;
     TrailFileIterator fin(fileName, DCorLC);
     for( ; !fin.isEnd(); ++fin) {
         const Trail& trail = *fin;
         for(unsigned int i=(trail.firstStateSpecified ? 0 : 1); i<trail.weights.size(); i++)
             if (trail.weights[i] <= (unsigned int)maxCompleteWeight)
-                addState(DCorLC, trail.states[i]);
+                states.push_back(trail.states[i]);
+        if (states.size() >= chunkSize) {
+            addStates(DCorLC, states);
+            states.clear();
+        }
     }
+    addStates(DCorLC, states);
 }
 
 void KnownSmallWeightStates::saveToFile(const KeccakFPropagation& DCorLC, const string& fileName) const
 {
     ofstream fout(fileName.c_str());
-    for(unsigned int weight=0; weight<statesAfterChiPerWeight.size(); weight++) {
-        for(unsigned int i=0; i<statesAfterChiPerWeight[weight].size(); i++) {
-            vector<SliceValue> stateBeforeChi;
-            DCorLC.directLambda(statesAfterChiPerWeight[weight][i], stateBeforeChi);
-            vector<SliceValue> stateBeforeChiMinZ;
-            getSymmetricMinimum(stateBeforeChi, stateBeforeChiMinZ);
-            Trail trail;
-            trail.append(stateBeforeChiMinZ, weight);
-            trail.save(fout);
+    for(UINT64 i=0; i<nrStates; i++) {
+        const UINT32 *record = getRecord(i);
+        vector<SliceValue> stateAfterChi(record + 4, record + 4 + laneSize);
+        vector<SliceValue> stateBeforeChi;
+        DCorLC.directLambda(stateAfterChi, stateBeforeChi);
+        vector<SliceValue> stateBeforeChiMinZ;
+        getSymmetricMinimum(stateBeforeChi, stateBeforeChiMinZ);
+        Trail trail;
+        trail.append(stateBeforeChiMinZ, record[2]);
+        trail.save(fout);
+    }
+}
+
+static const char knownSmallWeightStatesSignature[8] = { 'K', 'T', 'S', 'm', 'l', 'W', 'g', 't' };
+static const UINT32 knownSmallWeightStatesVersion = 1;
+static const size_t knownSmallWeightStatesHeaderSize = 32;
+
+static void writeLittleEndian(UINT8 *out, UINT64 value, unsigned int nrBytes)
+{
+    for(unsigned int j=0; j<nrBytes; j++)
+        out[j] = (UINT8)(value >> (8*j));
+}
+
+static UINT64 readLittleEndian(const UINT8 *in, unsigned int nrBytes)
+{
+    UINT64 value = 0;
+    for(unsigned int j=0; j<nrBytes; j++)
+        value ^= (UINT64)in[j] << (8*j);
+    return value;
+}
+
+void KnownSmallWeightStates::saveToBinaryFile(const KeccakFPropagation& DCorLC, const string& fileName) const
+{
+    UINT8 header[knownSmallWeightStatesHeaderSize];
+    memcpy(header, knownSmallWeightStatesSignature, 8);
+    writeLittleEndian(header + 8, knownSmallWeightStatesVersion, 4);
+    writeLittleEndian(header + 12, (UINT32)DCorLC.getPropagationType(), 4);
+    writeLittleEndian(header + 16, DCorLC.laneSize, 4);
+    writeLittleEndian(header + 20, (UINT32)maxCompleteWeight, 4);
+    writeLittleEndian(header + 24, nrStates, 8);
+    ofstream fout(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+    fout.write((const char *)header, knownSmallWeightStatesHeaderSize);
+    vector<UINT8> buffer(4*getRecordSize());
+    for(UINT64 i=0; i<nrStates; i++) {
+        const UINT32 *record = getRecord(i);
+        for(unsigned int j=0; j<getRecordSize(); j++)
+            writeLittleEndian(&buffer[4*j], record[j], 4);
+        fout.write((const char *)&buffer[0], buffer.size());
+    }
+    if (!fout)
+        throw KeccakException((string)"File '" + fileName + (string)"' cannot be written.");
+}
+
+bool KnownSmallWeightStates::loadFromBinaryFile(const KeccakFPropagation& DCorLC, const string& fileName)
+{
+    UINT8 header[knownSmallWeightStatesHeaderSize];
+    size_t fileSize;
+    {
+        ifstream fin(fileName.c_str(), ios::binary);
+        fin.read((char *)header, knownSmallWeightStatesHeaderSize);
+        if ((!fin) || (memcmp(header, knownSmallWeightStatesSignature, 8) != 0))
+            return false;
+        fin.seekg(0, ios_base::end);
+        fileSize = (size_t)fin.tellg();
+    }
+    unsigned int fileLaneSize = (unsigned int)readLittleEndian(header + 16, 4);
+    UINT64 fileNrStates = readLittleEndian(header + 24, 8);
+    if ((readLittleEndian(header + 8, 4) != knownSmallWeightStatesVersion)
+            || (readLittleEndian(header + 12, 4) != (UINT32)DCorLC.getPropagationType())
+            || (fileLaneSize != DCorLC.laneSize))
+        throw KeccakException((string)"File '" + fileName + (string)"' contains states for another version, propagation type or lane size.");
+    size_t recordsSize = (size_t)fileNrStates*(4 + fileLaneSize)*4;
+    if (fileSize != knownSmallWeightStatesHeaderSize + recordsSize)
+        throw KeccakException((string)"File '" + fileName + (string)"' is truncated.");
+    if (fileNrStates == 0)
+        return true;
+    shared_ptr<const UINT32> fileRecords;
+    const UINT32 one = 1;
+    bool littleEndian = (*(const UINT8 *)&one == 1);
+#ifndef _WIN32
+    if (littleEndian) {
+        int fd = open(fileName.c_str(), O_RDONLY);
+        void *mapped = MAP_FAILED;
+        if (fd >= 0) {
+            mapped = mmap(0, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+        }
+        if (mapped != MAP_FAILED) {
+            shared_ptr<const UINT8> content((const UINT8 *)mapped,
+                [fileSize](const UINT8 *p) { munmap((void *)p, fileSize); });
+            fileRecords = shared_ptr<const UINT32>(content, (const UINT32 *)(content.get() + knownSmallWeightStatesHeaderSize));
+        }
+    }
+#endif
+    (void)littleEndian;
+    if (!fileRecords) {
+        ifstream fin(fileName.c_str(), ios::binary);
+        fin.seekg(knownSmallWeightStatesHeaderSize);
+        vector<UINT8> buffer(recordsSize);
+        fin.read((char *)&buffer[0], recordsSize);
+        if (!fin)
+            throw KeccakException((string)"File '" + fileName + (string)"' cannot be read.");
+        UINT32 *inMemory = new UINT32[recordsSize/4];
+        for(size_t j=0; j<recordsSize/4; j++)
+            inMemory[j] = (UINT32)readLittleEndian(&buffer[4*j], 4);
+        fileRecords = shared_ptr<const UINT32>(inMemory, default_delete<const UINT32[]>());
+    }
+    if (nrStates == 0) {
+        laneSize = fileLaneSize;
+        nrStates = fileNrStates;
+        records = fileRecords;
+        buildIndex();
+    }
+    else {
+        if (fileLaneSize != laneSize)
+            throw KeccakException("KnownSmallWeightStates: the lane size does not match that of the states.");
+        vector<vector<UINT32> > newRecords;
+        for(UINT64 i=0; i<fileNrStates; i++) {
+            const UINT32 *record = fileRecords.get() + i*getRecordSize();
+            newRecords.push_back(vector<UINT32>(record, record + getRecordSize()));
         }
+        addRecords(newRecords);
     }
+    return true;
 }
 
-void KnownSmallWeightStates::addState(const KeccakFPropagation& DCorLC, const vector<SliceValue>& state)
+void KnownSmallWeightStates::addStates(const KeccakFPropagation& DCorLC, const vector<vector<SliceValue> >& states)
 {
-    unsigned int weight = DCorLC.getWeight(state);
-    if (weight > (unsigned int)maxCompleteWeight) return;
-    vector<SliceValue> stateAfterChi;
-    DCorLC.reverseLambda(state, stateAfterChi);
-    statesAfterChiPerWeight[weight].push_back(stateAfterChi);
+    if (states.empty())
+        return;
+    if ((laneSize != 0) && (laneSize != DCorLC.laneSize))
+        throw KeccakException("KnownSmallWeightStates: the lane size does not match that of the states.");
+    laneSize = DCorLC.laneSize;
+    vector<vector<UINT32> > newRecords;
+    for(unsigned int i=0; i<states.size(); i++) {
+        unsigned int weight = DCorLC.getWeight(states[i]);
+        if (weight > (unsigned int)maxCompleteWeight)
+            continue;
+        vector<SliceValue> stateAfterChi;
+        DCorLC.reverseLambda(states[i], stateAfterChi);
+        unsigned int dz, period;
+        UINT64 key = getKeyOfActiveRows(stateAfterChi, dz, period);
+        vector<UINT32> record;
+        record.push_back((UINT32)key);
+        record.push_back((UINT32)(key >> 32));
+        record.push_back(weight);
+        record.push_back(dz);
+        record.insert(record.end(), stateAfterChi.begin(), stateAfterChi.end());
+        newRecords.push_back(record);
+    }
+    addRecords(newRecords);
+}
+
+void KnownSmallWeightStates::addRecords(const vector<vector<UINT32> >& newRecords)
+{
+    // Keep the records in the order of increasing weight and then in the order they were added.
+    vector<pair<UINT32, UINT64> > order;
+    for(UINT64 i=0; i<nrStates; i++)
+        order.push_back(make_pair(getRecord(i)[2], i));
+    for(UINT64 i=0; i<newRecords.size(); i++)
+        order.push_back(make_pair(newRecords[i][2], nrStates + i));
+    stable_sort(order.begin(), order.end(),
+        [](const pair<UINT32, UINT64>& a, const pair<UINT32, UINT64>& b) { return a.first < b.first; });
+    UINT32 *merged = new UINT32[order.size()*getRecordSize()];
+    for(UINT64 i=0; i<order.size(); i++) {
+        const UINT32 *record = (order[i].second < nrStates) ? getRecord(order[i].second) : &newRecords[order[i].second - nrStates][0];
+        copy(record, record + getRecordSize(), merged + i*getRecordSize());
+    }
+    records = shared_ptr<const UINT32>(merged, default_delete<const UINT32[]>());
+    nrStates = order.size();
+    buildIndex();
+}
+
+void KnownSmallWeightStates::buildIndex()
+{
+    vector<UINT64> *newIndex = new vector<UINT64>(nrStates);
+    for(UINT64 i=0; i<nrStates; i++)
+        (*newIndex)[i] = i;
+    stable_sort(newIndex->begin(), newIndex->end(),
+        [this](UINT64 a, UINT64 b) { return getKey(getRecord(a)) < getKey(getRecord(b)); });
+    index.reset(newIndex);
 }
 
 KeccakFTrailExtension::KeccakFTrailExtension(const KeccakFDCLC& aParent, KeccakFPropagation::DCorLC aDCorLC)
     : KeccakFPropagation(aParent, aDCorLC),
         showMinimalTrails(false), allPrefixes(false),
-        knownSmallWeightStates(0)
+        knownSmallWeightStates(0), nrThreads(1), statistics(0),
+        outputMemoryBudget(0), spillPrefix("KeccakFTrailExtension"), bestFirstMemoryBudget(1 << 30)
 {
+    initializeKnownBounds();
+}
+
+KeccakFTrailExtension::KeccakFTrailExtension(const KeccakFPropagation& aDCorLC)
+    : KeccakFPropagation(aDCorLC),
+        showMinimalTrails(false), allPrefixes(false),
+        knownSmallWeightStates(0), nrThreads(1), statistics(0),
+        outputMemoryBudget(0), spillPrefix("KeccakFTrailExtension"), bestFirstMemoryBudget(1 << 30)
+{
+    initializeKnownBounds();
+}
+
+void KeccakFTrailExtension::initializeKnownBounds()
+{
+    DCorLC aDCorLC = getPropagationType();
     knownBounds.excludeBelowWeight(1, 2);
     knownBounds.excludeBelowWeight(2, 8);
     if (parent.getWidth() == 100) {
@@ -203,9 +444,30 @@ bool KeccakFTrailExtension::isLessThanMinWeightSoFar(unsigned int nrRounds, int
 
 void KeccakFTrailExtension::forwardExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight)
 {
+    if (outputMemoryBudget > 0) {
+        TrailSpillingCollector collector(spillPrefix, outputMemoryBudget);
+        extendTrailsUnbuffered(trailsIn, collector, nrRounds, maxTotalWeight, false);
+        collector.flush(trailsOut);
+    }
+    else
+        extendTrailsUnbuffered(trailsIn, trailsOut, nrRounds, maxTotalWeight, false);
+}
+
+void KeccakFTrailExtension::extendTrailsUnbuffered(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight, bool backward)
+{
+    if (nrThreads != 1) {
+        if (backward)
+            parallelBackwardExtendTrails(trailsIn, trailsOut, nrRounds, maxTotalWeight);
+        else
+            parallelForwardExtendTrails(trailsIn, trailsOut, nrRounds, maxTotalWeight);
+        return;
+    }
     progress.stack("File", trailsIn.getCount());
     for( ; !trailsIn.isEnd(); ++trailsIn) {
-        forwardExtendTrail(*trailsIn, trailsOut, nrRounds, maxTotalWeight);
+        if (backward)
+            backwardExtendTrail(*trailsIn, trailsOut, nrRounds, maxTotalWeight);
+        else
+            forwardExtendTrail(*trailsIn, trailsOut, nrRounds, maxTotalWeight);
         ++progress;
     }
     progress.unstack();
@@ -226,8 +488,10 @@ void KeccakFTrailExtension::recurseForwardExtendTrail(const Trail& trail, TrailF
     int curWeight = trail.weights.back();
     int maxWeightOut = maxTotalWeight - baseWeight
         - knownBounds.getMinWeight(nrRounds-baseNrRounds-1);
-    if (maxWeightOut < knownBounds.getMinWeight(1))
+    if (maxWeightOut < knownBounds.getMinWeight(1)) {
+        countSearchEvent(statistics, SearchStatistics::prunedByCost, curNrRounds);
         return;
+    }
     string synopsis;
     {
         stringstream str;
@@ -249,13 +513,16 @@ void KeccakFTrailExtension::recurseForwardExtendTrail(const Trail& trail, TrailF
                 bool minTrail = showMinimalTrails && isLessThanMinWeightSoFar(curNrRounds, curWeight);
                 if (minTrail)
                     cout << "! " << dec << curNrRounds << "-round trail of weight " << dec << curWeight << " found" << endl;
-                if ((curWeight <= maxTotalWeight) || minTrail) {
+                bool output = (curWeight <= maxTotalWeight) || minTrail;
+                countSearchChild(statistics, output ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+                if (output) {
                     Trail newTrail(trail);
                     newTrail.append((*i), weightOut);
                     trailsOut.fetchTrail(newTrail);
                 }
             }
             else {
+                countSearchChild(statistics, (weightOut <= maxWeightOut) ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
                 if (weightOut <= maxWeightOut) {
                     Trail newTrail(trail);
                     newTrail.append((*i), weightOut);
@@ -270,20 +537,25 @@ void KeccakFTrailExtension::recurseForwardExtendTrail(const Trail& trail, TrailF
         AffineSpaceOfStates base = buildStateBase(trail.states.back());
         SlicesAffineSpaceIterator i(base.originalGenerators, base.offset);
         progress.stack(synopsis + " [affine base]", i.getCount());
-        for(; !i.isEnd(); ++i) {
-            int weightOut = getWeight(*i);
+        // Each step adds one generator, so only the slices it touches need to be weighed again.
+        auto weightOfSlice = [this](SliceValue slice) { return getWeight(slice); };
+        int weightOut = i.isEnd() ? 0 : getWeight(*i);
+        for(; !i.isEnd(); ++i, weightOut = i.getUpdatedSum(weightOut, weightOfSlice)) {
             int curWeight = baseWeight + weightOut;
             if (curNrRounds == nrRounds) {
                 bool minTrail = showMinimalTrails && isLessThanMinWeightSoFar(curNrRounds, curWeight);
                 if (minTrail)
                     cout << "! " << dec << curNrRounds << "-round trail of weight " << dec << curWeight << " found" << endl;
-                if ((curWeight <= maxTotalWeight) || minTrail) {
+                bool output = (curWeight <= maxTotalWeight) || minTrail;
+                countSearchChild(statistics, output ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+                if (output) {
                     Trail newTrail(trail);
                     newTrail.append((*i), weightOut);
                     trailsOut.fetchTrail(newTrail);
                 }
             }
             else {
+                countSearchChild(statistics, (weightOut <= maxWeightOut) ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
                 if (weightOut <= maxWeightOut) {
                     Trail newTrail(trail);
                     newTrail.append((*i), weightOut);
@@ -296,14 +568,295 @@ void KeccakFTrailExtension::recurseForwardExtendTrail(const Trail& trail, TrailF
     }
 }
 
-void KeccakFTrailExtension::backwardExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight)
+void KeccakFTrailExtension::getForwardExtensions(const Trail& trail, int maxWeightOut, vector<pair<vector<SliceValue>, int> >& states)
 {
-    progress.stack("File", trailsIn.getCount());
+    const int minWeightInLookingForSmallWeightStates = 16;
+    if (((int)trail.weights.back() >= minWeightInLookingForSmallWeightStates) && (knownSmallWeightStates != 0)
+            && (maxWeightOut <= (int)knownSmallWeightStates->getMaxCompleteWeight())) {
+        vector<vector<SliceValue> > compatibleStates;
+        knownSmallWeightStates->connect(*this, trail.states.back(), maxWeightOut, compatibleStates);
+        for(vector<vector<SliceValue> >::const_iterator i=compatibleStates.begin(); i!=compatibleStates.end(); ++i) {
+            int weightOut = getWeight(*i);
+            if (weightOut <= maxWeightOut)
+                states.push_back(make_pair(*i, weightOut));
+        }
+    }
+    else {
+        AffineSpaceOfStates base = buildStateBase(trail.states.back());
+        SlicesAffineSpaceIterator i(base.originalGenerators, base.offset);
+        auto weightOfSlice = [this](SliceValue slice) { return getWeight(slice); };
+        int weightOut = i.isEnd() ? 0 : getWeight(*i);
+        for(; !i.isEnd(); ++i, weightOut = i.getUpdatedSum(weightOut, weightOfSlice))
+            if (weightOut <= maxWeightOut)
+                states.push_back(make_pair(*i, weightOut));
+    }
+}
+
+/** This class is a partial or complete trail in the queue of the best-first extension. */
+class BestFirstCandidate {
+public:
+    /** The weight of the trail plus the lower bound on the weight of the rounds to append. */
+    int bound;
+    /** The rank at which the trail was queued, to extend the trails with the same bound in that order. */
+    UINT64 rank;
+    Trail trail;
+    /** The order of the heap, which puts the candidate with the lowest bound first. */
+    bool operator<(const BestFirstCandidate& other) const
+    {
+        if (bound != other.bound)
+            return bound > other.bound;
+        return rank > other.rank;
+    }
+};
+
+int KeccakFTrailExtension::bestFirstForwardExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight, UINT64 nrTrails)
+{
+    vector<BestFirstCandidate> queue;
+    UINT64 nrQueued = 0;
+    UINT64 memoryUsage = 0;
+    int exhaustiveBelow = maxTotalWeight + 1;
+    int bound = maxTotalWeight;
+    multiset<int> weightsFound; // the weights of the lightest nrTrails complete trails found so far
+    UINT64 nrTrailsOut = 0;
+
+    auto queueTrail = [&](const Trail& trail) {
+        unsigned int trailNrRounds = trail.getNumberOfRounds();
+        int trailBound = trail.totalWeight + ((trailNrRounds < nrRounds) ? knownBounds.getMinWeight(nrRounds - trailNrRounds) : 0);
+        if (trailBound > bound) {
+            countSearchEvent(statistics, SearchStatistics::prunedByCost, trailNrRounds);
+            return;
+        }
+        if (trailNrRounds == nrRounds) {
+            if (showMinimalTrails && isLessThanMinWeightSoFar(nrRounds, trail.totalWeight))
+                cout << "! " << dec << nrRounds << "-round trail of weight " << dec << trail.totalWeight << " found" << endl;
+            if (nrTrails > 0) {
+                weightsFound.insert(trail.totalWeight);
+                if (weightsFound.size() > nrTrails)
+                    weightsFound.erase(--weightsFound.end());
+                if (weightsFound.size() == nrTrails)
+                    bound = min(bound, *weightsFound.rbegin());
+            }
+        }
+        BestFirstCandidate candidate;
+        candidate.bound = trailBound;
+        candidate.rank = nrQueued++;
+        candidate.trail = trail;
+        memoryUsage += getApproximateMemoryUsage(candidate.trail);
+        queue.push_back(candidate);
+        push_heap(queue.begin(), queue.end());
+        if ((bestFirstMemoryBudget > 0) && (memoryUsage > bestFirstMemoryBudget)) {
+            // Keep the lightest half of the budget, and give up on the bounds dropped.
+            sort_heap(queue.begin(), queue.end());
+            reverse(queue.begin(), queue.end());
+            UINT64 kept = 0;
+            size_t nrKept = 0;
+            while((nrKept < queue.size()) && (kept + getApproximateMemoryUsage(queue[nrKept].trail) <= bestFirstMemoryBudget/2)) {
+                kept += getApproximateMemoryUsage(queue[nrKept].trail);
+                nrKept++;
+            }
+            while((nrKept > 0) && (nrKept < queue.size()) && (queue[nrKept-1].bound == queue[nrKept].bound)) {
+                kept -= getApproximateMemoryUsage(queue[nrKept-1].trail);
+                nrKept--;
+            }
+            if (nrKept < queue.size()) {
+                exhaustiveBelow = min(exhaustiveBelow, queue[nrKept].bound);
+                bound = min(bound, exhaustiveBelow - 1);
+                cout << "The best-first queue exceeds its memory budget: the search is now exhaustive only below weight " << dec << exhaustiveBelow << endl;
+            }
+            queue.resize(nrKept);
+            memoryUsage = kept;
+            make_heap(queue.begin(), queue.end());
+        }
+    };
+
     for( ; !trailsIn.isEnd(); ++trailsIn) {
-        backwardExtendTrail(*trailsIn, trailsOut, nrRounds, maxTotalWeight);
-        ++progress;
+        if ((*trailsIn).stateAfterLastChiSpecified)
+            throw KeccakException("KeccakFTrailExtension::bestFirstForwardExtendTrails() can work only with trail cores or trail prefixes.");
+        if ((*trailsIn).getNumberOfRounds() <= nrRounds)
+            queueTrail(*trailsIn);
     }
-    progress.unstack();
+    while((!queue.empty()) && ((nrTrails == 0) || (nrTrailsOut < nrTrails))) {
+        pop_heap(queue.begin(), queue.end());
+        BestFirstCandidate candidate;
+        swap(candidate, queue.back());
+        queue.pop_back();
+        memoryUsage -= getApproximateMemoryUsage(candidate.trail);
+        if (candidate.bound > bound)
+            continue;
+        unsigned int curNrRounds = candidate.trail.getNumberOfRounds() + 1;
+        if (curNrRounds > nrRounds) {
+            trailsOut.fetchTrail(candidate.trail);
+            nrTrailsOut++;
+            continue;
+        }
+        int maxWeightOut = bound - candidate.trail.totalWeight - knownBounds.getMinWeight(nrRounds - curNrRounds);
+        vector<pair<vector<SliceValue>, int> > states;
+        getForwardExtensions(candidate.trail, maxWeightOut, states);
+        countSearchEvent(statistics, SearchStatistics::nodesVisited, curNrRounds - 1);
+        for(unsigned int i=0; i<states.size(); i++) {
+            Trail newTrail(candidate.trail);
+            newTrail.append(states[i].first, states[i].second);
+            queueTrail(newTrail);
+        }
+    }
+    return exhaustiveBelow;
+}
+
+/** This class contains the candidate states to append to a trail during
+  * the parallel forward extension, so that sub-ranges of them can be processed
+  * by different workers.
+  */
+class ForwardExtensionCandidates {
+public:
+    Trail trail;
+    int maxWeightOut;
+    bool affine;
+    vector<vector<SliceValue> > compatibleStates;
+    vector<vector<SliceValue> > generators;
+    vector<SliceValue> offset;
+public:
+    UINT64 getCount() const
+    {
+        return affine ? ((UINT64)1 << generators.size()) : compatibleStates.size();
+    }
+};
+
+bool KeccakFTrailExtension::outputMinimalOrLightTrail(ExtensionContext& context, const Trail& newTrail, unsigned int curNrRounds)
+{
+    bool minTrail = false;
+    if (showMinimalTrails) {
+        lock_guard<mutex> guard(context.minWeightSoFarLock);
+        minTrail = isLessThanMinWeightSoFar(curNrRounds, newTrail.totalWeight);
+        if (minTrail)
+            cout << "! " << dec << curNrRounds << "-round trail of weight " << dec << newTrail.totalWeight << " found" << endl;
+    }
+    if (((int)newTrail.totalWeight <= context.maxTotalWeight) || minTrail) {
+        context.trailsOut.fetchTrail(newTrail);
+        return true;
+    }
+    else
+        return false;
+}
+
+void KeccakFTrailExtension::parallelForwardExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight)
+{
+    // The bounds are computed beforehand, as the workers only read them.
+    knownBounds.getMinWeight(nrRounds);
+    ExtensionContext context(nrThreads, trailsOut, nrRounds, maxTotalWeight, trailsIn.getCount(), statistics);
+    context.pool.run([&](WorkStealingPool::Task& task) -> bool {
+        if (trailsIn.isEnd())
+            return false;
+        Trail trail(*trailsIn);
+        ++trailsIn;
+        context.progress.advance();
+        if (trail.stateAfterLastChiSpecified)
+            throw KeccakException("KeccakFTrailExtension::forwardExtendTrail() can work only with trail cores or trail prefixes.");
+        task = [this, &context, trail](unsigned int worker) {
+            parallelForwardExtendTrail(context, worker, trail);
+        };
+        return true;
+    });
+}
+
+void KeccakFTrailExtension::parallelForwardExtendTrail(ExtensionContext& context, unsigned int worker, const Trail& trail)
+{
+    int baseWeight = trail.totalWeight;
+    int baseNrRounds  = trail.getNumberOfRounds();
+    int curWeight = trail.weights.back();
+    int maxWeightOut = context.maxTotalWeight - baseWeight
+        - knownBounds.getMinWeight(context.nrRounds-baseNrRounds-1);
+    if (maxWeightOut < knownBounds.getMinWeight(1)) {
+        countSearchEvent(context.getStatistics(worker), SearchStatistics::prunedByCost, baseNrRounds + 1);
+        return;
+    }
+
+    shared_ptr<ForwardExtensionCandidates> candidates(new ForwardExtensionCandidates);
+    candidates->trail = trail;
+    candidates->maxWeightOut = maxWeightOut;
+    const int minWeightInLookingForSmallWeightStates = 16;
+    if ((curWeight >= minWeightInLookingForSmallWeightStates) && (knownSmallWeightStates != 0)
+            && (maxWeightOut <= knownSmallWeightStates->getMaxCompleteWeight())) {
+        candidates->affine = false;
+        knownSmallWeightStates->connect(*this, trail.states.back(), maxWeightOut, candidates->compatibleStates);
+    }
+    else {
+        AffineSpaceOfStates base = buildStateBase(trail.states.back());
+        candidates->affine = true;
+        candidates->generators = base.originalGenerators;
+        candidates->offset = base.offset;
+    }
+    parallelForwardExtendRange(context, worker, candidates, 0, candidates->getCount());
+}
+
+void KeccakFTrailExtension::parallelForwardExtendRange(ExtensionContext& context, unsigned int worker,
+    const shared_ptr<const ForwardExtensionCandidates>& candidates, UINT64 first, UINT64 last)
+{
+    const UINT64 grain = 64;
+    while(first < last) {
+        if (context.pool.isHungry() && ((last - first) >= 2*grain)) {
+            // Give away the second half to an idle worker.
+            UINT64 middle = first + (last - first)/2;
+            context.pool.spawn(worker, [this, &context, candidates, middle, last](unsigned int otherWorker) {
+                parallelForwardExtendRange(context, otherWorker, candidates, middle, last);
+            });
+            last = middle;
+        }
+        UINT64 chunkEnd = min(first + grain, last);
+        if (candidates->affine) {
+            SlicesAffineSpaceIterator i(candidates->generators, candidates->offset, first, chunkEnd);
+            auto weightOfSlice = [this](SliceValue slice) { return getWeight(slice); };
+            int weightOut = i.isEnd() ? 0 : getWeight(*i);
+            for(; !i.isEnd(); ++i, weightOut = i.getUpdatedSum(weightOut, weightOfSlice)) {
+                context.progress.countNode(worker);
+                parallelForwardExtendWithState(context, worker, *candidates, *i, weightOut);
+            }
+        }
+        else {
+            for(UINT64 k=first; k<chunkEnd; k++) {
+                context.progress.countNode(worker);
+                parallelForwardExtendWithState(context, worker, *candidates, candidates->compatibleStates[k],
+                    getWeight(candidates->compatibleStates[k]));
+            }
+        }
+        first = chunkEnd;
+    }
+}
+
+void KeccakFTrailExtension::parallelForwardExtendWithState(ExtensionContext& context, unsigned int worker,
+    const ForwardExtensionCandidates& candidates, const vector<SliceValue>& state, int weightOut)
+{
+    const Trail& trail = candidates.trail;
+    unsigned int curNrRounds = trail.getNumberOfRounds() + 1;
+    int curWeight = trail.totalWeight + weightOut;
+    if (curNrRounds == context.nrRounds) {
+        bool output = false;
+        if (showMinimalTrails || (curWeight <= context.maxTotalWeight)) {
+            Trail newTrail(trail);
+            newTrail.append(state, weightOut);
+            output = outputMinimalOrLightTrail(context, newTrail, curNrRounds);
+        }
+        countSearchChild(context.getStatistics(worker), output ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+    }
+    else {
+        countSearchChild(context.getStatistics(worker),
+            (weightOut <= candidates.maxWeightOut) ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+        if (weightOut <= candidates.maxWeightOut) {
+            Trail newTrail(trail);
+            newTrail.append(state, weightOut);
+            parallelForwardExtendTrail(context, worker, newTrail);
+        }
+    }
+}
+
+void KeccakFTrailExtension::backwardExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight)
+{
+    if (outputMemoryBudget > 0) {
+        TrailSpillingCollector collector(spillPrefix, outputMemoryBudget);
+        extendTrailsUnbuffered(trailsIn, collector, nrRounds, maxTotalWeight, true);
+        collector.flush(trailsOut);
+    }
+    else
+        extendTrailsUnbuffered(trailsIn, trailsOut, nrRounds, maxTotalWeight, true);
 }
 
 void KeccakFTrailExtension::backwardExtendTrail(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight)
@@ -324,9 +877,7 @@ void KeccakFTrailExtension::recurseBackwardExtendTrail(const Trail& trail, Trail
 {
     if (!allPrefixes && (nrRounds == (trail.getNumberOfRounds()+1))) {
         int baseWeight = trail.totalWeight;
-        vector<SliceValue> stateAfterChi;
-        reverseLambda(trail.states[0], stateAfterChi);
-        int curMinReverseWeight = getMinReverseWeight(stateAfterChi);
+        int curMinReverseWeight = getMinReverseWeightAfterLambda(trail.states[0]);
         int curWeight = baseWeight + curMinReverseWeight;
         bool minTrail = showMinimalTrails && isLessThanMinWeightSoFar(nrRounds, curWeight);
         if (minTrail)
@@ -343,8 +894,10 @@ void KeccakFTrailExtension::recurseBackwardExtendTrail(const Trail& trail, Trail
         int baseNrRounds  = trail.getNumberOfRounds();
         int maxWeightOut = maxTotalWeight - baseWeight
             - knownBounds.getMinWeight(nrRounds-baseNrRounds-1);
-        if (maxWeightOut < knownBounds.getMinWeight(1))
+        if (maxWeightOut < knownBounds.getMinWeight(1)) {
+            countSearchEvent(statistics, SearchStatistics::prunedByCost, baseNrRounds + 1);
             return;
+        }
         vector<SliceValue> stateAfterChi;
         reverseLambda(trail.states[0], stateAfterChi);
         ReverseStateIterator i(stateAfterChi, *this, maxWeightOut);
@@ -364,7 +917,9 @@ void KeccakFTrailExtension::recurseBackwardExtendTrail(const Trail& trail, Trail
                 bool minTrail = showMinimalTrails && isLessThanMinWeightSoFar(nrRounds, curWeight);
                 if (minTrail)
                     cout << "! " << dec << nrRounds << "-round trail of weight " << dec << curWeight << " found" << endl;
-                if ((curWeight <= maxTotalWeight) || minTrail) {
+                bool output = (curWeight <= maxTotalWeight) || minTrail;
+                countSearchChild(statistics, output ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+                if (output) {
                     Trail newTrail(trail);
                     newTrail.prepend((*i), weightOut);
                     trailsOut.fetchTrail(newTrail);
@@ -372,7 +927,9 @@ void KeccakFTrailExtension::recurseBackwardExtendTrail(const Trail& trail, Trail
             }
             else {
                 int minPrevWeight = getMinReverseWeightAfterLambda(*i);
-                if ((curWeight + minPrevWeight + knownBounds.getMinWeight(nrRounds-curNrRounds-1)) <= maxTotalWeight) {
+                bool affordable = (curWeight + minPrevWeight + knownBounds.getMinWeight(nrRounds-curNrRounds-1)) <= maxTotalWeight;
+                countSearchChild(statistics, affordable ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+                if (affordable) {
                     Trail newTrail(trail);
                     newTrail.prepend((*i), weightOut);
                     recurseBackwardExtendTrail(newTrail, trailsOut, nrRounds, maxTotalWeight, allPrefixes);
@@ -384,3 +941,102 @@ void KeccakFTrailExtension::recurseBackwardExtendTrail(const Trail& trail, Trail
     }
 }
 
+void KeccakFTrailExtension::parallelBackwardExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight)
+{
+    // The bounds are computed beforehand, as the workers only read them.
+    knownBounds.getMinWeight(nrRounds);
+    ExtensionContext context(nrThreads, trailsOut, nrRounds, maxTotalWeight, trailsIn.getCount(), statistics);
+    context.pool.run([&](WorkStealingPool::Task& task) -> bool {
+        if (trailsIn.isEnd())
+            return false;
+        const Trail& trail = *trailsIn;
+        bool isPrefix = trail.firstStateSpecified;
+        Trail trimmedTrailPrefix; // cut wrev(a0)
+        if (isPrefix)
+            trimmedTrailPrefix = trail;
+        else
+            for(unsigned int i=1; i<trail.states.size(); i++)
+                trimmedTrailPrefix.append(trail.states[i], trail.weights[i]);
+        ++trailsIn;
+        context.progress.advance();
+        bool withAllPrefixes = isPrefix || allPrefixes;
+        task = [this, &context, trimmedTrailPrefix, withAllPrefixes](unsigned int worker) {
+            parallelRecurseBackwardExtendTrail(context, worker, trimmedTrailPrefix, withAllPrefixes);
+        };
+        return true;
+    });
+}
+
+void KeccakFTrailExtension::parallelRecurseBackwardExtendTrail(ExtensionContext& context, unsigned int worker, const Trail& trail, bool allPrefixes)
+{
+    unsigned int nrRounds = context.nrRounds;
+    if (!allPrefixes && (nrRounds == (trail.getNumberOfRounds()+1))) {
+        int curMinReverseWeight = getMinReverseWeightAfterLambda(trail.states[0]);
+        if (showMinimalTrails || ((int)trail.totalWeight + curMinReverseWeight <= context.maxTotalWeight)) {
+            Trail newTrail;
+            newTrail.setFirstStateReverseMinimumWeight(curMinReverseWeight);
+            newTrail.append(trail);
+            outputMinimalOrLightTrail(context, newTrail, nrRounds);
+        }
+    }
+    else {
+        int baseWeight = trail.totalWeight;
+        int baseNrRounds  = trail.getNumberOfRounds();
+        int maxWeightOut = context.maxTotalWeight - baseWeight
+            - knownBounds.getMinWeight(nrRounds-baseNrRounds-1);
+        if (maxWeightOut < knownBounds.getMinWeight(1)) {
+            countSearchEvent(context.getStatistics(worker), SearchStatistics::prunedByCost, baseNrRounds + 1);
+            return;
+        }
+        vector<SliceValue> stateAfterChi;
+        reverseLambda(trail.states[0], stateAfterChi);
+        ReverseStateIterator i(stateAfterChi, *this, maxWeightOut);
+        if (i.isEmpty())
+            return;
+        parallelBackwardExtendRange(context, worker, make_shared<const Trail>(trail), i, allPrefixes);
+    }
+}
+
+void KeccakFTrailExtension::parallelBackwardExtendRange(ExtensionContext& context, unsigned int worker,
+    const shared_ptr<const Trail>& trail, ReverseStateIterator& i, bool allPrefixes)
+{
+    const unsigned int grain = 64;
+    unsigned int nrRounds = context.nrRounds;
+    int baseWeight = trail->totalWeight;
+    unsigned int curNrRounds = trail->getNumberOfRounds() + 1;
+    for(unsigned int n=0; !i.isEnd(); ++i, n++) {
+        if (((n % grain) == 0) && context.pool.isHungry()) {
+            // Give away the states with other choices for the slowest-varying rows.
+            vector<ReverseStateIterator> parts;
+            while(parts.empty() && i.split(1, parts)) ;
+            for(unsigned int k=0; k<parts.size(); k++) {
+                ReverseStateIterator part(parts[k]);
+                context.pool.spawn(worker, [this, &context, trail, part, allPrefixes](unsigned int otherWorker) mutable {
+                    parallelBackwardExtendRange(context, otherWorker, trail, part, allPrefixes);
+                });
+            }
+        }
+        context.progress.countNode(worker);
+        int weightOut = getWeight(*i);
+        int curWeight = baseWeight + weightOut;
+        if (curNrRounds == nrRounds) {
+            bool output = false;
+            if (showMinimalTrails || (curWeight <= context.maxTotalWeight)) {
+                Trail newTrail(*trail);
+                newTrail.prepend((*i), weightOut);
+                output = outputMinimalOrLightTrail(context, newTrail, nrRounds);
+            }
+            countSearchChild(context.getStatistics(worker), output ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+        }
+        else {
+            int minPrevWeight = getMinReverseWeightAfterLambda(*i);
+            bool affordable = (curWeight + minPrevWeight + knownBounds.getMinWeight(nrRounds-curNrRounds-1)) <= context.maxTotalWeight;
+            countSearchChild(context.getStatistics(worker), affordable ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+            if (affordable) {
+                Trail newTrail(*trail);
+                newTrail.prepend((*i), weightOut);
+                parallelRecurseBackwardExtendTrail(context, worker, newTrail, allPrefixes);
+            }
+        }
+    }
+}
@@ -17,12 +17,20 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #define _KECCAKFTRAILEXTENSION_H_
 
 #include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include "Keccak-fPropagation.h"
+#include "Keccak-fTrails.h"
 #include "progress.h"
+#include "searchStatistics.h"
+#include "workStealing.h"
 
 using namespace std;
 
+class ExtensionContext;
+class ForwardExtensionCandidates;
+
 /** Class that maintains a list of minimum weights for each number of rounds
   * below which there is no need to look for trails.
   * This is typically used during trail extension to avoid looking for trails
@@ -61,15 +69,33 @@ protected:
 /** Class that contains all states C after χ such that D=λ(C) has low weight.
   * This allows to quickly check whether a state B can be connected
   * to such a state C through χ.
+  * As χ maps active rows onto active rows, B and C can be compatible
+  * only if they have the same active rows. The states are therefore indexed
+  * by a hash of their active rows taken up to translation in z,
+  * so that connect() only tests the states, and the translations of them,
+  * whose active rows match those of B.
+  * The states are kept in a single array of records, which copies of this object share,
+  * and which can be mapped into memory from a binary file, see saveToBinaryFile().
   */
 class KnownSmallWeightStates {
 protected:
-    /** Vector that contains all states C per weight of D=λ(C). The first index level
-      * is for the weight of D=λ(C). All states are stored up to translation in z.
+    /** The lane size, or 0 until the first states are added. */
+    unsigned int laneSize;
+    /** The number of states in records. */
+    UINT64 nrStates;
+    /** The records of the states, in the order of increasing weight of D=λ(C)
+      * and then in the order in which they were added.
+      * Each record consists of getRecordSize() words: the hash of the active rows
+      * (2 words, low word first), the weight of D, the translation that brings
+      * the active rows to their canonical variant, see getMinimalTranslation(),
+      * and the slices of C. The memory is either mapped from a binary file
+      * or allocated on the heap.
       */
-    vector<vector<vector<SliceValue> > > statesAfterChiPerWeight;
+    shared_ptr<const UINT32> records;
+    /** The indexes of the records, sorted by hash and then by position. */
+    shared_ptr<const vector<UINT64> > index;
     /** This attribute tells up to which weight the set of states in
-     * statesAfterChiPerWeight is complete.
+     * records is complete.
      */
     int maxCompleteWeight;
 public:
@@ -89,7 +115,9 @@ public:
       * @param  DCorLC The propagation context,
       *                 as a reference to a KeccakFPropagation object.
       * @param  fileName    The name of the file to extract states from.
-      *     The file has to contain trails (or trail cores or trail prefixes)
+      *     The file can be a binary file written by saveToBinaryFile(),
+      *     which is then mapped into memory where available.
+      *     Otherwise, the file has to contain trails (or trail cores or trail prefixes)
       *     and all states with weight less than maxCompleteWeight will
       *     be fetched.
       *     The states fetched are interpreted as D=λ(C).
@@ -99,6 +127,10 @@ public:
       * @return The intended weight up to which the set is complete.
       */
     int getMaxCompleteWeight() const;
+    /** Method that returns the number of states in the set.
+      * @return The number of states.
+      */
+    UINT64 getNumberOfStates() const;
     /** Method that attempts at finding states D that are compatible
       * through λ after χ with the given state B.
       * @param  DCorLC The propagation context,
@@ -118,10 +150,25 @@ public:
       * @param  fileName    The name of the file to save to.
       */
     void saveToFile(const KeccakFPropagation& DCorLC, const string& fileName) const;
+    /** Method that stores all the states in a binary file, which loadFromFile() can map into memory.
+      * The file starts with the 8-byte signature "KTSmlWgt", the version (4 bytes),
+      * the propagation type (4 bytes), the lane size (4 bytes), maxCompleteWeight (4 bytes)
+      * and the number of states (8 bytes), followed by the records as described for @a records,
+      * all in little-endian order.
+      * @param  DCorLC The propagation context,
+      *                 as a reference to a KeccakFPropagation object.
+      * @param  fileName    The name of the file to save to.
+      */
+    void saveToBinaryFile(const KeccakFPropagation& DCorLC, const string& fileName) const;
 protected:
-    void addState(const KeccakFPropagation& DCorLC, const vector<SliceValue>& state);
-    void connect(const KeccakFPropagation& DCorLC, const vector<SliceValue>& inputState,
-        const vector<SliceValue>& candidate, vector<vector<SliceValue> >& compatibleStates) const;
+    unsigned int getRecordSize() const { return 4 + laneSize; }
+    const UINT32 *getRecord(UINT64 i) const { return records.get() + i*getRecordSize(); }
+    static UINT64 getKey(const UINT32 *record) { return (UINT64)record[0] ^ ((UINT64)record[1] << 32); }
+    static UINT64 getKeyOfActiveRows(const vector<SliceValue>& state, unsigned int& dz, unsigned int& period);
+    void addStates(const KeccakFPropagation& DCorLC, const vector<vector<SliceValue> >& states);
+    void addRecords(const vector<vector<UINT32> >& newRecords);
+    bool loadFromBinaryFile(const KeccakFPropagation& DCorLC, const string& fileName);
+    void buildIndex();
 };
 
 /** This class provides trail extension services.
@@ -149,12 +196,50 @@ public:
       * trail extension.
       */
     KnownSmallWeightStates *knownSmallWeightStates;
+    /** The number of threads used by forwardExtendTrails() and backwardExtendTrails().
+      * If 1 (the default), the trails are processed one after the other.
+      * Otherwise, the trails, and the extension spaces of the heavy ones,
+      * are processed by a WorkStealingPool with that many threads,
+      * or with one thread per hardware thread if 0.
+      * In this case, the output trails come in no particular order,
+      * and the progress is displayed by a ConcurrentProgressMeter.
+      */
+    unsigned int nrThreads;
+    /** This optional SearchStatistics object pointer counts the events of the extension,
+      * with the number of rounds of the extended trail as depth.
+      * Each state considered to extend a trail counts as a child,
+      * which is either visited, i.e., output or further extended,
+      * or pruned by the weight bound; a trail whose extension cannot fit
+      * in the weight bound at all also counts as pruned by cost.
+      * When several threads are used, each counts separately and
+      * the counts are added to this object when the extension is done.
+      * If null (the default), nothing is counted.
+      */
+    SearchStatistics *statistics;
+    /** If non-zero, forwardExtendTrails() and backwardExtendTrails() collect the
+      * output trails in a TrailSpillingCollector with this memory budget in bytes,
+      * which spills them to temporary files named after @a spillPrefix when needed,
+      * and give them to the output TrailFetcher at the end, by increasing total weight.
+      * If 0 (the default), the trails are given to the output TrailFetcher as they are found.
+      */
+    UINT64 outputMemoryBudget;
+    /** The prefix of the names of the temporary files, see @a outputMemoryBudget. */
+    string spillPrefix;
+    /** The memory budget in bytes of the queue of partial trails of bestFirstForwardExtendTrails(),
+      * 1 GiB by default. If 0, the queue is not limited.
+      */
+    UINT64 bestFirstMemoryBudget;
 protected:
     vector<int> minWeightSoFar;
     ProgressMeter progress;
 public:
     /** The constructor. See KeccakFPropagation::KeccakFPropagation(). */
     KeccakFTrailExtension(const KeccakFDCLC& aParent, KeccakFPropagation::DCorLC aDCorLC);
+    /** The constructor that shares the tables of an existing propagation context,
+      * see KeccakFPropagation::KeccakFPropagation(const KeccakFPropagation&).
+      * @param  aDCorLC The propagation context.
+      */
+    KeccakFTrailExtension(const KeccakFPropagation& aDCorLC);
     /** The destructor.
       * This frees the memory taken by @a knownSmallWeightStates.
       */
@@ -171,7 +256,7 @@ public:
       */
     void forwardExtendTrail(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight);
     /** This function is like forwardExtendTrail(), except that it processes
-      * all the trails from @a trailsIn.
+      * all the trails from @a trailsIn, possibly in parallel, see @a nrThreads.
       * @param  trailsIn    The starting trail cores or trail prefixes.
       * @param  trailsOut   Where to output the found trails.
       * @param  nrRounds    The target number of rounds.
@@ -193,21 +278,105 @@ public:
       * @param  maxTotalWeight  The maximum total weight to consider.
       */
     void backwardExtendTrail(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight);
-    /** This function is like backwardExtendTrails(), except that it processes
-      * all the trails from @a trailsIn.
+    /** This function is like backwardExtendTrail(), except that it processes
+      * all the trails from @a trailsIn, possibly in parallel, see @a nrThreads.
       * @param  trailsIn    The starting trail cores or trail prefixes.
       * @param  trailsOut   Where to output the found trails.
       * @param  nrRounds    The target number of rounds.
       * @param  maxTotalWeight  The maximum total weight to consider.
       */
     void backwardExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight);
+    /** This method looks for the lightest trails with @a nrRounds rounds
+      * that have one of the trails from @a trailsIn as prefix, like forwardExtendTrails(),
+      * but best first instead of depth first, so that the minimum weight can be found
+      * without having to guess @a maxTotalWeight.
+      * The partial trails wait in a priority queue, by their weight plus a lower bound
+      * on the weight of the rounds still to append, taken from @a knownBounds.
+      * The trail with the lowest such bound is extended by one round at a time,
+      * and a complete trail is output when it reaches the head of the queue,
+      * so the trails are output by nondecreasing weight.
+      * Once @a nrTrails trails are known, the partial trails that cannot beat them are
+      * pruned. If @a showMinimalTrails is true, each complete trail lighter than all
+      * those found before is reported on the standard output as soon as it is found.
+      * If the queue exceeds @a bestFirstMemoryBudget, its heaviest partial trails are dropped,
+      * and the search is then exhaustive only below the lowest bound dropped.
+      * The trails are processed by one thread, see @a nrThreads.
+      * @param  trailsIn    The starting trail cores or trail prefixes.
+      * @param  trailsOut   Where to output the found trails.
+      * @param  nrRounds    The target number of rounds.
+      * @param  maxTotalWeight  The maximum total weight to consider.
+      * @param  nrTrails    The number of trails to output, or 0 to output all those up to @a maxTotalWeight.
+      * @return The weight below which the search is exhaustive, i.e.,
+      *     @a maxTotalWeight+1 if no partial trail was dropped.
+      */
+    int bestFirstForwardExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight, UINT64 nrTrails = 1);
 
 
 
 protected:
+    void initializeKnownBounds();
+    void extendTrailsUnbuffered(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight, bool backward);
     void recurseForwardExtendTrail(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight);
+    void parallelForwardExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight);
+    void parallelForwardExtendTrail(ExtensionContext& context, unsigned int worker, const Trail& trail);
+    void parallelForwardExtendRange(ExtensionContext& context, unsigned int worker,
+        const shared_ptr<const ForwardExtensionCandidates>& candidates, UINT64 first, UINT64 last);
+    void parallelForwardExtendWithState(ExtensionContext& context, unsigned int worker,
+        const ForwardExtensionCandidates& candidates, const vector<SliceValue>& state, int weightOut);
     void recurseBackwardExtendTrail(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight, bool allPrefixes);
+    void parallelBackwardExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight);
+    void parallelRecurseBackwardExtendTrail(ExtensionContext& context, unsigned int worker, const Trail& trail, bool allPrefixes);
+    void parallelBackwardExtendRange(ExtensionContext& context, unsigned int worker,
+        const shared_ptr<const Trail>& trail, ReverseStateIterator& i, bool allPrefixes);
+    bool outputMinimalOrLightTrail(ExtensionContext& context, const Trail& newTrail, unsigned int curNrRounds);
     bool isLessThanMinWeightSoFar(unsigned int nrRounds, int weight);
+    void getForwardExtensions(const Trail& trail, int maxWeightOut, vector<pair<vector<SliceValue>, int> >& states);
+};
+
+/** This class contains what the workers of the parallel forward or backward extension share,
+  * including those of the derived classes.
+  * The trails output through @a trailsOut are counted in @a progress,
+  * together with the input trails and the states tried by the workers.
+  */
+class ExtensionContext : public TrailFetcher {
+protected:
+    TrailFetcher& finalTrailsOut;
+    SearchStatistics *statistics;
+    vector<SearchStatistics> workerStatistics;
+public:
+    WorkStealingPool pool;
+    ConcurrentProgressMeter progress;
+    TrailFetcherSynchronized trailsOut;
+    unsigned int nrRounds;
+    int maxTotalWeight;
+    mutex minWeightSoFarLock;
+public:
+    ExtensionContext(unsigned int nrThreads, TrailFetcher& aTrailsOut, unsigned int aNrRounds, int aMaxTotalWeight,
+        UINT64 nrTrailsIn = 0, SearchStatistics *aStatistics = 0)
+        : finalTrailsOut(aTrailsOut), statistics(aStatistics), pool(nrThreads),
+        progress("File", nrTrailsIn, pool.getNumberOfThreads()),
+        trailsOut(*this), nrRounds(aNrRounds), maxTotalWeight(aMaxTotalWeight)
+    {
+        if (statistics != 0)
+            workerStatistics.resize(pool.getNumberOfThreads());
+    }
+    /** The destructor adds the events counted by the workers to the statistics given to the constructor. */
+    ~ExtensionContext()
+    {
+        for(unsigned int i=0; i<workerStatistics.size(); i++)
+            statistics->add(workerStatistics[i]);
+    }
+    /** This method returns where a worker counts its events, or null if not counting. */
+    SearchStatistics *getStatistics(unsigned int worker)
+    {
+        return workerStatistics.empty() ? 0 : &workerStatistics[worker];
+    }
+    /** See TrailFetcher::fetchTrail(); this is called by @a trailsOut one trail at a time. */
+    void fetchTrail(const Trail& trail)
+    {
+        progress.countTrail();
+        finalTrailsOut.fetchTrail(trail);
+    }
 };
 
 #endif
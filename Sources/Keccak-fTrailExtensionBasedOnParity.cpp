@@ -28,7 +28,6 @@ AffineSpaceOfStates buildBasisBeforeChiGivenPatternAfterChi(const vector<SliceVa
 {
 	vector<SliceValue> offsetBeforeChi(stateAfterChi.size(), 0);
 	vector<vector<SliceValue> > generatorsBeforeChi;   // to store the generators
-	vector<vector<RowValue> > generatorsParities;
 
 	for (unsigned int z = 0; z < stateAfterChi.size(); z++){
 		if (stateAfterChi[z] != 0){
@@ -44,10 +43,6 @@ AffineSpaceOfStates buildBasisBeforeChiGivenPatternAfterChi(const vector<SliceVa
 							vector<SliceValue> generator(stateAfterChi.size(), 0);
 							setRow(generator, value, RowPosition(y, z));
 							generatorsBeforeChi.push_back(generator);
-
-							vector<RowValue> parity(stateAfterChi.size(), 0);
-							getParity(generator, parity);
-							generatorsParities.push_back(parity);
 						}
 					}
 				}
@@ -55,10 +50,8 @@ AffineSpaceOfStates buildBasisBeforeChiGivenPatternAfterChi(const vector<SliceVa
 		}
 	}
 
-	vector<RowValue> OffsetParity(offsetBeforeChi.size(),0);
-	getParity(offsetBeforeChi, OffsetParity);
-
-	AffineSpaceOfStates affineSpace(stateAfterChi.size(), generatorsBeforeChi, generatorsParities, offsetBeforeChi, OffsetParity);
+	// the parities are computed while packing the generators
+	AffineSpaceOfStates affineSpace(stateAfterChi.size(), generatorsBeforeChi, offsetBeforeChi);
 	return affineSpace;
 }
 
@@ -69,22 +62,14 @@ AffineSpaceOfStates getdBasisAfterThetaGivenPatternBeforeChi(const KeccakFTrailE
 	// offset
 	vector<SliceValue> offsetAfterTheta(keccakFTE.laneSize, 0);
 	keccakFTE.reverseLambdaAfterTheta(basisBeforeChi.offset, offsetAfterTheta);
-	vector<RowValue> offsetAfterThetaParity(keccakFTE.laneSize, 0);
-	getParity(offsetAfterTheta, offsetAfterThetaParity);
 
 	// basis
-	vector<vector<SliceValue> > generatorsAfterTheta;
-	vector<vector<RowValue> > generatorsAfterThetaParities;
-	for (unsigned int i = 0; i < basisBeforeChi.originalGenerators.size(); i++){
-		vector<SliceValue> generator(keccakFTE.laneSize, 0);
-		keccakFTE.reverseLambdaAfterTheta(basisBeforeChi.originalGenerators[i], generator);
-		generatorsAfterTheta.push_back(generator);
-		vector<RowValue> parity(keccakFTE.laneSize, 0);
-		getParity(generator, parity);
-		generatorsAfterThetaParities.push_back(parity);
-	}
-
-	AffineSpaceOfStates affineSpace(keccakFTE.laneSize, generatorsAfterTheta, generatorsAfterThetaParities, offsetAfterTheta, offsetAfterThetaParity);
+	vector<vector<SliceValue> > generatorsAfterTheta(basisBeforeChi.originalGenerators.size());
+	for (unsigned int i = 0; i < basisBeforeChi.originalGenerators.size(); i++)
+		keccakFTE.reverseLambdaAfterTheta(basisBeforeChi.originalGenerators[i], generatorsAfterTheta[i]);
+
+	// the parities are computed while packing the generators
+	AffineSpaceOfStates affineSpace(keccakFTE.laneSize, generatorsAfterTheta, offsetAfterTheta);
 	return affineSpace;
 
 }
@@ -99,7 +84,8 @@ AffineSpaceOfStates buildBasisIntersectionWithKernel(const AffineSpaceOfStates&
 	vector<vector<SliceValue> > generatorsIntersection;
 	vector<vector<RowValue> > generatorsParities;
 
-	vector<ColumnPosition> columns;
+	// the columns already considered, indexed by x+5z
+	vector<bool> checkedColumns(nrRowsAndColumns*lanesize, false);
 
 	for (unsigned int i = 0; i < basis.originalGenerators.size(); i++){
 		vector<SliceValue> generator = basis.originalGenerators[i];
@@ -117,17 +103,10 @@ AffineSpaceOfStates buildBasisIntersectionWithKernel(const AffineSpaceOfStates&
 						break;
 				}
 				// check if it has already been considered
-				bool checkedColumn = false;
-				for (unsigned int k = 0; k < columns.size(); k++){
-					if (z == columns[k].z && x == columns[k].x){
-						checkedColumn = true;
-						break;
-					}
-				}
-				if (checkedColumn)
+				if (checkedColumns[x + nrRowsAndColumns*z])
 					break;
 				else{
-					columns.push_back(ColumnPosition(x, z));
+					checkedColumns[x + nrRowsAndColumns*z] = true;
 					// offset column with an odd number of active bits
 					if ((getHammingWeightColumn(getColumn(offsetIntersection, x, z)) % 2) != 0){
 						offsetIntersection[z] ^= generator[z];
@@ -158,19 +137,18 @@ bool intersectionWithKernel(const AffineSpaceOfStates& basis)
 {
 	unsigned int lanesize = basis.offset.size();
 
+	// the union of the active bits of the basis vectors
+	vector<SliceValue> basisBits(lanesize, 0);
+	for (unsigned int i = 0; i < basis.originalGenerators.size(); i++)
+		for (unsigned int z = 0; z < lanesize; z++)
+			basisBits[z] |= basis.originalGenerators[i][z];
+
 	// check if columns of the offset with an odd number of active bits have corresponding active bits in the basis
 	for (unsigned int z = 0; z < lanesize; z++){
 		if (basis.offset[z] != 0){
 			for (int x = 0; x < nrRowsAndColumns; x++){
 				if ((getHammingWeightColumn(getColumn(basis.offset, x, z)) % 2) != 0){
-					bool existBasisBit = false;
-					for (unsigned int i = 0; i < basis.originalGenerators.size(); i++){
-						if (getHammingWeightColumn(getColumn(basis.originalGenerators[i], x, z)) != 0){
-							existBasisBit = true;
-							break;
-						}
-					}
-					if (existBasisBit == false)
+					if (getColumn(basisBits, x, z) == 0)
 						return false;
 				}
 			}
@@ -352,7 +330,7 @@ vector< vector<RowValue> > getRowValuesFromBasis(AffineSpaceOfStates& basis)
 
 
 
-parityBackwardIterator::parityBackwardIterator(const KeccakFPropagation& aDCorLC, vector<SliceValue> &aOffset, vector<RowValue> &aOffsetParity, vector<vector<RowValue> > &aValuesX, vector<vector<unsigned int> > &aNrBasisVectors, unsigned int& aStart, RowValue& aGuess, unsigned int aMaxWeight)
+parityBackwardIterator::parityBackwardIterator(const KeccakFPropagation& aDCorLC, const vector<SliceValue> &aOffset, const vector<RowValue> &aOffsetParity, const vector<vector<RowValue> > &aValuesX, const vector<vector<unsigned int> > &aNrBasisVectors, const unsigned int& aStart, const RowValue& aGuess, unsigned int aMaxWeight)
 : parityIterator(aDCorLC), start(aStart), offsetParity(aOffsetParity), offset(aOffset), rowsValues(aValuesX), nrBasisVectors(aNrBasisVectors), current(aStart), maxWeight(aMaxWeight), end(false), initialized(false), empty(true) {
 	b = offsetParity;
 	for (unsigned int i = 0; i < laneSize; i++)
@@ -680,7 +658,7 @@ AffineSpaceOfStates buildBasisAfterChiGivenPatternBeforeChi(vector<AffineSpaceOf
 }
 
 stateForwardIterator::stateForwardIterator(const KeccakFPropagation& aDCorLC, AffineSpaceOfStates& aBasis, unsigned int aBudgetWeight) :
-DCorLC(aDCorLC), laneSize(aDCorLC.laneSize), offset(aBasis.offset), offsetParity(aBasis.offsetParity), budgetWeight(aBudgetWeight), end(false), initialized(false), empty(true)
+DCorLC(aDCorLC), laneSize(aDCorLC.laneSize), offset(aBasis.offset), offsetParity(aBasis.offsetParity), stateAtB(aDCorLC, true), budgetWeight(aBudgetWeight), end(false), initialized(false), empty(true)
 {
 	for (unsigned int i = 0; i < aBasis.offsetGenerators.size(); i++){
 		basis.push_back(aBasis.offsetGenerators[i]);
@@ -709,10 +687,8 @@ void stateForwardIterator::initialize()
 {
 	indexes.push_back(-1);
 	stateAtA.push_back(offset);
-	vector<SliceValue> B(laneSize,0);
-	DCorLC.directLambda(stateAtA.back(), B);
-	stateAtB.push_back(B);
-	weight.push_back(DCorLC.getWeight(B));
+	stateAtB.set(stateAtA.back());
+	weight.push_back(stateAtB.getWeightOfImage());
 	vector<RowValue> parity(laneSize, 0);
 	getParity(stateAtA.back(), parity);
 	C.push_back(parity);
@@ -832,9 +808,8 @@ void stateForwardIterator::pushIndex(int& workingIndex)
 	unsigned int z = slices[workingIndex];
 	stateAtA.back()[z] ^= basis[workingIndex][z];
 
-	stateAtB.push_back(stateAtB.back()); // this can be optimized
-	DCorLC.directLambda(stateAtA.back(),stateAtB.back());
-	weight.push_back(DCorLC.getWeight(stateAtB.back())); // this can be optimized
+	stateAtB.toggleSlice(z, basis[workingIndex][z]);
+	weight.push_back(stateAtB.getWeightOfImage());
 
 	vector<RowValue> parity(laneSize,0);
 	getParity(stateAtA.back(), parity);
@@ -854,7 +829,8 @@ bool stateForwardIterator::popIndex(int& workingIndex)
 
 	indexes.pop_back();
 	stateAtA.pop_back();
-	stateAtB.pop_back();
+	unsigned int z = slices[workingIndex];
+	stateAtB.toggleSlice(z, basis[workingIndex][z]);
 	weight.pop_back();
 	C.pop_back();
 	D.pop_back();
@@ -1021,6 +997,15 @@ const vector<SliceValue>& stateForwardIterator::operator*()
 
 void KeccakFTrailExtensionBasedOnParity::forwardExtendTrailsInTheKernel(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight)
 {
+	if (nrThreads != 1) {
+		parallelExtendTrails(trailsIn, trailsOut, nrRounds, maxTotalWeight,
+			[this](ExtensionContext& context, unsigned int worker, const Trail& trail) {
+				if (trail.stateAfterLastChiSpecified)
+					throw KeccakException("KeccakFTrailExtension::forwardExtendTrail() can work only with trail cores or trail prefixes.");
+				parallelForwardExtendTrailInTheKernel(context, worker, trail);
+			});
+		return;
+	}
 	progress.stack("File", trailsIn.getCount());
 	for (; !trailsIn.isEnd(); ++trailsIn) {
 		forwardExtendTrailInTheKernel(*trailsIn, trailsOut, nrRounds, maxTotalWeight);
@@ -1044,8 +1029,10 @@ void KeccakFTrailExtensionBasedOnParity::recurseForwardExtendTrailInTheKernel(co
 	int curWeight = trail.weights.back();
 	int maxWeightOut = maxTotalWeight - baseWeight
 		- knownBounds.getMinWeight(nrRounds - baseNrRounds - 1);
-	if (maxWeightOut < knownBounds.getMinWeight(1))
+	if (maxWeightOut < knownBounds.getMinWeight(1)) {
+		countSearchEvent(statistics, SearchStatistics::prunedByCost, curNrRounds);
 		return;
+	}
 	string synopsis;
 	{
 		stringstream str;
@@ -1067,13 +1054,16 @@ void KeccakFTrailExtensionBasedOnParity::recurseForwardExtendTrailInTheKernel(co
 				bool minTrail = showMinimalTrails && isLessThanMinWeightSoFar(curNrRounds, curWeight);
 				if (minTrail)
 					cout << "! " << dec << curNrRounds << "-round trail of weight " << dec << curWeight << " found" << endl;
-				if ((curWeight <= maxTotalWeight) || minTrail) {
+				bool output = (curWeight <= maxTotalWeight) || minTrail;
+				countSearchChild(statistics, output ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+				if (output) {
 					Trail newTrail(trail);
 					newTrail.append((*i), weightOut);
 					trailsOut.fetchTrail(newTrail);
 				}
 			}
 			else {
+				countSearchChild(statistics, (weightOut <= maxWeightOut) ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
 				if (weightOut <= maxWeightOut) {
 					Trail newTrail(trail);
 					newTrail.append((*i), weightOut);
@@ -1090,20 +1080,25 @@ void KeccakFTrailExtensionBasedOnParity::recurseForwardExtendTrailInTheKernel(co
 		// generate the iterator
 		SlicesAffineSpaceIterator i = base.getIteratorInKernel();
 		progress.stack(synopsis + " [affine base]", i.getCount());
-		for (; !i.isEnd(); ++i) {
-			int weightOut = getWeight(*i);
+		// Each step adds one generator, so only the slices it touches need to be weighed again.
+		auto weightOfSlice = [this](SliceValue slice) { return getWeight(slice); };
+		int weightOut = i.isEnd() ? 0 : getWeight(*i);
+		for (; !i.isEnd(); ++i, weightOut = i.getUpdatedSum(weightOut, weightOfSlice)) {
 			int curWeight = baseWeight + weightOut;
 			if (curNrRounds == (int)nrRounds) {
 				bool minTrail = showMinimalTrails && isLessThanMinWeightSoFar(curNrRounds, curWeight);
 				if (minTrail)
 					cout << "! " << dec << curNrRounds << "-round trail of weight " << dec << curWeight << " found" << endl;
-				if ((curWeight <= maxTotalWeight) || minTrail) {
+				bool output = (curWeight <= maxTotalWeight) || minTrail;
+				countSearchChild(statistics, output ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+				if (output) {
 					Trail newTrail(trail);
 					newTrail.append((*i), weightOut);
 					trailsOut.fetchTrail(newTrail);
 				}
 			}
 			else {
+				countSearchChild(statistics, (weightOut <= maxWeightOut) ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
 				if (weightOut <= maxWeightOut) {
 					Trail newTrail(trail);
 					newTrail.append((*i), weightOut);
@@ -1119,6 +1114,16 @@ void KeccakFTrailExtensionBasedOnParity::recurseForwardExtendTrailInTheKernel(co
 
 void KeccakFTrailExtensionBasedOnParity::backwardExtendTrailsInTheKernel(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight)
 {
+	if (nrThreads != 1) {
+		parallelExtendTrails(trailsIn, trailsOut, nrRounds, maxTotalWeight,
+			[this](ExtensionContext& context, unsigned int worker, const Trail& trail) {
+				if (trail.firstStateSpecified)
+					parallelBackwardExtendTrailInTheKernel(context, worker, trail);
+				else
+					parallelBackwardExtendTrailInTheKernel(context, worker, getTrimmedTrailPrefix(trail));
+			});
+		return;
+	}
 	progress.stack("File", trailsIn.getCount());
 	for (; !trailsIn.isEnd(); ++trailsIn) {
 		backwardExtendTrailInTheKernel(*trailsIn, trailsOut, nrRounds, maxTotalWeight);
@@ -1131,17 +1136,18 @@ void KeccakFTrailExtensionBasedOnParity::backwardExtendTrailInTheKernel(const Tr
 {
 	bool isPrefix = trail.firstStateSpecified;
 	if (isPrefix) {
-		recurseBackwardExtendTrailInTheKernel(trail, trailsOut, nrRounds, maxTotalWeight);
+		recurseBackwardExtendTrailInTheKernel(trail, trailsOut, nrRounds, maxTotalWeight, statistics);
 	}
 	else {
 		Trail trimmedTrailPrefix;
 		for (unsigned int i = 1; i<trail.states.size(); i++)
 			trimmedTrailPrefix.append(trail.states[i], trail.weights[i]);
-		recurseBackwardExtendTrailInTheKernel(trimmedTrailPrefix, trailsOut, nrRounds, maxTotalWeight);
+		recurseBackwardExtendTrailInTheKernel(trimmedTrailPrefix, trailsOut, nrRounds, maxTotalWeight, statistics);
 	}
 }
 
-void KeccakFTrailExtensionBasedOnParity::recurseBackwardExtendTrailInTheKernel(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight)
+void KeccakFTrailExtensionBasedOnParity::recurseBackwardExtendTrailInTheKernel(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight,
+	SearchStatistics *aStatistics)
 {
 	if (!allPrefixes && (nrRounds == (trail.getNumberOfRounds() + 1))) {
 		int baseWeight = trail.totalWeight;
@@ -1162,10 +1168,13 @@ void KeccakFTrailExtensionBasedOnParity::recurseBackwardExtendTrailInTheKernel(c
 	else {
 	int baseWeight = trail.totalWeight;
 	// int baseNrRounds = trail.getNumberOfRounds();
+	unsigned int curNrRounds = trail.getNumberOfRounds() + 1;
 	int maxWeightOut = maxTotalWeight - baseWeight
 		- knownBounds.getMinWeight(1);
-	if (maxWeightOut < knownBounds.getMinWeight(1))
+	if (maxWeightOut < knownBounds.getMinWeight(1)) {
+		countSearchEvent(aStatistics, SearchStatistics::prunedByCost, curNrRounds);
 		return;
+	}
 
 	// compute state after chi
 	vector<SliceValue> stateAfterChi(laneSize, 0);
@@ -1176,8 +1185,10 @@ void KeccakFTrailExtensionBasedOnParity::recurseBackwardExtendTrailInTheKernel(c
 	AffineSpaceOfStates basisAfterTheta = getdBasisAfterThetaGivenPatternBeforeChi(*this, basisBeforeChi);
 	// check min weight
 	int curWeight = baseWeight + getWeight(basisBeforeChi.offset) + getMinReverseWeight(basisAfterTheta.offset);
-	if (curWeight > maxTotalWeight)
+	if (curWeight > maxTotalWeight) {
+		countSearchEvent(aStatistics, SearchStatistics::prunedByCost, curNrRounds);
 		return;
+	}
 	// check whether intersection with the kernel is empty
 	if (!intersectionWithKernel(basisAfterTheta))
 		return;
@@ -1197,16 +1208,34 @@ void KeccakFTrailExtensionBasedOnParity::recurseBackwardExtendTrailInTheKernel(c
 			newTrail.append(stateBeforeChi, getWeight(stateBeforeChi));
 			for (unsigned int i = 0; i<trail.states.size(); i++)
 				newTrail.append(trail.states[i], trail.weights[i]);
-			if ((int)newTrail.totalWeight <= maxTotalWeight){
+			bool output = ((int)newTrail.totalWeight <= maxTotalWeight);
+			countSearchChild(aStatistics, output ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+			if (output){
 				trailsOut.fetchTrail(newTrail);
 			}
 		}
+		else
+			countSearchChild(aStatistics, SearchStatistics::prunedByChiCompatibility, curNrRounds);
 	}
 }
 }
 
 void KeccakFTrailExtensionBasedOnParity::backwardExtendTrailsOutsideKernel(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight)
 {
+	if (nrThreads != 1) {
+		parallelExtendTrails(trailsIn, trailsOut, nrRounds, maxTotalWeight,
+			[this](ExtensionContext& context, unsigned int worker, const Trail& trail) {
+				if (trail.firstStateSpecified) {
+					int maxRevWeight = context.maxTotalWeight - max(int(trail.totalWeight + 2), knownBounds.getMinWeight(trail.getNumberOfRounds()));
+					parallelBackwardExtendTrailOutsideKernel(context, worker, trail, maxRevWeight, true);
+				}
+				else {
+					int maxRevWeight = context.maxTotalWeight - trail.totalWeight;
+					parallelBackwardExtendTrailOutsideKernel(context, worker, getTrimmedTrailPrefix(trail), maxRevWeight, allPrefixes);
+				}
+			});
+		return;
+	}
 	progress.stack("File", trailsIn.getCount());
 	for (; !trailsIn.isEnd(); ++trailsIn) {
 		backwardExtendTrailOutsideKernel(*trailsIn, trailsOut, nrRounds, maxTotalWeight);
@@ -1254,8 +1283,10 @@ void KeccakFTrailExtensionBasedOnParity::recurseBackwardExtendTrailOutsideKernel
 		int baseNrRounds = trail.getNumberOfRounds();
 		int maxWeightOut = maxTotalWeight - baseWeight
 			- knownBounds.getMinWeight(nrRounds - baseNrRounds - 1);
-		if (maxWeightOut < knownBounds.getMinWeight(1))
+		if (maxWeightOut < knownBounds.getMinWeight(1)) {
+			countSearchEvent(statistics, SearchStatistics::prunedByCost, baseNrRounds + 1);
 			return;
+		}
 		// compute state after chi by applying inverse of lambda on states[0]
 		// this is a2
 		vector<SliceValue> stateAfterChi(laneSize, 0);
@@ -1287,36 +1318,59 @@ void KeccakFTrailExtensionBasedOnParity::recurseBackwardExtendTrailOutsideKernel
 				vector<RowValue> parity = *iterator;
 				// exclude in kernel case
 				vector<RowValue> allzero(laneSize, 0);
-				if (parity != allzero){
+				if (parity == allzero)
+					countSearchChild(statistics, SearchStatistics::prunedByShape, baseNrRounds + 1);
+				else {
 					// if a pattern below the budget is found, then build states with given parity using the basis
-					SlicesAffineSpaceIterator stateIterator = basisAfterTheta.getIteratorWithGivenParity(parity);
-					for (; !stateIterator.isEnd(); ++stateIterator){
-						vector<SliceValue> state = *stateIterator; //theta(a1)
-						vector<SliceValue> stateBeforeChi; //b1
-						directLambdaAfterTheta(state, stateBeforeChi);
-						if (isChiCompatible(stateBeforeChi, stateAfterChi)){// (b1,a2)
-							Trail newTrail;
-							vector<SliceValue> stateBeforeLambda; //a1
-							reverseLambda(stateBeforeChi, stateBeforeLambda);
-							newTrail.setFirstStateReverseMinimumWeight(getMinReverseWeight(stateBeforeLambda));
-							newTrail.append(stateBeforeChi, getWeight(stateBeforeChi)); // add b1
-							for (unsigned int i = 0; i < trail.states.size(); i++)
-								newTrail.append(trail.states[i], trail.weights[i]); //add b2...
-							if ((int)newTrail.totalWeight <= maxTotalWeight)
-								trailsOut.fetchTrail(newTrail);
-						}
-					}
+					backwardExtendTrailWithGivenParity(trail, stateAfterChi, basisAfterTheta, parity, trailsOut, maxTotalWeight, statistics);
 				}
 			}
 		}
 	}
 }
 
+void KeccakFTrailExtensionBasedOnParity::backwardExtendTrailWithGivenParity(const Trail& trail, const vector<SliceValue>& stateAfterChi,
+	const AffineSpaceOfStates& basisAfterTheta, const vector<RowValue>& parity, TrailFetcher& trailsOut, int maxTotalWeight,
+	SearchStatistics *aStatistics) const
+{
+	unsigned int curNrRounds = trail.getNumberOfRounds() + 1;
+	SlicesAffineSpaceIterator stateIterator = basisAfterTheta.getIteratorWithGivenParity(parity);
+	for (; !stateIterator.isEnd(); ++stateIterator){
+		vector<SliceValue> state = *stateIterator; //theta(a1)
+		vector<SliceValue> stateBeforeChi; //b1
+		directLambdaAfterTheta(state, stateBeforeChi);
+		if (isChiCompatible(stateBeforeChi, stateAfterChi)){// (b1,a2)
+			Trail newTrail;
+			vector<SliceValue> stateBeforeLambda; //a1
+			reverseLambda(stateBeforeChi, stateBeforeLambda);
+			newTrail.setFirstStateReverseMinimumWeight(getMinReverseWeight(stateBeforeLambda));
+			newTrail.append(stateBeforeChi, getWeight(stateBeforeChi)); // add b1
+			for (unsigned int i = 0; i < trail.states.size(); i++)
+				newTrail.append(trail.states[i], trail.weights[i]); //add b2...
+			bool output = ((int)newTrail.totalWeight <= maxTotalWeight);
+			countSearchChild(aStatistics, output ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+			if (output)
+				trailsOut.fetchTrail(newTrail);
+		}
+		else
+			countSearchChild(aStatistics, SearchStatistics::prunedByChiCompatibility, curNrRounds);
+	}
+}
+
 void KeccakFTrailExtensionBasedOnParity::forwardExtendTrailsOutsideKernel(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight)
 {
-	progress.stack("File", trailsIn.getCount());
 	vector<AffineSpaceOfRows> basisPerInput;
 	setBasisPerInput(*this, basisPerInput);
+	if (nrThreads != 1) {
+		parallelExtendTrails(trailsIn, trailsOut, nrRounds, maxTotalWeight,
+			[this, &basisPerInput](ExtensionContext& context, unsigned int worker, const Trail& trail) {
+				if (trail.stateAfterLastChiSpecified)
+					throw KeccakException("KeccakFTrailExtension::forwardExtendTrail() can work only with trail cores or trail prefixes.");
+				parallelForwardExtendTrailOutsideKernel(context, worker, trail, basisPerInput);
+			});
+		return;
+	}
+	progress.stack("File", trailsIn.getCount());
 	for (; !trailsIn.isEnd(); ++trailsIn) {
 		forwardExtendTrailOutsideKernel(*trailsIn, trailsOut, nrRounds, maxTotalWeight, basisPerInput);
 		++progress;
@@ -1339,8 +1393,10 @@ void KeccakFTrailExtensionBasedOnParity::recurseForwardExtendTrailOutsideTheKern
 	int curWeight = trail.weights.back();
 	int maxWeightOut = maxTotalWeight - baseWeight
 		- knownBounds.getMinWeight(nrRounds - baseNrRounds - 1);
-	if (maxWeightOut < knownBounds.getMinWeight(1))
+	if (maxWeightOut < knownBounds.getMinWeight(1)) {
+		countSearchEvent(statistics, SearchStatistics::prunedByCost, curNrRounds);
 		return;
+	}
 	string synopsis;
 	{
 		stringstream str;
@@ -1362,13 +1418,16 @@ void KeccakFTrailExtensionBasedOnParity::recurseForwardExtendTrailOutsideTheKern
 				bool minTrail = showMinimalTrails && isLessThanMinWeightSoFar(curNrRounds, curWeight);
 				if (minTrail)
 					cout << "! " << dec << curNrRounds << "-round trail of weight " << dec << curWeight << " found" << endl;
-				if ((curWeight <= maxTotalWeight) || minTrail) {
+				bool output = (curWeight <= maxTotalWeight) || minTrail;
+				countSearchChild(statistics, output ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+				if (output) {
 					Trail newTrail(trail);
 					newTrail.append((*i), weightOut);
 					trailsOut.fetchTrail(newTrail);
 				}
 			}
 			else {
+				countSearchChild(statistics, (weightOut <= maxWeightOut) ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
 				if (weightOut <= maxWeightOut) {
 					Trail newTrail(trail);
 					newTrail.append((*i), weightOut);
@@ -1392,14 +1451,16 @@ void KeccakFTrailExtensionBasedOnParity::recurseForwardExtendTrailOutsideTheKern
 			vector<RowValue> parity;
 			getParity(*iterator, parity);
 			vector<RowValue> allzero(laneSize, 0);
-			if (parity != allzero){
+			if (parity == allzero)
+				countSearchChild(statistics, SearchStatistics::prunedByShape, curNrRounds);
+			else {
 				// compute state after lambda and construct the extended trail
 				vector<SliceValue> stateAfterLambda(laneSize, 0);
 				directLambda(*iterator, stateAfterLambda);
 				int weightOut = getWeight(stateAfterLambda);
 				int curWeight = baseWeight + weightOut;
 				if (curNrRounds == (int)nrRounds) {
-
+					countSearchChild(statistics, (curWeight <= maxTotalWeight) ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
 					if ((curWeight <= maxTotalWeight)) {
 						Trail newTrail(trail);
 						newTrail.append((stateAfterLambda), weightOut);
@@ -1407,6 +1468,7 @@ void KeccakFTrailExtensionBasedOnParity::recurseForwardExtendTrailOutsideTheKern
 					}
 				}
 				else {
+					countSearchChild(statistics, (weightOut <= maxWeightOut) ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
 					if (weightOut <= maxWeightOut) {
 						Trail newTrail(trail);
 						newTrail.append((stateAfterLambda), weightOut);
@@ -1419,3 +1481,215 @@ void KeccakFTrailExtensionBasedOnParity::recurseForwardExtendTrailOutsideTheKern
 		progress.unstack();
 	}
 }
+
+Trail KeccakFTrailExtensionBasedOnParity::getTrimmedTrailPrefix(const Trail& trail)
+{
+	Trail trimmedTrailPrefix;
+	for (unsigned int i = 1; i<trail.states.size(); i++)
+		trimmedTrailPrefix.append(trail.states[i], trail.weights[i]);
+	return trimmedTrailPrefix;
+}
+
+void KeccakFTrailExtensionBasedOnParity::parallelExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight,
+	const function<void(ExtensionContext& context, unsigned int worker, const Trail& trail)>& extendTrail)
+{
+	// The bounds are computed beforehand, as the workers only read them.
+	knownBounds.getMinWeight(nrRounds);
+	ExtensionContext context(nrThreads, trailsOut, nrRounds, maxTotalWeight, trailsIn.getCount(), statistics);
+	context.pool.run([&](WorkStealingPool::Task& task) -> bool {
+		if (trailsIn.isEnd())
+			return false;
+		Trail trail(*trailsIn);
+		++trailsIn;
+		context.progress.advance();
+		task = [&context, &extendTrail, trail](unsigned int worker) {
+			extendTrail(context, worker, trail);
+		};
+		return true;
+	});
+}
+
+void KeccakFTrailExtensionBasedOnParity::parallelAppendState(ExtensionContext& context, unsigned int worker, const Trail& trail,
+	const vector<SliceValue>& state, int weightOut, int maxWeightOut, bool minimalTrails)
+{
+	context.progress.countNode(worker);
+	unsigned int curNrRounds = trail.getNumberOfRounds() + 1;
+	if (curNrRounds == context.nrRounds) {
+		int curWeight = trail.totalWeight + weightOut;
+		bool output = (curWeight <= context.maxTotalWeight) || (minimalTrails && showMinimalTrails);
+		countSearchChild(context.getStatistics(worker), output ? SearchStatistics::nodesVisited : SearchStatistics::prunedByCost, curNrRounds);
+		if (output) {
+			Trail newTrail(trail);
+			newTrail.append(state, weightOut);
+			if (minimalTrails)
+				outputMinimalOrLightTrail(context, newTrail, curNrRounds);
+			else
+				context.trailsOut.fetchTrail(newTrail);
+		}
+	}
+	else if (weightOut > maxWeightOut)
+		countSearchChild(context.getStatistics(worker), SearchStatistics::prunedByCost, curNrRounds);
+	else {
+		countSearchChild(context.getStatistics(worker), SearchStatistics::nodesVisited, curNrRounds);
+		Trail newTrail(trail);
+		newTrail.append(state, weightOut);
+		parallelForwardExtendTrail(context, worker, newTrail);
+	}
+}
+
+void KeccakFTrailExtensionBasedOnParity::parallelOutputTrailCore(ExtensionContext& context, const Trail& trail)
+{
+	vector<SliceValue> stateAfterChi;
+	reverseLambda(trail.states[0], stateAfterChi);
+	int curMinReverseWeight = getMinReverseWeight(stateAfterChi);
+	if (showMinimalTrails || ((int)trail.totalWeight + curMinReverseWeight <= context.maxTotalWeight)) {
+		Trail newTrail;
+		newTrail.setFirstStateReverseMinimumWeight(curMinReverseWeight);
+		newTrail.append(trail);
+		outputMinimalOrLightTrail(context, newTrail, context.nrRounds);
+	}
+}
+
+void KeccakFTrailExtensionBasedOnParity::parallelForwardExtendTrailInTheKernel(ExtensionContext& context, unsigned int worker, const Trail& trail)
+{
+	int baseNrRounds = trail.getNumberOfRounds();
+	int curWeight = trail.weights.back();
+	int maxWeightOut = context.maxTotalWeight - trail.totalWeight
+		- knownBounds.getMinWeight(context.nrRounds - baseNrRounds - 1);
+	if (maxWeightOut < knownBounds.getMinWeight(1)) {
+		countSearchEvent(context.getStatistics(worker), SearchStatistics::prunedByCost, baseNrRounds + 1);
+		return;
+	}
+
+	const int minWeightInLookingForSmallWeightStates = 16;
+	if ((curWeight >= minWeightInLookingForSmallWeightStates) && (knownSmallWeightStates != 0)
+		&& (maxWeightOut <= knownSmallWeightStates->getMaxCompleteWeight())) {
+		vector<vector<SliceValue> > compatibleStates;
+		knownSmallWeightStates->connect(*this, trail.states.back(), maxWeightOut, compatibleStates);
+		for (vector<vector<SliceValue> >::const_iterator i = compatibleStates.begin(); i != compatibleStates.end(); ++i)
+			parallelAppendState(context, worker, trail, *i, getWeight(*i), maxWeightOut, true);
+	}
+	else {
+		AffineSpaceOfStates base = buildStateBase(trail.states.back());
+		SlicesAffineSpaceIterator i = base.getIteratorInKernel();
+		auto weightOfSlice = [this](SliceValue slice) { return getWeight(slice); };
+		int weightOut = i.isEnd() ? 0 : getWeight(*i);
+		for (; !i.isEnd(); ++i, weightOut = i.getUpdatedSum(weightOut, weightOfSlice))
+			parallelAppendState(context, worker, trail, *i, weightOut, maxWeightOut, true);
+	}
+}
+
+void KeccakFTrailExtensionBasedOnParity::parallelBackwardExtendTrailInTheKernel(ExtensionContext& context, unsigned int worker, const Trail& trail)
+{
+	// Besides the output of trail cores, the sequential method does not touch the minimum weights so far.
+	if (!allPrefixes && (context.nrRounds == (trail.getNumberOfRounds() + 1)))
+		parallelOutputTrailCore(context, trail);
+	else
+		recurseBackwardExtendTrailInTheKernel(trail, context.trailsOut, context.nrRounds, context.maxTotalWeight, context.getStatistics(worker));
+}
+
+/** This class contains the affine space of states after theta of the trails
+  * prepended by the parallel backward extension outside the kernel,
+  * which the workers share while enumerating the parities.
+  */
+class BackwardExtensionSpace {
+public:
+	Trail trail;
+	vector<SliceValue> stateAfterChi;
+	AffineSpaceOfStates basisAfterTheta;
+	vector<vector<RowValue> > values;
+	vector<vector<unsigned int> > nrVectors;
+	unsigned int start;
+	int maxRevWeight;
+public:
+	BackwardExtensionSpace(const Trail& aTrail, const vector<SliceValue>& aStateAfterChi, const AffineSpaceOfStates& aBasisAfterTheta, int aMaxRevWeight)
+		: trail(aTrail), stateAfterChi(aStateAfterChi), basisAfterTheta(aBasisAfterTheta),
+		values(getRowValuesFromBasis(basisAfterTheta)), nrVectors(getnNrBasisVectorsPerColumn(basisAfterTheta)),
+		start(getStartingSlice(basisAfterTheta)), maxRevWeight(aMaxRevWeight) {}
+};
+
+void KeccakFTrailExtensionBasedOnParity::parallelBackwardExtendTrailOutsideKernel(ExtensionContext& context, unsigned int worker, const Trail& trail, int maxRevWeight, bool allPrefixes)
+{
+	if (!allPrefixes && (context.nrRounds == (trail.getNumberOfRounds() + 1))) {
+		parallelOutputTrailCore(context, trail);
+		return;
+	}
+	int maxWeightOut = context.maxTotalWeight - trail.totalWeight
+		- knownBounds.getMinWeight(context.nrRounds - trail.getNumberOfRounds() - 1);
+	if (maxWeightOut < knownBounds.getMinWeight(1)) {
+		countSearchEvent(context.getStatistics(worker), SearchStatistics::prunedByCost, trail.getNumberOfRounds() + 1);
+		return;
+	}
+	vector<SliceValue> stateAfterChi(laneSize, 0);
+	reverseLambda(trail.states[0], stateAfterChi);
+	AffineSpaceOfStates basisBeforeChi = buildBasisBeforeChiGivenPatternAfterChi(stateAfterChi);
+	AffineSpaceOfStates basisAfterTheta = getdBasisAfterThetaGivenPatternBeforeChi(*this, basisBeforeChi);
+	shared_ptr<const BackwardExtensionSpace> sharedSpace(new BackwardExtensionSpace(trail, stateAfterChi, basisAfterTheta, maxRevWeight));
+
+	// The parity tree is split at its root, i.e., on the guess of the starting row before theta,
+	// and the states with a given parity are handed over to idle workers.
+	for (unsigned int k = 0; k < 32; k++)
+		context.pool.spawn(worker, [this, &context, sharedSpace, k](unsigned int worker) {
+			const BackwardExtensionSpace& space = *sharedSpace;
+			RowValue guess = k;
+			parityBackwardIterator iterator(*this, space.basisAfterTheta.offset, space.basisAfterTheta.offsetParity,
+				space.values, space.nrVectors, space.start, guess, space.maxRevWeight);
+			vector<RowValue> allzero(laneSize, 0);
+			for (; !iterator.isEnd(); ++iterator) {
+				const vector<RowValue>& parity = *iterator;
+				context.progress.countNode(worker);
+				if (parity == allzero) {
+					countSearchChild(context.getStatistics(worker), SearchStatistics::prunedByShape, space.trail.getNumberOfRounds() + 1);
+					continue;
+				}
+				if (context.pool.isHungry()) {
+					vector<RowValue> givenParity(parity);
+					context.pool.spawn(worker, [this, &context, sharedSpace, givenParity](unsigned int otherWorker) {
+						backwardExtendTrailWithGivenParity(sharedSpace->trail, sharedSpace->stateAfterChi,
+							sharedSpace->basisAfterTheta, givenParity, context.trailsOut, context.maxTotalWeight,
+							context.getStatistics(otherWorker));
+					});
+				}
+				else
+					backwardExtendTrailWithGivenParity(space.trail, space.stateAfterChi, space.basisAfterTheta,
+						parity, context.trailsOut, context.maxTotalWeight, context.getStatistics(worker));
+			}
+		});
+}
+
+void KeccakFTrailExtensionBasedOnParity::parallelForwardExtendTrailOutsideKernel(ExtensionContext& context, unsigned int worker, const Trail& trail, vector<AffineSpaceOfRows> basisPerInput)
+{
+	int baseNrRounds = trail.getNumberOfRounds();
+	int curWeight = trail.weights.back();
+	int maxWeightOut = context.maxTotalWeight - trail.totalWeight
+		- knownBounds.getMinWeight(context.nrRounds - baseNrRounds - 1);
+	if (maxWeightOut < knownBounds.getMinWeight(1)) {
+		countSearchEvent(context.getStatistics(worker), SearchStatistics::prunedByCost, baseNrRounds + 1);
+		return;
+	}
+
+	const int minWeightInLookingForSmallWeightStates = 16;
+	if ((curWeight >= minWeightInLookingForSmallWeightStates) && (knownSmallWeightStates != 0)
+		&& (maxWeightOut <= knownSmallWeightStates->getMaxCompleteWeight())) {
+		vector<vector<SliceValue> > compatibleStates;
+		knownSmallWeightStates->connect(*this, trail.states.back(), maxWeightOut, compatibleStates);
+		for (vector<vector<SliceValue> >::const_iterator i = compatibleStates.begin(); i != compatibleStates.end(); ++i)
+			parallelAppendState(context, worker, trail, *i, getWeight(*i), maxWeightOut, true);
+	}
+	else {
+		AffineSpaceOfStates base = buildBasisAfterChiGivenPatternBeforeChi(basisPerInput, trail.states.back());
+		stateForwardIterator iterator(*this, base, maxWeightOut);
+		vector<RowValue> allzero(laneSize, 0);
+		for (; !iterator.isEnd(); ++iterator) {
+			vector<RowValue> parity;
+			getParity(*iterator, parity);
+			if (parity == allzero)
+				countSearchChild(context.getStatistics(worker), SearchStatistics::prunedByShape, baseNrRounds + 1);
+			else {
+				vector<SliceValue> stateAfterLambda(laneSize, 0);
+				directLambda(*iterator, stateAfterLambda);
+				parallelAppendState(context, worker, trail, stateAfterLambda, getWeight(stateAfterLambda), maxWeightOut, false);
+			}
+		}
+	}
+}
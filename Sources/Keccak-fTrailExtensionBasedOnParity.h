@@ -23,6 +23,7 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include "Keccak-f.h"
 #include "Keccak-fAffineBases.h"
 #include "Keccak-fDCLC.h"
+#include "Keccak-fIncrementalState.h"
 #include "Keccak-fParts.h"
 #include "Keccak-fPropagation.h"
 #include "Keccak-fTrailExtension.h"
@@ -208,9 +209,9 @@ public:
 	* @param aGuess The guess on the value of the starting slice.
 	* @param aMaxWeight The maximum total weight to consider.
 	*/
-	parityBackwardIterator(const KeccakFPropagation& aDCorLC, vector<SliceValue> &aOffset, vector<RowValue> &aOffsetParity,
-		vector<vector<RowValue> > &aValuesX, vector<vector<unsigned int> > &aNrBasisVectors, unsigned int& aStart,
-		RowValue& aGuess, unsigned int aMaxWeight);
+	parityBackwardIterator(const KeccakFPropagation& aDCorLC, const vector<SliceValue> &aOffset, const vector<RowValue> &aOffsetParity,
+		const vector<vector<RowValue> > &aValuesX, const vector<vector<unsigned int> > &aNrBasisVectors, const unsigned int& aStart,
+		const RowValue& aGuess, unsigned int aMaxWeight);
 
 	/** This method initializes the iterator, by calling the method first. */
 	void initialize();
@@ -318,8 +319,8 @@ public:
 	vector<int> indexes;
 	/** The current state after chi. */
 	vector<vector<SliceValue> > stateAtA;
-	/** The current state after lambda. */
-	vector<vector<SliceValue> > stateAtB;
+	/** The current state after chi and its image after lambda, updated incrementally as basis vectors are pushed and popped. */
+	IncrementalState stateAtB;
 	/** The current weight of the state after lambda. */
 	vector<unsigned int> weight;
 	/** The maximum weight to generate states. */
@@ -469,7 +470,7 @@ public:
 	void forwardExtendTrailInTheKernel(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight);
 	
 	/** This function is like forwardExtendTrailInTheKernel(), except that it processes
-	* all the trails from @a trailsIn.
+	* all the trails from @a trailsIn, possibly in parallel, see @a nrThreads.
 	* @param  trailsIn    The starting trail cores or trail prefixes.
 	* @param  trailsOut   Where to output the found trails.
 	* @param  nrRounds    The target number of rounds.
@@ -491,7 +492,7 @@ public:
 	void backwardExtendTrailInTheKernel(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight);
 	
 	/** This function is like backwardExtendTrails(), except that it processes
-	* all the trails from @a trailsIn.
+	* all the trails from @a trailsIn, possibly in parallel, see @a nrThreads.
 	* @param  trailsIn    The starting trail cores or trail prefixes.
 	* @param  trailsOut   Where to output the found trails.
 	* @param  nrRounds    The target number of rounds.
@@ -517,7 +518,7 @@ public:
 	void backwardExtendTrailOutsideKernel(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight);
 	
 	/** This function is like backwardExtendTrailOutsideKernel(), except that it processes
-	* all the trails from @a trailsIn.
+	* all the trails from @a trailsIn, possibly in parallel, see @a nrThreads.
 	* @param  trailsIn    The starting trail cores or trail prefixes.
 	* @param  trailsOut   Where to output the found trails.
 	* @param  nrRounds    The target number of rounds.
@@ -531,6 +532,7 @@ public:
 	* up to total weight @a maxTotalWeight
 	* that have the given trail as prefix
 	* and whose states after chi are outside the kernel.
+	* The trails from @a trailsIn are processed possibly in parallel, see @a nrThreads.
 	* @param  trail   The starting trail core or trail prefix.
 	* @param  trailsOut   Where to output the found trails.
 	* @param  nrRounds    The target number of rounds.
@@ -550,9 +552,23 @@ public:
 protected:
 
 	void recurseForwardExtendTrailInTheKernel(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight);
-	void recurseBackwardExtendTrailInTheKernel(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight);
+	void recurseBackwardExtendTrailInTheKernel(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight,
+		SearchStatistics *aStatistics);
 	void recurseForwardExtendTrailOutsideTheKernel(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight, vector<AffineSpaceOfRows> basisPerInput);
 	void recurseBackwardExtendTrailOutsideKernel(const Trail& trail, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight, int maxRevWeight, bool allPrefixes);
+	void backwardExtendTrailWithGivenParity(const Trail& trail, const vector<SliceValue>& stateAfterChi,
+		const AffineSpaceOfStates& basisAfterTheta, const vector<RowValue>& parity, TrailFetcher& trailsOut, int maxTotalWeight,
+		SearchStatistics *aStatistics) const;
+	static Trail getTrimmedTrailPrefix(const Trail& trail);
+	void parallelExtendTrails(TrailIterator& trailsIn, TrailFetcher& trailsOut, unsigned int nrRounds, int maxTotalWeight,
+		const function<void(ExtensionContext& context, unsigned int worker, const Trail& trail)>& extendTrail);
+	void parallelAppendState(ExtensionContext& context, unsigned int worker, const Trail& trail,
+		const vector<SliceValue>& state, int weightOut, int maxWeightOut, bool minimalTrails);
+	void parallelOutputTrailCore(ExtensionContext& context, const Trail& trail);
+	void parallelForwardExtendTrailInTheKernel(ExtensionContext& context, unsigned int worker, const Trail& trail);
+	void parallelBackwardExtendTrailInTheKernel(ExtensionContext& context, unsigned int worker, const Trail& trail);
+	void parallelBackwardExtendTrailOutsideKernel(ExtensionContext& context, unsigned int worker, const Trail& trail, int maxRevWeight, bool allPrefixes);
+	void parallelForwardExtendTrailOutsideKernel(ExtensionContext& context, unsigned int worker, const Trail& trail, vector<AffineSpaceOfRows> basisPerInput);
 
 };
 
@@ -0,0 +1,241 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <exception>
+#include <memory>
+#include <thread>
+#include "Keccak-fParity.h"
+#include "Keccak-fTrailPipeline.h"
+
+using namespace std;
+
+TrailFilterTotalWeight::TrailFilterTotalWeight(unsigned int aMaxWeight, unsigned int aMinWeight)
+    : minWeight(aMinWeight), maxWeight(aMaxWeight)
+{
+}
+
+bool TrailFilterTotalWeight::filter(const KeccakFPropagation& DCorLC, const Trail& trail) const
+{
+    (void)DCorLC;
+    return (trail.totalWeight >= minWeight) && (trail.totalWeight <= maxWeight);
+}
+
+TrailFilterNumberOfRounds::TrailFilterNumberOfRounds(unsigned int aMinNrRounds, unsigned int aMaxNrRounds)
+    : minNrRounds(aMinNrRounds), maxNrRounds(aMaxNrRounds == 0 ? aMinNrRounds : aMaxNrRounds)
+{
+}
+
+bool TrailFilterNumberOfRounds::filter(const KeccakFPropagation& DCorLC, const Trail& trail) const
+{
+    (void)DCorLC;
+    unsigned int nrRounds = trail.getNumberOfRounds();
+    return (nrRounds >= minNrRounds) && (nrRounds <= maxNrRounds);
+}
+
+TrailFilterInKernel::TrailFilterInKernel(unsigned int aMinNrRoundsInKernel)
+    : minNrRoundsInKernel(aMinNrRoundsInKernel)
+{
+}
+
+bool TrailFilterInKernel::filter(const KeccakFPropagation& DCorLC, const Trail& trail) const
+{
+    vector<SliceValue> stateBeforeTheta;
+    return isKept(DCorLC, trail, stateBeforeTheta);
+}
+
+void TrailFilterInKernel::filterBatch(const KeccakFPropagation& DCorLC, vector<Trail>& trails) const
+{
+    vector<SliceValue> stateBeforeTheta;
+    unsigned int kept = 0;
+    for(unsigned int i=0; i<trails.size(); i++)
+        if (isKept(DCorLC, trails[i], stateBeforeTheta)) {
+            if (kept != i)
+                trails[kept] = trails[i];
+            kept++;
+        }
+    trails.resize(kept);
+}
+
+bool TrailFilterInKernel::isKept(const KeccakFPropagation& DCorLC, const Trail& trail, vector<SliceValue>& stateBeforeTheta) const
+{
+    unsigned int nrRoundsSpecified = 0;
+    unsigned int nrRoundsInKernel = 0;
+    for(unsigned int i=(trail.firstStateSpecified ? 0 : 1); i<trail.states.size(); i++) {
+        nrRoundsSpecified++;
+        DCorLC.reverseLambda(trail.states[i], stateBeforeTheta);
+        bool inKernel = true;
+        for(unsigned int z=0; (z<stateBeforeTheta.size()) && inKernel; z++)
+            inKernel = (getParity(stateBeforeTheta[z]) == 0);
+        if (inKernel)
+            nrRoundsInKernel++;
+    }
+    if (minNrRoundsInKernel == 0)
+        return nrRoundsInKernel == nrRoundsSpecified;
+    else
+        return nrRoundsInKernel >= minNrRoundsInKernel;
+}
+
+void TrailFetcherToVector::fetchTrail(const Trail& trail)
+{
+    trails.push_back(trail);
+}
+
+TrailFetcherDisplay::TrailFetcherDisplay(const KeccakFPropagation& aDCorLC, ostream& aFout)
+    : DCorLC(aDCorLC), fout(aFout)
+{
+}
+
+void TrailFetcherDisplay::fetchTrail(const Trail& trail)
+{
+    trail.display(DCorLC, fout);
+}
+
+TrailBatchQueue::TrailBatchQueue(unsigned int aCapacity)
+    : capacity(max(1U, aCapacity)), closed(false), cancelled(false)
+{
+}
+
+bool TrailBatchQueue::push(vector<Trail>& batch)
+{
+    unique_lock<mutex> guard(lock);
+    notFull.wait(guard, [this]() { return (batches.size() < capacity) || cancelled; });
+    if (cancelled)
+        return false;
+    batches.push_back(vector<Trail>());
+    batches.back().swap(batch);
+    notEmpty.notify_one();
+    return true;
+}
+
+bool TrailBatchQueue::pop(vector<Trail>& batch)
+{
+    unique_lock<mutex> guard(lock);
+    notEmpty.wait(guard, [this]() { return !batches.empty() || closed || cancelled; });
+    if (cancelled || batches.empty())
+        return false;
+    batch.swap(batches.front());
+    batches.pop_front();
+    notFull.notify_one();
+    return true;
+}
+
+void TrailBatchQueue::close()
+{
+    lock_guard<mutex> guard(lock);
+    closed = true;
+    notEmpty.notify_all();
+}
+
+void TrailBatchQueue::cancel()
+{
+    lock_guard<mutex> guard(lock);
+    cancelled = true;
+    notEmpty.notify_all();
+    notFull.notify_all();
+}
+
+TrailPipeline::TrailPipeline(const KeccakFPropagation& aDCorLC, unsigned int aBatchSize, unsigned int aQueueCapacity)
+    : DCorLC(aDCorLC), batchSize(max(1U, aBatchSize)), queueCapacity(aQueueCapacity), nrTrailsRead(0)
+{
+}
+
+void TrailPipeline::addFilter(TrailFilter *filter)
+{
+    filters.push_back(filter);
+}
+
+void TrailPipeline::addSink(TrailFetcher *sink)
+{
+    sinks.push_back(sink);
+}
+
+UINT64 TrailPipeline::run(TrailIterator& source)
+{
+    nrTrailsRead = 0;
+    nrTrailsKept.assign(filters.size(), 0);
+    // queues[i] feeds the filter i, and the last queue feeds the sinks.
+    vector<unique_ptr<TrailBatchQueue> > queues;
+    for(unsigned int i=0; i<=filters.size(); i++)
+        queues.push_back(unique_ptr<TrailBatchQueue>(new TrailBatchQueue(queueCapacity)));
+    mutex failureLock;
+    exception_ptr failure;
+    auto fail = [&]() {
+        {
+            lock_guard<mutex> guard(failureLock);
+            if (!failure)
+                failure = current_exception();
+        }
+        for(unsigned int i=0; i<queues.size(); i++)
+            queues[i]->cancel();
+    };
+
+    UINT64 nrTrailsOut = 0;
+    vector<thread> stages;
+    for(unsigned int i=0; i<filters.size(); i++)
+        stages.push_back(thread([&, i]() {
+            try {
+                vector<Trail> batch;
+                while(queues[i]->pop(batch)) {
+                    filters[i]->filterBatch(DCorLC, batch);
+                    nrTrailsKept[i] += batch.size();
+                    if ((batch.size() > 0) && !queues[i+1]->push(batch))
+                        return;
+                }
+                queues[i+1]->close();
+            }
+            catch(...) {
+                fail();
+            }
+        }));
+    stages.push_back(thread([&]() {
+        try {
+            vector<Trail> batch;
+            while(queues.back()->pop(batch)) {
+                for(unsigned int j=0; j<batch.size(); j++)
+                    for(unsigned int k=0; k<sinks.size(); k++)
+                        sinks[k]->fetchTrail(batch[j]);
+                nrTrailsOut += batch.size();
+            }
+        }
+        catch(...) {
+            fail();
+        }
+    }));
+
+    try {
+        vector<Trail> batch;
+        batch.reserve(batchSize);
+        bool stopped = false;
+        for( ; !source.isEnd() && !stopped; ++source) {
+            batch.push_back(*source);
+            nrTrailsRead++;
+            if (batch.size() >= batchSize) {
+                stopped = !queues[0]->push(batch);
+                batch.reserve(batchSize);
+            }
+        }
+        if ((!stopped) && (batch.size() > 0))
+            queues[0]->push(batch);
+        queues[0]->close();
+    }
+    catch(...) {
+        fail();
+    }
+    for(unsigned int i=0; i<stages.size(); i++)
+        stages[i].join();
+    if (failure)
+        rethrow_exception(failure);
+    return nrTrailsOut;
+}
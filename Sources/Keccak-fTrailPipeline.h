@@ -0,0 +1,202 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFTRAILPIPELINE_H_
+#define _KECCAKFTRAILPIPELINE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "Keccak-fPropagation.h"
+#include "Keccak-fTrails.h"
+
+using namespace std;
+
+/** This class implements a filter that keeps the trails with a total weight
+  * within a given range.
+  */
+class TrailFilterTotalWeight : public TrailFilter
+{
+protected:
+    unsigned int minWeight, maxWeight;
+public:
+    /** The constructor.
+      * @param  aMaxWeight  The maximum total weight of the trails to keep.
+      * @param  aMinWeight  The minimum total weight of the trails to keep.
+      */
+    TrailFilterTotalWeight(unsigned int aMaxWeight, unsigned int aMinWeight = 0);
+    /** See TrailFilter::filter(). */
+    virtual bool filter(const KeccakFPropagation& DCorLC, const Trail& trail) const;
+};
+
+/** This class implements a filter that keeps the trails with a number of rounds
+  * within a given range.
+  */
+class TrailFilterNumberOfRounds : public TrailFilter
+{
+protected:
+    unsigned int minNrRounds, maxNrRounds;
+public:
+    /** The constructor.
+      * @param  aMinNrRounds    The minimum number of rounds of the trails to keep.
+      * @param  aMaxNrRounds    The maximum number of rounds of the trails to keep,
+      *                         or 0 to take the same value as @a aMinNrRounds.
+      */
+    TrailFilterNumberOfRounds(unsigned int aMinNrRounds, unsigned int aMaxNrRounds = 0);
+    /** See TrailFilter::filter(). */
+    virtual bool filter(const KeccakFPropagation& DCorLC, const Trail& trail) const;
+};
+
+/** This class implements a filter that keeps the trails whose states
+  * before θ are in the CP-kernel, i.e., have all their columns of even parity.
+  * The state before θ of the round of states[i] is λ<sup>-1</sup>(states[i]),
+  * and only the rounds with a specified state are considered,
+  * that is, states[0] is skipped for a trail core.
+  */
+class TrailFilterInKernel : public TrailFilter
+{
+protected:
+    unsigned int minNrRoundsInKernel;
+public:
+    /** The constructor.
+      * @param  aMinNrRoundsInKernel    The minimum number of rounds whose state before θ
+      *                                 must be in the kernel, or 0 to require them all.
+      */
+    TrailFilterInKernel(unsigned int aMinNrRoundsInKernel = 0);
+    /** See TrailFilter::filter(). */
+    virtual bool filter(const KeccakFPropagation& DCorLC, const Trail& trail) const;
+    /** See TrailFilter::filterBatch(). The working states are allocated once for the batch. */
+    virtual void filterBatch(const KeccakFPropagation& DCorLC, vector<Trail>& trails) const;
+protected:
+    bool isKept(const KeccakFPropagation& DCorLC, const Trail& trail, vector<SliceValue>& stateBeforeTheta) const;
+};
+
+/** This class implements a TrailFetcher that keeps the trails in memory.
+  */
+class TrailFetcherToVector : public TrailFetcher {
+public:
+    /** The trails fetched, in their order of arrival. */
+    vector<Trail> trails;
+public:
+    /** See TrailFetcher::fetchTrail().*/
+    void fetchTrail(const Trail& trail);
+};
+
+/** This class implements a TrailFetcher that displays the trails in a human-readable form,
+  * see Trail::display().
+  */
+class TrailFetcherDisplay : public TrailFetcher {
+protected:
+    const KeccakFPropagation& DCorLC;
+    ostream& fout;
+public:
+    /** The constructor.
+      * @param   aDCorLC    The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      * @param  aFout   The stream to display to.
+      */
+    TrailFetcherDisplay(const KeccakFPropagation& aDCorLC, ostream& aFout);
+    /** See TrailFetcher::fetchTrail().*/
+    void fetchTrail(const Trail& trail);
+};
+
+/** This class implements a bounded queue of batches of trails between two stages of a TrailPipeline.
+  */
+class TrailBatchQueue {
+protected:
+    unsigned int capacity;
+    deque<vector<Trail> > batches;
+    mutex lock;
+    condition_variable notEmpty, notFull;
+    bool closed, cancelled;
+public:
+    /** The constructor.
+      * @param  aCapacity   The number of batches the queue can hold before push() blocks.
+      */
+    TrailBatchQueue(unsigned int aCapacity);
+    /** This method queues a batch, waiting while the queue is full.
+      * The content of @a batch is moved into the queue, leaving @a batch empty.
+      * @return False if the queue was cancelled.
+      */
+    bool push(vector<Trail>& batch);
+    /** This method takes the oldest batch, waiting while the queue is empty.
+      * @return False if the queue is closed and empty, or if it was cancelled.
+      */
+    bool pop(vector<Trail>& batch);
+    /** This method tells the next stage that no more batches will be pushed. */
+    void close();
+    /** This method makes push() and pop() return false immediately, to stop
+      * the pipeline after an error. */
+    void cancel();
+};
+
+/** This class reads trails from a TrailIterator, passes them through a sequence
+  * of filters and gives the remaining trails to one or more sinks.
+  * The source is read on the calling thread, while each filter and the sinks
+  * run on their own thread, connected by bounded queues of batches of trails,
+  * so that a file can be filtered in a single pass while it is being read.
+  * Since each stage processes the batches in their order, the sinks receive
+  * the trails in the order of the source.
+  * The filters are applied with TrailFilter::filterBatch(), one batch at a time.
+  * The filters and the sinks are not owned by the pipeline.
+  */
+class TrailPipeline {
+protected:
+    const KeccakFPropagation& DCorLC;
+    unsigned int batchSize;
+    unsigned int queueCapacity;
+    vector<TrailFilter *> filters;
+    vector<TrailFetcher *> sinks;
+    UINT64 nrTrailsRead;
+    vector<UINT64> nrTrailsKept;
+public:
+    /** The constructor.
+      * @param   aDCorLC    The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      * @param  aBatchSize  The number of trails per batch.
+      * @param  aQueueCapacity  The number of batches that can wait between two stages.
+      */
+    TrailPipeline(const KeccakFPropagation& aDCorLC, unsigned int aBatchSize = 1024, unsigned int aQueueCapacity = 8);
+    /** This method appends a filter to the pipeline.
+      * @param  filter  A pointer to the filter.
+      */
+    void addFilter(TrailFilter *filter);
+    /** This method adds a sink at the end of the pipeline.
+      * All the sinks receive all the trails kept by the filters,
+      * and are called from the same thread.
+      * @param  sink    A pointer to the sink.
+      */
+    void addSink(TrailFetcher *sink);
+    /** This method runs the pipeline until the source is exhausted.
+      * If a stage throws an exception, the pipeline is stopped and the exception
+      * is thrown again from this method.
+      * @param  source  The source of trails.
+      * @return The number of trails given to the sinks.
+      */
+    UINT64 run(TrailIterator& source);
+    /** This method returns the number of trails read from the source during the last run().
+      * @return The number of trails read.
+      */
+    UINT64 getNumberOfTrailsRead() const { return nrTrailsRead; }
+    /** This method returns the number of trails kept after a given filter during the last run().
+      * @param  i   The index of the filter in the order of addFilter().
+      * @return The number of trails kept by the filters up to the filter @a i included.
+      */
+    UINT64 getNumberOfTrailsKept(unsigned int i) const { return nrTrailsKept[i]; }
+};
+
+#endif
@@ -0,0 +1,205 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "Keccak-fTrailProbability.h"
+
+static unsigned int countBits(BitSlicedWord word)
+{
+    unsigned int count = 0;
+    for( ; word != 0; word &= word - 1)
+        count++;
+    return count;
+}
+
+double RoundProbability::getProbability() const
+{
+    return (nrPairs > 0) ? (double)nrFollowing/nrPairs : 0.0;
+}
+
+double RoundProbability::getPredictedProbability() const
+{
+    return pow(2.0, -(double)weight);
+}
+
+void RoundProbability::getConfidenceInterval(double z, double& low, double& high) const
+{
+    if (nrPairs == 0) {
+        low = 0.0;
+        high = 1.0;
+        return;
+    }
+    double n = (double)nrPairs;
+    double p = getProbability();
+    double denominator = 1.0 + z*z/n;
+    double center = (p + z*z/(2.0*n))/denominator;
+    double halfWidth = z*sqrt(p*(1.0-p)/n + z*z/(4.0*n*n))/denominator;
+    low = max(0.0, center - halfWidth);
+    high = min(1.0, center + halfWidth);
+}
+
+TrailProbabilityEstimator::TrailProbabilityEstimator(const KeccakFPropagation& aDC)
+    : nrThreads(thread::hardware_concurrency()), seed(0), measureDifferential(false),
+    DC(aDC), f(aDC.laneSize*25)
+{
+    if (nrThreads == 0)
+        nrThreads = 1;
+    if (DC.getPropagationType() != KeccakFPropagation::DC)
+        throw KeccakException("TrailProbabilityEstimator applies to differential trails only.");
+}
+
+void TrailProbabilityEstimator::toBitSlices(const vector<SliceValue>& state, vector<BitSlicedWord>& words) const
+{
+    vector<LaneValue> lanes;
+    fromSlicesToLanes(state, lanes);
+    words.assign(25*DC.laneSize, 0);
+    for(unsigned int i=0; i<25; i++)
+        for(unsigned int z=0; z<DC.laneSize; z++)
+            if ((lanes[i] >> z) & 1)
+                words[i*DC.laneSize+z] = ~(BitSlicedWord)0;
+}
+
+void TrailProbabilityEstimator::estimate(const Trail& trail, UINT64 nrPairs, TrailProbability& result) const
+{
+    const unsigned int width = 25*DC.laneSize;
+    const unsigned int firstRound = trail.firstStateSpecified ? 0 : 1;
+    const unsigned int nrStates = (unsigned int)trail.states.size();
+    if (firstRound >= nrStates)
+        throw KeccakException("The trail must have at least one specified state.");
+    // The differences before λ of the specified states, and after the last χ if specified.
+    vector<vector<BitSlicedWord> > differences;
+    for(unsigned int i=firstRound; i<nrStates; i++) {
+        vector<SliceValue> stateBeforeLambda;
+        DC.reverseLambda(trail.states[i], stateBeforeLambda);
+        differences.push_back(vector<BitSlicedWord>());
+        toBitSlices(stateBeforeLambda, differences.back());
+    }
+    if (trail.stateAfterLastChiSpecified) {
+        differences.push_back(vector<BitSlicedWord>());
+        toBitSlices(trail.stateAfterLastChi, differences.back());
+    }
+    const unsigned int nrCheckedRounds = (unsigned int)differences.size() - 1;
+    if (nrCheckedRounds == 0)
+        throw KeccakException("The trail must specify the output difference of at least one round.");
+
+    result.rounds.assign(nrCheckedRounds, RoundProbability());
+    for(unsigned int r=0; r<nrCheckedRounds; r++) {
+        result.rounds[r].round = firstRound + r;
+        result.rounds[r].weight = trail.weights[firstRound + r];
+        result.rounds[r].nrPairs = 0;
+        result.rounds[r].nrFollowing = 0;
+    }
+    const unsigned int groupsPerChunk = 16;
+    const UINT64 nrGroups = (nrPairs + KeccakFBitSliced::bitSlicedInstances - 1)/KeccakFBitSliced::bitSlicedInstances;
+    const UINT64 nrChunks = (nrGroups + groupsPerChunk - 1)/groupsPerChunk;
+    result.nrPairs = nrGroups*KeccakFBitSliced::bitSlicedInstances;
+    result.nrFollowing = 0;
+    result.nrDifferential = 0;
+
+    atomic<UINT64> next(0);
+    exception_ptr failure;
+    mutex lock;
+    vector<thread> workers;
+    for(unsigned int t=0; t<min((UINT64)nrThreads, nrChunks); t++)
+        workers.push_back(thread([&]() {
+            try {
+                vector<UINT64> entering(nrCheckedRounds, 0), following(nrCheckedRounds, 0);
+                UINT64 differential = 0;
+                vector<BitSlicedWord> S1(width), S2(width);
+                for(UINT64 chunk=next++; chunk<nrChunks; chunk=next++) {
+                    mt19937_64 generator(seed ^ (chunk*0x9E3779B97F4A7C15ULL));
+                    UINT64 groups = min((UINT64)groupsPerChunk, nrGroups - chunk*groupsPerChunk);
+                    for(UINT64 g=0; g<groups; g++) {
+                        for(unsigned int i=0; i<width; i++) {
+                            S1[i] = generator();
+                            S2[i] = S1[i] ^ differences[0][i];
+                        }
+                        BitSlicedWord alive = ~(BitSlicedWord)0;
+                        for(unsigned int r=0; r<nrCheckedRounds; r++) {
+                            if ((alive == 0) && !measureDifferential)
+                                break;
+                            f.roundOnBitSlices(&S1[0], (int)(firstRound + r));
+                            f.roundOnBitSlices(&S2[0], (int)(firstRound + r));
+                            const vector<BitSlicedWord>& expected = differences[r+1];
+                            BitSlicedWord mismatch = 0;
+                            for(unsigned int i=0; i<width; i++)
+                                mismatch |= S1[i] ^ S2[i] ^ expected[i];
+                            entering[r] += countBits(alive);
+                            alive &= ~mismatch;
+                            following[r] += countBits(alive);
+                            if (measureDifferential && (r == nrCheckedRounds-1))
+                                differential += countBits(~mismatch);
+                        }
+                    }
+                }
+                lock_guard<mutex> guard(lock);
+                for(unsigned int r=0; r<nrCheckedRounds; r++) {
+                    result.rounds[r].nrPairs += entering[r];
+                    result.rounds[r].nrFollowing += following[r];
+                }
+                result.nrDifferential += differential;
+            }
+            catch(...) {
+                lock_guard<mutex> guard(lock);
+                if (!failure)
+                    failure = current_exception();
+                next = nrChunks;
+            }
+        }));
+    for(unsigned int t=0; t<workers.size(); t++)
+        workers[t].join();
+    if (failure)
+        rethrow_exception(failure);
+    result.nrFollowing = result.rounds.back().nrFollowing;
+}
+
+static void displayProbability(ostream& fout, UINT64 count, UINT64 total)
+{
+    fout << dec << count << "/" << total;
+    if (count > 0)
+        fout << " = 2^" << fixed << setprecision(2) << log2((double)count/total) << defaultfloat;
+}
+
+void TrailProbabilityEstimator::display(ostream& fout, const TrailProbability& result, double z) const
+{
+    unsigned int totalWeight = 0;
+    for(unsigned int r=0; r<result.rounds.size(); r++) {
+        const RoundProbability& round = result.rounds[r];
+        double low, high;
+        round.getConfidenceInterval(z, low, high);
+        fout << "Round " << dec << round.round << ": weight " << round.weight << ", empirical ";
+        displayProbability(fout, round.nrFollowing, round.nrPairs);
+        fout << ", interval [" << low << ", " << high << "] vs predicted " << round.getPredictedProbability();
+        if ((round.getPredictedProbability() < low) || (round.getPredictedProbability() > high))
+            fout << " (outside)";
+        fout << endl;
+        totalWeight += round.weight;
+    }
+    fout << "Trail: weight " << dec << totalWeight << ", empirical ";
+    displayProbability(fout, result.nrFollowing, result.nrPairs);
+    fout << endl;
+    if (measureDifferential) {
+        fout << "Differential: empirical ";
+        displayProbability(fout, result.nrDifferential, result.nrPairs);
+        fout << endl;
+    }
+}
@@ -0,0 +1,113 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFTRAILPROBABILITY_H_
+#define _KECCAKFTRAILPROBABILITY_H_
+
+#include <iostream>
+#include <vector>
+#include "Keccak-fBitSliced.h"
+#include "Keccak-fPropagation.h"
+#include "Keccak-fTrails.h"
+
+using namespace std;
+
+/** This structure contains the empirical statistics of one round of a differential trail,
+  * as measured by TrailProbabilityEstimator.
+  */
+struct RoundProbability {
+    /** The index of the round in Trail::states. */
+    unsigned int round;
+    /** The weight of the round given by the trail, see Trail::weights. */
+    unsigned int weight;
+    /** The number of pairs that followed the trail up to the input of χ of this round. */
+    UINT64 nrPairs;
+    /** The number of these pairs whose difference after χ is the one of the trail. */
+    UINT64 nrFollowing;
+    /** This method returns the empirical probability nrFollowing/nrPairs, or 0 if there are no pairs. */
+    double getProbability() const;
+    /** This method returns the probability 2<sup>-weight</sup> predicted by the trail. */
+    double getPredictedProbability() const;
+    /** This method computes the Wilson score interval of the probability.
+      * @param  z       The quantile of the normal distribution, e.g., 1.96 for a 95% confidence level.
+      * @param  low     The lower end of the interval.
+      * @param  high    The upper end of the interval.
+      */
+    void getConfidenceInterval(double z, double& low, double& high) const;
+};
+
+/** This class contains the result of TrailProbabilityEstimator::estimate().  */
+struct TrailProbability {
+    /** The statistics of the rounds whose output difference is specified by the trail, in order. */
+    vector<RoundProbability> rounds;
+    /** The number of pairs evaluated. */
+    UINT64 nrPairs;
+    /** The number of pairs that followed the whole trail. */
+    UINT64 nrFollowing;
+    /** The number of pairs with the input and output differences of the trail, whatever the intermediate differences,
+      * if TrailProbabilityEstimator::measureDifferential is set. */
+    UINT64 nrDifferential;
+};
+
+/** This class estimates the probability of a differential trail experimentally,
+  * by evaluating random pairs with the input difference of the trail
+  * and checking their difference after each round.
+  * The pairs are evaluated 64 at a time with KeccakFBitSliced, round by round,
+  * so that a group of pairs is abandoned as soon as none of them follows the trail any more.
+  * The groups are distributed over several threads. Each group has its own pseudo-random generator
+  * derived from the seed, so the result does not depend on the number of threads.
+  *
+  * The input difference is the one before λ of the first specified state of the trail,
+  * so that the first round checked for a trail core is round 1.
+  * The difference after χ of the round of state i is compared to the one before λ of state i+1,
+  * and the difference after χ of the last round to the state after the last χ if specified.
+  * The round constants do not influence the differential propagation.
+  * This is mostly interesting for the small widths, from Keccak-<i>f</i>[25] to Keccak-<i>f</i>[200].
+  */
+class TrailProbabilityEstimator {
+public:
+    /** The number of threads used by estimate(). */
+    unsigned int nrThreads;
+    /** The seed of the pseudo-random generators. */
+    UINT64 seed;
+    /** Whether estimate() also counts the pairs that follow the differential of the trail,
+      * i.e., that have its input and output differences but possibly other intermediate differences.
+      * In this case, the groups of pairs are not abandoned early. */
+    bool measureDifferential;
+protected:
+    const KeccakFPropagation& DC;
+    KeccakFBitSliced f;
+public:
+    /** The constructor.
+      * @param  aDC     The propagation context of the trails, which must be of type DC.
+      */
+    TrailProbabilityEstimator(const KeccakFPropagation& aDC);
+    /** This method evaluates random pairs on a trail.
+      * @param  trail   The trail, with at least one round whose output difference is specified.
+      * @param  nrPairs The number of pairs, rounded up to a multiple of 64.
+      * @param  result  The statistics of the pairs.
+      */
+    void estimate(const Trail& trail, UINT64 nrPairs, TrailProbability& result) const;
+    /** This method displays the statistics of a trail.
+      * @param  fout    The stream to display to.
+      * @param  result  The statistics, as given by estimate().
+      * @param  z       The quantile of the normal distribution for the confidence intervals.
+      */
+    void display(ostream& fout, const TrailProbability& result, double z = 1.96) const;
+protected:
+    void toBitSlices(const vector<SliceValue>& state, vector<BitSlicedWord>& words) const;
+};
+
+#endif
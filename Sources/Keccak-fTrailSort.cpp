@@ -0,0 +1,393 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <algorithm>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <stdio.h>
+#include "Keccak-fTrailSort.h"
+
+using namespace std;
+
+/** This class implements a TrailFetcher that saves the sorted trails
+  * in the output file and in the buckets of weights.
+  */
+class SortedTrailsOutput : public TrailFetcher {
+protected:
+    string outFileName;
+    unsigned int bucketWidth;
+    ofstream fout;
+    unique_ptr<TrailFetcher> saveToFile;
+    ofstream bucketOut;
+    unsigned int currentBucket;
+public:
+    SortedTrailsOutput(const string& aOutFileName, bool binary, unsigned int aBucketWidth)
+        : outFileName(aOutFileName), bucketWidth(aBucketWidth),
+        fout(aOutFileName.c_str(), binary ? ios::out | ios::binary : ios::out),
+        currentBucket(0)
+    {
+        if (!fout)
+            throw TrailException((string)"File '" + outFileName + (string)"' cannot be written.");
+        if (binary)
+            saveToFile.reset(new TrailSaveToBinaryFile(fout));
+        else
+            saveToFile.reset(new TrailSaveToFile(fout));
+    }
+    void fetchTrail(const Trail& trail)
+    {
+        saveToFile->fetchTrail(trail);
+        if (bucketWidth > 0) {
+            // The trails come by increasing weight, so the buckets are written one after the other.
+            unsigned int bucket = trail.totalWeight/bucketWidth;
+            if ((!bucketOut.is_open()) || (bucket != currentBucket)) {
+                if (bucketOut.is_open())
+                    bucketOut.close();
+                currentBucket = bucket;
+                string bucketFileName = TrailFileSorter::getBucketFileName(outFileName, bucket*bucketWidth, (bucket+1)*bucketWidth-1);
+                bucketOut.open(bucketFileName.c_str());
+                if (!bucketOut)
+                    throw TrailException((string)"File '" + bucketFileName + (string)"' cannot be written.");
+            }
+            trail.save(bucketOut);
+        }
+    }
+};
+
+/** This class reads the trails of a sorted run one after the other. */
+class SortedRun {
+public:
+    TrailBinaryFile file;
+    const UINT8 *position;
+    Trail current;
+public:
+    SortedRun(const string& fileName)
+        : file(fileName), position(file.begin()) {}
+    bool next()
+    {
+        if (!TrailBinaryFile::isRecordComplete(position, file.end()))
+            return false;
+        current.loadBinary(position, file.end());
+        return true;
+    }
+};
+
+UINT64 getApproximateMemoryUsage(const Trail& trail)
+{
+    UINT64 size = sizeof(Trail) + trail.weights.capacity()*sizeof(unsigned int)
+        + trail.stateAfterLastChi.capacity()*sizeof(SliceValue);
+    for(unsigned int i=0; i<trail.states.size(); i++)
+        size += sizeof(vector<SliceValue>) + trail.states[i].capacity()*sizeof(SliceValue);
+    return size;
+}
+
+TrailFileSorter::TrailFileSorter(UINT64 aMaxTrailsPerRun)
+    : maxTrailsPerRun(aMaxTrailsPerRun), memoryBudget(0), maxRunsPerMerge(64), binaryOutput(false), bucketWidth(0),
+    nrTrailsRead(0), nrTrailsWritten(0), nrRuns(0), nrTemporaryFiles(0)
+{
+}
+
+UINT64 TrailFileSorter::sort(const vector<string>& inFileNames, const string& outFileName)
+{
+    nrTrailsRead = 0;
+    nrTrailsWritten = 0;
+    nrRuns = 0;
+    nrTemporaryFiles = 0;
+    vector<string> runFileNames;
+    try {
+        vector<Trail> trails;
+        UINT64 memoryUsage = 0;
+        for(unsigned int i=0; i<inFileNames.size(); i++) {
+            auto addTrail = [&](Trail& trail) {
+                trail.translate(trail.getCanonicalTranslation());
+                trails.push_back(trail);
+                nrTrailsRead++;
+                memoryUsage += getApproximateMemoryUsage(trails.back());
+                if ((trails.size() >= maxTrailsPerRun) || ((memoryBudget > 0) && (memoryUsage >= memoryBudget))) {
+                    spillRun(trails, outFileName, runFileNames);
+                    memoryUsage = 0;
+                }
+            };
+            if (Trail::isBinaryFile(inFileNames[i])) {
+                TrailBinaryFile file(inFileNames[i]);
+                Trail trail;
+                for(const UINT8 *data = file.begin(); TrailBinaryFile::isRecordComplete(data, file.end()); ) {
+                    trail.loadBinary(data, file.end());
+                    addTrail(trail);
+                }
+            }
+            else {
+                ifstream fin(inFileNames[i].c_str());
+                if (!fin)
+                    throw TrailException((string)"File '" + inFileNames[i] + (string)"' cannot be read.");
+                while(!(fin.eof())) {
+                    Trail trail;
+                    try {
+                        trail.load(fin);
+                    }
+                    catch(TrailException) {
+                        if (!fin)
+                            break;
+                        continue;
+                    }
+                    addTrail(trail);
+                }
+            }
+        }
+        if (trails.size() > 0)
+            spillRun(trails, outFileName, runFileNames);
+        nrRuns = runFileNames.size();
+
+        // The runs are merged by groups until they can all be merged at once into the output.
+        while(runFileNames.size() > maxRunsPerMerge) {
+            vector<string> mergedRunFileNames;
+            for(unsigned int first=0; first<runFileNames.size(); first+=maxRunsPerMerge) {
+                vector<string> group(runFileNames.begin() + first,
+                    runFileNames.begin() + min((size_t)first + maxRunsPerMerge, runFileNames.size()));
+                string mergedRunFileName = getTemporaryFileName(outFileName);
+                mergedRunFileNames.push_back(mergedRunFileName);
+                {
+                    ofstream fout(mergedRunFileName.c_str(), ios::out | ios::binary);
+                    if (!fout)
+                        throw TrailException((string)"File '" + mergedRunFileName + (string)"' cannot be written.");
+                    TrailSaveToBinaryFile save(fout);
+                    merge(group, save);
+                }
+                for(unsigned int i=0; i<group.size(); i++)
+                    remove(group[i].c_str());
+            }
+            runFileNames = mergedRunFileNames;
+        }
+        SortedTrailsOutput output(outFileName, binaryOutput, bucketWidth);
+        nrTrailsWritten = merge(runFileNames, output);
+    }
+    catch(...) {
+        for(unsigned int i=0; i<runFileNames.size(); i++)
+            remove(runFileNames[i].c_str());
+        throw;
+    }
+    for(unsigned int i=0; i<runFileNames.size(); i++)
+        remove(runFileNames[i].c_str());
+    return nrTrailsWritten;
+}
+
+string TrailFileSorter::getBucketFileName(const string& outFileName, unsigned int minWeight, unsigned int maxWeight)
+{
+    stringstream fileName;
+    fileName << outFileName << "-w" << dec << minWeight << "-" << maxWeight;
+    return fileName.str();
+}
+
+bool TrailFileSorter::isLess(const Trail& a, const Trail& b)
+{
+    if (a.totalWeight != b.totalWeight)
+        return a.totalWeight < b.totalWeight;
+    if (a.states.size() != b.states.size())
+        return a.states.size() < b.states.size();
+    if (a.firstStateSpecified != b.firstStateSpecified)
+        return b.firstStateSpecified;
+    if (a.stateAfterLastChiSpecified != b.stateAfterLastChiSpecified)
+        return b.stateAfterLastChiSpecified;
+    if (a.states != b.states)
+        return a.states < b.states;
+    if (a.stateAfterLastChiSpecified && (a.stateAfterLastChi != b.stateAfterLastChi))
+        return a.stateAfterLastChi < b.stateAfterLastChi;
+    return a.weights < b.weights;
+}
+
+string TrailFileSorter::getTemporaryFileName(const string& outFileName)
+{
+    stringstream fileName;
+    fileName << (temporaryPrefix.empty() ? outFileName : temporaryPrefix) << ".run" << dec << nrTemporaryFiles;
+    nrTemporaryFiles++;
+    return fileName.str();
+}
+
+void TrailFileSorter::spillRun(vector<Trail>& trails, const string& outFileName, vector<string>& runFileNames)
+{
+    std::sort(trails.begin(), trails.end(), isLess);
+    string runFileName = getTemporaryFileName(outFileName);
+    runFileNames.push_back(runFileName);
+    ofstream fout(runFileName.c_str(), ios::out | ios::binary);
+    if (!fout)
+        throw TrailException((string)"File '" + runFileName + (string)"' cannot be written.");
+    TrailSaveToBinaryFile save(fout);
+    for(unsigned int i=0; i<trails.size(); i++)
+        if ((i == 0) || isLess(trails[i-1], trails[i]))
+            save.fetchTrail(trails[i]);
+    fout.close();
+    if (!fout)
+        throw TrailException((string)"File '" + runFileName + (string)"' cannot be written.");
+    trails.clear();
+}
+
+UINT64 TrailFileSorter::merge(const vector<string>& runFileNames, TrailFetcher& trailsOut)
+{
+    vector<unique_ptr<SortedRun> > runs;
+    for(unsigned int i=0; i<runFileNames.size(); i++)
+        runs.push_back(unique_ptr<SortedRun>(new SortedRun(runFileNames[i])));
+    auto isLater = [&runs](unsigned int i, unsigned int j) {
+        return isLess(runs[j]->current, runs[i]->current);
+    };
+    priority_queue<unsigned int, vector<unsigned int>, decltype(isLater)> heads(isLater);
+    for(unsigned int i=0; i<runs.size(); i++)
+        if (runs[i]->next())
+            heads.push(i);
+    UINT64 count = 0;
+    Trail last;
+    while(!heads.empty()) {
+        unsigned int i = heads.top();
+        heads.pop();
+        // The trails come in order, so a duplicate immediately follows the trail it duplicates.
+        if ((count == 0) || isLess(last, runs[i]->current)) {
+            trailsOut.fetchTrail(runs[i]->current);
+            last = runs[i]->current;
+            count++;
+        }
+        if (runs[i]->next())
+            heads.push(i);
+    }
+    return count;
+}
+
+TrailSpillingCollector::TrailSpillingCollector(const string& aTemporaryPrefix, UINT64 aMemoryBudget)
+    : memoryBudget(aMemoryBudget), temporaryPrefix(aTemporaryPrefix), nrTrails(0), nrTemporaryFiles(0)
+{
+}
+
+TrailSpillingCollector::~TrailSpillingCollector()
+{
+    removeRuns();
+}
+
+void TrailSpillingCollector::fetchTrail(const Trail& trail)
+{
+    trails.append(trail);
+    nrTrails++;
+    if (trails.getMemoryUsage() >= memoryBudget)
+        spillRun();
+}
+
+void TrailSpillingCollector::getOrder(vector<UINT64>& order) const
+{
+    order.resize(trails.size());
+    for(UINT64 i=0; i<trails.size(); i++)
+        order[i] = i;
+    stable_sort(order.begin(), order.end(),
+        [this](UINT64 a, UINT64 b) { return trails[a].getTotalWeight() < trails[b].getTotalWeight(); });
+}
+
+void TrailSpillingCollector::spillRun()
+{
+    stringstream runFileName;
+    runFileName << temporaryPrefix << ".spill" << dec << nrTemporaryFiles;
+    nrTemporaryFiles++;
+    runFileNames.push_back(runFileName.str());
+    {
+        ofstream fout(runFileNames.back().c_str(), ios::out | ios::binary);
+        if (!fout)
+            throw TrailException((string)"File '" + runFileNames.back() + (string)"' cannot be written.");
+        TrailSaveToBinaryFile save(fout);
+        vector<UINT64> order;
+        getOrder(order);
+        Trail trail;
+        for(UINT64 i=0; i<order.size(); i++) {
+            trails.get(order[i], trail);
+            save.fetchTrail(trail);
+        }
+        fout.close();
+        if (!fout)
+            throw TrailException((string)"File '" + runFileNames.back() + (string)"' cannot be written.");
+    }
+    // The memory is given back, as its capacity counts in the budget.
+    trails.clear();
+    trails.shrinkToFit();
+}
+
+UINT64 TrailSpillingCollector::flush(TrailFetcher& trailsOut)
+{
+    vector<unique_ptr<SortedRun> > runs;
+    for(unsigned int i=0; i<runFileNames.size(); i++)
+        runs.push_back(unique_ptr<SortedRun>(new SortedRun(runFileNames[i])));
+    vector<UINT64> order;
+    getOrder(order);
+    UINT64 inMemory = 0;
+    Trail inMemoryTrail;
+    // The sources are the runs, in the order they were spilled, then the trails still in memory,
+    // so that the trails of equal weight come in their order of arrival.
+    const unsigned int inMemorySource = runs.size();
+    auto getCurrent = [&](unsigned int i) -> const Trail& {
+        return (i == inMemorySource) ? inMemoryTrail : runs[i]->current;
+    };
+    auto next = [&](unsigned int i) {
+        if (i < inMemorySource)
+            return runs[i]->next();
+        if (inMemory >= order.size())
+            return false;
+        trails.get(order[inMemory], inMemoryTrail);
+        inMemory++;
+        return true;
+    };
+    auto isLater = [&getCurrent](unsigned int i, unsigned int j) {
+        unsigned int wi = getCurrent(i).totalWeight, wj = getCurrent(j).totalWeight;
+        return (wi > wj) || ((wi == wj) && (i > j));
+    };
+    priority_queue<unsigned int, vector<unsigned int>, decltype(isLater)> heads(isLater);
+    for(unsigned int i=0; i<=inMemorySource; i++)
+        if (next(i))
+            heads.push(i);
+    UINT64 count = 0;
+    while(!heads.empty()) {
+        unsigned int i = heads.top();
+        heads.pop();
+        trailsOut.fetchTrail(getCurrent(i));
+        count++;
+        if (next(i))
+            heads.push(i);
+    }
+    runs.clear();
+    removeRuns();
+    trails.clear();
+    trails.shrinkToFit();
+    nrTrails = 0;
+    return count;
+}
+
+UINT64 TrailSpillingCollector::save(const string& fileName, bool binary)
+{
+    ofstream fout(fileName.c_str(), binary ? ios::out | ios::binary : ios::out);
+    if (!fout)
+        throw TrailException((string)"File '" + fileName + (string)"' cannot be written.");
+    UINT64 count;
+    if (binary) {
+        TrailSaveToBinaryFile save(fout);
+        count = flush(save);
+    }
+    else {
+        TrailSaveToFile save(fout);
+        count = flush(save);
+    }
+    fout.close();
+    if (!fout)
+        throw TrailException((string)"File '" + fileName + (string)"' cannot be written.");
+    return count;
+}
+
+void TrailSpillingCollector::removeRuns()
+{
+    for(unsigned int i=0; i<runFileNames.size(); i++)
+        remove(runFileNames[i].c_str());
+    runFileNames.clear();
+}
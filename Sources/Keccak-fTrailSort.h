@@ -0,0 +1,188 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFTRAILSORT_H_
+#define _KECCAKFTRAILSORT_H_
+
+#include <string>
+#include <vector>
+#include "Keccak-fTrailCollection.h"
+#include "Keccak-fTrails.h"
+
+using namespace std;
+
+/** This function returns the approximate number of bytes that a Trail object takes in memory.
+  * @param  trail   The trail.
+  * @return The number of bytes.
+  */
+UINT64 getApproximateMemoryUsage(const Trail& trail);
+
+/** This class sorts the trails of one or more files by total weight and removes
+  * the duplicates, where two trails are duplicates when they are equal up to
+  * a translation along z. The files can be much larger than the memory:
+  * the trails are read by chunks of at most @a maxTrailsPerRun trails
+  * or of at most @a memoryBudget bytes,
+  * each chunk is sorted in memory and spilled to a temporary file in the
+  * binary trail format (a run), and the runs are then merged.
+  * When there are more than @a maxRunsPerMerge runs, they are merged in several passes.
+  *
+  * Each trail is first translated to its canonical variant, see Trail::getCanonicalTranslation(),
+  * so the output contains the canonical variants only.
+  * The trails of equal weight are sorted in the order of isLess().
+  *
+  * The output can be split by weight into buckets, each saved in its own file in the text format.
+  * Since trails are sorted, a bucket, or the complete output, can then be
+  * loaded by KnownSmallWeightStates::loadFromFile().
+  */
+class TrailFileSorter {
+public:
+    /** The maximum number of trails sorted in memory at once. */
+    UINT64 maxTrailsPerRun;
+    /** If non-zero, the approximate number of bytes that the trails sorted in memory
+      * at once may take; a run is also spilled when this budget is reached.
+      */
+    UINT64 memoryBudget;
+    /** The maximum number of runs merged at once. */
+    unsigned int maxRunsPerMerge;
+    /** The prefix of the names of the temporary files.
+      * If empty, the name of the output file is used.
+      */
+    string temporaryPrefix;
+    /** If true, the output file is written in the binary trail format, see Trail::saveBinary(),
+      * otherwise in the text format, see Trail::save().
+      */
+    bool binaryOutput;
+    /** If non-zero, the trails are also saved in buckets of weights,
+      * the bucket k containing the trails with total weight from k*bucketWidth
+      * to (k+1)*bucketWidth-1, see getBucketFileName().
+      */
+    unsigned int bucketWidth;
+protected:
+    UINT64 nrTrailsRead;
+    UINT64 nrTrailsWritten;
+    unsigned int nrRuns;
+    unsigned int nrTemporaryFiles;
+public:
+    /** The constructor.
+      * @param  aMaxTrailsPerRun    The maximum number of trails sorted in memory at once.
+      */
+    TrailFileSorter(UINT64 aMaxTrailsPerRun = 1000000);
+    /** This method sorts the trails of the given files, removes the duplicates
+      * and saves the result into the output file and, if @a bucketWidth is non-zero,
+      * into the buckets of weights.
+      * The input files can be in the text or in the binary trail format.
+      * @param  inFileNames The names of the files to read from.
+      * @param  outFileName The name of the file to write to.
+      * @return The number of trails written.
+      */
+    UINT64 sort(const vector<string>& inFileNames, const string& outFileName);
+    /** This method returns the number of trails read by the last call to sort().
+      * @return The number of trails read.
+      */
+    UINT64 getNumberOfTrailsRead() const { return nrTrailsRead; }
+    /** This method returns the number of trails written by the last call to sort().
+      * @return The number of trails written.
+      */
+    UINT64 getNumberOfTrailsWritten() const { return nrTrailsWritten; }
+    /** This method returns the number of duplicates removed by the last call to sort().
+      * @return The number of duplicates.
+      */
+    UINT64 getNumberOfDuplicates() const { return nrTrailsRead - nrTrailsWritten; }
+    /** This method returns the number of runs spilled to disk by the last call to sort().
+      * @return The number of runs.
+      */
+    unsigned int getNumberOfRuns() const { return nrRuns; }
+    /** This function returns the name of the file containing the bucket of weights
+      * from @a minWeight to @a maxWeight, that is, the name of the output file followed by
+      * "-w", @a minWeight, "-" and @a maxWeight.
+      * @param  outFileName The name of the output file.
+      * @param  minWeight   The minimum total weight of the trails in the bucket.
+      * @param  maxWeight   The maximum total weight of the trails in the bucket.
+      * @return The name of the bucket file.
+      */
+    static string getBucketFileName(const string& outFileName, unsigned int minWeight, unsigned int maxWeight);
+    /** This function defines the order of the sorted trails:
+      * by total weight, then by number of rounds, by type
+      * and finally by the values of the states and of the weights.
+      * Two trails are equivalent in this order iff they have the same states and weights.
+      * @param  a   The first trail.
+      * @param  b   The second trail.
+      * @return True iff @a a comes strictly before @a b.
+      */
+    static bool isLess(const Trail& a, const Trail& b);
+protected:
+    string getTemporaryFileName(const string& outFileName);
+    void spillRun(vector<Trail>& trails, const string& outFileName, vector<string>& runFileNames);
+    UINT64 merge(const vector<string>& runFileNames, TrailFetcher& trailsOut);
+};
+
+/** This class implements a TrailFetcher that collects trails within a memory budget,
+  * for instance the output of a trail extension with a generous maximum weight.
+  * The trails are kept compactly in a TrailCollection. When its memory reaches
+  * @a memoryBudget bytes, they are sorted by total weight and spilled to a temporary
+  * file in the binary trail format (a run). At the end, flush() merges the runs
+  * and the trails still in memory, so that the trails come by increasing total weight
+  * and, for equal weights, in their order of arrival. The trails are not translated
+  * and the duplicates are kept; see TrailFileSorter to remove them.
+  * The temporary files are removed by flush() or by the destructor.
+  * The fetchTrail() method is not thread-safe, see TrailFetcherSynchronized.
+  */
+class TrailSpillingCollector : public TrailFetcher {
+public:
+    /** The approximate number of bytes that the trails kept in memory may take. */
+    UINT64 memoryBudget;
+    /** The prefix of the names of the temporary files. */
+    string temporaryPrefix;
+protected:
+    TrailCollection trails;
+    vector<string> runFileNames;
+    UINT64 nrTrails;
+    unsigned int nrTemporaryFiles;
+public:
+    /** The constructor.
+      * @param  aTemporaryPrefix    The prefix of the names of the temporary files.
+      * @param  aMemoryBudget   The approximate number of bytes that the trails kept in memory may take.
+      */
+    TrailSpillingCollector(const string& aTemporaryPrefix, UINT64 aMemoryBudget = (UINT64)1 << 30);
+    /** The destructor, which removes the temporary files. */
+    virtual ~TrailSpillingCollector();
+    /** See TrailFetcher::fetchTrail(). */
+    void fetchTrail(const Trail& trail);
+    /** This method returns the number of trails collected since the last flush(). */
+    UINT64 getNumberOfTrails() const { return nrTrails; }
+    /** This method returns the number of runs currently spilled to disk. */
+    unsigned int getNumberOfRuns() const { return runFileNames.size(); }
+    /** This method returns the number of bytes taken by the trails kept in memory. */
+    UINT64 getMemoryUsage() const { return trails.getMemoryUsage(); }
+    /** This method outputs all the trails collected by increasing total weight,
+      * and then empties the collector.
+      * @param  trailsOut   Where to output the trails.
+      * @return The number of trails output.
+      */
+    UINT64 flush(TrailFetcher& trailsOut);
+    /** This method saves all the trails collected into a file by increasing total weight,
+      * and then empties the collector.
+      * @param  fileName    The name of the file to write to.
+      * @param  binary  If true, the file is in the binary trail format, otherwise in the text format.
+      * @return The number of trails saved.
+      */
+    UINT64 save(const string& fileName, bool binary = false);
+protected:
+    void spillRun();
+    void getOrder(vector<UINT64>& order) const;
+    void removeRuns();
+};
+
+#endif
@@ -13,10 +13,24 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
 #include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "Keccak-fDisplay.h"
 #include "Keccak-fPropagation.h"
 #include "Keccak-fTrails.h"
+#include "translationsymmetry.h"
 
 using namespace std;
 
@@ -73,6 +87,75 @@ void Trail::prepend(const vector<SliceValue>& state, unsigned int weight)
     totalWeight += weight;
 }
 
+static void translateState(vector<SliceValue>& state, unsigned int dz)
+{
+    unsigned int laneSize = state.size();
+    if ((laneSize == 0) || ((dz % laneSize) == 0))
+        return;
+    vector<SliceValue> translated(laneSize);
+    for(unsigned int z=0; z<laneSize; z++)
+        translated[(z+dz)%laneSize] = state[z];
+    state = translated;
+}
+
+void Trail::translate(unsigned int dz)
+{
+    for(unsigned int i=0; i<states.size(); i++)
+        translateState(states[i], dz);
+    if (stateAfterLastChiSpecified)
+        translateState(stateAfterLastChi, dz);
+}
+
+unsigned int Trail::getCanonicalTranslation() const
+{
+    unsigned int laneSize = 0;
+    for(unsigned int i=0; (i<states.size()) && (laneSize == 0); i++)
+        laneSize = states[i].size();
+    if (laneSize == 0)
+        return 0;
+    // The states of a trail core start with an empty states[0].
+    vector<vector<SliceValue> > slices(laneSize);
+    for(unsigned int i=0; i<states.size(); i++)
+        if (states[i].size() == laneSize)
+            for(unsigned int z=0; z<laneSize; z++)
+                slices[z].push_back(states[i][z]);
+    if (stateAfterLastChiSpecified && (stateAfterLastChi.size() == laneSize))
+        for(unsigned int z=0; z<laneSize; z++)
+            slices[z].push_back(stateAfterLastChi[z]);
+    return getMinimalTranslation(slices);
+}
+
+static void hashState(UINT64& hash, const vector<SliceValue>& state, unsigned int dz)
+{
+    // FNV-1a on the slices of the state translated by dz
+    const UINT64 prime = 0x100000001B3ULL;
+    unsigned int laneSize = state.size();
+    hash = (hash ^ laneSize) * prime;
+    for(unsigned int z=0; z<laneSize; z++)
+        hash = (hash ^ state[(z+laneSize-dz%laneSize)%laneSize]) * prime;
+}
+
+UINT64 Trail::getHashUpToTranslation() const
+{
+    unsigned int dz = getCanonicalTranslation();
+    UINT64 hash = 0xCBF29CE484222325ULL;
+    hash = (hash ^ ((firstStateSpecified ? 1 : 0) | (stateAfterLastChiSpecified ? 2 : 0))) * 0x100000001B3ULL;
+    for(unsigned int i=0; i<states.size(); i++)
+        hashState(hash, states[i], dz);
+    if (stateAfterLastChiSpecified)
+        hashState(hash, stateAfterLastChi, dz);
+    return hash;
+}
+
+bool Trail::hasSameStates(const Trail& other) const
+{
+    if ((firstStateSpecified != other.firstStateSpecified) || (stateAfterLastChiSpecified != other.stateAfterLastChiSpecified))
+        return false;
+    if (states != other.states)
+        return false;
+    return (!stateAfterLastChiSpecified) || (stateAfterLastChi == other.stateAfterLastChi);
+}
+
 void Trail::display(const KeccakFPropagation& DCorLC, ostream& fout) const
 {
     if (states.size() == 0) {
@@ -281,6 +364,228 @@ void Trail::load(istream& fin)
     }
 }
 
+static const char binarySignature[8] = { 'K', 'T', 'T', 'r', 'a', 'i', 'l', 's' };
+
+static void writeUINT(ostream& fout, UINT32 value, unsigned int nrBytes)
+{
+    char bytes[4];
+    for(unsigned int i=0; i<nrBytes; i++)
+        bytes[i] = (char)((value >> (8*i)) & 0xFF);
+    fout.write(bytes, nrBytes);
+}
+
+static UINT32 readUINT(const UINT8*& data, const UINT8 *end, unsigned int nrBytes)
+{
+    if ((size_t)(end - data) < nrBytes)
+        throw TrailException("The binary trail record is truncated.");
+    UINT32 value = 0;
+    for(unsigned int i=0; i<nrBytes; i++)
+        value ^= (UINT32)data[i] << (8*i);
+    data += nrBytes;
+    return value;
+}
+
+static UINT64 readUINT64(const UINT8*& data, const UINT8 *end)
+{
+    UINT64 low = readUINT(data, end, 4);
+    return low ^ ((UINT64)readUINT(data, end, 4) << 32);
+}
+
+static void appendUINT(string& buffer, UINT64 value, unsigned int nrBytes)
+{
+    for(unsigned int i=0; i<nrBytes; i++)
+        buffer += (char)((value >> (8*i)) & 0xFF);
+}
+
+static UINT64 getFileSize(const string& fileName)
+{
+    ifstream fin(fileName.c_str(), ios::binary);
+    if (!fin)
+        throw TrailException((string)"File '" + fileName + (string)"' cannot be read.");
+    fin.seekg(0, ios_base::end);
+    return (UINT64)fin.tellg();
+}
+
+/** This function maps the given file into memory where available, or otherwise reads it entirely.
+  * The returned pointer releases the memory when the last copy goes away.
+  */
+static shared_ptr<const UINT8> mapFile(const string& fileName, size_t& size)
+{
+    size = 0;
+#ifndef _WIN32
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw TrailException((string)"File '" + fileName + (string)"' cannot be read.");
+    struct stat st;
+    void *mapped = MAP_FAILED;
+    if ((fstat(fd, &st) == 0) && (st.st_size > 0)) {
+        size = (size_t)st.st_size;
+        mapped = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapped != MAP_FAILED) {
+        size_t mappedSize = size;
+        return shared_ptr<const UINT8>((const UINT8 *)mapped,
+            [mappedSize](const UINT8 *p) { munmap((void *)p, mappedSize); });
+    }
+#endif
+    ifstream fin(fileName.c_str(), ios::binary);
+    if (!fin)
+        throw TrailException((string)"File '" + fileName + (string)"' cannot be read.");
+    fin.seekg(0, ios_base::end);
+    size = (size_t)fin.tellg();
+    fin.seekg(0, ios_base::beg);
+    shared_ptr<const UINT8> content(new UINT8[size + 1], default_delete<const UINT8[]>());
+    fin.read((char *)content.get(), size);
+    if (!fin)
+        throw TrailException((string)"File '" + fileName + (string)"' cannot be read.");
+    return content;
+}
+
+static void writeSparseState(ostream& fout, const vector<SliceValue>& state)
+{
+    unsigned int nrActiveSlices = 0;
+    for(unsigned int z=0; z<state.size(); z++)
+        if (state[z] != 0) nrActiveSlices++;
+    writeUINT(fout, nrActiveSlices, 1);
+    for(unsigned int z=0; z<state.size(); z++)
+        if (state[z] != 0) {
+            writeUINT(fout, z, 1);
+            writeUINT(fout, state[z], 4);
+        }
+}
+
+static void readSparseState(const UINT8*& data, const UINT8 *end, unsigned int laneSize, vector<SliceValue>& state)
+{
+    state.assign(laneSize, 0);
+    unsigned int nrActiveSlices = readUINT(data, end, 1);
+    for(unsigned int i=0; i<nrActiveSlices; i++) {
+        unsigned int z = readUINT(data, end, 1);
+        if (z >= laneSize)
+            throw TrailException("The binary trail record contains an invalid slice index.");
+        state[z] = readUINT(data, end, 4);
+    }
+}
+
+void Trail::saveBinary(ostream& fout) const
+{
+    unsigned int laneSize = 0;
+    if (states.size() > 1)
+        laneSize = states[1].size();
+    else if (states.size() > 0)
+        laneSize = states[0].size();
+    unsigned int offsetIndex = (firstStateSpecified ? 0 : 1);
+    unsigned int nrStates = states.size() - offsetIndex;
+    UINT32 length = 1 + 1 + 2 + 4 + 4 + 4*weights.size() + 4;
+    for(unsigned int i=offsetIndex; i<states.size(); i++)
+        length += 1 + 5*(states[i].size() - count(states[i].begin(), states[i].end(), (SliceValue)0));
+    if (stateAfterLastChiSpecified)
+        length += 1 + 5*(stateAfterLastChi.size() - count(stateAfterLastChi.begin(), stateAfterLastChi.end(), (SliceValue)0));
+    writeUINT(fout, length, 4);
+    writeUINT(fout, (firstStateSpecified ? 0 : 1) ^ (stateAfterLastChiSpecified ? 2 : 0), 1);
+    writeUINT(fout, 0, 1);
+    writeUINT(fout, laneSize, 2);
+    writeUINT(fout, totalWeight, 4);
+    writeUINT(fout, weights.size(), 4);
+    for(unsigned int i=0; i<weights.size(); i++)
+        writeUINT(fout, weights[i], 4);
+    writeUINT(fout, nrStates, 4);
+    for(unsigned int i=offsetIndex; i<states.size(); i++)
+        writeSparseState(fout, states[i]);
+    if (stateAfterLastChiSpecified)
+        writeSparseState(fout, stateAfterLastChi);
+}
+
+void Trail::loadBinary(const UINT8*& data, const UINT8 *end)
+{
+    UINT32 length = readUINT(data, end, 4);
+    if ((size_t)(end - data) < length)
+        throw TrailException("The binary trail record is truncated.");
+    const UINT8 *recordEnd = data + length;
+    unsigned int flags = readUINT(data, recordEnd, 1);
+    readUINT(data, recordEnd, 1);
+    unsigned int laneSize = readUINT(data, recordEnd, 2);
+    totalWeight = readUINT(data, recordEnd, 4);
+    firstStateSpecified = ((flags & 1) == 0);
+    stateAfterLastChiSpecified = ((flags & 2) != 0);
+
+    unsigned int size = readUINT(data, recordEnd, 4);
+    if ((size_t)(recordEnd - data) < 4*(size_t)size)
+        throw TrailException("The binary trail record is truncated.");
+    weights.resize(size);
+    for(unsigned int i=0; i<size; i++)
+        weights[i] = readUINT(data, recordEnd, 4);
+    size = readUINT(data, recordEnd, 4);
+    if ((size_t)(recordEnd - data) < (size_t)size)
+        throw TrailException("The binary trail record is truncated.");
+    states.clear();
+    states.reserve(size + (firstStateSpecified ? 0 : 1));
+    if (!firstStateSpecified)
+        states.push_back(vector<SliceValue>());
+    for(unsigned int i=0; i<size; i++) {
+        states.push_back(vector<SliceValue>());
+        readSparseState(data, recordEnd, laneSize, states.back());
+    }
+    if (stateAfterLastChiSpecified)
+        readSparseState(data, recordEnd, laneSize, stateAfterLastChi);
+    else
+        stateAfterLastChi.clear();
+    if (data != recordEnd)
+        throw TrailException("The binary trail record has an inconsistent length.");
+}
+
+void Trail::saveBinaryHeader(ostream& fout)
+{
+    fout.write(binarySignature, sizeof(binarySignature));
+    writeUINT(fout, TrailBinaryFile::version, 4);
+    writeUINT(fout, 0, 4);
+}
+
+bool Trail::isBinaryFile(const string& fileName)
+{
+    ifstream fin(fileName.c_str(), ios::binary);
+    char signature[sizeof(binarySignature)];
+    fin.read(signature, sizeof(signature));
+    return fin && (memcmp(signature, binarySignature, sizeof(signature)) == 0);
+}
+
+UINT64 Trail::convertToBinary(const string& inFileName, const string& outFileName)
+{
+    ifstream fin(inFileName.c_str());
+    if (!fin)
+        throw TrailException((string)"File '" + inFileName + (string)"' cannot be read.");
+    ofstream fout(outFileName.c_str(), ios::binary);
+    if (!fout)
+        throw TrailException((string)"File '" + outFileName + (string)"' cannot be written.");
+    saveBinaryHeader(fout);
+    UINT64 count = 0;
+    while(!(fin.eof())) {
+        try {
+            Trail trail(fin);
+            trail.saveBinary(fout);
+            count++;
+        }
+        catch(TrailException) {
+        }
+    }
+    return count;
+}
+
+UINT64 Trail::convertToText(const string& inFileName, const string& outFileName)
+{
+    TrailBinaryFile file(inFileName);
+    ofstream fout(outFileName.c_str());
+    if (!fout)
+        throw TrailException((string)"File '" + outFileName + (string)"' cannot be written.");
+    UINT64 count = 0;
+    Trail trail;
+    for(const UINT8 *data = file.begin(); TrailBinaryFile::isRecordComplete(data, file.end()); count++) {
+        trail.loadBinary(data, file.end());
+        trail.save(fout);
+    }
+    return count;
+}
+
 void Trail::append(const Trail& otherTrail)
 {
     for(unsigned int i=0; i<otherTrail.weights.size(); i++)
@@ -301,10 +606,22 @@ UINT64 Trail::produceHumanReadableFile(const KeccakFPropagation& DCorLC, const s
 
 // -------------------------------------------------------------
 //
-// TrailFilterAND
+// TrailFilter and TrailFilterAND
 //
 // -------------------------------------------------------------
 
+void TrailFilter::filterBatch(const KeccakFPropagation& DCorLC, vector<Trail>& trails) const
+{
+    unsigned int kept = 0;
+    for(unsigned int i=0; i<trails.size(); i++)
+        if (filter(DCorLC, trails[i])) {
+            if (kept != i)
+                trails[kept] = trails[i];
+            kept++;
+        }
+    trails.resize(kept);
+}
+
 TrailFilterAND::TrailFilterAND()
 {
 }
@@ -326,6 +643,178 @@ bool TrailFilterAND::filter(const KeccakFPropagation& DCorLC, const Trail& trail
     return pass;
 }
 
+TrailSetUpToTranslation::TrailSetUpToTranslation()
+    : nrTrails(0)
+{
+}
+
+bool TrailSetUpToTranslation::insert(const Trail& trail)
+{
+    Trail canonical(trail);
+    canonical.translate(trail.getCanonicalTranslation());
+    UINT64 hash = canonical.getHashUpToTranslation();
+    lock_guard<mutex> guard(lock);
+    vector<Trail>& bucket = trailsPerHash[hash];
+    for(unsigned int i=0; i<bucket.size(); i++)
+        if (bucket[i].hasSameStates(canonical))
+            return false;
+    bucket.push_back(canonical);
+    nrTrails++;
+    return true;
+}
+
+UINT64 TrailSetUpToTranslation::getNumberOfTrails()
+{
+    lock_guard<mutex> guard(lock);
+    return nrTrails;
+}
+
+bool TrailFilterUniqueUpToTranslation::filter(const KeccakFPropagation& DCorLC, const Trail& trail) const
+{
+    (void)DCorLC;
+    return trailsSeen.insert(trail);
+}
+
+// -------------------------------------------------------------
+//
+// TrailFileIndex
+//
+// -------------------------------------------------------------
+
+static const char indexSignature[8] = { 'K', 'T', 'T', 'r', 'I', 'n', 'd', 'x' };
+
+static bool isIndexHeaderValid(const UINT8 *data, size_t size, UINT64 trailFileSize)
+{
+    if ((size < TrailFileIndex::headerSize) || (((size - TrailFileIndex::headerSize) % TrailFileIndex::entrySize) != 0))
+        return false;
+    if (memcmp(data, indexSignature, sizeof(indexSignature)) != 0)
+        return false;
+    const UINT8 *end = data + TrailFileIndex::headerSize;
+    data += sizeof(indexSignature);
+    if (readUINT(data, end, 4) != TrailFileIndex::version)
+        return false;
+    readUINT(data, end, 4);
+    return (readUINT64(data, end) == trailFileSize);
+}
+
+TrailFileIndex::TrailFileIndex(const string& aFileName)
+    : fileName(aFileName), size(0)
+{
+    if (!load())
+        build();
+}
+
+string TrailFileIndex::getIndexFileName(const string& aFileName)
+{
+    return aFileName + ".index";
+}
+
+bool TrailFileIndex::isAvailable(const string& aFileName)
+{
+    ifstream fin(getIndexFileName(aFileName).c_str(), ios::binary);
+    if (!fin)
+        return false;
+    fin.seekg(0, ios_base::end);
+    size_t indexSize = (size_t)fin.tellg();
+    fin.seekg(0, ios_base::beg);
+    UINT8 header[headerSize];
+    fin.read((char *)header, headerSize);
+    return fin && isIndexHeaderValid(header, indexSize, getFileSize(aFileName));
+}
+
+bool TrailFileIndex::load()
+{
+    try {
+        content = mapFile(getIndexFileName(fileName), size);
+    }
+    catch(TrailException) {
+        return false;
+    }
+    if (isIndexHeaderValid(content.get(), size, getFileSize(fileName)))
+        return true;
+    content.reset();
+    size = 0;
+    return false;
+}
+
+void TrailFileIndex::build()
+{
+    ifstream fin(fileName.c_str());
+    if (!fin)
+        throw TrailException((string)"File '" + fileName + (string)"' cannot be read.");
+    string buffer(indexSignature, sizeof(indexSignature));
+    appendUINT(buffer, version, 4);
+    appendUINT(buffer, 0, 4);
+    appendUINT(buffer, getFileSize(fileName), 8);
+    Trail trail;
+    while(fin.good()) {
+        UINT64 offset = (UINT64)fin.tellg();
+        try {
+            trail.load(fin);
+            appendUINT(buffer, offset, 8);
+            appendUINT(buffer, trail.totalWeight, 4);
+            appendUINT(buffer, trail.getNumberOfRounds(), 4);
+        }
+        catch(TrailException) {
+        }
+    }
+    // The index is written under a temporary name so that other processes never map a partial file.
+    string indexFileName = getIndexFileName(fileName);
+    {
+        ofstream fout((indexFileName + ".tmp").c_str(), ios::binary | ios::trunc);
+        fout.write(buffer.data(), buffer.size());
+        fout.close();
+        if (fout)
+            rename((indexFileName + ".tmp").c_str(), indexFileName.c_str());
+        else
+            remove((indexFileName + ".tmp").c_str());
+    }
+    size = buffer.size();
+    UINT8 *inMemory = new UINT8[size];
+    memcpy(inMemory, buffer.data(), size);
+    content = shared_ptr<const UINT8>(inMemory, default_delete<const UINT8[]>());
+}
+
+UINT64 TrailFileIndex::getCount() const
+{
+    return (size - headerSize)/entrySize;
+}
+
+UINT64 TrailFileIndex::getCount(unsigned int maxWeight, unsigned int nrRounds) const
+{
+    UINT64 result = 0;
+    for(UINT64 k=0; k<getCount(); k++)
+        if ((getWeight(k) <= maxWeight) && ((nrRounds == 0) || (getNumberOfRounds(k) == nrRounds)))
+            result++;
+    return result;
+}
+
+UINT64 TrailFileIndex::getOffset(UINT64 k) const
+{
+    const UINT8 *data = content.get() + headerSize + k*entrySize;
+    return readUINT64(data, data + 8);
+}
+
+unsigned int TrailFileIndex::getWeight(UINT64 k) const
+{
+    const UINT8 *data = content.get() + headerSize + k*entrySize + 8;
+    return readUINT(data, data + 4, 4);
+}
+
+unsigned int TrailFileIndex::getNumberOfRounds(UINT64 k) const
+{
+    const UINT8 *data = content.get() + headerSize + k*entrySize + 12;
+    return readUINT(data, data + 4, 4);
+}
+
+void TrailFileIndex::getShard(unsigned int shard, unsigned int nrShards, UINT64& first, UINT64& last) const
+{
+    if (shard >= nrShards)
+        throw TrailException("The shard index must be smaller than the number of shards.");
+    first = getCount()*shard/nrShards;
+    last = getCount()*(shard+1)/nrShards;
+}
+
 // -------------------------------------------------------------
 //
 // TrailFileIterator
@@ -356,6 +845,16 @@ TrailFileIterator::TrailFileIterator(const string& aFileName, const KeccakFPropa
     next();
 }
 
+TrailFileIterator::TrailFileIterator(const string& aFileName, const KeccakFPropagation& aDCorLC,
+                                     unsigned int shard, unsigned int nrShards, TrailFilter *aFilter, bool aPrefetch)
+    : TrailIterator(aDCorLC, aFilter), fileName(aFileName), prefetch(aPrefetch),
+    index(new TrailFileIndex(aFileName))
+{
+    index->getShard(shard, nrShards, first, last);
+    initialize();
+    next();
+}
+
 void TrailFileIterator::initialize()
 {
     fin.open(fileName.c_str());
@@ -363,56 +862,107 @@ void TrailFileIterator::initialize()
         throw TrailException((string)"File '" + fileName + (string)"' cannot be read.");
     i = 0;
     count = unfilteredCount = 0;
-    if (prefetch) {
-        while(!(fin.eof())) {
-            try {
-                Trail trail(fin);
-                unfilteredCount++;
-                if (filter) {
-                    if (filter->filter(DCorLC, trail))
-                        count++;
-                }
-                else
-                    count++;
-            }
-            catch(TrailException) {
-            }
+    if (!index) {
+        first = position = 0;
+        last = ~(UINT64)0;
+        if (prefetch && (!filter) && TrailFileIndex::isAvailable(fileName)) {
+            index.reset(new TrailFileIndex(fileName));
+            last = index->getCount();
         }
-        fin.close();
-        fin.open(fileName.c_str());
-        fin.seekg(0, ios_base::beg);
-        if (!fin)
-            throw TrailException((string)"File '" + fileName + (string)"' cannot be read anymore.");
     }
+    else {
+        position = first;
+        if (first < index->getCount())
+            fin.seekg((streamoff)index->getOffset(first), ios_base::beg);
+    }
+    if (index && !filter)
+        count = unfilteredCount = last - first;
+    else if (prefetch)
+        countWithFilter();
     else
         count = ~(UINT64)0;
 }
 
-void TrailFileIterator::next()
+void TrailFileIterator::countWithFilter()
 {
-    if (fin.eof())
-        end = true;
-    else {
-        bool filterPass;
-        do {
-            try {
-                current.load(fin);
-                if (filter)
-                    filterPass = filter->filter(DCorLC, current);
-                else
-                    filterPass = true;
+    UINT64 k = first;
+    while((!(fin.eof())) && (k < last)) {
+        try {
+            Trail trail(fin);
+            k++;
+            if (filter) {
+                if (filter->filter(DCorLC, trail))
+                    count++;
             }
-            catch(TrailException) {
-                filterPass = false;
+            else
+                count++;
+        }
+        catch(TrailException) {
+        }
+    }
+    unfilteredCount = k - first;
+    fin.close();
+    fin.open(fileName.c_str());
+    if (!fin)
+        throw TrailException((string)"File '" + fileName + (string)"' cannot be read anymore.");
+    if (index && (first < index->getCount()))
+        fin.seekg((streamoff)index->getOffset(first), ios_base::beg);
+}
+
+void TrailFileIterator::next()
+{
+    bool filterPass = false;
+    bool resynchronized = false;
+    while((!filterPass) && (position < last) && (!(fin.eof()))) {
+        try {
+            current.load(fin);
+            position++;
+            resynchronized = false;
+            if (filter)
+                filterPass = filter->filter(DCorLC, current);
+            else
+                filterPass = true;
+        }
+        catch(TrailException) {
+            if (index) {
+                // Skip what could not be parsed, as when the index was built.
+                if (resynchronized)
+                    throw TrailException((string)"File '" + fileName + (string)"' does not match its index.");
+                fin.clear();
+                fin.seekg((streamoff)index->getOffset(position), ios_base::beg);
+                resynchronized = true;
             }
-        } while((!(fin.eof())) && (!filterPass));
-        end = !filterPass;
+        }
+    }
+    end = !filterPass;
+}
+
+void TrailFileIterator::seek(UINT64 k)
+{
+    if (!index) {
+        index.reset(new TrailFileIndex(fileName));
+        last = index->getCount();
     }
+    if ((k < first) || (k > last))
+        throw TrailException("The trail index is outside the range of the iterator.");
+    fin.clear();
+    if (k < index->getCount())
+        fin.seekg((streamoff)index->getOffset(k), ios_base::beg);
+    position = k;
+    i = k - first;
+    next();
+}
+
+UINT64 TrailFileIterator::getPosition() const
+{
+    return position - 1;
 }
 
 void TrailFileIterator::display(ostream& fout) const
 {
     fout << "'" << fileName << "'";
+    if (index && ((first > 0) || (last < index->getCount())))
+        fout << " from trail " << dec << first << " up to " << last << " (excluded)";
     if (prefetch) {
         fout << " containing " << dec << count << " trails";
         if (filter)
@@ -469,6 +1019,164 @@ ostream& operator<<(ostream& a, const TrailFileIterator& tfi)
     return a;
 }
 
+// -------------------------------------------------------------
+//
+// TrailBinaryFile
+//
+// -------------------------------------------------------------
+
+TrailBinaryFile::TrailBinaryFile(const string& fileName)
+    : content(mapFile(fileName, size))
+{
+    const UINT8 *data = content.get();
+    if ((size < headerSize) || (memcmp(data, binarySignature, sizeof(binarySignature)) != 0))
+        throw TrailException((string)"File '" + fileName + (string)"' is not in the binary trail format.");
+    data += sizeof(binarySignature);
+    if (readUINT(data, end(), 4) != version)
+        throw TrailException((string)"File '" + fileName + (string)"' uses an unsupported version of the binary trail format.");
+}
+
+bool TrailBinaryFile::isRecordComplete(const UINT8 *data, const UINT8 *end)
+{
+    if ((size_t)(end - data) < 4)
+        return false;
+    UINT32 length = readUINT(data, end, 4);
+    return ((size_t)(end - data) >= length);
+}
+
+const UINT8 *TrailBinaryFile::skipRecord(const UINT8 *data)
+{
+    const UINT8 *end = data + 4;
+    UINT32 length = readUINT(data, end, 4);
+    return data + length;
+}
+
+// -------------------------------------------------------------
+//
+// TrailBinaryFileIterator
+//
+// -------------------------------------------------------------
+
+TrailBinaryFileIterator::TrailBinaryFileIterator(const string& aFileName, const KeccakFPropagation& aDCorLC,
+                                     bool aPrefetch)
+    : TrailIterator(aDCorLC), fileName(aFileName), prefetch(aPrefetch), file(aFileName)
+{
+    initialize();
+    next();
+}
+
+TrailBinaryFileIterator::TrailBinaryFileIterator(const string& aFileName, const KeccakFPropagation& aDCorLC,
+                                     TrailFilter *aFilter, bool aPrefetch)
+    : TrailIterator(aDCorLC, aFilter), fileName(aFileName), prefetch(aPrefetch), file(aFileName)
+{
+    initialize();
+    next();
+}
+
+TrailBinaryFileIterator::TrailBinaryFileIterator(const string& aFileName, const KeccakFPropagation& aDCorLC,
+                                     TrailFilter *aFilter1, TrailFilter *aFilter2, bool aPrefetch)
+    : TrailIterator(aDCorLC, aFilter1, aFilter2), fileName(aFileName), prefetch(aPrefetch), file(aFileName)
+{
+    initialize();
+    next();
+}
+
+void TrailBinaryFileIterator::initialize()
+{
+    i = 0;
+    count = unfilteredCount = 0;
+    position = file.begin();
+    if (prefetch) {
+        Trail trail;
+        for(const UINT8 *data = file.begin(); TrailBinaryFile::isRecordComplete(data, file.end()); ) {
+            unfilteredCount++;
+            if (filter) {
+                trail.loadBinary(data, file.end());
+                if (filter->filter(DCorLC, trail))
+                    count++;
+            }
+            else {
+                data = TrailBinaryFile::skipRecord(data);
+                count++;
+            }
+        }
+    }
+    else
+        count = ~(UINT64)0;
+}
+
+void TrailBinaryFileIterator::next()
+{
+    bool filterPass = false;
+    while((!filterPass) && TrailBinaryFile::isRecordComplete(position, file.end())) {
+        current.loadBinary(position, file.end());
+        if (filter)
+            filterPass = filter->filter(DCorLC, current);
+        else
+            filterPass = true;
+    }
+    end = !filterPass;
+}
+
+void TrailBinaryFileIterator::display(ostream& fout) const
+{
+    fout << "'" << fileName << "'";
+    if (prefetch) {
+        fout << " containing " << dec << count << " trails";
+        if (filter)
+            fout << " (" << dec << unfilteredCount << " before filtering)";
+    }
+    else
+        fout << " (unknown trail count)";
+}
+
+bool TrailBinaryFileIterator::isEnd()
+{
+    return end;
+}
+
+bool TrailBinaryFileIterator::isEmpty()
+{
+    return (prefetch && (count == 0));
+}
+
+void TrailBinaryFileIterator::operator++()
+{
+    next();
+    i++;
+}
+
+const Trail& TrailBinaryFileIterator::operator*()
+{
+    return current;
+}
+
+bool TrailBinaryFileIterator::isBounded()
+{
+    return prefetch;
+}
+
+UINT64 TrailBinaryFileIterator::getIndex()
+{
+    return i;
+}
+
+UINT64 TrailBinaryFileIterator::getCount()
+{
+    return count;
+}
+
+UINT64 TrailBinaryFileIterator::getUnfilteredCount() const
+{
+    return unfilteredCount;
+}
+
+ostream& operator<<(ostream& a, const TrailBinaryFileIterator& tfi)
+{
+    tfi.display(a);
+    return a;
+}
+
 TrailSaveToFile::TrailSaveToFile(ostream& aFout)
     : fout(aFout)
 {
@@ -478,3 +1186,150 @@ void TrailSaveToFile::fetchTrail(const Trail& trail)
 {
     trail.save(fout);
 }
+
+TrailFetcherSynchronized::TrailFetcherSynchronized(TrailFetcher& aFetcher)
+    : fetcher(aFetcher)
+{
+}
+
+void TrailFetcherSynchronized::fetchTrail(const Trail& trail)
+{
+    lock_guard<mutex> guard(lock);
+    fetcher.fetchTrail(trail);
+}
+
+TrailFetcherUniqueUpToTranslation::TrailFetcherUniqueUpToTranslation(TrailFetcher& aFetcher)
+    : fetcher(aFetcher), nrDuplicates(0)
+{
+}
+
+void TrailFetcherUniqueUpToTranslation::fetchTrail(const Trail& trail)
+{
+    if (trailsSeen.insert(trail))
+        fetcher.fetchTrail(trail);
+    else
+        nrDuplicates++;
+}
+
+UINT64 TrailFetcherUniqueUpToTranslation::getNumberOfDuplicates() const
+{
+    return nrDuplicates;
+}
+
+TrailSaveToBinaryFile::TrailSaveToBinaryFile(ostream& aFout)
+    : fout(aFout)
+{
+    Trail::saveBinaryHeader(fout);
+}
+
+void TrailSaveToBinaryFile::fetchTrail(const Trail& trail)
+{
+    trail.saveBinary(fout);
+}
+
+TrailSaveToFileAsync::TrailSaveToFileAsync(const string& aFileName, bool aBinary, const string& compressor,
+    unsigned int aBatchSize, unsigned int aMaxPendingBatches)
+    : fileName(aFileName), binary(aBinary), batchSize(max(1U, aBatchSize)), maxPendingBatches(max(1U, aMaxPendingBatches)),
+    fout(0), piped(!compressor.empty()), closing(false)
+{
+    if (piped) {
+        string command = compressor + " > \"" + fileName + "\"";
+#ifdef _WIN32
+        fout = popen(command.c_str(), "wb");
+#else
+        fout = popen(command.c_str(), "w");
+#endif
+    }
+    else
+        fout = fopen(fileName.c_str(), binary ? "wb" : "w");
+    if (fout == 0)
+        throw TrailException((string)"File '" + fileName + (string)"' cannot be written.");
+    if (binary) {
+        stringstream header;
+        Trail::saveBinaryHeader(header);
+        string data = header.str();
+        fwrite(data.data(), 1, data.size(), fout);
+    }
+    batch.reserve(batchSize);
+    writer = thread(&TrailSaveToFileAsync::write, this);
+}
+
+TrailSaveToFileAsync::~TrailSaveToFileAsync()
+{
+    try {
+        close();
+    }
+    catch(...) {
+    }
+}
+
+void TrailSaveToFileAsync::fetchTrail(const Trail& trail)
+{
+    unique_lock<mutex> guard(lock);
+    if (failure)
+        rethrow_exception(failure);
+    if (closing)
+        throw TrailException((string)"File '" + fileName + (string)"' is already closed.");
+    batch.push_back(trail);
+    if (batch.size() >= batchSize)
+        queueBatch(guard);
+}
+
+void TrailSaveToFileAsync::queueBatch(unique_lock<mutex>& guard)
+{
+    wakeUpFetchers.wait(guard, [this]() { return (pending.size() < maxPendingBatches) || failure; });
+    pending.push_back(vector<Trail>());
+    pending.back().swap(batch);
+    batch.reserve(batchSize);
+    wakeUpWriter.notify_one();
+}
+
+void TrailSaveToFileAsync::close()
+{
+    {
+        unique_lock<mutex> guard(lock);
+        if (closing)
+            return;
+        if (!batch.empty())
+            queueBatch(guard);
+        closing = true;
+        wakeUpWriter.notify_one();
+    }
+    writer.join();
+    int status = piped ? pclose(fout) : fclose(fout);
+    fout = 0;
+    if ((status != 0) && !failure)
+        failure = make_exception_ptr(TrailException((string)"File '" + fileName + (string)"' could not be written completely."));
+    if (failure)
+        rethrow_exception(failure);
+}
+
+void TrailSaveToFileAsync::write()
+{
+    unique_lock<mutex> guard(lock);
+    while(true) {
+        wakeUpWriter.wait(guard, [this]() { return closing || !pending.empty(); });
+        if (pending.empty())
+            return;
+        vector<Trail> trails;
+        trails.swap(pending.front());
+        pending.pop_front();
+        wakeUpFetchers.notify_all();
+        if (failure)
+            continue;
+        guard.unlock();
+        stringstream out;
+        for(unsigned int i=0; i<trails.size(); i++)
+            if (binary)
+                trails[i].saveBinary(out);
+            else
+                trails[i].save(out);
+        string data = out.str();
+        bool written = (fwrite(data.data(), 1, data.size(), fout) == data.size());
+        guard.lock();
+        if (!written) {
+            failure = make_exception_ptr(TrailException((string)"File '" + fileName + (string)"' could not be written completely."));
+            wakeUpFetchers.notify_all();
+        }
+    }
+}
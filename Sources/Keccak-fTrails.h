@@ -16,8 +16,16 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #ifndef _KECCAKFTRAILS_H_
 #define _KECCAKFTRAILS_H_
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <unordered_map>
 #include "Keccak-fParts.h"
 
 class KeccakFPropagation;
@@ -105,6 +113,29 @@ public:
       * @param   weight The propagation weight.
       */
     void prepend(const vector<SliceValue>& state, unsigned int weight);
+    /** This method translates all the states of the trail along z by the same amount,
+      * so that the slice at z moves to position (z+@a dz) modulo the lane size.
+      * @param  dz  The amount of translation.
+      */
+    void translate(unsigned int dz);
+    /** This method returns the amount of translation along z that makes the trail
+      * the smallest among its translated variants, see translate().
+      * The slices are compared from the highest z down, as in isSmaller(),
+      * and the states at a given z are compared round after round.
+      * It runs in time linear in the lane size (times the number of states).
+      * @return The smallest amount of translation giving the canonical variant.
+      */
+    unsigned int getCanonicalTranslation() const;
+    /** This method returns a hash of the trail that is the same for all its translated variants,
+      * as it is computed on the canonical variant, see getCanonicalTranslation().
+      * @return The 64-bit hash.
+      */
+    UINT64 getHashUpToTranslation() const;
+    /** This method tells whether two trails have the same states.
+      * @param  other   The trail to compare with.
+      * @return True iff the states (and the state after the last χ, if specified) are equal.
+      */
+    bool hasSameStates(const Trail& other) const;
     /** This method displays the trail for in a human-readable form.
       * @param   DCorLC The propagation context of the trail,
       *                 as a reference to a KeccakFPropagation object.
@@ -119,6 +150,59 @@ public:
       * @param  fout    The stream to save the trail to.
       */
     void save(ostream& fout) const;
+    /** This methods loads the trail from a record in the binary trail format,
+      * see saveBinary().
+      * @param  data    A pointer to the beginning of the record,
+      *                 which is moved to the beginning of the next record.
+      * @param  end     A pointer just after the last byte available.
+      * An exception is thrown if the record is inconsistent or does not fit before @a end.
+      */
+    void loadBinary(const UINT8*& data, const UINT8 *end);
+    /** This methods outputs the trail as a record in the binary trail format.
+      * A binary trail file starts with the header written by saveBinaryHeader(),
+      * followed by the records one after the other.
+      * All integers are unsigned and stored in little-endian order.
+      * A record is made of:
+      * - the length of the rest of the record (4 bytes);
+      * - flags (1 byte): bit 0 is set for a trail core, bit 1 is set
+      *     when the state after the last χ is specified;
+      * - a reserved byte, set to zero;
+      * - the number of slices of the states (2 bytes);
+      * - the total weight (4 bytes);
+      * - the number of weights (4 bytes), followed by the weights (4 bytes each);
+      * - the number of states saved (4 bytes), that is, @a states without states[0] for a trail core,
+      *     followed by the states and, if specified, by the state after the last χ.
+      *     Each state is encoded sparsely as the number of non-zero slices (1 byte),
+      *     followed by each such slice as its index z (1 byte) and its value (4 bytes).
+      * @param  fout    The stream to save the trail to.
+      */
+    void saveBinary(ostream& fout) const;
+    /** This function writes the header in the binary trail format,
+      * that is, the 8-byte signature "KTTrails" followed by the version (4 bytes)
+      * and 4 reserved bytes set to zero.
+      * @param  fout    The stream to save the header to.
+      */
+    static void saveBinaryHeader(ostream& fout);
+    /** This function tells whether the given file starts with the header
+      * of the binary trail format.
+      * @param   fileName   The name of the file.
+      * @return True if the file is in the binary trail format.
+      */
+    static bool isBinaryFile(const string& fileName);
+    /** This function converts a file of trails in the text format, as written by save(),
+      * into a file in the binary format, as written by saveBinary().
+      * @param   inFileName     The name of the file to read from.
+      * @param   outFileName    The name of the file to write to.
+      * @return The number of trails converted.
+      */
+    static UINT64 convertToBinary(const string& inFileName, const string& outFileName);
+    /** This function converts a file of trails in the binary format, as written by saveBinary(),
+      * into a file in the text format, as written by save().
+      * @param   inFileName     The name of the file to read from.
+      * @param   outFileName    The name of the file to write to.
+      * @return The number of trails converted.
+      */
+    static UINT64 convertToText(const string& inFileName, const string& outFileName);
     /** This function reads all the trails in a file, checks their consistency
       * and then produces a report.
       * The report is output in a file with the same file name plus ".txt".
@@ -148,6 +232,14 @@ public:
       * @return The result of the filter: whether to keep (true) or discard (false) the given trail.
       */
     virtual bool filter(const KeccakFPropagation& DCorLC, const Trail& trail) const = 0;
+    /** This method removes from a batch of trails those that filter() discards,
+      * keeping the others in their order. Filters can override it to share
+      * their work over the trails of the batch.
+      * @param   DCorLC     The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      * @param  trails  The batch of trails to filter.
+      */
+    virtual void filterBatch(const KeccakFPropagation& DCorLC, vector<Trail>& trails) const;
 };
 
 /** This class implements a filter on trails, combining one or more given filters
@@ -172,6 +264,45 @@ public:
     virtual bool filter(const KeccakFPropagation& DCorLC, const Trail& trail) const;
 };
 
+/** This class keeps the trails seen so far, one per class of trails equivalent by translation along z.
+  * The trails are stored in their canonical variant (see Trail::getCanonicalTranslation())
+  * and indexed by Trail::getHashUpToTranslation().
+  * The method insert() can be called from several threads.
+  */
+class TrailSetUpToTranslation
+{
+protected:
+    mutex lock;
+    unordered_map<UINT64, vector<Trail> > trailsPerHash;
+    UINT64 nrTrails;
+public:
+    /** The constructor, which creates an empty set. */
+    TrailSetUpToTranslation();
+    /** This method adds a trail to the set, unless a translated variant of it is already present.
+      * @param  trail   The trail to add.
+      * @return True iff the trail was not yet present up to translation.
+      */
+    bool insert(const Trail& trail);
+    /** This method returns the number of trails in the set.
+      * @return The number of classes of trails equivalent by translation seen so far.
+      */
+    UINT64 getNumberOfTrails();
+};
+
+/** This class implements a filter that keeps only the first trail of each class of trails
+ * equivalent by translation along z, see TrailSetUpToTranslation.
+ */
+class TrailFilterUniqueUpToTranslation : public TrailFilter
+{
+protected:
+    mutable TrailSetUpToTranslation trailsSeen;
+public:
+    /** This method returns true iff no translated variant of the trail was given before.
+     * See TrailFilter::filter() for more details.
+     */
+    virtual bool filter(const KeccakFPropagation& DCorLC, const Trail& trail) const;
+};
+
 /** This base class represents an iterator on a set of trails.
  */
 class TrailIterator {
@@ -231,7 +362,88 @@ public:
     virtual const Trail& operator*() = 0;
 };
 
+/** This class implements an index of the trails in a file in the text format,
+  * see Trail::save(). For each trail, it records its offset in the file,
+  * its total weight and its number of rounds, so that one can seek
+  * to a given trail, count trails and split the file into shards without parsing it.
+  * The index is kept in a sidecar file, whose name is that of the trail file
+  * plus ".index", and which is mapped into memory where available.
+  * The sidecar file starts with the 8-byte signature "KTTrIndx", the version (4 bytes),
+  * 4 reserved bytes and the size of the trail file (8 bytes), followed by 16 bytes per trail:
+  * the offset (8 bytes), the total weight (4 bytes) and the number of rounds (4 bytes),
+  * all in little-endian order.
+  */
+class TrailFileIndex {
+protected:
+    string fileName;
+    shared_ptr<const UINT8> content;
+    size_t size;
+public:
+    /** The version of the format of the sidecar file. */
+    static const UINT32 version = 1;
+    /** The size in bytes of the header of the sidecar file. */
+    static const size_t headerSize = 24;
+    /** The size in bytes of the entry of each trail in the sidecar file. */
+    static const size_t entrySize = 16;
+public:
+    /** The constructor, which loads the sidecar file if it matches the trail file,
+      * or otherwise reads all the trails to build the index and tries to save it.
+      * @param  aFileName   The name of the file containing the trails.
+      */
+    TrailFileIndex(const string& aFileName);
+    /** This function returns the name of the sidecar file of a trail file.
+      * @param  aFileName   The name of the file containing the trails.
+      * @return The name of the sidecar file.
+      */
+    static string getIndexFileName(const string& aFileName);
+    /** This function tells whether a sidecar file exists and matches the trail file.
+      * @param  aFileName   The name of the file containing the trails.
+      * @return True if the index can be loaded without reading the trails.
+      */
+    static bool isAvailable(const string& aFileName);
+    /** This method returns the number of trails in the file.
+      * @return The number of trails.
+      */
+    UINT64 getCount() const;
+    /** This method returns the number of trails in the file with
+      * a total weight not exceeding the given value.
+      * @param  maxWeight   The maximum total weight.
+      * @param  nrRounds    If non-zero, only the trails with this number of rounds are counted.
+      * @return The number of such trails.
+      */
+    UINT64 getCount(unsigned int maxWeight, unsigned int nrRounds = 0) const;
+    /** This method returns the offset of a trail in the file.
+      * @param  k   The index of the trail, starting from 0.
+      * @return The offset in bytes of the trail in the file.
+      */
+    UINT64 getOffset(UINT64 k) const;
+    /** This method returns the total weight of a trail.
+      * @param  k   The index of the trail, starting from 0.
+      * @return The total weight of the trail.
+      */
+    unsigned int getWeight(UINT64 k) const;
+    /** This method returns the number of rounds of a trail.
+      * @param  k   The index of the trail, starting from 0.
+      * @return The number of rounds of the trail.
+      */
+    unsigned int getNumberOfRounds(UINT64 k) const;
+    /** This method splits the trails of the file into @a nrShards contiguous ranges
+      * of (almost) equal numbers of trails and returns the range of the given shard.
+      * @param  shard   The index of the shard, between 0 and @a nrShards-1.
+      * @param  nrShards    The number of shards.
+      * @param  first   The index of the first trail of the shard.
+      * @param  last    The index just after the last trail of the shard.
+      */
+    void getShard(unsigned int shard, unsigned int nrShards, UINT64& first, UINT64& last) const;
+protected:
+    bool load();
+    void build();
+};
+
 /** This class implements an iterator on a set of trails read from a file.
+ * When constructed for a shard, or after seek() is called, the iterator relies on
+ * a TrailFileIndex. Otherwise, an existing sidecar index is used to count
+ * the trails when no filter is given.
  */
 class TrailFileIterator : public TrailIterator {
 protected:
@@ -241,6 +453,8 @@ protected:
     UINT64 i, count, unfilteredCount;
     bool end;
     Trail current;
+    shared_ptr<TrailFileIndex> index;
+    UINT64 first, last, position;
 public:
     /** The constructor of the iterator.
       * @param  aFileName   The name of the file to read from.
@@ -272,6 +486,31 @@ public:
       */
     TrailFileIterator(const string& aFileName, const KeccakFPropagation& aDCorLC,
         TrailFilter *aFilter1, TrailFilter *aFilter2, bool aPrefetch = true);
+    /** The constructor of the iterator on one shard of the file,
+      * see TrailFileIndex::getShard(). The index of the file is loaded or built first.
+      * @param  aFileName   The name of the file to read from.
+      * @param   DCorLC     The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      * @param  shard       The index of the shard, between 0 and @a nrShards-1.
+      * @param  nrShards    The number of shards.
+      * @param  aFilter     A pointer to the filter, or 0 for no filter.
+      * @param  aPrefetch   Whether the shard has to be first read to determine
+      *                     the number of trails passing the filter, if any.
+      */
+    TrailFileIterator(const string& aFileName, const KeccakFPropagation& aDCorLC,
+        unsigned int shard, unsigned int nrShards, TrailFilter *aFilter = 0, bool aPrefetch = true);
+    /** This method moves the iterator to the trail with index @a k in the file,
+      * counted before filtering, or to the first trail after it that passes the filter.
+      * The index of the file is loaded or built if needed.
+      * If the iterator covers a shard, @a k must be within the shard.
+      * Afterwards, getIndex() counts the trails from @a k.
+      * @param  k   The index of the trail in the file, starting from 0.
+      */
+    void seek(UINT64 k);
+    /** This method returns the index in the file of the current trail, counted before filtering.
+      * @return The index in the file of the current trail.
+      */
+    UINT64 getPosition() const;
     /** This method displays information about the file being read.
       * @param  fout    The stream to display to.
       */
@@ -295,6 +534,121 @@ public:
       */
     UINT64 getUnfilteredCount() const;
     friend ostream& operator<<(ostream& a, const TrailFileIterator& tfi);
+protected:
+    void initialize();
+    void next();
+    void countWithFilter();
+};
+
+/** This class gives read-only access to the content of a file in the binary
+  * trail format, see Trail::saveBinary().
+  * Where available, the file is mapped into memory; otherwise, it is read entirely.
+  * Copies share the same mapping.
+  */
+class TrailBinaryFile {
+protected:
+    shared_ptr<const UINT8> content;
+    size_t size;
+public:
+    /** The version of the binary trail format written by Trail::saveBinary(). */
+    static const UINT32 version = 1;
+    /** The size in bytes of the header written by Trail::saveBinaryHeader(). */
+    static const size_t headerSize = 16;
+public:
+    /** The constructor, which opens the file and checks its header.
+      * @param  fileName    The name of the file to read from.
+      */
+    TrailBinaryFile(const string& fileName);
+    /** This method returns a pointer to the first record, just after the header.
+      * @return A pointer to the first record.
+      */
+    const UINT8 *begin() const { return content.get() + headerSize; }
+    /** This method returns a pointer just after the last byte of the file.
+      * @return A pointer to the end of the file.
+      */
+    const UINT8 *end() const { return content.get() + size; }
+    /** This function tells whether the record starting at @a data fits completely
+      * before @a end. If not, the record may still be being written.
+      * @param  data    A pointer to the beginning of a record.
+      * @param  end     A pointer just after the last byte available.
+      * @return True if the record is complete.
+      */
+    static bool isRecordComplete(const UINT8 *data, const UINT8 *end);
+    /** This function returns a pointer to the record following the one starting at @a data.
+      * @param  data    A pointer to the beginning of a complete record.
+      * @return A pointer to the beginning of the next record.
+      */
+    static const UINT8 *skipRecord(const UINT8 *data);
+};
+
+/** This class implements an iterator on a set of trails read from a file
+ * in the binary trail format, see Trail::saveBinary(). The file is mapped
+ * into memory, so counting the trails does not require decoding them
+ * unless a filter is given.
+ */
+class TrailBinaryFileIterator : public TrailIterator {
+protected:
+    string fileName;
+    bool prefetch;
+    UINT64 i, count, unfilteredCount;
+    bool end;
+    Trail current;
+    TrailBinaryFile file;
+    const UINT8 *position;
+public:
+    /** The constructor of the iterator.
+      * @param  aFileName   The name of the file to read from.
+      * @param   DCorLC     The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      * @param  aPrefetch   Whether the file has to be first read to determine
+      *                     the number of trails in the file.
+      */
+    TrailBinaryFileIterator(const string& aFileName, const KeccakFPropagation& aDCorLC,
+        bool aPrefetch = true);
+    /** The constructor of the iterator, with one filter.
+      * @param  aFileName   The name of the file to read from.
+      * @param   DCorLC     The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      * @param  aFilter A pointer to the filter.
+      * @param  aPrefetch   Whether the file has to be first read to determine
+      *                     the number of trails in the file.
+      */
+    TrailBinaryFileIterator(const string& aFileName, const KeccakFPropagation& aDCorLC,
+        TrailFilter *aFilter, bool aPrefetch = true);
+    /** The constructor of the iterator, with two filters.
+      * @param  aFileName   The name of the file to read from.
+      * @param   DCorLC     The propagation context of the trails,
+      *                     as a reference to a KeccakFPropagation object.
+      * @param  aFilter1    A pointer to the first filter.
+      * @param  aFilter2    A pointer to the second filter.
+      * @param  aPrefetch   Whether the file has to be first read to determine
+      *                     the number of trails in the file.
+      */
+    TrailBinaryFileIterator(const string& aFileName, const KeccakFPropagation& aDCorLC,
+        TrailFilter *aFilter1, TrailFilter *aFilter2, bool aPrefetch = true);
+    /** This method displays information about the file being read.
+      * @param  fout    The stream to display to.
+      */
+    void display(ostream& fout) const;
+    /** See TrailIterator::isEnd(). */
+    virtual bool isEnd();
+    /** See TrailIterator::isEmpty(). */
+    virtual bool isEmpty();
+    /** See TrailIterator::operator++(). */
+    virtual void operator++();
+    /** See TrailIterator::operator*(). */
+    virtual const Trail& operator*();
+    /** See TrailIterator::isBounded(). */
+    virtual bool isBounded();
+    /** See TrailIterator::getIndex(). */
+    virtual UINT64 getIndex();
+    /** See TrailIterator::getCount(). */
+    virtual UINT64 getCount();
+    /** This method returns the number of trails in the file before applying the filter(s).
+      * @return The number of trails in the file before applying the filter(s).
+      */
+    UINT64 getUnfilteredCount() const;
+    friend ostream& operator<<(ostream& a, const TrailBinaryFileIterator& tfi);
 protected:
     void initialize();
     void next();
@@ -325,4 +679,111 @@ public:
     void fetchTrail(const Trail& trail);
 };
 
+/** This class implements a TrailFetcher that forwards the trails to another
+  * TrailFetcher one at a time, so that it can be fed from several threads.
+  */
+class TrailFetcherSynchronized : public TrailFetcher {
+protected:
+    TrailFetcher& fetcher;
+    mutex lock;
+public:
+    /** The constructor.
+      * @param  aFetcher    The fetcher to forward the trails to.
+      */
+    TrailFetcherSynchronized(TrailFetcher& aFetcher);
+    /** See TrailFetcher::fetchTrail().*/
+    void fetchTrail(const Trail& trail);
+};
+
+/** This class implements a TrailFetcher that forwards to another TrailFetcher
+  * only the first trail of each class of trails equivalent by translation along z,
+  * e.g., to merge the outputs of several searches, see TrailSetUpToTranslation.
+  */
+class TrailFetcherUniqueUpToTranslation : public TrailFetcher {
+protected:
+    TrailFetcher& fetcher;
+    TrailSetUpToTranslation trailsSeen;
+    UINT64 nrDuplicates;
+public:
+    /** The constructor.
+      * @param  aFetcher    The fetcher to forward the unique trails to.
+      */
+    TrailFetcherUniqueUpToTranslation(TrailFetcher& aFetcher);
+    /** See TrailFetcher::fetchTrail().*/
+    void fetchTrail(const Trail& trail);
+    /** This method returns the number of trails not forwarded because a translated variant was fetched before.
+      * @return The number of duplicates.
+      */
+    UINT64 getNumberOfDuplicates() const;
+};
+
+/** This class implements a TrailFetcher and saves the trails in a file
+  * in the binary trail format, see Trail::saveBinary().
+  */
+class TrailSaveToBinaryFile : public TrailFetcher {
+protected:
+    ostream& fout;
+public:
+    /** The constructor, which writes the header of the binary trail format.
+      * @param  aFout   The output stream to save the trails to,
+      *                 which must be opened in binary mode.
+      */
+    TrailSaveToBinaryFile(ostream& aFout);
+    /** See TrailFetcher::fetchTrail().*/
+    void fetchTrail(const Trail& trail);
+};
+
+/** This class implements a TrailFetcher that saves the trails in a file
+  * from a separate writer thread, so that the search producing the trails
+  * does not wait for their formatting and output.
+  * The trails are queued by batches, and the writer thread formats each batch
+  * in memory and writes it at once, without flushing after each trail.
+  * The trails are written in the order of the calls to fetchTrail(),
+  * which can be made from several threads.
+  * Optionally, the output is piped through an external compressor.
+  */
+class TrailSaveToFileAsync : public TrailFetcher {
+protected:
+    string fileName;
+    bool binary;
+    unsigned int batchSize;
+    unsigned int maxPendingBatches;
+    FILE *fout;
+    bool piped;
+    vector<Trail> batch;
+    deque<vector<Trail> > pending;
+    mutex lock;
+    condition_variable wakeUpWriter, wakeUpFetchers;
+    bool closing;
+    exception_ptr failure;
+    thread writer;
+public:
+    /** The constructor, which opens the file and starts the writer thread.
+      * @param  aFileName   The name of the file to save the trails to.
+      * @param  aBinary     If true, the trails are saved in the binary trail format,
+      *                     see Trail::saveBinary(), otherwise in the text format, see Trail::save().
+      * @param  compressor  If not empty, the command through which the output is piped
+      *                     before being written to the file, e.g., "gzip -c" or "zstd -q -c".
+      * @param  aBatchSize  The number of trails passed at once to the writer thread.
+      * @param  aMaxPendingBatches  The number of batches that can wait for the writer thread
+      *                     before fetchTrail() blocks, which limits the memory used.
+      */
+    TrailSaveToFileAsync(const string& aFileName, bool aBinary = false, const string& compressor = "",
+        unsigned int aBatchSize = 4096, unsigned int aMaxPendingBatches = 16);
+    /** The destructor, which calls close() and ignores its errors. */
+    ~TrailSaveToFileAsync();
+    /** See TrailFetcher::fetchTrail().
+      * If the writer thread failed, its exception is thrown again from here.
+      */
+    void fetchTrail(const Trail& trail);
+    /** This method writes the trails still queued, waits for the writer thread to finish and closes the file.
+      * If the writer thread failed, its exception is thrown again from here.
+      * Calling it more than once has no further effect.
+      */
+    void close();
+protected:
+    void write();
+    void queueBatch(unique_lock<mutex>& guard);
+};
+
 #endif
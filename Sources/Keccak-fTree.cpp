@@ -20,6 +20,7 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include <algorithm>
 
 #include "Keccak-fTree.h"
+#include "translationsymmetry.h"
 
 OrbitalPosition OrbitalsSet::getFirstChildUnit(const std::vector<OrbitalPosition>& unitList, const TwoRoundTrailCoreStack& cache) const
 {
@@ -75,40 +76,21 @@ bool OrbitalsSet::isCanonical(const std::vector<OrbitalPosition>& orbitalList, T
 		if (orbitalList[0].z != 0)
 			return false;
 
-		unsigned int lastZ = 0;
+		// Translating the list by the z of one of its orbitals amounts to rotating the list,
+		// so each orbital is encoded with the gap to the z of the next one (cyclically),
+		// which makes the order [z,x,y0,y1] between lists the lexicographic order between encodings.
+		vector<unsigned int> encoding(orbitalList.size());
 		for (unsigned int i = 0; i < orbitalList.size(); i++){
-			unsigned int z = orbitalList[i].z;
-			if (z != 0 && z > lastZ){ // consider translation by z only if it has not been already considered before
-				lastZ = z;
-				// translate by z
-				vector<OrbitalPosition> tauList; // translated list
-				for (unsigned int j = i; j < orbitalList.size(); j++){
-					OrbitalPosition orbital = orbitalList[j];
-					orbital.z -= z;
-					tauList.push_back(orbital);
-				}
-				for (unsigned int j = 0; j < i; j++){
-					OrbitalPosition orbital = orbitalList[j];
-					orbital.z = orbital.z - z + laneSize;
-					tauList.push_back(orbital);
-				}
-				// compare lists
-				unsigned int k = 0;
-				for (k = 0; k < orbitalList.size(); k++){
-					unsigned int cmp = compare(tauList[k], orbitalList[k]);
-					if (cmp == 1)
-						return false; // there is a traslated variant smaller than the original
-					if (cmp == 2)
-						break; // original list is smaller than this translated variant, but still need to check other variants
-				}
-				// if the two list are identical, then the list is z-periodic.
-				// No need to check the other translated variants.
-				if (k == orbitalList.size()){
-					cache.nodePeriod = z;
-					break;
-				}
-			}
+			const OrbitalPosition& orbital = orbitalList[i];
+			unsigned int nextZ = (i+1 < orbitalList.size()) ? orbitalList[i+1].z : orbitalList[0].z + laneSize;
+			encoding[i] = ((orbital.x*5 + orbital.y0)*5 + orbital.y1)*(laneSize+1) + (nextZ - orbital.z);
 		}
+		// A rotation starting inside a slice is always larger than the one starting at the first orbital of this slice.
+		if (getLeastRotation(encoding) != 0)
+			return false; // there is a translated variant smaller than the original
+		unsigned int period = getRotationPeriod(encoding);
+		if (period < orbitalList.size())
+			cache.nodePeriod = orbitalList[period].z;
 		return true;
 	}
 
@@ -179,6 +161,51 @@ Column::Column(bool& aOdd, bool& aAffected){
 
 }
 
+static UINT64 readValueFromCursor(const vector<UINT64>& cursor, size_t& position)
+{
+	if (position >= cursor.size())
+		throw KeccakException("The cursor is too short for the units it should contain.");
+	return cursor[position++];
+}
+
+void appendToCursor(vector<UINT64>& cursor, const OrbitalPosition& orbital)
+{
+	cursor.push_back(orbital.x);
+	cursor.push_back(orbital.z);
+	cursor.push_back(orbital.y0);
+	cursor.push_back(orbital.y1);
+}
+
+void readFromCursor(const vector<UINT64>& cursor, size_t& position, OrbitalPosition& orbital)
+{
+	orbital.x = (unsigned int)readValueFromCursor(cursor, position);
+	orbital.z = (unsigned int)readValueFromCursor(cursor, position);
+	orbital.y0 = (unsigned int)readValueFromCursor(cursor, position);
+	orbital.y1 = (unsigned int)readValueFromCursor(cursor, position);
+}
+
+void appendToCursor(vector<UINT64>& cursor, const Column& column)
+{
+	cursor.push_back(column.position.x);
+	cursor.push_back(column.position.z);
+	cursor.push_back(column.value);
+	cursor.push_back((column.odd ? 1 : 0) | (column.affected ? 2 : 0) | (column.entangled ? 4 : 0) | (column.starting ? 8 : 0));
+	cursor.push_back(column.index);
+}
+
+void readFromCursor(const vector<UINT64>& cursor, size_t& position, Column& column)
+{
+	column.position.x = (unsigned int)readValueFromCursor(cursor, position);
+	column.position.z = (unsigned int)readValueFromCursor(cursor, position);
+	column.value = (ColumnValue)readValueFromCursor(cursor, position);
+	UINT64 flags = readValueFromCursor(cursor, position);
+	column.odd = ((flags & 1) != 0);
+	column.affected = ((flags & 2) != 0);
+	column.entangled = ((flags & 4) != 0);
+	column.starting = ((flags & 8) != 0);
+	column.index = (unsigned int)readValueFromCursor(cursor, position);
+}
+
 const ColumnValue ColumnsSet::UOValues[5] = {
 	0x01, 0x02, 0x04, 0x08, 0x10 };
 
@@ -276,17 +303,13 @@ Column ColumnsSet::getFirstChildUnit(const std::vector<Column>& unitList, const
 			// case ending AEC -> new column is a starting AEC
 			else {
 				// the position of the new starting AEC is the position of the new run, that depends on the starting position
-				// of the last run. Namely, go back and look for the previous (starting) AEC.
+				// of the last run, as kept by the cache.
 				// for z-canonicity, a new AEC cannot have x-coordinate smaller than x-coordinate of first AEC.
-				unsigned int i = 3; // size-1 is ending AEC, size-2 is UOC, check from size-3 on.
-				for (i = 3; i <= unitList.size(); i++){
-					if (unitList[unitList.size() - i].starting == true)
-						break;
-				}
+				const Column& lastStarting = unitList[cache.stack_runStart.top()];
 				newColumn.affected = true;
 				newColumn.odd = false;
-				newColumn.position.x = unitList[unitList.size() - i].position.x;
-				newColumn.position.z = unitList[unitList.size() - i].position.z;
+				newColumn.position.x = lastStarting.position.x;
+				newColumn.position.z = lastStarting.position.z;
 				newColumn.starting = true;
 				do {
 					if (newColumn.position.x < 4){
@@ -491,6 +514,7 @@ DCorLC(aDCorLC) {
 	stack_w0.push(0);
 	stack_w1.push(0);
 	stack_complete.push(true);
+	stack_runStart.push(0);
 	rootPeriod = 0;
 	nodePeriod = aDCorLC.laneSize;
 	vector<RowValue> emptyPlane(laneSize, 0);
@@ -509,6 +533,7 @@ DCorLC(aDCorLC) {
 	stack_w0.push(aW0);
 	stack_w1.push(aW1);
 	stack_complete.push(true);
+	stack_runStart.push(0);
 	rootPeriod = aRootPeriod;
 	nodePeriod = aDCorLC.laneSize;
 	getParity(stateA, C);
@@ -541,11 +566,18 @@ void TwoRoundTrailCoreStack::push(const OrbitalPosition& aOrbital){
 	stack_w1.push(w1);
 
 	stack_complete.push(true);
+	stack_runStart.push(stack_runStart.top());
 	dummy = false;
 }
 
 void TwoRoundTrailCoreStack::push(const Column& aColumn){
 
+	// the index of the new unit is the number of units already pushed
+	if (aColumn.affected && !aColumn.odd && aColumn.starting)
+		stack_runStart.push((unsigned int)stack_w0.size() - 1);
+	else
+		stack_runStart.push(stack_runStart.top());
+
 	if (aColumn.affected && !aColumn.odd){
 		pushAffectedEvenColumn(aColumn);
 		setBitToOne(D, aColumn.position.x, aColumn.position.z);
@@ -569,6 +601,7 @@ void TwoRoundTrailCoreStack::pushDummy()
 	stack_w0.push(stack_w0.top());
 	stack_w1.push(stack_w1.top());
 	stack_complete.push(true);
+	stack_runStart.push(stack_runStart.top());
 	dummy = true;
 }
 
@@ -635,6 +668,7 @@ void TwoRoundTrailCoreStack::pop(const Column& aColumn){
 	stack_w0.pop();
 	stack_w1.pop();
 	stack_complete.pop();
+	stack_runStart.pop();
 
 	if (dummy){
 		dummy = false;
@@ -693,6 +727,7 @@ void TwoRoundTrailCoreStack::pop(const OrbitalPosition& aOrbital){
 	stack_w0.pop();
 	stack_w1.pop();
 	stack_complete.pop();
+	stack_runStart.pop();
 
 	if (dummy){
 		dummy = false;
@@ -742,25 +777,98 @@ RowValue TwoRoundTrailCoreStack::getRowB(unsigned int y, unsigned int z) const
 
 int TwoRoundTrailCoreStack::pushBitAndGetDeltaMinReverseWeight(vector<SliceValue>& state, const BitPosition& p)
 {
-	int weightBefore = DCorLC.getMinReverseWeight(state[p.z]);
+	// only the row of p changes, so the difference of its weights is enough
+	int weightBefore = DCorLC.getMinReverseWeightRow(getRowFromSlice(state[p.z], p.y));
 	if ((getBit(state, p) & 1) == 0)
 		setBitToOne(state, p);
 	else
 		setBitToZero(state, p);
-	return (int)DCorLC.getMinReverseWeight(state[p.z]) - weightBefore;
+	return (int)DCorLC.getMinReverseWeightRow(getRowFromSlice(state[p.z], p.y)) - weightBefore;
 }
 
 int TwoRoundTrailCoreStack::pushBitAndGetDeltaWeight(vector<SliceValue>& state, const BitPosition& p)
 {
-	int weightBefore = DCorLC.getWeight(state[p.z]);
+	// only the row of p changes, so the difference of its weights is enough
+	int weightBefore = DCorLC.getWeightRow(getRowFromSlice(state[p.z], p.y));
 	if ((getBit(state, p) & 1) == 0)
 		setBitToOne(state, p);
 	else
 		setBitToZero(state, p);
-	return (int)DCorLC.getWeight(state[p.z]) - weightBefore;
+	return (int)DCorLC.getWeightRow(getRowFromSlice(state[p.z], p.y)) - weightBefore;
 }
 
 
+/** This class represents a state of the cache with some of its bits modified,
+* as needed to evaluate the cost bound of a node of the run tree.
+* Only the modified slices are copied, so that the weights of the modified state
+* are obtained from those kept by the cache and from the weights of these slices.
+*/
+class ModifiedStateOfCache {
+protected:
+	/** The state of the cache. */
+	const StateAsVectorOfSlices& state;
+	/** The modified slices, valid only for the slice indexes set in touched. */
+	SliceValue slices[64];
+	/** The slice indexes modified, one bit per z. */
+	UINT64 touched;
+	/** The slice indexes modified, as a list. */
+	unsigned int touchedList[64];
+	/** The number of slice indexes in touchedList. */
+	unsigned int nrTouched;
+public:
+	ModifiedStateOfCache(const StateAsVectorOfSlices& aState)
+		: state(aState), touched(0), nrTouched(0) {}
+	SliceValue getSlice(unsigned int z) const
+	{
+		return ((touched >> z) & 1) ? slices[z] : state[z];
+	}
+	int getBit(const BitPosition& p) const
+	{
+		return (getSlice(p.z) >> (p.x + 5 * p.y)) & 1;
+	}
+	void setBitToOne(const BitPosition& p)
+	{
+		touch(p.z);
+		slices[p.z] |= (SliceValue)1 << (p.x + 5 * p.y);
+	}
+	void setBitToZero(const BitPosition& p)
+	{
+		touch(p.z);
+		slices[p.z] &= ~((SliceValue)1 << (p.x + 5 * p.y));
+	}
+	/** This method returns the minimum reverse weight of the modified state,
+	* given that of the state of the cache. */
+	int getMinReverseWeight(const KeccakFPropagation& DCorLC, unsigned int weightOfCache) const
+	{
+		int weight = weightOfCache;
+		for (unsigned int i = 0; i < nrTouched; i++) {
+			unsigned int z = touchedList[i];
+			weight += (int)DCorLC.getMinReverseWeight(slices[z]) - (int)DCorLC.getMinReverseWeight(state[z]);
+		}
+		return weight;
+	}
+	/** This method returns the weight of the modified state,
+	* given that of the state of the cache. */
+	int getWeight(const KeccakFPropagation& DCorLC, unsigned int weightOfCache) const
+	{
+		int weight = weightOfCache;
+		for (unsigned int i = 0; i < nrTouched; i++) {
+			unsigned int z = touchedList[i];
+			weight += (int)DCorLC.getWeight(slices[z]) - (int)DCorLC.getWeight(state[z]);
+		}
+		return weight;
+	}
+protected:
+	void touch(unsigned int z)
+	{
+		if (((touched >> z) & 1) == 0) {
+			slices[z] = state[z];
+			touched |= (UINT64)1 << z;
+			touchedList[nrTouched++] = z;
+		}
+	}
+};
+
 unsigned int TwoRoundTrailCoreCostFunction::getCost(const vector<OrbitalPosition>& unitList, const TwoRoundTrailCoreStack& cache) const
 {
 	(void) unitList;
@@ -856,20 +964,21 @@ unsigned int TwoRoundTrailCoreCostBoundFunction::getCost(const vector<Column>& u
 	//the total number of odd-0 columns in slices with row y!=0 active.
 
 	// remove y=0 from all AEC
-	StateAsVectorOfSlices stateA = cache.stack_stateAtA.top();
-	StateAsVectorOfSlices stateB = cache.stack_stateAtB.top();
+	// only the modified slices are weighed again, the rest of the weights come from the cache
+	ModifiedStateOfCache stateA(cache.stack_stateAtA.top());
+	ModifiedStateOfCache stateB(cache.stack_stateAtB.top());
 
 	for (unsigned int i = 0; i < unitList.size(); i++){
 		if (unitList[i].affected == true){
 			if((getBit(cache.C, unitList[i].position.x, unitList[i].position.z) & 1) == 0){
 				BitPosition p(unitList[i].position.x, 0, unitList[i].position.z);
-				if ( (getBit(stateA, p) & 1)){
+				if (stateA.getBit(p)){
 					cache.DCorLC.reverseRhoPiBeforeTheta(p);
-					setBitToZero(stateA, p);
+					stateA.setBitToZero(p);
 				}
 				else{
 					cache.DCorLC.directRhoPiAfterTheta(p);
-					setBitToZero(stateB, p);
+					stateB.setBitToZero(p);
 				}
 			}
 		}
@@ -882,7 +991,7 @@ unsigned int TwoRoundTrailCoreCostBoundFunction::getCost(const vector<Column>& u
 			if (!(getBit(cache.D, unitList[i].position.x, unitList[i].position.z) & 1)){
 				if (unitList[i].index==0){
 					// set this bit to zero and check if the slice value is zero
-					SliceValue slice = stateA[unitList[i].position.z];
+					SliceValue slice = stateA.getSlice(unitList[i].position.z);
 					slice &= ~((SliceValue)1 << (unitList[i].position.x + 5 * 0));
 					if (slice != 0){
 						// check if y=0 is the only active row
@@ -890,7 +999,7 @@ unsigned int TwoRoundTrailCoreCostBoundFunction::getCost(const vector<Column>& u
 							// deactivate its bit after lambda
 							BitPosition p(unitList[i].position.x, 0, unitList[i].position.z);
 							cache.DCorLC.directRhoPiAfterTheta(p);
-							setBitToZero(stateB, p);
+							stateB.setBitToZero(p);
 						}
 						else
 					n0++;
@@ -900,7 +1009,7 @@ unsigned int TwoRoundTrailCoreCostBoundFunction::getCost(const vector<Column>& u
 						// deactivate its bit after lambda
 						BitPosition p(unitList[i].position.x, 0, unitList[i].position.z);
 						cache.DCorLC.directRhoPiAfterTheta(p);
-						setBitToZero(stateB, p);
+						stateB.setBitToZero(p);
 					}
 				}
 			}
@@ -908,7 +1017,7 @@ unsigned int TwoRoundTrailCoreCostBoundFunction::getCost(const vector<Column>& u
 	}
 
 	// compute the new cost
-	int weight = alpha*cache.DCorLC.getMinReverseWeight(stateA) + beta*cache.DCorLC.getWeight(stateB);
+	int weight = alpha*stateA.getMinReverseWeight(cache.DCorLC, cache.stack_w0.top()) + beta*stateB.getWeight(cache.DCorLC, cache.stack_w1.top());
 
 	return max(0,weight-int(2*max(alpha,beta)*n0));
 }
@@ -1050,14 +1159,14 @@ bool TwoRoundTrailCoreCostBoundFunction::canAfford(const vector<Column>& unitLis
 			return true;
 
 		// push to A and B
-		StateAsVectorOfSlices stateA = cache.stack_stateAtA.top();
-		StateAsVectorOfSlices stateB = cache.stack_stateAtB.top();
+		ModifiedStateOfCache stateA(cache.stack_stateAtA.top());
+		ModifiedStateOfCache stateB(cache.stack_stateAtB.top());
 		for (unsigned int y = 0; y < 5; y++) {
 			BitPosition p(newColumn.position.x, y, newColumn.position.z);
 			cache.DCorLC.reverseRhoPiBeforeTheta(p);
-			setBitToOne(stateA, p.x, p.y, p.z);
+			stateA.setBitToOne(p);
 			cache.DCorLC.directRhoPiAfterTheta(p);
-			setBitToOne(stateB, p.x, p.y, p.z);
+			stateB.setBitToOne(p);
 		}
 
 		// remove y=0 from all AEC
@@ -1065,13 +1174,13 @@ bool TwoRoundTrailCoreCostBoundFunction::canAfford(const vector<Column>& unitLis
 			if (unitList[i].affected == true){
 				if ((getBit(cache.C, unitList[i].position.x, unitList[i].position.z) & 1) == 0){
 					BitPosition p(unitList[i].position.x, 0, unitList[i].position.z);
-					if ((getBit(stateA, p) & 1)){
+					if (stateA.getBit(p)){
 						cache.DCorLC.reverseRhoPiBeforeTheta(p);
-						setBitToZero(stateA, p);
+						stateA.setBitToZero(p);
 					}
 					else{
 			cache.DCorLC.directRhoPiAfterTheta(p);
-						setBitToZero(stateB, p);
+						stateB.setBitToZero(p);
 					}
 				}
 			}
@@ -1085,14 +1194,14 @@ bool TwoRoundTrailCoreCostBoundFunction::canAfford(const vector<Column>& unitLis
 				if ( !(getBit(cache.D, unitList[i].position.x, unitList[i].position.z) & 1)){
 					if (unitList[i].index == 0){
 						// set this bit to zero and check if the slice value is zero
-						SliceValue slice = stateA[unitList[i].position.z];
+						SliceValue slice = stateA.getSlice(unitList[i].position.z);
 						slice &= ~((SliceValue)1 << (unitList[i].position.x + 5 * 0));
 						if (slice != 0){
 							if ((getRowFromSlice(slice, 1) == 0) && (getRowFromSlice(slice, 2) == 0) && (getRowFromSlice(slice, 3) == 0) && (getRowFromSlice(slice, 4) == 0)){
 								// deactivate its bit after lambda
 								BitPosition p(unitList[i].position.x, 0, unitList[i].position.z);
 								cache.DCorLC.directRhoPiAfterTheta(p);
-								setBitToZero(stateB, p);
+								stateB.setBitToZero(p);
 							}
 							else
 				n0++;
@@ -1101,7 +1210,7 @@ bool TwoRoundTrailCoreCostBoundFunction::canAfford(const vector<Column>& unitLis
 							// deactivate its bit after lambda
 							BitPosition p(unitList[i].position.x, 0, unitList[i].position.z);
 							cache.DCorLC.directRhoPiAfterTheta(p);
-							setBitToZero(stateB, p);
+							stateB.setBitToZero(p);
 						}
 		}
 				}
@@ -1109,7 +1218,7 @@ bool TwoRoundTrailCoreCostBoundFunction::canAfford(const vector<Column>& unitLis
 		}
 
 		// compute the new cost
-		int newWeight = alpha*cache.DCorLC.getMinReverseWeight(stateA) + beta*cache.DCorLC.getWeight(stateB) - max(alpha, beta) * 10;
+		int newWeight = alpha*stateA.getMinReverseWeight(cache.DCorLC, cache.stack_w0.top()) + beta*stateB.getWeight(cache.DCorLC, cache.stack_w1.top()) - max(alpha, beta) * 10;
 
 		if (newWeight -2*max(alpha,beta)*n0 > maxCost){
 			newColumn.index = 15;
@@ -213,6 +213,8 @@ public:
 	stack<unsigned int> stack_w0, stack_w1;
 	/** The stack to indicate if a state is valid or not. */
 	stack<bool> stack_complete;
+	/** The stack of the index, in the unit list, of the starting affected even column of the highest run. */
+	stack<unsigned int> stack_runStart;
 	/** The z-period of the root and the current node. */
 	unsigned int rootPeriod, nodePeriod;
 	/** The parity pattern of the current state. */
@@ -441,6 +443,32 @@ public:
 };
 
 
+/** This function appends an orbital to a cursor, see GenericTreeIterator::getCursor().
+* @param cursor The cursor to append to.
+* @param orbital The orbital.
+*/
+void appendToCursor(vector<UINT64>& cursor, const OrbitalPosition& orbital);
+
+/** This function reads an orbital from a cursor, see GenericTreeIterator::resume().
+* @param cursor The cursor.
+* @param position The position in the cursor, which is moved past the orbital.
+* @param orbital The orbital read.
+*/
+void readFromCursor(const vector<UINT64>& cursor, size_t& position, OrbitalPosition& orbital);
+
+/** This function appends a column to a cursor, see GenericTreeIterator::getCursor().
+* @param cursor The cursor to append to.
+* @param column The column.
+*/
+void appendToCursor(vector<UINT64>& cursor, const Column& column);
+
+/** This function reads a column from a cursor, see GenericTreeIterator::resume().
+* @param cursor The cursor.
+* @param position The position in the cursor, which is moved past the column.
+* @param column The column read.
+*/
+void readFromCursor(const vector<UINT64>& cursor, size_t& position, Column& column);
+
 /** The orbital tree. */
 typedef GenericTreeIterator<OrbitalPosition, OrbitalsSet, TwoRoundTrailCoreStack, TwoRoundTrailCore, TwoRoundTrailCoreCostFunction> OrbitalTreeIterator;
 
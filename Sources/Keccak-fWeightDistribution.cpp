@@ -0,0 +1,218 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include "Keccak-fWeightDistribution.h"
+
+using namespace std;
+
+// -------------------------------------------------------------
+//
+// BigUnsigned
+//
+// -------------------------------------------------------------
+
+BigUnsigned::BigUnsigned(UINT32 value)
+{
+    if (value != 0)
+        words.push_back(value);
+}
+
+BigUnsigned& BigUnsigned::operator+=(const BigUnsigned& other)
+{
+    if (words.size() < other.words.size())
+        words.resize(other.words.size(), 0);
+    UINT64 carry = 0;
+    for(size_t i=0; i<words.size(); i++) {
+        carry += (UINT64)words[i] + ((i < other.words.size()) ? other.words[i] : 0);
+        words[i] = (UINT32)carry;
+        carry >>= 32;
+        if ((carry == 0) && (i >= other.words.size()))
+            break;
+    }
+    if (carry != 0)
+        words.push_back((UINT32)carry);
+    return *this;
+}
+
+BigUnsigned& BigUnsigned::operator-=(const BigUnsigned& other)
+{
+    if (compare(other) < 0)
+        throw Exception("BigUnsigned: the result of the subtraction would be negative.");
+    UINT64 borrow = 0;
+    for(size_t i=0; i<words.size(); i++) {
+        UINT64 subtrahend = borrow + ((i < other.words.size()) ? other.words[i] : 0);
+        borrow = ((UINT64)words[i] < subtrahend) ? 1 : 0;
+        words[i] = (UINT32)(((UINT64)words[i] + (borrow << 32)) - subtrahend);
+        if ((borrow == 0) && (i >= other.words.size()))
+            break;
+    }
+    while((!words.empty()) && (words.back() == 0))
+        words.pop_back();
+    return *this;
+}
+
+BigUnsigned& BigUnsigned::operator*=(UINT32 factor)
+{
+    if (factor == 0) {
+        words.clear();
+        return *this;
+    }
+    UINT64 carry = 0;
+    for(size_t i=0; i<words.size(); i++) {
+        carry += (UINT64)words[i]*factor;
+        words[i] = (UINT32)carry;
+        carry >>= 32;
+    }
+    if (carry != 0)
+        words.push_back((UINT32)carry);
+    return *this;
+}
+
+UINT32 BigUnsigned::divide(UINT32 divisor)
+{
+    if (divisor == 0)
+        throw Exception("BigUnsigned: division by zero.");
+    UINT64 remainder = 0;
+    for(size_t i=words.size(); i>0; i--) {
+        remainder = (remainder << 32) | words[i-1];
+        words[i-1] = (UINT32)(remainder / divisor);
+        remainder %= divisor;
+    }
+    while((!words.empty()) && (words.back() == 0))
+        words.pop_back();
+    return (UINT32)remainder;
+}
+
+int BigUnsigned::compare(const BigUnsigned& other) const
+{
+    if (words.size() != other.words.size())
+        return (words.size() < other.words.size()) ? -1 : 1;
+    for(size_t i=words.size(); i>0; i--)
+        if (words[i-1] != other.words[i-1])
+            return (words[i-1] < other.words[i-1]) ? -1 : 1;
+    return 0;
+}
+
+double BigUnsigned::log2() const
+{
+    if (words.empty())
+        return -numeric_limits<double>::infinity();
+    // The two most significant words give 53 bits of precision at least.
+    size_t n = words.size();
+    double top = (double)words[n-1];
+    if (n >= 2)
+        top = top*4294967296.0 + (double)words[n-2];
+    return std::log2(top) + 32.0*(double)((n >= 2) ? n-2 : 0);
+}
+
+string BigUnsigned::toString() const
+{
+    if (words.empty())
+        return "0";
+    BigUnsigned quotient(*this);
+    vector<UINT32> chunks; // in base 10^9, least significant first
+    while(!quotient.isZero())
+        chunks.push_back(quotient.divide(1000000000));
+    stringstream out;
+    out << chunks.back();
+    for(size_t i=chunks.size()-1; i>0; i--)
+        out << setw(9) << setfill('0') << chunks[i-1];
+    return out.str();
+}
+
+// -------------------------------------------------------------
+//
+// KeccakFWeightDistribution
+//
+// -------------------------------------------------------------
+
+KeccakFWeightDistribution::KeccakFWeightDistribution(const KeccakFPropagation& DCorLC)
+    : laneSize(DCorLC.laneSize), name(DCorLC.name)
+{
+    for(RowValue row=0; row<(1 << nrRowsAndColumns); row++) {
+        unsigned int weight = DCorLC.getWeightRow(row);
+        if (weight >= rowsPerWeight.size())
+            rowsPerWeight.resize(weight + 1, 0);
+        rowsPerWeight[weight]++;
+    }
+    // Only the zero row has weight 0, which makes the recurrence free of divisions by the constant term.
+    if (rowsPerWeight[0] != 1)
+        throw Exception("KeccakFWeightDistribution: only the zero row is expected to have weight 0.");
+
+    // With A(x) = P(x)^n, P(x)A'(x) = nP'(x)A(x) gives, for the coefficient of x^(k-1):
+    // k a_k = sum_{j=1}^{d} ((n+1)j - k) p_j a_{k-j}.
+    // The terms are accumulated in a positive and a negative part, as the integers are unsigned.
+    unsigned int n = 5*laneSize;
+    unsigned int d = (unsigned int)rowsPerWeight.size() - 1;
+    statesPerWeight.assign(n*d + 1, BigUnsigned());
+    statesPerWeight[0] = BigUnsigned(1);
+    for(unsigned int k=1; k<=n*d; k++) {
+        BigUnsigned positive, negative;
+        for(unsigned int j=1; (j<=d) && (j<=k); j++) {
+            if ((rowsPerWeight[j] == 0) || statesPerWeight[k-j].isZero())
+                continue;
+            BigUnsigned term(statesPerWeight[k-j]);
+            term *= rowsPerWeight[j];
+            if ((n+1)*j >= k) {
+                term *= (n+1)*j - k;
+                positive += term;
+            }
+            else {
+                term *= k - (n+1)*j;
+                negative += term;
+            }
+        }
+        positive -= negative;
+        if (positive.divide(k) != 0)
+            throw Exception("KeccakFWeightDistribution: the recurrence gave a non-integer number of states.");
+        statesPerWeight[k] = positive;
+    }
+}
+
+/** This function returns @a count / @a divisor in scientific notation with 6 significant digits,
+  * computed exactly from the integer. */
+static string toScientificString(const BigUnsigned& count, UINT32 divisor)
+{
+    const unsigned int extraDigits = 6;
+    BigUnsigned scaled(count);
+    for(unsigned int i=0; i<extraDigits; i++)
+        scaled *= 10;
+    scaled.divide(divisor);
+    string digits = scaled.toString();
+    if (digits == "0")
+        return "0";
+    int exponent = (int)digits.size() - 1 - (int)extraDigits;
+    stringstream out;
+    out << digits[0];
+    if (digits.size() > 1)
+        out << "." << digits.substr(1, 5);
+    out << "e" << (exponent >= 0 ? "+" : "-") << setw(2) << setfill('0') << abs(exponent);
+    return out.str();
+}
+
+void KeccakFWeightDistribution::save(ostream& fout) const
+{
+    double log2LaneSize = std::log2((double)laneSize);
+    for(unsigned int w=0; w<statesPerWeight.size(); w++)
+        fout << "w: " << dec << w
+            << " log: " << (statesPerWeight[w].log2() - log2LaneSize)
+            << " n : " << toScientificString(statesPerWeight[w], laneSize)
+            << " count: " << statesPerWeight[w].toString() << endl;
+}
@@ -0,0 +1,101 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKFWEIGHTDISTRIBUTION_H_
+#define _KECCAKFWEIGHTDISTRIBUTION_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Keccak-fPropagation.h"
+
+using namespace std;
+
+/** This class represents a non-negative integer of arbitrary size,
+  * with the few operations needed by KeccakFWeightDistribution.
+  */
+class BigUnsigned {
+protected:
+    /** The 32-bit words, least significant first, without leading zero words. */
+    vector<UINT32> words;
+public:
+    /** The constructor.
+      * @param  value   The initial value.
+      */
+    BigUnsigned(UINT32 value = 0);
+    /** This method tells whether the value is zero. */
+    bool isZero() const { return words.empty(); }
+    /** This method adds another integer to this one. */
+    BigUnsigned& operator+=(const BigUnsigned& other);
+    /** This method subtracts another integer from this one, which must not be smaller. */
+    BigUnsigned& operator-=(const BigUnsigned& other);
+    /** This method multiplies this integer by a 32-bit factor. */
+    BigUnsigned& operator*=(UINT32 factor);
+    /** This method divides this integer by a non-zero 32-bit divisor, rounding down.
+      * @param  divisor The divisor.
+      * @return The remainder.
+      */
+    UINT32 divide(UINT32 divisor);
+    /** This method compares this integer with another one.
+      * @return -1, 0 or 1 if this integer is smaller than, equal to or larger than @a other.
+      */
+    int compare(const BigUnsigned& other) const;
+    bool operator==(const BigUnsigned& other) const { return words == other.words; }
+    bool operator!=(const BigUnsigned& other) const { return words != other.words; }
+    /** This method returns the base-2 logarithm of the integer,
+      * which does not overflow even when the integer does not fit in a double,
+      * or minus infinity for zero.
+      */
+    double log2() const;
+    /** This method returns the integer in decimal. */
+    string toString() const;
+};
+
+/** This class computes the exact number of states of Keccak-<i>f</i>
+  * per propagation weight, for DC or for LC, i.e., the number of round differentials
+  * or of round linear approximations per weight.
+  * The weight of a state is the sum of the weights of its 5×laneSize rows, so the numbers of states
+  * are the coefficients of the polynomial P(x)<sup><i>n</i></sup>, with <i>n</i> = 5×laneSize
+  * and P(x) the sum of x<sup>w(r)</sup> over the 32 row values r.
+  * As P(x) has only 5 terms, its power is computed with the recurrence that follows from
+  * P(x)·A'(x) = <i>n</i>·P'(x)·A(x) for A(x) = P(x)<sup><i>n</i></sup>,
+  * i.e., each coefficient from the previous ones with a few products by small integers.
+  * This takes time linear in the degree, instead of the convolution row after row.
+  */
+class KeccakFWeightDistribution {
+public:
+    /** The lane size. */
+    unsigned int laneSize;
+    /** This attribute contains the string "DC" or "LC", as KeccakFPropagation::name. */
+    string name;
+    /** The number of row values per weight. */
+    vector<UINT32> rowsPerWeight;
+    /** The number of states per weight, the index being the weight. */
+    vector<BigUnsigned> statesPerWeight;
+public:
+    /** The constructor, which computes the distribution.
+      * @param  DCorLC  The propagation context, as a reference to a KeccakFPropagation object.
+      */
+    KeccakFWeightDistribution(const KeccakFPropagation& DCorLC);
+    /** This method outputs the distribution, one line per weight, with
+      * the weight, the base-2 logarithm of the number of states divided by the lane size,
+      * i.e., roughly the number of states up to translation along z, this number,
+      * and the exact number of states.
+      * @param  fout    The stream to write to.
+      */
+    void save(ostream& fout) const;
+};
+
+#endif
@@ -13,6 +13,7 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include "Keccak.h"
@@ -58,3 +59,59 @@ string ReducedRoundKeccak::getDescription() const
     a << " from " << dec << startRoundIndex << " to " << startRoundIndex+nrRounds-1 << "]";
     return a.str();
 }
+
+ReducedRoundKeccakSweep::ReducedRoundKeccakSweep(unsigned int aRate, unsigned int aCapacity, int aStartRoundIndex, unsigned int aMaxNrRounds)
+    : rate(aRate), capacity(aCapacity), startRoundIndex(aStartRoundIndex), maxNrRounds(aMaxNrRounds),
+    f(aRate+aCapacity, aStartRoundIndex, aMaxNrRounds)
+{
+}
+
+void ReducedRoundKeccakSweep::hash(const UINT8 *input, unsigned int inputLengthInBits, vector<vector<UINT8> >& outputs, unsigned int outputLengthInBits) const
+{
+    // As Sponge::checkSqueezeLength()
+    if ((rate % 8) == 0) {
+        if ((outputLengthInBits % 8) != 0)
+            throw SpongeException("The desired output length must be a multiple of 8.");
+    }
+    else {
+        if (outputLengthInBits != rate)
+            throw SpongeException("The desired output length must be equal to the rate.");
+    }
+    unsigned int outputLengthInBytes = (outputLengthInBits+7)/8;
+    outputs.assign(maxNrRounds, vector<UINT8>(outputLengthInBytes));
+
+    MultiRatePadding pad;
+    MessageQueue queue(rate);
+    queue.append(input, inputLengthInBits);
+    queue.pad(pad);
+    if ((queue.blockCount() == 1) && (outputLengthInBits <= rate)) {
+        unsigned int stateSize = (f.getWidth()+7)/8;
+        vector<UINT8> states((maxNrRounds+1)*stateSize, 0);
+        const vector<UINT8>& block = queue.firstBlock();
+        copy(block.begin(), block.end(), states.begin());
+        f.sweepRounds(&states[0]);
+        for(unsigned int n=1; n<=maxNrRounds; n++) {
+            if (outputLengthInBytes == 0)
+                break;
+            copy(states.begin() + n*stateSize, states.begin() + n*stateSize + outputLengthInBytes, outputs[n-1].begin());
+            if ((rate % 8) != 0)
+                outputs[n-1][rate/8] &= (1 << (rate % 8)) - 1;
+        }
+    }
+    else {
+        for(unsigned int n=1; n<=maxNrRounds; n++) {
+            ReducedRoundKeccak keccakRR(rate, capacity, startRoundIndex, n);
+            keccakRR.absorb(input, inputLengthInBits);
+            if (outputLengthInBytes > 0)
+                keccakRR.squeeze(&outputs[n-1][0], outputLengthInBits);
+        }
+    }
+}
+
+string ReducedRoundKeccakSweep::getDescription() const
+{
+    stringstream a;
+    a << "Keccak[r=" << dec << rate << ", c=" << dec << capacity << ", 1 to " << dec << maxNrRounds << " rounds";
+    a << " from " << dec << startRoundIndex << "]";
+    return a.str();
+}
@@ -79,5 +79,51 @@ public:
     string getDescription() const;
 };
 
+/**
+  * Class that computes the outputs of ReducedRoundKeccak for the same input
+  * and all the numbers of rounds from 1 to a maximum, starting from the same round index,
+  * as needed by studies over the number of rounds.
+  * When the padded input fits in one block and the output in the first output block,
+  * which is the usual case, the outputs for all the numbers of rounds come from
+  * a single evaluation of the rounds with KeccakF::sweepRounds(),
+  * as the state after n rounds is also the state before round n+1.
+  * Otherwise, each number of rounds goes through its own ReducedRoundKeccak.
+  * The sweeps over the start round index go through one object per start round index,
+  * as the rounds then differ from the first one.
+  */
+class ReducedRoundKeccakSweep {
+protected:
+    unsigned int rate, capacity;
+    int startRoundIndex;
+    unsigned int maxNrRounds;
+    /** The permutation with the maximum number of rounds. */
+    KeccakFanyRounds f;
+public:
+    /**
+      * The constructor.
+      *
+      * @param  aRate       The rate (in bits) of the Keccak sponge function.
+      * @param  aCapacity   The capacity (in bits) of the Keccak sponge function.
+      * @param  aStartRoundIndex    The index of the first round.
+      * @param  aMaxNrRounds    The maximum number of rounds.
+      */
+    ReducedRoundKeccakSweep(unsigned int aRate, unsigned int aCapacity, int aStartRoundIndex, unsigned int aMaxNrRounds);
+    /**
+      * Method that hashes @a input for all the numbers of rounds:
+      * for n from 1 to getMaximumNumberOfRounds(), @a outputs[n-1] receives the
+      * output of ReducedRoundKeccak(rate, capacity, startRoundIndex, n) after absorbing @a input,
+      * with the same restrictions on @a outputLengthInBits as Sponge::squeeze().
+      *
+      * @param  input       The input message.
+      * @param  inputLengthInBits   The length in bits of the input message.
+      * @param  outputs     The outputs, resized to getMaximumNumberOfRounds() outputs of (outputLengthInBits+7)/8 bytes.
+      * @param  outputLengthInBits  The length in bits of each output.
+      */
+    void hash(const UINT8 *input, unsigned int inputLengthInBits, vector<vector<UINT8> >& outputs, unsigned int outputLengthInBits) const;
+    /** Method that returns the maximum number of rounds. */
+    unsigned int getMaximumNumberOfRounds() const { return maxNrRounds; }
+    /** Method that returns a string describing the sweep. */
+    string getDescription() const;
+};
 
 #endif
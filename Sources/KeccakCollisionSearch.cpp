@@ -0,0 +1,346 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <sstream>
+#include <string.h>
+#include <thread>
+#include "KeccakCollisionSearch.h"
+
+static const string pointsHeader = "KeccakTools distinguished points";
+
+static UINT64 mix(UINT64 x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+ReducedRoundKeccakCollisionSearch::ReducedRoundKeccakCollisionSearch(unsigned int aRate, unsigned int aCapacity, int aStartRoundIndex, unsigned int aNrRounds,
+    unsigned int aOutputLength, const vector<UINT8>& aMessageTemplate, unsigned int aMessageLength,
+    unsigned int aDistinguishedBits, UINT64 aTableSize, UINT64 aSeed)
+    : nrThreads(thread::hardware_concurrency()), walksPerThread(4*KeccakF::batchSize),
+    f(aRate+aCapacity, aStartRoundIndex, aNrRounds), keccakRR(aRate, aCapacity, aStartRoundIndex, aNrRounds),
+    rate(aRate), capacity(aCapacity), nrRounds(aNrRounds), startRoundIndex(aStartRoundIndex),
+    outputLength(aOutputLength), messageLength(aMessageLength), distinguishedBits(aDistinguishedBits), seed(aSeed),
+    tableFill(0), nrWalks(0), nrAbandonedWalks(0), nrEvaluations(0), nrFalseAlarms(0), nrWalksStarted(0), elapsedTime(0.0)
+{
+    if (nrThreads == 0)
+        nrThreads = 1;
+    if ((rate % 8) != 0)
+        throw CollisionSearchException("The rate must be a multiple of 8.");
+    if ((outputLength == 0) || (outputLength > 64))
+        throw CollisionSearchException("The output length must be between 1 and 64 bits.");
+    if (messageLength < outputLength)
+        throw CollisionSearchException("The messages must be at least as long as the output.");
+    if (distinguishedBits >= outputLength)
+        throw CollisionSearchException("The number of distinguished bits must be less than the output length.");
+    if (aTableSize == 0)
+        throw CollisionSearchException("The table must have at least one entry.");
+    messageTemplate.assign((messageLength+7)/8, 0);
+    for(unsigned int i=0; (i<messageTemplate.size()) && (i<aMessageTemplate.size()); i++)
+        messageTemplate[i] = aMessageTemplate[i];
+    if ((messageLength % 8) != 0)
+        messageTemplate.back() &= (1 << (messageLength % 8)) - 1;
+    for(unsigned int i=0; i<outputLength; i++)
+        messageTemplate[i/8] &= ~(1 << (i%8));
+    MultiRatePadding pad;
+    oneBlock = (pad.getPaddedSize(rate, messageLength) == rate) && (outputLength <= rate);
+    if (oneBlock) {
+        paddedBlock.assign((f.getWidth()+7)/8, 0);
+        copy(messageTemplate.begin(), messageTemplate.end(), paddedBlock.begin());
+        pad.padInPlace(rate, &paddedBlock[0], messageLength);
+    }
+    Entry empty = { 0, 0, 0 };
+    table.assign(aTableSize, empty);
+}
+
+string ReducedRoundKeccakCollisionSearch::getDescription() const
+{
+    stringstream description;
+    description << keccakRR << " output " << dec << outputLength << " message " << messageLength;
+    for(unsigned int i=0; i<messageTemplate.size(); i++)
+        description << ((i == 0) ? " " : "") << hex << (messageTemplate[i] >> 4) << (messageTemplate[i] & 0xF);
+    description << " distinguished " << dec << distinguishedBits;
+    return description.str();
+}
+
+void ReducedRoundKeccakCollisionSearch::getMessage(UINT64 x, vector<UINT8>& message) const
+{
+    message = messageTemplate;
+    for(unsigned int i=0; i<outputLength; i++)
+        if ((x >> i) & 1)
+            message[i/8] |= 1 << (i%8);
+}
+
+bool ReducedRoundKeccakCollisionSearch::isDistinguished(UINT64 x) const
+{
+    return (x & ((((UINT64)1) << distinguishedBits) - 1)) == 0;
+}
+
+UINT64 ReducedRoundKeccakCollisionSearch::getStart(UINT64 walk) const
+{
+    UINT64 x = mix(seed ^ mix(walk));
+    return (outputLength == 64) ? x : (x & ((((UINT64)1) << outputLength) - 1));
+}
+
+UINT64 ReducedRoundKeccakCollisionSearch::getSlot(UINT64 point) const
+{
+    return mix(point) % table.size();
+}
+
+void ReducedRoundKeccakCollisionSearch::evaluateBatch(const UINT64 *x, UINT64 *images, unsigned int count, vector<UINT8>& buffer) const
+{
+    const unsigned int outputLengthInBytes = (outputLength+7)/8;
+    if (oneBlock) {
+        const unsigned int stateSize = (unsigned int)paddedBlock.size();
+        buffer.resize(count*stateSize);
+        for(unsigned int k=0; k<count; k++) {
+            UINT8 *state = &buffer[k*stateSize];
+            memcpy(state, &paddedBlock[0], stateSize);
+            for(unsigned int i=0; i<outputLengthInBytes; i++)
+                state[i] |= (UINT8)(x[k] >> (8*i));
+        }
+        f.applyBatch(&buffer[0], count);
+    }
+    else {
+        const unsigned int messageLengthInBytes = (unsigned int)messageTemplate.size();
+        buffer.resize(count*(messageLengthInBytes + outputLengthInBytes));
+        vector<const UINT8 *> messages(count);
+        vector<unsigned int> lengths(count, messageLength);
+        vector<UINT8 *> outputs(count);
+        for(unsigned int k=0; k<count; k++) {
+            UINT8 *message = &buffer[count*outputLengthInBytes + k*messageLengthInBytes];
+            memcpy(message, &messageTemplate[0], messageLengthInBytes);
+            for(unsigned int i=0; i<outputLengthInBytes; i++)
+                message[i] |= (UINT8)(x[k] >> (8*i));
+            messages[k] = message;
+            outputs[k] = &buffer[k*outputLengthInBytes];
+        }
+        keccakRR.hashBatch(messages, lengths, outputs, 8*outputLengthInBytes);
+    }
+    const unsigned int stride = oneBlock ? (unsigned int)paddedBlock.size() : outputLengthInBytes;
+    for(unsigned int k=0; k<count; k++) {
+        UINT64 image = 0;
+        for(unsigned int i=0; i<outputLengthInBytes; i++)
+            image ^= ((UINT64)buffer[k*stride+i]) << (8*i);
+        images[k] = (outputLength == 64) ? image : (image & ((((UINT64)1) << outputLength) - 1));
+    }
+}
+
+UINT64 ReducedRoundKeccakCollisionSearch::evaluate(UINT64 x) const
+{
+    UINT64 image;
+    vector<UINT8> buffer;
+    evaluateBatch(&x, &image, 1, buffer);
+    return image;
+}
+
+bool ReducedRoundKeccakCollisionSearch::insert(const Entry& entry, Entry& previous)
+{
+    Entry& slot = table[getSlot(entry.point)];
+    if (slot.length == 0) {
+        slot = entry;
+        tableFill++;
+        return false;
+    }
+    if (slot.point == entry.point) {
+        previous = slot;
+        return true;
+    }
+    slot = entry;
+    return false;
+}
+
+bool ReducedRoundKeccakCollisionSearch::locate(const Entry& a, const Entry& b, Collision& collision, UINT64& nrSteps) const
+{
+    UINT64 x[2] = { a.start, b.start };
+    UINT64 lengths[2] = { a.length, b.length };
+    UINT64 images[2];
+    vector<UINT8> buffer;
+    nrSteps = 0;
+    // The longer walk is advanced until both are at the same distance from the distinguished point.
+    for(int i=0; i<2; i++)
+        for( ; lengths[i] > lengths[1-i]; lengths[i]--) {
+            evaluateBatch(&x[i], &x[i], 1, buffer);
+            nrSteps++;
+        }
+    // If the walks now coincide, one start is on the other walk and there is no collision.
+    if (x[0] == x[1])
+        return false;
+    for( ; lengths[0] > 0; lengths[0]--) {
+        evaluateBatch(x, images, 2, buffer);
+        nrSteps += 2;
+        if (images[0] == images[1]) {
+            collision.x1 = min(x[0], x[1]);
+            collision.x2 = max(x[0], x[1]);
+            collision.image = images[0];
+            return true;
+        }
+        x[0] = images[0];
+        x[1] = images[1];
+    }
+    return false;
+}
+
+bool ReducedRoundKeccakCollisionSearch::addCollision(const Collision& collision)
+{
+    for(unsigned int i=0; i<collisions.size(); i++)
+        if ((collisions[i].x1 == collision.x1) && (collisions[i].x2 == collision.x2))
+            return false;
+    collisions.push_back(collision);
+    return true;
+}
+
+UINT64 ReducedRoundKeccakCollisionSearch::search(UINT64 nrCollisions, UINT64 maxEvaluations)
+{
+    if (collisions.size() >= nrCollisions)
+        return collisions.size();
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    const UINT64 maxLength = 20*(((UINT64)1) << distinguishedBits);
+    const unsigned int nrWalksPerThread = max(walksPerThread, 1U);
+    atomic<bool> stop(false);
+    atomic<UINT64> walkCounter(nrWalksStarted);
+    atomic<UINT64> evaluations(0), walks(0), abandonedWalks(0), falseAlarms(0);
+    exception_ptr failure;
+    vector<thread> workers;
+    for(unsigned int t=0; t<nrThreads; t++)
+        workers.push_back(thread([&]() {
+            try {
+                vector<UINT64> starts(nrWalksPerThread), current(nrWalksPerThread), lengths(nrWalksPerThread, 0);
+                vector<UINT8> buffer;
+                for(unsigned int k=0; k<nrWalksPerThread; k++)
+                    starts[k] = current[k] = getStart(walkCounter++);
+                while(!stop) {
+                    evaluateBatch(&current[0], &current[0], nrWalksPerThread, buffer);
+                    UINT64 total = (evaluations += nrWalksPerThread);
+                    if ((maxEvaluations > 0) && (total >= maxEvaluations))
+                        stop = true;
+                    for(unsigned int k=0; k<nrWalksPerThread; k++) {
+                        lengths[k]++;
+                        if (isDistinguished(current[k])) {
+                            walks++;
+                            Entry entry = { current[k], starts[k], lengths[k] };
+                            Entry previous;
+                            bool match;
+                            {
+                                lock_guard<mutex> guard(lock);
+                                match = insert(entry, previous);
+                            }
+                            if (match && (previous.start != entry.start)) {
+                                Collision collision;
+                                UINT64 nrSteps;
+                                bool found = locate(previous, entry, collision, nrSteps);
+                                evaluations += nrSteps;
+                                if (found) {
+                                    lock_guard<mutex> guard(lock);
+                                    if (addCollision(collision) && (collisions.size() >= nrCollisions))
+                                        stop = true;
+                                }
+                                else
+                                    falseAlarms++;
+                            }
+                        }
+                        else if (lengths[k] < maxLength)
+                            continue;
+                        else
+                            abandonedWalks++;
+                        starts[k] = current[k] = getStart(walkCounter++);
+                        lengths[k] = 0;
+                    }
+                }
+            }
+            catch(...) {
+                lock_guard<mutex> guard(lock);
+                if (!failure)
+                    failure = current_exception();
+                stop = true;
+            }
+        }));
+    for(unsigned int t=0; t<workers.size(); t++)
+        workers[t].join();
+    nrWalksStarted = walkCounter;
+    nrEvaluations += evaluations;
+    nrWalks += walks;
+    nrAbandonedWalks += abandonedWalks;
+    nrFalseAlarms += falseAlarms;
+    elapsedTime += chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    if (failure)
+        rethrow_exception(failure);
+    return collisions.size();
+}
+
+void ReducedRoundKeccakCollisionSearch::saveDistinguishedPoints(ostream& fout) const
+{
+    fout << pointsHeader << endl;
+    fout << getDescription() << endl;
+    fout << "points " << dec << tableFill << endl;
+    for(UINT64 i=0; i<table.size(); i++)
+        if (table[i].length > 0)
+            fout << hex << table[i].point << " " << table[i].start << " " << table[i].length << endl;
+    fout << dec;
+}
+
+UINT64 ReducedRoundKeccakCollisionSearch::loadDistinguishedPoints(istream& fin)
+{
+    string header, description;
+    getline(fin, header);
+    if (header != pointsHeader)
+        throw CollisionSearchException("The stream does not contain distinguished points.");
+    getline(fin, description);
+    if (description != getDescription())
+        throw CollisionSearchException("The distinguished points were saved with different parameters: " + description);
+    string keyword;
+    UINT64 nrPoints;
+    fin >> keyword >> dec >> nrPoints;
+    if ((!fin) || (keyword != "points"))
+        throw CollisionSearchException("The distinguished points are corrupted.");
+    for(UINT64 i=0; i<nrPoints; i++) {
+        Entry entry, previous;
+        fin >> hex >> entry.point >> entry.start >> entry.length;
+        if ((!fin) || (entry.length == 0))
+            throw CollisionSearchException("The distinguished points are corrupted.");
+        if (insert(entry, previous) && (previous.start != entry.start)) {
+            Collision collision;
+            UINT64 nrSteps;
+            if (locate(previous, entry, collision, nrSteps))
+                addCollision(collision);
+            else
+                nrFalseAlarms++;
+            nrEvaluations += nrSteps;
+        }
+    }
+    fin >> dec;
+    return nrPoints;
+}
+
+void ReducedRoundKeccakCollisionSearch::displayStatistics(ostream& fout) const
+{
+    fout << "Collision search on " << keccakRR << " truncated to " << dec << outputLength << " bits, ";
+    fout << distinguishedBits << " distinguished bits" << endl;
+    fout << "walks: " << nrWalks << " reached a distinguished point, " << nrAbandonedWalks << " abandoned" << endl;
+    fout << "evaluations: " << nrEvaluations << " in " << elapsedTime << " seconds";
+    if (elapsedTime > 0.0)
+        fout << ", i.e., " << (nrEvaluations/elapsedTime) << " per second";
+    fout << endl;
+    fout << "table: " << tableFill << " of " << table.size() << " entries in use ("
+        << (100.0*tableFill/table.size()) << "%)" << endl;
+    fout << "collisions: " << collisions.size() << " distinct, " << nrFalseAlarms << " false alarms" << endl;
+}
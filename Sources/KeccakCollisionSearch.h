@@ -0,0 +1,156 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KECCAKCOLLISIONSEARCH_H_
+#define _KECCAKCOLLISIONSEARCH_H_
+
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Keccak.h"
+
+using namespace std;
+
+typedef Exception CollisionSearchException;
+
+/** This class searches for collisions on the truncated output of a reduced-round Keccak instance
+  * with the parallel collision search of van Oorschot and Wiener.
+  *
+  * The search iterates the function g that maps a point x of outputLength bits,
+  * at most 64, to the first outputLength bits of the output of the instance on the message
+  * made of a fixed template whose first outputLength bits are replaced by x.
+  * A walk starts from a pseudo-random point derived from the seed and iterates g
+  * until it reaches a distinguished point, i.e., a point whose distinguishedBits lowest bits are zero.
+  * The distinguished point, the start of the walk and its length are then stored in a table;
+  * when two walks from different starts reach the same distinguished point,
+  * they are walked again from their starts to locate the collision.
+  * A walk that is longer than 20 times the expected length is abandoned, as it is likely in a cycle.
+  *
+  * The walks run on several threads, each advancing a batch of walks together
+  * so that the permutation can process the messages with Transformation::applyBatch().
+  * The table is shared by the threads and has a fixed number of entries,
+  * so the memory use is bounded: when two distinguished points fall in the same entry, the older one is lost.
+  *
+  * The search can be distributed over several nodes by giving them different seeds,
+  * saving their distinguished points with saveDistinguishedPoints() and loading them
+  * on one node with loadDistinguishedPoints(), which locates the collisions between them.
+  */
+class ReducedRoundKeccakCollisionSearch {
+public:
+    /** A collision g(x1) = g(x2) with x1 < x2. */
+    struct Collision {
+        UINT64 x1, x2, image;
+    };
+    /** The number of threads used by search(). */
+    unsigned int nrThreads;
+    /** The number of walks that each thread advances together. */
+    unsigned int walksPerThread;
+protected:
+    struct Entry {
+        UINT64 point, start;
+        UINT64 length;
+    };
+    KeccakFanyRounds f;
+    ReducedRoundKeccak keccakRR;
+    /** Whether the padded messages fit in one block and the output in the first block,
+      * so that the states can be prepared directly. */
+    bool oneBlock;
+    /** The first block of the messages, padded, with zeroes in place of the point. */
+    vector<UINT8> paddedBlock;
+    unsigned int rate, capacity, nrRounds;
+    int startRoundIndex;
+    unsigned int outputLength;
+    vector<UINT8> messageTemplate;
+    unsigned int messageLength;
+    unsigned int distinguishedBits;
+    UINT64 seed;
+    vector<Entry> table;
+    UINT64 tableFill;
+    vector<Collision> collisions;
+    UINT64 nrWalks, nrAbandonedWalks, nrEvaluations, nrFalseAlarms, nrWalksStarted;
+    double elapsedTime;
+    mutex lock;
+public:
+    /** The constructor.
+      * @param  aRate       The rate, a multiple of 8.
+      * @param  aCapacity   The capacity.
+      * @param  aStartRoundIndex    The index of the first round.
+      * @param  aNrRounds   The number of rounds.
+      * @param  aOutputLength   The number of bits of the output that must collide, from 1 to 64.
+      * @param  aMessageTemplate    The bits of the messages after the first @a aOutputLength bits.
+      * @param  aMessageLength      The length in bits of the messages, at least @a aOutputLength.
+      * @param  aDistinguishedBits  The number of bits that must be zero in a distinguished point.
+      * @param  aTableSize  The number of entries of the table of distinguished points.
+      * @param  aSeed       The seed from which the starts of the walks are derived.
+      */
+    ReducedRoundKeccakCollisionSearch(unsigned int aRate, unsigned int aCapacity, int aStartRoundIndex, unsigned int aNrRounds,
+        unsigned int aOutputLength, const vector<UINT8>& aMessageTemplate, unsigned int aMessageLength,
+        unsigned int aDistinguishedBits, UINT64 aTableSize, UINT64 aSeed);
+    /** This method builds the message corresponding to a point.
+      * @param  x       The point.
+      * @param  message The message, of @a aMessageLength bits.
+      */
+    void getMessage(UINT64 x, vector<UINT8>& message) const;
+    /** This method computes g on a point, without the batches. */
+    UINT64 evaluate(UINT64 x) const;
+    /** This method runs walks until a given number of distinct collisions is found
+      * or a given number of evaluations of g is reached.
+      * It can be called again to continue the search, with the same table.
+      * @param  nrCollisions    The number of distinct collisions to find, counting those found before.
+      * @param  maxEvaluations  The maximum number of evaluations of g in this call, or 0 for no limit.
+      * @return The number of distinct collisions found so far.
+      */
+    UINT64 search(UINT64 nrCollisions, UINT64 maxEvaluations = 0);
+    /** This method returns the distinct collisions found so far, in the order they were found. */
+    const vector<Collision>& getCollisions() const { return collisions; }
+    /** This method saves the distinguished points in the table, one per line as
+      * the point, the start of the walk and its length, in hexadecimal.
+      * @param  fout    The stream to save the points to.
+      */
+    void saveDistinguishedPoints(ostream& fout) const;
+    /** This method loads distinguished points saved by saveDistinguishedPoints(),
+      * possibly on another node, and inserts them in the table, locating the collisions.
+      * An exception is thrown if the points were saved with different parameters.
+      * @param  fin     The stream to load the points from.
+      * @return The number of points loaded.
+      */
+    UINT64 loadDistinguishedPoints(istream& fin);
+    /** This method returns the number of walks that reached a distinguished point. */
+    UINT64 getNumberOfWalks() const { return nrWalks; }
+    /** This method returns the number of walks abandoned. */
+    UINT64 getNumberOfAbandonedWalks() const { return nrAbandonedWalks; }
+    /** This method returns the number of evaluations of g, including those to locate the collisions. */
+    UINT64 getNumberOfEvaluations() const { return nrEvaluations; }
+    /** This method returns the number of entries of the table in use. */
+    UINT64 getTableFill() const { return tableFill; }
+    /** This method returns the number of entries of the table. */
+    UINT64 getTableSize() const { return table.size(); }
+    /** This method returns the total duration in seconds of the calls to search(). */
+    double getElapsedTime() const { return elapsedTime; }
+    /** This method displays the statistics of the search: walks, rate, table fill and collisions. */
+    void displayStatistics(ostream& fout) const;
+protected:
+    string getDescription() const;
+    bool isDistinguished(UINT64 x) const;
+    UINT64 getStart(UINT64 walk) const;
+    UINT64 getSlot(UINT64 point) const;
+    void evaluateBatch(const UINT64 *x, UINT64 *images, unsigned int count, vector<UINT8>& buffer) const;
+    bool insert(const Entry& entry, Entry& previous);
+    bool locate(const Entry& a, const Entry& b, Collision& collision, UINT64& nrSteps) const;
+    bool addCollision(const Collision& collision);
+};
+
+#endif
@@ -16,6 +16,159 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #ifndef _KECCAKCRUNCHYCONTEST_H_
 #define _KECCAKCRUNCHYCONTEST_H_
 
+#include <iostream>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+/** This class holds challenges of the Keccak Crunchy Crypto Contest,
+  * each with a candidate solution, and verifies them all at once.
+  * The challenges on the same instance of ReducedRoundKeccak are verified together
+  * with Sponge::hashBatch(), so that the instance is created only once
+  * and the candidate inputs go through the permutation in batches,
+  * and the different instances are distributed over several threads.
+  */
+class CrunchyContestVerifier {
+public:
+    /** The length in bits of the image in a preimage challenge. */
+    static const unsigned int preimageImageLength = 80;
+    /** The length in bits of the output that must collide in a collision challenge. */
+    static const unsigned int collisionImageLength = 160;
+    /** A challenge with its candidate solution. */
+    struct Challenge {
+        /** Whether this is a collision challenge (true) or a preimage challenge (false). */
+        bool collision;
+        unsigned int rate, capacity, nrRounds;
+        int startRoundIndex;
+        /** For a preimage challenge, the image. */
+        vector<UINT8> image;
+        /** The candidate preimage, or the first input of the candidate collision. */
+        vector<UINT8> input1;
+        unsigned int input1Length;
+        /** The second input of the candidate collision. */
+        vector<UINT8> input2;
+        unsigned int input2Length;
+    };
+    /** The number of threads used by verify(). */
+    unsigned int nrThreads;
+protected:
+    vector<Challenge> challenges;
+public:
+    /** The constructor, with as many threads as the hardware can run concurrently. */
+    CrunchyContestVerifier();
+    /** This method adds a preimage challenge.
+      * @param  r   The rate.
+      * @param  c   The capacity.
+      * @param  nr  The number of rounds.
+      * @param  image   The image, of preimageImageLength bits.
+      * @param  start   The index of the first round.
+      * @param  preimage    The candidate preimage.
+      * @param  preimageLength  The length in bits of the candidate preimage.
+      */
+    void addPreimageChallenge(int r, int c, int nr, const UINT8 image[], int start, const UINT8 preimage[], const int preimageLength);
+    /** This method adds a collision challenge.
+      * @param  r   The rate.
+      * @param  c   The capacity.
+      * @param  nr  The number of rounds.
+      * @param  start   The index of the first round.
+      * @param  input1  The first input of the candidate collision.
+      * @param  input1Length    The length in bits of @a input1.
+      * @param  input2  The second input of the candidate collision.
+      * @param  input2Length    The length in bits of @a input2.
+      */
+    void addCollisionChallenge(int r, int c, int nr, int start, const UINT8 input1[], const int input1Length, const UINT8 input2[], const int input2Length);
+    /** This method adds all the challenges of the contest, with the solutions received so far. */
+    void addAllChallenges();
+    /** This method returns the number of challenges. */
+    unsigned int size() const { return (unsigned int)challenges.size(); }
+    /** This method returns a challenge. */
+    const Challenge& operator[](unsigned int i) const { return challenges[i]; }
+    /** This method verifies the challenges.
+      * @param  results For each challenge in the order they were added, whether its solution is correct.
+      */
+    void verify(vector<bool>& results) const;
+    /** This method verifies the challenges and displays the result of each,
+      * in the order they were added, followed by the number of correct solutions.
+      * @param  fout    The stream to display the results to.
+      * @return The number of correct solutions.
+      */
+    unsigned int verify(ostream& fout) const;
+protected:
+    void verifyInstance(const vector<unsigned int>& indexes, vector<bool>& results) const;
+};
+
+/** This class searches for preimages of a reduced-round Keccak instance
+  * by sweeping a space of candidate messages.
+  * A candidate is made of a fixed message template, in which the bits of a counter
+  * are written at chosen positions, the free bits;
+  * the counter goes through a given range, which is cut into chunks distributed over several threads.
+  * A candidate is a hit when the first bits of its output are equal to those of the target image,
+  * so that a partial match can be requested to run experiments on a small search space.
+  * When the padded candidates fit in one block, which is the usual case,
+  * the states are prepared directly and go through the permutation with
+  * Transformation::applyBatch(); otherwise, the candidates go through Sponge::hashBatch().
+  */
+class ReducedRoundKeccakPreimageSearch {
+public:
+    /** The number of threads used by search(). */
+    unsigned int nrThreads;
+    /** The number of candidates that a thread takes at once. */
+    unsigned int chunkSize;
+protected:
+    unsigned int rate, capacity, nrRounds;
+    int startRoundIndex;
+    vector<UINT8> image;
+    unsigned int matchLength;
+    vector<UINT8> messageTemplate;
+    unsigned int messageLength;
+    vector<unsigned int> freeBits;
+    UINT64 nrCandidatesTried;
+    double elapsedTime;
+public:
+    /** The constructor.
+      * @param  aRate       The rate, a multiple of 8.
+      * @param  aCapacity   The capacity.
+      * @param  aStartRoundIndex    The index of the first round.
+      * @param  aNrRounds   The number of rounds.
+      * @param  aImage      The target image.
+      * @param  aMatchLength    The number of bits of the output, at most the rate,
+      *                     that must be equal to the first bits of @a aImage.
+      */
+    ReducedRoundKeccakPreimageSearch(unsigned int aRate, unsigned int aCapacity, int aStartRoundIndex, unsigned int aNrRounds,
+        const vector<UINT8>& aImage, unsigned int aMatchLength);
+    /** This method sets the space of the candidates.
+      * @param  aMessageTemplate    The bits of the candidates outside the free bits.
+      * @param  aMessageLength      The length in bits of the candidates.
+      * @param  aFreeBits   The positions in the candidates of the bits 0, 1, ... of the counter, at most 64.
+      */
+    void setSearchSpace(const vector<UINT8>& aMessageTemplate, unsigned int aMessageLength, const vector<unsigned int>& aFreeBits);
+    /** This method returns the length in bits of the candidates. */
+    unsigned int getMessageLength() const { return messageLength; }
+    /** This method builds the candidate for a value of the counter.
+      * @param  value   The value of the counter.
+      * @param  message The candidate, of getMessageLength() bits.
+      */
+    void getCandidate(UINT64 value, vector<UINT8>& message) const;
+    /** This method tries the candidates for the counter values from @a first to @a last-1.
+      * @param  first   The first value of the counter.
+      * @param  last    The value after the last value of the counter.
+      * @param  hits    The values of the counter giving hits, by increasing value.
+      * @return The number of hits.
+      */
+    UINT64 search(UINT64 first, UINT64 last, vector<UINT64>& hits);
+    /** This method returns the number of candidates tried by the last search. */
+    UINT64 getNumberOfCandidatesTried() const { return nrCandidatesTried; }
+    /** This method returns the duration in seconds of the last search. */
+    double getElapsedTime() const { return elapsedTime; }
+    /** This method returns the number of candidates tried per second by the last search. */
+    double getRate() const { return (elapsedTime > 0.0) ? nrCandidatesTried/elapsedTime : 0.0; }
+protected:
+    bool fitsInOneBlock() const;
+    void searchChunk(UINT64 first, UINT64 last, vector<UINT64>& hits) const;
+    bool isHit(const UINT8 *output) const;
+};
+
 void verifyChallenges();
 
 #endif
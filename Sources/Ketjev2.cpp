@@ -19,6 +19,10 @@ Ketje::Ketje(unsigned int width, unsigned int rho)
     : f(width), monkeyWrap(f, rho, 12, 1, 6)
 {}
 
+Ketje::Ketje(const Ketje &other)
+    : f(other.f), monkeyWrap(other.monkeyWrap, f)
+{}
+
 void Ketje::initialize(const string &K, const string &N)
 {
     monkeyWrap.initialize(BitString(K), BitString(N));
@@ -38,6 +42,26 @@ string Ketje::unwrap(const string &A, const string &C, const string &T)
     return monkeyWrap.unwrap(BitString(A), BitString(C), BitString(T)).str();
 }
 
+void Ketje::addAssociatedData(const UINT8 *A, size_t length)
+{
+    monkeyWrap.addAssociatedData(A, length);
+}
+
+void Ketje::wrap(const UINT8 *B, UINT8 *C, size_t length)
+{
+    monkeyWrap.wrapBytes(B, C, length);
+}
+
+void Ketje::unwrap(const UINT8 *C, UINT8 *B, size_t length)
+{
+    monkeyWrap.unwrapBytes(C, B, length);
+}
+
+void Ketje::finalize(UINT8 *T, size_t length)
+{
+    monkeyWrap.finalize(T, length);
+}
+
 unsigned int Ketje::getWidth() const
 {
     return f.width;
@@ -25,14 +25,23 @@ using namespace std;
 
 class Ketje {
 protected:
-    IterableTransformation<KeccakPStar>  f;
+    IterableKeccakTransformation<KeccakPStar> f;
     MonkeyWrap                           monkeyWrap;
 public:
     Ketje(unsigned int width, unsigned int rho);
+    Ketje(const Ketje &other);                                       // Copies the state, with monkeyWrap on the copy's own f
     void          initialize(const string &K, const string &N);
     string        wrap(const string &A, const string &B, unsigned int ell, string &T);
     string        unwrap(const string &A, const string &C, const string &T);
     unsigned int  getWidth() const;
+
+    /* Streaming interface on byte buffers, see MonkeyWrap */
+    void          addAssociatedData(const UINT8 *A, size_t length);
+    void          wrap(const UINT8 *B, UINT8 *C, size_t length);
+    void          unwrap(const UINT8 *C, UINT8 *B, size_t length);
+    void          finalize(UINT8 *T, size_t length);
+
+    friend class KetjeWrapOperation;
 };
 
 class KetjeJr: public Ketje {
@@ -49,6 +49,18 @@ bool Keyak::Wrap(istream& I, stringstream& O, istream& A, stringstream& T, bool
     return motorist.Wrap(I, O, A, T, unwrapFlag, forgetFlag);
 }
 
+bool Keyak::StartEngine(const string& K, const string& N, bool tagFlag, UINT8 *T, bool unwrapFlag, bool forgetFlag)
+{
+    unsigned int lk = W/8*((c+9+W-1)/W);
+    string SUV = keypack(K, lk) + N;
+    return motorist.StartEngine((const UINT8 *)SUV.data(), SUV.size(), tagFlag, T, unwrapFlag, forgetFlag);
+}
+
+bool Keyak::Wrap(const UINT8 *I, size_t Ilength, UINT8 *O, const UINT8 *A, size_t Alength, UINT8 *T, bool unwrapFlag, bool forgetFlag)
+{
+    return motorist.Wrap(I, Ilength, O, A, Alength, T, unwrapFlag, forgetFlag);
+}
+
 ostream& operator<<(ostream& a, const Keyak& keyak)
 {
     return a << "Keyak[b=" << dec << keyak.f.getWidth()
@@ -36,9 +36,13 @@ public:
     Keyak(const Keyak& keyak);
     bool StartEngine(const string& K, const string& N, bool tagFlag, stringstream& T, bool unwrapFlag, bool forgetFlag);
     bool Wrap(istream& I, stringstream& O, istream& A, stringstream& T, bool unwrapFlag, bool forgetFlag);
+    /* Same as above on byte buffers, see Motorist */
+    bool StartEngine(const string& K, const string& N, bool tagFlag, UINT8 *T, bool unwrapFlag, bool forgetFlag);
+    bool Wrap(const UINT8 *I, size_t Ilength, UINT8 *O, const UINT8 *A, size_t Alength, UINT8 *T, bool unwrapFlag, bool forgetFlag);
     friend ostream& operator<<(ostream& a, const Keyak& piston);
     unsigned int getWidth() const;
     unsigned int getPi() const;
+    friend class KeyakWrapOperation;
 };
 
 class RiverKeyak : public Keyak {
@@ -20,38 +20,76 @@
 /* KravatteCompressionRollingFunction */
 BitString KravatteCompressionRollingFunction::operator()(const BitString &k, unsigned int i) const
 {
-	vector<UINT8> kp(k.array(), k.array() + k.size() / 8);
-	UINT64 *lanes = reinterpret_cast<UINT64 *>(kp.data());
+	BitString kp(k);
+	rollInPlace(reinterpret_cast<UINT64 *>(kp.array()), kp.size(), i);
+	return kp;
+}
 
-	for (unsigned int j = 0; j < i; j++)
-	{
-		UINT64 x0 = lanes[5 * 4    ];
-		UINT64 x1 = lanes[5 * 4 + 1];
+void KravatteCompressionRollingFunction::rollInPlace(UINT64 *lanes, unsigned int width, unsigned int i) const
+{
+	(void)width;
+	UINT64 *row = &lanes[5 * 4];
 
-		std::rotate(&lanes[5 * 4], &lanes[5 * 4 + 1], &lanes[5 * 5]);
-		lanes[5 * 4 + 4] = (ROL64(x0, 7) ^ x1 ^ (x1 >> 3));
+	// Only the last row changes; writing it back every 5 steps saves the rotation of the lanes
+	for (; i >= 5; i -= 5)
+	{
+		UINT64 x0 = row[0], x1 = row[1], x2 = row[2], x3 = row[3], x4 = row[4];
+		UINT64 x5 = ROL64(x0, 7) ^ x1 ^ (x1 >> 3);
+		UINT64 x6 = ROL64(x1, 7) ^ x2 ^ (x2 >> 3);
+		UINT64 x7 = ROL64(x2, 7) ^ x3 ^ (x3 >> 3);
+		UINT64 x8 = ROL64(x3, 7) ^ x4 ^ (x4 >> 3);
+		UINT64 x9 = ROL64(x4, 7) ^ x5 ^ (x5 >> 3);
+		row[0] = x5; row[1] = x6; row[2] = x7; row[3] = x8; row[4] = x9;
 	}
+	for (; i > 0; i--)
+	{
+		UINT64 x0 = row[0];
+		UINT64 x1 = row[1];
 
-	return BitString(kp);
+		std::rotate(&row[0], &row[1], &row[5]);
+		row[4] = (ROL64(x0, 7) ^ x1 ^ (x1 >> 3));
+	}
 }
 
 /* KravatteExpansionRollingFunction */
 BitString KravatteExpansionRollingFunction::operator()(const BitString &k, unsigned int i) const
 {
-	vector<UINT8> kp(k.array(), k.array() + k.size() / 8);
-	UINT64 *lanes = reinterpret_cast<UINT64 *>(kp.data());
+	BitString kp(k);
+	rollInPlace(reinterpret_cast<UINT64 *>(kp.array()), kp.size(), i);
+	return kp;
+}
 
-	for (unsigned int j = 0; j < i; j++)
-	{
-		UINT64 x0 = lanes[5 * 3    ];
-		UINT64 x1 = lanes[5 * 3 + 1];
-		UINT64 x2 = lanes[5 * 3 + 2];
+void KravatteExpansionRollingFunction::rollInPlace(UINT64 *lanes, unsigned int width, unsigned int i) const
+{
+	(void)width;
+	UINT64 *rows = &lanes[5 * 3];
 
-		std::rotate(&lanes[5 * 3], &lanes[5 * 3 + 1], &lanes[5 * 5]);
-		lanes[5 * 4 + 4] = (ROL64(x0, 7) ^ ROL64(x1, 18) ^ (x2 & (x1 >> 1)));
+	// Only the last two rows change; writing them back every 10 steps saves the rotation of the lanes
+	for (; i >= 10; i -= 10)
+	{
+		UINT64 x[20];
+		for (unsigned int j = 0; j < 10; j++)
+		{
+			x[j] = rows[j];
+		}
+		for (unsigned int j = 0; j < 10; j++)
+		{
+			x[j + 10] = (ROL64(x[j], 7) ^ ROL64(x[j + 1], 18) ^ (x[j + 2] & (x[j + 1] >> 1)));
+		}
+		for (unsigned int j = 0; j < 10; j++)
+		{
+			rows[j] = x[j + 10];
+		}
 	}
+	for (; i > 0; i--)
+	{
+		UINT64 x0 = rows[0];
+		UINT64 x1 = rows[1];
+		UINT64 x2 = rows[2];
 
-	return BitString(kp);
+		std::rotate(&rows[0], &rows[1], &rows[10]);
+		rows[9] = (ROL64(x0, 7) ^ ROL64(x1, 18) ^ (x2 & (x1 >> 1)));
+	}
 }
 
 /* Kravatte Achouffe instantiation parameters */
@@ -93,18 +131,34 @@ Kravatte::Kravatte()
 {
 }
 
+/* Kravatte key context pool */
+KravatteKeyContextPool::KravatteKeyContextPool(unsigned int capacity, unsigned int nrMasks)
+	: FarfalleKeyContextPool(make_Kravatte(), capacity, nrMasks)
+{
+}
+
 /* Kravatte-SANE */
 KravatteSANE::KravatteSANE(const BitString &K, const BitString &N, BitString &T, bool sender)
 	: FarfalleSANE(make_Kravatte(), KravatteParams::param_SANE_t, KravatteParams::param_SANE_l, K, N, T, sender)
 {
 }
 
+KravatteSANE::KravatteSANE(const shared_ptr<const FarfalleKeyContext> &key, const BitString &N, BitString &T, bool sender)
+	: FarfalleSANE(make_Kravatte(), KravatteParams::param_SANE_t, KravatteParams::param_SANE_l, key, N, T, sender)
+{
+}
+
 /* Kravatte-SANSE */
 KravatteSANSE::KravatteSANSE(const BitString &K)
 	: FarfalleSANSE(make_Kravatte(), KravatteParams::param_SANSE_t, K)
 {
 }
 
+KravatteSANSE::KravatteSANSE(const shared_ptr<const FarfalleKeyContext> &key)
+	: FarfalleSANSE(make_Kravatte(), KravatteParams::param_SANSE_t, key)
+{
+}
+
 /* Kravatte-WBC */
 KravatteWBC::KravatteWBC()
 	: FarfalleWBC(make_Short_Kravatte(), make_Kravatte(), KravatteParams::param_WBC_l)
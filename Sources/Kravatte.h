@@ -30,12 +30,14 @@ class KravatteCompressionRollingFunction : public BaseRollingFunction
 {
 	public:
 		BitString operator()(const BitString &k, unsigned int i) const;
+		void rollInPlace(UINT64 *k, unsigned int width, unsigned int i) const;
 };
 
 class KravatteExpansionRollingFunction : public BaseRollingFunction
 {
 	public:
 		BitString operator()(const BitString &k, unsigned int i) const;
+		void rollInPlace(UINT64 *k, unsigned int width, unsigned int i) const;
 };
 
 class Kravatte : public Farfalle
@@ -44,16 +46,29 @@ class Kravatte : public Farfalle
 		Kravatte();
 };
 
+/**
+ * Class implementing a pool of key contexts for Kravatte, see FarfalleKeyContextPool.
+ * The contexts are valid for Kravatte, Kravatte-SANE, Kravatte-SANSE, Kravatte-WBC and Kravatte-WBC-AE,
+ * which all derive their key with the same permutation and rolling function.
+ */
+class KravatteKeyContextPool : public FarfalleKeyContextPool
+{
+	public:
+		KravatteKeyContextPool(unsigned int capacity = 1024, unsigned int nrMasks = 32);
+};
+
 class KravatteSANE : public FarfalleSANE
 {
 	public:
 		KravatteSANE(const BitString &K, const BitString &N, BitString &T, bool sender);
+		KravatteSANE(const shared_ptr<const FarfalleKeyContext> &key, const BitString &N, BitString &T, bool sender);
 };
 
 class KravatteSANSE : public FarfalleSANSE
 {
 	public:
 		KravatteSANSE(const BitString &K);
+		KravatteSANSE(const shared_ptr<const FarfalleKeyContext> &key);
 };
 
 class KravatteWBC : public FarfalleWBC
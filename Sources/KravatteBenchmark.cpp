@@ -0,0 +1,69 @@
+/*
+ * Implementation by the Farfalle and Kravatte Teams, namely, Guido Bertoni,
+ * Joan Daemen, Seth Hoffert, Michaël Peeters, Gilles Van Assche and Ronny Van Keer,
+ * hereby denoted as "the implementer".
+ *
+ * For more information, feedback or questions, please refer to our websites:
+ * https://keccak.team/farfalle.html
+ * https://keccak.team/kravatte.html
+ *
+ * To the extent possible under law, the implementer has waived all copyright
+ * and related or neighboring rights to the source code in this file.
+ * http://creativecommons.org/publicdomain/zero/1.0/
+ */
+
+#include "Kravatte.h"
+#include "modesBenchmark.h"
+
+// Kravatte is in a separate file, since Farfalle.h and monkey.h both define IterableTransformation.
+
+void benchmarkKravatteModes(ostream& out, const vector<unsigned int>& lengths, double minimumTime)
+{
+	unsigned int maximumLength = lengths.back();
+	vector<UINT8> input(maximumLength + 1, 0x5A), output(maximumLength + 1);
+	// The in-place calls of WBC-AE need room for the expansion of 128 bits
+	vector<UINT8> wrapped(maximumLength + 16);
+	BitString K(string(32, 'K'));
+	BitString N(string(16, 'N'));
+
+	Kravatte kravatte;
+	for (unsigned int i = 0; i < lengths.size(); i++)
+	{
+		BitString M(input.data(), 8 * lengths[i]);
+		measureMode(out, "Kravatte", "Achouffe", "prf", lengths[i], 0, [&]() { kravatte(K, M, 256); }, minimumTime);
+	}
+	for (unsigned int i = 1; i < lengths.size(); i++)
+	{
+		unsigned int length = lengths[i];
+		measureMode(out, "Kravatte", "Achouffe", "keystream", length, 0, [&]() { kravatte(K, N, output.data(), 8 * length); }, minimumTime);
+	}
+
+	BitString T;
+	KravatteSANE sane(K, N, T, true);
+	KravatteSANSE sanse(K);
+	KravatteWBC wbc;
+	KravatteWBCAE wbcae;
+	BitString empty;
+	for (unsigned int i = 0; i < lengths.size(); i++)
+	{
+		BitString M(input.data(), 8 * lengths[i]);
+		measureMode(out, "Kravatte", "SANE", "wrap", lengths[i], 0, [&]() { sane.wrap(empty, M); }, minimumTime);
+		measureMode(out, "Kravatte", "SANSE", "wrap", lengths[i], 0, [&]() { sanse.wrap(empty, M); }, minimumTime);
+		if (lengths[i] > 0)
+		{
+			measureMode(out, "Kravatte", "WBC", "encipher", lengths[i], 0, [&]() { wbc.encipher(K, empty, M); }, minimumTime);
+			measureMode(out, "Kravatte", "WBC", "encipher in place", lengths[i], 0, [&]() { wbc.encipher(K, empty, output.data(), lengths[i]); }, minimumTime);
+		}
+		measureMode(out, "Kravatte", "WBC-AE", "wrap", lengths[i], 0, [&]() { wbcae.wrap(K, empty, M); }, minimumTime);
+		measureMode(out, "Kravatte", "WBC-AE", "wrap in place", lengths[i], 0, [&]() { wbcae.wrap(K, empty, wrapped.data(), lengths[i]); }, minimumTime);
+	}
+	BitString P(input.data(), 8 * 16);
+	for (unsigned int i = 1; i < lengths.size(); i++)
+	{
+		BitString A(input.data(), 8 * lengths[i]);
+		measureMode(out, "Kravatte", "SANE", "wrap", 0, lengths[i], [&]() { sane.wrap(A, empty); }, minimumTime);
+		measureMode(out, "Kravatte", "SANSE", "wrap", 0, lengths[i], [&]() { sanse.wrap(A, empty); }, minimumTime);
+		measureMode(out, "Kravatte", "WBC", "encipher", 16, lengths[i], [&]() { wbc.encipher(K, A, P); }, minimumTime);
+		measureMode(out, "Kravatte", "WBC-AE", "wrap", 0, lengths[i], [&]() { wbcae.wrap(K, A, empty); }, minimumTime);
+	}
+}
@@ -564,6 +564,17 @@ static void performTestKravatte_WBC_OneInput(BitLength keyLen, BitLength dataLen
 
     Farfalle_assert(!memcmp(input,inputPrime,(dataLen + 7) / 8));
 
+	if ((dataLen & 7) == 0)
+	{
+		// The in-place interface must give the same ciphertext.
+		BitSequence block[dataByteSize];
+		memcpy(block, input, dataLen / 8);
+		kvw.encipher(BitString(key, keyLen), BitString(W, WLen), block, dataLen / 8);
+		Farfalle_assert(!memcmp(block, output, dataLen / 8));
+		kvw.decipher(BitString(key, keyLen), BitString(W, WLen), block, dataLen / 8);
+		Farfalle_assert(!memcmp(block, input, dataLen / 8));
+	}
+
 	rSpongeChecksum.absorb(output, 8 * ((dataLen + 7) / 8));
 
     #ifdef VERBOSE_WBC
@@ -762,6 +773,27 @@ static void performTestKravatte_WBC_AE_OneInput(BitLength keyLen, BitLength data
 
     Farfalle_assert(!memcmp(input,inputPrime,(dataLen + 7) / 8));
 
+	if ((dataLen & 7) == 0)
+	{
+		// The in-place interface must give the same ciphertext, and reject it once altered.
+		BitSequence buffer[dataByteSize + expansionLenWBCAE];
+		memcpy(buffer, input, dataLen / 8);
+		size_t length = kvw.wrap(BitString(key, keyLen), BitString(AD, ADLen), buffer, dataLen / 8);
+		Farfalle_assert((length == outputLen / 8) && !memcmp(buffer, output, length));
+		length = kvw.unwrap(BitString(key, keyLen), BitString(AD, ADLen), buffer, length);
+		Farfalle_assert((length == dataLen / 8) && !memcmp(buffer, input, length));
+		memcpy(buffer, output, outputLen / 8);
+		buffer[0] ^= 1;
+		bool rejected = false;
+		try {
+			kvw.unwrap(BitString(key, keyLen), BitString(AD, ADLen), buffer, outputLen / 8);
+		}
+		catch(Exception) {
+			rejected = true;
+		}
+		Farfalle_assert(rejected);
+	}
+
 	rSpongeChecksum.absorb(output, 8 * ((outputLen + 7) / 8));
 
     #ifdef VERBOSE_WBC_AE
@@ -32,20 +32,39 @@ UINT8 enc8(unsigned int x)
         return UINT8(x);
 }
 
+/** Reads the stream @a in until its end. */
+static vector<UINT8> readAll(istream& in)
+{
+    vector<UINT8> result;
+    while(hasMore(in))
+        result.push_back(in.get());
+    return result;
+}
+
+/** Reads at most @a count bytes from the stream @a in. */
+static vector<UINT8> readAtMost(istream& in, unsigned int count)
+{
+    vector<UINT8> result;
+    while(hasMore(in) && (result.size() < count))
+        result.push_back(in.get());
+    return result;
+}
+
 Piston::Piston(const Permutation *f, unsigned int Rs, unsigned int Ra)
     : f(f), Rs(Rs), Ra(Ra), OmegaC(0), OmegaI(0)
 {
     unsigned int b = f->getWidth();
     if ((b%8) != 0)
         throw Exception("b is not a multiple of 8.");
+    if (b/8 > sizeof(state))
+        throw Exception("b is larger than 1600.");
     if (((b-32)/8) >= 248)
         throw Exception("(b-32)/8 is larger or equal to 248.");
     if (Rs > Ra)
         throw Exception("Rs is larger than Ra.");
     if (Ra > ((b-32)/8))
         throw Exception("Ra is larger than (b-32)/8.");
-    state.reset(new UINT8[b/8]);
-    memset(state.get(), 0, b/8);
+    memset(state, 0, sizeof(state));
     EOM = Ra;
     CryptEnd = Ra+1;
     InjectStart = Ra+2;
@@ -58,58 +77,99 @@ Piston::Piston(const Piston& other)
         InjectStart(other.InjectStart), InjectEnd(other.InjectEnd),
         OmegaC(0), OmegaI(0)
 {
-    unsigned int b = f->getWidth();
-    state.reset(new UINT8[b/8]);
-    memcpy(state.get(), other.state.get(), b/8);
+    memcpy(state, other.state, sizeof(state));
 }
 
-void Piston::Crypt(istream& I, ostream& O, bool decryptFlag)
+void Piston::Crypt(ByteReader& I, ByteWriter& O, bool decryptFlag)
 {
-    while(hasMore(I) && (OmegaC < Rs)) {
-        UINT8 x = I.get();
-        O.put(state.get()[OmegaC] ^ x);
-        if (decryptFlag)
-            state.get()[OmegaC] = x;
-        else
-            state.get()[OmegaC] ^= x;
-        OmegaC++;
-    }
-    state.get()[CryptEnd] ^= enc8(OmegaC);
+    unsigned int count = (unsigned int)min((size_t)(Rs - OmegaC), I.remaining());
+    const UINT8 *in = I.current();
+    UINT8 *out = O.current();
+    if (decryptFlag)
+        for(unsigned int i=0; i<count; i++) {
+            out[i] = state[OmegaC+i] ^ in[i];
+            state[OmegaC+i] = in[i];
+        }
+    else
+        for(unsigned int i=0; i<count; i++) {
+            state[OmegaC+i] ^= in[i];
+            out[i] = state[OmegaC+i];
+        }
+    I.skip(count);
+    O.skip(count);
+    OmegaC += count;
+    state[CryptEnd] ^= enc8(OmegaC);
     OmegaC = 0;
     OmegaI = Rs;
 }
 
-void Piston::Inject(istream& X)
+void Piston::Crypt(istream& I, ostream& O, bool decryptFlag)
 {
-    state.get()[InjectStart] ^= enc8(OmegaI);
-    while(hasMore(X) && (OmegaI < Ra)) {
-        state.get()[OmegaI] ^= X.get();
-        OmegaI++;
-    }
-    state.get()[InjectEnd] ^= enc8(OmegaI);
+    vector<UINT8> in = readAtMost(I, Rs - OmegaC);
+    vector<UINT8> out(in.size() + 1);
+    ByteReader reader(in.data(), in.size());
+    ByteWriter writer(out.data());
+    Crypt(reader, writer, decryptFlag);
+    O.write((const char *)out.data(), writer.size());
+}
+
+void Piston::Inject(ByteReader& X)
+{
+    state[InjectStart] ^= enc8(OmegaI);
+    unsigned int count = (unsigned int)min((size_t)(Ra - OmegaI), X.remaining());
+    const UINT8 *in = X.current();
+    for(unsigned int i=0; i<count; i++)
+        state[OmegaI+i] ^= in[i];
+    X.skip(count);
+    OmegaI += count;
+    state[InjectEnd] ^= enc8(OmegaI);
     OmegaC = 0;
     OmegaI = 0;
 }
 
+void Piston::Inject(istream& X)
+{
+    vector<UINT8> in = readAtMost(X, Ra - OmegaI);
+    ByteReader reader(in.data(), in.size());
+    Inject(reader);
+}
+
 void Piston::Spark(void)
 {
-    (*f)(state.get());
+    (*f)(state);
 }
 
-void Piston::GetTag(ostream& T, unsigned int l)
+void Piston::GetTag(UINT8 *T, unsigned int l)
+{
+    MarkTag(l);
+    Spark();
+    ExtractTag(T, l);
+}
+
+void Piston::MarkTag(unsigned int l)
 {
     if (l > Rs)
         throw Exception("The requested tag is too long.");
     if (l == 0)
-        state.get()[EOM] ^= enc8(255);
+        state[EOM] ^= enc8(255);
     else
-        state.get()[EOM] ^= enc8(l);
-    Spark();
+        state[EOM] ^= enc8(l);
+}
+
+void Piston::ExtractTag(UINT8 *T, unsigned int l)
+{
     for(unsigned int i=0; i<l; i++)
-        T.put(state.get()[i]);
+        T[i] = state[i];
     OmegaC = l;
 }
 
+void Piston::GetTag(ostream& T, unsigned int l)
+{
+    vector<UINT8> tag(l + 1);
+    GetTag(tag.data(), l);
+    T.write((const char *)tag.data(), l);
+}
+
 ostream& operator<<(ostream& a, const Piston& piston)
 {
     return a << "Piston[f=" << (*piston.f) << ", Rs=" << dec << piston.Rs << ", Ra=" << piston.Ra << "]";
@@ -120,6 +180,35 @@ Engine::Engine(vector<Piston>& aPistons)
 {
 }
 
+void Engine::SparkAll(void)
+{
+    unsigned int Pi = Pistons.size();
+    if (Pi == 1) {
+        Pistons[0].Spark();
+        return;
+    }
+    // The pistons are independent between knots, so they go through the permutation together
+    unsigned int stateSize = Pistons[0].f->getWidth()/8;
+    batch.resize(Pi*stateSize);
+    for(unsigned int i=0; i<Pi; i++)
+        memcpy(&batch[i*stateSize], Pistons[i].state, stateSize);
+    Pistons[0].f->applyBatch(batch.data(), Pi);
+    for(unsigned int i=0; i<Pi; i++)
+        memcpy(Pistons[i].state, &batch[i*stateSize], stateSize);
+}
+
+void Engine::Wrap(ByteReader& I, ByteWriter& O, ByteReader& A, bool decryptFlag)
+{
+    unsigned int Pi = Pistons.size();
+    if(I.hasMore())
+        for(unsigned int i=0; i<Pi; i++)
+            Pistons[i].Crypt(I, O, decryptFlag);
+    for(unsigned int i=0; i<Pi; i++)
+        Pistons[i].Inject(A);
+    if (I.hasMore() || A.hasMore())
+        SparkAll();
+}
+
 void Engine::Wrap(istream& I, ostream& O, istream& A, bool decryptFlag)
 {
     unsigned int Pi = Pistons.size();
@@ -129,42 +218,56 @@ void Engine::Wrap(istream& I, ostream& O, istream& A, bool decryptFlag)
     for(unsigned int i=0; i<Pi; i++)
         Pistons[i].Inject(A);
     if (hasMore(I) || hasMore(A))
-        for(unsigned int i=0; i<Pi; i++)
-            Pistons[i].Spark();
+        SparkAll();
 }
 
-void Engine::GetTags(ostream& T, const vector<unsigned int>& l)
+void Engine::GetTags(UINT8 *T, const vector<unsigned int>& l)
 {
     unsigned int Pi = Pistons.size();
     for(unsigned int i=0; i<Pi; i++)
-        Pistons[i].GetTag(T, l[i]);
+        Pistons[i].MarkTag(l[i]);
+    SparkAll();
+    for(unsigned int i=0; i<Pi; i++) {
+        Pistons[i].ExtractTag(T, l[i]);
+        T += l[i];
+    }
 }
 
-void Engine::InjectCollective(istream& X, bool diversifyFlag)
+void Engine::GetTags(ostream& T, const vector<unsigned int>& l)
+{
+    unsigned int total = 0;
+    for(unsigned int i=0; i<l.size(); i++)
+        total += l[i];
+    vector<UINT8> tags(total + 1);
+    GetTags(tags.data(), l);
+    T.write((const char *)tags.data(), total);
+}
+
+void Engine::InjectCollective(const UINT8 *X, size_t length, bool diversifyFlag)
 {
     unsigned int Pi = Pistons.size();
-    stringstream *Y = new stringstream[Pi];
-    while(hasMore(X)) {
-        UINT8 x = X.get();
-        for(unsigned int i=0; i<Pi; i++)
-            Y[i].put(x);
-    }
+    vector<vector<UINT8> > Y(Pi, vector<UINT8>(X, X + length));
     if (diversifyFlag) {
         for(unsigned int i=0; i<Pi; i++) {
-            Y[i].put(enc8(Pi));
-            Y[i].put(enc8(i));
+            Y[i].push_back(enc8(Pi));
+            Y[i].push_back(enc8(i));
         }
     }
+    vector<ByteReader> readers;
     for(unsigned int i=0; i<Pi; i++)
-        Y[i].seekg(0, ios_base::beg);
-    while(hasMore(Y[0])) {
+        readers.push_back(ByteReader(Y[i].data(), Y[i].size()));
+    while(readers[0].hasMore()) {
         for(unsigned int i=0; i<Pi; i++)
-            Pistons[i].Inject(Y[i]);
-        if (hasMore(Y[0]))
-            for(unsigned int i=0; i<Pi; i++)
-                Pistons[i].Spark();
+            Pistons[i].Inject(readers[i]);
+        if (readers[0].hasMore())
+            SparkAll();
     }
-    delete[] Y;
+}
+
+void Engine::InjectCollective(istream& X, bool diversifyFlag)
+{
+    vector<UINT8> x = readAll(X);
+    InjectCollective(x.data(), x.size(), diversifyFlag);
 }
 
 ostream& operator<<(ostream& a, const Engine& engine)
@@ -179,52 +282,99 @@ Motorist::Motorist(const Permutation *f, unsigned int Pi, unsigned int W, unsign
 {
 }
 
-bool Motorist::StartEngine(istream& SUV, bool tagFlag, stringstream& T, bool decryptFlag, bool forgetFlag)
+bool Motorist::StartEngine(const UINT8 *SUV, size_t SUVlength, bool tagFlag, UINT8 *T, bool decryptFlag, bool forgetFlag)
 {
     if (phase != ready)
         throw Exception("The phase must be ready to call Motorist::StartEngine().");
-    engine.InjectCollective(SUV, true);
+    engine.InjectCollective(SUV, SUVlength, true);
     if (forgetFlag)
         MakeKnot();
     phase = riding;
     return HandleTag(tagFlag, T, decryptFlag);
 }
 
-bool Motorist::Wrap(istream& I, stringstream& O, istream& A, stringstream& T, bool decryptFlag, bool forgetFlag)
+bool Motorist::StartEngine(istream& SUV, bool tagFlag, stringstream& T, bool decryptFlag, bool forgetFlag)
+{
+    vector<UINT8> suv = readAll(SUV);
+    string expected = T.str();
+    vector<UINT8> tag(tau/8 + 1);
+    bool sizeMatches = (expected.size() == tau/8);
+    if (decryptFlag && sizeMatches)
+        memcpy(tag.data(), expected.data(), tau/8);
+    bool res = StartEngine(suv.data(), suv.size(), tagFlag, tag.data(), decryptFlag, forgetFlag);
+    if (tagFlag && decryptFlag && !sizeMatches && res) {
+        phase = failed;
+        res = false;
+    }
+    if (tagFlag && !decryptFlag)
+        T.str(string((const char *)tag.data(), tau/8));
+    return res;
+}
+
+bool Motorist::Wrap(const UINT8 *I, size_t Ilength, UINT8 *O, const UINT8 *A, size_t Alength, UINT8 *T, bool decryptFlag, bool forgetFlag)
 {
     if (phase != riding)
         throw Exception("The phase must be riding to call Motorist::Wrap().");
+    ByteReader in(I, Ilength), ad(A, Alength);
+    ByteWriter out(O);
     do {
-        engine.Wrap(I, O, A, decryptFlag);
-    } while(hasMore(I) || hasMore(A));
+        engine.Wrap(in, out, ad, decryptFlag);
+    } while(in.hasMore() || ad.hasMore());
     if ((Pi > 1) || forgetFlag)
         MakeKnot();
     bool res = HandleTag(true, T, decryptFlag);
     if (!res)
+        memset(O, 0, Ilength);
+    return res;
+}
+
+bool Motorist::Wrap(istream& I, stringstream& O, istream& A, stringstream& T, bool decryptFlag, bool forgetFlag)
+{
+    vector<UINT8> in = readAll(I), ad = readAll(A);
+    vector<UINT8> out(in.size() + 1);
+    string expected = T.str();
+    vector<UINT8> tag(tau/8 + 1);
+    bool sizeMatches = (expected.size() == tau/8);
+    if (decryptFlag && sizeMatches)
+        memcpy(tag.data(), expected.data(), tau/8);
+    bool res = Wrap(in.data(), in.size(), out.data(), ad.data(), ad.size(), tag.data(), decryptFlag, forgetFlag);
+    if (decryptFlag && !sizeMatches && res) {
+        phase = failed;
+        res = false;
+    }
+    if (res)
+        O.write((const char *)out.data(), in.size());
+    else
         O.str(string(""));
+    if (!decryptFlag)
+        T.str(string((const char *)tag.data(), tau/8));
     return res;
 }
 
+unsigned int Motorist::getTagLength() const
+{
+    return tau/8;
+}
+
 void Motorist::MakeKnot(void)
 {
-    stringstream Tprime;
-    engine.GetTags(Tprime, vector<unsigned int>(Pi, cprime/8));
-    Tprime.seekg(0, ios_base::beg);
-    engine.InjectCollective(Tprime, false);
+    vector<UINT8> Tprime(Pi*cprime/8);
+    engine.GetTags(Tprime.data(), vector<unsigned int>(Pi, cprime/8));
+    engine.InjectCollective(Tprime.data(), Tprime.size(), false);
 }
 
-bool Motorist::HandleTag(bool tagFlag, stringstream& T, bool decryptFlag)
+bool Motorist::HandleTag(bool tagFlag, UINT8 *T, bool decryptFlag)
 {
-    stringstream Tprime;
     if (!tagFlag)
-        engine.GetTags(Tprime, vector<unsigned int>(Pi, 0));
+        engine.GetTags((UINT8 *)0, vector<unsigned int>(Pi, 0));
     else {
+        vector<UINT8> Tprime(tau/8 + 1);
         vector<unsigned int> l(Pi, 0);
         l[0] = tau/8;
-        engine.GetTags(Tprime, l);
+        engine.GetTags(Tprime.data(), l);
         if (!decryptFlag)
-            T.str(Tprime.str());
-        else if (Tprime.str() != T.str()) {
+            memcpy(T, Tprime.data(), tau/8);
+        else if (memcmp(Tprime.data(), T, tau/8) != 0) {
             phase = failed;
             return false;
         }
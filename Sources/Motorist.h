@@ -25,35 +25,82 @@ http://creativecommons.org/publicdomain/zero/1.0/
 
 using namespace std;
 
+/** Read position in a byte buffer, the counterpart of istream in the buffer-based interface. */
+class ByteReader {
+protected:
+    const UINT8 *data;
+    size_t size;
+    size_t position;
+public:
+    ByteReader(const UINT8 *data, size_t size) : data(data), size(size), position(0) {}
+    bool hasMore() const { return position < size; }
+    size_t remaining() const { return size - position; }
+    const UINT8 *current() const { return data + position; }
+    void skip(size_t count) { position += count; }
+};
+
+/** Write position in a caller buffer, the counterpart of ostream in the buffer-based interface. */
+class ByteWriter {
+protected:
+    UINT8 *data;
+    size_t position;
+public:
+    ByteWriter(UINT8 *data) : data(data), position(0) {}
+    UINT8 *current() { return data + position; }
+    void skip(size_t count) { position += count; }
+    size_t size() const { return position; }
+};
+
 class Piston {
 protected:
     const Permutation *f;
-    auto_ptr<UINT8> state;
+    UINT8 state[200];
     unsigned int Rs, Ra;
     unsigned int EOM, CryptEnd, InjectStart, InjectEnd;
 	unsigned int OmegaC, OmegaI;
 public:
     Piston(const Permutation *f, unsigned int Rs, unsigned int Ra);
     Piston(const Piston& other);
+    void Crypt(ByteReader& I, ByteWriter& O, bool decryptFlag);
     void Crypt(istream& I, ostream& O, bool decryptFlag);
+    void Inject(ByteReader& X);
     void Inject(istream& X);
     void Spark(void);
+    void GetTag(UINT8 *T, unsigned int l);
     void GetTag(ostream& T, unsigned int l);
     friend ostream& operator<<(ostream& a, const Piston& piston);
+protected:
+    void MarkTag(unsigned int l);
+    void ExtractTag(UINT8 *T, unsigned int l);
+    friend class Engine;
+    friend class KeyakWrapOperation;
 };
 
 class Engine {
 protected:
     vector<Piston>& Pistons;
+    vector<UINT8> batch;
+    /** Applies the permutation onto all pistons in lockstep, see Transformation::applyBatch(). */
+    void SparkAll(void);
 public:
     Engine(vector<Piston>& Pistons);
 public:
+    void Wrap(ByteReader& I, ByteWriter& O, ByteReader& A, bool decryptFlag);
     void Wrap(istream& I, ostream& O, istream& A, bool decryptFlag);
+    void GetTags(UINT8 *T, const vector<unsigned int>& l);
     void GetTags(ostream& T, const vector<unsigned int>& l);
+    void InjectCollective(const UINT8 *X, size_t length, bool diversifyFlag);
     void InjectCollective(istream& X, bool diversifyFlag);
     friend ostream& operator<<(ostream& a, const Engine& engine);
 };
 
+/**
+  * Class implementing the Motorist mode.
+  * The methods on byte buffers are the reference ones, those on streams
+  * read their input streams until the end and call them.
+  * In the former, the tag @a T has tau/8 bytes and the output @a O
+  * as many bytes as the input @a I; it is zeroed if unwrapping fails.
+  */
 class Motorist {
 protected:
     unsigned int Pi;
@@ -66,13 +113,17 @@ protected:
     enum { ready, riding, failed } phase;
 public:
     Motorist(const Permutation *f, unsigned int Pi, unsigned int W, unsigned int c, unsigned int tau);
+    bool StartEngine(const UINT8 *SUV, size_t SUVlength, bool tagFlag, UINT8 *T, bool decryptFlag, bool forgetFlag);
     bool StartEngine(istream& SUV, bool tagFlag, stringstream& T, bool decryptFlag, bool forgetFlag);
+    bool Wrap(const UINT8 *I, size_t Ilength, UINT8 *O, const UINT8 *A, size_t Alength, UINT8 *T, bool decryptFlag, bool forgetFlag);
     bool Wrap(istream& I, stringstream& O, istream& A, stringstream& T, bool decryptFlag, bool forgetFlag);
+    unsigned int getTagLength() const;
 protected:
     void MakeKnot(void);
-    bool HandleTag(bool tagFlag, stringstream& T, bool decryptFlag);
+    bool HandleTag(bool tagFlag, UINT8 *T, bool decryptFlag);
 public:
     friend ostream& operator<<(ostream& a, const Motorist& motorist);
+    friend class KeyakWrapOperation;
 };
 
 #endif
@@ -22,10 +22,13 @@ This file defines the components for a general tree structure.
 #ifndef _TREE_
 #define _TREE_
 
+#include <functional>
 #include <iostream>
 #include <stack>
 #include <vector>
+#include "searchStatistics.h"
 #include "types.h"
+#include "workStealing.h"
 
 using namespace std;
 
@@ -66,6 +69,14 @@ protected:
 	bool empty;
 	/** Number of the current iteration. */
 	UINT64 index;
+	/** The depth of the root of the traversed (sub)tree: the iterator never goes above it. */
+	unsigned int baseDepth;
+	/** The maximum depth of the nodes visited by the iterator. */
+	unsigned int maxDepth;
+	/** Attribute that indicates that the children of the current node must not be visited. */
+	bool skipChildren;
+	/** Where to count the nodes visited and pruned per depth, or null, see setStatistics(). */
+	SearchStatistics *statistics;
 
 public:
 
@@ -82,7 +93,10 @@ public:
 		end = false;
 		initialized = false;
 		index = 0;
-		
+		baseDepth = 0;
+		maxDepth = ~0U;
+		skipChildren = false;
+		statistics = 0;
 	}
 
 	/** This method indicates whether the iterator has reached the end of the tree.
@@ -129,6 +143,124 @@ public:
 		return out;
 	}
 
+	/** This method returns the depth of the current node, i.e., its number of units.
+	*  @return The depth of the current node.
+	*/
+	unsigned int getDepth() const
+	{
+		return (unsigned int)unitList.size();
+	}
+
+	/** This method returns the cost of the current node, as given by the cost function when its highest unit was pushed.
+	* The cost of each node on the path from the root is kept, so this does not evaluate the cost function again.
+	*  @return The cost of the current node, or 0 at the root.
+	*/
+	unsigned int getCost() const
+	{
+		return cost.empty() ? 0 : cost.back();
+	}
+
+	/** This method limits the depth of the nodes visited by the iterator.
+	* The nodes at depth @a aMaxDepth are visited, but not their children.
+	*  @param aMaxDepth The maximum depth.
+	*/
+	void setMaxDepth(unsigned int aMaxDepth)
+	{
+		maxDepth = aMaxDepth;
+	}
+
+	/** This method sets where to count the events of the traversal, per depth given by getDepth():
+	* the nodes visited, the candidate units considered as children,
+	* and those pruned by the cost function or as not canonical.
+	* The iterators copied from this one, e.g., by subtree() or split(), count in the same object,
+	* so they must be given their own when used in other threads.
+	*  @param aStatistics The object to count in, or null not to count.
+	*/
+	void setStatistics(SearchStatistics *aStatistics)
+	{
+		statistics = aStatistics;
+	}
+
+	/** This method returns an iterator over the descendants of the current node,
+	* with the same unit set, cost function and maximum cost.
+	* The current node becomes the root of the returned iterator, which is not part of its traversal.
+	*  @param aMaxDepth The maximum depth of the nodes visited by the returned iterator.
+	*  @return The iterator over the subtree.
+	*/
+	GenericTreeIterator subtree(unsigned int aMaxDepth = ~0U) const
+	{
+		GenericTreeIterator sub(*this);
+		sub.baseDepth = getDepth();
+		sub.maxDepth = aMaxDepth;
+		sub.skipChildren = false;
+		sub.initialized = false;
+		sub.end = false;
+		sub.index = 0;
+		return sub;
+	}
+
+	/** This method appends to @a cursor the unit list of the current node,
+	* e.g., to save it in a SearchCheckpoint.
+	* The units are appended with the function appendToCursor(), which must be defined for the type Unit.
+	* The cursor is empty if the traversal has not reached its first node yet.
+	* @param cursor The cursor to append to.
+	*/
+	void getCursor(vector<UINT64>& cursor) const
+	{
+		if (initialized && !end)
+			for (unsigned int i = 0; i < unitList.size(); i++)
+				appendToCursor(cursor, unitList[i]);
+	}
+
+	/** This method moves the iterator to the node given by @a cursor, as obtained from getCursor()
+	* with an iterator over the same tree. The traversal then continues after that node,
+	* so the node itself must not be output again.
+	* The units are read with the function readFromCursor(), which must be defined for the type Unit.
+	* @param cursor The cursor.
+	*/
+	void resume(const vector<UINT64>& cursor)
+	{
+		while (pop());
+		size_t position = 0;
+		while (position < cursor.size()) {
+			Unit unit;
+			readFromCursor(cursor, position, unit);
+			push(unit);
+		}
+		index = 0;
+		initialized = !unitList.empty();
+		end = false;
+		empty = false;
+		skipChildren = false;
+	}
+
+	/** This method indicates whether split() can be called.
+	*  @return True if the current node is below the root of the traversed (sub)tree.
+	*/
+	bool canSplit()
+	{
+		return initialized && !end && (getDepth() > baseDepth);
+	}
+
+	/** This method splits the remaining traversal in two parts.
+	* Let N be the ancestor of the current node (or the current node itself) just below
+	* the root of the traversed (sub)tree. After the call, this iterator only visits
+	* the remaining descendants of N, while the returned iterator is positioned at N,
+	* and visits the next siblings of N and their descendants after its first increment.
+	* The two iterators can be used independently, e.g., in different threads.
+	*  @pre canSplit() must be true.
+	*  @return The iterator over the remaining siblings of N.
+	*/
+	GenericTreeIterator split()
+	{
+		GenericTreeIterator rest(*this);
+		while (rest.getDepth() > baseDepth + 1)
+			rest.pop();
+		rest.skipChildren = true;
+		baseDepth++;
+		return rest;
+	}
+
 private:
 
 	/** This method initializes the iterator.
@@ -160,7 +292,9 @@ private:
 	*/
 	bool next()
 	{
-		if (toChild())
+		if (skipChildren)
+			skipChildren = false;
+		else if (toChild())
 			return true;
 		do{
 			if (toSibling())
@@ -176,11 +310,13 @@ private:
 	*/
 	bool toChild()
 	{
+		if (unitList.size() >= maxDepth)
+			return false;
 		try {
 			Unit newUnit = unitSet.getFirstChildUnit(unitList,cache);
 			if (canAfford(newUnit)) {
 				push(newUnit);
-				if (cost.back() <= maxCost && isCanonical())
+				if (isAcceptable())
 					return true;
 				else{
 					if (iterateHighestUnit())
@@ -197,7 +333,7 @@ private:
 						unitSet.iterateUnit(unitList, newUnit,cache);
 					} while (!canAfford(newUnit));
 					push(newUnit);
-					if (cost.back() <= maxCost && isCanonical())
+					if (isAcceptable())
 						return true;
 					pop();
 				} while (true);
@@ -214,7 +350,7 @@ private:
 	*/
 	bool toSibling()
 	{
-		if (unitList.empty())
+		if (unitList.size() <= baseDepth)
 			return false;
 		else
 			return iterateHighestUnit();
@@ -226,7 +362,7 @@ private:
 	*/
 	bool toParent()
 	{
-		if (unitList.empty())
+		if (unitList.size() <= baseDepth)
 			return false;
 		else
 			return pop();
@@ -252,7 +388,7 @@ private:
 			} while (!canAfford(lastUnit));
 
 			push(lastUnit);
-			if (cost.back() <= maxCost && isCanonical())
+			if (isAcceptable())
 				return true;
 			pop();
 		} while (true);
@@ -303,14 +439,158 @@ private:
 		return unitSet.isCanonical(unitList, cache);
 	}
 
+	/** This method checks if the node just pushed can be visited,
+	* i.e., if its cost is within the maximum cost and if it is canonical.
+	* @return true if the node can be visited, false otherwise.
+	*/
+	bool isAcceptable()
+	{
+		if (cost.back() > maxCost) {
+			countSearchEvent(statistics, SearchStatistics::prunedByCost, getDepth());
+			return false;
+		}
+		if (!isCanonical()) {
+			countSearchEvent(statistics, SearchStatistics::prunedByCanonicity, getDepth());
+			return false;
+		}
+		countSearchEvent(statistics, SearchStatistics::nodesVisited, getDepth());
+		return true;
+	}
+
 	/** This method checks if the addition of a new unit is affordable depending on the cost.
 	* @return true if it is affordable, false otherwise.
 	*/
 	bool canAfford(Unit& newUnit)
 	{
-		return costFunction.canAfford(unitList, cache, newUnit, maxCost, cost);
+		countSearchEvent(statistics, SearchStatistics::childrenGenerated, getDepth() + 1);
+		if (costFunction.canAfford(unitList, cache, newUnit, maxCost, cost))
+			return true;
+		countSearchEvent(statistics, SearchStatistics::prunedByCost, getDepth() + 1);
+		return false;
+	}
+
+};
+
+/**
+* \brief ParallelTreeTraversal class : Traversal of a tree spread over several threads.
+*
+* \details This class visits all the nodes of a tree, as GenericTreeIterator does, but with a pool of threads.
+* The nodes up to a given split depth are enumerated by a single iterator,
+* and the subtrees rooted at the nodes of the split depth are handed to the workers.
+* When some workers are idle, a worker splits the remaining part of its subtree
+* and spawns it, so that they can steal it.
+* All the iterators share the unit set, the cost function and the maximum cost,
+* so each worker prunes its subtree exactly as the sequential traversal does.
+* The order in which the nodes are visited is not specified.
+*/
+template<class Iterator, class OutputRepresentation>
+class ParallelTreeTraversal {
+public:
+	/** The type of the function called for each node, with the index of the worker that visits it. */
+	typedef function<void(const OutputRepresentation& node, unsigned int worker)> Visitor;
+protected:
+	/** The pool of threads. */
+	WorkStealingPool pool;
+	/** The depth at which the subtrees are handed to the workers. */
+	unsigned int splitDepth;
+	/** The number of nodes visited by a worker between two checks for idle workers. */
+	unsigned int grain;
+	/** Where to add the events counted by the workers, or null, see setStatistics(). */
+	SearchStatistics *statistics;
+	/** The events counted by each worker, and by the enumeration of the subtrees as the last entry. */
+	vector<SearchStatistics> workerStatistics;
+public:
+	/** The constructor.
+	* @param aNrThreads The number of threads, or 0 to use the number of hardware threads.
+	* @param aSplitDepth The depth at which the subtrees are handed to the workers.
+	* @param aGrain The number of nodes visited by a worker between two checks for idle workers.
+	*/
+	ParallelTreeTraversal(unsigned int aNrThreads = 0, unsigned int aSplitDepth = 2, unsigned int aGrain = 256)
+		: pool(aNrThreads), splitDepth(aSplitDepth > 0 ? aSplitDepth : 1), grain(aGrain > 0 ? aGrain : 1), statistics(0)
+	{
+	}
+
+	/** This method sets where to add the events of the traversals, see GenericTreeIterator::setStatistics().
+	* Each worker counts in its own object, which are added to @a aStatistics at the end of run().
+	* @param aStatistics The object to add the counts to, or null not to count.
+	*/
+	void setStatistics(SearchStatistics *aStatistics)
+	{
+		statistics = aStatistics;
+	}
+
+	/** This method returns the number of threads.
+	* @return The number of threads.
+	*/
+	unsigned int getNumberOfThreads() const
+	{
+		return pool.getNumberOfThreads();
+	}
+
+	/** This method visits all the nodes of the tree traversed by @a iterator.
+	* The visitor can be called from several threads at the same time.
+	* @param iterator An iterator at the beginning of the tree, which is left untouched.
+	* @param visitor The function called for each node.
+	*/
+	void run(const Iterator& iterator, const Visitor& visitor)
+	{
+		workerStatistics.assign(statistics != 0 ? pool.getNumberOfThreads() + 1 : 0, SearchStatistics());
+		Iterator top(iterator.subtree(splitDepth));
+		top.setStatistics(getWorkerStatistics(pool.getNumberOfThreads()));
+		pool.run([&](WorkStealingPool::Task& task) -> bool {
+			if (top.isEnd())
+				return false;
+			if (top.getDepth() < splitDepth) {
+				OutputRepresentation node(*top);
+				task = [node, &visitor](unsigned int worker) { visitor(node, worker); };
+			}
+			else {
+				Iterator sub(top);
+				task = [this, sub, &visitor](unsigned int worker) {
+					Iterator i(sub);
+					i.setStatistics(getWorkerStatistics(worker));
+					visitor(*i, worker);
+					Iterator descendants(i.subtree());
+					traverse(descendants, visitor, worker);
+				};
+			}
+			++top;
+			return true;
+		});
+		for (unsigned int i = 0; i < workerStatistics.size(); i++)
+			statistics->add(workerStatistics[i]);
+	}
+
+protected:
+	/** This method visits the nodes of @a i, and spawns part of them when some workers are idle.
+	* @param i The iterator to traverse.
+	* @param visitor The function called for each node.
+	* @param worker The index of the calling worker.
+	*/
+	void traverse(Iterator& i, const Visitor& visitor, unsigned int worker)
+	{
+		i.setStatistics(getWorkerStatistics(worker));
+		unsigned int count = 0;
+		for (; !i.isEnd(); ++i) {
+			visitor(*i, worker);
+			if ((++count >= grain) && pool.isHungry() && i.canSplit()) {
+				count = 0;
+				Iterator rest(i.split());
+				pool.spawn(worker, [this, rest, &visitor](unsigned int aWorker) {
+					Iterator j(rest);
+					j.setStatistics(getWorkerStatistics(aWorker));
+					++j;
+					traverse(j, visitor, aWorker);
+				});
+			}
+		}
 	}
 
+	/** This method returns the object in which a worker counts, or null if not counting. */
+	SearchStatistics *getWorkerStatistics(unsigned int worker)
+	{
+		return workerStatistics.empty() ? 0 : &workerStatistics[worker];
+	}
 };
 
 #endif
@@ -15,6 +15,7 @@
  */
 
 #include <sstream>
+#include <string.h>
 #include <string>
 #include <vector>
 #include "bitstring.h"
@@ -45,6 +46,117 @@ static void Farfalle_assert(bool condition, const string &synopsis, const char *
 #define assert(cond, msg)  Farfalle_assert(cond, msg, __FUNCTION__)
 #endif
 
+BitStringBytes::BitStringBytes(size_t size, UINT8 byte)
+    : n(0), capacity(sizeof(inlineBuffer)), p((UINT8 *)inlineBuffer)
+{
+    reserve(size);
+    memset(p, byte, size);
+    n = size;
+}
+
+BitStringBytes::BitStringBytes(const UINT8 *first, const UINT8 *last)
+    : n(0), capacity(sizeof(inlineBuffer)), p((UINT8 *)inlineBuffer)
+{
+    assign(first, last);
+}
+
+BitStringBytes::BitStringBytes(const BitStringBytes &other)
+    : n(0), capacity(sizeof(inlineBuffer)), p((UINT8 *)inlineBuffer)
+{
+    assign(other.begin(), other.end());
+}
+
+BitStringBytes::BitStringBytes(BitStringBytes &&other) noexcept
+    : n(0), capacity(sizeof(inlineBuffer)), p((UINT8 *)inlineBuffer)
+{
+    *this = std::move(other);
+}
+
+BitStringBytes::~BitStringBytes()
+{
+    if ( !isInline() ) {
+        delete[] p;
+    }
+}
+
+BitStringBytes &BitStringBytes::operator=(const BitStringBytes &other)
+{
+    if ( this != &other ) {
+        assign(other.begin(), other.end());
+    }
+    return *this;
+}
+
+BitStringBytes &BitStringBytes::operator=(BitStringBytes &&other) noexcept
+{
+    if ( this == &other ) {
+        return *this;
+    }
+    if ( other.isInline() ) {                                        // Small strings are simply copied
+        if ( !isInline() && (capacity < other.n) ) {
+            delete[] p;
+            p        = (UINT8 *)inlineBuffer;
+            capacity = sizeof(inlineBuffer);
+        }
+        memcpy(p, other.p, other.n);
+        n = other.n;
+    }
+    else {                                                           // Large strings are stolen
+        if ( !isInline() ) {
+            delete[] p;
+        }
+        p              = other.p;
+        capacity       = other.capacity;
+        n              = other.n;
+        other.p        = (UINT8 *)other.inlineBuffer;
+        other.capacity = sizeof(other.inlineBuffer);
+    }
+    other.n = 0;
+    return *this;
+}
+
+void BitStringBytes::reserve(size_t newCapacity)
+{
+    if ( newCapacity <= capacity ) {
+        return;
+    }
+    if ( newCapacity < 2 * capacity ) {
+        newCapacity = 2 * capacity;
+    }
+    UINT8 *newP = new UINT8[newCapacity];
+    memcpy(newP, p, n);
+    if ( !isInline() ) {
+        delete[] p;
+    }
+    p        = newP;
+    capacity = newCapacity;
+}
+
+void BitStringBytes::assign(const UINT8 *first, const UINT8 *last)
+{
+    size_t size = last - first;
+    if ( size > capacity ) {                                         // No need to keep the current content
+        n = 0;
+        reserve(size);
+    }
+    memmove(p, first, size);
+    n = size;
+}
+
+void BitStringBytes::resize(size_t size)
+{
+    if ( size > n ) {
+        reserve(size);
+        memset(p + n, 0, size - n);
+    }
+    n = size;
+}
+
+bool operator==(const BitStringBytes &A, const BitStringBytes &B)
+{
+    return (A.n == B.n) && (memcmp(A.p, B.p, A.n) == 0);
+}
+
 void BitString::truncateLastByte(void)
 {
     if ( vSize % 8 ) {
@@ -69,7 +181,7 @@ BitString::~BitString()
 }
 
 BitString::BitString(unsigned int bit)
-    : vSize(1), v(1, bit), alias(NULL)
+    : vSize(1), v(1, (UINT8)bit), alias(NULL)
 {
     assert((0 == bit) || (1 == bit), "bit must be 0 or 1.");
 }
@@ -83,18 +195,18 @@ BitString::BitString(unsigned int size, UINT8 byte)
 BitString::BitString(string &s)
     : vSize(s.size() * 8), v(), alias(&s)
 {
-    v.assign(s.c_str(), s.c_str() + s.size());
+    v.assign((const UINT8 *)s.data(), (const UINT8 *)s.data() + s.size());
 }
 
 BitString::BitString(const string &s)
     : vSize(s.size() * 8), v(), alias(NULL)
 {
-    v.assign(s.c_str(), s.c_str() + s.size());
+    v.assign((const UINT8 *)s.data(), (const UINT8 *)s.data() + s.size());
 }
 
 BitString::BitString(const string &s, unsigned int index, unsigned int size)
     : vSize((index >= s.size() * 8) ? 0 : (size + index <= s.size() * 8) ? size : s.size() * 8 - index),
-    v(s.begin() + index / 8, s.begin() + index / 8 + ((vSize) + 7) / 8), // vSize must be initialized first! (better enable -Wreorder)
+    v((const UINT8 *)s.data() + index / 8, (const UINT8 *)s.data() + index / 8 + ((vSize) + 7) / 8), // vSize must be initialized first! (better enable -Wreorder)
     alias(NULL)
 {
     assert((index % 8) == 0, "This implementation only supports index that are multiple of 8.");
@@ -105,6 +217,18 @@ BitString::BitString(const BitString &S)
     : vSize(S.vSize), v(S.v), alias(NULL)                            // We don't copy the alias
 {}
 
+BitString::BitString(BitString &&S) noexcept
+    : vSize(S.vSize), v(), alias(NULL)                               // Nor do we move it
+{
+    if ( S.alias ) {                                                 // S must keep its content for its string
+        v = S.v;
+    }
+    else {
+        v       = std::move(S.v);
+        S.vSize = 0;
+    }
+}
+
 BitString::BitString(const BitString &S, unsigned int index, unsigned int size)
     : vSize((index >= S.vSize) ? 0 : (size + index <= S.vSize) ? size : S.vSize - index),
     v(S.v.begin() + index / 8, S.v.begin() + index / 8 + ((vSize) + 7) / 8),
@@ -115,7 +239,7 @@ BitString::BitString(const BitString &S, unsigned int index, unsigned int size)
 }
 
 BitString::BitString(const vector<UINT8> &v)
-    : vSize(v.size() * 8), v(v), alias(NULL)
+    : vSize(v.size() * 8), v(v.data(), v.data() + v.size()), alias(NULL)
 {}
 
 BitString::BitString(const UINT8 *s, unsigned int size)
@@ -130,12 +254,12 @@ string BitString::str() const
 UINT8 *BitString::array()
 {
     assert((vSize % 8) == 0, "Can't get array if BitString length is not a multiple of 8."); // Because caller may modify the array and break the invariant
-    return &v[0];
+    return v.data();
 }
 
 const UINT8 *BitString::array() const
 {
-    return &v[0];
+    return v.data();
 }
 
 unsigned int BitString::size() const
@@ -228,70 +352,151 @@ BitString &BitString::operator=(const BitString &A)
     return *this;
 }
 
-bool operator==(const BitString &A, const BitString &B)
+BitString &BitString::operator=(BitString &&A)
 {
-    return (A.vSize == B.vSize) && (A.v == B.v);
+    if ( (this != &A) && A.alias ) {                                 // A must keep its content for its string
+        vSize = A.vSize;
+        v     = A.v;
+    }
+    else if ( this != &A ) {
+        vSize   = A.vSize;
+        v       = std::move(A.v);
+        A.vSize = 0;
+    }
+    syncAlias();
+    return *this;
 }
 
-BitString operator||(const BitString &A, unsigned int bit)
+BitString &BitString::operator^=(const BitString &A)
 {
-    assert((0 == bit) || (1 == bit), "bit must be 0 or 1.");
+    assert(vSize == A.vSize, "Cannot xor two BitString of different size.");
 
-    BitString  Z(A);
-    Z.v.resize((Z.vSize + 8) / 8);
-    Z.v[Z.vSize / 8] |= bit << (Z.vSize % 8);
-    Z.vSize++;
-
-    return Z;
+    UINT8       *z = v.data();
+    const UINT8 *a = A.v.data();
+    for ( size_t i = 0; i < v.size(); i++ ) {
+        z[i] ^= a[i];
+    }
+    syncAlias();
+    return *this;
 }
 
-BitString operator||(const BitString &A, const BitString &B)
+BitString &BitString::append(unsigned int bit)
 {
-    // Allocate C
-    BitString  C(A.vSize + B.vSize, 0);
+    assert((0 == bit) || (1 == bit), "bit must be 0 or 1.");
+
+    v.resize((vSize + 8) / 8);
+    v[vSize / 8] |= bit << (vSize % 8);
+    vSize++;
+    syncAlias();
+    return *this;
+}
 
-    // Copy A into C
-    copy(A.v.begin(), A.v.end(), C.v.begin());
+BitString &BitString::append(const BitString &B)
+{
+    if ( &B == this ) {
+        BitString copyOfB(B);
+        return append(copyOfB);
+    }
 
-    // Append B to C, starting from index A.vSize -- do it fast if possible, possibly with overflow
-    if ((A.vSize % 8) == 0 ) {
-        C.overwrite(B, A.vSize);
+    // Append B starting from index vSize -- do it fast if possible
+    unsigned int nbits  = (vSize % 8);
+    size_t       offset = (vSize / 8);
+    vSize += B.vSize;
+    v.resize((vSize + 7) / 8);
+    if ( nbits == 0 ) {
+        copy(B.v.begin(), B.v.end(), v.begin() + offset);
     }
     else {
-        // There are (A.vSize%8) bits in last byte -- append with shift -- TODO: fast copy with 32-bit
-        vector<UINT8>::iterator  c     = C.v.begin() + (A.vSize / 8);
-        unsigned int             nbits = (A.vSize % 8);
-        UINT8                    last  = *c & ((1 << (nbits)) - 1);  // last = -----xxx
+        // There are nbits bits in last byte -- append with shift
+        UINT8 *c    = v.begin() + offset;
+        UINT8  last = *c & ((1 << (nbits)) - 1);                     // last = -----xxx
 
-        for ( vector<UINT8>::const_iterator b = B.v.begin(); b != B.v.end();) {
+        for ( const UINT8 *b = B.v.begin(); b != B.v.end();) {
             *(c++) = last | (*b << nbits);                           // *c   = -----xxx | xxxxx---
             last   = *(b++) >> (8 - nbits);                          // last = -----xxx
         }
 
-        if ( c != C.v.end()) {
+        if ( c != v.end()) {
             *(c++) = last;
         }
     }
+    truncateLastByte();
+    syncAlias();
+    return *this;
+}
+
+bool operator==(const BitString &A, const BitString &B)
+{
+    return (A.vSize == B.vSize) && (A.v == B.v);
+}
+
+BitString operator||(const BitString &A, unsigned int bit)
+{
+    BitString  Z(A);
+    Z.append(bit);
+    return Z;
+}
+
+// The overloads on rvalues reuse the storage of the temporaries, unless they are bound to a string
+
+BitString operator||(BitString &&A, unsigned int bit)
+{
+    if ( A.alias ) {
+        return static_cast<const BitString &>(A) || bit;
+    }
+    A.append(bit);
+    return std::move(A);
+}
 
+BitString operator||(const BitString &A, const BitString &B)
+{
+    BitString  C(A);
+    C.append(B);
     return C;
 }
 
+BitString operator||(BitString &&A, const BitString &B)
+{
+    if ( A.alias ) {
+        return static_cast<const BitString &>(A) || B;
+    }
+    A.append(B);
+    return std::move(A);
+}
+
 BitString operator^(const BitString &A, const BitString &B)
 {
-    assert(A.vSize == B.vSize, "Cannot xor two BitString of different size.");
+    BitString  Z(A);
+    Z ^= B;
+    return Z;
+}
 
-    BitString                Z(A.vSize, (UINT8)0);
-    vector<UINT8>::iterator  z = Z.v.begin();
-    for ( vector<UINT8>::const_iterator a = A.v.begin(), b = B.v.begin(); a != A.v.end(); ++a, ++b, ++z ) {
-        *z = *a ^ *b;
+BitString operator^(BitString &&A, const BitString &B)
+{
+    if ( A.alias ) {
+        return static_cast<const BitString &>(A) ^ B;
     }
+    A ^= B;
+    return std::move(A);
+}
 
-    return Z;
+BitString operator^(const BitString &A, BitString &&B)
+{
+    if ( B.alias ) {
+        return A ^ static_cast<const BitString &>(B);
+    }
+    B ^= A;
+    return std::move(B);
+}
+
+BitString operator^(BitString &&A, BitString &&B)
+{
+    return std::move(A) ^ static_cast<const BitString &>(B);
 }
 
 ostream &operator<<(ostream &os, const BitString &S)
 {
-    for ( vector<UINT8>::const_iterator i = S.v.begin(); i != S.v.end();) {
+    for ( const UINT8 *i = S.v.begin(); i != S.v.end();) {
         os.width(2);
         os.fill('0');
         os << hex << ((int)UINT8(*i));
@@ -350,16 +555,14 @@ BitStrings operator*(const BitString &A, const BitString &B)
 }
 
 Block::Block(BitString &S, unsigned int index, unsigned int r)
-    : B(S), alias(S), index(index), r(r)
+    : B(&S), alias(S), index(index), r(r)
 {
     assert(0 < r,             "r must be positive.");
     assert(index <= S.size(), "index must be less than or equal to bit string size.");
 }
 
-static BitString  dummy; // Not nice but nobody will notice
-
 Block::Block(const BitString &S, unsigned int index, unsigned int r)
-    : B(dummy), alias(S), index(index), r(r)
+    : B(NULL), alias(S), index(index), r(r)
 {
     assert(0 < r,             "r must be positive.");
     assert(index <= S.size(), "index must be less than or equal to bit string size.");
@@ -367,15 +570,46 @@ Block::Block(const BitString &S, unsigned int index, unsigned int r)
 
 Block &Block::operator=(const BitString &S)
 {
+    assert(B != NULL,     "Block is not mutable.");
     assert(S.size() <= r, "String size must be less than or equal to block size.");
-    B.overwrite(S, index);
+    B->overwrite(S, index);
 
     return *this;
 }
 
 Block::operator BitString() const
 {
-    return BitString(alias, index, r);
+    if ( isByteAligned() ) {
+        return BitString(alias, index, r);
+    }
+
+    // Shift the bytes of the block down to a byte boundary, reading only the block itself
+    unsigned int  blockSize = size();
+    unsigned int  shift     = index % 8;
+    const UINT8 * src       = alias.array() + index / 8;
+    unsigned int  srcBytes  = (shift + blockSize + 7) / 8;
+    vector<UINT8> bytes((blockSize + 7) / 8 + 1, 0);
+    for ( unsigned int i = 0; i < bytes.size() - 1; ++i ) {
+        bytes[i] = src[i] >> shift;
+        if ( i + 1 < srcBytes ) {
+            bytes[i] |= src[i + 1] << (8 - shift);
+        }
+    }
+    if ( blockSize % 8 ) {
+        bytes[blockSize / 8] &= (1 << (blockSize % 8)) - 1;
+    }
+    return BitString(bytes.data(), blockSize);
+}
+
+bool Block::isByteAligned() const
+{
+    return (index % 8) == 0;
+}
+
+const UINT8 *Block::data() const
+{
+    assert(isByteAligned(), "The block must start on a byte boundary.");
+    return alias.array() + index / 8;
 }
 
 unsigned int Block::size() const
@@ -389,15 +623,15 @@ ostream &operator<<(ostream &os, const Block &B)
 }
 
 Blocks::Blocks(unsigned int r)
-    : alias(B), const_alias(B), r(r)
+    : alias(&B), const_alias(B), r(r)
 {}
 
 Blocks::Blocks(BitString &S, unsigned int r)
-    : B(S), alias(S), const_alias(S), r(r)
+    : alias(&S), const_alias(S), r(r)
 {}
 
 Blocks::Blocks(const BitString &S, unsigned int r)
-    : B(S), alias(B), const_alias(S), r(r)                           // B(S) done to allow using non-const operator[]
+    : alias(NULL), const_alias(S), r(r)
 {}
 
 unsigned int Blocks::size() const
@@ -412,7 +646,10 @@ BitString Blocks::bits() const
 
 Block Blocks::operator[](unsigned int i)
 {
-    return Block(alias, i * r, r);
+    if ( alias == NULL ) {
+        return Block(const_alias, i * r, r);
+    }
+    return Block(*alias, i * r, r);
 }
 
 Block Blocks::operator[](unsigned int i) const
@@ -22,13 +22,53 @@
 
 using namespace std;
 
+/**
+ * Class implementing the byte storage of a BitString, as a minimal
+ * replacement for vector<UINT8> that keeps up to 1600 bits inline,
+ * so that the bit strings the size of a Keccak-p state need no heap allocation
+ */
+class BitStringBytes {
+protected:
+    static const size_t inlineWords = 25;
+    size_t         n;                                                // number of bytes
+    size_t         capacity;                                         // number of bytes available at p
+    UINT8 *        p;                                                // points to inlineBuffer or to a heap buffer
+    UINT64         inlineBuffer[inlineWords];                        // UINT64 so that the bytes can be read as lanes
+    bool  isInline(void) const { return p == (const UINT8 *)inlineBuffer; }
+    void  reserve(size_t newCapacity);
+public:
+    BitStringBytes() : n(0), capacity(sizeof(inlineBuffer)), p((UINT8 *)inlineBuffer) {}
+    BitStringBytes(size_t size, UINT8 byte);
+    BitStringBytes(const UINT8 *first, const UINT8 *last);
+    BitStringBytes(const BitStringBytes &other);
+    BitStringBytes(BitStringBytes &&other) noexcept;
+    ~BitStringBytes();
+    BitStringBytes &  operator=(const BitStringBytes &other);
+    BitStringBytes &  operator=(BitStringBytes &&other) noexcept;
+    void              assign(const UINT8 *first, const UINT8 *last);
+    void              resize(size_t size);                           // new bytes are set to zero
+    size_t            size() const { return n; }
+    UINT8 *           data() { return p; }
+    const UINT8 *     data() const { return p; }
+    UINT8 *           begin() { return p; }
+    const UINT8 *     begin() const { return p; }
+    UINT8 *           end() { return p + n; }
+    const UINT8 *     end() const { return p + n; }
+    UINT8 &           operator[](size_t i) { return p[i]; }
+    const UINT8 &     operator[](size_t i) const { return p[i]; }
+    UINT8 &           back() { return p[n - 1]; }
+    friend bool       operator==(const BitStringBytes &A, const BitStringBytes &B);
+};
+
+bool                  operator==(const BitStringBytes &A, const BitStringBytes &B);
+
 /**
  * Class implementing a simple bit string
  */
 class BitString {
 protected:
     unsigned int   vSize;                                            // size in bits -- invariant: v.size() == (vSize+7)/8
-    vector<UINT8>  v;                                                // vector storing bytes -- invariant: if (vSize%8), then (v[vSize/8] >> (vSize%8)) == 0
+    BitStringBytes v;                                                // bytes -- invariant: if (vSize%8), then (v[vSize/8] >> (vSize%8)) == 0
     string *       alias;
     void  truncateLastByte(void);
     void  syncAlias(void);
@@ -41,6 +81,7 @@ public:
     BitString(const string &s);
     BitString(const string &s, unsigned int index, unsigned int size);
     BitString(const BitString &S);
+    BitString(BitString &&S) noexcept;
     BitString(const BitString &S, unsigned int index, unsigned int size);
     BitString(const vector<UINT8> &v);
     BitString(const UINT8 *s, unsigned int size);
@@ -57,17 +98,31 @@ public:
     BitString &       truncate(unsigned int size);
     BitString &       overwrite(const BitString &S, unsigned int index);
     BitString &       operator=(const BitString &A);
+    BitString &       operator=(BitString &&A);
+    BitString &       operator^=(const BitString &A);                // In place, A must have the same size
+    BitString &       append(unsigned int bit);                      // In place, same as *this = *this || bit
+    BitString &       append(const BitString &B);                    // In place, same as *this = *this || B
     friend bool       operator==(const BitString &A, const BitString &B);
     friend BitString  operator||(const BitString &A, unsigned int bit);
+    friend BitString  operator||(BitString &&A, unsigned int bit);
     friend BitString  operator||(const BitString &A, const BitString &B);
+    friend BitString  operator||(BitString &&A, const BitString &B);
     friend BitString  operator^(const BitString &A, const BitString &B);
+    friend BitString  operator^(BitString &&A, const BitString &B);
+    friend BitString  operator^(const BitString &A, BitString &&B);
+    friend BitString  operator^(BitString &&A, BitString &&B);
     friend ostream &  operator<<(ostream &os, const BitString &S);
 };
 
 bool                  operator==(const BitString &A, const BitString &B);
 BitString             operator||(const BitString &A, unsigned int bit);
+BitString             operator||(BitString &&A, unsigned int bit);       // The overloads on rvalues reuse the storage of the temporaries
 BitString             operator||(const BitString &A, const BitString &B);
+BitString             operator||(BitString &&A, const BitString &B);
 BitString             operator^(const BitString &A, const BitString &B);
+BitString             operator^(BitString &&A, const BitString &B);
+BitString             operator^(const BitString &A, BitString &&B);
+BitString             operator^(BitString &&A, BitString &&B);
 ostream &             operator<<(ostream &os, const BitString &S);
 
 /**
@@ -95,16 +150,18 @@ BitStrings operator*(const BitString &A, const BitString &B);
  */
 class Block {
 protected:
-    BitString &      B;
-    const BitString &alias;                                          // Block is mutable if &B == &alias
+    BitString *      B;                                              // Block is mutable if B != NULL, then B == &alias
+    const BitString &alias;
     unsigned int     index;
     unsigned int     r;
 public:
     Block(BitString &S, unsigned int index, unsigned int r);
     Block(const BitString &S, unsigned int index, unsigned int r);
-    Block &         operator=(const BitString &S);
+    Block &         operator=(const BitString &S);                   // In place in the underlying string
     operator BitString() const;
     unsigned int    size() const;
+    bool            isByteAligned() const;                           // True if the block starts on a byte boundary
+    const UINT8 *   data() const;                                    // Bytes of the block, without copy -- only if isByteAligned()
     friend ostream &operator<<(ostream &os, const Block &B);
 };
 
@@ -116,13 +173,13 @@ ostream &           operator<<(ostream &os, const Block &B);
 class Blocks {
 protected:
     BitString        B;
-    BitString &      alias;
-    const BitString &const_alias;                                    // Block is mutable if &alias == &const_alias
+    BitString *      alias;                                          // Blocks are mutable if alias != NULL, then alias == &const_alias
+    const BitString &const_alias;
     unsigned int     r;
 public:
     Blocks(unsigned int r);                                          // Use internal BitString for storage
     Blocks(BitString &S, unsigned int r);                            // Use given BitString for storage
-    Blocks(const BitString &S, unsigned int r);                      // Idem, but not mutable
+    Blocks(const BitString &S, unsigned int r);                      // Idem, but not mutable and without copy of S
     unsigned int    size() const;
     BitString       bits() const;
     Block           operator[](unsigned int i);
@@ -0,0 +1,135 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "checkpoint.h"
+
+static const string checkpointHeader = "KeccakTools search checkpoint";
+
+SearchCheckpoint::SearchCheckpoint(const string& aFileName, const string& aDescription, unsigned int aInterval)
+    : fileName(aFileName), description(aDescription), interval(aInterval),
+    lastSave(time(0)), resuming(false), outputSize(0), output(0)
+{
+    load();
+}
+
+bool SearchCheckpoint::isResuming() const
+{
+    return resuming;
+}
+
+const vector<UINT64>& SearchCheckpoint::getCursor() const
+{
+    return cursor;
+}
+
+void SearchCheckpoint::load()
+{
+    ifstream fin(fileName.c_str());
+    if (!fin)
+        return;
+    string header, aDescription, keyword;
+    getline(fin, header);
+    getline(fin, aDescription);
+    if (header != checkpointHeader)
+        throw CheckpointException("The file " + fileName + " is not a checkpoint.");
+    if (aDescription != description)
+        throw CheckpointException("The checkpoint " + fileName + " was made for another search: " + aDescription);
+    UINT64 size, nrValues;
+    fin >> keyword >> size;
+    if (keyword != "output")
+        throw CheckpointException("The checkpoint " + fileName + " is corrupted.");
+    fin >> keyword >> nrValues;
+    if (keyword != "cursor")
+        throw CheckpointException("The checkpoint " + fileName + " is corrupted.");
+    vector<UINT64> aCursor(nrValues);
+    for(UINT64 i=0; i<nrValues; i++)
+        fin >> aCursor[i];
+    if (!fin)
+        throw CheckpointException("The checkpoint " + fileName + " is corrupted.");
+    cursor = aCursor;
+    outputSize = size;
+    resuming = true;
+}
+
+void SearchCheckpoint::openOutput(ofstream& fout, const string& outputFileName)
+{
+    if (resuming) {
+#ifdef _WIN32
+        FILE *f = fopen(outputFileName.c_str(), "r+b");
+        bool truncated = (f != 0) && (_chsize_s(_fileno(f), outputSize) == 0);
+        if (f != 0) fclose(f);
+#else
+        bool truncated = (truncate(outputFileName.c_str(), (off_t)outputSize) == 0);
+#endif
+        if (!truncated)
+            throw CheckpointException("The output file " + outputFileName + " of the checkpoint cannot be truncated.");
+        fout.open(outputFileName.c_str(), ios::in | ios::out | ios::binary);
+        fout.seekp(0, ios::end);
+    }
+    else
+        fout.open(outputFileName.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!fout)
+        throw CheckpointException("The output file " + outputFileName + " cannot be opened.");
+    output = &fout;
+}
+
+bool SearchCheckpoint::isDue()
+{
+    return difftime(time(0), lastSave) >= interval;
+}
+
+void SearchCheckpoint::save(const vector<UINT64>& aCursor)
+{
+    if (output != 0) {
+        output->flush();
+        outputSize = (UINT64)output->tellp();
+    }
+    string tmpFileName = fileName + ".tmp";
+    {
+        ofstream fout(tmpFileName.c_str());
+        fout << checkpointHeader << endl;
+        fout << description << endl;
+        fout << "output " << dec << outputSize << endl;
+        fout << "cursor " << aCursor.size();
+        for(unsigned int i=0; i<aCursor.size(); i++)
+            fout << " " << aCursor[i];
+        fout << endl;
+        if (!fout)
+            throw CheckpointException("The checkpoint " + tmpFileName + " cannot be written.");
+    }
+#ifdef _WIN32
+    remove(fileName.c_str());
+#endif
+    if (rename(tmpFileName.c_str(), fileName.c_str()) != 0)
+        throw CheckpointException("The checkpoint " + fileName + " cannot be written.");
+    cursor = aCursor;
+    lastSave = time(0);
+}
+
+void SearchCheckpoint::complete()
+{
+    if (output != 0)
+        output->flush();
+    remove(fileName.c_str());
+    resuming = false;
+}
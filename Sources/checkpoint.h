@@ -0,0 +1,104 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <fstream>
+#include <string>
+#include <time.h>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+typedef Exception CheckpointException;
+
+/** This class saves and restores the progress of a long search, so that it can resume
+  * after a crash or a preemption instead of starting over.
+  * The progress is captured by a cursor, i.e., a list of integers whose meaning
+  * is defined by the search (e.g., the unit list of a tree iterator, see
+  * GenericTreeIterator::getCursor()), together with the size of the output file
+  * at the time the cursor was saved.
+  * When resuming, the output file is truncated back to that size, so the trails
+  * output after the last checkpoint are not duplicated.
+  *
+  * The checkpoint file is a text file, written under a temporary name and then renamed,
+  * so that a crash while saving leaves the previous checkpoint intact.
+  * It also contains a description of the search, which must match when resuming.
+  */
+class SearchCheckpoint {
+protected:
+    /** The name of the checkpoint file. */
+    string fileName;
+    /** The description of the search. */
+    string description;
+    /** The minimum time between two checkpoints, in seconds. */
+    unsigned int interval;
+    /** The time of the last checkpoint, or of the construction. */
+    time_t lastSave;
+    /** Whether a checkpoint was found at construction. */
+    bool resuming;
+    /** The cursor found at construction, or the one last saved. */
+    vector<UINT64> cursor;
+    /** The size of the output file when the cursor was saved. */
+    UINT64 outputSize;
+    /** The output stream whose position is recorded with the cursor, if any. */
+    ostream *output;
+public:
+    /** The constructor, which loads the checkpoint file if it exists.
+      * @param  aFileName   The name of the checkpoint file.
+      * @param  aDescription    A one-line description of the search and of its parameters.
+      * @param  aInterval   The minimum time between two checkpoints, in seconds.
+      * @throw  CheckpointException if the file exists but cannot be read, or
+      *         if it was made for a search with another description.
+      */
+    SearchCheckpoint(const string& aFileName, const string& aDescription, unsigned int aInterval = 600);
+    /** This method tells whether a checkpoint was found, in which case the search
+      * must resume from getCursor().
+      * @return True if the search resumes from a checkpoint.
+      */
+    bool isResuming() const;
+    /** This method returns the cursor of the checkpoint found at construction.
+      * @return A constant reference to the cursor.
+      */
+    const vector<UINT64>& getCursor() const;
+    /** This method opens the output file of the search.
+      * If the search resumes, the file is truncated to its size at the checkpoint
+      * and opened for appending; otherwise, it is created or emptied.
+      * The position of @a fout is then saved with each cursor.
+      * @param  fout    The stream to open.
+      * @param  outputFileName  The name of the output file.
+      */
+    void openOutput(ofstream& fout, const string& outputFileName);
+    /** This method tells whether it is time to save a new checkpoint.
+      * It only reads the clock, so it can be called at every step of the search.
+      * @return True if at least the interval elapsed since the last checkpoint.
+      */
+    bool isDue();
+    /** This method saves a checkpoint.
+      * The output stream, if any, is flushed first, so the cursor must correspond to
+      * a point where all the trails before it have been output.
+      * @param  aCursor The cursor.
+      */
+    void save(const vector<UINT64>& aCursor);
+    /** This method removes the checkpoint file, to be called when the search is complete.
+      */
+    void complete();
+protected:
+    void load();
+};
+
+#endif
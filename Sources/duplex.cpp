@@ -55,6 +55,21 @@ void Duplex::computeRhoMax()
     }
 }
 
+void Duplex::saveCheckpoint(DuplexCheckpoint& checkpoint) const
+{
+    unsigned int width = f->getWidth();
+    checkpoint.width = width;
+    checkpoint.rate = rate;
+    checkpoint.state.assign(state.get(), state.get() + (width+7)/8);
+}
+
+void Duplex::restoreCheckpoint(const DuplexCheckpoint& checkpoint)
+{
+    if ((checkpoint.width != f->getWidth()) || (checkpoint.rate != rate))
+        throw DuplexException("The checkpoint does not come from a compatible duplex object.");
+    memcpy(state.get(), &checkpoint.state[0], checkpoint.state.size());
+}
+
 unsigned int Duplex::getCapacity() const
 {
     return capacity;
@@ -72,10 +87,8 @@ unsigned int Duplex::getMaximumOutputLength() const
 
 void Duplex::duplexing(const UINT8 *input, unsigned int inputLengthInBits, UINT8 *output, unsigned int desiredOutputLengthInBits)
 {
-    vector<UINT8> outputAsVector;
-    duplexing(input, inputLengthInBits, outputAsVector, desiredOutputLengthInBits);
-    for(unsigned int i=0; i<outputAsVector.size(); i++)
-        output[i] = outputAsVector[i];
+    processDuplexing(input, inputLengthInBits);
+    outputDuplexing(output, desiredOutputLengthInBits);
 }
 
 const UINT8* Duplex::processDuplexing(MessageQueue& queue, UINT8 delimitedSigmaEnd)
@@ -86,6 +99,16 @@ const UINT8* Duplex::processDuplexing(MessageQueue& queue, UINT8 delimitedSigmaE
         queue.appendBit(delimitedSigmaEnd & 1);
         delimitedSigmaEnd >>= 1;
     }
+    unsigned int inputSize = queue.lastBlockSize();
+    if ((queue.blockCount() <= 1) && pad->padInPlace(rate, state.get(), inputSize)) {
+        if (inputSize > 0) {
+            const vector<UINT8>& block = queue.firstBlock();
+            for(vector<UINT8>::size_type i=0; i<block.size(); ++i)
+                state.get()[i] ^= block[i];
+        }
+        (*f)(state.get());
+        return state.get();
+    }
     queue.pad(*pad);
     if ((queue.blockCount() != 1) || (!queue.firstBlockIsWhole()))
         throw DuplexException("The given input length must be such that it spans exactly one block after padding.");
@@ -98,10 +121,42 @@ const UINT8* Duplex::processDuplexing(MessageQueue& queue, UINT8 delimitedSigmaE
 
 void Duplex::duplexingBytes(const UINT8 *sigmaBegin, unsigned int sigmaBeginByteLen, UINT8 delimitedSigmaEnd, UINT8 *Z, unsigned int ZByteLen)
 {
-    vector<UINT8> ZAsVector;
-    duplexingBytes(sigmaBegin, sigmaBegin+sigmaBeginByteLen, delimitedSigmaEnd, ZAsVector, ZByteLen);
-    for(unsigned int i=0; i<ZAsVector.size(); i++)
-        Z[i] = ZAsVector[i];
+    processDuplexing(sigmaBegin, sigmaBeginByteLen*8, delimitedSigmaEnd);
+    outputDuplexing(Z, ZByteLen*8);
+}
+
+void Duplex::processDuplexing(const UINT8 *input, unsigned int inputLengthInBits, UINT8 delimitedSigmaEnd)
+{
+    if (delimitedSigmaEnd == 0x00)
+        throw DuplexException("delimitedSigmaEnd has an invalid coding.");
+    unsigned int trailingLength = 0;
+    while((delimitedSigmaEnd >> (trailingLength+1)) != 0)
+        trailingLength++;
+    unsigned int totalLength = inputLengthInBits + trailingLength;
+    if (pad->getPaddedSize(rate, totalLength) != rate)
+        throw DuplexException("The given input length must be such that it spans exactly one block after padding.");
+    UINT8 *s = state.get();
+    for(unsigned int i=0; i<inputLengthInBits/8; ++i)
+        s[i] ^= input[i];
+    if ((inputLengthInBits % 8) != 0)
+        s[inputLengthInBits/8] ^= input[inputLengthInBits/8] & ((1 << (inputLengthInBits % 8)) - 1);
+    if (trailingLength > 0) {
+        unsigned int trailingBits = (unsigned int)(delimitedSigmaEnd ^ (1 << trailingLength)) << (inputLengthInBits % 8);
+        s[inputLengthInBits/8] ^= (UINT8)(trailingBits & 0xFF);
+        if ((trailingBits >> 8) != 0)
+            s[inputLengthInBits/8 + 1] ^= (UINT8)(trailingBits >> 8);
+    }
+    pad->padInPlace(rate, s, totalLength);
+    (*f)(s);
+}
+
+void Duplex::outputDuplexing(UINT8 *output, unsigned int desiredOutputLengthInBits) const
+{
+    if (desiredOutputLengthInBits > rate)
+        throw DuplexException("The given output length must be less than or equal to the rate.");
+    memcpy(output, state.get(), (desiredOutputLengthInBits+7)/8);
+    if ((desiredOutputLengthInBits % 8) != 0)
+        output[desiredOutputLengthInBits/8] &= (1 << (desiredOutputLengthInBits % 8)) - 1;
 }
 
 string Duplex::getDescription() const
@@ -26,6 +26,25 @@ using namespace std;
 
 typedef Exception DuplexException;
 
+/**
+  * Class that holds a snapshot of the state of a Duplex object, as taken by
+  * Duplex::saveCheckpoint() and restored by Duplex::restoreCheckpoint().
+  * Saving into an existing checkpoint reuses its memory.
+  */
+class DuplexCheckpoint {
+protected:
+    /** The width of the transformation of the duplex object the checkpoint was taken from. */
+    unsigned int width;
+    /** The rate of the duplex object the checkpoint was taken from. */
+    unsigned int rate;
+    /** The state of the duplex object. */
+    vector<UINT8> state;
+public:
+    /** The constructor, for an empty checkpoint that can only be saved into. */
+    DuplexCheckpoint() : width(0), rate(0) {}
+    friend class Duplex;
+};
+
 /**
   * Class implementing the duplex construction.
   */
@@ -86,6 +105,8 @@ public:
       * @param  output      The buffer where to store the output data.
       * @param  desiredOutputLengthInBits    The length in bits of the output.
       *
+      * This method writes the output directly into @a output and does not allocate memory.
+      *
       * @pre    inputLengthInBits ≤ getMaximumInputLength()
       * @pre    desiredOutputLengthInBits ≤ getMaximumOutputLength()
       */
@@ -143,6 +164,7 @@ public:
       *                     and the bits in @a delimitedSigmaEnd before the delimiter.
       * @pre    @a delimitedSigmaEnd ≠ 0x00
       * @pre    @a sigmaBeginByteLen*8+<i>n</i> ≤ getMaximumInputLength()
+      * @note   This method writes the output directly into @a Z and does not allocate memory.
       * @pre    @a ZByteLen*8 ≤ getMaximumOutputLength()
       */
     void duplexingBytes(const UINT8 *sigmaBegin, unsigned int sigmaBeginByteLen, UINT8 delimitedSigmaEnd, UINT8 *Z, unsigned int ZByteLen);
@@ -196,6 +218,15 @@ public:
         processDuplexing(queue, delimitedSigmaEnd);
     }
 
+    /**
+      * Method that saves the current state of the duplex object into @a checkpoint.
+      */
+    void saveCheckpoint(DuplexCheckpoint& checkpoint) const;
+    /**
+      * Method that brings the duplex object back to the state saved in @a checkpoint.
+      * The checkpoint must come from a duplex object with the same transformation and rate.
+      */
+    void restoreCheckpoint(const DuplexCheckpoint& checkpoint);
     /**
       * Method that returns the capacity of the sponge function.
       */
@@ -222,6 +253,13 @@ protected:
       */
     void computeRhoMax();
     const UINT8* processDuplexing(MessageQueue& queue, UINT8 delimitedSigmaEnd = 0x01);
+    /** Internal method that XORs the input, the trailing bits of @a delimitedSigmaEnd
+      * and the padding (see PaddingRule::padInPlace()) directly into the state,
+      * then applies the permutation. It does not allocate memory.
+      */
+    void processDuplexing(const UINT8 *input, unsigned int inputLengthInBits, UINT8 delimitedSigmaEnd = 0x01);
+    /** Internal method that copies the output directly from the state into @a output. */
+    void outputDuplexing(UINT8 *output, unsigned int desiredOutputLengthInBits) const;
     template<class OutputContainer>
     void outputDuplexing(const UINT8* state, OutputContainer& output, unsigned int desiredOutputLengthInBits)
     {
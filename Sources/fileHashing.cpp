@@ -0,0 +1,80 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "fileHashing.h"
+
+UINT64 forEachFileChunk(const string& fileName, const function<void(const UINT8 *, unsigned int)>& consumer,
+    unsigned int maxChunkSize)
+{
+    if ((maxChunkSize == 0) || (maxChunkSize >= (1U<<29)))
+        throw FileHashingException("The chunk size must be between 1 and 2^29-1 bytes.");
+#ifndef _WIN32
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw FileHashingException("Cannot open " + fileName + " for reading.");
+    struct stat st;
+    if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode)) {
+        UINT64 size = (UINT64)st.st_size;
+        if (size == 0) {
+            close(fd);
+            return 0;
+        }
+        void *mapped = mmap(0, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped != MAP_FAILED) {
+            madvise(mapped, (size_t)size, MADV_SEQUENTIAL);
+            const UINT8 *data = (const UINT8 *)mapped;
+            try {
+                for(UINT64 offset=0; offset<size; offset+=maxChunkSize)
+                    consumer(data + offset, (unsigned int)min((UINT64)maxChunkSize, size - offset));
+            }
+            catch(...) {
+                munmap(mapped, (size_t)size);
+                throw;
+            }
+            munmap(mapped, (size_t)size);
+            return size;
+        }
+    }
+    else
+        close(fd);
+#endif
+    // Pipes, devices, or platforms without mmap(): read in large chunks
+    ifstream fin(fileName.c_str(), ios::binary);
+    if (!fin)
+        throw FileHashingException("Cannot open " + fileName + " for reading.");
+    vector<UINT64> buffer((maxChunkSize+7)/8);
+    UINT8 *chunk = (UINT8 *)&buffer[0];
+    UINT64 size = 0;
+    while(fin) {
+        fin.read((char *)chunk, maxChunkSize);
+        unsigned int lengthInBytes = (unsigned int)fin.gcount();
+        if (lengthInBytes > 0)
+            consumer(chunk, lengthInBytes);
+        size += lengthInBytes;
+    }
+    if (!fin.eof())
+        throw FileHashingException("Error while reading " + fileName + ".");
+    return size;
+}
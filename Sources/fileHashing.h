@@ -0,0 +1,98 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _FILEHASHING_H_
+#define _FILEHASHING_H_
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include "types.h"
+
+using namespace std;
+
+/** Exception thrown when a file cannot be read. */
+typedef Exception FileHashingException;
+
+/**
+  * Function that passes the whole content of a file to @a consumer, as
+  * consecutive chunks of at most @a maxChunkSize bytes.
+  * Where possible, the file is mapped into memory and the chunks point
+  * directly into the mapping; otherwise, the file is read into a buffer
+  * in chunks of @a maxChunkSize bytes.
+  *
+  * @param  fileName    The name of the file to read.
+  * @param  consumer    The function called on each chunk, with a pointer
+  *                     to the data and its length in bytes.
+  * @param  maxChunkSize    The maximum size of a chunk, in bytes,
+  *                     which must be less than 2^29 so that its length
+  *                     in bits fits in an unsigned int.
+  * @return The size of the file, in bytes.
+  */
+UINT64 forEachFileChunk(const string& fileName, const function<void(const UINT8 *, unsigned int)>& consumer,
+    unsigned int maxChunkSize = 1<<26);
+
+/**
+  * Function that absorbs the content of a file into @a hash, which can be
+  * a Sponge (e.g., Keccak or ReducedRoundKeccak) or a
+  * ShortLeafInterleavedSpongeTree, or any class with a compatible
+  * absorb(const UINT8 *, unsigned int) method.
+  * The data are absorbed directly from the file mapping when available.
+  *
+  * @return The number of bytes absorbed.
+  */
+template<class Hash>
+UINT64 absorbFile(Hash& hash, const string& fileName)
+{
+    return forEachFileChunk(fileName, [&hash](const UINT8 *data, unsigned int lengthInBytes) {
+        hash.absorb(data, lengthInBytes*8);
+    });
+}
+
+/**
+  * Function that hashes a file with @a hash, as absorbFile() does,
+  * then absorbs the optional suffix bits and squeezes the output.
+  * If @a report is not null, the throughput is written to it.
+  *
+  * @param  hash        The hashing object, in its initial state.
+  * @param  fileName    The name of the file to hash.
+  * @param  output      The buffer where to store the output.
+  * @param  outputLengthInBits  The length in bits of the output.
+  * @param  suffix      The bits to absorb after the content of the file
+  *                     (e.g., the domain separation bits of SHA-3),
+  *                     or 0 for none.
+  * @param  suffixLengthInBits  The number of bits in @a suffix.
+  * @param  report      The stream where to write the throughput, or 0.
+  */
+template<class Hash>
+void hashFile(Hash& hash, const string& fileName, UINT8 *output, unsigned int outputLengthInBits,
+    const UINT8 *suffix = 0, unsigned int suffixLengthInBits = 0, ostream *report = 0)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    UINT64 lengthInBytes = absorbFile(hash, fileName);
+    if (suffixLengthInBits > 0)
+        hash.absorb(suffix, suffixLengthInBits);
+    hash.squeeze(output, outputLengthInBits);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (report != 0) {
+        (*report) << fileName << ": " << dec << lengthInBytes << " bytes in " << seconds << " s";
+        if (seconds > 0)
+            (*report) << " (" << (lengthInBytes/seconds/1e6) << " MB/s)";
+        (*report) << endl;
+    }
+}
+
+#endif
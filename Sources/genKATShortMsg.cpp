@@ -8,6 +8,8 @@ questions, please refer to our website: http://keccak.noekeon.org/
 This code is based on genKAT.c by NIST.
 */
 
+#include <algorithm>
+#include <mutex>
 #include <sstream>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,6 +17,7 @@ This code is based on genKAT.c by NIST.
 #include <string>
 #include <time.h>
 #include <ctype.h>
+#include <thread>
 
 #include "duplex.h"
 #include "Keccak.h"
@@ -25,56 +28,87 @@ This code is based on genKAT.c by NIST.
 typedef enum { KAT_SUCCESS = 0, KAT_FILE_OPEN_ERROR = 1, KAT_HEADER_ERROR = 2, KAT_DATA_ERROR = 3, KAT_HASH_ERROR = 4 } STATUS_CODES;
 typedef unsigned char BitSequence;
 
+/** The parameters of one ShortMsgKAT file to generate from ShortMsgKAT.txt. */
+struct ShortMsgKATInstance {
+    unsigned int rate, capacity;
+    /** The rounds of Keccak-f[1600] to use, or nrRounds=0 for the nominal number of rounds. */
+    int startRoundIndex;
+    unsigned int nrRounds;
+    /** The suffix appended to each message before padding, given as delimited bits (0 for none). */
+    unsigned char delimitedSuffix;
+    /** The output lengths printed as "MD = " and as "Squeezed = " (0 if not printed). */
+    unsigned int hashbitlen, squeezedOutputLength;
+    std::string fileName;
+    /** The header line of the output file, or empty to copy the header of ShortMsgKAT.txt. */
+    std::string description;
+    /** The name displayed when the file is finished. */
+    std::string label;
+};
+
+STATUS_CODES genShortMsgKATs(const vector<ShortMsgKATInstance>& instances, unsigned int nrThreads);
+ShortMsgKATInstance shortMsgInstance(unsigned int rate, unsigned int capacity, int outputLength, const std::string& suffix, bool fixedOutputLength = false);
+ShortMsgKATInstance shortMsgHashInstance(unsigned int rate, unsigned int capacity,  unsigned char delimitedSuffix, unsigned int hashbitlen, unsigned int squeezedOutputLength, const std::string& fileName, const std::string& description);
 STATUS_CODES genShortMsg(unsigned int rate, unsigned int capacity, int outputLength, const std::string& suffix, bool fixedOutputLength = false);
 STATUS_CODES genShortMsgHash(unsigned int rate, unsigned int capacity,  unsigned char delimitedSuffix, unsigned int hashbitlen, unsigned int squeezedOutputLength, const std::string& fileName, const std::string& description);
 int     FindMarker(FILE *infile, const char *marker);
 int     ReadHex(FILE *infile, BitSequence *A, int Length, const char *str);
 void    fprintBstr(FILE *fp, const char *S, BitSequence *A, int L);
+STATUS_CODES readShortMessages(FILE *fp_in, vector<int>& lengths, vector<vector<BitSequence> >& messages);
+void    hashShortMessages(const Sponge& sponge, const vector<int>& lengths, const vector<vector<BitSequence> >& messages,
+            unsigned char delimitedSuffix, unsigned int outputLength, vector<vector<BitSequence> >& outputs);
+unsigned int getNumberOfDelimitedBits(unsigned char delimitedSuffix);
 
 #define SqueezingOutputLength 4096
 
-void genKATShortMsg_main()
+/** Generates all the ShortMsgKAT files, spreading the instances
+  * and the messages over @a nrThreads threads (0 for the number of hardware threads).
+  * The files are identical whatever the number of threads.
+  */
+void genKATShortMsg_main(unsigned int nrThreads)
 {
-    genShortMsg(1024,  576, 4096, "0");
-    genShortMsg(1152,  448,  224, "224", true);
-    genShortMsg(1088,  512,  256, "256", true);
-    genShortMsg( 832,  768,  384, "384", true);
-    genShortMsg( 576, 1024,  512, "512", true);
-    genShortMsg(1344,  256, 4096, "r1344c256");
-    genShortMsg(1440,  160, 1440, "r1440c160");
-
-    genShortMsg( 256,  544, 4096, "r256c544");
-    genShortMsg( 288,  512, 4096, "r288c512");
-    genShortMsg( 512,  288, 4096, "r512c288");
-    genShortMsg( 544,  256, 4096, "r544c256");
-    genShortMsg( 640,  160, 4096, "r640c160");
-
-    genShortMsg( 128,  272, 4096, "r128c272");
-    genShortMsg( 144,  256, 4096, "r144c256");
-    genShortMsg( 240,  160, 4096, "r240c160");
-
-    genShortMsg(  40,   160, 4096, "r40c160");
+    vector<ShortMsgKATInstance> instances;
+    instances.push_back(shortMsgInstance(1024,  576, 4096, "0"));
+    instances.push_back(shortMsgInstance(1152,  448,  224, "224", true));
+    instances.push_back(shortMsgInstance(1088,  512,  256, "256", true));
+    instances.push_back(shortMsgInstance( 832,  768,  384, "384", true));
+    instances.push_back(shortMsgInstance( 576, 1024,  512, "512", true));
+    instances.push_back(shortMsgInstance(1344,  256, 4096, "r1344c256"));
+    instances.push_back(shortMsgInstance(1440,  160, 1440, "r1440c160"));
+
+    instances.push_back(shortMsgInstance( 256,  544, 4096, "r256c544"));
+    instances.push_back(shortMsgInstance( 288,  512, 4096, "r288c512"));
+    instances.push_back(shortMsgInstance( 512,  288, 4096, "r512c288"));
+    instances.push_back(shortMsgInstance( 544,  256, 4096, "r544c256"));
+    instances.push_back(shortMsgInstance( 640,  160, 4096, "r640c160"));
+
+    instances.push_back(shortMsgInstance( 128,  272, 4096, "r128c272"));
+    instances.push_back(shortMsgInstance( 144,  256, 4096, "r144c256"));
+    instances.push_back(shortMsgInstance( 240,  160, 4096, "r240c160"));
+
+    instances.push_back(shortMsgInstance(  40,   160, 4096, "r40c160"));
 
     // The following instances are from
     // [Keccak team, Cryptology ePrint Archive, Report 2013/231, Table 4]
-    genShortMsgHash(1344, 256, 0x1F, 0, 4096,
+    instances.push_back(shortMsgHashInstance(1344, 256, 0x1F, 0, 4096,
         "ShortMsgKAT_KeccakSeqHash11c256.txt",
-        "Keccak(SakuraSequential|11)[r=1344, c=256] sponge function");
-    genShortMsgHash(1344, 256, 0x33, 224, 0,
+        "Keccak(SakuraSequential|11)[r=1344, c=256] sponge function"));
+    instances.push_back(shortMsgHashInstance(1344, 256, 0x33, 224, 0,
         "ShortMsgKAT_KeccakSeqHash001c256_n224.txt",
-        "Keccak(SakuraSequential|001)[r=1344, c=256] 224-bit hash function");
-    genShortMsgHash(1344, 256, 0x37, 256, 0,
+        "Keccak(SakuraSequential|001)[r=1344, c=256] 224-bit hash function"));
+    instances.push_back(shortMsgHashInstance(1344, 256, 0x37, 256, 0,
         "ShortMsgKAT_KeccakSeqHash101c256_n256.txt",
-        "Keccak(SakuraSequential|101)[r=1344, c=256] 256-bit hash function");
-    genShortMsgHash(1088, 512, 0x1F, 0, 4096,
+        "Keccak(SakuraSequential|101)[r=1344, c=256] 256-bit hash function"));
+    instances.push_back(shortMsgHashInstance(1088, 512, 0x1F, 0, 4096,
         "ShortMsgKAT_KeccakSeqHash11c512.txt",
-        "Keccak(SakuraSequential|11)[r=1088, c=512] sponge function");
-    genShortMsgHash(1088, 512, 0x33, 384, 0,
+        "Keccak(SakuraSequential|11)[r=1088, c=512] sponge function"));
+    instances.push_back(shortMsgHashInstance(1088, 512, 0x33, 384, 0,
         "ShortMsgKAT_KeccakSeqHash001c512_n384.txt",
-        "Keccak(SakuraSequential|001)[r=1088, c=512] 384-bit hash function");
-    genShortMsgHash(1088, 512, 0x37, 512, 0,
+        "Keccak(SakuraSequential|001)[r=1088, c=512] 384-bit hash function"));
+    instances.push_back(shortMsgHashInstance(1088, 512, 0x37, 512, 0,
         "ShortMsgKAT_KeccakSeqHash101c512_n512.txt",
-        "Keccak(SakuraSequential|101)[r=1088, c=512] 512-bit hash function");
+        "Keccak(SakuraSequential|101)[r=1088, c=512] 512-bit hash function"));
+
+    genShortMsgKATs(instances, nrThreads);
 }
 
 STATUS_CODES genSpongeKAT(Sponge& sponge, const std::string& suffix);
@@ -135,79 +169,49 @@ void fromNISTConventionToInternalConvention(BitSequence *Msg, int msglen)
     }
 }
 
-STATUS_CODES genShortMsg(unsigned int rate, unsigned int capacity, int outputLength, const std::string& suffix, bool fixedOutputLength)
+/** Reads all the remaining messages of the ShortMsgKAT.txt file, as given in the file. */
+STATUS_CODES readShortMessages(FILE *fp_in, vector<int>& lengths, vector<vector<BitSequence> >& messages)
 {
-    char        line[SUBMITTER_INFO_LEN];
-    int         msglen, msgbytelen, done;
+    int msglen;
     BitSequence Msg[256];
-    BitSequence Squeezed[SqueezingOutputLength/8];
-    FILE        *fp_in, *fp_out;
-
-    if ( (fp_in = fopen("ShortMsgKAT.txt", "r")) == NULL ) {
-        printf("Couldn't open <ShortMsgKAT.txt> for read\n");
-        return KAT_FILE_OPEN_ERROR;
-    }
-
-    string fileName = std::string("ShortMsgKAT_") + suffix + std::string(".txt");
-    if ( (fp_out = fopen(fileName.c_str(), "w")) == NULL ) {
-        printf("Couldn't open <%s> for write\n", fileName.c_str());
-        return KAT_FILE_OPEN_ERROR;
-    }
-    fprintf(fp_out, "# %s\n", fileName.c_str());
-    if ( FindMarker(fp_in, "# Algorithm Name:") && (1 == fscanf(fp_in, "%[^\n]\n", line)) ) {
-        fprintf(fp_out, "# Algorithm Name:%s\n", line);
-    }
-    else {
-        printf("genShortMsg: Couldn't read Algorithm Name\n");
-        return KAT_HEADER_ERROR;
-    }
-    if ( FindMarker(fp_in, "# Principal Submitter:") && (1 == fscanf(fp_in, "%[^\n]\n", line)) ) {
-        fprintf(fp_out, "# Principal Submitter:%s\n", line);
-    }
-    else {
-        printf("genShortMsg: Couldn't read Principal Submitter\n");
-        return KAT_HEADER_ERROR;
-    }
 
-    done = 0;
-    do {
-        if ( FindMarker(fp_in, "Len = ") ) {
-            if ( 1 != fscanf(fp_in, "%d", &msglen)) {
-                printf("ERROR: unable to read 'Len' from <ShortMsgKAT.txt>\n");
-                return KAT_DATA_ERROR;
-            }
-        }
-        else {
-            done = 1;
-            break;
+    while ( FindMarker(fp_in, "Len = ") ) {
+        if ( 1 != fscanf(fp_in, "%d", &msglen)) {
+            printf("ERROR: unable to read 'Len' from <ShortMsgKAT.txt>\n");
+            return KAT_DATA_ERROR;
         }
-        msgbytelen = (msglen+7)/8;
-
+        int msgbytelen = (msglen+7)/8;
         if ( !ReadHex(fp_in, Msg, msgbytelen, "Msg = ") ) {
             printf("ERROR: unable to read 'Msg' from <ShortMsgKAT.txt>\n");
             return KAT_DATA_ERROR;
         }
-        fprintf(fp_out, "\nLen = %d\n", msglen);
-        fprintBstr(fp_out, "Msg = ", Msg, msgbytelen);
-
-        Keccak keccak(rate, capacity);
-
-        fromNISTConventionToInternalConvention(Msg, msglen);
-        keccak.absorb(Msg, msglen);
-        keccak.squeeze(Squeezed, outputLength);
-        if (fixedOutputLength)
-            fprintBstr(fp_out, "MD = ", Squeezed, outputLength/8);
-        else
-            fprintBstr(fp_out, "Squeezed = ", Squeezed, outputLength/8);
-    } while ( !done );
-    printf("finished ShortMsgKAT for <%s>\n", suffix.c_str());
-
-    fclose(fp_in);
-    fclose(fp_out);
-
+        lengths.push_back(msglen);
+        messages.push_back(vector<BitSequence>(Msg, Msg + max(msgbytelen, 1)));
+    }
     return KAT_SUCCESS;
 }
 
+/** Hashes all the messages at once with Sponge::hashBatch(), each followed by the bits of @a delimitedSuffix (if not 0). */
+void hashShortMessages(const Sponge& sponge, const vector<int>& lengths, const vector<vector<BitSequence> >& messages,
+    unsigned char delimitedSuffix, unsigned int outputLength, vector<vector<BitSequence> >& outputs)
+{
+    vector<vector<BitSequence> > converted(messages);
+    vector<const UINT8 *> inputs;
+    vector<unsigned int> inputLengths;
+    vector<UINT8 *> outputPointers;
+    outputs.assign(messages.size(), vector<BitSequence>((outputLength+7)/8));
+    for(unsigned int i=0; i<messages.size(); i++) {
+        fromNISTConventionToInternalConvention(&converted[i][0], lengths[i]);
+        inputs.push_back(&converted[i][0]);
+        inputLengths.push_back(lengths[i]);
+        outputPointers.push_back(&outputs[i][0]);
+    }
+    unsigned char suffix[1];
+    suffix[0] = delimitedSuffix;
+    sponge.hashBatch(inputs, inputLengths, outputPointers, outputLength,
+        suffix, (delimitedSuffix != 0) ? getNumberOfDelimitedBits(delimitedSuffix) : 0);
+}
+
 unsigned int getNumberOfDelimitedBits(unsigned char delimitedSuffix)
 {
     if ((delimitedSuffix & 0x80) != 0)
@@ -228,65 +232,153 @@ unsigned int getNumberOfDelimitedBits(unsigned char delimitedSuffix)
         return 0;
 }
 
+ShortMsgKATInstance shortMsgInstance(unsigned int rate, unsigned int capacity, int outputLength, const std::string& suffix, bool fixedOutputLength)
+{
+    ShortMsgKATInstance instance;
+    instance.rate = rate;
+    instance.capacity = capacity;
+    instance.startRoundIndex = 0;
+    instance.nrRounds = 0;
+    instance.delimitedSuffix = 0;
+    instance.hashbitlen = fixedOutputLength ? outputLength : 0;
+    instance.squeezedOutputLength = fixedOutputLength ? 0 : outputLength;
+    instance.fileName = std::string("ShortMsgKAT_") + suffix + std::string(".txt");
+    instance.label = suffix;
+    return instance;
+}
+
+ShortMsgKATInstance shortMsgHashInstance(unsigned int rate, unsigned int capacity,  unsigned char delimitedSuffix, unsigned int hashbitlen, unsigned int squeezedOutputLength, const std::string& fileName, const std::string& description)
+{
+    ShortMsgKATInstance instance;
+    instance.rate = rate;
+    instance.capacity = capacity;
+    instance.startRoundIndex = 0;
+    instance.nrRounds = 0;
+    instance.delimitedSuffix = delimitedSuffix;
+    instance.hashbitlen = hashbitlen;
+    instance.squeezedOutputLength = (squeezedOutputLength > 0) ? SqueezingOutputLength : 0;
+    instance.fileName = fileName;
+    instance.description = description;
+    instance.label = fileName;
+    return instance;
+}
+
+STATUS_CODES genShortMsg(unsigned int rate, unsigned int capacity, int outputLength, const std::string& suffix, bool fixedOutputLength)
+{
+    return genShortMsgKATs(vector<ShortMsgKATInstance>(1, shortMsgInstance(rate, capacity, outputLength, suffix, fixedOutputLength)), 1);
+}
+
 STATUS_CODES genShortMsgHash(unsigned int rate, unsigned int capacity,  unsigned char delimitedSuffix, unsigned int hashbitlen, unsigned int squeezedOutputLength, const std::string& fileName, const std::string& description)
 {
-    int         msglen, msgbytelen, done;
-    BitSequence Msg[256];
-    BitSequence Squeezed[SqueezingOutputLength/8];
+    return genShortMsgKATs(vector<ShortMsgKATInstance>(1, shortMsgHashInstance(rate, capacity, delimitedSuffix, hashbitlen, squeezedOutputLength, fileName, description)), 1);
+}
+
+/** Reads ShortMsgKAT.txt once, hashes its messages for all the instances
+  * and writes the output files in order.
+  * The work is cut into slices of messages of one instance, which are
+  * distributed over the threads. Each slice goes through Sponge::hashBatch().
+  */
+STATUS_CODES genShortMsgKATs(const vector<ShortMsgKATInstance>& instances, unsigned int nrThreads)
+{
+    char        algorithmName[SUBMITTER_INFO_LEN], principalSubmitter[SUBMITTER_INFO_LEN];
     FILE        *fp_in, *fp_out;
 
     if ( (fp_in = fopen("ShortMsgKAT.txt", "r")) == NULL ) {
         printf("Couldn't open <ShortMsgKAT.txt> for read\n");
         return KAT_FILE_OPEN_ERROR;
     }
-
-    if ( (fp_out = fopen(fileName.c_str(), "w")) == NULL ) {
-        printf("Couldn't open <%s> for write\n", fileName.c_str());
-        return KAT_FILE_OPEN_ERROR;
+    bool needsHeader = false;
+    for(unsigned int k=0; k<instances.size(); k++)
+        if (instances[k].description.empty())
+            needsHeader = true;
+    if (needsHeader) {
+        if ( !FindMarker(fp_in, "# Algorithm Name:") || (1 != fscanf(fp_in, "%[^\n]\n", algorithmName)) ) {
+            printf("genShortMsg: Couldn't read Algorithm Name\n");
+            return KAT_HEADER_ERROR;
+        }
+        if ( !FindMarker(fp_in, "# Principal Submitter:") || (1 != fscanf(fp_in, "%[^\n]\n", principalSubmitter)) ) {
+            printf("genShortMsg: Couldn't read Principal Submitter\n");
+            return KAT_HEADER_ERROR;
+        }
     }
-    fprintf(fp_out, "# %s\n", description.c_str());
-
-    done = 0;
-    do {
-        if ( FindMarker(fp_in, "Len = ") ) {
-            if ( 1 != fscanf(fp_in, "%d", &msglen)) {
-                printf("ERROR: unable to read 'Len' from <ShortMsgKAT.txt>\n");
-                return KAT_DATA_ERROR;
+    vector<int> lengths;
+    vector<vector<BitSequence> > messages;
+    STATUS_CODES status = readShortMessages(fp_in, lengths, messages);
+    fclose(fp_in);
+    if (status != KAT_SUCCESS)
+        return status;
+
+    const unsigned int messagesPerSlice = 64;
+    const unsigned int slicesPerInstance = (unsigned int)(messages.size() + messagesPerSlice - 1)/messagesPerSlice;
+    const unsigned int nrSlices = (unsigned int)instances.size()*slicesPerInstance;
+    vector<vector<vector<BitSequence> > > squeezed(instances.size(), vector<vector<BitSequence> >(messages.size()));
+    unsigned int nextSlice = 0;
+    mutex lock;
+    auto worker = [&]() {
+        while(true) {
+            unsigned int slice;
+            {
+                lock_guard<mutex> guard(lock);
+                if (nextSlice >= nrSlices)
+                    return;
+                slice = nextSlice++;
             }
+            const ShortMsgKATInstance& instance = instances[slice/slicesPerInstance];
+            unsigned int first = (slice%slicesPerInstance)*messagesPerSlice;
+            unsigned int last = min(first + messagesPerSlice, (unsigned int)messages.size());
+            vector<int> sliceLengths(lengths.begin()+first, lengths.begin()+last);
+            vector<vector<BitSequence> > sliceMessages(messages.begin()+first, messages.begin()+last);
+            vector<vector<BitSequence> > sliceOutputs;
+            Sponge *sponge;
+            if (instance.nrRounds == 0)
+                sponge = new Keccak(instance.rate, instance.capacity);
+            else
+                sponge = new ReducedRoundKeccak(instance.rate, instance.capacity, instance.startRoundIndex, instance.nrRounds);
+            hashShortMessages(*sponge, sliceLengths, sliceMessages, instance.delimitedSuffix,
+                max(instance.hashbitlen, instance.squeezedOutputLength), sliceOutputs);
+            delete sponge;
+            // Each slice writes to its own entries, so no locking is needed here
+            for(unsigned int i=first; i<last; i++)
+                squeezed[slice/slicesPerInstance][i].swap(sliceOutputs[i-first]);
         }
-        else {
-            done = 1;
-            break;
-        }
-        msgbytelen = (msglen+7)/8;
+    };
+    if (nrThreads == 0)
+        nrThreads = max(1U, thread::hardware_concurrency());
+    nrThreads = min(nrThreads, max(1U, nrSlices));
+    if (nrThreads == 1)
+        worker();
+    else {
+        vector<thread> threads;
+        for(unsigned int t=0; t<nrThreads; t++)
+            threads.push_back(thread(worker));
+        for(unsigned int t=0; t<nrThreads; t++)
+            threads[t].join();
+    }
 
-        if ( !ReadHex(fp_in, Msg, msgbytelen, "Msg = ") ) {
-            printf("ERROR: unable to read 'Msg' from <ShortMsgKAT.txt>\n");
-            return KAT_DATA_ERROR;
+    for(unsigned int k=0; k<instances.size(); k++) {
+        const ShortMsgKATInstance& instance = instances[k];
+        if ( (fp_out = fopen(instance.fileName.c_str(), "w")) == NULL ) {
+            printf("Couldn't open <%s> for write\n", instance.fileName.c_str());
+            return KAT_FILE_OPEN_ERROR;
         }
-        fprintf(fp_out, "\nLen = %d\n", msglen);
-        fprintBstr(fp_out, "Msg = ", Msg, msgbytelen);
-
-        Keccak keccak(rate, capacity);
-
-        fromNISTConventionToInternalConvention(Msg, msglen);
-        keccak.absorb(Msg, msglen);
-        {
-            unsigned char suffix[1];
-            suffix[0] = delimitedSuffix;
-            keccak.absorb(suffix, getNumberOfDelimitedBits(delimitedSuffix));
+        if (instance.description.empty()) {
+            fprintf(fp_out, "# %s\n", instance.fileName.c_str());
+            fprintf(fp_out, "# Algorithm Name:%s\n", algorithmName);
+            fprintf(fp_out, "# Principal Submitter:%s\n", principalSubmitter);
         }
-        keccak.squeeze(Squeezed, max(hashbitlen, squeezedOutputLength));
-
-        if (hashbitlen > 0)
-            fprintBstr(fp_out, "MD = ", Squeezed, hashbitlen/8);
-        if (squeezedOutputLength > 0)
-            fprintBstr(fp_out, "Squeezed = ", Squeezed, SqueezingOutputLength/8);
-    } while ( !done );
-    printf("finished ShortMsgKAT for <%s>\n", fileName.c_str());
-
-    fclose(fp_in);
-    fclose(fp_out);
+        else
+            fprintf(fp_out, "# %s\n", instance.description.c_str());
+        for(unsigned int i=0; i<messages.size(); i++) {
+            fprintf(fp_out, "\nLen = %d\n", lengths[i]);
+            fprintBstr(fp_out, "Msg = ", &messages[i][0], (lengths[i]+7)/8);
+            if (instance.hashbitlen > 0)
+                fprintBstr(fp_out, "MD = ", &squeezed[k][i][0], instance.hashbitlen/8);
+            if (instance.squeezedOutputLength > 0)
+                fprintBstr(fp_out, "Squeezed = ", &squeezed[k][i][0], instance.squeezedOutputLength/8);
+        }
+        fclose(fp_out);
+        printf("finished ShortMsgKAT for <%s>\n", instance.label.c_str());
+    }
 
     return KAT_SUCCESS;
 }
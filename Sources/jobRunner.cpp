@@ -0,0 +1,204 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <thread>
+#include "jobRunner.h"
+
+void BatchJob::parse(const string& line)
+{
+    stringstream sin(line);
+    string DCorLCName;
+    if (!(sin >> kind >> dec >> width >> DCorLCName))
+        throw BatchJobException("The job '" + line + "' must start with its kind, the width and DC or LC.");
+    if (DCorLCName == "DC")
+        DCorLC = KeccakFPropagation::DC;
+    else if (DCorLCName == "LC")
+        DCorLC = KeccakFPropagation::LC;
+    else
+        throw BatchJobException("The job '" + line + "' must specify DC or LC after the width.");
+    arguments.clear();
+    string argument;
+    while(sin >> argument)
+        arguments.push_back(argument);
+}
+
+string BatchJob::getDescription() const
+{
+    stringstream description;
+    description << kind << " " << dec << width << " " << ((DCorLC == KeccakFPropagation::DC) ? "DC" : "LC");
+    for(unsigned int i=0; i<arguments.size(); i++)
+        description << " " << arguments[i];
+    return description.str();
+}
+
+int BatchJob::getInteger(unsigned int i) const
+{
+    if (i >= arguments.size())
+        throw BatchJobException("The job '" + getDescription() + "' has too few parameters.");
+    char *end;
+    long value = strtol(arguments[i].c_str(), &end, 10);
+    if ((end == arguments[i].c_str()) || (*end != 0))
+        throw BatchJobException("The parameter '" + arguments[i] + "' of the job '" + getDescription() + "' is not an integer.");
+    return (int)value;
+}
+
+string BatchJob::getArgument(unsigned int i, const string& defaultValue) const
+{
+    return (i < arguments.size()) ? arguments[i] : defaultValue;
+}
+
+BatchJobRunner::BatchJobRunner()
+    : nrThreads(0)
+{
+}
+
+void BatchJobRunner::addHandler(const string& kind, unsigned int minNrArguments, const string& usage, const Handler& handler)
+{
+    Kind& k = kinds[kind];
+    k.minNrArguments = minNrArguments;
+    k.usage = usage;
+    k.handler = handler;
+}
+
+void BatchJobRunner::addJob(const string& line)
+{
+    BatchJob job;
+    job.parse(line);
+    map<string, Kind>::const_iterator k = kinds.find(job.kind);
+    if (k == kinds.end())
+        throw BatchJobException("Unknown kind of job: " + job.kind);
+    if (job.arguments.size() < k->second.minNrArguments)
+        throw BatchJobException("The job '" + line + "' has too few parameters; expected: "
+            + job.kind + " width DC|LC " + k->second.usage);
+    job.index = jobs.size();
+    jobs.push_back(job);
+}
+
+unsigned int BatchJobRunner::load(const string& fileName)
+{
+    ifstream fin(fileName.c_str());
+    if (!fin)
+        throw BatchJobException("The job list " + fileName + " cannot be read.");
+    unsigned int count = 0;
+    string line;
+    while(getline(fin, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if ((first == string::npos) || (line[first] == '#'))
+            continue;
+        addJob(line);
+        count++;
+    }
+    return count;
+}
+
+const KeccakFDCLC& BatchJobRunner::getKeccakFDCLC(unsigned int width)
+{
+    shared_ptr<Shared<KeccakFDCLC> > shared;
+    {
+        lock_guard<mutex> guard(sharedLock);
+        shared_ptr<Shared<KeccakFDCLC> >& entry = sharedParents[width];
+        if (!entry)
+            entry.reset(new Shared<KeccakFDCLC>);
+        shared = entry;
+    }
+    // The other jobs that need the same instance wait until it is initialized.
+    call_once(shared->initialized, [&]() { shared->instance.reset(new KeccakFDCLC(width)); });
+    return *shared->instance;
+}
+
+const KeccakFPropagation& BatchJobRunner::getPropagation(unsigned int width, KeccakFPropagation::DCorLC DCorLC)
+{
+    const KeccakFDCLC& parent = getKeccakFDCLC(width);
+    shared_ptr<Shared<KeccakFPropagation> > shared;
+    {
+        lock_guard<mutex> guard(sharedLock);
+        shared_ptr<Shared<KeccakFPropagation> >& entry = sharedPropagations[make_pair(width, (int)DCorLC)];
+        if (!entry)
+            entry.reset(new Shared<KeccakFPropagation>);
+        shared = entry;
+    }
+    call_once(shared->initialized, [&]() { shared->instance.reset(new KeccakFPropagation(parent, DCorLC)); });
+    return *shared->instance;
+}
+
+void BatchJobRunner::runJob(const BatchJob& job, ostream& log)
+{
+    try {
+        kinds.find(job.kind)->second.handler(job, *this, log);
+    }
+    catch(Exception e) {
+        throw BatchJobException(e.reason);
+    }
+    catch(std::exception& e) {
+        throw BatchJobException(e.what());
+    }
+}
+
+unsigned int BatchJobRunner::run(ostream& fout)
+{
+    unsigned int n = nrThreads;
+    if (n == 0)
+        n = thread::hardware_concurrency();
+    if (n == 0)
+        n = 1;
+    if (n > jobs.size())
+        n = jobs.size();
+    atomic<unsigned int> next(0);
+    atomic<unsigned int> nrFailed(0);
+    mutex outputLock;
+    auto work = [&]() {
+        for(unsigned int i=next++; i<jobs.size(); i=next++) {
+            const BatchJob& job = jobs[i];
+            {
+                lock_guard<mutex> guard(outputLock);
+                fout << "[job " << dec << job.index << "] started: " << job.getDescription() << endl;
+            }
+            stringstream log;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            string failure;
+            try {
+                runJob(job, log);
+            }
+            catch(Exception e) {
+                failure = e.reason;
+                nrFailed++;
+            }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            lock_guard<mutex> guard(outputLock);
+            fout << log.str();
+            fout << "[job " << dec << job.index << "] " << (failure.empty() ? "done" : "failed: " + failure)
+                << " in " << seconds << " s" << endl;
+        }
+    };
+    vector<thread> workers;
+    for(unsigned int t=1; t<n; t++)
+        workers.push_back(thread(work));
+    work();
+    for(unsigned int t=0; t<workers.size(); t++)
+        workers[t].join();
+    jobs.clear();
+    return nrFailed;
+}
+
+void BatchJobRunner::displayUsage(ostream& fout) const
+{
+    for(map<string, Kind>::const_iterator k=kinds.begin(); k!=kinds.end(); ++k)
+        fout << k->first << " width DC|LC " << k->second.usage << endl;
+}
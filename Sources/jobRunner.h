@@ -0,0 +1,148 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _JOBRUNNER_H_
+#define _JOBRUNNER_H_
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Keccak-fDCLC.h"
+#include "Keccak-fPropagation.h"
+
+using namespace std;
+
+typedef Exception BatchJobException;
+
+/** This class describes one job of a BatchJobRunner, as read from one line of a job list:
+  * the kind of analysis, the width of Keccak-f, the type of propagation
+  * and the remaining parameters, whose meaning depends on the kind.
+  */
+class BatchJob {
+public:
+    /** The index of the job in the list, from 0. */
+    unsigned int index;
+    /** The kind of analysis, e.g., "extend". */
+    string kind;
+    /** The width of Keccak-f. */
+    unsigned int width;
+    /** The type of propagation. */
+    KeccakFPropagation::DCorLC DCorLC;
+    /** The remaining parameters, e.g., weight bounds and file names. */
+    vector<string> arguments;
+public:
+    /** This method reads a job from a line of the form
+      * "kind width DC|LC argument...".
+      * @param  line    The line.
+      * An exception is thrown if the line is malformed.
+      */
+    void parse(const string& line);
+    /** This method returns the job as a line that parse() can read. */
+    string getDescription() const;
+    /** This method returns a parameter as an integer.
+      * @param  i   The index of the parameter in @a arguments.
+      */
+    int getInteger(unsigned int i) const;
+    /** This method returns a parameter, or a default value if the job has fewer parameters.
+      * @param  i   The index of the parameter in @a arguments.
+      * @param  defaultValue    The value if the parameter is absent.
+      */
+    string getArgument(unsigned int i, const string& defaultValue) const;
+};
+
+/** This class runs a list of jobs concurrently on a pool of threads.
+  * Each kind of job is run by a handler registered with addHandler().
+  * The jobs share one KeccakFDCLC instance per width and one KeccakFPropagation
+  * instance per width and type of propagation, see getKeccakFDCLC() and getPropagation(),
+  * which are initialized once, by the first job that needs them, and are not modified afterwards.
+  *
+  * The job list is a text file with one job per line, see BatchJob::parse();
+  * empty lines and lines starting with '#' are ignored.
+  * Each handler writes its report to a stream of its own, which is displayed
+  * as one block when the job is done, so that the reports of concurrent jobs
+  * do not mix. A job that throws an exception is reported as failed
+  * and does not stop the other jobs.
+  */
+class BatchJobRunner {
+public:
+    /** The function that runs a job, writing its report to @a log. */
+    typedef function<void(const BatchJob& job, BatchJobRunner& runner, ostream& log)> Handler;
+    /** The number of jobs run at the same time, or 0 for one per hardware thread. */
+    unsigned int nrThreads;
+protected:
+    struct Kind {
+        unsigned int minNrArguments;
+        string usage;
+        Handler handler;
+    };
+    template<class T> struct Shared {
+        once_flag initialized;
+        unique_ptr<const T> instance;
+    };
+    map<string, Kind> kinds;
+    vector<BatchJob> jobs;
+    mutex sharedLock;
+    map<unsigned int, shared_ptr<Shared<KeccakFDCLC> > > sharedParents;
+    map<pair<unsigned int, int>, shared_ptr<Shared<KeccakFPropagation> > > sharedPropagations;
+public:
+    /** The constructor. */
+    BatchJobRunner();
+    /** This method registers the handler of a kind of job.
+      * @param  kind    The kind of job.
+      * @param  minNrArguments  The minimum number of parameters after the type of propagation.
+      * @param  usage   The description of the parameters, for the error messages.
+      * @param  handler The function that runs the jobs of this kind.
+      */
+    void addHandler(const string& kind, unsigned int minNrArguments, const string& usage, const Handler& handler);
+    /** This method appends a job to the list, after checking that its kind is known.
+      * @param  line    The job as a line, see BatchJob::parse().
+      */
+    void addJob(const string& line);
+    /** This method appends the jobs of a job list.
+      * @param  fileName    The name of the file with the job list.
+      * @return The number of jobs read.
+      */
+    unsigned int load(const string& fileName);
+    /** This method returns the number of jobs in the list. */
+    unsigned int getNumberOfJobs() const { return jobs.size(); }
+    /** This method returns the KeccakFDCLC instance shared by the jobs with a given width,
+      * initializing it if necessary. It can be called concurrently by the handlers.
+      * @param  width   The width of Keccak-f.
+      */
+    const KeccakFDCLC& getKeccakFDCLC(unsigned int width);
+    /** This method returns the KeccakFPropagation instance shared by the jobs with a given width
+      * and type of propagation, initializing it if necessary. It can be called concurrently by the handlers.
+      * @param  width   The width of Keccak-f.
+      * @param  DCorLC  The type of propagation.
+      */
+    const KeccakFPropagation& getPropagation(unsigned int width, KeccakFPropagation::DCorLC DCorLC);
+    /** This method runs all the jobs of the list and empties it.
+      * @param  fout    The stream to display the reports of the jobs to.
+      * @return The number of jobs that failed.
+      */
+    unsigned int run(ostream& fout);
+    /** This method displays the kinds of jobs and their parameters.
+      * @param  fout    The stream to display to.
+      */
+    void displayUsage(ostream& fout) const;
+protected:
+    void runJob(const BatchJob& job, ostream& log);
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <algorithm>
+#include <sstream>
+#include <string.h>
+#include <thread>
+#include "keystream.h"
+
+using namespace std;
+
+/** Calls body(first, last) on nrWorkers consecutive ranges covering [0, count), each in its own thread. */
+template<class Body>
+static void forEachRange(unsigned int count, unsigned int nrWorkers, Body body)
+{
+    nrWorkers = max(1U, min(nrWorkers, count));
+    vector<thread> threads;
+    for(unsigned int t=1; t<nrWorkers; t++)
+        threads.push_back(thread(body, (unsigned int)((UINT64)t*count/nrWorkers), (unsigned int)((UINT64)(t+1)*count/nrWorkers)));
+    body(0, (unsigned int)((UINT64)count/nrWorkers));
+    for(unsigned int t=0; t<threads.size(); t++)
+        threads[t].join();
+}
+
+KeystreamGenerator::KeystreamGenerator(const Transformation *aF, const PaddingRule *aPad, unsigned int aRate,
+    unsigned int aNrStreams, unsigned int aNrThreads)
+    : f(aF), pad(aPad), rate(aRate), nrStreams(aNrStreams), nrThreads(aNrThreads)
+{
+    unsigned int width = f->getWidth();
+    if ((rate == 0) || ((rate % 8) != 0))
+        throw KeystreamException("The rate must be a strictly positive multiple of 8.");
+    if (rate > width)
+        throw KeystreamException("The requested rate is too large when using this function.");
+    if (!pad->isRateValid(rate))
+        throw KeystreamException("The requested rate is incompatible with the padding rule.");
+    // As in Duplex::computeRhoMax(), but in whole bytes.
+    unsigned int rhoMax = 0;
+    while(pad->getPaddedSize(rate, rhoMax+1) <= rate)
+        rhoMax++;
+    maximumInputLengthInBytes = rhoMax/8;
+    if (maximumInputLengthInBytes == 0)
+        throw KeystreamException("The rate must allow at least one byte of input per duplexing call.");
+    stateSize = (width+7)/8;
+    states.assign((size_t)nrStreams*stateSize, 0);
+}
+
+void KeystreamGenerator::absorbBlock(UINT8 *state, const UINT8 *input, unsigned int inputLengthInBytes) const
+{
+    for(unsigned int i=0; i<inputLengthInBytes; i++)
+        state[i] ^= input[i];
+    if (!pad->padInPlace(rate, state, inputLengthInBytes*8))
+        throw KeystreamException("The input does not fit in one block after padding.");
+}
+
+void KeystreamGenerator::reseed(unsigned int stream, const UINT8 *seed, unsigned int seedLengthInBytes)
+{
+    if (stream >= nrStreams)
+        throw KeystreamException("The stream index is out of range.");
+    UINT8 *state = &states[(size_t)stream*stateSize];
+    unsigned int offset = 0;
+    do {
+        unsigned int length = min(maximumInputLengthInBytes, seedLengthInBytes - offset);
+        absorbBlock(state, seed + offset, length);
+        (*f)(state);
+        offset += length;
+    } while(offset < seedLengthInBytes);
+}
+
+void KeystreamGenerator::reseedAll(const UINT8 *seed, unsigned int seedLengthInBytes)
+{
+    forEachRange(nrStreams, nrThreads, [&](unsigned int first, unsigned int last) {
+        vector<UINT8> message(seed, seed + seedLengthInBytes);
+        message.resize(seedLengthInBytes + 4);
+        unsigned int messageLength = (unsigned int)message.size();
+        for(unsigned int offset=0; offset<messageLength; offset+=maximumInputLengthInBytes) {
+            unsigned int length = min(maximumInputLengthInBytes, messageLength - offset);
+            for(unsigned int stream=first; stream<last; stream++) {
+                for(unsigned int i=0; i<4; i++)
+                    message[seedLengthInBytes + i] = (UINT8)(stream >> (8*i));
+                absorbBlock(&states[(size_t)stream*stateSize], &message[offset], length);
+            }
+            f->applyBatch(&states[(size_t)first*stateSize], last - first);
+        }
+    });
+}
+
+void KeystreamGenerator::generateRange(const vector<UINT8 *>& outputs, UINT64 lengthInBytes, unsigned int first, unsigned int last)
+{
+    const unsigned int blockSize = rate/8;
+    for(UINT64 offset=0; offset<lengthInBytes; offset+=blockSize) {
+        for(unsigned int stream=first; stream<last; stream++)
+            absorbBlock(&states[(size_t)stream*stateSize], 0, 0);
+        f->applyBatch(&states[(size_t)first*stateSize], last - first);
+        size_t length = (size_t)min((UINT64)blockSize, lengthInBytes - offset);
+        for(unsigned int stream=first; stream<last; stream++)
+            memcpy(outputs[stream] + offset, &states[(size_t)stream*stateSize], length);
+    }
+}
+
+void KeystreamGenerator::generate(const vector<UINT8 *>& outputs, UINT64 lengthInBytes)
+{
+    if (outputs.size() != nrStreams)
+        throw KeystreamException("There must be one output buffer per stream.");
+    forEachRange(nrStreams, nrThreads, [&](unsigned int first, unsigned int last) {
+        generateRange(outputs, lengthInBytes, first, last);
+    });
+}
+
+void KeystreamGenerator::generate(unsigned int stream, UINT8 *output, UINT64 lengthInBytes)
+{
+    if (stream >= nrStreams)
+        throw KeystreamException("The stream index is out of range.");
+    const unsigned int blockSize = rate/8;
+    UINT8 *state = &states[(size_t)stream*stateSize];
+    for(UINT64 offset=0; offset<lengthInBytes; offset+=blockSize) {
+        absorbBlock(state, 0, 0);
+        (*f)(state);
+        memcpy(output + offset, state, (size_t)min((UINT64)blockSize, lengthInBytes - offset));
+    }
+}
+
+string KeystreamGenerator::getDescription() const
+{
+    stringstream a;
+    a << "KeystreamGenerator[f=" << (*f) << ", pad=" << (*pad)
+        << ", r=" << dec << rate
+        << ", streams=" << nrStreams
+        << ", threads=" << nrThreads
+        << "]";
+    return a.str();
+}
+
+ostream& operator<<(ostream& a, const KeystreamGenerator& generator)
+{
+    return a << generator.getDescription();
+}
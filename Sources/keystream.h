@@ -0,0 +1,127 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KEYSTREAM_H_
+#define _KEYSTREAM_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "padding.h"
+#include "transformations.h"
+#include "types.h"
+
+using namespace std;
+
+typedef Exception KeystreamException;
+
+/**
+  * Class that runs many independent keystreams, or deterministic random bit
+  * generators, each being a duplex object with the same transformation,
+  * padding rule and rate.
+  * Stream @a i behaves exactly as a Duplex object that would go through the
+  * same calls: reseeding is a sequence of duplexing calls without output,
+  * and each block of keystream is the output of a duplexing call with an
+  * empty input.
+  * The states of all the streams are stored one after the other, so that
+  * the streams go through the transformation together with
+  * Transformation::applyBatch(), and are split among several threads when
+  * requested. The keystream is written directly into the buffers of the caller.
+  */
+class KeystreamGenerator {
+protected:
+    /** The transformation (or permutation) used by the duplex construction.
+      * The memory allocated by f is assumed to belong to the caller;
+      * this class does not free the allocated memory.
+      */
+    const Transformation *f;
+    /** The padding rule used by the duplex construction.
+      * The memory allocated by pad is assumed to belong to the caller;
+      * this class does not free the allocated memory.
+      */
+    const PaddingRule *pad;
+    /** The rate of the duplex construction, a multiple of 8. */
+    unsigned int rate;
+    /** The maximum input length in bytes of a duplexing call. */
+    unsigned int maximumInputLengthInBytes;
+    /** The size of a state in bytes. */
+    unsigned int stateSize;
+    /** The number of streams. */
+    unsigned int nrStreams;
+    /** The number of threads among which the streams are split. */
+    unsigned int nrThreads;
+    /** The states of the streams, one after the other. */
+    vector<UINT8> states;
+public:
+    /**
+      * The constructor. All the streams start from the all-zero state,
+      * so they must be seeded with reseed() or reseedAll().
+      *
+      * @param  aF          A pointer to the transformation used in the duplex construction.
+      * @param  aPad        A pointer to the padding rule used in the duplex construction.
+      * @param  aRate       The rate (in bits), which must be a multiple of 8.
+      * @param  aNrStreams  The number of streams.
+      * @param  aNrThreads  The number of threads generate() and reseedAll() use.
+      */
+    KeystreamGenerator(const Transformation *aF, const PaddingRule *aPad, unsigned int aRate,
+        unsigned int aNrStreams, unsigned int aNrThreads = 1);
+    /**
+      * Method that absorbs @a seed into stream @a stream, as a sequence of
+      * duplexing calls without output, each with at most
+      * getMaximumInputLength()/8 bytes of the seed.
+      * An empty seed still gives one duplexing call.
+      */
+    void reseed(unsigned int stream, const UINT8 *seed, unsigned int seedLengthInBytes);
+    /**
+      * Method that absorbs into each stream @a seed followed by the index
+      * of the stream on 4 bytes, least significant first, as with reseed(),
+      * so that the streams derived from the same seed are independent.
+      */
+    void reseedAll(const UINT8 *seed, unsigned int seedLengthInBytes);
+    /**
+      * Method that writes @a lengthInBytes bytes of keystream of each stream
+      * into the corresponding buffer of @a outputs.
+      * The keystream is produced one block of getRate()/8 bytes at a time;
+      * when @a lengthInBytes is not a multiple of this block size,
+      * the rest of the last block is discarded.
+      *
+      * @param  outputs     One buffer of at least @a lengthInBytes bytes per stream.
+      * @param  lengthInBytes   The number of bytes to write into each buffer.
+      */
+    void generate(const vector<UINT8 *>& outputs, UINT64 lengthInBytes);
+    /**
+      * Method that writes @a lengthInBytes bytes of keystream of stream @a stream
+      * into @a output, like generate() but for a single stream.
+      */
+    void generate(unsigned int stream, UINT8 *output, UINT64 lengthInBytes);
+    /** Method that returns the number of streams. */
+    unsigned int getNrStreams() const { return nrStreams; }
+    /** Method that returns the rate in bits. */
+    unsigned int getRate() const { return rate; }
+    /** Method that returns the maximum input length in bits of a duplexing call. */
+    unsigned int getMaximumInputLength() const { return maximumInputLengthInBytes*8; }
+    /** Method that returns a string with a description of itself. */
+    string getDescription() const;
+    /** Method that prints a brief description of the generator. */
+    friend ostream& operator<<(ostream& a, const KeystreamGenerator& generator);
+protected:
+    /** Internal method that XORs @a input and the padding into the state @a state,
+      * for a duplexing call whose permutation is applied by the caller. */
+    void absorbBlock(UINT8 *state, const UINT8 *input, unsigned int inputLengthInBytes) const;
+    /** Internal method that writes the keystream of the streams from @a first to @a last (excluded). */
+    void generateRange(const vector<UINT8 *>& outputs, UINT64 lengthInBytes, unsigned int first, unsigned int last);
+};
+
+#endif
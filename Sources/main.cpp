@@ -11,29 +11,49 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string.h>
+#include <thread>
+#include "checkpoint.h"
 #include "duplex.h"
+#include "fileHashing.h"
+#include "jobRunner.h"
 #include "Keccak.h"
+#include "KeccakCollisionSearch.h"
 #include "KeccakCrunchyContest.h"
 #include "Keccak-f25LUT.h"
+#include "Keccak-fBenchmark.h"
 #include "Keccak-fCodeGen.h"
 #include "Keccak-fDCEquations.h"
 #include "Keccak-fDCLC.h"
+#include "Keccak-fDisplay.h"
 #include "Keccak-fEquations.h"
 #include "Keccak-fPropagation.h"
 #include "Keccak-fTrailExtension.h"
+#include "Keccak-fTrailCheck.h"
+#include "Keccak-fTrailCoreParity.h"
 #include "Keccak-fTrailExtensionBasedOnParity.h"
+#include "Keccak-fTrailPipeline.h"
+#include "Keccak-fTrailProbability.h"
 #include "Keccak-fTrails.h"
+#include "Keccak-fTrailBenchmark.h"
+#include "Keccak-fTrailSort.h"
 #include "Keccak-fTree.h"
+#include "Keccak-fWeightDistribution.h"
 #include "Keyakv2-test.h"
 #include "Ketjev2-test.h"
 #include "Kravatte.h"
 #include "Kravatte-test.h"
 #include "KravatteModes-test.h"
+#include "modesBenchmark.h"
+#include "workUnits.h"
 
 using namespace std;
 
@@ -191,6 +211,24 @@ void generateCode()
         keccakF.setInterleavingFactor(2);
         keccakF.genMacroFile(fout, true);
     }
+
+    {
+        KeccakFCodeGen keccakF(1600);
+
+        string fileName = keccakF.buildFileName("", "-times4-AVX2.macros");
+        ofstream fout(fileName.c_str());
+        keccakF.setSIMDInstructionSet(KeccakFCodeGen::AVX2);
+        keccakF.genMacroFile(fout, true);
+    }
+
+    {
+        KeccakFCodeGen keccakF(1600);
+
+        string fileName = keccakF.buildFileName("", "-times8-AVX512.macros");
+        ofstream fout(fileName.c_str());
+        keccakF.setSIMDInstructionSet(KeccakFCodeGen::AVX512);
+        keccakF.genMacroFile(fout, true);
+    }
 }
 
 /** Example function that uses the Keccak-f[25] look-up tables.
@@ -208,7 +246,7 @@ void testKeccakF25LUT()
     }
 }
 
-void genKATShortMsg_main();
+void genKATShortMsg_main(unsigned int nrThreads = 0);
 
 /** Example function that displays DC/LC propagation on rows.
   */
@@ -352,6 +390,11 @@ void generateDCTrailEquations()
         ofstream fout(fileName.c_str());
         keccakFDCEq.genDCEquations(fout, trail);
     }
+    {
+        string fileName = string("DC") + keccakFDCEq.getName() + "-equations.cnf";
+        ofstream fout(fileName.c_str());
+        keccakFDCEq.genDCEquationsCNF(fout, trail);
+    }
 }
 
 /** Example function that generates a trail from a pair of inputs.
@@ -432,6 +475,8 @@ void generateTrailFromDinurDunkelmanShamirCollision()
     }
 }
 
+void extendTrails(KeccakFTrailExtension& keccakFTE, const string& inFileName, const string& outFileName, unsigned int nrRounds, int maxWeight, bool reverse, bool allPrefixes, ostream& fout);
+
 /** Example function that takes trails from a file and extends them
   * forward or backward up to a given weight and given number of rounds.
   * @param  DCLC    Whether linear or differential trails are processed.
@@ -465,21 +510,8 @@ void extendTrails(KeccakFPropagation::DCorLC DCLC, unsigned int width, const str
         }
 
         try {
-            TrailFileIterator trailsIn(inFileName, keccakFTE);
-            cout << trailsIn << endl;
             string outFileName = inFileName + (reverse ? string("-rev") : string("-dir"));
-            ofstream fout(outFileName.c_str());
-            TrailSaveToFile trailsOut(fout);
-            if (reverse) {
-                keccakFTE.showMinimalTrails = true;
-                keccakFTE.allPrefixes = allPrefixes;
-                keccakFTE.backwardExtendTrails(trailsIn, trailsOut, nrRounds, maxWeight);
-            }
-            else {
-                keccakFTE.showMinimalTrails = true;
-                keccakFTE.forwardExtendTrails(trailsIn, trailsOut, nrRounds, maxWeight);
-            }
-            Trail::produceHumanReadableFile(keccakFTE, outFileName);
+            extendTrails(keccakFTE, inFileName, outFileName, nrRounds, maxWeight, reverse, allPrefixes, cout);
         }
         catch(TrailException e) {
             cout << e.reason << endl;
@@ -490,6 +522,50 @@ void extendTrails(KeccakFPropagation::DCorLC DCLC, unsigned int width, const str
     }
 }
 
+/** This function does the extension of extendTrails() with a given KeccakFTrailExtension instance,
+  * from @a inFileName to @a outFileName, and displays the input file to @a fout.
+  */
+void extendTrails(KeccakFTrailExtension& keccakFTE, const string& inFileName, const string& outFileName, unsigned int nrRounds, int maxWeight, bool reverse, bool allPrefixes, ostream& fout)
+{
+    TrailFileIterator trailsIn(inFileName, keccakFTE);
+    fout << trailsIn << endl;
+    TrailSaveToFileAsync trailsOut(outFileName);
+    if (reverse) {
+        keccakFTE.showMinimalTrails = true;
+        keccakFTE.allPrefixes = allPrefixes;
+        keccakFTE.backwardExtendTrails(trailsIn, trailsOut, nrRounds, maxWeight);
+    }
+    else {
+        keccakFTE.showMinimalTrails = true;
+        keccakFTE.forwardExtendTrails(trailsIn, trailsOut, nrRounds, maxWeight);
+    }
+    trailsOut.close();
+    Trail::produceHumanReadableFile(keccakFTE, outFileName);
+}
+
+/** Example function that looks for the @a nrTrails lightest trails with @a nrRounds rounds
+  * that extend forward the trails of @a inFileName, best first,
+  * see KeccakFTrailExtension::bestFirstForwardExtendTrails().
+  */
+void bestFirstExtendTrails(unsigned int width, KeccakFPropagation::DCorLC DCLC, const string& inFileName, unsigned int nrRounds, int maxWeight, UINT64 nrTrails)
+{
+    KeccakFDCLC keccakF(width);
+    KeccakFTrailExtension keccakFTE(keccakF, DCLC);
+    keccakFTE.showMinimalTrails = true;
+    TrailFileIterator trailsIn(inFileName, keccakFTE);
+    cout << trailsIn << endl;
+    string outFileName = inFileName + "-best";
+    int exhaustiveBelow;
+    {
+        ofstream fout(outFileName.c_str());
+        TrailSaveToFile trailsOut(fout);
+        exhaustiveBelow = keccakFTE.bestFirstForwardExtendTrails(trailsIn, trailsOut, nrRounds, maxWeight, nrTrails);
+    }
+    if (exhaustiveBelow <= maxWeight)
+        cout << "The search was exhaustive only below weight " << dec << exhaustiveBelow << "." << endl;
+    Trail::produceHumanReadableFile(keccakFTE, outFileName);
+}
+
 /** Example function that uses extendTrails().
   */
 void extendTrails()
@@ -499,9 +575,52 @@ void extendTrails()
     extendTrails(KeccakFPropagation::LC, 1600, "LCKeccakF-1600-trailcores", 4, 100, false);
 }
 
+// This function traverses a tree sequentially and calls visit() for each node.
+// If a checkpoint is given, the traversal resumes from it if relevant,
+// and the current node is periodically saved in it.
+template<class Iterator, class Visit>
+static void traverseTreeWithCheckpoint(Iterator& iterator, SearchCheckpoint *checkpoint, Visit visit)
+{
+    if ((checkpoint != 0) && checkpoint->isResuming()) {
+        iterator.resume(checkpoint->getCursor());
+        ++iterator;
+    }
+    for (; !iterator.isEnd(); ++iterator) {
+        TwoRoundTrailCore node = *iterator;
+        visit(node);
+        if ((checkpoint != 0) && checkpoint->isDue()) {
+            vector<UINT64> cursor;
+            iterator.getCursor(cursor);
+            checkpoint->save(cursor);
+        }
+    }
+    if (checkpoint != 0)
+        checkpoint->complete();
+}
+
+// This function opens the output file of a tree traversal, with a checkpoint if checkpointInterval is not zero.
+static SearchCheckpoint *openTreeTraversalOutput(ofstream& fout, const string& oFileName, const string& description, unsigned int checkpointInterval)
+{
+    if (checkpointInterval == 0) {
+        fout.open(oFileName.c_str());
+        return 0;
+    }
+    SearchCheckpoint *checkpoint = new SearchCheckpoint(oFileName + ".checkpoint", description, checkpointInterval);
+    checkpoint->openOutput(fout, oFileName);
+    if (checkpoint->isResuming())
+        cout << "Resuming from " << oFileName << ".checkpoint" << endl;
+    return checkpoint;
+}
+
 // This function outputs a file with 2-round trail cores in the kernel with cost below given limit.
+// With nrThreads different from 1, the tree is traversed with a pool of threads (0 means as many as the hardware supports),
+// and the trail cores appear in the file in a non-deterministic order.
+// With checkpointInterval different from 0, the traversal is sequential and saves a checkpoint
+// every checkpointInterval seconds, from which a later call with the same parameters resumes.
 // An example function to use it is given below.
-void traverseOrbitalTree(KeccakFPropagation::DCorLC DCLC, unsigned int width, unsigned int maxCost, unsigned int alpha, unsigned int beta)
+string traverseOrbitalTree(const KeccakFPropagation& keccakProp, unsigned int maxCost, unsigned int alpha, unsigned int beta, unsigned int nrThreads, unsigned int checkpointInterval);
+
+void traverseOrbitalTree(KeccakFPropagation::DCorLC DCLC, unsigned int width, unsigned int maxCost, unsigned int alpha, unsigned int beta, unsigned int nrThreads = 1, unsigned int checkpointInterval = 0)
 {
     (void)DCLC;
     cout << "Initializing... " << flush;
@@ -511,6 +630,15 @@ void traverseOrbitalTree(KeccakFPropagation::DCorLC DCLC, unsigned int width, un
     cout << keccakFDCLC << endl;
     cout << "Initialized " << flush;
     cout << endl;
+    traverseOrbitalTree(keccakProp, maxCost, alpha, beta, nrThreads, checkpointInterval);
+}
+
+/** This function does the traversal of traverseOrbitalTree() with a given KeccakFPropagation instance
+  * and returns the name of the output file.
+  */
+string traverseOrbitalTree(const KeccakFPropagation& keccakProp, unsigned int maxCost, unsigned int alpha, unsigned int beta, unsigned int nrThreads, unsigned int checkpointInterval)
+{
+    unsigned int width = keccakProp.laneSize*25;
 
     // output file
     stringstream FileName;
@@ -518,7 +646,10 @@ void traverseOrbitalTree(KeccakFPropagation::DCorLC DCLC, unsigned int width, un
     FileName << "Below-";
     FileName << maxCost;
     string oFileName = FileName.str();
-    ofstream fout(oFileName.c_str());
+    stringstream description;
+    description << "traverseOrbitalTree " << dec << width << " " << maxCost << " " << alpha << " " << beta;
+    ofstream fout;
+    unique_ptr<SearchCheckpoint> checkpoint(openTreeTraversalOutput(fout, oFileName, description.str(), checkpointInterval));
     TrailSaveToFile trailsOut(fout);
 
     TwoRoundTrailCoreCostFunction costF(alpha, beta);
@@ -527,18 +658,82 @@ void traverseOrbitalTree(KeccakFPropagation::DCorLC DCLC, unsigned int width, un
 
     OrbitalTreeIterator iterator(orbSet, cache, costF, maxCost);
 
-    for (; !iterator.isEnd(); ++iterator) {
-        TwoRoundTrailCore node = *iterator;
-        node.save(fout);
+    if ((nrThreads == 1) || checkpoint) {
+        traverseTreeWithCheckpoint(iterator, checkpoint.get(), [&](TwoRoundTrailCore& node) {
+            node.save(fout);
+        });
+    }
+    else {
+        mutex outputLock;
+        ParallelTreeTraversal<OrbitalTreeIterator, TwoRoundTrailCore> traversal(nrThreads);
+        traversal.run(iterator, [&](const TwoRoundTrailCore& aNode, unsigned int) {
+            TwoRoundTrailCore node = aNode;
+            stringstream sout;
+            node.save(sout);
+            lock_guard<mutex> guard(outputLock);
+            fout << sout.str();
+        });
     }
 
     Trail::produceHumanReadableFile(keccakProp, oFileName);
+    return oFileName;
+}
+
+// This function saves the 2-round trail core of a node of the run tree outside the kernel,
+// followed by the nodes of the orbital tree that has it at its root.
+static void saveRunNodeAndOrbitalTree(const KeccakFPropagation& keccakProp, TwoRoundTrailCore& nodeRun, unsigned int maxCost, unsigned int alpha, unsigned int beta, ostream& fout)
+{
+    unsigned int laneSize = keccakProp.laneSize;
+    unsigned int costNodeRun = alpha*nodeRun.w0 + beta*nodeRun.w1;
+    bool completeNodeRun = nodeRun.complete;
+
+    if (costNodeRun <= maxCost && completeNodeRun){
+        nodeRun.save(fout);
+        TwoRoundTrailCoreStack cacheOrb(keccakProp, nodeRun.stateA, nodeRun.stateB, nodeRun.w0, nodeRun.w1, completeNodeRun, nodeRun.zPeriod);
+        TwoRoundTrailCoreCostFunction costFOrb(alpha, beta);
+
+        vector<RowValue> C(nodeRun.C), D(nodeRun.D);
+        vector<unsigned int> yMin(5 * laneSize, 0);
+
+        for (unsigned int x = 0; x < 5; x++){
+            for (unsigned int z = 0; z < laneSize; z++) {
+                bool odd = (getBit(C, x, z) != 0);
+                bool affected = (getBit(D, x, z) != 0);
+                if (affected) {
+                    yMin[x + 5 * z] = 5; // no orbitals here
+                }
+                else{
+                    if (odd){
+                        for (unsigned int y = 0; y < 5; y++){
+                            if (getBit(nodeRun.stateA, x, y, z) != 0){
+                                yMin[x + 5 * z] = y + 1;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
 
+        // orbital tree with parity-bare trail core at root
+        OrbitalsSet orbSet(yMin, laneSize);
+        OrbitalTreeIterator iteratorOrb(orbSet, cacheOrb, costFOrb, maxCost);
+
+        for (; !iteratorOrb.isEnd(); ++iteratorOrb) {
+            TwoRoundTrailCore nodeOrb = *iteratorOrb;
+            nodeOrb.save(fout);
+        }
+    }
 }
 
 // This function outputs a file with 2-round trail cores outside the kernel with cost below given limit.
+// With nrThreads different from 1, the run tree is traversed with a pool of threads (0 means as many as the hardware supports),
+// each orbital tree being traversed by the thread that visits its root,
+// and the trail cores appear in the file in a non-deterministic order.
+// With checkpointInterval different from 0, the traversal is sequential and saves a checkpoint
+// every checkpointInterval seconds, from which a later call with the same parameters resumes.
 // An example function to use it is given below
-void traverseRunTreeAndOrbitalTree(KeccakFPropagation::DCorLC DCLC, unsigned int width, unsigned int maxCost, unsigned int alpha, unsigned int beta)
+void traverseRunTreeAndOrbitalTree(KeccakFPropagation::DCorLC DCLC, unsigned int width, unsigned int maxCost, unsigned int alpha, unsigned int beta, unsigned int nrThreads = 1, unsigned int checkpointInterval = 0)
 {
     (void)DCLC;
     unsigned int laneSize = width / 25;
@@ -557,7 +752,10 @@ void traverseRunTreeAndOrbitalTree(KeccakFPropagation::DCorLC DCLC, unsigned int
     FileName << "Below";
     FileName << maxCost;
     string oFileName = FileName.str();
-    ofstream fout(oFileName.c_str());
+    stringstream description;
+    description << "traverseRunTreeAndOrbitalTree " << dec << width << " " << maxCost << " " << alpha << " " << beta;
+    ofstream fout;
+    unique_ptr<SearchCheckpoint> checkpoint(openTreeTraversalOutput(fout, oFileName, description.str(), checkpointInterval));
     TrailSaveToFile trailsOut(fout);
 
     TwoRoundTrailCoreCostBoundFunction costFRun(alpha, beta);
@@ -566,50 +764,21 @@ void traverseRunTreeAndOrbitalTree(KeccakFPropagation::DCorLC DCLC, unsigned int
 
     RunTreeIterator iteratorRun(colSet, cacheRun, costFRun, maxCost);
 
-    //unsigned int counter = 0;
-
-    for (; !iteratorRun.isEnd(); ++iteratorRun) {
-        TwoRoundTrailCore nodeRun = *iteratorRun;
-        unsigned int costNodeRun = alpha*nodeRun.w0 + beta*nodeRun.w1;
-        bool completeNodeRun = nodeRun.complete;
-
-        if (costNodeRun <= maxCost && completeNodeRun){
-            nodeRun.save(fout);
-            TwoRoundTrailCoreStack cacheOrb(keccakProp, nodeRun.stateA, nodeRun.stateB, nodeRun.w0, nodeRun.w1, completeNodeRun, nodeRun.zPeriod);
-            TwoRoundTrailCoreCostFunction costFOrb(alpha, beta);
-
-            vector<RowValue> C(nodeRun.C), D(nodeRun.D);
-            vector<unsigned int> yMin(5 * laneSize, 0);
-
-            for (unsigned int x = 0; x < 5; x++){
-                for (unsigned int z = 0; z < laneSize; z++) {
-                    bool odd = (getBit(C, x, z) != 0);
-                    bool affected = (getBit(D, x, z) != 0);
-                    if (affected) {
-                        yMin[x + 5 * z] = 5; // no orbitals here
-                    }
-                    else{
-                        if (odd){
-                            for (unsigned int y = 0; y < 5; y++){
-                                if (getBit(nodeRun.stateA, x, y, z) != 0){
-                                    yMin[x + 5 * z] = y + 1;
-                                    break;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-
-            // orbital tree with parity-bare trail core at root
-            OrbitalsSet orbSet(yMin, laneSize);
-            OrbitalTreeIterator iteratorOrb(orbSet, cacheOrb, costFOrb, maxCost);
-
-            for (; !iteratorOrb.isEnd(); ++iteratorOrb) {
-                TwoRoundTrailCore nodeOrb = *iteratorOrb;
-                nodeOrb.save(fout);
-            }
-        }
+    if ((nrThreads == 1) || checkpoint) {
+        traverseTreeWithCheckpoint(iteratorRun, checkpoint.get(), [&](TwoRoundTrailCore& nodeRun) {
+            saveRunNodeAndOrbitalTree(keccakProp, nodeRun, maxCost, alpha, beta, fout);
+        });
+    }
+    else {
+        mutex outputLock;
+        ParallelTreeTraversal<RunTreeIterator, TwoRoundTrailCore> traversal(nrThreads);
+        traversal.run(iteratorRun, [&](const TwoRoundTrailCore& aNode, unsigned int) {
+            TwoRoundTrailCore nodeRun = aNode;
+            stringstream sout;
+            saveRunNodeAndOrbitalTree(keccakProp, nodeRun, maxCost, alpha, beta, sout);
+            lock_guard<mutex> guard(outputLock);
+            fout << sout.str();
+        });
     }
 
     Trail::produceHumanReadableFile(keccakProp, oFileName);
@@ -771,50 +940,592 @@ void backwardExtendOutsideKernel(){
 
 }
 
-// this function computes the number of round differentials per weight for a given Keccak width
-void weightDistributions(unsigned int width)
-{
-    unsigned int laneSize = width / 25;
-    unsigned int numRows = width / 5;
+// this function computes the number of round differentials or linear approximations per weight for a given Keccak width
+string weightDistributions(const KeccakFPropagation& keccakProp);
 
+void weightDistributions(unsigned int width, KeccakFPropagation::DCorLC DCLC = KeccakFPropagation::DC)
+{
     cout << "Initializing... " << flush;
     KeccakFDCLC keccakFDCLC(width);
-    KeccakFPropagation keccakProp(keccakFDCLC, KeccakFPropagation::DC);
+    KeccakFPropagation keccakProp(keccakFDCLC, DCLC);
     cout << keccakFDCLC << endl;
-    // output file
-    stringstream outFileName;
-    outFileName << keccakProp.buildFileName("-weightDistributions");
-    string oFileName = outFileName.str();
+    cout << "Weight distributions written to " << weightDistributions(keccakProp) << endl;
+}
+
+/** This function computes the exact weight distributions of weightDistributions() with a given
+  * KeccakFPropagation instance and returns the name of the output file.
+  */
+string weightDistributions(const KeccakFPropagation& keccakProp)
+{
+    KeccakFWeightDistribution distribution(keccakProp);
+    string oFileName = keccakProp.buildFileName("-weightDistributions");
     ofstream fout(oFileName.c_str());
+    distribution.save(fout);
+    return oFileName;
+}
+
+/** This function computes the weight distributions of all the widths of Keccak-<i>f</i>,
+  * for both DC and LC, each in its own thread, and lists the output files.
+  */
+void allWeightDistributions()
+{
+    vector<string> fileNames;
+    vector<thread> workers;
+    mutex outputMutex;
+    for(unsigned int width=25; width<=1600; width*=2)
+        for(unsigned int i=0; i<2; i++) {
+            KeccakFPropagation::DCorLC DCLC = (i == 0) ? KeccakFPropagation::DC : KeccakFPropagation::LC;
+            workers.push_back(thread([&, width, DCLC]() {
+                KeccakFDCLC keccakFDCLC(width);
+                KeccakFPropagation keccakProp(keccakFDCLC, DCLC);
+                string fileName = weightDistributions(keccakProp);
+                lock_guard<mutex> lock(outputMutex);
+                fileNames.push_back(fileName);
+            }));
+        }
+    for(unsigned int i=0; i<workers.size(); i++)
+        workers[i].join();
+    sort(fileNames.begin(), fileNames.end());
+    for(unsigned int i=0; i<fileNames.size(); i++)
+        cout << "Weight distributions written to " << fileNames[i] << endl;
+}
+
+/** Example function that outputs the SHA3-256 hash of files, with
+  * the throughput on the standard error.
+  */
+void hashFiles(const vector<string>& fileNames)
+{
+    const UINT8 SHA3suffix = 0x02; // the bits 01, least significant bit first
+    for(unsigned int i=0; i<fileNames.size(); i++) {
+        Keccak keccak(1088, 512);
+        UINT8 digest[32];
+        hashFile(keccak, fileNames[i], digest, 256, &SHA3suffix, 2, &cerr);
+        for(unsigned int j=0; j<32; j++)
+            cout << hex << setw(2) << setfill('0') << (int)digest[j];
+        cout << "  " << fileNames[i] << endl;
+    }
+}
 
-    RowValue rowVal;
-    int i;
-    unsigned int numRowsPerWeight[nrRowsAndColumns]; // table where numRowsPerWeight[i] contains the number of row inputs with weight i
-    double wattab0[20000], wattab1[20000]; // these tables will contain the final number of states with given weight. numbers can grow quite large, hence they are double
+void convertTrailFile(const string& inFileName, const string& outFileName)
+{
+    UINT64 count;
+    if (Trail::isBinaryFile(inFileName))
+        count = Trail::convertToText(inFileName, outFileName);
+    else
+        count = Trail::convertToBinary(inFileName, outFileName);
+    cout << dec << count << " trails converted from " << inFileName << " to " << outFileName << endl;
+}
+
+/** Example function that sorts the trails of several files by weight
+  * and removes the duplicates up to translation, see TrailFileSorter.
+  */
+void sortTrailFiles(const vector<string>& inFileNames, const string& outFileName, unsigned int bucketWidth)
+{
+    TrailFileSorter sorter;
+    sorter.bucketWidth = bucketWidth;
+    sorter.sort(inFileNames, outFileName);
+    cout << dec << sorter.getNumberOfTrailsRead() << " trails read, ";
+    cout << sorter.getNumberOfDuplicates() << " duplicates removed, ";
+    cout << sorter.getNumberOfTrailsWritten() << " trails written to " << outFileName;
+    cout << " (" << sorter.getNumberOfRuns() << " runs)" << endl;
+}
+
+/** Example function that keeps the trails of a file up to a given weight,
+  * without the trails equivalent by translation, through a TrailPipeline.
+  */
+void filterTrailFile(const KeccakFPropagation& DCorLC, const string& inFileName, const string& outFileName, unsigned int maxWeight, ostream& fout)
+{
+    TrailFileIterator trailsIn(inFileName, DCorLC, false);
+    TrailFilterTotalWeight weightFilter(maxWeight);
+    TrailFilterUniqueUpToTranslation uniqueFilter;
+    TrailSaveToFileAsync trailsOut(outFileName);
+    TrailPipeline pipeline(DCorLC);
+    pipeline.addFilter(&weightFilter);
+    pipeline.addFilter(&uniqueFilter);
+    pipeline.addSink(&trailsOut);
+    UINT64 count = pipeline.run(trailsIn);
+    trailsOut.close();
+    fout << dec << pipeline.getNumberOfTrailsRead() << " trails read, ";
+    fout << pipeline.getNumberOfTrailsKept(0) << " up to weight " << maxWeight << ", ";
+    fout << count << " written to " << outFileName << endl;
+}
 
-    // fill weight table for rows
-    for(i = 0; i<nrRowsAndColumns; i++)
-        numRowsPerWeight[i] = 0;
-    for (rowVal = 0; rowVal<(1 << nrRowsAndColumns); rowVal++)
-        numRowsPerWeight[keccakProp.getWeightRow(rowVal)]++;
+void filterTrailFile(unsigned int width, KeccakFPropagation::DCorLC DCLC, const string& inFileName, const string& outFileName, unsigned int maxWeight)
+{
+    KeccakFDCLC keccakF(width);
+    KeccakFPropagation DCorLC(keccakF, DCLC);
+    filterTrailFile(DCorLC, inFileName, outFileName, maxWeight, cout);
+}
 
-    for (i = 0; i<20000; i++) wattab0[i] = wattab1[i] = 0;
-    wattab1[0] = 1;
-    for (unsigned int j = 0; j<numRows; j++){
-        for (i = 0; i<int(j*nrRowsAndColumns) + 1; i++) wattab0[i] = wattab1[i]; // copy wattab1 into wattab0
-        for (i = 0; i<int(j*nrRowsAndColumns) + 1; i++) wattab1[i] = 0; // clear wattab1
-        for (i = 0; i<int(j + 1)*nrRowsAndColumns; i++){
-            for (int k = 0; k<nrRowsAndColumns; k++) wattab1[i + k] += wattab0[i] * numRowsPerWeight[k]; // convolution, as many as there are "rows"
+/** Example function that searches for preimages of a reduced-round Keccak instance
+  * among the messages of a given length whose first bits are free and the others are zero,
+  * see ReducedRoundKeccakPreimageSearch. The image is given in hexadecimal,
+  * and only its first @a matchLength bits have to match.
+  */
+void searchPreimages(unsigned int rate, unsigned int capacity, int startRoundIndex, unsigned int nrRounds,
+    const string& imageInHex, unsigned int matchLength, unsigned int messageLength, unsigned int nrFreeBits)
+{
+    vector<UINT8> image;
+    for(unsigned int i=0; i+1<imageInHex.size(); i+=2)
+        image.push_back((UINT8)strtoul(imageInHex.substr(i, 2).c_str(), 0, 16));
+    ReducedRoundKeccakPreimageSearch search(rate, capacity, startRoundIndex, nrRounds, image, matchLength);
+    vector<unsigned int> freeBits;
+    for(unsigned int i=0; i<nrFreeBits; i++)
+        freeBits.push_back(i);
+    search.setSearchSpace(vector<UINT8>(), messageLength, freeBits);
+    vector<UINT64> hits;
+    search.search(0, (nrFreeBits >= 64) ? ~(UINT64)0 : ((UINT64)1 << nrFreeBits), hits);
+    for(unsigned int i=0; i<hits.size(); i++) {
+        vector<UINT8> message;
+        search.getCandidate(hits[i], message);
+        cout << "Hit: ";
+        for(unsigned int j=0; j<message.size(); j++)
+            cout << hex << setw(2) << setfill('0') << (int)message[j];
+        cout << endl;
+    }
+    cout << dec << hits.size() << " hit(s) among " << search.getNumberOfCandidatesTried() << " candidates in ";
+    cout << search.getElapsedTime() << " seconds, i.e., " << search.getRate() << " hashes/second" << endl;
+}
+
+/** Example function that searches for collisions on the first @a outputLength bits of a
+  * reduced-round Keccak instance, with messages of @a messageLength bits that are zero
+  * after the first @a outputLength bits, see ReducedRoundKeccakCollisionSearch.
+  * To distribute the search, each node runs with its own seed and saves its distinguished points
+  * to @a outPointsFileName; the files of the other nodes given in @a inPointsFileNames are loaded first.
+  */
+void searchCollisions(unsigned int rate, unsigned int capacity, int startRoundIndex, unsigned int nrRounds,
+    unsigned int outputLength, unsigned int messageLength, unsigned int distinguishedBits, unsigned int nrCollisions, UINT64 seed,
+    const string& outPointsFileName, const vector<string>& inPointsFileNames)
+{
+    ReducedRoundKeccakCollisionSearch search(rate, capacity, startRoundIndex, nrRounds,
+        outputLength, vector<UINT8>(), messageLength, distinguishedBits, 1 << 20, seed);
+    for(unsigned int i=0; i<inPointsFileNames.size(); i++) {
+        ifstream fin(inPointsFileNames[i].c_str());
+        if (!fin)
+            throw CollisionSearchException("The file " + inPointsFileNames[i] + " cannot be read.");
+        cout << dec << search.loadDistinguishedPoints(fin) << " distinguished points loaded from " << inPointsFileNames[i] << endl;
+    }
+    search.search(nrCollisions);
+    const vector<ReducedRoundKeccakCollisionSearch::Collision>& collisions = search.getCollisions();
+    for(unsigned int i=0; i<collisions.size(); i++) {
+        cout << "Collision:";
+        for(int j=0; j<2; j++) {
+            vector<UINT8> message;
+            search.getMessage((j == 0) ? collisions[i].x1 : collisions[i].x2, message);
+            cout << " ";
+            for(unsigned int k=0; k<message.size(); k++)
+                cout << hex << setw(2) << setfill('0') << (int)message[k];
         }
+        cout << dec << endl;
+    }
+    search.displayStatistics(cout);
+    if (!outPointsFileName.empty()) {
+        ofstream fout(outPointsFileName.c_str());
+        search.saveDistinguishedPoints(fout);
+        if (!fout)
+            throw CollisionSearchException("The file " + outPointsFileName + " cannot be written.");
+    }
+}
+
+/** Example function that estimates experimentally the probability of a differential trail of a file,
+  * with 2<sup>@a log2NrPairs</sup> pairs, see TrailProbabilityEstimator.
+  */
+void estimateTrailProbability(unsigned int width, const string& inFileName, UINT64 trailIndex, unsigned int log2NrPairs, UINT64 seed)
+{
+    KeccakFDCLC keccakF(width);
+    KeccakFPropagation DC(keccakF, KeccakFPropagation::DC);
+    unique_ptr<TrailIterator> trailsIn;
+    if (Trail::isBinaryFile(inFileName))
+        trailsIn.reset(new TrailBinaryFileIterator(inFileName, DC, false));
+    else
+        trailsIn.reset(new TrailFileIterator(inFileName, DC, false));
+    for(UINT64 i=0; (i<trailIndex) && !trailsIn->isEnd(); i++)
+        ++(*trailsIn);
+    if (trailsIn->isEnd())
+        throw KeccakException("The file " + inFileName + " does not contain enough trails.");
+    const Trail& trail = **trailsIn;
+    trail.display(DC, cout);
+    TrailProbabilityEstimator estimator(DC);
+    estimator.seed = seed;
+    estimator.measureDifferential = true;
+    TrailProbability result;
+    estimator.estimate(trail, ((UINT64)1) << log2NrPairs, result);
+    estimator.display(cout, result);
+}
+
+/** Example function that checks all the trails of a file, see TrailFileChecker,
+  * and writes the list of the bad trails to @a errorsFileName if not empty.
+  */
+void checkTrailFile(const KeccakFPropagation& DCorLC, const string& inFileName, const string& errorsFileName, ostream& fout)
+{
+    TrailFileChecker checker(DCorLC);
+    checker.check(inFileName);
+    checker.displaySummary(fout);
+    if (!errorsFileName.empty()) {
+        ofstream ferrors(errorsFileName.c_str());
+        checker.saveErrors(ferrors);
     }
+    else
+        checker.saveErrors(fout);
+}
+
+void checkTrailFile(unsigned int width, KeccakFPropagation::DCorLC DCLC, const string& inFileName, const string& errorsFileName)
+{
+    KeccakFDCLC keccakF(width);
+    KeccakFPropagation DCorLC(keccakF, DCLC);
+    checkTrailFile(DCorLC, inFileName, errorsFileName, cout);
+}
 
-    for (i = 0; i<int(nrRowsAndColumns*numRows); i++)
-        fout << "w: " << i << " log: " << log(wattab1[i]/laneSize) / log(2) <<  " n : " << wattab1[i]/laneSize << endl;
+/** Example function that renders the trails of a file, in the binary trail format
+  * or in the text format, as SVG documents with an HTML index, see KeccakTrailsInSVG.
+  */
+void renderTrailFile(unsigned int width, KeccakFPropagation::DCorLC DCLC, const string& inFileName, const string& prefix, unsigned int trailsPerDocument)
+{
+    KeccakFDCLC keccakF(width);
+    KeccakFPropagation DCorLC(keccakF, DCLC);
+    KeccakTrailsInSVG renderer;
+    renderer.trailsPerDocument = trailsPerDocument;
+    unique_ptr<TrailIterator> trailsIn;
+    if (Trail::isBinaryFile(inFileName))
+        trailsIn.reset(new TrailBinaryFileIterator(inFileName, DCorLC, false));
+    else
+        trailsIn.reset(new TrailFileIterator(inFileName, DCorLC, false));
+    UINT64 count = renderer.render(DCorLC, *trailsIn, prefix);
+    cout << dec << count << " trails rendered, see " << prefix << "-index.html" << endl;
+}
+
+/** Example function that runs the jobs of a job list concurrently, see BatchJobRunner.
+  * The jobs with the same width and type of propagation share the same KeccakFDCLC
+  * and KeccakFPropagation instances.
+  * @param  jobListFileName The name of the file with the job list.
+  * @param  nrThreads   The number of jobs run at the same time, or 0 for one per hardware thread.
+  */
+void runJobs(const string& jobListFileName, unsigned int nrThreads)
+{
+    BatchJobRunner runner;
+    runner.nrThreads = nrThreads;
+    // The extension has its own state, so each job has its own instance,
+    // which still takes its χ tables from the shared KeccakFDCLC instance.
+    runner.addHandler("extend", 4, "nrRounds maxWeight forward|backward inFile [outFile]",
+        [](const BatchJob& job, BatchJobRunner& runner, ostream& log) {
+            bool reverse = (job.arguments[2] == "backward");
+            if ((!reverse) && (job.arguments[2] != "forward"))
+                throw BatchJobException("The direction of the extension must be forward or backward.");
+            string inFileName = job.arguments[3];
+            string outFileName = job.getArgument(4, inFileName + (reverse ? string("-rev") : string("-dir")));
+            KeccakFTrailExtension keccakFTE(runner.getKeccakFDCLC(job.width), job.DCorLC);
+            extendTrails(keccakFTE, inFileName, outFileName, job.getInteger(0), job.getInteger(1), reverse, false, log);
+            log << "Trails written to " << outFileName << endl;
+        });
+    runner.addHandler("filter", 3, "maxWeight inFile outFile",
+        [](const BatchJob& job, BatchJobRunner& runner, ostream& log) {
+            filterTrailFile(runner.getPropagation(job.width, job.DCorLC), job.arguments[1], job.arguments[2], job.getInteger(0), log);
+        });
+    runner.addHandler("check", 1, "inFile [errorsFile]",
+        [](const BatchJob& job, BatchJobRunner& runner, ostream& log) {
+            checkTrailFile(runner.getPropagation(job.width, job.DCorLC), job.arguments[0], job.getArgument(1, ""), log);
+        });
+    runner.addHandler("weight-distributions", 0, "",
+        [](const BatchJob& job, BatchJobRunner& runner, ostream& log) {
+            log << "Weight distributions written to " << weightDistributions(runner.getPropagation(job.width, job.DCorLC)) << endl;
+        });
+    runner.addHandler("orbital-tree", 3, "maxCost alpha beta",
+        [](const BatchJob& job, BatchJobRunner& runner, ostream& log) {
+            if (job.DCorLC != KeccakFPropagation::DC)
+                throw BatchJobException("The orbital tree is only traversed for DC.");
+            string fileName = traverseOrbitalTree(runner.getPropagation(job.width, job.DCorLC),
+                job.getInteger(0), job.getInteger(1), job.getInteger(2), 1, 0);
+            log << "Trail cores written to " << fileName << endl;
+        });
+    try {
+        runner.load(jobListFileName);
+    }
+    catch(BatchJobException e) {
+        cout << e.reason << endl;
+        cout << "The kinds of jobs are:" << endl;
+        runner.displayUsage(cout);
+        return;
+    }
+    unsigned int nrJobs = runner.getNumberOfJobs();
+    unsigned int nrFailed = runner.run(cout);
+    cout << dec << (nrJobs - nrFailed) << " jobs done, " << nrFailed << " failed" << endl;
+}
+
+// The functions below spread a search over independent workers, e.g., the jobs of
+// a batch scheduler, through a WorkManifest. The description of the manifest
+// starts with the kind of search, followed by its parameters.
+
+// This function writes a manifest to traverse the orbital tree as traverseOrbitalTree() does,
+// with one unit per subtree rooted at the given depth.
+void createOrbitalTreeManifest(const string& manifestFileName, unsigned int width, unsigned int maxCost, unsigned int alpha, unsigned int beta, unsigned int splitDepth)
+{
+    KeccakFDCLC keccakFDCLC(width);
+    KeccakFPropagation keccakProp(keccakFDCLC, KeccakFPropagation::DC);
+    stringstream description;
+    description << "orbital-tree " << dec << width << " " << maxCost << " " << alpha << " " << beta;
+    WorkManifest manifest(manifestFileName, description.str());
+    TwoRoundTrailCoreCostFunction costF(alpha, beta);
+    OrbitalsSet orbSet(width / 25);
+    TwoRoundTrailCoreStack cache(keccakProp);
+    OrbitalTreeIterator iterator(orbSet, cache, costF, maxCost);
+    manifest.addTreeUnits(iterator, splitDepth);
+    manifest.save();
+    cout << dec << manifest.getNumberOfUnits() << " units written to " << manifestFileName << endl;
+}
+
+// This function writes a manifest to extend the trails of a file as extendTrails() does, one unit per shard of the file.
+void createExtensionManifest(const string& manifestFileName, KeccakFPropagation::DCorLC DCLC, unsigned int width, const string& inFileName, unsigned int nrRounds, int maxWeight, bool reverse, unsigned int nrShards)
+{
+    stringstream description;
+    description << "extend " << (DCLC == KeccakFPropagation::DC ? "DC" : "LC") << " " << dec << width << " "
+        << nrRounds << " " << maxWeight << " " << (reverse ? 1 : 0) << " " << inFileName;
+    WorkManifest manifest(manifestFileName, description.str());
+    manifest.addTrailFileShards(nrShards);
+    manifest.save();
+    cout << dec << manifest.getNumberOfUnits() << " units written to " << manifestFileName << endl;
+}
+
+// This function writes a manifest to generate the 2-round trail cores with the parities
+// listed in a file, see generateTwoRoundTrailCoresWithGivenParities(), split into ranges of parities.
+void createParitiesManifest(const string& manifestFileName, KeccakFPropagation::DCorLC DCLC, unsigned int width, const string& parityFileName, int maxWeight, unsigned int nrUnits)
+{
+    ifstream fin(parityFileName.c_str());
+    if (!fin)
+        throw KeccakException("File '" + parityFileName + "' cannot be read.");
+    UINT64 nrParities = 0;
+    string line;
+    while(getline(fin, line))
+        if (line.find_first_not_of(" \t\r") != string::npos)
+            nrParities++;
+    stringstream description;
+    description << "parities " << (DCLC == KeccakFPropagation::DC ? "DC" : "LC") << " " << dec << width << " "
+        << maxWeight << " " << parityFileName;
+    WorkManifest manifest(manifestFileName, description.str());
+    manifest.addParityRanges(nrParities, nrUnits);
+    manifest.save();
+    cout << dec << manifest.getNumberOfUnits() << " units written to " << manifestFileName << endl;
+}
+
+// This function runs the units of a manifest with the given function:
+// the one with the given index if any, otherwise all the units it can claim.
+static void runWorkUnits(const WorkManifest& manifest, const string& workerName, int unitIndex,
+    const function<void(const WorkUnit& unit, ostream& fout)>& run)
+{
+    if (unitIndex >= 0) {
+        if ((unsigned int)unitIndex >= manifest.getNumberOfUnits())
+            throw WorkManifestException("There is no such unit in the manifest.");
+        if (!manifest.isDone(unitIndex))
+            manifest.run(unitIndex, run);
+        cout << "Unit " << dec << unitIndex << " done" << endl;
+    }
+    else {
+        unsigned int count = manifest.work(workerName, run);
+        cout << workerName << " ran " << dec << count << " units" << endl;
+    }
+}
+
+// This function runs units of a manifest written by one of the functions above.
+// The context of the search is initialized once and shared by all the units run by the worker.
+void workOnManifest(const string& manifestFileName, const string& workerName, int unitIndex = -1)
+{
+    WorkManifest manifest(manifestFileName);
+    stringstream sin(manifest.getDescription());
+    string kind, DCLCName, inFileName;
+    sin >> kind;
+    if (kind == "orbital-tree") {
+        unsigned int width, maxCost, alpha, beta;
+        sin >> dec >> width >> maxCost >> alpha >> beta;
+        KeccakFDCLC keccakFDCLC(width);
+        KeccakFPropagation keccakProp(keccakFDCLC, KeccakFPropagation::DC);
+        TwoRoundTrailCoreCostFunction costF(alpha, beta);
+        OrbitalsSet orbSet(width / 25);
+        TwoRoundTrailCoreStack cache(keccakProp);
+        OrbitalTreeIterator iterator(orbSet, cache, costF, maxCost);
+        runWorkUnits(manifest, workerName, unitIndex, [&](const WorkUnit& unit, ostream& fout) {
+            WorkManifest::traverseTreeUnit(unit, iterator, [&](const TwoRoundTrailCore& aNode) {
+                TwoRoundTrailCore node = aNode;
+                node.save(fout);
+            });
+        });
+        return;
+    }
+    unsigned int width;
+    sin >> DCLCName >> dec >> width;
+    KeccakFPropagation::DCorLC DCLC = (DCLCName == "LC") ? KeccakFPropagation::LC : KeccakFPropagation::DC;
+    KeccakFDCLC keccakF(width);
+    if (kind == "extend") {
+        unsigned int nrRounds, reverse;
+        int maxWeight;
+        sin >> nrRounds >> maxWeight >> reverse >> ws;
+        getline(sin, inFileName);
+        KeccakFTrailExtension keccakFTE(keccakF, DCLC);
+        keccakFTE.showMinimalTrails = true;
+        runWorkUnits(manifest, workerName, unitIndex, [&](const WorkUnit& unit, ostream& fout) {
+            TrailFileIterator trailsIn(inFileName, keccakFTE, (unsigned int)unit.first, (unsigned int)unit.last);
+            TrailSaveToFile trailsOut(fout);
+            if (reverse)
+                keccakFTE.backwardExtendTrails(trailsIn, trailsOut, nrRounds, maxWeight);
+            else
+                keccakFTE.forwardExtendTrails(trailsIn, trailsOut, nrRounds, maxWeight);
+        });
+    }
+    else if (kind == "parities") {
+        int maxWeight;
+        sin >> maxWeight >> ws;
+        getline(sin, inFileName);
+        KeccakFPropagation DCorLC(keccakF, DCLC);
+        runWorkUnits(manifest, workerName, unitIndex, [&](const WorkUnit& unit, ostream& fout) {
+            ifstream fin(inFileName.c_str());
+            if (!fin)
+                throw KeccakException("File '" + inFileName + "' cannot be read.");
+            vector<vector<RowValue> > parities;
+            string line;
+            for(UINT64 i=0; (i<unit.last) && getline(fin, line); ) {
+                if (line.find_first_not_of(" \t\r") == string::npos)
+                    continue;
+                if (i >= unit.first) {
+                    stringstream sline(line);
+                    vector<RowValue> parity;
+                    readParity(sline, parity);
+                    parities.push_back(parity);
+                }
+                i++;
+            }
+            TrailSaveToFile trailsOut(fout);
+            generateTwoRoundTrailCoresWithGivenParities(DCorLC, parities, maxWeight, trailsOut, true, 1);
+        });
+    }
+    else
+        throw WorkManifestException("Unknown kind of search: " + kind);
 }
 
 int main(int argc, char *argv[])
 {
     try {
+        if ((argc > 1) && (string(argv[1]) == "benchmark")) {
+            benchmarkPermutations(cout);
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 1) && (string(argv[1]) == "benchmark-packed-lanes")) {
+            bool passed = benchmarkPackedLanes(cout);
+            return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if ((argc > 1) && (string(argv[1]) == "benchmark-modes")) {
+            benchmarkModes(cout);
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 1) && (string(argv[1]) == "benchmark-keystreams")) {
+            unsigned int nrThreads = (argc > 2) ? atoi(argv[2]) : thread::hardware_concurrency();
+            vector<unsigned int> nrStreams = { 1, 8, 64 }, threadCounts = { 1 };
+            if (nrThreads > 1)
+                threadCounts.push_back(nrThreads);
+            bool passed = benchmarkKeystreams(cout, nrStreams, threadCounts);
+            return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if ((argc > 1) && (string(argv[1]) == "benchmark-sessions")) {
+            bool passed = benchmarkSessionBatches(cout, { 1, 8, 64, 1024 }, { 0, 16, 256 });
+            return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if ((argc > 1) && (string(argv[1]) == "benchmark-round-sweep")) {
+            bool passed = benchmarkRoundSweeps(cout);
+            return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if ((argc > 1) && (string(argv[1]) == "benchmark-trails")) {
+            bool passed = benchmarkTrailSearches(cout, (argc > 2) ? string(argv[2]) : string("Example trails"));
+            return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if ((argc > 1) && (string(argv[1]) == "weight-distributions")) {
+            if (argc > 2)
+                weightDistributions(atoi(argv[2]), ((argc > 3) && (string(argv[3]) == "LC")) ? KeccakFPropagation::LC : KeccakFPropagation::DC);
+            else
+                allWeightDistributions();
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 1) && (string(argv[1]) == "hash")) {
+            hashFiles(vector<string>(argv+2, argv+argc));
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 3) && (string(argv[1]) == "convert-trails")) {
+            convertTrailFile(argv[2], argv[3]);
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 6) && (string(argv[1]) == "filter-trails")) {
+            KeccakFPropagation::DCorLC DCLC = (string(argv[3]) == "LC") ? KeccakFPropagation::LC : KeccakFPropagation::DC;
+            filterTrailFile(atoi(argv[2]), DCLC, argv[4], argv[5], atoi(argv[6]));
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 7) && (string(argv[1]) == "manifest-orbital-tree")) {
+            createOrbitalTreeManifest(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5]), atoi(argv[6]), atoi(argv[7]));
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 9) && (string(argv[1]) == "manifest-extend")) {
+            KeccakFPropagation::DCorLC DCLC = (string(argv[3]) == "LC") ? KeccakFPropagation::LC : KeccakFPropagation::DC;
+            createExtensionManifest(argv[2], DCLC, atoi(argv[4]), argv[5], atoi(argv[6]), atoi(argv[7]), atoi(argv[8]) != 0, atoi(argv[9]));
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 7) && (string(argv[1]) == "manifest-parities")) {
+            KeccakFPropagation::DCorLC DCLC = (string(argv[3]) == "LC") ? KeccakFPropagation::LC : KeccakFPropagation::DC;
+            createParitiesManifest(argv[2], DCLC, atoi(argv[4]), argv[5], atoi(argv[6]), atoi(argv[7]));
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 3) && (string(argv[1]) == "work")) {
+            workOnManifest(argv[2], argv[3], (argc > 4) ? atoi(argv[4]) : -1);
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 3) && (string(argv[1]) == "merge-work")) {
+            WorkManifest(argv[2]).merge(argv[3]);
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 2) && (string(argv[1]) == "release-work")) {
+            cout << dec << WorkManifest(argv[2]).releaseClaims() << " claims released" << endl;
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 5) && (string(argv[1]) == "equations-matrix")) {
+            KeccakFEquations keccakF(atoi(argv[2]));
+            ofstream fout(argv[5], ios::out | ios::binary | ios::trunc);
+            keccakF.genRoundEquationsMatrix(fout, atoi(argv[3]), atoi(argv[4]));
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 1) && (string(argv[1]) == "verify-challenges")) {
+            verifyChallenges();
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 9) && (string(argv[1]) == "preimage-search")) {
+            searchPreimages(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), atoi(argv[5]), argv[6], atoi(argv[7]), atoi(argv[8]), atoi(argv[9]));
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 10) && (string(argv[1]) == "collision-search")) {
+            searchCollisions(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), atoi(argv[5]), atoi(argv[6]), atoi(argv[7]), atoi(argv[8]), atoi(argv[9]),
+                strtoull(argv[10], 0, 10), (argc > 11) ? argv[11] : "", vector<string>(argv+min(argc, 12), argv+argc));
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 5) && (string(argv[1]) == "trail-probability")) {
+            estimateTrailProbability(atoi(argv[2]), argv[3], strtoull(argv[4], 0, 10), atoi(argv[5]), (argc > 6) ? strtoull(argv[6], 0, 10) : 0);
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 4) && (string(argv[1]) == "check-trails")) {
+            KeccakFPropagation::DCorLC DCLC = (string(argv[3]) == "LC") ? KeccakFPropagation::LC : KeccakFPropagation::DC;
+            checkTrailFile(atoi(argv[2]), DCLC, argv[4], (argc > 5) ? argv[5] : "");
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 5) && (string(argv[1]) == "render-trails")) {
+            KeccakFPropagation::DCorLC DCLC = (string(argv[3]) == "LC") ? KeccakFPropagation::LC : KeccakFPropagation::DC;
+            renderTrailFile(atoi(argv[2]), DCLC, argv[4], argv[5], (argc > 6) ? atoi(argv[6]) : 1);
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 6) && (string(argv[1]) == "best-first-extend")) {
+            KeccakFPropagation::DCorLC DCLC = (string(argv[3]) == "LC") ? KeccakFPropagation::LC : KeccakFPropagation::DC;
+            bestFirstExtendTrails(atoi(argv[2]), DCLC, argv[4], atoi(argv[5]), atoi(argv[6]), (argc > 7) ? strtoull(argv[7], 0, 10) : 1);
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 2) && (string(argv[1]) == "run-jobs")) {
+            runJobs(argv[2], (argc > 3) ? atoi(argv[3]) : 0);
+            return EXIT_SUCCESS;
+        }
+        if ((argc > 4) && (string(argv[1]) == "sort-trails")) {
+            sortTrailFiles(vector<string>(argv+4, argv+argc), argv[2], atoi(argv[3]));
+            return EXIT_SUCCESS;
+        }
         //TODO: uncomment the desired function
         //testKeccakF();
         //testKeccakSponge();
@@ -839,7 +1550,7 @@ int main(int argc, char *argv[])
         //forwardExtendOutsideKernel();
         //generateTrailCoresOutsideTheKernel();
         //generateTrailCoresInTheKernel();
-        //weightDistributions(200);
+        //weightDistributions(200, KeccakFPropagation::DC);
         //testKravatte();
         //testKravatteModes();
     }
@@ -0,0 +1,342 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string.h>
+#include "duplex.h"
+#include "Keccak.h"
+#include "Keccak-f.h"
+#include "Keyakv2.h"
+#include "Ketjev2.h"
+#include "keystream.h"
+#include "modesBenchmark.h"
+#include "sessionBatch.h"
+
+using namespace std;
+
+/** Calls @a call repeatedly for at least @a minimumTime seconds and returns the time per call in seconds. */
+static double measureSecondsPerCall(const function<void()>& call, double minimumTime)
+{
+    call();
+    UINT64 count = 1;
+    double elapsed;
+    while(true) {
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for(UINT64 i=0; i<count; i++)
+            call();
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        if (elapsed >= minimumTime)
+            break;
+        count *= 2;
+    }
+    return elapsed/count;
+}
+
+void measureMode(ostream& out, const string& mode, const string& instance, const string& operation,
+    unsigned int messageLength, unsigned int adLength, const function<void()>& call, double minimumTime)
+{
+    double secondsPerCall = measureSecondsPerCall(call, minimumTime);
+    out << mode << "," << instance << "," << operation << ","
+        << dec << messageLength << "," << adLength << ","
+        << (1.0/secondsPerCall) << "," << ((messageLength + adLength)/secondsPerCall) << ","
+        << (secondsPerCall*1e6) << endl;
+}
+
+/** Returns the lengths 0, 16, 256, ... up to @a maximumLength. */
+static vector<unsigned int> benchmarkedLengths(unsigned int maximumLength)
+{
+    vector<unsigned int> lengths(1, 0);
+    for(UINT64 length=16; length<=maximumLength; length*=16)
+        lengths.push_back((unsigned int)length);
+    return lengths;
+}
+
+static void benchmarkKeyak(ostream& out, Keyak& keyak, const string& instance, const vector<unsigned int>& lengths, double minimumTime)
+{
+    unsigned int maximumLength = lengths.back();
+    vector<UINT8> input(maximumLength + 1, 0x5A), output(maximumLength + 1), tag(16);
+    keyak.StartEngine(string(16, 'K'), string(16, 'N'), false, tag.data(), false, false);
+    for(unsigned int i=0; i<lengths.size(); i++) {
+        unsigned int length = lengths[i];
+        measureMode(out, "Keyak", instance, "wrap", length, 0, [&]() {
+            keyak.Wrap(input.data(), length, output.data(), input.data(), 0, tag.data(), false, false);
+        }, minimumTime);
+    }
+    for(unsigned int i=1; i<lengths.size(); i++) {
+        unsigned int length = lengths[i];
+        measureMode(out, "Keyak", instance, "wrap", 0, length, [&]() {
+            keyak.Wrap(input.data(), 0, output.data(), input.data(), length, tag.data(), false, false);
+        }, minimumTime);
+    }
+}
+
+static void benchmarkKetje(ostream& out, Ketje& ketje, const string& instance, const vector<unsigned int>& lengths, double minimumTime)
+{
+    unsigned int maximumLength = lengths.back();
+    vector<UINT8> input(maximumLength + 1, 0x5A), output(maximumLength + 1), tag(16);
+    ketje.initialize(string(ketje.getWidth()/32, 'K'), string(ketje.getWidth()/32, 'N'));
+    for(unsigned int i=0; i<lengths.size(); i++) {
+        unsigned int length = lengths[i];
+        measureMode(out, "Ketje", instance, "wrap", length, 0, [&]() {
+            ketje.wrap(input.data(), output.data(), length);
+            ketje.finalize(tag.data(), tag.size());
+        }, minimumTime);
+    }
+    for(unsigned int i=1; i<lengths.size(); i++) {
+        unsigned int length = lengths[i];
+        measureMode(out, "Ketje", instance, "wrap", 0, length, [&]() {
+            ketje.addAssociatedData(input.data(), length);
+            ketje.finalize(tag.data(), tag.size());
+        }, minimumTime);
+    }
+}
+
+void benchmarkModes(ostream& out, unsigned int maximumLength, double minimumTime)
+{
+    vector<unsigned int> lengths = benchmarkedLengths(maximumLength);
+    out << "mode,instance,operation,messageLength,adLength,callsPerSecond,bytesPerSecond,latencyMicroseconds" << endl;
+    {
+        RiverKeyak river; LakeKeyak lake; SeaKeyak sea; OceanKeyak ocean; LunarKeyak lunar;
+        benchmarkKeyak(out, river, "River", lengths, minimumTime);
+        benchmarkKeyak(out, lake, "Lake", lengths, minimumTime);
+        benchmarkKeyak(out, sea, "Sea", lengths, minimumTime);
+        benchmarkKeyak(out, ocean, "Ocean", lengths, minimumTime);
+        benchmarkKeyak(out, lunar, "Lunar", lengths, minimumTime);
+    }
+    {
+        KetjeJr jr; KetjeSr sr; KetjeMinor minor; KetjeMajor major;
+        benchmarkKetje(out, jr, "Jr", lengths, minimumTime);
+        benchmarkKetje(out, sr, "Sr", lengths, minimumTime);
+        benchmarkKetje(out, minor, "Minor", lengths, minimumTime);
+        benchmarkKetje(out, major, "Major", lengths, minimumTime);
+    }
+    benchmarkKravatteModes(out, lengths, minimumTime);
+}
+
+/** Checks the streams @a stream of @a generator, seeded with reseedAll(), against a Duplex object. */
+static bool checkKeystreamAgainstDuplex(KeystreamGenerator& generator, const Transformation& f, const PaddingRule& pad,
+    const vector<UINT8>& seed, unsigned int stream, const vector<UINT8>& keystream)
+{
+    Duplex duplex(&f, &pad, generator.getRate());
+    vector<UINT8> message(seed);
+    for(unsigned int i=0; i<4; i++)
+        message.push_back((UINT8)(stream >> (8*i)));
+    unsigned int chunkSize = generator.getMaximumInputLength()/8;
+    for(unsigned int offset=0; offset<message.size(); offset+=chunkSize)
+        duplex.duplexingBytes(&message[offset], min(chunkSize, (unsigned int)message.size() - offset), 0x01, 0, 0);
+    unsigned int blockSize = generator.getRate()/8;
+    vector<UINT8> block(blockSize);
+    const UINT8 *noInput = 0;
+    for(unsigned int offset=0; offset<keystream.size(); offset+=blockSize) {
+        duplex.duplexing(noInput, 0, &block[0], generator.getRate());
+        unsigned int length = min(blockSize, (unsigned int)keystream.size() - offset);
+        if (memcmp(&block[0], &keystream[offset], length) != 0)
+            return false;
+    }
+    return true;
+}
+
+bool benchmarkKeystreams(ostream& out, const vector<unsigned int>& nrStreams, const vector<unsigned int>& nrThreads,
+    unsigned int lengthInBytes, double minimumTime)
+{
+    KeccakF f(1600);
+    MultiRatePadding pad;
+    const unsigned int rate = 1600-256;
+    vector<UINT8> seed(32);
+    for(unsigned int i=0; i<seed.size(); i++)
+        seed[i] = (UINT8)i;
+    bool passed = true;
+    out << "streams,threads,bytesPerStream,check,callsPerSecond,gigabytesPerSecond" << endl;
+    for(unsigned int i=0; i<nrStreams.size(); i++)
+        for(unsigned int j=0; j<nrThreads.size(); j++) {
+            KeystreamGenerator generator(&f, &pad, rate, nrStreams[i], nrThreads[j]);
+            generator.reseedAll(&seed[0], (unsigned int)seed.size());
+            vector<vector<UINT8> > buffers(nrStreams[i], vector<UINT8>(lengthInBytes));
+            vector<UINT8 *> outputs(nrStreams[i]);
+            for(unsigned int k=0; k<nrStreams[i]; k++)
+                outputs[k] = &buffers[k][0];
+            generator.generate(outputs, lengthInBytes);
+            bool ok = (nrStreams[i] == 0)
+                || (checkKeystreamAgainstDuplex(generator, f, pad, seed, 0, buffers[0])
+                    && checkKeystreamAgainstDuplex(generator, f, pad, seed, nrStreams[i]-1, buffers[nrStreams[i]-1]));
+            passed = passed && ok;
+            double secondsPerCall = measureSecondsPerCall([&]() {
+                generator.generate(outputs, lengthInBytes);
+            }, minimumTime);
+            out << dec << nrStreams[i] << "," << nrThreads[j] << "," << lengthInBytes << ","
+                << (ok ? "ok" : "FAILED") << ","
+                << (1.0/secondsPerCall) << ","
+                << ((double)lengthInBytes*nrStreams[i]/secondsPerCall/1e9) << endl;
+        }
+    return passed;
+}
+
+/** Compares the wrapping of @a length bytes with @a adLength bytes of associated data by @a nrSessions sessions,
+  * one after the other with @a wrapOne(session, ...) and together with SessionBatch through @a makeOperation(session, ...),
+  * then measures both and outputs a line of results, in the format of benchmarkSessionBatches(). */
+static bool benchmarkSessionBatch(ostream& out, const string& instance, unsigned int nrSessions, unsigned int length, unsigned int adLength,
+    const function<void(unsigned int, const UINT8 *, const UINT8 *, UINT8 *, UINT8 *)>& wrapOne,
+    const function<BatchedOperation *(unsigned int, const UINT8 *, const UINT8 *, UINT8 *, UINT8 *)>& makeOperation,
+    double minimumTime)
+{
+    const unsigned int tagLength = 16;
+    vector<UINT8> input(length + 1, 0x5A), ad(adLength + 1, 0xA5);
+    vector<UINT8> outputs1((size_t)nrSessions*(length + 1)), outputs2((size_t)nrSessions*(length + 1));
+    vector<UINT8> tags1((size_t)nrSessions*tagLength), tags2((size_t)nrSessions*tagLength);
+    SessionBatch sessionBatch;
+    vector<unique_ptr<BatchedOperation> > operations(nrSessions);
+    vector<BatchedOperation *> pointers(nrSessions);
+    auto wrapIndividually = [&]() {
+        for(unsigned int i=0; i<nrSessions; i++)
+            wrapOne(i, input.data(), ad.data(), &outputs1[(size_t)i*(length + 1)], &tags1[(size_t)i*tagLength]);
+    };
+    auto wrapTogether = [&]() {
+        for(unsigned int i=0; i<nrSessions; i++) {
+            operations[i].reset(makeOperation(i, input.data(), ad.data(), &outputs2[(size_t)i*(length + 1)], &tags2[(size_t)i*tagLength]));
+            pointers[i] = operations[i].get();
+        }
+        sessionBatch.run(pointers);
+    };
+    // The sessions of both sets start from the same state, so the first calls must give the same results.
+    wrapIndividually();
+    wrapTogether();
+    bool ok = (outputs1 == outputs2) && (tags1 == tags2);
+    // Both ways are measured alternately a few times, keeping the best of each, so that
+    // a transient load on the machine does not decide the ratio.
+    double secondsIndividually = 0.0, secondsTogether = 0.0;
+    for(unsigned int repetition=0; repetition<3; repetition++) {
+        double s1 = measureSecondsPerCall(wrapIndividually, minimumTime/3);
+        double s2 = measureSecondsPerCall(wrapTogether, minimumTime/3);
+        if ((repetition == 0) || (s1 < secondsIndividually))
+            secondsIndividually = s1;
+        if ((repetition == 0) || (s2 < secondsTogether))
+            secondsTogether = s2;
+    }
+    out << instance << "," << dec << nrSessions << "," << length << "," << adLength << ","
+        << (ok ? "ok" : "FAILED") << ","
+        << (nrSessions/secondsIndividually) << "," << (nrSessions/secondsTogether) << ","
+        << (secondsIndividually/secondsTogether) << endl;
+    return ok;
+}
+
+bool benchmarkSessionBatches(ostream& out, const vector<unsigned int>& nrSessions, const vector<unsigned int>& lengths, double minimumTime)
+{
+    bool passed = true;
+    out << "instance,sessions,messageLength,adLength,check,sessionsPerSecondIndividually,sessionsPerSecondBatched,speedup" << endl;
+    for(unsigned int i=0; i<nrSessions.size(); i++)
+        for(unsigned int j=0; j<lengths.size(); j++) {
+            unsigned int n = nrSessions[i], length = lengths[j], adLength = 16;
+            {
+                vector<RiverKeyak> individual(n), together(n);
+                for(unsigned int k=0; k<n; k++) {
+                    string nonce = string(15, 'N') + char(k);
+                    individual[k].StartEngine(string(16, 'K'), nonce, false, (UINT8 *)0, false, false);
+                    together[k].StartEngine(string(16, 'K'), nonce, false, (UINT8 *)0, false, false);
+                }
+                passed = benchmarkSessionBatch(out, "RiverKeyak", n, length, adLength,
+                    [&](unsigned int k, const UINT8 *I, const UINT8 *A, UINT8 *O, UINT8 *T) {
+                        individual[k].Wrap(I, length, O, A, adLength, T, false, false);
+                    },
+                    [&](unsigned int k, const UINT8 *I, const UINT8 *A, UINT8 *O, UINT8 *T) {
+                        return new KeyakWrapOperation(together[k], I, length, O, A, adLength, T, false, false);
+                    }, minimumTime) && passed;
+            }
+            {
+                vector<LakeKeyak> individual(n), together(n);
+                for(unsigned int k=0; k<n; k++) {
+                    string nonce = string(15, 'N') + char(k);
+                    individual[k].StartEngine(string(16, 'K'), nonce, false, (UINT8 *)0, false, false);
+                    together[k].StartEngine(string(16, 'K'), nonce, false, (UINT8 *)0, false, false);
+                }
+                passed = benchmarkSessionBatch(out, "LakeKeyak", n, length, adLength,
+                    [&](unsigned int k, const UINT8 *I, const UINT8 *A, UINT8 *O, UINT8 *T) {
+                        individual[k].Wrap(I, length, O, A, adLength, T, false, true);
+                    },
+                    [&](unsigned int k, const UINT8 *I, const UINT8 *A, UINT8 *O, UINT8 *T) {
+                        return new KeyakWrapOperation(together[k], I, length, O, A, adLength, T, false, true);
+                    }, minimumTime) && passed;
+            }
+            {
+                // Ketje refers to its own permutation, so the sessions are not copied.
+                vector<unique_ptr<KetjeSr> > individual, together;
+                for(unsigned int k=0; k<n; k++) {
+                    string nonce = string(15, 'N') + char(k);
+                    individual.push_back(unique_ptr<KetjeSr>(new KetjeSr()));
+                    together.push_back(unique_ptr<KetjeSr>(new KetjeSr()));
+                    individual[k]->initialize(string(16, 'K'), nonce);
+                    together[k]->initialize(string(16, 'K'), nonce);
+                }
+                passed = benchmarkSessionBatch(out, "KetjeSr", n, length, adLength,
+                    [&](unsigned int k, const UINT8 *I, const UINT8 *A, UINT8 *O, UINT8 *T) {
+                        individual[k]->addAssociatedData(A, adLength);
+                        individual[k]->wrap(I, O, length);
+                        individual[k]->finalize(T, 16);
+                    },
+                    [&](unsigned int k, const UINT8 *I, const UINT8 *A, UINT8 *O, UINT8 *T) {
+                        return new KetjeWrapOperation(*together[k], A, adLength, I, O, length, T, 16);
+                    }, minimumTime) && passed;
+            }
+        }
+    return passed;
+}
+
+bool benchmarkRoundSweeps(ostream& out, double minimumTime)
+{
+    struct Combination { unsigned int rate, capacity; int startRoundIndex; unsigned int inputLength, outputLength; };
+    const unsigned int maxNrRounds = 24;
+    const Combination combinations[] = {
+        { 1088, 512, 0, 256, 256 },
+        { 1088, 512, 4, 256, 256 },
+        { 1344, 256, 0, 8, 1344 },
+        { 1088, 512, 0, 2000, 256 },
+        { 640, 160, 0, 128, 640 },
+        { 40, 160, 0, 16, 40 },
+        { 18, 7, 0, 8, 18 },
+    };
+    bool passed = true;
+    out << "instance,inputLength,outputLength,check,inputsPerSecondPerRoundCount,inputsPerSecondSweep,speedup" << endl;
+    for(unsigned int i=0; i<sizeof(combinations)/sizeof(combinations[0]); i++) {
+        const Combination& c = combinations[i];
+        vector<UINT8> input((c.inputLength+7)/8);
+        for(unsigned int j=0; j<input.size(); j++)
+            input[j] = (UINT8)(0x3D*j + i);
+        unsigned int outputLengthInBytes = (c.outputLength+7)/8;
+        vector<vector<UINT8> > outputs1(maxNrRounds, vector<UINT8>(outputLengthInBytes)), outputs2;
+        ReducedRoundKeccakSweep sweep(c.rate, c.capacity, c.startRoundIndex, maxNrRounds);
+        auto hashPerRoundCount = [&]() {
+            for(unsigned int n=1; n<=maxNrRounds; n++) {
+                ReducedRoundKeccak keccakRR(c.rate, c.capacity, c.startRoundIndex, n);
+                keccakRR.absorb(input.data(), c.inputLength);
+                keccakRR.squeeze(outputs1[n-1].data(), c.outputLength);
+            }
+        };
+        auto hashSweep = [&]() {
+            sweep.hash(input.data(), c.inputLength, outputs2, c.outputLength);
+        };
+        hashPerRoundCount();
+        hashSweep();
+        bool ok = (outputs1 == outputs2);
+        passed = passed && ok;
+        double secondsPerRoundCount = measureSecondsPerCall(hashPerRoundCount, minimumTime);
+        double secondsSweep = measureSecondsPerCall(hashSweep, minimumTime);
+        out << sweep.getDescription() << "," << dec << c.inputLength << "," << c.outputLength << ","
+            << (ok ? "ok" : "FAILED") << ","
+            << (1.0/secondsPerRoundCount) << "," << (1.0/secondsSweep) << ","
+            << (secondsPerRoundCount/secondsSweep) << endl;
+    }
+    return passed;
+}
@@ -0,0 +1,111 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _MODESBENCHMARK_H_
+#define _MODESBENCHMARK_H_
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+  * Function that measures the authenticated encryption and PRF modes, namely
+  * all the instances of Keyak and Ketje, and Kravatte as a PRF and in its modes
+  * SANE, SANSE, WBC and WBC-AE, and outputs the results as lines of
+  * comma-separated values, starting with the line of column names.
+  * Each operation is measured on messages of 0 bytes, then 16<sup>i</sup> bytes
+  * up to @a maximumLength without associated data, and likewise on associated
+  * data (or the tweak of WBC) with empty messages.
+  * Keyak and Ketje go through their interfaces on byte buffers.
+  * For the keystream operation of Kravatte, the message length is that of the output.
+  *
+  * @param  out         The stream to write the results to.
+  * @param  maximumLength   The largest message or associated data length, in bytes.
+  * @param  minimumTime The minimum duration, in seconds, of each measurement.
+  */
+void benchmarkModes(ostream& out, unsigned int maximumLength = 1<<20, double minimumTime = 0.05);
+
+/**
+  * Function that measures Kravatte as a PRF and in its modes, see benchmarkModes().
+  *
+  * @param  out         The stream to write the results to.
+  * @param  lengths     The message and associated data lengths in bytes.
+  * @param  minimumTime The minimum duration, in seconds, of each measurement.
+  */
+void benchmarkKravatteModes(ostream& out, const vector<unsigned int>& lengths, double minimumTime);
+
+/**
+  * Function that calls @a call repeatedly for at least @a minimumTime seconds
+  * and outputs a line of results, in the format of benchmarkModes(),
+  * where the throughput counts @a messageLength + @a adLength bytes per call.
+  */
+void measureMode(ostream& out, const string& mode, const string& instance, const string& operation,
+    unsigned int messageLength, unsigned int adLength, const function<void()>& call, double minimumTime);
+
+/**
+  * Function that measures the keystream generation of KeystreamGenerator
+  * with Keccak-<i>f</i>[1600], a capacity of 256 bits and the multi-rate padding,
+  * for each combination of a number of streams and a number of threads.
+  * Before each measurement, the first and last streams are checked against Duplex.
+  * The results are output as lines of comma-separated values, starting with
+  * the line of column names, with the throughput in GB/s summed over the streams.
+  *
+  * @param  out         The stream to write the results to.
+  * @param  nrStreams   The numbers of streams to measure.
+  * @param  nrThreads   The numbers of threads to measure.
+  * @param  lengthInBytes   The number of bytes generated per stream and per call.
+  * @param  minimumTime The minimum duration, in seconds, of each measurement.
+  * @return Whether all the checked streams matched those of Duplex.
+  */
+bool benchmarkKeystreams(ostream& out, const vector<unsigned int>& nrStreams, const vector<unsigned int>& nrThreads,
+    unsigned int lengthInBytes = 1<<16, double minimumTime = 0.2);
+
+/**
+  * Function that measures the wrapping of short messages by many independent
+  * sessions of RiverKeyak, LakeKeyak (with the forget flag) and KetjeSr,
+  * one session after the other and together with SessionBatch.
+  * For each combination of a number of sessions and a message length,
+  * with 16 bytes of associated data, the results of the first calls
+  * of both ways are compared, and the sessions per second of both ways, each the best of three
+  * alternate measurements, and their ratio are output as lines of comma-separated values,
+  * starting with the line of column names.
+  *
+  * @param  out         The stream to write the results to.
+  * @param  nrSessions  The numbers of sessions to measure.
+  * @param  lengths     The message lengths in bytes.
+  * @param  minimumTime The minimum duration, in seconds, of each measurement.
+  * @return Whether the batched sessions gave the same results as the individual ones.
+  */
+bool benchmarkSessionBatches(ostream& out, const vector<unsigned int>& nrSessions, const vector<unsigned int>& lengths, double minimumTime = 0.2);
+
+/**
+  * Function that measures the hashing of a short input by reduced-round Keccak
+  * for all the numbers of rounds from 1 to 24, with one ReducedRoundKeccak per number of rounds
+  * and with a single ReducedRoundKeccakSweep, for several widths, rates and start round indices.
+  * For each combination, the outputs of both ways are compared,
+  * and the inputs per second of both ways are output as lines of comma-separated values,
+  * starting with the line of column names.
+  * A combination with an input longer than the rate checks the fallback of the sweep.
+  *
+  * @param  out         The stream to write the results to.
+  * @param  minimumTime The minimum duration, in seconds, of each measurement.
+  * @return Whether the sweeps gave the same outputs as ReducedRoundKeccak.
+  */
+bool benchmarkRoundSweeps(ostream& out, double minimumTime = 0.2);
+
+#endif
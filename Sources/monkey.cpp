@@ -35,6 +35,11 @@ static void Farfalle_assert(bool condition, const string &synopsis, const char *
 #define assert(cond, msg)  Farfalle_assert(cond, msg, __FUNCTION__)
 #endif
 
+void BaseIterableTransformation::apply(UINT8 *state, unsigned int n)
+{
+    (*this)[n](state);
+}
+
 MonkeyDuplex::MonkeyDuplex(BaseIterableTransformation &f,
                            unsigned int                r,
                            unsigned int                nStart,
@@ -48,11 +53,16 @@ MonkeyDuplex::MonkeyDuplex(BaseIterableTransformation &f,
     assert(nStep < nStride,    "nStep must be less than nStride.");
 }
 
+MonkeyDuplex::MonkeyDuplex(const MonkeyDuplex &other, BaseIterableTransformation &f)
+    : f(f), r(other.r), nStart(other.nStart), nStep(other.nStep), nStride(other.nStride), s(other.s)
+{
+}
+
 void MonkeyDuplex::start(const BitString &I)
 {
     assert(I.size() + 2 <= f.width, "I length must be less than or equal to the permutation width minus 2.");
     s = I || BitString::pad101(f.width, I.size());
-    f[nStart](s.array());
+    f.apply(s.array(), nStart);
 }
 
 BitString MonkeyDuplex::step(const BitString &sigma, unsigned int ell)
@@ -63,8 +73,8 @@ BitString MonkeyDuplex::step(const BitString &sigma, unsigned int ell)
     BitString  P;
 
     P = sigma || BitString::pad101(r, sigma.size());
-    s = s ^ (P || BitString::zeroes(f.width - r));
-    f[nStep](s.array());
+    s ^= (P || BitString::zeroes(f.width - r));
+    f.apply(s.array(), nStep);
 
     return BitString(s).truncate(ell);
 }
@@ -77,18 +87,53 @@ BitString MonkeyDuplex::stride(const BitString &sigma, unsigned int ell)
     BitString  P;
 
     P = sigma || BitString::pad101(r, sigma.size());
-    s = s ^ (P || BitString::zeroes(f.width - r));
-    f[nStride](s.array());
+    s ^= (P || BitString::zeroes(f.width - r));
+    f.apply(s.array(), nStride);
 
     return BitString(s).truncate(ell);
 }
 
+UINT8 *MonkeyDuplex::state()
+{
+    return s.array();
+}
+
+void MonkeyDuplex::padInPlace(unsigned int sigmaLength)
+{
+    assert(sigmaLength + 2 <= r, "sigma length must be less than or equal to r minus 2.");
+
+    UINT8 *state = s.array();
+    state[sigmaLength / 8] ^= 1 << (sigmaLength % 8);
+    state[(r - 1) / 8]     ^= 1 << ((r - 1) % 8);
+}
+
+void MonkeyDuplex::padAndPermute(unsigned int sigmaLength, unsigned int nrRounds)
+{
+    padInPlace(sigmaLength);
+    f.apply(s.array(), nrRounds);
+}
+
+void MonkeyDuplex::stepInPlace(unsigned int sigmaLength)
+{
+    padAndPermute(sigmaLength, nStep);
+}
+
+void MonkeyDuplex::strideInPlace(unsigned int sigmaLength)
+{
+    padAndPermute(sigmaLength, nStride);
+}
+
+MonkeyWrap::MonkeyWrap(const MonkeyWrap &other, BaseIterableTransformation &f)
+    : f(f), rho(other.rho), D(other.D, f), inPayload(other.inPayload), position(other.position)
+{
+}
+
 MonkeyWrap::MonkeyWrap(BaseIterableTransformation &f,
                        unsigned int                rho,
                        unsigned int                nStart,
                        unsigned int                nStep,
                        unsigned int                nStride)
-    : f(f), rho(rho), D(f, rho + 4, nStart, nStep, nStride)
+    : f(f), rho(rho), D(f, rho + 4, nStart, nStep, nStride), inPayload(false), position(0)
 {
     assert(rho + 4 <= f.width, "rho must be lower than or equal to the permutation width minus 4.");
 }
@@ -102,6 +147,96 @@ void MonkeyWrap::initialize(const BitString &K, const BitString &N)
         "N length must be lower than or equal to the permutation width minus K length and 18.");
 
     D.start(BitString::keypack(K, K.size() + 16) || N);
+    inPayload = false;
+    position  = 0;
+}
+
+void MonkeyWrap::endAssociatedData()
+{
+    // Last block of A, with frame bits 01
+    D.state()[position] ^= 0x02;
+    D.stepInPlace(8 * position + 2);
+    inPayload = true;
+    position  = 0;
+}
+
+void MonkeyWrap::nextPayloadBlock()
+{
+    // Block of B followed by another one, with frame bits 11
+    D.state()[position] ^= 0x03;
+    D.stepInPlace(8 * position + 2);
+    position = 0;
+}
+
+void MonkeyWrap::addAssociatedData(const UINT8 *A, size_t length)
+{
+    assert((rho % 8) == 0, "The streaming interface requires rho to be a multiple of 8.");
+    assert(!inPayload,     "Associated data must come before the payload.");
+
+    UINT8 *state = D.state();
+    for ( size_t i = 0; i < length; ++i ) {
+        if ( position == (unsigned int)rho / 8 ) {
+            // Block of A followed by another one, with frame bits 00
+            D.stepInPlace(rho + 2);
+            position = 0;
+        }
+        state[position++] ^= A[i];
+    }
+}
+
+void MonkeyWrap::wrapBytes(const UINT8 *B, UINT8 *C, size_t length)
+{
+    assert((rho % 8) == 0, "The streaming interface requires rho to be a multiple of 8.");
+    if ( !inPayload ) {
+        endAssociatedData();
+    }
+
+    UINT8 *state = D.state();
+    for ( size_t i = 0; i < length; ++i ) {
+        if ( position == (unsigned int)rho / 8 ) {
+            nextPayloadBlock();
+        }
+        state[position] ^= B[i];
+        C[i] = state[position++];
+    }
+}
+
+void MonkeyWrap::unwrapBytes(const UINT8 *C, UINT8 *B, size_t length)
+{
+    assert((rho % 8) == 0, "The streaming interface requires rho to be a multiple of 8.");
+    if ( !inPayload ) {
+        endAssociatedData();
+    }
+
+    UINT8 *state = D.state();
+    for ( size_t i = 0; i < length; ++i ) {
+        if ( position == (unsigned int)rho / 8 ) {
+            nextPayloadBlock();
+        }
+        B[i] = state[position] ^ C[i];
+        state[position++] = C[i];
+    }
+}
+
+void MonkeyWrap::finalize(UINT8 *T, size_t length)
+{
+    assert((rho % 8) == 0, "The streaming interface requires rho to be a multiple of 8.");
+    if ( !inPayload ) {
+        endAssociatedData();
+    }
+
+    // Last block of B, with frame bits 10
+    D.state()[position] ^= 0x01;
+    D.strideInPlace(8 * position + 2);
+    for ( size_t i = 0; i < length; i += rho / 8 ) {
+        if ( i > 0 ) {
+            D.stepInPlace(1);                                        // Same as step(BitString(0), rho)
+        }
+        size_t count = min(length - i, (size_t)rho / 8);
+        copy(D.state(), D.state() + count, T + i);
+    }
+    inPayload = false;
+    position  = 0;
 }
 
 BitString MonkeyWrap::wrap(const BitString &Abits, const BitString &Bbits, unsigned int ell, BitString &T)
@@ -120,7 +255,7 @@ BitString MonkeyWrap::wrap(const BitString &Abits, const BitString &Bbits, unsig
     }
     T    = D.stride(B[B.size() - 1] || 1 || 0, rho);
     while ( T.size() < ell ) {
-        T = T || D.step(BitString(0), rho);
+        T.append(D.step(BitString(0), rho));
     }
     T.truncate(ell);
 
@@ -143,7 +278,7 @@ BitString MonkeyWrap::unwrap(const BitString &Abits, const BitString &Cbits, con
     }
     Tprime = D.stride(B[C.size() - 1] || 1 || 0, rho);
     while ( Tprime.size() < T.size()) {
-        Tprime = Tprime || D.step(BitString(0), rho);
+        Tprime.append(D.step(BitString(0), rho));
     }
     Tprime.truncate(T.size());
     if ( T == Tprime ) {
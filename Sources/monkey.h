@@ -17,6 +17,7 @@
 #define _MONKEY_H_
 
 #include <iostream>
+#include <map>
 #include <memory>
 #include "padding.h"
 #include "transformations.h"
@@ -35,19 +36,41 @@ public:
     BaseIterableTransformation(unsigned int width) : width(width) {}
 
     virtual const Transformation &operator[](unsigned int n) = 0;
+    virtual void apply(UINT8 *state, unsigned int n);                // Applies n rounds in place, by default through operator[](n)
 };
 
 template<class T>
 class IterableTransformation: public BaseIterableTransformation {
 protected:
-    T                     f;
+    map<unsigned int, shared_ptr<T> > f;                             // One instance per number of rounds, built on first use
 public:
-    IterableTransformation(unsigned int width) : BaseIterableTransformation(width), f(width, 1) {}
+    IterableTransformation(unsigned int width) : BaseIterableTransformation(width) {}
 
     const Transformation &operator[](unsigned int n)
     {
-        f = T(width, n);
-        return f;
+        shared_ptr<T> &fn = f[n];
+        if ( !fn ) {
+            fn.reset(new T(width, n));
+        }
+        return *fn;
+    }
+};
+
+/**
+ * Class implementing an iterable permutation on a single instance of a Keccak-f class such as KeccakPStar,
+ * which applies any number of rounds in place on the lanes with KeccakF::applyRounds(),
+ * without looking up or building one instance per number of rounds.
+ */
+template<class T>
+class IterableKeccakTransformation: public IterableTransformation<T> {
+protected:
+    T                             nominal;                           // The instance with the nominal number of rounds
+public:
+    IterableKeccakTransformation(unsigned int width) : IterableTransformation<T>(width), nominal(width, T(width, 1).getNominalNumberOfRounds()) {}
+
+    void apply(UINT8 *state, unsigned int n)
+    {
+        nominal.applyRounds(state, n);
     }
 };
 
@@ -66,9 +89,18 @@ protected:
     BitString                   s;
 public:
     MonkeyDuplex(BaseIterableTransformation &f, unsigned int r, unsigned int nStart, unsigned int nStep, unsigned int nStride);
+    MonkeyDuplex(const MonkeyDuplex &other, BaseIterableTransformation &f);    // Copies the state of other, on f instead of other.f
     void       start(const BitString &I);
     BitString  step(const BitString &sigma, unsigned int ell);
     BitString  stride(const BitString &sigma, unsigned int ell);
+    UINT8 *    state();                                              // The state, for the in-place interface below
+    void       stepInPlace(unsigned int sigmaLength);                // Same as step(), with sigma already XORed into state()
+    void       strideInPlace(unsigned int sigmaLength);              // Same as stride(), with sigma already XORed into state()
+protected:
+    void       padInPlace(unsigned int sigmaLength);                 // Pads the sigma already XORed into state(), without permuting
+    void       padAndPermute(unsigned int sigmaLength, unsigned int nrRounds);
+
+    friend class KetjeWrapOperation;
 };
 
 typedef Exception  MonkeyWrapException;
@@ -81,11 +113,28 @@ protected:
     BaseIterableTransformation &f;
     const int                   rho;
     MonkeyDuplex                D;
+    bool                        inPayload;                           // Whether the streaming interface is past the associated data
+    unsigned int                position;                            // Bytes of the current block already processed by the streaming interface
+    void       endAssociatedData();
+    void       nextPayloadBlock();
 public:
     MonkeyWrap(BaseIterableTransformation &f, unsigned int rho, unsigned int nStart, unsigned int nStep, unsigned int nStride);
+    MonkeyWrap(const MonkeyWrap &other, BaseIterableTransformation &f);        // Copies the state of other, on f instead of other.f
     void       initialize(const BitString &K, const BitString &N);
     BitString  wrap(const BitString &A, const BitString &B, unsigned int ell, BitString &T);
     BitString  unwrap(const BitString &A, const BitString &C, const BitString &T);
+
+    /*
+     * Streaming interface on byte buffers, for rho a multiple of 8: one call to wrap() is equivalent to
+     * addAssociatedData() on the bytes of A, then wrapBytes() on those of B, then finalize(), each in any
+     * number of calls, and likewise for unwrap() with unwrapBytes(). The caller checks the tag of unwrapping.
+     */
+    void       addAssociatedData(const UINT8 *A, size_t length);
+    void       wrapBytes(const UINT8 *B, UINT8 *C, size_t length);
+    void       unwrapBytes(const UINT8 *C, UINT8 *B, size_t length);
+    void       finalize(UINT8 *T, size_t length);
+
+    friend class KetjeWrapOperation;
 };
 
 #endif
@@ -13,6 +13,7 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
 #include <sstream>
 #include <vector>
 #include "padding.h"
@@ -48,6 +49,18 @@ void MessageBlock::appendByte(UINT8 byteValue)
     }
 }
 
+void MessageBlock::appendBytes(const UINT8 *bytes, unsigned int count)
+{
+    if ((bitsInBlock % 8) == 0) {
+        block.insert(block.end(), bytes, bytes+count);
+        bitsInBlock += 8*count;
+    }
+    else {
+        for(unsigned int i=0; i<count; i++)
+            appendByte(bytes[i]);
+    }
+}
+
 void MessageBlock::appendZeroes(unsigned int count)
 {
     while((count > 0) && ((bitsInBlock % 8) != 0)) {
@@ -121,6 +134,22 @@ void MessageQueue::appendByte(UINT8 byteValue)
     }
 }
 
+void MessageQueue::append(const UINT8 *input, unsigned int lengthInBits)
+{
+    if ((lastBlockSize() % 8) == 0) {
+        while(lengthInBits >= 8) {
+            adjustLastBlock();
+            unsigned int count = min(lengthInBits/8, (blockSize - lastBlockSize())/8);
+            if (count == 0)
+                break;
+            queue.back().appendBytes(input, count);
+            input += count;
+            lengthInBits -= 8*count;
+        }
+    }
+    append<const UINT8 *>(input, lengthInBits);
+}
+
 void MessageQueue::appendZeroes(unsigned int count)
 {
     while(count > 0) {
@@ -175,6 +204,25 @@ void PaddingRule::append10star(unsigned int blockSize, MessageQueue& queue) cons
         queue.appendZeroes(blockSize - (queue.lastBlockSize() % blockSize));
 }
 
+bool PaddingRule::padInPlace(unsigned int rate, UINT8 *block, unsigned int inputSize) const
+{
+    if (getPaddedSize(rate, inputSize) != rate)
+        return false;
+    MessageQueue queue(rate);
+    queue.appendZeroes(inputSize);
+    pad(rate, queue);
+    const vector<UINT8>& padding = queue.firstBlock();
+    for(vector<UINT8>::size_type i=0; i<padding.size(); ++i)
+        block[i] ^= padding[i];
+    return true;
+}
+
+/** Function that flips the bit at the given position in a block. */
+static inline void flipBit(UINT8 *block, unsigned int position)
+{
+    block[position/8] ^= (UINT8)(1 << (position%8));
+}
+
 unsigned int PaddingRule::getDuplexRate(unsigned int rho_max) const
 {
     unsigned int rate = 0;
@@ -210,6 +258,14 @@ unsigned int SimplePadding::getPaddedSize(unsigned int rate, unsigned int inputS
     return inputSize;
 }
 
+bool SimplePadding::padInPlace(unsigned int rate, UINT8 *block, unsigned int inputSize) const
+{
+    if (getPaddedSize(rate, inputSize) != rate)
+        return false;
+    flipBit(block, inputSize);
+    return true;
+}
+
 string SimplePadding::getDescription() const
 {
     return "pad10*";
@@ -230,6 +286,15 @@ unsigned int MultiRatePadding::getPaddedSize(unsigned int rate, unsigned int inp
     return inputSize;
 }
 
+bool MultiRatePadding::padInPlace(unsigned int rate, UINT8 *block, unsigned int inputSize) const
+{
+    if (getPaddedSize(rate, inputSize) != rate)
+        return false;
+    flipBit(block, inputSize);
+    flipBit(block, rate-1);
+    return true;
+}
+
 string MultiRatePadding::getDescription() const
 {
     return "pad10*1";
@@ -256,6 +321,18 @@ unsigned int OldDiversifiedKeccakPadding::getPaddedSize(unsigned int rate, unsig
     return inputSize;
 }
 
+bool OldDiversifiedKeccakPadding::padInPlace(unsigned int rate, UINT8 *block, unsigned int inputSize) const
+{
+    if (getPaddedSize(rate, inputSize) != rate)
+        return false;
+    flipBit(block, inputSize);
+    unsigned int byteIndex = (inputSize+8)/8;
+    block[byteIndex] ^= diversifier;
+    block[byteIndex+1] ^= (UINT8)(rate/8);
+    flipBit(block, (byteIndex+2)*8);
+    return true;
+}
+
 string OldDiversifiedKeccakPadding::getDescription() const
 {
     stringstream str;
@@ -47,6 +47,11 @@ public:
       * @param  byteValue     The value (0x00…0xFF) of the byte to append.
       */
     void appendByte(UINT8 byteValue);
+    /** Method to append whole bytes to the block.
+      * @param  bytes     The bytes to append.
+      * @param  count     The number of bytes to append.
+      */
+    void appendBytes(const UINT8 *bytes, unsigned int count);
     /** Method to append a series of bits with value '0'.
       * @param  count     The number of zeroes to append.
       */
@@ -116,6 +121,15 @@ public:
             }
         }
     }
+    /** Method to append a number of bits to the sequence, given as a buffer.
+      * When the sequence is byte-aligned, the whole bytes are copied
+      * block by block instead of one at a time.
+      * @param  input       The bytes to append.
+      * If the number of bits is not a multiple of 8, the last byte contains the
+      * last few bits in its least significant bits.
+      * @param  lengthInBits The number of bits to append.
+      */
+    void append(const UINT8 *input, unsigned int lengthInBits);
     /** Method to append a number of bytes to the sequence.
       * @param  inputStart  Constant iterator for the begin of the sequence of bytes to append.
       * @param  inputStop   Constant iterator for the end of the sequence of bytes to append.
@@ -177,6 +191,19 @@ public:
       * @param  inputSize   The size in bits of the input message before padding.
       */
     virtual unsigned int getPaddedSize(unsigned int rate, unsigned int inputSize) const = 0;
+    /** Method to apply the padding in place onto a single block, without
+      * allocating memory. The padding bits are XORed into @a block after the first
+      * @a inputSize bits, so @a block can be a buffer where the bits after the message
+      * are zero or the state into which the message was XORed.
+      * The default implementation goes through pad() and thus allocates memory;
+      * the padding rules of this file override it.
+      * @param  rate The block size in bits to which the padding must align.
+      * @param  block    The block into which to XOR the padding bits.
+      * @param  inputSize   The size in bits of the message before padding.
+      * @return  True iff the padded message spans exactly one block, otherwise
+      *          @a block is left unchanged.
+      */
+    virtual bool padInPlace(unsigned int rate, UINT8 *block, unsigned int inputSize) const;
     /** Abstract method to compute the minimum rate of a duplex object with the
       * given padding, given the maximum duplex rate rho_max.
       * @param  rate The block size in bits to which the padding must align.
@@ -217,6 +244,8 @@ public:
     void pad(unsigned int rate, MessageQueue& queue) const;
     /** Actual method for SimplePadding, see PaddingRule::getPaddedSize(). */
     unsigned int getPaddedSize(unsigned int rate, unsigned int inputSize) const;
+    /** Actual method for SimplePadding, see PaddingRule::padInPlace(). */
+    bool padInPlace(unsigned int rate, UINT8 *block, unsigned int inputSize) const;
     /** Actual method for SimplePadding, see PaddingRule::getDescription(). */
     string getDescription() const;
 };
@@ -233,6 +262,8 @@ public:
     void pad(unsigned int rate, MessageQueue& queue) const;
     /** Actual method for MultiRatePadding, see PaddingRule::getPaddedSize(). */
     unsigned int getPaddedSize(unsigned int rate, unsigned int inputSize) const;
+    /** Actual method for MultiRatePadding, see PaddingRule::padInPlace(). */
+    bool padInPlace(unsigned int rate, UINT8 *block, unsigned int inputSize) const;
     /** Actual method for MultiRatePadding, see PaddingRule::getDescription(). */
     string getDescription() const;
 };
@@ -251,6 +282,8 @@ public:
     void pad(unsigned int rate, MessageQueue& queue) const;
     /** Actual method for OldDiversifiedKeccakPadding, see PaddingRule::getPaddedSize(). */
     unsigned int getPaddedSize(unsigned int rate, unsigned int inputSize) const;
+    /** Actual method for OldDiversifiedKeccakPadding, see PaddingRule::padInPlace(). */
+    bool padInPlace(unsigned int rate, UINT8 *block, unsigned int inputSize) const;
     /** Actual method for OldDiversifiedKeccakPadding, see PaddingRule::getDescription(). */
     string getDescription() const;
     /** Actual method for OldDiversifiedKeccakPadding, see PaddingRule::isRateValid().
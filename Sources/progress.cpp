@@ -14,14 +14,33 @@ http://creativecommons.org/publicdomain/zero/1.0/
 */
 
 //#include <cstdlib>
+#include <chrono>
 #include <iostream>
-//#include <sstream>
+#include <sstream>
 //#include <time.h>
 #include "progress.h"
 
+atomic<UINT64> ProgressMeter::ticks(0);
+
 ProgressMeter::ProgressMeter()
-: height(0), previousDisplay(0), lastHeightDisplayed(0), nrDisplaysSinceFullDisplay(0)
+: height(0), previousDisplay(0), lastHeightDisplayed(0), nrDisplaysSinceFullDisplay(0), lastTickSeen(~(UINT64)0)
 {
+    startTicking();
+}
+
+void ProgressMeter::startTicking()
+{
+    static once_flag started;
+    call_once(started, []() {
+        // The thread only touches ticks, so it can be left running until the process exits.
+        thread ticker([]() {
+            while(true) {
+                this_thread::sleep_for(chrono::seconds(1));
+                ticks.fetch_add(1, memory_order_relaxed);
+            }
+        });
+        ticker.detach();
+    });
 }
 
 void ProgressMeter::clear()
@@ -30,8 +49,10 @@ void ProgressMeter::clear()
     previousDisplay = 0;
     lastHeightDisplayed = 0;
     nrDisplaysSinceFullDisplay = 0;
+    lastTickSeen = ~(UINT64)0;
     index.clear();
     count.clear();
+    startTime.clear();
     synopsis.clear();
 }
 
@@ -45,6 +66,7 @@ void ProgressMeter::stack(const string& aSynopsis, UINT64 aCount)
     if (height > 0)
         index.push_back(topIndex);
     count.push_back(aCount);
+    startTime.push_back(time(NULL));
     synopsis.push_back(aSynopsis);
     height++;
     topIndex = 0;
@@ -58,6 +80,7 @@ void ProgressMeter::unstack()
             index.pop_back();
         }
         count.pop_back();
+        startTime.pop_back();
         synopsis.pop_back();
         height--;
     }
@@ -65,14 +88,9 @@ void ProgressMeter::unstack()
         lastHeightDisplayed = height;
 }
 
-void ProgressMeter::operator++()
-{
-    topIndex++;
-    displayIfNecessary();
-}
-
 void ProgressMeter::displayIfNecessary()
 {
+    lastTickSeen = ticks.load(memory_order_relaxed);
     if (difftime(time(NULL), previousDisplay) >= 10.0)
         display();
 }
@@ -80,6 +98,7 @@ void ProgressMeter::displayIfNecessary()
 void ProgressMeter::display()
 {
     if (height > 0) {
+        time_t now = time(NULL);
         unsigned int startHeight = max(int(lastHeightDisplayed)-1, 0);
         if (startHeight >= height)
             startHeight = height-1;
@@ -92,20 +111,132 @@ void ProgressMeter::display()
             if (i < startHeight) cout << "(";
             if (synopsis[i].length() > 0)
                 cout << synopsis[i] << ": ";
-            if (i == (height-1))
-                cout << dec << topIndex;
-            else
-                cout << dec << index[i];
+            UINT64 currentIndex = (i == (height-1)) ? topIndex : index[i];
+            cout << dec << currentIndex;
             if (count[i] > 0)
                 cout << " / " << dec << count[i];
+            double elapsed = difftime(now, startTime[i]);
+            if ((elapsed > 0) && (currentIndex > 0)) {
+                cout << " [" << formatRate(currentIndex/elapsed) << "/s";
+                // A count of ~0 stands for an unknown count, e.g., from a TrailIterator.
+                if ((i == 0) && (count[i] > currentIndex) && (count[i] != ~(UINT64)0))
+                    cout << ", ETA " << formatDuration(elapsed*(count[i]-currentIndex)/currentIndex);
+                cout << "]";
+            }
             if (i < startHeight) cout << ")";
             cout << endl;
         }
         lastHeightDisplayed = height;
-        previousDisplay = time(NULL);
+        previousDisplay = now;
         if (effectiveStartHeight > 0)
             nrDisplaysSinceFullDisplay++;
         else
             nrDisplaysSinceFullDisplay = 0;
     }
 }
+
+string ProgressMeter::formatDuration(double seconds)
+{
+    UINT64 s = (UINT64)(seconds + 0.5);
+    stringstream str;
+    str.fill('0');
+    if (s >= 86400) {
+        str << dec << s/86400 << "d";
+        str.width(2);
+        str << (s%86400)/3600 << "h";
+    }
+    else if (s >= 3600) {
+        str << dec << s/3600 << "h";
+        str.width(2);
+        str << (s%3600)/60 << "m";
+    }
+    else if (s >= 60) {
+        str << dec << s/60 << "m";
+        str.width(2);
+        str << s%60 << "s";
+    }
+    else
+        str << dec << s << "s";
+    return str.str();
+}
+
+string ProgressMeter::formatRate(double perSecond)
+{
+    stringstream str;
+    if (perSecond >= 100.0)
+        str << dec << (UINT64)(perSecond + 0.5);
+    else {
+        str.precision(3);
+        str << perSecond;
+    }
+    return str.str();
+}
+
+ConcurrentProgressMeter::ConcurrentProgressMeter(const string& aSynopsis, UINT64 aCount, unsigned int aNrWorkers, double aPeriod)
+    : synopsis(aSynopsis), count(aCount == ~(UINT64)0 ? 0 : aCount), nrWorkers(aNrWorkers), period(aPeriod),
+    workers(new WorkerCounters[aNrWorkers]), index(0), nrTrails(0),
+    startTime(time(NULL)), nrNodesAtLastDisplay(0), nrTrailsAtLastDisplay(0), lastDisplay(startTime),
+    stopping(false), reporter(&ConcurrentProgressMeter::report, this)
+{
+}
+
+ConcurrentProgressMeter::~ConcurrentProgressMeter()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    reporter.join();
+}
+
+UINT64 ConcurrentProgressMeter::getNumberOfNodes() const
+{
+    UINT64 nrNodes = 0;
+    for(unsigned int i=0; i<nrWorkers; i++)
+        nrNodes += workers[i].nrNodes.load(memory_order_relaxed);
+    return nrNodes;
+}
+
+UINT64 ConcurrentProgressMeter::getNumberOfTrails() const
+{
+    return nrTrails.load(memory_order_relaxed);
+}
+
+void ConcurrentProgressMeter::report()
+{
+    unique_lock<mutex> guard(lock);
+    while(!wakeUp.wait_for(guard, chrono::duration<double>(period), [this]() { return stopping; })) {
+        guard.unlock();
+        display();
+        guard.lock();
+    }
+}
+
+void ConcurrentProgressMeter::display()
+{
+    lock_guard<mutex> guard(displayLock);
+    time_t now = time(NULL);
+    UINT64 currentIndex = index.load(memory_order_relaxed);
+    UINT64 nrNodes = getNumberOfNodes();
+    UINT64 currentNrTrails = getNumberOfTrails();
+    double sinceLastDisplay = difftime(now, lastDisplay);
+    double elapsed = difftime(now, startTime);
+    if (synopsis.length() > 0)
+        cout << synopsis << ": ";
+    cout << dec << currentIndex;
+    if (count > 0)
+        cout << " / " << dec << count;
+    cout << ", " << dec << nrNodes << " nodes";
+    if (sinceLastDisplay > 0)
+        cout << " [" << ProgressMeter::formatRate((nrNodes - nrNodesAtLastDisplay)/sinceLastDisplay) << "/s]";
+    cout << ", " << dec << currentNrTrails << " trails";
+    if (sinceLastDisplay > 0)
+        cout << " [" << ProgressMeter::formatRate((currentNrTrails - nrTrailsAtLastDisplay)/sinceLastDisplay) << "/s]";
+    if ((currentIndex > 0) && (count > currentIndex) && (elapsed > 0))
+        cout << ", ETA " << ProgressMeter::formatDuration(elapsed*(count-currentIndex)/currentIndex);
+    cout << endl;
+    nrNodesAtLastDisplay = nrNodes;
+    nrTrailsAtLastDisplay = currentNrTrails;
+    lastDisplay = now;
+}
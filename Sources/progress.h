@@ -17,32 +17,147 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #define _PROGRESS_H_
 
 #include <time.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include "types.h"
 #include <algorithm>
 
 using namespace std;
 
+/** This class displays the progress of nested loops, as a stack of counters.
+  * For each level, it displays the index, the total count if known,
+  * and the rate of the index per second since the level was stacked.
+  * For the bottom level, i.e., the first one stacked, it also displays
+  * an estimate of the remaining time when its total count is known.
+  * The display is refreshed at most every 10 seconds.
+  * To keep operator++() cheap, the clock is not read in it:
+  * a background thread shared by all the instances ticks once per second,
+  * and operator++() only compares the current tick with the last one seen.
+  * An instance must be used by one thread at a time,
+  * see ConcurrentProgressMeter for counting from several threads.
+  */
 class ProgressMeter {
 public:
     vector<string> synopsis;
     vector<UINT64> index, count;
+    vector<time_t> startTime;
     unsigned int height;
     UINT64 topIndex;
     time_t previousDisplay;
     unsigned int lastHeightDisplayed;
     unsigned int nrDisplaysSinceFullDisplay;
+    UINT64 lastTickSeen;
 public:
     ProgressMeter();
     void stack(UINT64 aCount = 0);
     void stack(const string& aSynopsis, UINT64 aCount = 0);
     void unstack();
-    void operator++();
+    inline void operator++()
+    {
+        topIndex++;
+        if (ticks.load(memory_order_relaxed) != lastTickSeen)
+            displayIfNecessary();
+    }
     void clear();
+    /** This function formats a duration in seconds for display, e.g., "2h05m".
+      * @param  seconds The duration in seconds.
+      * @return The formatted duration.
+      */
+    static string formatDuration(double seconds);
+    /** This function formats a rate per second for display,
+      * rounded to an integer from 100 on, or with three significant digits below.
+      * @param  perSecond   The rate per second.
+      * @return The formatted rate.
+      */
+    static string formatRate(double perSecond);
 protected:
+    /** The number of seconds elapsed since the first instance was constructed,
+      * as counted by the background thread.
+      */
+    static atomic<UINT64> ticks;
+    static void startTicking();
     void display();
     void displayIfNecessary();
 };
 
+/** This class counts the progress of a search whose work is spread over several threads,
+  * such as those of a WorkStealingPool.
+  * A single counter, advanced with advance(), tracks the index within a known count,
+  * typically the input trails, and gives the estimate of the remaining time.
+  * Each worker additionally counts the nodes it visits with countNode()
+  * in its own slot, without any synchronization but relaxed atomic loads and stores,
+  * so that it costs nearly nothing in the inner loops.
+  * The trails found are counted with countTrail().
+  * A background thread sums up the counters and displays the totals and their rates
+  * every @a period seconds, until the object is destroyed.
+  */
+class ConcurrentProgressMeter {
+protected:
+    struct alignas(64) WorkerCounters {
+        atomic<UINT64> nrNodes;
+        WorkerCounters() : nrNodes(0) {}
+    };
+    string synopsis;
+    UINT64 count;
+    unsigned int nrWorkers;
+    double period;
+    unique_ptr<WorkerCounters[]> workers;
+    atomic<UINT64> index;
+    atomic<UINT64> nrTrails;
+    time_t startTime;
+    UINT64 nrNodesAtLastDisplay, nrTrailsAtLastDisplay;
+    time_t lastDisplay;
+    mutex displayLock;
+    mutex lock;
+    condition_variable wakeUp;
+    bool stopping;
+    thread reporter;
+public:
+    /** The constructor, which starts the background thread.
+      * @param  aSynopsis   The text that describes what @a index counts.
+      * @param  aCount      The total count for the index, or 0 or ~0 if unknown.
+      * @param  aNrWorkers  The number of workers that call countNode().
+      * @param  aPeriod     The number of seconds between two displays.
+      */
+    ConcurrentProgressMeter(const string& aSynopsis, UINT64 aCount, unsigned int aNrWorkers, double aPeriod = 10.0);
+    /** The destructor, which stops the background thread. */
+    ~ConcurrentProgressMeter();
+    /** This method increments the index. */
+    inline void advance()
+    {
+        index.fetch_add(1, memory_order_relaxed);
+    }
+    /** This method counts a node visited by a worker.
+      * It must be called only by the thread running as the given worker.
+      * @param  worker  The index of the worker, less than the number of workers.
+      */
+    inline void countNode(unsigned int worker)
+    {
+        atomic<UINT64>& nrNodes = workers[worker].nrNodes;
+        nrNodes.store(nrNodes.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+    /** This method counts a trail found, from any thread. */
+    inline void countTrail()
+    {
+        nrTrails.fetch_add(1, memory_order_relaxed);
+    }
+    /** This method returns the total number of nodes counted so far by all the workers.
+      * @return The number of nodes.
+      */
+    UINT64 getNumberOfNodes() const;
+    /** This method returns the number of trails counted so far.
+      * @return The number of trails.
+      */
+    UINT64 getNumberOfTrails() const;
+    /** This method displays the current totals, and their rates since the previous display. */
+    void display();
+protected:
+    void report();
+};
+
 #endif
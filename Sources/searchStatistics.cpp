@@ -0,0 +1,101 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <fstream>
+#include "searchStatistics.h"
+
+UINT64 SearchStatistics::get(Event event, unsigned int depth) const
+{
+    if (depth < counts.size())
+        return counts[depth][event];
+    else
+        return 0;
+}
+
+UINT64 SearchStatistics::getTotal(Event event) const
+{
+    UINT64 total = 0;
+    for(unsigned int depth=0; depth<counts.size(); depth++)
+        total += counts[depth][event];
+    return total;
+}
+
+unsigned int SearchStatistics::getNumberOfDepths() const
+{
+    return (unsigned int)counts.size();
+}
+
+void SearchStatistics::add(const SearchStatistics& other)
+{
+    if (other.counts.size() > counts.size())
+        grow((unsigned int)other.counts.size() - 1);
+    for(unsigned int depth=0; depth<other.counts.size(); depth++)
+        for(unsigned int event=0; event<nrEvents; event++)
+            counts[depth][event] += other.counts[depth][event];
+}
+
+void SearchStatistics::clear()
+{
+    counts.clear();
+}
+
+void SearchStatistics::grow(unsigned int depth)
+{
+    array<UINT64, nrEvents> zero;
+    zero.fill(0);
+    counts.resize(depth + 1, zero);
+}
+
+const char *SearchStatistics::getName(Event event)
+{
+    switch(event) {
+    case nodesVisited: return "nodesVisited";
+    case childrenGenerated: return "childrenGenerated";
+    case prunedByCost: return "prunedByCost";
+    case prunedByCanonicity: return "prunedByCanonicity";
+    case prunedByChiCompatibility: return "prunedByChiCompatibility";
+    case prunedByShape: return "prunedByShape";
+    default: return "unknown";
+    }
+}
+
+void SearchStatistics::saveAsJSON(ostream& out) const
+{
+    out << "{" << endl;
+    out << "  \"total\": {";
+    for(unsigned int event=0; event<nrEvents; event++)
+        out << (event > 0 ? ", " : " ") << "\"" << getName((Event)event) << "\": " << dec << getTotal((Event)event);
+    out << " }," << endl;
+    out << "  \"perDepth\": [";
+    for(unsigned int depth=0; depth<counts.size(); depth++) {
+        out << (depth > 0 ? "," : "") << endl;
+        out << "    { \"depth\": " << dec << depth;
+        for(unsigned int event=0; event<nrEvents; event++)
+            out << ", \"" << getName((Event)event) << "\": " << dec << counts[depth][event];
+        out << " }";
+    }
+    if (counts.size() > 0)
+        out << endl << "  ";
+    out << "]" << endl;
+    out << "}" << endl;
+}
+
+void SearchStatistics::saveAsJSON(const string& fileName) const
+{
+    ofstream fout(fileName.c_str());
+    if (!fout)
+        throw Exception("Cannot open " + fileName + " for writing.");
+    saveAsJSON(fout);
+}
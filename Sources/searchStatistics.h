@@ -0,0 +1,142 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _SEARCHSTATISTICS_H_
+#define _SEARCHSTATISTICS_H_
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+/** This class counts, per depth, the events of a search in a tree,
+  * such as the nodes visited and the children pruned for each reason,
+  * so as to see where a search spends its time, e.g., when tuning its cost bounds.
+  * The meaning of the depth depends on the search, e.g., the number of units
+  * for a GenericTreeIterator, or the number of rounds for the trail extension.
+  * An object must be used by one thread at a time;
+  * the objects of several threads can be added up with add().
+  * The searches that support it take a pointer to such an object,
+  * and do not count anything if it is null.
+  * Defining KECCAKTOOLS_NO_SEARCH_STATISTICS at compile time
+  * removes the counting altogether, see countSearchEvent().
+  */
+class SearchStatistics {
+public:
+    /** The events counted. */
+    enum Event {
+        /** A node accepted by the search, i.e., visited, output or further extended. */
+        nodesVisited = 0,
+        /** A candidate child considered by the search, before checking its cost and shape. */
+        childrenGenerated,
+        /** A candidate child, or a whole subtree, rejected because of the cost or weight bound. */
+        prunedByCost,
+        /** A candidate child rejected because it is not the canonical representative of its class. */
+        prunedByCanonicity,
+        /** A candidate child rejected because its states are not compatible through χ. */
+        prunedByChiCompatibility,
+        /** A candidate child rejected for another structural reason, e.g., an ill-formed state. */
+        prunedByShape,
+        /** The number of events. */
+        nrEvents
+    };
+protected:
+    vector<array<UINT64, nrEvents> > counts;
+public:
+    /** This method counts an event at a given depth.
+      * @param  event   The event.
+      * @param  depth   The depth at which the event occurs.
+      * @param  n       The number of events to count.
+      */
+    inline void count(Event event, unsigned int depth, UINT64 n = 1)
+    {
+        if (depth >= counts.size())
+            grow(depth);
+        counts[depth][event] += n;
+    }
+    /** This method returns the number of events counted at a given depth.
+      * @param  event   The event.
+      * @param  depth   The depth.
+      * @return The number of events.
+      */
+    UINT64 get(Event event, unsigned int depth) const;
+    /** This method returns the number of events counted at all depths.
+      * @param  event   The event.
+      * @return The number of events.
+      */
+    UINT64 getTotal(Event event) const;
+    /** This method returns one more than the highest depth at which an event was counted.
+      * @return The number of depths.
+      */
+    unsigned int getNumberOfDepths() const;
+    /** This method adds the counts of another object to this one.
+      * @param  other   The counts to add.
+      */
+    void add(const SearchStatistics& other);
+    /** This method resets all the counts to zero. */
+    void clear();
+    /** This method writes the counts as a JSON object,
+      * with the totals and one entry per depth, named after the events.
+      * @param  out The stream to write to.
+      */
+    void saveAsJSON(ostream& out) const;
+    /** This method writes the counts as a JSON object to a file.
+      * @param  fileName    The name of the file.
+      */
+    void saveAsJSON(const string& fileName) const;
+    /** This function returns the name of an event, as used in saveAsJSON().
+      * @param  event   The event.
+      * @return The name of the event.
+      */
+    static const char *getName(Event event);
+protected:
+    void grow(unsigned int depth);
+};
+
+/** This function counts an event in @a statistics, if not null.
+  * It does nothing if KECCAKTOOLS_NO_SEARCH_STATISTICS is defined.
+  * @param  statistics  The statistics to update, or null.
+  * @param  event   The event.
+  * @param  depth   The depth at which the event occurs.
+  */
+inline void countSearchEvent(SearchStatistics *statistics, SearchStatistics::Event event, unsigned int depth)
+{
+#ifndef KECCAKTOOLS_NO_SEARCH_STATISTICS
+    if (statistics != 0)
+        statistics->count(event, depth);
+#endif
+}
+
+/** This function counts a candidate child in @a statistics, if not null,
+  * together with its outcome, i.e., whether it is visited or pruned and why.
+  * It does nothing if KECCAKTOOLS_NO_SEARCH_STATISTICS is defined.
+  * @param  statistics  The statistics to update, or null.
+  * @param  outcome The event for the outcome of the child, e.g., SearchStatistics::nodesVisited.
+  * @param  depth   The depth of the child.
+  */
+inline void countSearchChild(SearchStatistics *statistics, SearchStatistics::Event outcome, unsigned int depth)
+{
+#ifndef KECCAKTOOLS_NO_SEARCH_STATISTICS
+    if (statistics != 0) {
+        statistics->count(SearchStatistics::childrenGenerated, depth);
+        statistics->count(outcome, depth);
+    }
+#endif
+}
+
+#endif
@@ -0,0 +1,298 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <algorithm>
+#include <string.h>
+#include "sessionBatch.h"
+
+using namespace std;
+
+// -------------------------------------------------------------
+//
+// SessionBatch
+//
+// -------------------------------------------------------------
+
+unsigned int SessionBatch::getGroup(const Transformation& f)
+{
+    map<const Transformation *, unsigned int>::const_iterator i = groupOfPermutation.find(&f);
+    if (i != groupOfPermutation.end())
+        return i->second;
+    unsigned int group = (unsigned int)groupOfDescription.insert(make_pair(f.getDescription(), (unsigned int)groupOfDescription.size())).first->second;
+    groupOfPermutation[&f] = group;
+    return group;
+}
+
+void SessionBatch::run(const vector<BatchedOperation *>& operations)
+{
+    pending.clear();
+    for(unsigned int i=0; i<operations.size(); i++)
+        if (operations[i]->advance())
+            pending.push_back(operations[i]);
+    while(!pending.empty()) {
+        for(unsigned int i=0; i<groups.size(); i++)
+            groups[i].clear();
+        stillPending.clear();
+        bool alone = (pending.size() == 1);
+        for(unsigned int i=0; i<pending.size(); i++) {
+            BatchedOperation *operation = pending[i];
+            if (alone || !operation->isBatched()) {
+                // The operation goes on by itself until it completes or its next call can be batched.
+                bool more;
+                do {
+                    operation->permute();
+                    more = operation->advance();
+                } while(more && (alone || !operation->isBatched()));
+                if (more)
+                    stillPending.push_back(operation);
+                continue;
+            }
+            const Transformation& f = operation->getPermutation();
+            unsigned int group = getGroup(f);
+            if (group >= groups.size()) {
+                groups.resize(group + 1);
+                permutations.resize(group + 1);
+            }
+            groups[group].push_back(operation);
+            permutations[group] = &f;
+        }
+        for(unsigned int g=0; g<groups.size(); g++) {
+            unsigned int count = (unsigned int)groups[g].size();
+            if (count == 0)
+                continue;
+            if (count == 1)
+                groups[g][0]->permute();
+            else {
+                unsigned int stateSize = (permutations[g]->getWidth()+7)/8;
+                batch.resize((size_t)count*stateSize);
+                for(unsigned int k=0; k<count; k++)
+                    memcpy(&batch[(size_t)k*stateSize], groups[g][k]->getState(), stateSize);
+                permutations[g]->applyBatch(batch.data(), count);
+                for(unsigned int k=0; k<count; k++)
+                    memcpy(groups[g][k]->getState(), &batch[(size_t)k*stateSize], stateSize);
+            }
+            for(unsigned int k=0; k<count; k++)
+                if (groups[g][k]->advance())
+                    stillPending.push_back(groups[g][k]);
+        }
+        pending.swap(stillPending);
+    }
+}
+
+// -------------------------------------------------------------
+//
+// KeyakWrapOperation
+//
+// -------------------------------------------------------------
+
+KeyakWrapOperation::KeyakWrapOperation(Keyak& aKeyak, const UINT8 *aI, size_t anIlength, UINT8 *aO, const UINT8 *aA, size_t anAlength,
+    UINT8 *aT, bool anUnwrapFlag, bool aForgetFlag)
+    : keyak(aKeyak), piston(aKeyak.motorist.Pistons[0]), I(aI, anIlength), A(aA, anAlength), O(aO), Obegin(aO), Ilength(anIlength),
+    T(aT), unwrapFlag(anUnwrapFlag), forgetFlag(aForgetFlag), knot(0, 0), phase(wrapping), result(false)
+{
+    if (keyak.motorist.Pi != 1)
+        throw Exception("KeyakWrapOperation only supports the instances of Keyak with a single piston.");
+    if (keyak.motorist.phase != Motorist::riding)
+        throw Exception("The phase must be riding to call Motorist::Wrap().");
+}
+
+// The phases follow Motorist::Wrap() with a single piston, stopping at each call to SparkAll().
+bool KeyakWrapOperation::advance()
+{
+    Motorist& motorist = keyak.motorist;
+    switch(phase) {
+    case wrapping:
+        if (I.hasMore())
+            piston.Crypt(I, O, unwrapFlag);
+        piston.Inject(A);
+        if (I.hasMore() || A.hasMore())
+            return true;
+        if (forgetFlag) {
+            piston.MarkTag(motorist.cprime/8);
+            phase = knotting;
+        }
+        else {
+            piston.MarkTag(motorist.tau/8);
+            phase = tagging;
+        }
+        return true;
+    case knotting:
+        Tprime.resize(motorist.cprime/8);
+        piston.ExtractTag(Tprime.data(), motorist.cprime/8);
+        knot = ByteReader(Tprime.data(), Tprime.size());
+        phase = injectingKnot;
+        // fall through
+    case injectingKnot:
+        piston.Inject(knot);
+        if (knot.hasMore())
+            return true;
+        piston.MarkTag(motorist.tau/8);
+        phase = tagging;
+        return true;
+    case tagging:
+        Tprime.resize(motorist.tau/8 + 1);
+        piston.ExtractTag(Tprime.data(), motorist.tau/8);
+        result = true;
+        if (!unwrapFlag)
+            memcpy(T, Tprime.data(), motorist.tau/8);
+        else if (memcmp(Tprime.data(), T, motorist.tau/8) != 0) {
+            motorist.phase = Motorist::failed;
+            memset(Obegin, 0, Ilength);
+            result = false;
+        }
+        phase = done;
+        return false;
+    default:
+        return false;
+    }
+}
+
+UINT8 *KeyakWrapOperation::getState()
+{
+    return piston.state;
+}
+
+const Transformation& KeyakWrapOperation::getPermutation()
+{
+    return *piston.f;
+}
+
+// -------------------------------------------------------------
+//
+// KetjeWrapOperation
+//
+// -------------------------------------------------------------
+
+KetjeWrapOperation::KetjeWrapOperation(Ketje& aKetje, const UINT8 *anA, size_t anAlength, const UINT8 *anInput, UINT8 *anOutput, size_t aLength,
+    UINT8 *aT, size_t aTlength, bool anUnwrapFlag)
+    : ketje(aKetje), A(anA), Alength(anAlength), Aoffset(0), input(anInput), output(anOutput), length(aLength), offset(0),
+    T(aT), Tlength(aTlength), Toffset(0), unwrapFlag(anUnwrapFlag), nrRounds(0), phase(associatedData)
+{
+    if ((ketje.monkeyWrap.rho % 8) != 0)
+        throw Exception("The streaming interface requires rho to be a multiple of 8.");
+    if (ketje.monkeyWrap.inPayload && (Alength > 0))
+        throw Exception("Associated data must come before the payload.");
+    if (ketje.monkeyWrap.inPayload)
+        phase = payload;
+}
+
+// The phases follow MonkeyWrap::addAssociatedData(), wrapBytes() or unwrapBytes() and finalize(),
+// stopping at each permutation call.
+bool KetjeWrapOperation::advance()
+{
+    MonkeyWrap& monkeyWrap = ketje.monkeyWrap;
+    MonkeyDuplex& D = monkeyWrap.D;
+    UINT8 *state = D.state();
+    unsigned int &position = monkeyWrap.position;
+    const unsigned int blockSize = monkeyWrap.rho/8;
+    switch(phase) {
+    case associatedData:
+        while(Aoffset < Alength) {
+            if (position == blockSize) {
+                // Block of A followed by another one, with frame bits 00
+                D.padInPlace(monkeyWrap.rho + 2);
+                position = 0;
+                nrRounds = D.nStep;
+                return true;
+            }
+            // The bytes up to the end of the block, through local pointers so that the compiler keeps them in registers
+            size_t count = min(Alength - Aoffset, (size_t)(blockSize - position));
+            UINT8 *s = state + position;
+            const UINT8 *a = A + Aoffset;
+            for(size_t i=0; i<count; i++)
+                s[i] ^= a[i];
+            position += (unsigned int)count;
+            Aoffset += count;
+        }
+        // Last block of A, with frame bits 01
+        state[position] ^= 0x02;
+        D.padInPlace(8*position + 2);
+        monkeyWrap.inPayload = true;
+        position = 0;
+        phase = payload;
+        nrRounds = D.nStep;
+        return true;
+    case payload:
+        while(offset < length) {
+            if (position == blockSize) {
+                // Block of B followed by another one, with frame bits 11
+                state[position] ^= 0x03;
+                D.padInPlace(8*position + 2);
+                position = 0;
+                nrRounds = D.nStep;
+                return true;
+            }
+            size_t count = min(length - offset, (size_t)(blockSize - position));
+            UINT8 *s = state + position;
+            const UINT8 *in = input + offset;
+            UINT8 *out = output + offset;
+            if (unwrapFlag)
+                for(size_t i=0; i<count; i++) {
+                    out[i] = s[i] ^ in[i];
+                    s[i] = in[i];
+                }
+            else
+                for(size_t i=0; i<count; i++) {
+                    s[i] ^= in[i];
+                    out[i] = s[i];
+                }
+            position += (unsigned int)count;
+            offset += count;
+        }
+        // Last block of B, with frame bits 10
+        state[position] ^= 0x01;
+        D.padInPlace(8*position + 2);
+        phase = tag;
+        nrRounds = D.nStride;
+        return true;
+    case tag:
+        {
+            size_t count = min(Tlength - Toffset, (size_t)blockSize);
+            copy(state, state + count, T + Toffset);
+            Toffset += count;
+        }
+        if (Toffset < Tlength) {
+            D.padInPlace(1);
+            nrRounds = D.nStep;
+            return true;
+        }
+        monkeyWrap.inPayload = false;
+        position = 0;
+        phase = done;
+        return false;
+    default:
+        return false;
+    }
+}
+
+UINT8 *KetjeWrapOperation::getState()
+{
+    return ketje.monkeyWrap.D.state();
+}
+
+const Transformation& KetjeWrapOperation::getPermutation()
+{
+    return ketje.f[nrRounds];
+}
+
+bool KetjeWrapOperation::isBatched()
+{
+    return nrRounds >= minimumBatchedRounds;
+}
+
+void KetjeWrapOperation::permute()
+{
+    ketje.f.apply(ketje.monkeyWrap.D.state(), nrRounds);
+}
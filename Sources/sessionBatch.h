@@ -0,0 +1,167 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _SESSIONBATCH_H_
+#define _SESSIONBATCH_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "Keyakv2.h"
+#include "Ketjev2.h"
+#include "transformations.h"
+#include "types.h"
+
+using namespace std;
+
+/**
+  * Abstract class that represents a pending operation of a session,
+  * which SessionBatch advances one permutation call at a time,
+  * together with the operations of other sessions.
+  */
+class BatchedOperation {
+public:
+    /** Virtual destructor - necessary because this is an abstract class. */
+    virtual ~BatchedOperation() {}
+    /**
+      * Method that performs the processing of the operation up to its next
+      * permutation call and returns true, or that completes the operation
+      * and returns false. After it returns true, the caller applies
+      * getPermutation() onto getState(), possibly through permute(), before calling it again.
+      */
+    virtual bool advance() = 0;
+    /** Method that returns the state onto which to apply the next permutation call. */
+    virtual UINT8 *getState() = 0;
+    /** Method that returns the permutation of the next permutation call. */
+    virtual const Transformation& getPermutation() = 0;
+    /**
+      * Method that tells whether the next permutation call is worth processing
+      * together with those of other operations. If not, SessionBatch calls
+      * permute() instead, e.g., for calls so short that interleaving the states
+      * costs more than it saves.
+      */
+    virtual bool isBatched() { return true; }
+    /** Method that applies the next permutation call onto getState(), on its own. */
+    virtual void permute() { getPermutation()(getState()); }
+};
+
+/**
+  * Class that advances the pending operations of many independent sessions
+  * together: at each step, the states of all the operations that wait for
+  * the same permutation go through it with Transformation::applyBatch().
+  * The permutations are told apart by their description, so that the
+  * sessions of the same instance, e.g., many RiverKeyak objects,
+  * share the batches even though each has its own permutation object.
+  * The calls that an operation does not want batched (see BatchedOperation::isBatched()),
+  * the groups with a single state and the operations of a single session
+  * go through the permutation on their own, as in a plain loop over the sessions.
+  * In particular, the 1-round and 6-round calls of Ketje are never batched (see KetjeWrapOperation).
+  * The gain over the plain loop depends on the machine and on the build flags;
+  * see benchmarkSessionBatches(), i.e., "KeccakTools benchmark-sessions", to measure it.
+  */
+class SessionBatch {
+protected:
+    /** The index of the group of each permutation object seen so far. */
+    map<const Transformation *, unsigned int> groupOfPermutation;
+    /** The index of the group of each permutation description seen so far. */
+    map<string, unsigned int> groupOfDescription;
+    /** The states of a group, one after the other, as given to applyBatch(). */
+    vector<UINT8> batch;
+    /** The pending operations, their groups and the permutation of each group,
+      * kept between the calls to run() to save their allocations. */
+    vector<BatchedOperation *> pending, stillPending;
+    vector<vector<BatchedOperation *> > groups;
+    vector<const Transformation *> permutations;
+public:
+    /**
+      * Method that runs the operations until they are all completed.
+      * The results are available from each operation afterwards.
+      */
+    void run(const vector<BatchedOperation *>& operations);
+protected:
+    /** Internal method that returns the group index of @a f. */
+    unsigned int getGroup(const Transformation& f);
+};
+
+/**
+  * Class that represents a call to Keyak::Wrap() on byte buffers,
+  * to be run by SessionBatch.
+  * The parameters and the result are those of Keyak::Wrap(),
+  * and the session must not be used until the operation completes.
+  * Only the instances with a single piston, i.e., RiverKeyak and LakeKeyak, are supported.
+  */
+class KeyakWrapOperation : public BatchedOperation {
+protected:
+    Keyak& keyak;
+    Piston& piston;
+    ByteReader I, A;
+    ByteWriter O;
+    UINT8 *Obegin;
+    size_t Ilength;
+    UINT8 *T;
+    bool unwrapFlag, forgetFlag;
+    /** The tag, or the chaining value of the knot, extracted from the piston. */
+    vector<UINT8> Tprime;
+    ByteReader knot;
+    enum { wrapping, knotting, injectingKnot, tagging, done } phase;
+    bool result;
+public:
+    KeyakWrapOperation(Keyak& keyak, const UINT8 *I, size_t Ilength, UINT8 *O, const UINT8 *A, size_t Alength,
+        UINT8 *T, bool unwrapFlag, bool forgetFlag);
+    bool advance();
+    UINT8 *getState();
+    const Transformation& getPermutation();
+    /** Method that returns the result of Keyak::Wrap(), once the operation has completed. */
+    bool getResult() const { return result; }
+};
+
+/**
+  * Class that represents the wrapping (or unwrapping) of a message with Ketje,
+  * equivalent to Ketje::addAssociatedData(A, Alength), then Ketje::wrap(B, C, length)
+  * (or Ketje::unwrap(C, B, length)), then Ketje::finalize(T, Tlength),
+  * to be run by SessionBatch. As with Ketje::finalize(), the caller checks the tag of unwrapping.
+  * The session must not be used until the operation completes.
+  * The step and stride calls of Ketje, with 1 and 6 rounds, are never batched:
+  * they are applied in place on each session (see BaseIterableTransformation::apply()),
+  * as for so few rounds the copies into and out of a batch outweigh what interleaving saves.
+  * Only the calls of at least minimumBatchedRounds rounds would be batched.
+  */
+class KetjeWrapOperation : public BatchedOperation {
+protected:
+    Ketje& ketje;
+    const UINT8 *A;
+    size_t Alength, Aoffset;
+    const UINT8 *input;
+    UINT8 *output;
+    size_t length, offset;
+    UINT8 *T;
+    size_t Tlength, Toffset;
+    bool unwrapFlag;
+    /** The number of rounds of the next permutation call. */
+    unsigned int nrRounds;
+    enum { associatedData, payload, tag, done } phase;
+public:
+    KetjeWrapOperation(Ketje& ketje, const UINT8 *A, size_t Alength, const UINT8 *input, UINT8 *output, size_t length,
+        UINT8 *T, size_t Tlength, bool unwrapFlag = false);
+    bool advance();
+    UINT8 *getState();
+    const Transformation& getPermutation();
+    bool isBatched();
+    void permute();
+    /** The smallest number of rounds for which the permutation calls are batched. */
+    static const unsigned int minimumBatchedRounds = 12;
+};
+
+#endif
@@ -13,6 +13,7 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
 #include <sstream>
 #include <string.h>
 #include <vector>
@@ -21,7 +22,7 @@ http://creativecommons.org/publicdomain/zero/1.0/
 using namespace std;
 
 Sponge::Sponge(const Transformation *aF, const PaddingRule *aPad, unsigned int aRate)
-    : f(aF), pad(aPad), rate(aRate), squeezing(false), absorbQueue(rate)
+    : f(aF), pad(aPad), rate(aRate), squeezing(false), absorbQueue(rate), squeezeOffset(0)
 {
     unsigned int width = f->getWidth();
     if (rate <= 0)
@@ -39,7 +40,7 @@ Sponge::Sponge(const Transformation *aF, const PaddingRule *aPad, unsigned int a
 Sponge::Sponge(const Sponge& other)
     : f(other.f), pad(other.pad), capacity(other.capacity), rate(other.rate),
         squeezing(other.squeezing), absorbQueue(other.absorbQueue),
-        squeezeBuffer(other.squeezeBuffer)
+        squeezeOffset(other.squeezeOffset)
 {
     unsigned int width = f->getWidth();
     state.reset(new UINT8[(width+7)/8]);
@@ -63,14 +64,42 @@ void Sponge::reset()
     for(unsigned int i=0; i<(width+7)/8; i++)
         state.get()[i] = 0;
     absorbQueue.clear();
-    squeezeBuffer.clear();
+    squeezeOffset = 0;
 }
 
 void Sponge::absorb(const UINT8 *input, unsigned int lengthInBits)
 {
-    unsigned int lengthInBytes = (lengthInBits+7)/8;
-    vector<UINT8> inputAsVector(input, input+lengthInBytes);
-    absorb(inputAsVector, lengthInBits);
+    if (lengthInBits == 0)
+        return;
+    if (squeezing)
+        throw SpongeException("The absorbing phase is over.");
+    if (((rate % 8) == 0) && ((absorbQueue.lastBlockSize() % 8) == 0)) {
+        // First complete the pending partial block, if any, through the queue
+        if (absorbQueue.blockCount() > 0) {
+            unsigned int lengthToComplete = min(lengthInBits, rate - absorbQueue.lastBlockSize());
+            absorbQueue.append(input, lengthToComplete);
+            if (absorbQueue.firstBlockIsWhole()) {
+                absorbBlock(absorbQueue.firstBlock());
+                absorbQueue.removeFirstBlock();
+            }
+            input += lengthToComplete/8;
+            lengthInBits -= lengthToComplete;
+        }
+        // Then absorb the whole blocks directly from the input
+        if (absorbQueue.blockCount() == 0) {
+            while(lengthInBits >= rate) {
+                absorbBlock(input, rate/8);
+                input += rate/8;
+                lengthInBits -= rate;
+            }
+        }
+    }
+    // The trailing partial block (or all blocks if the rate is not a multiple of 8)
+    absorbQueue.append(input, lengthInBits);
+    while(absorbQueue.firstBlockIsWhole()) {
+        absorbBlock(absorbQueue.firstBlock());
+        absorbQueue.removeFirstBlock();
+    }
 }
 
 void Sponge::absorb(const vector<UINT8>& input, unsigned int lengthInBits)
@@ -80,86 +109,185 @@ void Sponge::absorb(const vector<UINT8>& input, unsigned int lengthInBits)
     unsigned int lengthInBytes = (lengthInBits+7)/8;
     if (input.size() < lengthInBytes)
         throw SpongeException("The given input length is inconsistent.");
-    if (squeezing)
-        throw SpongeException("The absorbing phase is over.");
-    absorbQueue.append(input.begin(), lengthInBits);
-    while(absorbQueue.firstBlockIsWhole()) {
-        absorbBlock(absorbQueue.firstBlock());
-        absorbQueue.removeFirstBlock();
-    }
+    absorb(&input[0], lengthInBits);
 }
 
 void Sponge::absorbBlock(const vector<UINT8>& block)
 {
-    for(vector<UINT8>::size_type i=0; i<block.size(); ++i)
-        state.get()[i] ^= block[i];
-    (*f)(state.get());
+    absorbBlock(&block[0], (unsigned int)block.size());
 }
 
-void Sponge::squeeze(UINT8 *output, unsigned int desiredLengthInBits)
+void Sponge::absorbBlock(const UINT8 *block, unsigned int lengthInBytes)
 {
-    vector<UINT8> outputAsVector;
-    squeeze(outputAsVector, desiredLengthInBits);
-    for(unsigned int i=0; i<outputAsVector.size(); i++)
-        output[i] = outputAsVector[i];
+    UINT8 *s = state.get();
+    unsigned int i = 0;
+    for( ; i+8<=lengthInBytes; i+=8) {
+        UINT64 stateWord, blockWord;
+        memcpy(&stateWord, s+i, 8);
+        memcpy(&blockWord, block+i, 8);
+        stateWord ^= blockWord;
+        memcpy(s+i, &stateWord, 8);
+    }
+    for( ; i<lengthInBytes; i++)
+        s[i] ^= block[i];
+    (*f)(s);
 }
 
-void Sponge::squeeze(vector<UINT8>& output, unsigned int desiredLengthInBits)
+void Sponge::squeeze(UINT8 *output, unsigned int desiredLengthInBits)
 {
-	if (!squeezing)
+    unsigned int desiredLengthInBytes = checkSqueezeLength(desiredLengthInBits);
+    if (!squeezing)
         flushAndSwitchToSqueezingPhase();
     if ((rate % 8) == 0) {
-        if ((desiredLengthInBits % 8) != 0)
-            throw SpongeException("The desired output length must be a multiple of 8.");
-        unsigned int desiredLengthInBytes = desiredLengthInBits / 8;
+        const unsigned int rateInBytes = rate/8;
         while(desiredLengthInBytes > 0) {
-            if (squeezeBuffer.size() == 0)
-                squeezeIntoBuffer();
-            while((desiredLengthInBytes > 0) && (squeezeBuffer.size() > 0)) {
-                output.push_back(squeezeBuffer.front());
-                desiredLengthInBytes--;
-                squeezeBuffer.pop_front();
+            if (squeezeOffset == rateInBytes) {
+                (*f)(state.get());
+                squeezeOffset = 0;
             }
+            unsigned int lengthInBytes = min(desiredLengthInBytes, rateInBytes - squeezeOffset);
+            memcpy(output, state.get() + squeezeOffset, lengthInBytes);
+            output += lengthInBytes;
+            desiredLengthInBytes -= lengthInBytes;
+            squeezeOffset += lengthInBytes;
         }
     }
     else {
-        if (desiredLengthInBits != rate)
-            throw SpongeException("The desired output length must be equal to the rate.");
-        if (squeezeBuffer.size() == 0)
-            squeezeIntoBuffer();
-        while(squeezeBuffer.size() > 0) {
-            output.push_back(squeezeBuffer.front());
-            squeezeBuffer.pop_front();
-        }
+        if (squeezeOffset > 0)
+            (*f)(state.get());
+        memcpy(output, state.get(), desiredLengthInBytes);
+        output[rate/8] &= (1 << (rate % 8)) - 1;
+        squeezeOffset = desiredLengthInBytes;
     }
 }
 
-void Sponge::squeezeIntoBuffer()
+void Sponge::squeeze(vector<UINT8>& output, unsigned int desiredLengthInBits)
 {
-    (*f)(state.get());
-    fromStateToSqueezeBuffer();
+    unsigned int desiredLengthInBytes = checkSqueezeLength(desiredLengthInBits);
+    if (desiredLengthInBytes == 0)
+        return;
+    vector<UINT8>::size_type previousSize = output.size();
+    output.resize(previousSize + desiredLengthInBytes);
+    squeeze(&output[previousSize], desiredLengthInBits);
 }
 
-void Sponge::fromStateToSqueezeBuffer()
+unsigned int Sponge::checkSqueezeLength(unsigned int desiredLengthInBits) const
 {
-    for(unsigned int i=0; i<rate/8; ++i)
-        squeezeBuffer.push_back(state.get()[i]);
-    if ((rate % 8) != 0) {
-        UINT8 lastByte = (state.get())[rate/8];
-        UINT8 mask = (1 << (rate % 8)) - 1;
-        squeezeBuffer.push_back(lastByte & mask);
+    if ((rate % 8) == 0) {
+        if ((desiredLengthInBits % 8) != 0)
+            throw SpongeException("The desired output length must be a multiple of 8.");
+    }
+    else {
+        if (desiredLengthInBits != rate)
+            throw SpongeException("The desired output length must be equal to the rate.");
     }
+    return (desiredLengthInBits+7)/8;
 }
 
 void Sponge::flushAndSwitchToSqueezingPhase()
 {
+    // When the padding fits in the pending block, XOR both directly into the state
+    unsigned int pendingSize = absorbQueue.lastBlockSize();
+    if ((absorbQueue.blockCount() <= 1) && pad->padInPlace(rate, state.get(), pendingSize)) {
+        if (pendingSize > 0)
+            absorbBlock(absorbQueue.firstBlock());
+        else
+            (*f)(state.get());
+        absorbQueue.clear();
+        squeezing = true;
+        squeezeOffset = 0;
+        return;
+    }
     absorbQueue.pad(*pad);
     while(absorbQueue.firstBlockIsWhole()) {
         absorbBlock(absorbQueue.firstBlock());
         absorbQueue.removeFirstBlock();
     }
     squeezing = true;
-    fromStateToSqueezeBuffer();
+    squeezeOffset = 0;
+}
+
+void Sponge::hashBatch(const vector<const UINT8 *>& messages, const vector<unsigned int>& lengthsInBits,
+    const vector<UINT8 *>& outputs, unsigned int outputLengthInBits,
+    const UINT8 *suffix, unsigned int suffixLengthInBits) const
+{
+    unsigned int count = (unsigned int)messages.size();
+    if ((lengthsInBits.size() != count) || (outputs.size() != count))
+        throw SpongeException("The numbers of messages, lengths and outputs must be equal.");
+    unsigned int outputLengthInBytes = checkSqueezeLength(outputLengthInBits);
+    if (count == 0)
+        return;
+
+    // Pad the messages, then sort them by decreasing number of blocks,
+    // so that the messages still being absorbed are always the first ones.
+    vector<MessageQueue> queues(count, MessageQueue(rate));
+    vector<unsigned int> order(count);
+    for(unsigned int i=0; i<count; i++) {
+        queues[i].append(messages[i], lengthsInBits[i]);
+        queues[i].append(suffix, suffixLengthInBits);
+        queues[i].pad(*pad);
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&queues](unsigned int a, unsigned int b)
+        { return queues[a].blockCount() > queues[b].blockCount(); });
+
+    unsigned int stateSize = (f->getWidth()+7)/8;
+    vector<UINT8> states(count*stateSize, 0);
+    unsigned int active = count;
+    while(active > 0) {
+        for(unsigned int k=0; k<active; k++) {
+            MessageQueue& queue = queues[order[k]];
+            const vector<UINT8>& block = queue.firstBlock();
+            for(vector<UINT8>::size_type i=0; i<block.size(); i++)
+                states[k*stateSize+i] ^= block[i];
+            queue.removeFirstBlock();
+        }
+        f->applyBatch(&states[0], active);
+        while((active > 0) && (queues[order[active-1]].blockCount() == 0))
+            active--;
+    }
+
+    const unsigned int blockSize = ((rate % 8) == 0) ? rate/8 : (rate+7)/8;
+    for(unsigned int offset=0; offset<outputLengthInBytes; offset+=blockSize) {
+        if (offset > 0)
+            f->applyBatch(&states[0], count);
+        unsigned int lengthInBytes = min(blockSize, outputLengthInBytes-offset);
+        for(unsigned int k=0; k<count; k++) {
+            UINT8 *output = outputs[order[k]] + offset;
+            memcpy(output, &states[k*stateSize], lengthInBytes);
+            if ((rate % 8) != 0)
+                output[rate/8] &= (1 << (rate % 8)) - 1;
+        }
+    }
+}
+
+void Sponge::saveCheckpoint(SpongeCheckpoint& checkpoint) const
+{
+    unsigned int width = f->getWidth();
+    checkpoint.width = width;
+    checkpoint.rate = rate;
+    checkpoint.squeezing = squeezing;
+    checkpoint.state.assign(state.get(), state.get() + (width+7)/8);
+    if (absorbQueue.blockCount() > 0) {
+        checkpoint.pendingBlock = absorbQueue.firstBlock();
+        checkpoint.pendingBlockSize = absorbQueue.lastBlockSize();
+    }
+    else {
+        checkpoint.pendingBlock.clear();
+        checkpoint.pendingBlockSize = 0;
+    }
+    checkpoint.squeezeOffset = squeezeOffset;
+}
+
+void Sponge::restoreCheckpoint(const SpongeCheckpoint& checkpoint)
+{
+    if ((checkpoint.width != f->getWidth()) || (checkpoint.rate != rate))
+        throw SpongeException("The checkpoint does not come from a compatible sponge.");
+    squeezing = checkpoint.squeezing;
+    memcpy(state.get(), &checkpoint.state[0], checkpoint.state.size());
+    absorbQueue.clear();
+    absorbQueue.append(checkpoint.pendingBlock.begin(), checkpoint.pendingBlockSize);
+    squeezeOffset = checkpoint.squeezeOffset;
 }
 
 string Sponge::getDescription() const
@@ -175,3 +303,47 @@ ostream& operator<<(ostream& a, const Sponge& sponge)
 {
     return a << sponge.getDescription();
 }
+
+SpongePrefixCache::SpongePrefixCache(unsigned int aMaximumSize)
+    : maximumSize(aMaximumSize)
+{
+}
+
+string SpongePrefixCache::buildKey(const Sponge& sponge, const UINT8 *prefix, unsigned int prefixLengthInBits)
+{
+    string key = sponge.getDescription();
+    key += '\0';
+    key.append((const char *)prefix, prefixLengthInBits/8);
+    return key;
+}
+
+void SpongePrefixCache::startWithPrefix(Sponge& sponge, const UINT8 *prefix, unsigned int prefixLengthInBits)
+{
+    if ((prefixLengthInBits % 8) != 0)
+        throw SpongeException("The prefix length must be a multiple of 8.");
+    string key = buildKey(sponge, prefix, prefixLengthInBits);
+    map<string, SpongeCheckpoint>::const_iterator i = checkpoints.find(key);
+    if (i != checkpoints.end()) {
+        sponge.restoreCheckpoint(i->second);
+        return;
+    }
+    sponge.reset();
+    sponge.absorb(prefix, prefixLengthInBits);
+    if ((maximumSize > 0) && (checkpoints.size() >= maximumSize)) {
+        checkpoints.erase(insertionOrder.front());
+        insertionOrder.pop_front();
+    }
+    sponge.saveCheckpoint(checkpoints[key]);
+    insertionOrder.push_back(key);
+}
+
+unsigned int SpongePrefixCache::size() const
+{
+    return (unsigned int)checkpoints.size();
+}
+
+void SpongePrefixCache::clear()
+{
+    checkpoints.clear();
+    insertionOrder.clear();
+}
@@ -18,7 +18,9 @@ http://creativecommons.org/publicdomain/zero/1.0/
 
 #include <deque>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <string>
 #include "padding.h"
 #include "transformations.h"
 #include "types.h"
@@ -27,6 +29,36 @@ using namespace std;
 
 typedef Exception SpongeException;
 
+/**
+  * Class that holds a snapshot of a Sponge object, as taken by
+  * Sponge::saveCheckpoint(), so that the sponge can later be brought back
+  * to that point with Sponge::restoreCheckpoint(). This is meant for
+  * many messages sharing a common prefix: the prefix is absorbed once,
+  * and each message starts from the checkpoint.
+  * Saving into an existing checkpoint reuses its memory.
+  */
+class SpongeCheckpoint {
+protected:
+    /** The width of the transformation of the sponge the checkpoint was taken from. */
+    unsigned int width;
+    /** The rate of the sponge the checkpoint was taken from. */
+    unsigned int rate;
+    /** Whether the sponge was in the squeezing phase. */
+    bool squeezing;
+    /** The state of the sponge. */
+    vector<UINT8> state;
+    /** The partial block not yet absorbed. */
+    vector<UINT8> pendingBlock;
+    /** The number of bits in pendingBlock. */
+    unsigned int pendingBlockSize;
+    /** The number of bytes of the current output block already squeezed. */
+    unsigned int squeezeOffset;
+public:
+    /** The constructor, for an empty checkpoint that can only be saved into. */
+    SpongeCheckpoint() : width(0), rate(0), squeezing(false), pendingBlockSize(0), squeezeOffset(0) {}
+    friend class Sponge;
+};
+
 /**
   * Class implementing the sponge construction.
   * This class uses a given transformation (inherited from class
@@ -61,8 +93,9 @@ protected:
     auto_ptr<UINT8> state;
     /** The message blocks not yet absorbed. */
     MessageQueue absorbQueue;
-    /** Buffer containing the partial block that is being squeezed. */
-    deque<UINT8> squeezeBuffer;
+    /** The number of bytes of the current output block, i.e., of the first
+      * bytes of the state, that have already been squeezed. */
+    unsigned int squeezeOffset;
 public:
     /**
       * The constructor. The transformation, padding rule and rate are given to the
@@ -122,6 +155,9 @@ public:
     /**
       * Method to extract data from the squeezing phase. If in the
       * absorbing phase, this function also switches to the squeezing phase.
+      * The output is copied directly from the state into @a output, one
+      * block at a time, and successive calls continue the output stream
+      * where the previous one stopped.
       *
       * @param  output      The buffer where to store the squeezed data.
       * @param  desiredLengthInBits     The length in bits of the output.
@@ -141,6 +177,36 @@ public:
       *                     Otherwise, @a desiredOutputLength must be equal to the rate.
       */
     void squeeze(vector<UINT8>& output, unsigned int desiredLengthInBits);
+    /**
+      * Method that hashes several messages independently with the same
+      * transformation, padding and rate as this sponge, each as if with a
+      * fresh sponge absorbing the message, then @a suffix, and squeezing
+      * @a outputLengthInBits bits. The messages go through the permutation
+      * together with Transformation::applyBatch(), one block per message
+      * at each step; messages with fewer blocks simply leave the batch
+      * earlier. The state of this sponge is not used nor modified.
+      *
+      * @param  messages    The messages to hash.
+      * @param  lengthsInBits   The length in bits of each message, not necessarily a multiple of 8.
+      * @param  outputs     The buffers where to store the output of each message.
+      * @param  outputLengthInBits  The length in bits of each output,
+      *                     with the same restrictions as for squeeze().
+      * @param  suffix      Bits to append to every message, e.g., domain separation bits.
+      * @param  suffixLengthInBits  The number of bits in @a suffix.
+      */
+    void hashBatch(const vector<const UINT8 *>& messages, const vector<unsigned int>& lengthsInBits,
+        const vector<UINT8 *>& outputs, unsigned int outputLengthInBits,
+        const UINT8 *suffix = 0, unsigned int suffixLengthInBits = 0) const;
+    /**
+      * Method that saves the current state of the sponge, including the input
+      * not yet absorbed and the position in the output stream, into @a checkpoint.
+      */
+    void saveCheckpoint(SpongeCheckpoint& checkpoint) const;
+    /**
+      * Method that brings the sponge back to the state saved in @a checkpoint.
+      * The checkpoint must come from a sponge with the same transformation and rate.
+      */
+    void restoreCheckpoint(const SpongeCheckpoint& checkpoint);
     /**
       * Method that returns the capacity of the sponge function.
       */
@@ -164,20 +230,69 @@ protected:
       * @param  block  A block to absorb.
       */
     void absorbBlock(const vector<UINT8>& block);
+    /**
+      * Internal method that does the actual absorbing of a whole block
+      * given as @a lengthInBytes bytes, XORing it into the state
+      * word by word, without going through absorbQueue.
+      * @param  block  A pointer to the block to absorb.
+      * @param  lengthInBytes  The length of the block in bytes.
+      */
+    void absorbBlock(const UINT8 *block, unsigned int lengthInBytes);
     /**
       * Internal method that absorbs the data still in absorbQueue,
       * and then switches the sponge function to the squeezing phase.
       */
     void flushAndSwitchToSqueezingPhase();
     /**
-      * Internal method that does the actual squeezing and stores the whole
-      * squeezed block into squeezeBuffer.
+      * Internal method that checks the desired output length of squeeze()
+      * and returns it in bytes.
       */
-    void squeezeIntoBuffer();
+    unsigned int checkSqueezeLength(unsigned int desiredLengthInBits) const;
+};
+
+/**
+  * Class that keeps Sponge checkpoints taken after absorbing given prefixes,
+  * so that hashing messages that share a prefix can fork from the
+  * precomputed state instead of absorbing the prefix again.
+  * The checkpoints are keyed by the description of the sponge and the prefix itself.
+  */
+class SpongePrefixCache {
+protected:
+    /** The checkpoints, indexed by the key built in buildKey(). */
+    map<string, SpongeCheckpoint> checkpoints;
+    /** The keys in the order of insertion, to evict the oldest ones first. */
+    deque<string> insertionOrder;
+    /** The maximum number of checkpoints kept, or 0 for no limit. */
+    unsigned int maximumSize;
+public:
     /**
-      * Internal method that copies a block from state to squeezeBuffer.
+      * The constructor.
+      * @param  aMaximumSize    The maximum number of checkpoints kept, or 0 for no limit.
       */
-    void fromStateToSqueezeBuffer();
+    SpongePrefixCache(unsigned int aMaximumSize = 0);
+    /**
+      * Method that resets @a sponge and brings it to the state after absorbing
+      * @a prefix. If this prefix was already absorbed for the same kind of sponge,
+      * the state is restored from the cache; otherwise, the prefix is absorbed
+      * and a checkpoint is added to the cache.
+      *
+      * @param  sponge      The sponge to prepare.
+      * @param  prefix      The prefix to absorb.
+      * @param  prefixLengthInBits  The length of the prefix in bits,
+      *                     which must be a multiple of 8.
+      */
+    void startWithPrefix(Sponge& sponge, const UINT8 *prefix, unsigned int prefixLengthInBits);
+    /**
+      * Method that returns the number of checkpoints in the cache.
+      */
+    unsigned int size() const;
+    /**
+      * Method that empties the cache.
+      */
+    void clear();
+protected:
+    /** Method that builds the key of a prefix for a given sponge. */
+    static string buildKey(const Sponge& sponge, const UINT8 *prefix, unsigned int prefixLengthInBits);
 };
 
 #endif
@@ -13,11 +13,18 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
+#include <algorithm>
+#include <thread>
 #include "spongetree.h"
 
-ShortLeafInterleavedSpongeTree::ShortLeafInterleavedSpongeTree(const SpongeFactory& aFactory, const int aD, const int aB)
-    : factory(aFactory), absorbQueue(aB), D(aD), B(aB)
+// Below this amount of input, in bytes, the leaves are processed in the calling thread.
+static const unsigned int minimumParallelLength = 1<<16;
+
+ShortLeafInterleavedSpongeTree::ShortLeafInterleavedSpongeTree(const SpongeFactory& aFactory, const int aD, const int aB, unsigned int aNrThreads)
+    : factory(aFactory), absorbQueue(aB), D(aD), B(aB), nrThreads(aNrThreads)
 {
+    if (nrThreads == 0)
+        nrThreads = max(1U, thread::hardware_concurrency());
     for(int i=0; i<D; i++)
         leaves.push_back(factory.newSponge());
     final = factory.newSponge();
@@ -37,16 +44,33 @@ ShortLeafInterleavedSpongeTree::~ShortLeafInterleavedSpongeTree()
 
 void ShortLeafInterleavedSpongeTree::absorb(const UINT8 *input, unsigned int lengthInBits)
 {
-    unsigned int lengthInBytes = (lengthInBits+7)/8;
-    vector<UINT8> inputAsVector(input, input+lengthInBytes);
-    absorb(inputAsVector, lengthInBits);
-}
-
-void ShortLeafInterleavedSpongeTree::absorb(const vector<UINT8>& input, unsigned int lengthInBits)
-{
+    if (lengthInBits == 0)
+        return;
     if (squeezing)
         throw SpongeException("The absorbing phase is over.");
-    absorbQueue.append(input.begin(), lengthInBits);
+    if (((B % 8) == 0) && ((absorbQueue.lastBlockSize() % 8) == 0)) {
+        // First complete the pending partial block, if any, through the queue
+        if (absorbQueue.blockCount() > 0) {
+            unsigned int lengthToComplete = min(lengthInBits, B - absorbQueue.lastBlockSize());
+            absorbQueue.append(input, lengthToComplete);
+            if (absorbQueue.firstBlockIsWhole()) {
+                leaves[leafIndex]->absorb(absorbQueue.firstBlock(), B);
+                absorbQueue.removeFirstBlock();
+                leafIndex = (leafIndex+1)%D;
+            }
+            input += lengthToComplete/8;
+            lengthInBits -= lengthToComplete;
+        }
+        // Then hand out the whole blocks directly from the input
+        if (absorbQueue.blockCount() == 0) {
+            unsigned int nrBlocks = lengthInBits/B;
+            absorbStripes(input, nrBlocks);
+            input += nrBlocks*(B/8);
+            lengthInBits -= nrBlocks*B;
+        }
+    }
+    // The trailing partial block (or all blocks if B is not a multiple of 8)
+    absorbQueue.append(input, lengthInBits);
     while(absorbQueue.firstBlockIsWhole()) {
         leaves[leafIndex]->absorb(absorbQueue.firstBlock(), B);
         absorbQueue.removeFirstBlock();
@@ -54,6 +78,44 @@ void ShortLeafInterleavedSpongeTree::absorb(const vector<UINT8>& input, unsigned
     }
 }
 
+void ShortLeafInterleavedSpongeTree::absorb(const vector<UINT8>& input, unsigned int lengthInBits)
+{
+    if (lengthInBits == 0)
+        return;
+    unsigned int lengthInBytes = (lengthInBits+7)/8;
+    if (input.size() < lengthInBytes)
+        throw SpongeException("The given input length is inconsistent.");
+    absorb(&input[0], lengthInBits);
+}
+
+void ShortLeafInterleavedSpongeTree::absorbStripes(const UINT8 *blocks, unsigned int nrBlocks)
+{
+    if (nrBlocks == 0)
+        return;
+    const unsigned int blockSize = B/8;
+    // The d-th block goes to the leaf leafIndex+d, so each leaf
+    // takes every D-th block of the input, starting from its own offset.
+    auto absorbLeaves = [&](unsigned int first, unsigned int step) {
+        for(unsigned int d=first; d<(unsigned int)D; d+=step) {
+            Sponge *leaf = leaves[(leafIndex+d)%D];
+            for(unsigned int j=d; j<nrBlocks; j+=D)
+                leaf->absorb(blocks + (size_t)j*blockSize, B);
+        }
+    };
+    unsigned int nrWorkers = min(nrThreads, min((unsigned int)D, nrBlocks));
+    if ((nrWorkers <= 1) || ((size_t)nrBlocks*blockSize < minimumParallelLength))
+        absorbLeaves(0, 1);
+    else {
+        vector<thread> threads;
+        for(unsigned int t=1; t<nrWorkers; t++)
+            threads.push_back(thread(absorbLeaves, t, nrWorkers));
+        absorbLeaves(0, nrWorkers);
+        for(unsigned int t=0; t<threads.size(); t++)
+            threads[t].join();
+    }
+    leafIndex = (leafIndex+nrBlocks)%D;
+}
+
 void ShortLeafInterleavedSpongeTree::flushAndSwitchToSqueezingPhase()
 {
     leaves[leafIndex]->absorb(absorbQueue.firstBlock(), absorbQueue.lastBlockSize());
@@ -87,3 +149,172 @@ void ShortLeafInterleavedSpongeTree::squeeze(vector<UINT8>& output, unsigned int
         flushAndSwitchToSqueezingPhase();
     final->squeeze(output, desiredLengthInBits);
 }
+
+ChunkedSpongeTree::ChunkedSpongeTree(const SpongeFactory& aFactory, unsigned int aB, unsigned int aH,
+    unsigned int aF, unsigned int aNrThreads)
+    : factory(aFactory), pendingChunkSize(0), nrChunks(0), squeezing(false), B(aB), H(aH),
+    F((aH > 2) ? aF : 0), nrThreads(aNrThreads)
+{
+    if ((B == 0) || (B >= (1U<<29)))
+        throw SpongeException("The chunk size must be between 1 and 2^29-1 bytes.");
+    if (H < 2)
+        throw SpongeException("The height of the tree must be at least 2.");
+    if ((H > 2) && (F < 2))
+        throw SpongeException("The fan-out must be at least 2.");
+    if (nrThreads == 0)
+        nrThreads = max(1U, thread::hardware_concurrency());
+    leaf = factory.newSponge();
+    if ((leaf->getRate() % 8) != 0) {
+        delete leaf;
+        throw SpongeException("The rate of the sponge functions must be a multiple of 8.");
+    }
+    C = 8*((leaf->getCapacity()+7)/8);
+    for(unsigned int i=0; i<H-1; i++)
+        nodes.push_back(factory.newSponge());
+    nodeSizes.assign(H-1, 0);
+}
+
+ChunkedSpongeTree::~ChunkedSpongeTree()
+{
+    for(unsigned int i=0; i<nodes.size(); i++) {
+        delete nodes[i];
+        nodes[i] = (Sponge*)0;
+    }
+    delete leaf;
+}
+
+void ChunkedSpongeTree::absorb(const UINT8 *input, unsigned int lengthInBits)
+{
+    if (lengthInBits == 0)
+        return;
+    if (squeezing)
+        throw SpongeException("The absorbing phase is over.");
+    if ((pendingChunkSize % 8) != 0)
+        throw SpongeException("The message length is no longer a multiple of 8.");
+    unsigned int lengthInBytes = lengthInBits/8;
+    // First complete the pending chunk, if any
+    if (pendingChunkSize > 0) {
+        unsigned int lengthToComplete = min(lengthInBytes, B - pendingChunkSize/8);
+        pendingChunk.insert(pendingChunk.end(), input, input+lengthToComplete);
+        pendingChunkSize += 8*lengthToComplete;
+        input += lengthToComplete;
+        lengthInBytes -= lengthToComplete;
+        if (pendingChunkSize == 8*B) {
+            absorbChunks(&pendingChunk[0], 1);
+            pendingChunk.clear();
+            pendingChunkSize = 0;
+        }
+    }
+    // Then hash the whole chunks directly from the input
+    if (pendingChunkSize == 0) {
+        unsigned int count = lengthInBytes/B;
+        absorbChunks(input, count);
+        input += (size_t)count*B;
+        lengthInBytes -= count*B;
+    }
+    // The beginning of the next chunk
+    unsigned int extraBits = lengthInBits % 8;
+    pendingChunk.insert(pendingChunk.end(), input, input + lengthInBytes + ((extraBits > 0) ? 1 : 0));
+    pendingChunkSize += 8*lengthInBytes + extraBits;
+    if (extraBits > 0)
+        pendingChunk.back() &= (1 << extraBits) - 1;
+}
+
+void ChunkedSpongeTree::absorbChunks(const UINT8 *chunks, unsigned int count)
+{
+    if (count == 0)
+        return;
+    const unsigned int chainingValueSize = C/8;
+    const unsigned int chunksPerBatch = 16;
+    const UINT8 leafFrameBits = 0x00; // the bits 00
+    vector<UINT8> chainingValues((size_t)count*chainingValueSize);
+    auto hashChunks = [&](unsigned int first, unsigned int last) {
+        vector<const UINT8 *> messages;
+        vector<unsigned int> lengths;
+        vector<UINT8 *> outputs;
+        for(unsigned int i=first; i<last; i+=chunksPerBatch) {
+            unsigned int batchSize = min(chunksPerBatch, last-i);
+            messages.clear();
+            outputs.clear();
+            for(unsigned int j=i; j<i+batchSize; j++) {
+                messages.push_back(chunks + (size_t)j*B);
+                outputs.push_back(&chainingValues[(size_t)j*chainingValueSize]);
+            }
+            lengths.assign(batchSize, 8*B);
+            leaf->hashBatch(messages, lengths, outputs, C, &leafFrameBits, 2);
+        }
+    };
+    unsigned int nrWorkers = min(nrThreads, count);
+    if ((nrWorkers <= 1) || ((size_t)count*B < minimumParallelLength))
+        hashChunks(0, count);
+    else {
+        vector<thread> threads;
+        for(unsigned int t=1; t<nrWorkers; t++)
+            threads.push_back(thread(hashChunks, (unsigned int)((UINT64)t*count/nrWorkers),
+                (unsigned int)((UINT64)(t+1)*count/nrWorkers)));
+        hashChunks(0, (unsigned int)((UINT64)count/nrWorkers));
+        for(unsigned int t=0; t<threads.size(); t++)
+            threads[t].join();
+    }
+    for(unsigned int i=0; i<count; i++)
+        addChainingValue(0, &chainingValues[(size_t)i*chainingValueSize]);
+    nrChunks += count;
+}
+
+void ChunkedSpongeTree::addChainingValue(unsigned int level, const UINT8 *chainingValue)
+{
+    nodes[level]->absorb(chainingValue, C);
+    nodeSizes[level]++;
+    if ((level+1 < nodes.size()) && (nodeSizes[level] == F))
+        finishIntermediateNode(level);
+}
+
+void ChunkedSpongeTree::absorbParameters(unsigned int level)
+{
+    UINT8 parametersAndFrameBits[10];
+    for(unsigned int i=0; i<4; i++) {
+        parametersAndFrameBits[i] = (UINT8)(B >> (8*i));
+        parametersAndFrameBits[4+i] = (UINT8)(F >> (8*i));
+    }
+    parametersAndFrameBits[8] = (UINT8)H;
+    parametersAndFrameBits[9] = 0x01; // the bit 1, followed by 0 for an intermediate node
+    bool final = (level+1 == nodes.size());
+    nodes[level]->absorb(parametersAndFrameBits, 72 + (final ? 1 : 2));
+}
+
+void ChunkedSpongeTree::finishIntermediateNode(unsigned int level)
+{
+    UINT8 chainingValue[200];
+    absorbParameters(level);
+    nodes[level]->squeeze(chainingValue, C);
+    nodes[level]->reset();
+    nodeSizes[level] = 0;
+    addChainingValue(level+1, chainingValue);
+}
+
+void ChunkedSpongeTree::flushAndSwitchToSqueezingPhase()
+{
+    if ((pendingChunkSize > 0) || (nrChunks == 0)) {
+        const UINT8 leafFrameBits = 0x00; // the bits 00
+        UINT8 chainingValue[200];
+        pendingChunk.push_back(0); // so that the buffer is never empty
+        leaf->hashBatch(vector<const UINT8 *>(1, &pendingChunk[0]), vector<unsigned int>(1, pendingChunkSize),
+            vector<UINT8 *>(1, chainingValue), C, &leafFrameBits, 2);
+        pendingChunk.clear();
+        pendingChunkSize = 0;
+        nrChunks++;
+        addChainingValue(0, chainingValue);
+    }
+    for(unsigned int level=0; level+1<nodes.size(); level++)
+        if (nodeSizes[level] > 0)
+            finishIntermediateNode(level);
+    absorbParameters((unsigned int)nodes.size()-1);
+    squeezing = true;
+}
+
+void ChunkedSpongeTree::squeeze(UINT8 *output, unsigned int desiredLengthInBits)
+{
+    if (!squeezing)
+        flushAndSwitchToSqueezingPhase();
+    nodes.back()->squeeze(output, desiredLengthInBits);
+}
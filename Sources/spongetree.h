@@ -47,6 +47,12 @@ public:
   * - the value <i>B</i> coded on 32-bit in a little-endian fashion;
   * - 5 bits set to zero (reserved for future use, for other layouts);
   * - the final bit set to 1 for domain separation with leaves.
+  *
+  * When <i>B</i> is a multiple of 8, the whole blocks of a call to absorb()
+  * are taken directly from the caller's buffer, each leaf striding over its
+  * own blocks. For large inputs, the leaves then absorb concurrently, so the
+  * transformations of the sponge functions created by the factory must be
+  * usable from several threads at once.
   */
 class ShortLeafInterleavedSpongeTree {
 protected:
@@ -78,14 +84,20 @@ protected:
     /** The chaining value size.
       */
     int C;
+    /** The number of threads over which the leaves are distributed.
+      */
+    unsigned int nrThreads;
 public:
     /** The constructor.
       * @param  aFactory    The object that will create the right sponge functions
       *                     for the leaves and for the final node.
       * @param  aD  The value for <i>D</i>.
       * @param  aB  The value for <i>B</i>.
+      * @param  aNrThreads  The maximum number of threads used to absorb
+      *                     into the leaves, or 0 to use the number of
+      *                     hardware threads.
       */
-    ShortLeafInterleavedSpongeTree(const SpongeFactory& aFactory, const int aD, const int aB);
+    ShortLeafInterleavedSpongeTree(const SpongeFactory& aFactory, const int aD, const int aB, unsigned int aNrThreads = 0);
     /** The desctructor. It deallocates any allocated object.
       */
     ~ShortLeafInterleavedSpongeTree();
@@ -142,6 +154,13 @@ public:
       */
     void squeeze(vector<UINT8>& output, unsigned int desiredLengthInBits);
 protected:
+    /**
+      * Internal method that absorbs @a nrBlocks whole blocks of <i>B</i> bits,
+      * stored one after the other, into the leaves,
+      * starting with the leaf at leafIndex.
+      * @pre <i>B</i> must be a multiple of 8.
+      */
+    void absorbStripes(const UINT8 *blocks, unsigned int nrBlocks);
     /**
       * Internal method that absorbs the data still in absorbQueue,
       * and then switches the sponge function of the final node
@@ -150,4 +169,150 @@ protected:
     void flushAndSwitchToSqueezingPhase();
 };
 
+/** This class implements a tree hashing mode of configurable shape,
+  * in the spirit of Sakura and KangarooTwelve.
+  * The message is cut into chunks of <i>B</i> bytes (the last one
+  * possibly shorter, and a single empty chunk for the empty message),
+  * which are the leaves of the tree.
+  * The tree has height <i>H</i> &ge; 2: the leaves form the first level,
+  * each of the <i>H</i>-2 intermediate levels groups the chaining values
+  * of the level below by <i>F</i> (the fan-out), and the final node
+  * takes all the chaining values of the level below it.
+  * The chaining value size <i>C</i> is the capacity of the underlying
+  * sponge function, rounded up to the next multiple of 8 bits.
+  * - A leaf contains its chunk followed by the bits 00.
+  * - An intermediate node contains the concatenation of its chaining values,
+  *   the parameters and the bits 10.
+  * - The final node contains the concatenation of its chaining values,
+  *   the parameters and the bit 1.
+  * The parameters are the values <i>B</i> and <i>F</i>, each coded on
+  * 32 bits in a little-endian fashion, and the value <i>H</i> coded on 8 bits.
+  *
+  * The chunks whose bytes are all available in a call to absorb() are
+  * hashed together with Sponge::hashBatch(), and in parallel over several
+  * threads for large inputs; their chaining values are then combined in
+  * order into the nodes of the upper levels.
+  * The rate of the sponge functions created by the factory must be a
+  * multiple of 8, and their transformation must be usable from several
+  * threads at once.
+  */
+class ChunkedSpongeTree {
+protected:
+    /** This attributes allows the class to create new sponge functions
+      * as needed.
+      */
+    const SpongeFactory& factory;
+    /** The sponge function used to hash the leaves, through its const method
+      * Sponge::hashBatch() only.
+      */
+    Sponge* leaf;
+    /** The sponge functions of the nodes being filled at the levels 1 to <i>H</i>-1,
+      * the last one being the final node.
+      */
+    vector<Sponge*> nodes;
+    /** The number of chaining values absorbed by each node of @a nodes.
+      */
+    vector<unsigned int> nodeSizes;
+    /** The bytes of the current chunk not yet hashed, plus the last bits
+      * if the message length is not a multiple of 8.
+      */
+    vector<UINT8> pendingChunk;
+    /** The number of bits in @a pendingChunk.
+      */
+    unsigned int pendingChunkSize;
+    /** The number of chunks hashed so far.
+      */
+    UINT64 nrChunks;
+    /** Boolean indicating whether the tree is in the squeezing phase
+      * (true) or in the absorbing phase (false). */
+    bool squeezing;
+    /** The chunk size in bytes.
+      */
+    unsigned int B;
+    /** The height of the tree.
+      */
+    unsigned int H;
+    /** The fan-out of the intermediate nodes.
+      */
+    unsigned int F;
+    /** The chaining value size.
+      */
+    unsigned int C;
+    /** The number of threads over which the chunks are distributed.
+      */
+    unsigned int nrThreads;
+public:
+    /** The constructor.
+      * @param  aFactory    The object that will create the right sponge functions
+      *                     for all the nodes.
+      * @param  aB  The value for <i>B</i>, in bytes.
+      * @param  aH  The value for <i>H</i>, at least 2.
+      * @param  aF  The value for <i>F</i>, at least 2 if <i>H</i> &gt; 2
+      *             (ignored otherwise).
+      * @param  aNrThreads  The maximum number of threads used to hash
+      *                     the chunks, or 0 to use the number of
+      *                     hardware threads.
+      */
+    ChunkedSpongeTree(const SpongeFactory& aFactory, unsigned int aB = 8192, unsigned int aH = 2,
+        unsigned int aF = 0, unsigned int aNrThreads = 0);
+    /** The desctructor. It deallocates any allocated object.
+      */
+    ~ChunkedSpongeTree();
+    /**
+      * Method that absorbs data. The data is given as a sequence of bytes.
+      * Within each byte, the bits are understood to be ordered from the
+      * least significant bit to the most significant bit.
+      *
+      * @pre This function must be used in the absorbing phase only.
+      *
+      * @param  input       The data to absorb. When lengthInBits is not
+      *                     a multiple of 8, the last bits of data must be
+      *                     in the least significant bits of the last byte.
+      * @param  lengthInBits    The length in bits of the data provided in
+      *                     input. When lengthInBits is not a multiple
+      *                     of 8, this function can no longer be used.
+      */
+    void absorb(const UINT8 *input, unsigned int lengthInBits);
+    /**
+      * Method to extract data from the squeezing phase. If in the
+      * absorbing phase, this function also switches to the squeezing phase.
+      *
+      * @param  output      The buffer where to store the squeezed data.
+      * @param  desiredLengthInBits     The length in bits of the output,
+      *                     which must be a multiple of 8.
+      */
+    void squeeze(UINT8 *output, unsigned int desiredLengthInBits);
+protected:
+    /**
+      * Internal method that hashes @a count whole chunks stored one after
+      * the other, and combines their chaining values into the upper levels.
+      */
+    void absorbChunks(const UINT8 *chunks, unsigned int count);
+    /**
+      * Internal method that absorbs a chaining value into the node
+      * at the given level (0 for the level just above the leaves),
+      * and finishes that node if it is full.
+      */
+    void addChainingValue(unsigned int level, const UINT8 *chainingValue);
+    /**
+      * Internal method that absorbs the parameters and the frame bits into
+      * the node at the given level.
+      */
+    void absorbParameters(unsigned int level);
+    /**
+      * Internal method that finishes the intermediate node at the given level,
+      * absorbs its chaining value into the level above and resets it.
+      */
+    void finishIntermediateNode(unsigned int level);
+    /**
+      * Internal method that hashes the last chunk, finishes the nodes
+      * still being filled, and then switches the sponge function of
+      * the final node to the squeezing phase.
+      */
+    void flushAndSwitchToSqueezingPhase();
+private:
+    ChunkedSpongeTree(const ChunkedSpongeTree&);
+    ChunkedSpongeTree& operator=(const ChunkedSpongeTree&);
+};
+
 #endif
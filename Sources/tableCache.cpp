@@ -0,0 +1,166 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string.h>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "tableCache.h"
+
+static const char tableCacheSignature[8] = { 'K', 'T', 'T', 'a', 'b', 'l', 'e', '\0' };
+/** The version of the file format, and of the content of the tables;
+  * it must be increased whenever either changes, so that older files are ignored. */
+static const UINT32 tableCacheVersion = 1;
+
+static mutex tableCacheDirectoryLock;
+static string tableCacheBaseDirectory;
+
+void setTableCacheDirectory(const string& directory)
+{
+    lock_guard<mutex> guard(tableCacheDirectoryLock);
+    tableCacheBaseDirectory = directory;
+}
+
+string getTableCacheDirectory()
+{
+    string base;
+    {
+        lock_guard<mutex> guard(tableCacheDirectoryLock);
+        base = tableCacheBaseDirectory;
+    }
+    if (base.empty()) {
+        const char *fromEnvironment = getenv("KECCAKTOOLS_CACHE");
+        base = ((fromEnvironment != 0) && (fromEnvironment[0] != 0)) ? fromEnvironment : "KeccakToolsCache";
+    }
+    stringstream directory;
+    directory << base << "/v" << tableCacheVersion;
+    return directory.str();
+}
+
+/** This function builds the header of a table, whose size is a multiple of 8 bytes.
+  * The 8 bytes at offset 16 contain the size of the table. */
+static vector<UINT8> buildHeader(const string& parameters, UINT64 size)
+{
+    size_t headerSize = (24 + parameters.size() + 1 + 7)/8*8;
+    vector<UINT8> header(headerSize, 0);
+    memcpy(&header[0], tableCacheSignature, 8);
+    for(unsigned int i=0; i<4; i++) {
+        header[8+i] = (UINT8)(tableCacheVersion >> (8*i));
+        header[12+i] = (UINT8)(headerSize >> (8*i));
+    }
+    for(unsigned int i=0; i<8; i++)
+        header[16+i] = (UINT8)(size >> (8*i));
+    memcpy(&header[24], parameters.data(), parameters.size());
+    return header;
+}
+
+static UINT64 readSize(const UINT8 *header)
+{
+    UINT64 size = 0;
+    for(unsigned int i=0; i<8; i++)
+        size ^= (UINT64)header[16+i] << (8*i);
+    return size;
+}
+
+shared_ptr<const UINT8> loadCachedTable(const string& name, const string& parameters, size_t& size)
+{
+    string fileName = getTableCacheDirectory() + "/" + name;
+    vector<UINT8> expected = buildHeader(parameters, 0);
+    vector<UINT8> header(expected.size());
+    UINT64 fileSize;
+    {
+        ifstream fin(fileName.c_str(), ios::binary);
+        fin.read((char *)&header[0], header.size());
+        if (!fin)
+            return shared_ptr<const UINT8>();
+        fin.seekg(0, ios_base::end);
+        fileSize = (UINT64)fin.tellg();
+    }
+    UINT64 tableSize = readSize(&header[0]);
+    if ((memcmp(&header[0], &expected[0], 16) != 0) || (memcmp(&header[24], &expected[24], header.size() - 24) != 0)
+            || (fileSize != header.size() + tableSize))
+        return shared_ptr<const UINT8>();
+    size = (size_t)tableSize;
+    size_t headerSize = header.size();
+#ifndef _WIN32
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        size_t mappedSize = (size_t)fileSize;
+        void *mapped = mmap(0, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped != MAP_FAILED) {
+            shared_ptr<const UINT8> content((const UINT8 *)mapped,
+                [mappedSize](const UINT8 *p) { munmap((void *)p, mappedSize); });
+            return shared_ptr<const UINT8>(content, content.get() + headerSize);
+        }
+    }
+#endif
+    ifstream fin(fileName.c_str(), ios::binary);
+    fin.seekg(headerSize);
+    shared_ptr<UINT64> content(new UINT64[size/8 + 1], default_delete<UINT64[]>());
+    fin.read((char *)content.get(), size);
+    if (!fin)
+        return shared_ptr<const UINT8>();
+    return shared_ptr<const UINT8>(content, (const UINT8 *)content.get());
+}
+
+static void makeDirectory(const string& directory)
+{
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0777);
+#endif
+}
+
+bool saveCachedTable(const string& name, const string& parameters, const UINT8 *data, size_t size)
+{
+    string directory = getTableCacheDirectory();
+    // The base directory, then the version subdirectory; they may already exist.
+    makeDirectory(directory.substr(0, directory.rfind('/')));
+    makeDirectory(directory);
+    string fileName = directory + "/" + name;
+    stringstream temporaryName;
+    temporaryName << fileName << ".tmp" << hex << chrono::steady_clock::now().time_since_epoch().count()
+        << "-" << this_thread::get_id();
+    vector<UINT8> header = buildHeader(parameters, size);
+    {
+        ofstream fout(temporaryName.str().c_str(), ios::out | ios::binary | ios::trunc);
+        fout.write((const char *)&header[0], header.size());
+        fout.write((const char *)data, size);
+        if (!fout) {
+            fout.close();
+            remove(temporaryName.str().c_str());
+            return false;
+        }
+    }
+#ifdef _WIN32
+    remove(fileName.c_str()); // rename() does not replace an existing file there
+#endif
+    return rename(temporaryName.str().c_str(), fileName.c_str()) == 0;
+}
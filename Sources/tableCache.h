@@ -0,0 +1,66 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _TABLECACHE_H_
+#define _TABLECACHE_H_
+
+#include <memory>
+#include <string>
+#include "types.h"
+
+using namespace std;
+
+/**
+  * Functions that persist the tables that the trail searches build at startup,
+  * so that the next runs map them into memory instead of computing them again.
+  * The tables are files in a cache directory, with a subdirectory per version
+  * of the file format. Each file starts with a header that records the
+  * parameters the table was computed with, e.g., the propagation type, the lane size
+  * and the maximum weight, so that a table is only reused for the same parameters.
+  * The directory is given by the environment variable KECCAKTOOLS_CACHE
+  * if set, and is "KeccakToolsCache" in the working directory otherwise.
+  */
+
+/** Function that returns the directory of the cached tables, including the version subdirectory. */
+string getTableCacheDirectory();
+
+/** Function that sets the base directory of the cached tables, overriding KECCAKTOOLS_CACHE. */
+void setTableCacheDirectory(const string& directory);
+
+/**
+  * Function that maps into memory the table cached under @a name,
+  * or reads it entirely where mapping is not available.
+  *
+  * @param  name        The name of the table, which is also its file name.
+  * @param  parameters  A description of the parameters of the table,
+  *                     which must match the one given to saveCachedTable().
+  * @param  size        The size of the table in bytes, on output.
+  * @return A pointer to the content of the table, aligned on 8 bytes,
+  *                     which releases the memory when the last copy goes away,
+  *                     or null if there is no table with these name and parameters.
+  */
+shared_ptr<const UINT8> loadCachedTable(const string& name, const string& parameters, size_t& size);
+
+/**
+  * Function that saves a table under @a name, creating the cache directory if needed.
+  * The file is first written under a temporary name, then renamed,
+  * so that concurrent runs never see a partial table.
+  * As the cache only saves time, a table that cannot be written is not an error.
+  *
+  * @return Whether the table was saved.
+  */
+bool saveCachedTable(const string& name, const string& parameters, const UINT8 *data, size_t size);
+
+#endif
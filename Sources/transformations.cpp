@@ -19,3 +19,10 @@ ostream& operator<<(ostream& a, const Transformation& transformation)
 {
     return a << transformation.getDescription();
 }
+
+void Transformation::applyBatch(UINT8 * states, unsigned int count) const
+{
+    unsigned int stateSize = (getWidth()+7)/8;
+    for(unsigned int i=0; i<count; i++)
+        (*this)(states + i*stateSize);
+}
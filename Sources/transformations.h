@@ -44,6 +44,17 @@ public:
       *                 ceil(getWidth()/8.0) bytes.
       */
     virtual void operator()(UINT8 * state) const = 0;
+    /**
+      * Method that applies the transformation onto several states stored
+      * one after the other. The default implementation calls operator()
+      * on each state in turn; subclasses may override it to process
+      * several states simultaneously.
+      *
+      * @param  states  A buffer containing @a count states, each of
+      *                 ceil(getWidth()/8.0) bytes.
+      * @param  count   The number of states in @a states.
+      */
+    virtual void applyBatch(UINT8 * states, unsigned int count) const;
     /**
       * Abstract method that returns a string with a description of itself.
       */
@@ -52,6 +52,78 @@ bool isSmallerAfterTranslation(const std::vector<T>& a, unsigned int dz)
     return (a[z] > a[(z+dz)%size]);
 }
 
+/** This function returns the smallest index @a k such that the rotation
+  * (@a a[k], @a a[k+1], ..., @a a[k-1]) is the smallest among the rotations
+  * of @a a in the lexicographic order that starts with the first element.
+  * It runs in time linear in the size of @a a.
+  * @param  a   The vector to rotate, of which the elements must support < and ==.
+  * @return The index of the first element of the smallest rotation.
+  */
+template<class T>
+unsigned int getLeastRotation(const std::vector<T>& a)
+{
+    unsigned int size = a.size();
+    unsigned int i = 0, j = 1, k = 0;
+    while((i < size) && (j < size) && (k < size)) {
+        const T& ai = a[(i+k)%size];
+        const T& aj = a[(j+k)%size];
+        if (ai == aj)
+            k++;
+        else {
+            if (aj < ai)
+                i += k+1;
+            else
+                j += k+1;
+            if (i == j)
+                j++;
+            k = 0;
+        }
+    }
+    return (i < j) ? i : j;
+}
+
+/** This function returns the smallest @a p &gt; 0 such that rotating
+  * @a a by @a p elements gives @a a again, or the size of @a a if there is none.
+  * It runs in time linear in the size of @a a.
+  * @param  a   The vector to consider, of which the elements must support ==.
+  * @return The period of @a a under rotation.
+  */
+template<class T>
+unsigned int getRotationPeriod(const std::vector<T>& a)
+{
+    unsigned int size = a.size();
+    if (size == 0)
+        return 0;
+    // Prefix function of Knuth, Morris and Pratt
+    std::vector<unsigned int> border(size, 0);
+    for(unsigned int i=1; i<size; i++) {
+        unsigned int b = border[i-1];
+        while((b > 0) && !(a[i] == a[b]))
+            b = border[b-1];
+        if (a[i] == a[b])
+            b++;
+        border[i] = b;
+    }
+    unsigned int period = size - border[size-1];
+    return ((size % period) == 0) ? period : size;
+}
+
+/** This function returns the translation amount @a dz such that
+  * the vector translated by @a dz, i.e., with @a a[z] moved to position (z+dz) modulo the size,
+  * is the smallest among the translated versions of @a a in the order of isSmaller().
+  * It runs in time linear in the size of @a a.
+  * @param  a   The vector to translate.
+  * @return The smallest amount of translation giving the minimum.
+  */
+template<class T>
+unsigned int getMinimalTranslation(const std::vector<T>& a)
+{
+    // isSmaller() compares from the highest index down, hence the reversed vector,
+    // on which translating by dz amounts to rotating by dz.
+    std::vector<T> reversed(a.rbegin(), a.rend());
+    return getLeastRotation(reversed);
+}
+
 /** This function returns whether the given vector without translation
   * is the smallest among the translated versions of itself.
   * @param  a   The vector to test.
@@ -60,11 +132,7 @@ bool isSmallerAfterTranslation(const std::vector<T>& a, unsigned int dz)
 template<class T>
 bool isMinimalSymmetrically(const std::vector<T>& a)
 {
-    unsigned int laneSize = a.size();
-    for(unsigned int dz=1; dz<laneSize; dz++)
-        if (isSmallerAfterTranslation(a, dz))
-            return false;
-    return true;
+    return getMinimalTranslation(a) == 0;
 }
 
 /** This function returns the minimum among the translated
@@ -76,15 +144,11 @@ bool isMinimalSymmetrically(const std::vector<T>& a)
 template<class T>
 void getSymmetricMinimum(const std::vector<T>& a, std::vector<T>& aMin)
 {
-    aMin = a;
     unsigned int laneSize = a.size();
-    for(unsigned int dz=1; dz<laneSize; dz++) {
-        std::vector<T> aDz(a.size());
-        for(unsigned int z=0; z<laneSize; z++)
-            aDz[(z+dz)%laneSize] = a[z];
-        if (isSmaller(aDz, aMin))
-            aMin = aDz;
-    }
+    unsigned int dz = getMinimalTranslation(a);
+    aMin.resize(laneSize);
+    for(unsigned int z=0; z<laneSize; z++)
+        aMin[(z+dz)%laneSize] = a[z];
 }
 
 #endif
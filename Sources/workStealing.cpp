@@ -0,0 +1,140 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <thread>
+#include "workStealing.h"
+
+WorkStealingPool::WorkStealingPool(unsigned int aNrThreads)
+    : nrThreads(aNrThreads), nrQueued(0), nrRunning(0), nrIdle(0),
+    sourceBusy(false), sourceExhausted(false)
+{
+    if (nrThreads == 0)
+        nrThreads = max(1U, thread::hardware_concurrency());
+    queues.resize(nrThreads);
+}
+
+unsigned int WorkStealingPool::getNumberOfThreads() const
+{
+    return nrThreads;
+}
+
+void WorkStealingPool::run(const Source& source)
+{
+    nrQueued = 0;
+    nrRunning = 0;
+    nrIdle = 0;
+    sourceBusy = false;
+    sourceExhausted = false;
+    failure = exception_ptr();
+    vector<thread> threads;
+    for(unsigned int t=0; t<nrThreads; t++)
+        threads.push_back(thread(&WorkStealingPool::work, this, t, cref(source)));
+    for(unsigned int t=0; t<nrThreads; t++)
+        threads[t].join();
+    for(unsigned int t=0; t<nrThreads; t++)
+        queues[t].clear();
+    if (failure)
+        rethrow_exception(failure);
+}
+
+void WorkStealingPool::spawn(unsigned int worker, const Task& task)
+{
+    lock_guard<mutex> guard(lock);
+    queues[worker].push_back(task);
+    nrQueued++;
+    wakeUp.notify_one();
+}
+
+bool WorkStealingPool::isHungry() const
+{
+    return nrIdle > 0;
+}
+
+bool WorkStealingPool::take(unsigned int worker, Task& task)
+{
+    if (nrQueued == 0)
+        return false;
+    if (!queues[worker].empty()) {
+        task = queues[worker].back();
+        queues[worker].pop_back();
+    }
+    else {
+        unsigned int victim = worker;
+        do
+            victim = (victim + 1) % nrThreads;
+        while(queues[victim].empty());
+        task = queues[victim].front();
+        queues[victim].pop_front();
+    }
+    nrQueued--;
+    return true;
+}
+
+void WorkStealingPool::execute(unique_lock<mutex>& guard, const Task& task, unsigned int worker)
+{
+    nrRunning++;
+    guard.unlock();
+    try {
+        task(worker);
+    }
+    catch(...) {
+        guard.lock();
+        if (!failure)
+            failure = current_exception();
+        guard.unlock();
+    }
+    guard.lock();
+    nrRunning--;
+    wakeUp.notify_all();
+}
+
+void WorkStealingPool::work(unsigned int worker, const Source& source)
+{
+    unique_lock<mutex> guard(lock);
+    while(!failure) {
+        Task task;
+        if (take(worker, task))
+            execute(guard, task, worker);
+        else if (!sourceExhausted && !sourceBusy) {
+            sourceBusy = true;
+            guard.unlock();
+            bool fetched = false;
+            try {
+                fetched = source(task);
+            }
+            catch(...) {
+                guard.lock();
+                if (!failure)
+                    failure = current_exception();
+                guard.unlock();
+            }
+            guard.lock();
+            sourceBusy = false;
+            if (!fetched)
+                sourceExhausted = true;
+            wakeUp.notify_all();
+            if (fetched)
+                execute(guard, task, worker);
+        }
+        else if (sourceExhausted && (nrRunning == 0))
+            break;
+        else {
+            nrIdle++;
+            wakeUp.wait(guard);
+            nrIdle--;
+        }
+    }
+    wakeUp.notify_all();
+}
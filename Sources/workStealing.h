@@ -0,0 +1,90 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _WORKSTEALING_H_
+#define _WORKSTEALING_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+/** This class implements a pool of threads that process tasks with work stealing.
+  * Each worker has its own double-ended queue of tasks: it takes the most recent
+  * task it spawned, and when its queue is empty, it steals the oldest task
+  * of another worker. When no task is queued at all, a worker asks the source
+  * given to run() for a new task.
+  * Tasks may therefore spawn sub-tasks when their work turns out to be heavy,
+  * typically only when isHungry() tells that some workers are idle.
+  */
+class WorkStealingPool {
+public:
+    /** The type of a task, which receives the index of the worker that executes it. */
+    typedef function<void(unsigned int worker)> Task;
+    /** The type of a source of tasks, which returns false when it is exhausted.
+      * The source is never called from two workers at the same time.
+      */
+    typedef function<bool(Task& task)> Source;
+protected:
+    unsigned int nrThreads;
+    vector<deque<Task> > queues;
+    mutex lock;
+    condition_variable wakeUp;
+    UINT64 nrQueued;
+    unsigned int nrRunning;
+    atomic<unsigned int> nrIdle;
+    bool sourceBusy, sourceExhausted;
+    exception_ptr failure;
+public:
+    /** The constructor.
+      * @param  aNrThreads  The number of worker threads,
+      *                     or 0 to use the number of hardware threads.
+      */
+    WorkStealingPool(unsigned int aNrThreads = 0);
+    /** This method returns the number of worker threads.
+      * @return The number of worker threads.
+      */
+    unsigned int getNumberOfThreads() const;
+    /** This method runs the workers until the source is exhausted and all the tasks,
+      * including the spawned ones, are done.
+      * If a task or the source throws an exception, the workers stop taking
+      * new tasks and the first exception is thrown again from this method.
+      * @param  source  The source of tasks.
+      */
+    void run(const Source& source);
+    /** This method queues a task on the queue of the given worker.
+      * It is meant to be called from within a task.
+      * @param  worker  The index of the worker executing the calling task.
+      * @param  task    The task to queue.
+      */
+    void spawn(unsigned int worker, const Task& task);
+    /** This method tells whether some workers are waiting for tasks,
+      * in which case a running task should spawn part of its work.
+      * @return True if some workers are idle.
+      */
+    bool isHungry() const;
+protected:
+    void work(unsigned int worker, const Source& source);
+    bool take(unsigned int worker, Task& task);
+    void execute(unique_lock<mutex>& guard, const Task& task, unsigned int worker);
+};
+
+#endif
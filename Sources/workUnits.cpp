@@ -0,0 +1,236 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <time.h>
+#include "workUnits.h"
+
+static const string manifestHeader = "KeccakTools work manifest";
+static const char *typeNames[] = { "top", "subtree", "shard", "parities" };
+
+void WorkUnit::save(ostream& fout) const
+{
+    fout << typeNames[type] << " " << dec << first << " " << last << " " << cursor.size();
+    for(unsigned int i=0; i<cursor.size(); i++)
+        fout << " " << cursor[i];
+    fout << endl;
+}
+
+void WorkUnit::load(istream& fin)
+{
+    string typeName;
+    UINT64 nrValues;
+    fin >> typeName >> dec >> first >> last >> nrValues;
+    if (!fin)
+        throw WorkManifestException("The work unit cannot be read.");
+    unsigned int t = 0;
+    while((t < 4) && (typeName != typeNames[t]))
+        t++;
+    if (t == 4)
+        throw WorkManifestException("The work unit has an unknown type: " + typeName);
+    type = (Type)t;
+    cursor.resize(nrValues);
+    for(UINT64 i=0; i<nrValues; i++)
+        fin >> cursor[i];
+    if (!fin)
+        throw WorkManifestException("The work unit cannot be read.");
+}
+
+WorkManifest::WorkManifest(const string& aFileName, const string& aDescription)
+    : fileName(aFileName), description(aDescription)
+{
+}
+
+WorkManifest::WorkManifest(const string& aFileName)
+    : fileName(aFileName)
+{
+    load();
+}
+
+void WorkManifest::load()
+{
+    ifstream fin(fileName.c_str());
+    if (!fin)
+        throw WorkManifestException("The manifest " + fileName + " cannot be read.");
+    string header;
+    getline(fin, header);
+    if (header != manifestHeader)
+        throw WorkManifestException("The file " + fileName + " is not a work manifest.");
+    getline(fin, description);
+    string keyword;
+    UINT64 nrUnits;
+    fin >> keyword >> dec >> nrUnits;
+    if ((!fin) || (keyword != "units"))
+        throw WorkManifestException("The manifest " + fileName + " is corrupted.");
+    units.resize(nrUnits);
+    for(UINT64 i=0; i<nrUnits; i++)
+        units[i].load(fin);
+}
+
+void WorkManifest::addUnit(const WorkUnit& unit)
+{
+    units.push_back(unit);
+}
+
+void WorkManifest::addTrailFileShards(unsigned int nrShards)
+{
+    for(unsigned int shard=0; shard<nrShards; shard++)
+        addUnit(WorkUnit(WorkUnit::trailFileShard, shard, nrShards));
+}
+
+void WorkManifest::addParityRanges(UINT64 nrParities, unsigned int nrUnits)
+{
+    if (nrUnits == 0)
+        return;
+    UINT64 first = 0;
+    for(unsigned int k=0; k<nrUnits; k++) {
+        UINT64 last = nrParities*(k+1)/nrUnits;
+        if (last > first)
+            addUnit(WorkUnit(WorkUnit::parityRange, first, last));
+        first = last;
+    }
+}
+
+void WorkManifest::save() const
+{
+    string tmpFileName = fileName + ".tmp";
+    {
+        ofstream fout(tmpFileName.c_str());
+        fout << manifestHeader << endl;
+        fout << description << endl;
+        fout << "units " << dec << units.size() << endl;
+        for(unsigned int i=0; i<units.size(); i++)
+            units[i].save(fout);
+        if (!fout)
+            throw WorkManifestException("The manifest " + tmpFileName + " cannot be written.");
+    }
+#ifdef _WIN32
+    remove(fileName.c_str());
+#endif
+    if (rename(tmpFileName.c_str(), fileName.c_str()) != 0)
+        throw WorkManifestException("The manifest " + fileName + " cannot be written.");
+}
+
+string WorkManifest::getOutputFileName(unsigned int i) const
+{
+    stringstream name;
+    name << fileName << ".unit" << dec << i;
+    return name.str();
+}
+
+string WorkManifest::getClaimFileName(unsigned int i) const
+{
+    return getOutputFileName(i) + ".claim";
+}
+
+bool WorkManifest::isDone(unsigned int i) const
+{
+    ifstream fin(getOutputFileName(i).c_str());
+    return (bool)fin;
+}
+
+bool WorkManifest::isComplete() const
+{
+    for(unsigned int i=0; i<units.size(); i++)
+        if (!isDone(i))
+            return false;
+    return true;
+}
+
+bool WorkManifest::claim(const string& workerName, unsigned int& i, unsigned int firstIndex) const
+{
+    for(i=firstIndex; i<units.size(); i++) {
+        if (isDone(i))
+            continue;
+        // The creation fails if another worker already claimed the unit.
+        FILE *f = fopen(getClaimFileName(i).c_str(), "wx");
+        if (f == 0)
+            continue;
+        fprintf(f, "%s %lu\n", workerName.c_str(), (unsigned long)time(0));
+        fclose(f);
+        // The unit may have been completed between the check and the claim.
+        if (isDone(i)) {
+            remove(getClaimFileName(i).c_str());
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+unsigned int WorkManifest::releaseClaims() const
+{
+    unsigned int count = 0;
+    for(unsigned int i=0; i<units.size(); i++)
+        if ((!isDone(i)) && (remove(getClaimFileName(i).c_str()) == 0))
+            count++;
+    return count;
+}
+
+void WorkManifest::run(unsigned int i, const function<void(const WorkUnit& unit, ostream& fout)>& run) const
+{
+    string outFileName = getOutputFileName(i);
+    string tmpFileName = outFileName + ".tmp";
+    try {
+        ofstream fout(tmpFileName.c_str(), ios::out | ios::binary | ios::trunc);
+        if (!fout)
+            throw WorkManifestException("The output " + tmpFileName + " cannot be written.");
+        run(units[i], fout);
+        fout.close();
+        if (!fout)
+            throw WorkManifestException("The output " + tmpFileName + " cannot be written.");
+    }
+    catch(...) {
+        remove(tmpFileName.c_str());
+        throw;
+    }
+#ifdef _WIN32
+    remove(outFileName.c_str());
+#endif
+    if (rename(tmpFileName.c_str(), outFileName.c_str()) != 0)
+        throw WorkManifestException("The output " + outFileName + " cannot be written.");
+    remove(getClaimFileName(i).c_str());
+}
+
+unsigned int WorkManifest::work(const string& workerName, const function<void(const WorkUnit& unit, ostream& fout)>& run) const
+{
+    unsigned int count = 0;
+    unsigned int i;
+    for(unsigned int next=0; claim(workerName, i, next); next=i+1) {
+        this->run(i, run);
+        count++;
+    }
+    return count;
+}
+
+void WorkManifest::merge(const string& outFileName) const
+{
+    if (!isComplete())
+        throw WorkManifestException("Some units of " + fileName + " are not done yet.");
+    ofstream fout(outFileName.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!fout)
+        throw WorkManifestException("The file " + outFileName + " cannot be written.");
+    for(unsigned int i=0; i<units.size(); i++) {
+        ifstream fin(getOutputFileName(i).c_str(), ios::in | ios::binary);
+        if (!fin)
+            throw WorkManifestException("The output " + getOutputFileName(i) + " cannot be read.");
+        if (fin.peek() != EOF)
+            fout << fin.rdbuf();
+    }
+    if (!fout)
+        throw WorkManifestException("The file " + outFileName + " cannot be written.");
+}
@@ -0,0 +1,233 @@
+/*
+KeccakTools
+
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _WORKUNITS_H_
+#define _WORKUNITS_H_
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+typedef Exception WorkManifestException;
+
+/** This class describes one independent part of a search, to be run by one worker
+  * of a WorkManifest. Its meaning depends on its type:
+  * - treeTop: the nodes of a tree up to depth @a first included;
+  * - treeSubtree: the descendants of the node given by @a cursor,
+  *     see GenericTreeIterator::getCursor();
+  * - trailFileShard: the shard @a first out of @a last of a trail file, see TrailFileIndex::getShard();
+  * - parityRange: the parities with index from @a first to @a last-1 in a list of parities.
+  */
+class WorkUnit {
+public:
+    /** The types of work units. */
+    enum Type { treeTop = 0, treeSubtree, trailFileShard, parityRange };
+    /** The type of the unit. */
+    Type type;
+    /** The first parameter of the unit, see the class description. */
+    UINT64 first;
+    /** The second parameter of the unit, see the class description. */
+    UINT64 last;
+    /** The cursor of the root node, for a unit of type treeSubtree. */
+    vector<UINT64> cursor;
+public:
+    /** The constructor.
+      * @param  aType   The type of the unit.
+      * @param  aFirst  The first parameter.
+      * @param  aLast   The second parameter.
+      */
+    WorkUnit(Type aType = treeTop, UINT64 aFirst = 0, UINT64 aLast = 0)
+        : type(aType), first(aFirst), last(aLast) {}
+    /** This method writes the unit on one line.
+      * @param  fout    The stream to write to.
+      */
+    void save(ostream& fout) const;
+    /** This method reads a unit written by save().
+      * @param  fin     The stream to read from.
+      */
+    void load(istream& fin);
+};
+
+/** This class lists the work units of a search spread over many independent workers,
+  * e.g., the jobs of a batch scheduler on a cluster, sharing a file system.
+  *
+  * The manifest file is a text file with a one-line description of the search
+  * followed by the units, one per line. It is written once by the process that
+  * splits the search. Afterwards, the state of a unit is kept in files next to the manifest:
+  * a worker claims the unit with index i by creating the file getClaimFileName(i) exclusively,
+  * writes its output under a temporary name, and marks the unit as done by renaming
+  * the output to getOutputFileName(i). Since the creation of the claim fails if the file exists,
+  * two workers never run the same unit, and since the rename is atomic,
+  * a unit whose output exists is complete.
+  * Workers can also run a unit given by its index, e.g., the index of a job in an array of jobs,
+  * without claiming it.
+  *
+  * When all the units are done, merge() concatenates their outputs in the order of the units.
+  */
+class WorkManifest {
+protected:
+    /** The name of the manifest file. */
+    string fileName;
+    /** The description of the search. */
+    string description;
+    /** The units. */
+    vector<WorkUnit> units;
+public:
+    /** The constructor of a new manifest, without units.
+      * @param  aFileName   The name of the manifest file.
+      * @param  aDescription    A one-line description of the search and of its parameters,
+      *                     which the workers use to know what to run.
+      */
+    WorkManifest(const string& aFileName, const string& aDescription);
+    /** The constructor that loads an existing manifest.
+      * @param  aFileName   The name of the manifest file.
+      */
+    WorkManifest(const string& aFileName);
+    /** This method returns the description of the search.
+      * @return The description of the search.
+      */
+    const string& getDescription() const { return description; }
+    /** This method returns the number of units.
+      * @return The number of units.
+      */
+    unsigned int getNumberOfUnits() const { return (unsigned int)units.size(); }
+    /** This method returns a unit.
+      * @param  i   The index of the unit.
+      * @return A constant reference to the unit.
+      */
+    const WorkUnit& getUnit(unsigned int i) const { return units[i]; }
+    /** This method appends a unit.
+      * @param  unit    The unit.
+      */
+    void addUnit(const WorkUnit& unit);
+    /** This method appends the units to traverse a tree: one unit of type treeTop
+      * for the nodes up to @a splitDepth, and one unit of type treeSubtree for the descendants
+      * of each node at depth @a splitDepth. The nodes up to @a splitDepth are enumerated
+      * to build the units.
+      * @param  iterator    An iterator over the tree, not yet started,
+      *                     e.g., a GenericTreeIterator.
+      * @param  splitDepth  The depth of the roots of the subtrees, at least 1.
+      */
+    template<class Iterator>
+    void addTreeUnits(const Iterator& iterator, unsigned int splitDepth)
+    {
+        if (splitDepth == 0)
+            throw WorkManifestException("The subtrees of the work units must be rooted at depth 1 or more.");
+        addUnit(WorkUnit(WorkUnit::treeTop, splitDepth));
+        Iterator top(iterator.subtree(splitDepth));
+        for (; !top.isEnd(); ++top)
+            if (top.getDepth() == splitDepth) {
+                WorkUnit unit(WorkUnit::treeSubtree);
+                top.getCursor(unit.cursor);
+                addUnit(unit);
+            }
+    }
+    /** This method appends the units of type trailFileShard that cover a trail file.
+      * @param  nrShards    The number of shards.
+      */
+    void addTrailFileShards(unsigned int nrShards);
+    /** This method appends the units of type parityRange that cover a list of parities.
+      * @param  nrParities  The number of parities in the list.
+      * @param  nrUnits     The number of units to create, if there are enough parities.
+      */
+    void addParityRanges(UINT64 nrParities, unsigned int nrUnits);
+    /** This method writes the manifest file.
+      * It is written under a temporary name and then renamed.
+      */
+    void save() const;
+    /** This method returns the name of the file with the output of a unit.
+      * @param  i   The index of the unit.
+      * @return The name of the output file.
+      */
+    string getOutputFileName(unsigned int i) const;
+    /** This method returns the name of the file marking that a unit is claimed.
+      * @param  i   The index of the unit.
+      * @return The name of the claim file.
+      */
+    string getClaimFileName(unsigned int i) const;
+    /** This method tells whether a unit is done, i.e., whether its output file exists.
+      * @param  i   The index of the unit.
+      * @return True if the unit is done.
+      */
+    bool isDone(unsigned int i) const;
+    /** This method tells whether all the units are done.
+      * @return True if all the units are done.
+      */
+    bool isComplete() const;
+    /** This method claims the first unit that is neither done nor claimed.
+      * @param  workerName  The name of the worker, written into the claim file.
+      * @param  i   The index of the claimed unit.
+      * @param  firstIndex  The index of the first unit to consider.
+      * @return False if there is no unit left to claim.
+      */
+    bool claim(const string& workerName, unsigned int& i, unsigned int firstIndex = 0) const;
+    /** This method removes the claims of the units that are not done,
+      * e.g., after workers were killed, so that other workers can claim them again.
+      * It must not be called while workers are running.
+      * @return The number of claims removed.
+      */
+    unsigned int releaseClaims() const;
+    /** This method runs a unit: it calls @a run with the unit and a stream
+      * opened on a temporary file, then marks the unit as done,
+      * and finally removes its claim, if any.
+      * If @a run throws an exception, the temporary file is removed and the exception is thrown again.
+      * @param  i   The index of the unit.
+      * @param  run The function that runs a unit and writes its output to the stream.
+      */
+    void run(unsigned int i, const function<void(const WorkUnit& unit, ostream& fout)>& run) const;
+    /** This method claims and runs units until none is left to claim.
+      * Since a unit is claimed at most once, each claim continues from the unit after the previous one.
+      * @param  workerName  The name of the worker, see claim().
+      * @param  run The function that runs a unit, see run().
+      * @return The number of units run.
+      */
+    unsigned int work(const string& workerName, const function<void(const WorkUnit& unit, ostream& fout)>& run) const;
+    /** This method concatenates the outputs of all the units, in the order of the units.
+      * @param  outFileName The name of the file to write to.
+      * @throw  WorkManifestException if some units are not done.
+      */
+    void merge(const string& outFileName) const;
+    /** This function returns the nodes of a tree visited by a unit made by addTreeUnits().
+      * @param  unit    The unit, of type treeTop or treeSubtree.
+      * @param  iterator    An iterator over the same tree as given to addTreeUnits().
+      * @param  visit   The function called with each node.
+      */
+    template<class Iterator, class Visit>
+    static void traverseTreeUnit(const WorkUnit& unit, const Iterator& iterator, Visit visit)
+    {
+        if (unit.type == WorkUnit::treeTop) {
+            Iterator top(iterator.subtree((unsigned int)unit.first));
+            for (; !top.isEnd(); ++top)
+                visit(*top);
+        }
+        else if (unit.type == WorkUnit::treeSubtree) {
+            Iterator root(iterator);
+            root.resume(unit.cursor);
+            Iterator descendants(root.subtree());
+            for (; !descendants.isEnd(); ++descendants)
+                visit(*descendants);
+        }
+        else
+            throw WorkManifestException("This work unit is not part of a tree.");
+    }
+protected:
+    void load();
+};
+
+#endif